@@ -0,0 +1,261 @@
+// Benchmark de host (Linux) del bus de eventos de app_manager_aq (app_bus_aq.c).
+//
+// Compara los tres modos del bus con un modelo del bucle por defecto de esp_event
+// (copia en el heap + cola de 32 + una tarea que recorre los handlers):
+//   latency:    una publicación en vuelo cada vez, del publish al handler (p50/p99/max);
+//   throughput: 1 y 4 productores publicando sin pausa; mensajes por segundo hasta que
+//               el último llega al handler, y reservas de heap por mensaje (malloc se
+//               intercepta con --wrap). QUEUE reintenta con el anillo lleno (backpressure),
+//               LATEST solo entrega el último (coalesced).
+// Antes se comprueba el puente a esp_event de los temas con bridge y el orden por
+// productor en QUEUE.
+
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "app_bus_aq.h"
+#include "esp_event.h"
+#include "mock_aq.h"
+
+ESP_EVENT_DEFINE_BASE(BENCH_EVENTS);
+
+typedef enum {
+    PATH_DIRECT,
+    PATH_QUEUE,
+    PATH_LATEST,
+    PATH_ESP_EVENT,
+    PATH_COUNT,
+} path_t;
+
+static const char *const s_path_name[PATH_COUNT] = { "direct", "queue", "latest", "esp_event" };
+
+static uint32_t s_iters = 20000;
+static uint32_t s_msgs = 1000000;
+
+static int64_t s_t_pub;
+static uint32_t *s_lat_ns;
+static _Atomic uint32_t s_done;         // último seq visto por el handler (latency)
+static _Atomic uint64_t s_delivered;    // entregas (throughput)
+static bool s_measure_latency;
+static uint32_t s_last_seq[8];          // QUEUE: orden por productor
+static _Atomic uint32_t s_order_errors;
+static uint32_t s_failures;
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void on_msg(uint32_t seq) {
+    if (s_measure_latency) {
+        s_lat_ns[seq] = (uint32_t)(now_ns() - s_t_pub);
+        atomic_store_explicit(&s_done, seq, memory_order_release);
+    } else {
+        atomic_fetch_add_explicit(&s_delivered, 1, memory_order_relaxed);
+    }
+}
+
+static void bus_handler(app_topic_aq_t topic, const void *data, void *ctx) {
+    switch (topic) {
+    case APP_TOPIC_RULE_OUTPUT_AQ:
+        on_msg((uint32_t)((const app_bus_rule_output_aq_t *)data)->value);
+        break;
+    case APP_TOPIC_SENSOR_AQ: {
+        const app_bus_sensor_aq_t *s = data;
+        uint32_t seq = (uint32_t)s->ts_ms;
+        if (!s_measure_latency) {
+            if (seq <= s_last_seq[s->channel]) atomic_fetch_add(&s_order_errors, 1);
+            s_last_seq[s->channel] = seq;
+        }
+        on_msg(seq);
+        break;
+    }
+    case APP_TOPIC_NET_STATS_AQ:
+        on_msg(((const app_bus_net_stats_aq_t *)data)->rx_packets);
+        break;
+    default:
+        break;
+    }
+}
+
+static void esp_event_handler(void *arg, esp_event_base_t base, int32_t id, void *data) {
+    on_msg((uint32_t)((const app_bus_sensor_aq_t *)data)->ts_ms);
+}
+
+static esp_err_t publish(path_t path, uint8_t producer, uint32_t seq) {
+    switch (path) {
+    case PATH_DIRECT: {
+        // float representa exactos los enteros hasta 2^24
+        const app_bus_rule_output_aq_t v = { .value = (float)seq, .signal = 0 };
+        return app_bus_pub_rule_output_aq(&v);
+    }
+    case PATH_QUEUE: {
+        const app_bus_sensor_aq_t v = { .ts_ms = seq, .value = 1.0f, .channel = producer };
+        return app_bus_pub_sensor_aq(&v);
+    }
+    case PATH_LATEST: {
+        const app_bus_net_stats_aq_t v = { .rx_packets = seq };
+        return app_bus_pub_net_stats_aq(&v);
+    }
+    default: {
+        const app_bus_sensor_aq_t v = { .ts_ms = seq, .value = 1.0f, .channel = producer };
+        return esp_event_post(BENCH_EVENTS, 0, &v, sizeof(v), portMAX_DELAY);
+    }
+    }
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// ---- Latencia ----
+
+static void bench_latency(path_t path) {
+    s_measure_latency = true;
+    atomic_store(&s_done, 0);
+    uint64_t a0 = mock_allocs_aq();
+    for (uint32_t i = 1; i <= s_iters; i++) {
+        s_t_pub = now_ns();
+        publish(path, 0, i);
+        while (atomic_load_explicit(&s_done, memory_order_acquire) != i) {
+        }
+    }
+    uint64_t allocs = mock_allocs_aq() - a0;
+    qsort(s_lat_ns + 1, s_iters, sizeof(uint32_t), cmp_u32);
+    printf("RESULT test=latency path=%s n=%u p50_ns=%u p99_ns=%u max_ns=%u allocs_per_msg=%.2f\n", s_path_name[path],
+           s_iters, s_lat_ns[1 + s_iters / 2], s_lat_ns[1 + (uint32_t)(s_iters * 0.99)], s_lat_ns[s_iters],
+           (double)allocs / s_iters);
+    s_measure_latency = false;
+}
+
+// ---- Rendimiento ----
+
+typedef struct {
+    path_t path;
+    uint8_t id;
+    uint32_t n;
+    uint64_t backpressure;
+} producer_t;
+
+static void *producer_main(void *arg) {
+    producer_t *p = arg;
+    for (uint32_t i = 1; i <= p->n; i++) {
+        while (publish(p->path, p->id, i) == ESP_ERR_NO_MEM) {
+            p->backpressure++;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static bool all_delivered(path_t path, uint64_t total, uint32_t published_before) {
+    if (path != PATH_LATEST) return atomic_load(&s_delivered) >= total;
+    // LATEST: hecho cuando la última publicación se entregó (las demás se fusionaron)
+    app_bus_stats_aq_t st;
+    app_bus_get_stats_aq(APP_TOPIC_NET_STATS_AQ, &st);
+    return st.published - published_before == total && atomic_load(&s_delivered) > 0 &&
+           st.delivered + st.coalesced == st.published;
+}
+
+static void bench_throughput(path_t path, int producers) {
+    producer_t p[8];
+    pthread_t th[8];
+    uint32_t per = s_msgs / producers;
+    uint64_t total = (uint64_t)per * producers;
+    app_bus_stats_aq_t before;
+    app_bus_get_stats_aq(path == PATH_QUEUE ? APP_TOPIC_SENSOR_AQ : APP_TOPIC_NET_STATS_AQ, &before);
+    memset(s_last_seq, 0, sizeof(s_last_seq));
+    atomic_store(&s_delivered, 0);
+
+    uint64_t a0 = mock_allocs_aq();
+    int64_t t0 = now_ns();
+    for (int i = 0; i < producers; i++) {
+        p[i] = (producer_t){ .path = path, .id = (uint8_t)i, .n = per };
+        pthread_create(&th[i], NULL, producer_main, &p[i]);
+    }
+    uint64_t backpressure = 0;
+    for (int i = 0; i < producers; i++) {
+        pthread_join(th[i], NULL);
+        backpressure += p[i].backpressure;
+    }
+    while (!all_delivered(path, total, before.published)) {
+        sched_yield();
+    }
+    int64_t t1 = now_ns();
+    uint64_t allocs = mock_allocs_aq() - a0;
+
+    app_bus_stats_aq_t st;
+    app_bus_get_stats_aq(path == PATH_QUEUE ? APP_TOPIC_SENSOR_AQ : APP_TOPIC_NET_STATS_AQ, &st);
+    double secs = (double)(t1 - t0) / 1e9;
+    printf("RESULT test=throughput path=%s producers=%d msgs=%llu mmsg_per_s=%.2f delivered=%llu backpressure=%llu "
+           "coalesced=%u high_water=%u allocs_per_msg=%.2f\n",
+           s_path_name[path], producers, (unsigned long long)total, total / secs / 1e6,
+           (unsigned long long)atomic_load(&s_delivered), (unsigned long long)backpressure,
+           path == PATH_LATEST ? st.coalesced - before.coalesced : 0, path == PATH_QUEUE ? st.high_water : 0,
+           (double)allocs / total);
+}
+
+// ---- Puente a esp_event ----
+
+static _Atomic int s_bridged;
+
+static void on_bridged(void *arg, esp_event_base_t base, int32_t id, void *data) {
+    const app_bus_link_aq_t *l = data;
+    if (id == APP_TOPIC_LINK_AQ && l->link_up && l->cause == 3) atomic_store(&s_bridged, 1);
+}
+
+static void check_bridge(void) {
+    const app_bus_link_aq_t link = { .link_up = true, .master_alive = true, .cause = 3 };
+    app_bus_link_aq_t out = { 0 };
+    app_bus_pub_link_aq(&link);
+    int64_t deadline = now_ns() + 1000000000;
+    while (!atomic_load(&s_bridged) && now_ns() < deadline) sched_yield();
+    bool ok = atomic_load(&s_bridged) && app_bus_latest_aq(APP_TOPIC_LINK_AQ, &out) == ESP_OK && out.cause == 3 &&
+              app_bus_latest_aq(APP_TOPIC_SENSOR_AQ, &out) == ESP_ERR_NOT_SUPPORTED;
+    printf("RESULT test=bridge ok=%s\n", ok ? "yes" : "NO");
+    if (!ok) s_failures++;
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "n:m:")) != -1) {
+        switch (opt) {
+        case 'n': s_iters = (uint32_t)atoi(optarg); break;
+        case 'm': s_msgs = (uint32_t)atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n latency_iters] [-m throughput_msgs]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (s_iters >= (1u << 24)) s_iters = (1u << 24) - 1;
+    s_lat_ns = calloc(s_iters + 1, sizeof(uint32_t));
+
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    ESP_ERROR_CHECK(app_bus_start_aq());
+    ESP_ERROR_CHECK(app_bus_subscribe_aq(APP_TOPIC_RULE_OUTPUT_AQ, bus_handler, NULL));
+    ESP_ERROR_CHECK(app_bus_subscribe_aq(APP_TOPIC_SENSOR_AQ, bus_handler, NULL));
+    ESP_ERROR_CHECK(app_bus_subscribe_aq(APP_TOPIC_NET_STATS_AQ, bus_handler, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(BENCH_EVENTS, ESP_EVENT_ANY_ID, esp_event_handler, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(APP_BUS_EVENTS, ESP_EVENT_ANY_ID, on_bridged, NULL));
+
+    check_bridge();
+    for (path_t p = 0; p < PATH_COUNT; p++) bench_latency(p);
+    static const int producers[] = { 1, 4 };
+    for (size_t k = 0; k < sizeof(producers) / sizeof(producers[0]); k++) {
+        for (path_t p = 0; p < PATH_COUNT; p++) bench_throughput(p, producers[k]);
+    }
+
+    app_bus_stats_aq_t st;
+    app_bus_get_stats_aq(APP_TOPIC_SENSOR_AQ, &st);
+    if (atomic_load(&s_order_errors)) s_failures++;
+    printf("RESULT check=%s order_errors=%u sensor_dropped=%u\n", s_failures ? "FAIL" : "ok",
+           atomic_load(&s_order_errors), st.dropped);
+    return s_failures ? 1 : 0;
+}
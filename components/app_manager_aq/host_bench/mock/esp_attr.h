@@ -0,0 +1,3 @@
+#pragma once
+// Atributos de sección de IDF: en el host todo es memoria normal
+#define IRAM_ATTR
@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+#include "sdkconfig.h"
+
+// Subconjunto de FreeRTOS sobre pthreads. Los ticks son milisegundos.
+typedef int32_t  BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t  StackType_t;   // como en IDF: pilas en bytes
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+#define portMAX_DELAY      ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms)  ((TickType_t)(ms))
+#define tskNO_AFFINITY     0x7FFFFFFF
+
+// En el host no hay ISR
+#define xPortInIsrContext()      0
+#define portYIELD_FROM_ISR(woken) (void)(woken)
+
+typedef struct mock_task *TaskHandle_t;
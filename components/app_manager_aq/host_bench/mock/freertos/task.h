@@ -0,0 +1,14 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+typedef struct { uint8_t opaque[352]; } StaticTask_t;
+
+// Los buffers se ignoran: la tarea es un pthread
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                           UBaseType_t prio, StackType_t *stack_buf, StaticTask_t *tcb,
+                                           BaseType_t core);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void       vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken);
+// Sin timeout en el mock: espera siempre
+uint32_t   ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks);
@@ -0,0 +1,175 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mock_aq.h"
+#include "esp_err.h"
+#include "esp_event.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// ---------- heap ----------
+
+static atomic_ullong s_allocs;
+
+void *__real_malloc(size_t size);
+void *__wrap_malloc(size_t size) {
+    atomic_fetch_add_explicit(&s_allocs, 1, memory_order_relaxed);
+    return __real_malloc(size);
+}
+
+uint64_t mock_allocs_aq(void) {
+    return atomic_load(&s_allocs);
+}
+
+// ---------- tareas ----------
+
+struct mock_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+};
+
+static __thread struct mock_task *s_current;
+
+static void *task_entry(void *p) {
+    struct mock_task *t = p;
+    s_current = t;
+    t->fn(t->arg);
+    return NULL;
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                           UBaseType_t prio, StackType_t *stack_buf, StaticTask_t *tcb,
+                                           BaseType_t core) {
+    (void)name; (void)stack; (void)prio; (void)stack_buf; (void)tcb; (void)core;
+    struct mock_task *t = calloc(1, sizeof(*t));
+    if (t == NULL) return NULL;
+    t->fn = fn;
+    t->arg = arg;
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_cond_init(&t->cond, NULL);
+    if (pthread_create(&t->thread, NULL, task_entry, t) != 0) {
+        free(t);
+        return NULL;
+    }
+    return t;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken) {
+    xTaskNotifyGive(task);
+    if (woken) *woken = pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+    (void)ticks;
+    struct mock_task *t = s_current;
+    pthread_mutex_lock(&t->lock);
+    while (t->notify == 0) pthread_cond_wait(&t->cond, &t->lock);
+    uint32_t val = t->notify;
+    t->notify = clear_on_exit ? 0 : val - 1;
+    pthread_mutex_unlock(&t->lock);
+    return val;
+}
+
+// ---------- esp_event (modelo del bucle por defecto) ----------
+
+#define EV_QUEUE_LEN CONFIG_ESP_SYSTEM_EVENT_QUEUE_SIZE
+#define EV_MAX_HANDLERS 16
+
+typedef struct {
+    esp_event_base_t base;
+    int32_t id;
+    void *data;
+} ev_item_t;
+
+typedef struct {
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t fn;
+    void *arg;
+} ev_handler_t;
+
+static pthread_mutex_t s_ev_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_ev_not_empty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t s_ev_not_full = PTHREAD_COND_INITIALIZER;
+static ev_item_t s_ev_q[EV_QUEUE_LEN];
+static uint32_t s_ev_head, s_ev_count;
+static ev_handler_t s_ev_handlers[EV_MAX_HANDLERS];
+static int s_ev_nhandlers;
+static pthread_t s_ev_thread;
+static bool s_ev_started;
+
+static void *ev_loop(void *arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&s_ev_lock);
+        while (s_ev_count == 0) pthread_cond_wait(&s_ev_not_empty, &s_ev_lock);
+        ev_item_t it = s_ev_q[s_ev_head];
+        s_ev_head = (s_ev_head + 1) % EV_QUEUE_LEN;
+        s_ev_count--;
+        pthread_cond_signal(&s_ev_not_full);
+        int n = s_ev_nhandlers;
+        pthread_mutex_unlock(&s_ev_lock);
+        for (int i = 0; i < n; i++) {
+            const ev_handler_t *h = &s_ev_handlers[i];
+            if (h->base == it.base && (h->id == ESP_EVENT_ANY_ID || h->id == it.id)) {
+                h->fn(h->arg, it.base, it.id, it.data);
+            }
+        }
+        free(it.data);
+    }
+    return NULL;
+}
+
+esp_err_t esp_event_loop_create_default(void) {
+    if (s_ev_started) return ESP_ERR_INVALID_STATE;
+    s_ev_started = true;
+    return pthread_create(&s_ev_thread, NULL, ev_loop, NULL) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t base, int32_t id, esp_event_handler_t fn, void *arg) {
+    pthread_mutex_lock(&s_ev_lock);
+    if (s_ev_nhandlers == EV_MAX_HANDLERS) {
+        pthread_mutex_unlock(&s_ev_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    s_ev_handlers[s_ev_nhandlers++] = (ev_handler_t){ base, id, fn, arg };
+    pthread_mutex_unlock(&s_ev_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_event_post(esp_event_base_t base, int32_t id, const void *data, size_t size, TickType_t ticks) {
+    void *copy = NULL;
+    if (size) {
+        copy = malloc(size);
+        if (copy == NULL) return ESP_ERR_NO_MEM;
+        memcpy(copy, data, size);
+    }
+    pthread_mutex_lock(&s_ev_lock);
+    while (s_ev_count == EV_QUEUE_LEN) {
+        if (ticks == 0) {
+            pthread_mutex_unlock(&s_ev_lock);
+            free(copy);
+            return ESP_ERR_TIMEOUT;
+        }
+        pthread_cond_wait(&s_ev_not_full, &s_ev_lock);
+    }
+    s_ev_q[(s_ev_head + s_ev_count) % EV_QUEUE_LEN] = (ev_item_t){ base, id, copy };
+    s_ev_count++;
+    pthread_cond_signal(&s_ev_not_empty);
+    pthread_mutex_unlock(&s_ev_lock);
+    return ESP_OK;
+}
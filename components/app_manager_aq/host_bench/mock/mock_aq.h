@@ -0,0 +1,5 @@
+#pragma once
+#include <stdint.h>
+
+// Reservas de heap de todo el proceso (el bench enlaza con -Wl,--wrap=malloc)
+uint64_t mock_allocs_aq(void);
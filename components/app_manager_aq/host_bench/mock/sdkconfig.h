@@ -0,0 +1,9 @@
+#pragma once
+// Valores por defecto del Kconfig de app_manager_aq (bus de eventos) para el build de host
+#define CONFIG_AQ_BUS_MAX_SUBS 4
+#define CONFIG_AQ_BUS_SENSOR_DEPTH 64
+#define CONFIG_AQ_BUS_TASK_PRIO 8
+#define CONFIG_AQ_BUS_TASK_CORE -1
+#define CONFIG_AQ_BUS_TASK_STACK 3072
+// Cola del bucle de eventos por defecto de IDF
+#define CONFIG_ESP_SYSTEM_EVENT_QUEUE_SIZE 32
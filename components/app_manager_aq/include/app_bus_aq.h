@@ -0,0 +1,107 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_event.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bus interno de la aplicación: temas con tipo fijo, suscriptores en tablas estáticas y
+// huecos preasignados por tema. Publicar no reserva memoria ni toma locks, y se puede
+// hacer desde una ISR. Tres modos por tema:
+//   DIRECT  los handlers corren dentro de la publicación, en el contexto del que publica
+//           (si publica una ISR, los handlers deben ser seguros en ISR).
+//   QUEUE   anillo de `depth` huecos (potencia de 2) que vacía la tarea del bus; con el
+//           anillo lleno la publicación devuelve ESP_ERR_NO_MEM y se cuenta en dropped.
+//   LATEST  solo importa el último valor: se sobrescribe sin perder nunca el más nuevo,
+//           la tarea del bus entrega el último (los intermedios cuentan en coalesced) y
+//           app_bus_latest_aq lo lee desde cualquier tarea.
+// Los temas con bridge se reenvían además a esp_event (APP_BUS_EVENTS, id = tema) desde
+// la tarea del bus: solo para eventos gruesos y poco frecuentes.
+
+ESP_EVENT_DECLARE_BASE(APP_BUS_EVENTS);
+
+typedef enum {
+    APP_BUS_DIRECT_AQ,
+    APP_BUS_QUEUE_AQ,
+    APP_BUS_LATEST_AQ,
+} app_bus_mode_aq_t;
+
+typedef struct {
+    bool link_up;
+    bool master_alive;
+    bool safe_mode;
+    uint8_t cause;          // usb_comms_safe_cause_aq_t
+} app_bus_link_aq_t;
+
+typedef struct {
+    uint32_t rx_packets;
+    uint32_t rx_bytes;
+    uint32_t tx_packets;
+    uint32_t tx_bytes;
+    uint32_t drops;         // suma de todas las causas
+} app_bus_net_stats_aq_t;
+
+typedef struct {
+    int64_t ts_ms;
+    float value;
+    uint8_t channel;
+} app_bus_sensor_aq_t;
+
+typedef struct {
+    float value;
+    uint8_t signal;         // señal del motor de reglas
+} app_bus_rule_output_aq_t;
+
+// X(NOMBRE, nombre, tipo, modo, depth, bridge)
+#define APP_BUS_TOPICS_AQ(X)                                                                                  \
+    X(LINK,        link,        app_bus_link_aq_t,        APP_BUS_LATEST_AQ, 4,                          1) \
+    X(NET_STATS,   net_stats,   app_bus_net_stats_aq_t,   APP_BUS_LATEST_AQ, 4,                          0) \
+    X(SENSOR,      sensor,      app_bus_sensor_aq_t,      APP_BUS_QUEUE_AQ,  CONFIG_AQ_BUS_SENSOR_DEPTH, 0) \
+    X(RULE_OUTPUT, rule_output, app_bus_rule_output_aq_t, APP_BUS_DIRECT_AQ, 0,                          0)
+
+typedef enum {
+#define APP_BUS_ENUM_AQ(NAME, name, type, mode, depth, bridge) APP_TOPIC_##NAME##_AQ,
+    APP_BUS_TOPICS_AQ(APP_BUS_ENUM_AQ)
+#undef APP_BUS_ENUM_AQ
+    APP_TOPIC_COUNT_AQ,
+} app_topic_aq_t;
+
+// data apunta a una copia (QUEUE, LATEST) o a lo publicado (DIRECT); solo vale durante la llamada
+typedef void (*app_bus_handler_aq_t)(app_topic_aq_t topic, const void *data, void *ctx);
+
+typedef struct {
+    uint32_t published;
+    uint32_t delivered;     // publicaciones que llegaron a los handlers
+    uint32_t dropped;       // QUEUE: anillo lleno
+    uint32_t coalesced;     // LATEST: sobrescritas antes de entregarse
+    uint32_t high_water;    // QUEUE: ocupación máxima vista por la tarea del bus
+    uint8_t subscribers;
+} app_bus_stats_aq_t;
+
+// Inicializa los anillos y arranca la tarea del bus (pila y TCB estáticos). Publicar antes
+// devuelve ESP_ERR_INVALID_STATE; suscribirse se puede antes o después.
+esp_err_t app_bus_start_aq(void);
+// Hasta CONFIG_AQ_BUS_MAX_SUBS por tema, sin baja. Seguro desde cualquier tarea.
+esp_err_t app_bus_subscribe_aq(app_topic_aq_t topic, app_bus_handler_aq_t fn, void *ctx);
+// data: un valor del tipo del tema. Seguro desde cualquier tarea o ISR.
+esp_err_t app_bus_publish_aq(app_topic_aq_t topic, const void *data);
+// Último valor de un tema LATEST. ESP_ERR_NOT_FOUND si aún no se ha publicado.
+esp_err_t app_bus_latest_aq(app_topic_aq_t topic, void *out);
+esp_err_t app_bus_get_stats_aq(app_topic_aq_t topic, app_bus_stats_aq_t *out);
+
+// Envoltorios con tipo: app_bus_pub_<nombre>_aq(const tipo *v)
+#define APP_BUS_PUB_AQ(NAME, name, type, mode, depth, bridge)          \
+    static inline esp_err_t app_bus_pub_##name##_aq(const type *v) { \
+        return app_bus_publish_aq(APP_TOPIC_##NAME##_AQ, v);          \
+    }
+APP_BUS_TOPICS_AQ(APP_BUS_PUB_AQ)
+#undef APP_BUS_PUB_AQ
+
+#ifdef __cplusplus
+}
+#endif
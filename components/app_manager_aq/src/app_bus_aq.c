@@ -0,0 +1,339 @@
+#include "app_bus_aq.h"
+#include <stdatomic.h>
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "app_bus_aq";
+
+ESP_EVENT_DEFINE_BASE(APP_BUS_EVENTS);
+
+#define BUS_CORE_AQ (CONFIG_AQ_BUS_TASK_CORE < 0 ? tskNO_AFFINITY : CONFIG_AQ_BUS_TASK_CORE)
+
+// Cabecera de cada hueco; el payload va detrás, alineado a 8
+typedef struct {
+    _Atomic uint32_t seq;
+    uint32_t pad;
+} cell_hdr_t;
+
+// Huecos de cada tema (uno de relleno en DIRECT, que no guarda nada)
+#define APP_BUS_CELLS_AQ(NAME, n, T, M, D, B)                                                          \
+    typedef struct {                                                                                    \
+        cell_hdr_t h;                                                                                   \
+        T data;                                                                                         \
+    } cell_##n##_t;                                                                                     \
+    static cell_##n##_t s_cells_##n[(M) == APP_BUS_DIRECT_AQ ? 1 : (D)];                                \
+    _Static_assert((M) == APP_BUS_DIRECT_AQ || ((D) >= 2 && ((D) & ((D) - 1)) == 0),                    \
+                   #NAME ": depth must be a power of 2");                                               \
+    _Static_assert(!((M) == APP_BUS_DIRECT_AQ && (B)), #NAME ": DIRECT topics cannot bridge");
+APP_BUS_TOPICS_AQ(APP_BUS_CELLS_AQ)
+#undef APP_BUS_CELLS_AQ
+
+#define APP_BUS_SIZE_AQ(NAME, n, T, M, D, B) +sizeof(s_cells_##n)
+#define CELLS_BYTES_AQ (0 APP_BUS_TOPICS_AQ(APP_BUS_SIZE_AQ))
+
+typedef struct {
+    const char *name;
+    uint8_t *cells;
+    uint16_t stride;
+    uint16_t offset;        // del payload dentro del hueco
+    uint16_t size;
+    uint16_t mask;
+    uint8_t mode;
+    bool bridge;
+} topic_desc_t;
+
+static const topic_desc_t s_desc[APP_TOPIC_COUNT_AQ] = {
+#define APP_BUS_DESC_AQ(NAME, n, T, M, D, B)                                                            \
+    [APP_TOPIC_##NAME##_AQ] = {                                                                         \
+        .name = #n,                                                                                     \
+        .cells = (uint8_t *)s_cells_##n,                                                                \
+        .stride = sizeof(cell_##n##_t),                                                                 \
+        .offset = offsetof(cell_##n##_t, data),                                                         \
+        .size = sizeof(T),                                                                              \
+        .mask = (M) == APP_BUS_DIRECT_AQ ? 0 : (D) - 1,                                                 \
+        .mode = (M),                                                                                    \
+        .bridge = (B),                                                                                  \
+    },
+    APP_BUS_TOPICS_AQ(APP_BUS_DESC_AQ)
+#undef APP_BUS_DESC_AQ
+};
+
+// Copia de trabajo de la tarea del bus, con el tamaño y la alineación del mayor payload
+typedef union {
+#define APP_BUS_UNION_AQ(NAME, n, T, M, D, B) T n;
+    APP_BUS_TOPICS_AQ(APP_BUS_UNION_AQ)
+#undef APP_BUS_UNION_AQ
+} any_payload_t;
+
+typedef struct {
+    _Atomic(app_bus_handler_aq_t) fn;   // se publica el último: NULL = hueco aún a medias
+    void *ctx;
+} sub_t;
+
+typedef struct {
+    _Atomic uint32_t head;          // QUEUE: posiciones reservadas; LATEST: escrituras empezadas
+    uint32_t tail;                  // QUEUE: solo la tarea del bus
+    _Atomic uint32_t complete;      // LATEST: posición + 1 de la última escritura completa
+    uint32_t delivered_pos;         // LATEST: solo la tarea del bus
+    _Atomic uint32_t nsubs;
+    sub_t subs[CONFIG_AQ_BUS_MAX_SUBS];
+    _Atomic uint32_t published;
+    _Atomic uint32_t delivered;
+    _Atomic uint32_t dropped;
+    _Atomic uint32_t coalesced;
+    uint32_t high_water;
+} topic_state_t;
+
+static topic_state_t s_state[APP_TOPIC_COUNT_AQ];
+static atomic_bool s_ready;
+static atomic_bool s_wake;          // la tarea ya tiene un aviso pendiente
+static TaskHandle_t s_task;
+static StaticTask_t s_task_tcb;
+static StackType_t s_task_stack[CONFIG_AQ_BUS_TASK_STACK];
+static any_payload_t s_scratch;
+
+static inline uint8_t *cell_at(const topic_desc_t *d, uint32_t pos)
+{
+    return d->cells + (size_t)(pos & d->mask) * d->stride;
+}
+
+static inline _Atomic uint32_t *cell_seq(uint8_t *cell)
+{
+    return &((cell_hdr_t *)cell)->seq;
+}
+
+static void IRAM_ATTR dispatch(app_topic_aq_t topic, const void *data)
+{
+    topic_state_t *st = &s_state[topic];
+    uint32_t n = atomic_load_explicit(&st->nsubs, memory_order_acquire);
+    if (n > CONFIG_AQ_BUS_MAX_SUBS) n = CONFIG_AQ_BUS_MAX_SUBS;
+    for (uint32_t i = 0; i < n; i++) {
+        app_bus_handler_aq_t fn = atomic_load_explicit(&st->subs[i].fn, memory_order_acquire);
+        if (fn) fn(topic, data, st->subs[i].ctx);
+    }
+    atomic_fetch_add_explicit(&st->delivered, 1, memory_order_relaxed);
+}
+
+// Un solo aviso por ráfaga: la tarea borra s_wake antes de vaciar, así que lo que se
+// publique a partir de ahí vuelve a avisar
+static void IRAM_ATTR wake_task(void)
+{
+    if (atomic_exchange_explicit(&s_wake, true, memory_order_acq_rel)) return;
+    if (xPortInIsrContext()) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(s_task, &woken);
+        portYIELD_FROM_ISR(woken);
+    } else {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+// Anillo de Vyukov, como el log diferido de usb_netif_aq: el hueco está libre para pos
+// cuando seq == pos y publicado cuando seq == pos + 1
+static bool IRAM_ATTR queue_push(const topic_desc_t *d, topic_state_t *st, const void *data)
+{
+    uint32_t pos = atomic_load_explicit(&st->head, memory_order_relaxed);
+    uint8_t *cell;
+    for (;;) {
+        cell = cell_at(d, pos);
+        int32_t diff = (int32_t)(atomic_load_explicit(cell_seq(cell), memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&st->head, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = atomic_load_explicit(&st->head, memory_order_relaxed);
+        }
+    }
+    memcpy(cell + d->offset, data, d->size);
+    atomic_store_explicit(cell_seq(cell), pos + 1, memory_order_release);
+    return true;
+}
+
+static bool queue_pop(const topic_desc_t *d, topic_state_t *st, void *out)
+{
+    uint8_t *cell = cell_at(d, st->tail);
+    if (atomic_load_explicit(cell_seq(cell), memory_order_acquire) != st->tail + 1) return false;
+    uint32_t depth = atomic_load_explicit(&st->head, memory_order_relaxed) - st->tail;
+    if (depth > st->high_water) st->high_water = depth;
+    memcpy(out, cell + d->offset, d->size);
+    atomic_store_explicit(cell_seq(cell), st->tail + d->mask + 1, memory_order_release);
+    st->tail++;
+    return true;
+}
+
+// LATEST: cada escritura toma su propio hueco del anillo y lo marca con un seqlock
+// (2·pos + 1 escribiendo, 2·pos + 2 completo); complete apunta a la más nueva terminada.
+// Ningún escritor espera a otro: el lector reintenta si el hueco cambió mientras copiaba.
+static void IRAM_ATTR latest_write(const topic_desc_t *d, topic_state_t *st, const void *data)
+{
+    uint32_t pos = atomic_fetch_add_explicit(&st->head, 1, memory_order_relaxed);
+    uint8_t *cell = cell_at(d, pos);
+    atomic_store_explicit(cell_seq(cell), 2 * pos + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(cell + d->offset, data, d->size);
+    atomic_store_explicit(cell_seq(cell), 2 * pos + 2, memory_order_release);
+    uint32_t cur = atomic_load_explicit(&st->complete, memory_order_relaxed);
+    while ((int32_t)(pos + 1 - cur) > 0 &&
+           !atomic_compare_exchange_weak_explicit(&st->complete, &cur, pos + 1, memory_order_release,
+                                                  memory_order_relaxed)) {
+    }
+}
+
+static bool latest_read(const topic_desc_t *d, topic_state_t *st, void *out, uint32_t *out_pos)
+{
+    // Solo falla si mask + 1 escritores adelantan al lector durante la copia
+    for (int tries = 0; tries < 16; tries++) {
+        uint32_t c = atomic_load_explicit(&st->complete, memory_order_acquire);
+        // c == 0 también tras 2^32 escrituras: entonces pos = UINT32_MAX
+        if (c == 0 && atomic_load_explicit(&st->head, memory_order_relaxed) == 0) return false;
+        uint32_t pos = c - 1;
+        uint8_t *cell = cell_at(d, pos);
+        if (atomic_load_explicit(cell_seq(cell), memory_order_acquire) != 2 * pos + 2) continue;
+        memcpy(out, cell + d->offset, d->size);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(cell_seq(cell), memory_order_relaxed) != 2 * pos + 2) continue;
+        *out_pos = c;
+        return true;
+    }
+    return false;
+}
+
+esp_err_t IRAM_ATTR app_bus_publish_aq(app_topic_aq_t topic, const void *data)
+{
+    if (topic >= APP_TOPIC_COUNT_AQ || data == NULL) return ESP_ERR_INVALID_ARG;
+    if (!atomic_load_explicit(&s_ready, memory_order_acquire)) return ESP_ERR_INVALID_STATE;
+    const topic_desc_t *d = &s_desc[topic];
+    topic_state_t *st = &s_state[topic];
+    atomic_fetch_add_explicit(&st->published, 1, memory_order_relaxed);
+    switch (d->mode) {
+    case APP_BUS_DIRECT_AQ:
+        dispatch(topic, data);
+        return ESP_OK;
+    case APP_BUS_QUEUE_AQ:
+        if (!queue_push(d, st, data)) {
+            // Lleno: se pierde el nuevo, nunca se bloquea al que publica
+            atomic_fetch_add_explicit(&st->dropped, 1, memory_order_relaxed);
+            return ESP_ERR_NO_MEM;
+        }
+        break;
+    default:
+        latest_write(d, st, data);
+        break;
+    }
+    wake_task();
+    return ESP_OK;
+}
+
+static void deliver(app_topic_aq_t topic, const topic_desc_t *d)
+{
+    dispatch(topic, &s_scratch);
+    if (d->bridge) {
+        // Sin espera: si la cola de esp_event está llena se pierde el aviso, no el bus
+        if (esp_event_post(APP_BUS_EVENTS, topic, &s_scratch, d->size, 0) != ESP_OK) {
+            ESP_LOGW(TAG, "esp_event queue full, %s not bridged", d->name);
+        }
+    }
+}
+
+// Vacía todos los temas; true si entregó algo
+static bool drain(void)
+{
+    bool any = false;
+    for (int t = 0; t < APP_TOPIC_COUNT_AQ; t++) {
+        const topic_desc_t *d = &s_desc[t];
+        topic_state_t *st = &s_state[t];
+        if (d->mode == APP_BUS_QUEUE_AQ) {
+            // Como mucho un anillo por pasada para no dejar sin turno a los demás temas
+            for (uint32_t n = 0; n <= d->mask && queue_pop(d, st, &s_scratch); n++) {
+                deliver((app_topic_aq_t)t, d);
+                any = true;
+            }
+        } else if (d->mode == APP_BUS_LATEST_AQ) {
+            uint32_t pos;
+            if (latest_read(d, st, &s_scratch, &pos) && pos != st->delivered_pos) {
+                if (st->delivered_pos && pos - st->delivered_pos > 1) {
+                    atomic_fetch_add_explicit(&st->coalesced, pos - st->delivered_pos - 1, memory_order_relaxed);
+                }
+                st->delivered_pos = pos;
+                deliver((app_topic_aq_t)t, d);
+                any = true;
+            }
+        }
+    }
+    return any;
+}
+
+static void app_bus_task(void *arg)
+{
+    for (;;) {
+        atomic_store_explicit(&s_wake, false, memory_order_release);
+        while (drain()) {
+        }
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+esp_err_t app_bus_start_aq(void)
+{
+    if (atomic_load_explicit(&s_ready, memory_order_acquire)) return ESP_OK;
+    for (int t = 0; t < APP_TOPIC_COUNT_AQ; t++) {
+        const topic_desc_t *d = &s_desc[t];
+        if (d->mode != APP_BUS_QUEUE_AQ) continue;
+        for (uint32_t i = 0; i <= d->mask; i++) {
+            atomic_store_explicit(cell_seq(cell_at(d, i)), i, memory_order_relaxed);
+        }
+    }
+    s_task = xTaskCreateStaticPinnedToCore(app_bus_task, "app_bus", CONFIG_AQ_BUS_TASK_STACK, NULL,
+                                           CONFIG_AQ_BUS_TASK_PRIO, s_task_stack, &s_task_tcb, BUS_CORE_AQ);
+    if (s_task == NULL) return ESP_FAIL;
+    atomic_store_explicit(&s_ready, true, memory_order_release);
+    ESP_LOGI(TAG, "Event bus started: %d topics, %u bytes of slots", APP_TOPIC_COUNT_AQ, (unsigned)CELLS_BYTES_AQ);
+    return ESP_OK;
+}
+
+esp_err_t app_bus_subscribe_aq(app_topic_aq_t topic, app_bus_handler_aq_t fn, void *ctx)
+{
+    if (topic >= APP_TOPIC_COUNT_AQ || fn == NULL) return ESP_ERR_INVALID_ARG;
+    topic_state_t *st = &s_state[topic];
+    // Se reserva el índice, se rellena y se publica fn: dispatch salta los huecos a medias
+    uint32_t i = atomic_fetch_add_explicit(&st->nsubs, 1, memory_order_acq_rel);
+    if (i >= CONFIG_AQ_BUS_MAX_SUBS) {
+        atomic_fetch_sub_explicit(&st->nsubs, 1, memory_order_relaxed);
+        return ESP_ERR_NO_MEM;
+    }
+    st->subs[i].ctx = ctx;
+    atomic_store_explicit(&st->subs[i].fn, fn, memory_order_release);
+    return ESP_OK;
+}
+
+esp_err_t app_bus_latest_aq(app_topic_aq_t topic, void *out)
+{
+    if (topic >= APP_TOPIC_COUNT_AQ || out == NULL) return ESP_ERR_INVALID_ARG;
+    const topic_desc_t *d = &s_desc[topic];
+    if (d->mode != APP_BUS_LATEST_AQ) return ESP_ERR_NOT_SUPPORTED;
+    uint32_t pos;
+    return latest_read(d, &s_state[topic], out, &pos) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t app_bus_get_stats_aq(app_topic_aq_t topic, app_bus_stats_aq_t *out)
+{
+    if (topic >= APP_TOPIC_COUNT_AQ || out == NULL) return ESP_ERR_INVALID_ARG;
+    topic_state_t *st = &s_state[topic];
+    uint32_t subs = atomic_load_explicit(&st->nsubs, memory_order_relaxed);
+    *out = (app_bus_stats_aq_t){
+        .published = atomic_load_explicit(&st->published, memory_order_relaxed),
+        .delivered = atomic_load_explicit(&st->delivered, memory_order_relaxed),
+        .dropped = atomic_load_explicit(&st->dropped, memory_order_relaxed),
+        .coalesced = atomic_load_explicit(&st->coalesced, memory_order_relaxed),
+        .high_water = st->high_water,
+        .subscribers = (uint8_t)(subs < CONFIG_AQ_BUS_MAX_SUBS ? subs : CONFIG_AQ_BUS_MAX_SUBS),
+    };
+    return ESP_OK;
+}
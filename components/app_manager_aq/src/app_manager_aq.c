@@ -1,23 +1,411 @@
 #include "app_manager_aq.h"
+#include "app_bus_aq.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_app_desc.h"
 #include "esp_log.h"
 #include "esp_event.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "ctrl_udp_aq.h"
+#include "mqtt_service_aq.h"
+#include "ota_aq.h"
+#include "rules_engine_aq.h"
+#include "telemetry_codec_aq.h"
+#include "timesync_aq.h"
+#include "tsdb_aq.h"
 #include "usb_comms_aq.h"
+#include "usb_netif_aq.h"
 
 static const char *TAG = "app_manager_aq";
 
+// Arena de decodificación de comandos; solo se usa desde la tarea de mqtt_service_aq
+static uint8_t s_cmd_arena_buf[CONFIG_AQ_TLM_ARENA_SIZE];
+static tlm_arena_aq_t s_cmd_arena;
+static uint8_t s_topic_ack = MQTT_SERVICE_TOPIC_INVALID_AQ;
+static esp_timer_handle_t s_rules_timer;
+static uint8_t s_sig_safe_mode = RULES_SIGNAL_INVALID_AQ;
+static esp_netif_t *s_netif;
+static uint32_t s_ota_req;
+// target del canal UDP -> señal "ctrl_<target>", resuelto en start_rules
+static uint8_t s_ctrl_sig[CONFIG_AQ_CTRL_SIGNALS];
+static uint8_t s_topic_tsdb = MQTT_SERVICE_TOPIC_INVALID_AQ;
+static TaskHandle_t s_tsdb_task;
+
+// Un segmento de tsdb_aq por PUBLISH QoS1: cabecera fija (5) + topic (2 + len) + packet id (2)
+_Static_assert(CONFIG_AQ_TSDB_SEG_SIZE + 9 + sizeof(CONFIG_AQ_MQTT_TOPIC_ROOT "/" CONFIG_AQ_MQTT_PANEL_ID "/tsdb") <=
+                   CONFIG_AQ_MQTT_SLOT_SIZE,
+               "AQ_TSDB_SEG_SIZE does not fit in an MQTT QoS1 slot");
+
+#define RULES_NVS_NS  "app_manager_aq"
+#define RULES_NVS_KEY "rules"
+
+static void send_ack(uint32_t req, bool ok, const char *err)
+{
+    tlm_msg_aq_t msg = {.type = TLM_MSG_ACK_AQ};
+    msg.ack.id = CONFIG_AQ_MQTT_PANEL_ID;
+    msg.ack.api_version = "1.0";
+    msg.ack.fw_version = esp_app_get_description()->version;
+    msg.ack.req = req;
+    msg.ack.ok = ok;
+    msg.ack.err = err;
+
+    uint8_t buf[192];
+    size_t len;
+    if (tlm_encode_aq(tlm_get_format_aq(), &msg, buf, sizeof(buf), &len) == ESP_OK) {
+        mqtt_service_publish_aq(s_topic_ack, buf, len, 1, false);
+    }
+}
+
+// target = "ip:puerto" del emisor OTA del MASTER; vacío = broker y puerto por defecto.
+// El ack final (OTA_DONE/OTA_FAILED) lleva el mismo req.
+static void start_ota(const tlm_command_aq_t *cmd)
+{
+    char host[16] = CONFIG_AQ_MQTT_BROKER_HOST;
+    uint16_t port = CONFIG_AQ_OTA_DEFAULT_PORT;
+    const char *target = cmd->target ? cmd->target : "";
+    const char *colon = strchr(target, ':');
+    size_t host_len = colon ? (size_t)(colon - target) : strlen(target);
+    if (host_len >= sizeof(host)) {
+        send_ack(cmd->req, false, "bad target");
+        return;
+    }
+    if (host_len) {
+        memcpy(host, target, host_len);
+        host[host_len] = '\0';
+    }
+    if (colon) port = (uint16_t)atoi(colon + 1);
+
+    s_ota_req = cmd->req;
+    esp_err_t err = ota_start_aq(s_netif, host, port);
+    if (err != ESP_OK) {
+        send_ack(cmd->req, false, esp_err_to_name(err));
+    }
+}
+
+static void on_ota(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    if (id == OTA_DONE) {
+        send_ack(s_ota_req, true, NULL);
+    } else if (id == OTA_FAILED) {
+        send_ack(s_ota_req, false, esp_err_to_name(((const ota_stats_aq_t *)data)->result));
+    }
+}
+
+// Comandos del MASTER en <prefijo>cmd, en CBOR o JSON (se detecta por el primer byte)
+static void on_command(const char *topic, size_t topic_len, const uint8_t *payload, size_t len, void *ctx)
+{
+    tlm_format_aq_t fmt;
+    tlm_msg_aq_t msg;
+    tlm_arena_reset_aq(&s_cmd_arena);
+    if (tlm_detect_format_aq(payload, len, &fmt) != ESP_OK ||
+        tlm_decode_aq(fmt, payload, len, &s_cmd_arena, &msg) != ESP_OK || msg.type != TLM_MSG_COMMAND_AQ) {
+        ESP_LOGW(TAG, "Discarding malformed command (%u bytes)", (unsigned)len);
+        return;
+    }
+
+    const tlm_command_aq_t *cmd = &msg.command;
+    if (cmd->cmd && strcmp(cmd->cmd, "encoding") == 0) {
+        // target = formatos aceptados por el MASTER en orden de preferencia, p.ej. "cbor,json"
+        esp_err_t err = tlm_negotiate_aq(cmd->target ? cmd->target : "");
+        ESP_LOGI(TAG, "Telemetry encoding: %s", tlm_format_name_aq(tlm_get_format_aq()));
+        send_ack(cmd->req, err == ESP_OK, err == ESP_OK ? NULL : "unsupported encoding");
+        return;
+    }
+    if (cmd->cmd && strcmp(cmd->cmd, "ota") == 0) {
+        start_ota(cmd);
+        return;
+    }
+    if (cmd->cmd && strcmp(cmd->cmd, "set") == 0) {
+        // Misma acción que CTRL_UDP_OP_SET_AQ por la vía MQTT; target = nombre de una señal
+        // que ya existe (la usa una regla o la ha registrado el firmware). Un nombre
+        // desconocido se rechaza en vez de crear un registro que nadie lee.
+        uint8_t sig = rules_find_signal_aq(cmd->target ? cmd->target : "");
+        esp_err_t err = rules_set_input_aq(sig, cmd->value);
+        send_ack(cmd->req, err == ESP_OK, err == ESP_OK ? NULL : "bad target");
+        return;
+    }
+    ESP_LOGW(TAG, "Unknown command '%s'", cmd->cmd ? cmd->cmd : "");
+    send_ack(cmd->req, false, "unknown command");
+}
+
+// Informe periódico de usb_netif_aq: se resume en el tema NET_STATS del bus (el último
+// valor queda disponible con app_bus_latest_aq) y se registra en el log.
+static void on_usb_stats(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    const usb_netif_stats_aq_t *st = (const usb_netif_stats_aq_t *)data;
+    uint32_t drops = 0;
+    for (int i = 0; i < USB_NETIF_DROP_COUNT_AQ; i++) {
+        drops += st->drops[i];
+    }
+    const app_bus_net_stats_aq_t ns = {
+        .rx_packets = st->rx_packets,
+        .rx_bytes = st->rx_bytes,
+        .tx_packets = st->tx_packets,
+        .tx_bytes = st->tx_bytes,
+        .drops = drops,
+    };
+    app_bus_pub_net_stats_aq(&ns);
+    ESP_LOGI(TAG, "usb stats: rx %lu pkt/%lu B, tx %lu pkt/%lu B, drops %lu, rxq hw %lu, rx paused %lu (%lu ms)",
+             (unsigned long)st->rx_packets, (unsigned long)st->rx_bytes,
+             (unsigned long)st->tx_packets, (unsigned long)st->tx_bytes,
+             (unsigned long)drops, (unsigned long)st->rx_queue_high_water,
+             (unsigned long)st->rx_pauses, (unsigned long)(st->rx_paused_us / 1000));
+    timesync_stats_aq_t ts;
+    if (timesync_get_stats_aq(&ts) == ESP_OK) {
+        ESP_LOGI(TAG, "timesync: flags 0x%lx, sof %ld ns (jitter %lu) drift %ld ppb, master %ld ns (jitter %lu, rtt %lu us)",
+                 (unsigned long)ts.flags, (long)ts.sof_offset_ns, (unsigned long)ts.sof_jitter_ns, (long)ts.drift_ppb,
+                 (long)ts.master_offset_ns, (unsigned long)ts.master_jitter_ns, (unsigned long)(ts.delay_ns / 1000));
+    }
+}
+
+// CTRL_UDP_OP_SET_AQ: corre en la tarea tcpip; solo una escritura sin lock al banco de señales
+static esp_err_t on_ctrl_set(uint16_t target, float value, void *ctx)
+{
+    if (target >= CONFIG_AQ_CTRL_SIGNALS) return ESP_ERR_INVALID_ARG;
+    return rules_set_input_aq(s_ctrl_sig[target], value);
+}
+
+static void rules_tick_cb(void *arg)
+{
+    rules_tick_aq();
+}
+
+// Reglas persistidas: se cargan antes de levantar el enlace para que el panel
+// funcione de forma autónoma aunque el MASTER no responda.
+static void rules_load_from_nvs(void)
+{
+    nvs_handle_t h;
+    size_t len = 0;
+    if (nvs_open(RULES_NVS_NS, NVS_READONLY, &h) != ESP_OK) {
+        ESP_LOGW(TAG, "No stored rules");
+        return;
+    }
+    if (nvs_get_blob(h, RULES_NVS_KEY, NULL, &len) == ESP_OK && len > 0) {
+        // Solo en la carga: el intérprete no asigna memoria
+        char *json = malloc(len);
+        if (json && nvs_get_blob(h, RULES_NVS_KEY, json, &len) == ESP_OK) {
+            rules_load_aq(json, len, NULL);
+        }
+        free(json);
+    }
+    nvs_close(h);
+}
+
+static esp_err_t rules_store_in_nvs(const void *json, size_t len)
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(RULES_NVS_NS, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+    err = nvs_set_blob(h, RULES_NVS_KEY, json, len);
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    return err;
+}
+
+// Hot reload desde el MASTER en <prefijo>rules. Solo se guarda si compila.
+static void on_rules(const char *topic, size_t topic_len, const uint8_t *payload, size_t len, void *ctx)
+{
+    rules_compile_err_aq_t cerr;
+    if (rules_load_aq((const char *)payload, len, &cerr) != ESP_OK) {
+        send_ack(0, false, cerr.msg);
+        return;
+    }
+    esp_err_t err = rules_store_in_nvs(payload, len);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Rules active but not persisted: %s", esp_err_to_name(err));
+    }
+    send_ack(0, err == ESP_OK, err == ESP_OK ? NULL : "not persisted");
+}
+
+// Heartbeat de aplicación del MASTER en <prefijo>master/heartbeat; el contenido no importa
+static void on_master_heartbeat(const char *topic, size_t topic_len, const uint8_t *payload, size_t len, void *ctx)
+{
+    usb_comms_master_heartbeat_aq();
+}
+
+static void publish_link(void)
+{
+    usb_comms_liveness_aq_t l;
+    usb_comms_get_liveness_aq(&l);
+    const app_bus_link_aq_t link = {
+        .link_up = l.link_up,
+        .master_alive = l.master_alive,
+        .safe_mode = l.safe_mode,
+        .cause = (uint8_t)l.cause,
+    };
+    app_bus_pub_link_aq(&link);
+}
+
+// Salidas del motor de reglas, en la tarea de esp_timer: DIRECT, los handlers de la
+// placa (GPIO, relés) corren aquí mismo sin pasar por ninguna cola
+static void on_rule_output(uint8_t signal, float value, void *ctx)
+{
+    const app_bus_rule_output_aq_t out = { .value = value, .signal = signal };
+    app_bus_pub_rule_output_aq(&out);
+}
+
+// Muestras de sensor publicadas por la placa: sin MASTER se guardan en tsdb_aq para el
+// replay. Corre en la tarea del bus (puede bloquear mientras tsdb_aq escribe en flash).
+static void on_sensor(app_topic_aq_t topic, const void *data, void *ctx)
+{
+    const app_bus_sensor_aq_t *s = (const app_bus_sensor_aq_t *)data;
+    if (!mqtt_service_is_connected_aq()) {
+        tsdb_append_aq(s->channel, s->ts_ms, s->value);
+    }
+}
+
+// SAFE MODE: las reglas locales siguen corriendo y ven la señal "safe_mode" para
+// llevar las salidas a su estado seguro sin depender del MASTER.
+static void on_safe_mode(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    const usb_comms_safe_mode_aq_t *ev = (const usb_comms_safe_mode_aq_t *)data;
+    bool enter = id == USB_COMMS_SAFE_MODE_ENTER;
+    rules_set_input_aq(s_sig_safe_mode, enter ? 1.0f : 0.0f);
+    if (!enter) {
+        // El MASTER responde: el firmware actual funciona, se cancela el rollback
+        ota_mark_valid_aq();
+    }
+    if (enter) {
+        ESP_LOGW(TAG, "SAFE MODE entered (cause %d, detected in %lu ms)", ev->cause, (unsigned long)ev->latency_ms);
+    } else {
+        ESP_LOGI(TAG, "SAFE MODE left after %lu ms", (unsigned long)ev->latency_ms);
+    }
+    publish_link();
+}
+
+// Backlog de tsdb_aq: un segmento por mensaje en <prefijo>tsdb, tal cual (binario).
+// QoS1: una vez en la ventana se reenvía tras reconectar, así que el segmento se libera.
+static esp_err_t publish_segment(const uint8_t *seg, size_t len, void *ctx)
+{
+    return mqtt_service_publish_aq(s_topic_tsdb, seg, len, 1, false);
+}
+
+static void tsdb_replay_task(void *arg)
+{
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // Las muestras de segmentos aún abiertos también son del corte
+        tsdb_seal_aq();
+        uint32_t total = 0, n = 0;
+        esp_err_t err;
+        do {
+            err = tsdb_replay_aq(publish_segment, NULL, UINT32_MAX, &n);
+            total += n;
+            // Ventana QoS1 llena: se espera a que lleguen PUBACK
+            if (err == ESP_ERR_NO_MEM) vTaskDelay(pdMS_TO_TICKS(20));
+        } while (err == ESP_ERR_NO_MEM && mqtt_service_is_connected_aq());
+        if (total || err != ESP_OK) {
+            ESP_LOGI(TAG, "tsdb replay: %lu segments (%s)", (unsigned long)total, esp_err_to_name(err));
+        }
+    }
+}
+
+static void on_mqtt_connected(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    xTaskNotifyGive(s_tsdb_task);
+}
+
+static void start_tsdb(void)
+{
+    ESP_ERROR_CHECK(tsdb_init_aq(CONFIG_AQ_TSDB_PARTITION));
+    s_topic_tsdb = mqtt_service_topic_aq("tsdb");
+    if (xTaskCreate(tsdb_replay_task, "tsdb_replay", 3072, NULL, 3, &s_tsdb_task) != pdPASS) {
+        ESP_LOGE(TAG, "Cannot create tsdb replay task");
+        return;
+    }
+    ESP_ERROR_CHECK(esp_event_handler_register(MQTT_SERVICE_EVENTS, MQTT_SERVICE_CONNECTED, on_mqtt_connected, NULL));
+}
+
+static void start_rules(void)
+{
+    ESP_ERROR_CHECK(rules_init_aq(on_rule_output, NULL));
+    rules_load_from_nvs();
+    // Se arranca en SAFE MODE hasta ver al MASTER
+    s_sig_safe_mode = rules_signal_aq("safe_mode");
+    rules_set_input_aq(s_sig_safe_mode, 1.0f);
+    for (int i = 0; i < CONFIG_AQ_CTRL_SIGNALS; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "ctrl_%d", i);
+        s_ctrl_sig[i] = rules_signal_aq(name);
+    }
+    const esp_timer_create_args_t args = {
+        .callback = rules_tick_cb,
+        .name = "rules_tick",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&args, &s_rules_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(s_rules_timer, (uint64_t)CONFIG_AQ_RULES_TICK_MS * 1000));
+}
+
+// Los pcb UDP se ligan a la netif USB, que lwIP solo numera al añadirla en el primer
+// montaje: se abren con el primer USB_NET_UP y siguen abiertos en las caídas siguientes
+static void on_link_up(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    static bool s_udp_started;
+    esp_netif_t *netif = NULL;
+    if (s_udp_started || usb_netif_get_esp_netif_aq(&netif) != ESP_OK) return;
+    s_udp_started = true;
+    // Vía rápida para comandos sensibles a la latencia; MQTT sigue aceptando "set"
+    if (ctrl_udp_start_aq(netif) != ESP_OK) {
+        ESP_LOGE(TAG, "Control channel not started");
+    }
+    // Base de tiempo común del hub; sin ella la telemetría sigue con el reloj local
+    if (timesync_start_aq(netif) != ESP_OK) {
+        ESP_LOGW(TAG, "Time sync not started");
+    }
+}
+
 void app_manager_start(void)
 {
     ESP_LOGI(TAG, "Starting App Manager");
 
+    // NVS guarda la última concesión DHCP del enlace USB (arranque rápido) y las reglas
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        err = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(err);
+
     ESP_ERROR_CHECK(esp_event_loop_create_default());
+    // Bus interno para los eventos frecuentes; esp_event queda para los gruesos
+    ESP_ERROR_CHECK(app_bus_start_aq());
+    ESP_ERROR_CHECK(esp_event_handler_register(USB_NET_EVENTS, USB_NET_STATS, on_usb_stats, NULL));
+    start_rules();
+    // Antes que el enlace: la telemetría se guarda aunque el MASTER no aparezca
+    start_tsdb();
+    ESP_ERROR_CHECK(app_bus_subscribe_aq(APP_TOPIC_SENSOR_AQ, on_sensor, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(USB_COMMS_EVENTS, ESP_EVENT_ANY_ID, on_safe_mode, NULL));
+    ESP_ERROR_CHECK(ctrl_udp_register_aq(CTRL_UDP_OP_SET_AQ, on_ctrl_set, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(USB_NET_EVENTS, USB_NET_UP, on_link_up, NULL));
+    ESP_ERROR_CHECK(usb_comms_liveness_start_aq());
     ESP_ERROR_CHECK(usb_comms_init_aq());
 
+    // Todo lo que depende del MASTER arranca aunque no esté: con el MASTER caído en el
+    // arranque, el heartbeat (salida de SAFE MODE) y MQTT_SERVICE_CONNECTED (backlog de
+    // tsdb) llegan cuando aparezca. mqtt_service_aq espera la IP y reconecta solo.
+    ESP_ERROR_CHECK(usb_netif_get_esp_netif_aq(&s_netif));
+    ESP_ERROR_CHECK(esp_event_handler_register(OTA_EVENTS, ESP_EVENT_ANY_ID, on_ota, NULL));
+    // Imagen recién actualizada: se confirma en el primer SAFE_MODE_EXIT o vuelve a la anterior
+    if (ota_verify_start_aq() != ESP_OK) {
+        ESP_LOGW(TAG, "OTA verify timer not started");
+    }
+    tlm_arena_init_aq(&s_cmd_arena, s_cmd_arena_buf, sizeof(s_cmd_arena_buf));
+    s_topic_ack = mqtt_service_topic_aq("ack");
+    ESP_ERROR_CHECK(mqtt_service_subscribe_aq("cmd", on_command, NULL));
+    ESP_ERROR_CHECK(mqtt_service_subscribe_aq("rules", on_rules, NULL));
+    ESP_ERROR_CHECK(mqtt_service_subscribe_aq("master/heartbeat", on_master_heartbeat, NULL));
+    ESP_ERROR_CHECK(mqtt_service_start_aq(s_netif));
+
     esp_ip4_addr_t ip = {0};
-    esp_err_t w = usb_comms_wait_link_aq(pdMS_TO_TICKS(CONFIG_AQ_COMMS_WAIT_MS), &ip);
-    if (w == ESP_OK) {
-        ESP_LOGI(TAG, "USB link ready, starting MQTT");
-        // ESP_ERROR_CHECK(mqtt_service_start_aq()); // Uncomment when mqtt_service_aq is available
+    if (usb_comms_wait_link_aq(pdMS_TO_TICKS(CONFIG_AQ_COMMS_WAIT_MS), &ip) == ESP_OK) {
+        ESP_LOGI(TAG, "USB link ready");
     } else {
-        ESP_LOGE(TAG, "USB link timeout, no IP");
+        ESP_LOGW(TAG, "USB link timeout, no IP yet; services start when the link comes up");
     }
+    publish_link();
 }
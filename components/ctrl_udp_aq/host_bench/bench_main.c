@@ -0,0 +1,412 @@
+// Benchmark de host (Linux) del canal de control de ctrl_udp_aq.
+//
+// Compila ctrl_proto_aq.c real detrás de un socket UDP POSIX: un hilo hace de tarea
+// tcpip del panel (recvfrom -> ctrl_proto_handle_aq -> sendto del mismo buffer) y el hilo
+// principal hace de MASTER, un comando en vuelo cada vez, midiendo el ida y vuelta.
+// Compara con el camino de los comandos MQTT: MASTER -> broker -> tarea del servicio MQTT
+// del panel -> JSON -> handler -> ack JSON -> broker -> MASTER, todo por TCP en loopback
+// con TCP_NODELAY (como mqtt_service_aq). Antes comprueba la ventana de seq y los errores.
+//
+// Con -H ip hace solo de MASTER contra un panel real (CONFIG_AQ_CTRL_UDP_PORT).
+// -C solo comprueba el protocolo, sin sockets ni medidas: es lo que ejecuta ctest.
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "ctrl_proto_aq.h"
+#include "ctrl_udp_aq.h"
+
+#define OUTPUTS 8
+
+static uint32_t s_cmds = 20000;
+static const char *s_panel_host;
+static atomic_bool s_stop;
+static float s_out[OUTPUTS];
+static uint32_t s_set_calls;
+static int s_failures;
+
+static int64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// El "actuador": una escritura, como on_ctrl_set de app_manager_aq
+static esp_err_t set_output(uint16_t target, float value, void *ctx) {
+    s_set_calls++;
+    if (target >= OUTPUTS) return ESP_ERR_INVALID_ARG;
+    s_out[target] = value;
+    return ESP_OK;
+}
+
+static void check(bool ok, const char *what) {
+    if (!ok) {
+        fprintf(stderr, "check failed: %s\n", what);
+        s_failures++;
+    }
+}
+
+static ctrl_udp_frame_aq_t frame(uint8_t op, uint32_t seq, uint16_t target, float value, uint8_t flags) {
+    ctrl_udp_frame_aq_t f = {
+        .magic = CTRL_UDP_MAGIC_AQ, .version = CTRL_UDP_VERSION_AQ, .op = op,
+        .seq = seq, .target = target, .flags = flags, .value = value,
+    };
+    return f;
+}
+
+// Devuelve el status del ack, o -1 si no hubo respuesta
+static int exchange(ctrl_proto_aq_t *c, ctrl_udp_frame_aq_t *f, uint64_t peer) {
+    if (!ctrl_proto_handle_aq(c, (uint8_t *)f, sizeof(*f), peer, now_us())) return -1;
+    return f->status;
+}
+
+//--------------------------------------------------------------------+
+// Casos de protocolo, sin sockets
+//--------------------------------------------------------------------+
+static void run_checks(void) {
+    ctrl_proto_aq_t c;
+    ctrl_proto_init_aq(&c, now_us);
+    check(ctrl_proto_register_aq(&c, CTRL_UDP_OP_PING_AQ, set_output, NULL) == ESP_ERR_INVALID_ARG, "ping not registrable");
+    check(ctrl_proto_register_aq(&c, CTRL_UDP_MAX_OPS_AQ, set_output, NULL) == ESP_ERR_INVALID_ARG, "op range");
+    ESP_ERROR_CHECK(ctrl_proto_register_aq(&c, CTRL_UDP_OP_SET_AQ, set_output, NULL));
+    const uint64_t peer_a = 1, peer_b = 2;
+    s_set_calls = 0;
+
+    ctrl_udp_frame_aq_t f = frame(CTRL_UDP_OP_SET_AQ, 100, 3, 1.5f, CTRL_UDP_FLAG_SYNC_AQ);
+    check(exchange(&c, &f, peer_a) == CTRL_UDP_OK_AQ && s_out[3] == 1.5f, "first command executes");
+    check(f.op == (CTRL_UDP_OP_SET_AQ | CTRL_UDP_ACK_AQ) && f.seq == 100 && f.flags == 0, "ack echoes op and seq");
+
+    // Retransmisión: mismo status, marcada, sin volver a ejecutar
+    f = frame(CTRL_UDP_OP_SET_AQ, 100, 3, 9.0f, 0);
+    check(exchange(&c, &f, peer_a) == CTRL_UDP_OK_AQ && (f.flags & CTRL_UDP_FLAG_DUP_AQ), "duplicate acked");
+    check(s_set_calls == 1 && s_out[3] == 1.5f, "duplicate not re-executed");
+
+    f = frame(CTRL_UDP_OP_SET_AQ, 99, 3, 9.0f, 0);
+    check(exchange(&c, &f, peer_a) == CTRL_UDP_STALE_AQ && s_out[3] == 1.5f, "stale rejected");
+
+    // Salto hacia delante: se aceptan pérdidas entre medias
+    f = frame(CTRL_UDP_OP_SET_AQ, 105, 20, 1.0f, 0);
+    check(exchange(&c, &f, peer_a) == CTRL_UDP_FAILED_AQ && c.stats.failed == 1, "handler error reported");
+    f = frame(CTRL_UDP_OP_SET_AQ, 105, 20, 1.0f, 0);
+    check(exchange(&c, &f, peer_a) == CTRL_UDP_FAILED_AQ && s_set_calls == 2, "duplicate keeps failed status");
+
+    f = frame(7, 106, 0, 0.0f, 0);
+    check(exchange(&c, &f, peer_a) == CTRL_UDP_BAD_OP_AQ, "unregistered op");
+    f = frame(CTRL_UDP_OP_PING_AQ, 107, 0, 0.0f, 0);
+    check(exchange(&c, &f, peer_a) == CTRL_UDP_OK_AQ && s_set_calls == 2, "ping");
+
+    // Nueva sesión del MASTER (reinicio): SYNC o cambio de emisor reabren la ventana
+    f = frame(CTRL_UDP_OP_SET_AQ, 1, 4, 2.0f, CTRL_UDP_FLAG_SYNC_AQ);
+    check(exchange(&c, &f, peer_a) == CTRL_UDP_OK_AQ && s_out[4] == 2.0f, "sync resets window");
+    f = frame(CTRL_UDP_OP_SET_AQ, 0, 5, 3.0f, 0);
+    check(exchange(&c, &f, peer_b) == CTRL_UDP_OK_AQ && s_out[5] == 3.0f, "new peer resets window");
+
+    // Sin respuesta: tamaño, magic, acks rebotados
+    uint32_t malformed = c.stats.malformed;
+    f = frame(CTRL_UDP_OP_SET_AQ, 2, 4, 0.0f, 0);
+    check(!ctrl_proto_handle_aq(&c, (uint8_t *)&f, sizeof(f) - 1, peer_b, now_us()), "short frame ignored");
+    f.magic = 0x1234;
+    check(!ctrl_proto_handle_aq(&c, (uint8_t *)&f, sizeof(f), peer_b, now_us()), "bad magic ignored");
+    f = frame(CTRL_UDP_OP_SET_AQ | CTRL_UDP_ACK_AQ, 2, 4, 0.0f, 0);
+    check(!ctrl_proto_handle_aq(&c, (uint8_t *)&f, sizeof(f), peer_b, now_us()), "ack ignored");
+    f = frame(CTRL_UDP_OP_SET_AQ, 2, 4, 0.0f, 0);
+    f.version = 9;
+    check(exchange(&c, &f, peer_b) == CTRL_UDP_BAD_VERSION_AQ && f.version == CTRL_UDP_VERSION_AQ, "bad version answered");
+    check(c.stats.malformed == malformed + 4 && s_out[4] == 2.0f, "malformed counted, nothing executed");
+    check(c.stats.duplicates == 2 && c.stats.stale == 1 && c.stats.bad_op == 1, "stats");
+    printf("RESULT checks=%s\n", s_failures ? "FAIL" : "ok");
+}
+
+//--------------------------------------------------------------------+
+// Latencias
+//--------------------------------------------------------------------+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void report(const char *path, uint32_t *rtt, uint32_t n, uint32_t lost, uint64_t handler_sum) {
+    if (n == 0) {
+        printf("RESULT path=%s cmds=0 lost=%u\n", path, lost);
+        return;
+    }
+    qsort(rtt, n, sizeof(*rtt), cmp_u32);
+    printf("RESULT path=%s cmds=%u lost=%u rtt_p50_us=%u rtt_p99_us=%u rtt_max_us=%u handler_avg_us=%.2f\n",
+           path, n, lost, rtt[n / 2], rtt[(uint64_t)n * 99 / 100], rtt[n - 1], (double)handler_sum / n);
+}
+
+// Tarea tcpip simulada: el ack se escribe sobre el buffer recibido y sale tal cual
+static void *udp_panel_thread(void *arg) {
+    int fd = *(int *)arg;
+    ctrl_proto_aq_t c;
+    ctrl_proto_init_aq(&c, now_us);
+    ESP_ERROR_CHECK(ctrl_proto_register_aq(&c, CTRL_UDP_OP_SET_AQ, set_output, NULL));
+    uint8_t buf[64];
+    while (!atomic_load(&s_stop)) {
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t n = recvfrom(fd, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len);
+        if (n < 0) continue;  // timeout: revisa s_stop
+        int64_t t_rx = now_us();
+        uint64_t peer = ((uint64_t)ntohl(from.sin_addr.s_addr) << 16) | ntohs(from.sin_port);
+        if (ctrl_proto_handle_aq(&c, buf, (size_t)n, peer, t_rx)) {
+            sendto(fd, buf, CTRL_UDP_FRAME_LEN_AQ, 0, (struct sockaddr *)&from, from_len);
+        }
+    }
+    return NULL;
+}
+
+static void set_rcvtimeo(int fd, int ms) {
+    struct timeval tv = { .tv_sec = ms / 1000, .tv_usec = (ms % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+// MASTER UDP: un comando en vuelo, reintento tras 200 ms con la misma seq
+static void udp_master(const struct sockaddr_in *panel, const char *path) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    set_rcvtimeo(fd, 200);
+    connect(fd, (const struct sockaddr *)panel, sizeof(*panel));
+    uint32_t *rtt = calloc(s_cmds, sizeof(*rtt));
+    uint32_t n = 0, lost = 0;
+    uint64_t handler_sum = 0;
+    uint32_t seq0 = (uint32_t)now_us();
+    for (uint32_t i = 0; i < s_cmds; i++) {
+        ctrl_udp_frame_aq_t f = frame(CTRL_UDP_OP_SET_AQ, seq0 + i, i % OUTPUTS, (float)i, i == 0 ? CTRL_UDP_FLAG_SYNC_AQ : 0);
+        int64_t t0 = now_us();
+        bool acked = false;
+        for (int attempt = 0; attempt < 3 && !acked; attempt++) {
+            send(fd, &f, sizeof(f), 0);
+            ctrl_udp_frame_aq_t ack;
+            while (recv(fd, &ack, sizeof(ack), 0) == sizeof(ack)) {
+                if (ack.seq == f.seq && ack.op == (f.op | CTRL_UDP_ACK_AQ)) {
+                    handler_sum += ack.handler_us;
+                    acked = true;
+                    break;
+                }
+            }
+        }
+        if (acked) {
+            rtt[n++] = (uint32_t)(now_us() - t0);
+        } else {
+            lost++;
+        }
+    }
+    report(path, rtt, n, lost, handler_sum);
+    free(rtt);
+    close(fd);
+}
+
+static void run_udp(void) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        exit(1);
+    }
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (struct sockaddr *)&addr, &len);
+    set_rcvtimeo(fd, 50);
+    atomic_store(&s_stop, false);
+    pthread_t th;
+    pthread_create(&th, NULL, udp_panel_thread, &fd);
+    udp_master(&addr, "udp_raw");
+    atomic_store(&s_stop, true);
+    pthread_join(th, NULL);
+    close(fd);
+}
+
+//--------------------------------------------------------------------+
+// Camino MQTT: broker que reenvía mensajes [u16 len][topic\0payload] entre dos clientes
+//--------------------------------------------------------------------+
+static bool recv_all(int fd, void *buf, size_t len) {
+    uint8_t *p = buf;
+    while (len) {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n <= 0) return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool recv_msg(int fd, char *buf, size_t cap, uint16_t *len) {
+    if (!recv_all(fd, len, sizeof(*len)) || *len >= cap) return false;
+    if (!recv_all(fd, buf, *len)) return false;
+    buf[*len] = '\0';
+    return true;
+}
+
+static void send_msg(int fd, const char *topic, const char *payload) {
+    char buf[256];
+    size_t tl = strlen(topic) + 1, pl = strlen(payload);
+    uint16_t len = (uint16_t)(tl + pl);
+    memcpy(buf, &len, sizeof(len));
+    memcpy(buf + 2, topic, tl);
+    memcpy(buf + 2 + tl, payload, pl);
+    send(fd, buf, 2 + len, MSG_NOSIGNAL);
+}
+
+static int tcp_connect(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct sockaddr_in a = { .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    if (connect(fd, (struct sockaddr *)&a, sizeof(a)) < 0) {
+        perror("connect");
+        exit(1);
+    }
+    return fd;
+}
+
+typedef struct {
+    int listen_fd;
+    int master_fd;   // extremos del broker
+    int panel_fd;
+} broker_aq_t;
+
+// cmd: MASTER -> panel; ack: panel -> MASTER
+static void *broker_thread(void *arg) {
+    broker_aq_t *b = arg;
+    int one = 1;
+    b->master_fd = accept(b->listen_fd, NULL, NULL);
+    b->panel_fd = accept(b->listen_fd, NULL, NULL);
+    setsockopt(b->master_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(b->panel_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    char buf[256];
+    uint16_t len;
+    for (;;) {
+        fd_set rd;
+        FD_ZERO(&rd);
+        FD_SET(b->master_fd, &rd);
+        FD_SET(b->panel_fd, &rd);
+        int maxfd = b->master_fd > b->panel_fd ? b->master_fd : b->panel_fd;
+        if (select(maxfd + 1, &rd, NULL, NULL, NULL) <= 0) break;
+        int from = FD_ISSET(b->master_fd, &rd) ? b->master_fd : b->panel_fd;
+        int to = from == b->master_fd ? b->panel_fd : b->master_fd;
+        if (!recv_msg(from, buf, sizeof(buf), &len)) break;
+        send_msg(to, buf, buf + strlen(buf) + 1);
+    }
+    return NULL;
+}
+
+// Servicio MQTT del panel: parsea el comando JSON, ejecuta y publica el ack
+static void *mqtt_panel_thread(void *arg) {
+    int fd = *(int *)arg;
+    char buf[256];
+    uint16_t len;
+    while (recv_msg(fd, buf, sizeof(buf), &len)) {
+        int64_t t_rx = now_us();
+        const char *json = buf + strlen(buf) + 1;
+        unsigned long req = 0;
+        unsigned target = 0;
+        float value = 0.0f;
+        const char *p;
+        if ((p = strstr(json, "\"req\":")) != NULL) req = strtoul(p + 6, NULL, 10);
+        if ((p = strstr(json, "\"target\":\"ctrl_")) != NULL) target = (unsigned)strtoul(p + 15, NULL, 10);
+        if ((p = strstr(json, "\"value\":")) != NULL) value = strtof(p + 8, NULL);
+        esp_err_t err = set_output((uint16_t)target, value, NULL);
+        char ack[160];
+        snprintf(ack, sizeof(ack), "{\"type\":\"ack\",\"id\":\"p1\",\"req\":%lu,\"ok\":%s,\"handler_us\":%lld}",
+                 req, err == ESP_OK ? "true" : "false", (long long)(now_us() - t_rx));
+        send_msg(fd, "aq/p1/ack", ack);
+    }
+    return NULL;
+}
+
+static void run_mqtt(void) {
+    broker_aq_t b = { .listen_fd = socket(AF_INET, SOCK_STREAM, 0) };
+    int one = 1;
+    setsockopt(b.listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    bind(b.listen_fd, (struct sockaddr *)&addr, sizeof(addr));
+    listen(b.listen_fd, 2);
+    socklen_t alen = sizeof(addr);
+    getsockname(b.listen_fd, (struct sockaddr *)&addr, &alen);
+    uint16_t port = ntohs(addr.sin_port);
+
+    pthread_t broker, panel;
+    pthread_create(&broker, NULL, broker_thread, &b);
+    int master = tcp_connect(port);
+    usleep(10000);  // el broker distingue a los clientes por orden de conexión
+    int panel_fd = tcp_connect(port);
+    pthread_create(&panel, NULL, mqtt_panel_thread, &panel_fd);
+
+    uint32_t *rtt = calloc(s_cmds, sizeof(*rtt));
+    uint64_t handler_sum = 0;
+    uint32_t n = 0;
+    char buf[256];
+    uint16_t len;
+    for (uint32_t i = 0; i < s_cmds; i++) {
+        char cmd[160];
+        snprintf(cmd, sizeof(cmd), "{\"type\":\"command\",\"req\":%u,\"cmd\":\"set\",\"target\":\"ctrl_%u\",\"value\":%u}",
+                 i, i % OUTPUTS, i);
+        int64_t t0 = now_us();
+        send_msg(master, "aq/p1/cmd", cmd);
+        if (!recv_msg(master, buf, sizeof(buf), &len)) break;
+        rtt[n++] = (uint32_t)(now_us() - t0);
+        const char *h = strstr(buf + strlen(buf) + 1, "\"handler_us\":");
+        if (h) handler_sum += strtoul(h + 13, NULL, 10);
+    }
+    report("mqtt_json", rtt, n, s_cmds - n, handler_sum);
+    free(rtt);
+
+    shutdown(master, SHUT_RDWR);
+    shutdown(panel_fd, SHUT_RDWR);
+    pthread_join(broker, NULL);
+    pthread_join(panel, NULL);
+    close(b.master_fd);
+    close(b.panel_fd);
+    close(master);
+    close(panel_fd);
+    close(b.listen_fd);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-n commands] [-H panel_ip] [-C]\n"
+                    "  -H: only act as MASTER against a real panel on UDP %d\n"
+                    "  -C: only run the protocol checks (ctest)\n",
+            prog, CONFIG_AQ_CTRL_UDP_PORT);
+}
+
+int main(int argc, char **argv) {
+    bool check_only = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:H:Ch")) != -1) {
+        switch (opt) {
+        case 'n': s_cmds = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'H': s_panel_host = optarg; break;
+        case 'C': check_only = true; break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (s_cmds == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (s_panel_host) {
+        struct sockaddr_in panel = { .sin_family = AF_INET, .sin_port = htons(CONFIG_AQ_CTRL_UDP_PORT) };
+        if (inet_pton(AF_INET, s_panel_host, &panel.sin_addr) != 1) {
+            usage(argv[0]);
+            return 2;
+        }
+        udp_master(&panel, "udp_panel");
+        return 0;
+    }
+
+    run_checks();
+    if (check_only) return s_failures ? 1 : 0;
+    run_udp();
+    run_mqtt();
+    return s_failures ? 1 : 0;
+}
@@ -0,0 +1,3 @@
+#pragma once
+// Valores por defecto del Kconfig de ctrl_udp_aq
+#define CONFIG_AQ_CTRL_UDP_PORT 5516
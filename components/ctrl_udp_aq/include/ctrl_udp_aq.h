@@ -0,0 +1,88 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_netif.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Canal de control rápido MASTER -> panel: tramas UDP binarias de tamaño fijo sobre la
+// API raw de lwIP, ligadas a la netif USB. El comando se ejecuta en el callback de
+// recepción, dentro de la tarea tcpip, y el ack sale en el mismo pbuf antes de volver:
+// sin socket, sin despertar otra tarea y sin parsear JSON. Protocolo: README.md.
+
+#define CTRL_UDP_MAGIC_AQ     0x4351  // "QC" en little-endian
+#define CTRL_UDP_VERSION_AQ   1
+#define CTRL_UDP_FRAME_LEN_AQ 16
+#define CTRL_UDP_MAX_OPS_AQ   16
+#define CTRL_UDP_LAT_BUCKETS_AQ 16
+
+// Operaciones; las libres (< CTRL_UDP_MAX_OPS_AQ) las registra la aplicación
+#define CTRL_UDP_OP_PING_AQ   0   // sin handler: solo ack, mide el ida y vuelta
+#define CTRL_UDP_OP_SET_AQ    1   // salida `target` al valor `value`
+
+// op del ack = op del comando | CTRL_UDP_ACK_AQ
+#define CTRL_UDP_ACK_AQ       0x80
+
+// flags del comando
+#define CTRL_UDP_FLAG_SYNC_AQ 0x01  // primer comando de una sesión del MASTER: reinicia la ventana de seq
+// flags del ack
+#define CTRL_UDP_FLAG_DUP_AQ  0x01  // retransmisión ya ejecutada: status es el de la primera vez
+
+typedef enum {
+    CTRL_UDP_OK_AQ = 0,
+    CTRL_UDP_FAILED_AQ,        // el handler devolvió error
+    CTRL_UDP_BAD_OP_AQ,        // operación sin handler
+    CTRL_UDP_STALE_AQ,         // seq anterior a la última ejecutada: no se ejecuta
+    CTRL_UDP_BAD_VERSION_AQ,
+} ctrl_udp_status_aq_t;
+
+// Trama de 16 B, little-endian, igual en los dos sentidos
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t  version;
+    uint8_t  op;          // ack: op | CTRL_UDP_ACK_AQ
+    uint32_t seq;         // creciente por sesión; el ack lleva el del comando
+    uint16_t target;      // salida / canal de la operación
+    uint8_t  status;      // ack: ctrl_udp_status_aq_t
+    uint8_t  flags;       // CTRL_UDP_FLAG_*
+    union {
+        float    value;       // comando
+        uint32_t handler_us;  // ack: recepción -> handler terminado, en el panel
+    };
+} ctrl_udp_frame_aq_t;
+
+_Static_assert(sizeof(ctrl_udp_frame_aq_t) == CTRL_UDP_FRAME_LEN_AQ, "ctrl frame layout");
+
+// Corre en la tarea tcpip: tiene que ser corto y no bloquear (escribir un GPIO, un
+// registro, una variable atómica). ESP_OK -> CTRL_UDP_OK_AQ; otro -> CTRL_UDP_FAILED_AQ.
+typedef esp_err_t (*ctrl_udp_handler_aq_t)(uint16_t target, float value, void *ctx);
+
+typedef struct {
+    uint32_t rx;               // tramas recibidas
+    uint32_t acks;
+    uint32_t executed;         // handlers ejecutados (OK o FAILED)
+    uint32_t duplicates;       // retransmisiones contestadas sin volver a ejecutar
+    uint32_t stale;
+    uint32_t malformed;        // tamaño, magic o versión: sin ack salvo versión
+    uint32_t bad_op;
+    uint32_t failed;
+    uint32_t last_seq;
+    uint32_t handler_max_us;
+    uint32_t handler_us[CTRL_UDP_LAT_BUCKETS_AQ];  // bucket i = [2^i, 2^(i+1)) µs
+} ctrl_udp_stats_aq_t;
+
+// Antes de ctrl_udp_start_aq. ESP_ERR_INVALID_STATE con el canal en marcha.
+esp_err_t ctrl_udp_register_aq(uint8_t op, ctrl_udp_handler_aq_t fn, void *ctx);
+// Abre el pcb UDP en CONFIG_AQ_CTRL_UDP_PORT ligado a la netif (la de
+// usb_netif_get_esp_netif_aq). Solo acepta tramas que entren por ella.
+esp_err_t ctrl_udp_start_aq(esp_netif_t *netif);
+esp_err_t ctrl_udp_stop_aq(void);
+// Copia tomada en la tarea tcpip: coherente con los comandos en curso
+esp_err_t ctrl_udp_get_stats_aq(ctrl_udp_stats_aq_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,96 @@
+#include "ctrl_proto_aq.h"
+#include <string.h>
+
+void ctrl_proto_init_aq(ctrl_proto_aq_t *c, int64_t (*now_us)(void)) {
+    memset(c, 0, sizeof(*c));
+    c->now_us = now_us;
+}
+
+esp_err_t ctrl_proto_register_aq(ctrl_proto_aq_t *c, uint8_t op, ctrl_udp_handler_aq_t fn, void *ctx) {
+    if (op >= CTRL_UDP_MAX_OPS_AQ || op == CTRL_UDP_OP_PING_AQ) return ESP_ERR_INVALID_ARG;
+    c->fn[op] = fn;
+    c->ctx[op] = ctx;
+    return ESP_OK;
+}
+
+static void record_latency(ctrl_udp_stats_aq_t *st, uint32_t us) {
+    int b = us ? 31 - __builtin_clz(us) : 0;
+    if (b >= CTRL_UDP_LAT_BUCKETS_AQ) b = CTRL_UDP_LAT_BUCKETS_AQ - 1;
+    st->handler_us[b]++;
+    if (us > st->handler_max_us) st->handler_max_us = us;
+}
+
+// Ventana de seq: se ejecuta lo posterior a la última ejecutada; la misma seq es una
+// retransmisión (el ack se perdió) y se contesta sin repetir la acción
+static uint8_t execute(ctrl_proto_aq_t *c, const ctrl_udp_frame_aq_t *f, uint64_t peer, int64_t t_rx_us,
+                       uint8_t *flags, uint32_t *handler_us) {
+    bool fresh = !c->synced || peer != c->peer || (f->flags & CTRL_UDP_FLAG_SYNC_AQ);
+    int32_t d = (int32_t)(f->seq - c->last_seq);
+    if (!fresh && d == 0) {
+        c->stats.duplicates++;
+        *flags = CTRL_UDP_FLAG_DUP_AQ;
+        return c->last_status;
+    }
+    if (!fresh && d < 0) {
+        c->stats.stale++;
+        return CTRL_UDP_STALE_AQ;
+    }
+
+    uint8_t status;
+    if (f->op >= CTRL_UDP_MAX_OPS_AQ || (f->op != CTRL_UDP_OP_PING_AQ && c->fn[f->op] == NULL)) {
+        c->stats.bad_op++;
+        status = CTRL_UDP_BAD_OP_AQ;
+    } else {
+        status = CTRL_UDP_OK_AQ;
+        if (f->op != CTRL_UDP_OP_PING_AQ) {
+            c->stats.executed++;
+            if (c->fn[f->op](f->target, f->value, c->ctx[f->op]) != ESP_OK) {
+                c->stats.failed++;
+                status = CTRL_UDP_FAILED_AQ;
+            }
+        }
+        int64_t dt = c->now_us() - t_rx_us;
+        *handler_us = dt > 0 ? (uint32_t)dt : 0;
+        record_latency(&c->stats, *handler_us);
+    }
+    c->synced = true;
+    c->peer = peer;
+    c->last_seq = f->seq;
+    c->last_status = status;
+    c->stats.last_seq = f->seq;
+    return status;
+}
+
+bool ctrl_proto_handle_aq(ctrl_proto_aq_t *c, uint8_t *frame, size_t len, uint64_t peer, int64_t t_rx_us) {
+    c->stats.rx++;
+    ctrl_udp_frame_aq_t f;
+    if (len != sizeof(f)) {
+        c->stats.malformed++;
+        return false;
+    }
+    memcpy(&f, frame, sizeof(f));
+    // Un ack rebotado o ruido en el puerto no merece respuesta
+    if (f.magic != CTRL_UDP_MAGIC_AQ || (f.op & CTRL_UDP_ACK_AQ)) {
+        c->stats.malformed++;
+        return false;
+    }
+
+    uint8_t flags = 0;
+    uint32_t handler_us = 0;
+    uint8_t status;
+    if (f.version != CTRL_UDP_VERSION_AQ) {
+        c->stats.malformed++;
+        status = CTRL_UDP_BAD_VERSION_AQ;  // se contesta para que el MASTER lo vea
+    } else {
+        status = execute(c, &f, peer, t_rx_us, &flags, &handler_us);
+    }
+
+    f.version = CTRL_UDP_VERSION_AQ;
+    f.op |= CTRL_UDP_ACK_AQ;
+    f.status = status;
+    f.flags = flags;
+    f.handler_us = handler_us;
+    memcpy(frame, &f, sizeof(f));
+    c->stats.acks++;
+    return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ctrl_udp_aq.h"
+
+// Núcleo del canal de control: validación, ventana de seq, despacho y ack en el mismo
+// buffer. C puro y de un solo hilo (la tarea tcpip en el panel) para que el benchmark de
+// host lo ejecute detrás de un socket POSIX.
+
+typedef struct {
+    ctrl_udp_handler_aq_t fn[CTRL_UDP_MAX_OPS_AQ];
+    void *ctx[CTRL_UDP_MAX_OPS_AQ];
+    int64_t (*now_us)(void);
+    // Un MASTER: la ventana se reinicia si cambia el emisor o llega CTRL_UDP_FLAG_SYNC_AQ
+    uint64_t peer;
+    bool synced;
+    uint32_t last_seq;
+    uint8_t last_status;
+    ctrl_udp_stats_aq_t stats;
+} ctrl_proto_aq_t;
+
+void ctrl_proto_init_aq(ctrl_proto_aq_t *c, int64_t (*now_us)(void));
+esp_err_t ctrl_proto_register_aq(ctrl_proto_aq_t *c, uint8_t op, ctrl_udp_handler_aq_t fn, void *ctx);
+
+// frame: len bytes recibidos de peer (IP y puerto). true si hay que contestar: el ack
+// ya está escrito sobre frame (CTRL_UDP_FRAME_LEN_AQ bytes). t_rx_us: llegada de la trama.
+bool ctrl_proto_handle_aq(ctrl_proto_aq_t *c, uint8_t *frame, size_t len, uint64_t peer, int64_t t_rx_us);
@@ -0,0 +1,106 @@
+#include "ctrl_udp_aq.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_netif_net_stack.h"
+#include "esp_timer.h"
+#include "lwip/pbuf.h"
+#include "lwip/udp.h"
+#include "sdkconfig.h"
+#include "ctrl_proto_aq.h"
+
+static const char *TAG = "ctrl_udp_aq";
+
+// Todo el estado lo toca solo la tarea tcpip (callbacks de lwIP y esp_netif_tcpip_exec)
+static ctrl_proto_aq_t s_proto;
+static struct udp_pcb *s_pcb;
+static bool s_proto_ready;
+
+static int64_t now_us(void) {
+    return esp_timer_get_time();
+}
+
+// El ack sale en el mismo pbuf del comando: sin reservas en la ruta del comando. Si el
+// pbuf no tiene hueco para las cabeceras, udp_sendto encadena uno propio.
+static void ctrl_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    int64_t t_rx = esp_timer_get_time();
+    uint8_t copy[CTRL_UDP_FRAME_LEN_AQ];
+    ip_addr_t dst;
+    ip_addr_copy(dst, *addr);  // addr puede apuntar a cabeceras que el envío sobrescribe
+    uint64_t peer = ((uint64_t)ip4_addr_get_u32(ip_2_ip4(&dst)) << 16) | port;
+
+    // Trama de 16 B: casi siempre contigua; si llegó troceada se trabaja sobre una copia
+    bool contiguous = p->len == p->tot_len;
+    uint8_t *frame = contiguous ? (uint8_t *)p->payload : copy;
+    if (!contiguous && p->tot_len == sizeof(copy)) {
+        pbuf_copy_partial(p, copy, sizeof(copy), 0);
+    }
+    if (ctrl_proto_handle_aq(&s_proto, frame, p->tot_len, peer, t_rx)) {
+        if (!contiguous) pbuf_take(p, copy, sizeof(copy));
+        udp_sendto(pcb, p, &dst, port);
+    }
+    pbuf_free(p);
+}
+
+static esp_err_t ctrl_open(void *ctx) {
+    struct netif *lwip_netif = esp_netif_get_netif_impl((esp_netif_t *)ctx);
+    if (lwip_netif == NULL) return ESP_ERR_INVALID_STATE;
+    struct udp_pcb *pcb = udp_new_ip_type(IPADDR_TYPE_V4);
+    if (pcb == NULL) return ESP_ERR_NO_MEM;
+    if (udp_bind(pcb, IP4_ADDR_ANY, CONFIG_AQ_CTRL_UDP_PORT) != ERR_OK) {
+        udp_remove(pcb);
+        return ESP_FAIL;
+    }
+    // Solo la netif USB: el mismo puerto en otra interfaz no llega aquí
+    udp_bind_netif(pcb, lwip_netif);
+    udp_recv(pcb, ctrl_recv, NULL);
+    s_pcb = pcb;
+    return ESP_OK;
+}
+
+static esp_err_t ctrl_close(void *ctx) {
+    if (s_pcb) {
+        udp_remove(s_pcb);
+        s_pcb = NULL;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t ctrl_copy_stats(void *ctx) {
+    *(ctrl_udp_stats_aq_t *)ctx = s_proto.stats;
+    return ESP_OK;
+}
+
+esp_err_t ctrl_udp_register_aq(uint8_t op, ctrl_udp_handler_aq_t fn, void *ctx) {
+    if (s_pcb) return ESP_ERR_INVALID_STATE;
+    if (!s_proto_ready) {
+        ctrl_proto_init_aq(&s_proto, now_us);
+        s_proto_ready = true;
+    }
+    return ctrl_proto_register_aq(&s_proto, op, fn, ctx);
+}
+
+esp_err_t ctrl_udp_start_aq(esp_netif_t *netif) {
+    if (netif == NULL) return ESP_ERR_INVALID_ARG;
+    if (s_pcb) return ESP_ERR_INVALID_STATE;
+    if (!s_proto_ready) {
+        ctrl_proto_init_aq(&s_proto, now_us);
+        s_proto_ready = true;
+    }
+    esp_err_t err = esp_netif_tcpip_exec(ctrl_open, netif);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "UDP %d not opened: %s", CONFIG_AQ_CTRL_UDP_PORT, esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "Control channel on UDP %d", CONFIG_AQ_CTRL_UDP_PORT);
+    return ESP_OK;
+}
+
+esp_err_t ctrl_udp_stop_aq(void) {
+    return esp_netif_tcpip_exec(ctrl_close, NULL);
+}
+
+esp_err_t ctrl_udp_get_stats_aq(ctrl_udp_stats_aq_t *out) {
+    if (out == NULL) return ESP_ERR_INVALID_ARG;
+    if (!s_proto_ready) return ESP_ERR_INVALID_STATE;
+    return esp_netif_tcpip_exec(ctrl_copy_stats, out);
+}
@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+"""Envía comandos al canal de control UDP de ctrl_udp_aq y mide el ida y vuelta.
+
+Uso (en el MASTER, con la IP del panel en la red USB):
+    python components/ctrl_udp_aq/tools/ctrl_send.py 192.168.7.2                   # 1000 SET, percentiles
+    python components/ctrl_udp_aq/tools/ctrl_send.py 192.168.7.2 --op ping -n 200
+    python components/ctrl_udp_aq/tools/ctrl_send.py 192.168.7.2 --mqtt 192.168.7.1 --panel p1
+
+--mqtt mide el mismo comando por la vía MQTT ("set" en aq/<panel>/cmd, ack en
+aq/<panel>/ack; necesita paho-mqtt) para comparar. Trama de 16 B little-endian: u16 magic
+= 0x4351, u8 version = 1, u8 op, u32 seq, u16 target, u8 status, u8 flags, f32 value
+(en el ack: u32 handler_us). El primer comando lleva SYNC para abrir una sesión nueva.
+"""
+import argparse
+import json
+import socket
+import struct
+import sys
+import threading
+import time
+
+FRAME = struct.Struct('<HBBIHBBf')
+ACK = struct.Struct('<HBBIHBBI')
+MAGIC = 0x4351
+VERSION = 1
+OPS = {'ping': 0, 'set': 1}
+ACK_BIT = 0x80
+FLAG_SYNC = 0x01
+FLAG_DUP = 0x01
+STATUS = ['ok', 'failed', 'bad_op', 'stale', 'bad_version']
+
+
+def percentiles(name, samples_us, lost):
+    if not samples_us:
+        print(f'{name}: no replies, {lost} lost')
+        return
+    s = sorted(samples_us)
+    p = lambda q: s[min(len(s) - 1, int(len(s) * q))]
+    print(f'{name}: {len(s)} cmds, {lost} lost, rtt p50 {p(0.5) / 1000:.2f} ms, '
+          f'p99 {p(0.99) / 1000:.2f} ms, max {s[-1] / 1000:.2f} ms')
+
+
+def run_udp(args):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.connect((args.panel_ip, args.port))
+    sock.settimeout(args.timeout / 1000)
+    op = OPS[args.op]
+    seq0 = int(time.monotonic() * 1000) & 0xffffffff
+    rtt, lost, handler, dups, bad = [], 0, [], 0, {}
+    for i in range(args.count):
+        seq = (seq0 + i) & 0xffffffff
+        frame = FRAME.pack(MAGIC, VERSION, op, seq, args.target, 0, FLAG_SYNC if i == 0 else 0, args.value)
+        t0 = time.perf_counter_ns()
+        ack = None
+        for _ in range(args.retries + 1):
+            sock.send(frame)
+            try:
+                while True:
+                    data = sock.recv(64)
+                    if len(data) != ACK.size:
+                        continue
+                    a = ACK.unpack(data)
+                    if a[0] == MAGIC and a[2] == op | ACK_BIT and a[3] == seq:
+                        ack = a
+                        break
+            except socket.timeout:
+                continue
+            break
+        if ack is None:
+            lost += 1
+            continue
+        rtt.append((time.perf_counter_ns() - t0) // 1000)
+        handler.append(ack[7])
+        if ack[6] & FLAG_DUP:
+            dups += 1
+        if ack[5] != 0:
+            name = STATUS[ack[5]] if ack[5] < len(STATUS) else str(ack[5])
+            bad[name] = bad.get(name, 0) + 1
+        if args.interval:
+            time.sleep(args.interval / 1000)
+    percentiles('udp', rtt, lost)
+    if handler:
+        print(f'  panel handler avg {sum(handler) / len(handler):.1f} us, max {max(handler)} us, '
+              f'{dups} duplicate acks, errors {bad or "none"}')
+
+
+def run_mqtt(args):
+    try:
+        import paho.mqtt.client as mqtt
+    except ImportError:
+        sys.exit('--mqtt needs paho-mqtt')
+    acks = {}
+    got = threading.Condition()
+
+    def on_message(client, userdata, msg):
+        try:
+            req = json.loads(msg.payload).get('req')
+        except ValueError:
+            return  # ack en CBOR: negociar "json" antes de medir
+        with got:
+            acks[req] = time.perf_counter_ns()
+            got.notify()
+
+    client = mqtt.Client()
+    client.on_message = on_message
+    client.connect(args.mqtt, 1883)
+    client.subscribe(f'aq/{args.panel}/ack', qos=1)
+    client.loop_start()
+    time.sleep(0.5)
+    rtt, lost = [], 0
+    for i in range(args.count):
+        req = 100000 + i
+        cmd = {'type': 'command', 'req': req, 'cmd': 'set', 'target': f'ctrl_{args.target}', 'value': args.value}
+        t0 = time.perf_counter_ns()
+        client.publish(f'aq/{args.panel}/cmd', json.dumps(cmd), qos=1)
+        with got:
+            if not got.wait_for(lambda: req in acks, timeout=args.timeout * (args.retries + 1) / 1000):
+                lost += 1
+                continue
+            rtt.append((acks.pop(req) - t0) // 1000)
+        if args.interval:
+            time.sleep(args.interval / 1000)
+    client.loop_stop()
+    percentiles('mqtt', rtt, lost)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument('panel_ip')
+    ap.add_argument('--port', type=int, default=5516, help='CONFIG_AQ_CTRL_UDP_PORT')
+    ap.add_argument('--op', choices=OPS, default='set')
+    ap.add_argument('--target', type=int, default=0, help='salida: señal ctrl_<target> en app_manager_aq')
+    ap.add_argument('--value', type=float, default=1.0)
+    ap.add_argument('-n', '--count', type=int, default=1000)
+    ap.add_argument('--interval', type=float, default=0, help='ms entre comandos')
+    ap.add_argument('--timeout', type=int, default=200, help='ms por intento')
+    ap.add_argument('--retries', type=int, default=2)
+    ap.add_argument('--mqtt', help='broker: mide también la vía MQTT')
+    ap.add_argument('--panel', default='p1', help='CONFIG_AQ_MQTT_PANEL_ID')
+    args = ap.parse_args()
+    run_udp(args)
+    if args.mqtt:
+        run_mqtt(args)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,219 @@
+// Benchmark de host (Linux) del camino de publicación de mqtt_service_aq.
+//
+// Compila el códec, los topics internados y la sesión reales sobre sockets POSIX y
+// levanta un broker mínimo en 127.0.0.1 (CONNACK, PUBACK, PINGRESP). Cada payload
+// lleva la marca de tiempo del envío, así la latencia es extremo a extremo.
+// -c compara con el camino "clásico": formatear el paquete en un buffer y send().
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include "mqtt_codec_aq.h"
+#include "mqtt_session_aq.h"
+#include "mqtt_topic_aq.h"
+
+static uint32_t s_msgs = 200000;
+static uint16_t s_payload_len = 64;
+static uint8_t s_qos = 0;
+static bool s_copy_path = false;
+static int s_listen_fd = -1;
+static uint32_t *s_lat_us;             // una muestra por mensaje, escrita por el broker
+static uint32_t *s_call_us;            // coste de la llamada publish
+static atomic_uint s_received;
+
+static void *broker_thread(void *arg) {
+    int fd = accept(s_listen_fd, NULL, NULL);
+    if (fd < 0) return NULL;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    static uint8_t buf[64 * 1024];
+    size_t len = 0;
+    for (;;) {
+        ssize_t r = recv(fd, buf + len, sizeof(buf) - len, 0);
+        if (r <= 0) break;
+        len += r;
+        size_t off = 0;
+        mqtt_packet_aq_t pkt;
+        size_t used;
+        while (mqtt_parse_aq(buf + off, len - off, &pkt, &used) == 1) {
+            uint8_t out[4];
+            switch (pkt.type) {
+            case MQTT_PKT_CONNECT:
+                out[0] = MQTT_PKT_CONNACK << 4; out[1] = 2; out[2] = 0; out[3] = 0;
+                send(fd, out, 4, 0);
+                break;
+            case MQTT_PKT_PINGREQ:
+                out[0] = MQTT_PKT_PINGRESP << 4; out[1] = 0;
+                send(fd, out, 2, 0);
+                break;
+            case MQTT_PKT_PUBLISH: {
+                const char *topic;
+                uint16_t topic_len, id;
+                const uint8_t *payload;
+                size_t payload_len;
+                if (!mqtt_parse_publish_aq(&pkt, &topic, &topic_len, &id, &payload, &payload_len)) break;
+                uint32_t seq;
+                int64_t t0;
+                memcpy(&seq, payload, sizeof(seq));
+                memcpy(&t0, payload + 4, sizeof(t0));
+                if (seq < s_msgs) s_lat_us[seq] = (uint32_t)(esp_timer_get_time() - t0);
+                if (id) send(fd, out, mqtt_encode_puback_aq(out, sizeof(out), id), 0);
+                atomic_fetch_add(&s_received, 1);
+                break;
+            }
+            case MQTT_PKT_DISCONNECT:
+                close(fd);
+                return NULL;
+            default:
+                break;
+            }
+            off += used;
+        }
+        memmove(buf, buf + off, len - off);
+        len -= off;
+    }
+    close(fd);
+    return NULL;
+}
+
+static int start_broker(uint16_t *port) {
+    s_listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t alen = sizeof(addr);
+    if (bind(s_listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(s_listen_fd, 1) != 0) {
+        return -1;
+    }
+    getsockname(s_listen_fd, (struct sockaddr *)&addr, &alen);
+    *port = ntohs(addr.sin_port);
+    return 0;
+}
+
+// Camino de referencia: paquete completo formateado en un buffer y un send()
+static esp_err_t publish_copy(int fd, uint8_t topic_id, const uint8_t *payload, size_t len) {
+    static uint8_t pkt[CONFIG_AQ_MQTT_SLOT_SIZE * 4];
+    size_t topic_len;
+    const uint8_t *topic = mqtt_topic_encoded_aq(topic_id, &topic_len);
+    size_t n = mqtt_encode_publish_fixed_aq(pkt, 0, false, topic_len, len);
+    memcpy(pkt + n, topic, topic_len);
+    memcpy(pkt + n + topic_len, payload, len);
+    return send(fd, pkt, n + topic_len + len, 0) == (ssize_t)(n + topic_len + len) ? ESP_OK : ESP_FAIL;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-n msgs] [-s payload_len] [-q 0|1] [-c] [-v]\n"
+            "  -c publishes through a formatted copy + send() for comparison (QoS0 only)\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:q:cvh")) != -1) {
+        switch (opt) {
+        case 'n': s_msgs = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 's': s_payload_len = (uint16_t)strtoul(optarg, NULL, 0); break;
+        case 'q': s_qos = (uint8_t)strtoul(optarg, NULL, 0); break;
+        case 'c': s_copy_path = true; break;
+        case 'v': g_mock_log_verbose_aq = true; break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (s_msgs == 0 || s_payload_len < 12 || s_qos > 1 || (s_copy_path && s_qos) ||
+        s_payload_len > CONFIG_AQ_MQTT_SLOT_SIZE - 64) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    s_lat_us = calloc(s_msgs, sizeof(uint32_t));
+    s_call_us = calloc(s_msgs, sizeof(uint32_t));
+    uint16_t port;
+    if (!s_lat_us || !s_call_us || start_broker(&port) != 0) {
+        fprintf(stderr, "setup failed\n");
+        return 1;
+    }
+    pthread_t broker;
+    pthread_create(&broker, NULL, broker_thread, NULL);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port),
+                               .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    int one = 1;
+    struct timeval snd_to = {.tv_sec = 1};
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &snd_to, sizeof(snd_to));
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("connect");
+        return 1;
+    }
+
+    mqtt_topic_init_aq(CONFIG_AQ_MQTT_TOPIC_ROOT "/" CONFIG_AQ_MQTT_PANEL_ID "/");
+    uint8_t topic = mqtt_topic_intern_aq("telemetry");
+    mqtt_session_init_aq(NULL);
+    mqtt_connect_opts_aq_t copts = {
+        .client_id = CONFIG_AQ_MQTT_PANEL_ID,
+        .keepalive_s = CONFIG_AQ_MQTT_KEEPALIVE_S,
+        .clean_session = true,
+    };
+    ESP_ERROR_CHECK(mqtt_session_open_aq(fd, &copts, 1000));
+
+    uint8_t payload[CONFIG_AQ_MQTT_SLOT_SIZE];
+    memset(payload, 0xa5, sizeof(payload));
+    uint32_t window_full = 0;
+    int64_t t_start = esp_timer_get_time();
+    for (uint32_t i = 0; i < s_msgs; i++) {
+        memcpy(payload, &i, sizeof(i));
+        for (;;) {
+            int64_t t0 = esp_timer_get_time();
+            memcpy(payload + 4, &t0, sizeof(t0));
+            esp_err_t err = s_copy_path ? publish_copy(fd, topic, payload, s_payload_len)
+                                        : mqtt_session_publish_aq(topic, payload, s_payload_len, s_qos, false);
+            s_call_us[i] = (uint32_t)(esp_timer_get_time() - t0);
+            if (err == ESP_OK) break;
+            if (err != ESP_ERR_NO_MEM) {
+                fprintf(stderr, "publish %u failed: %s\n", i, esp_err_to_name(err));
+                return 1;
+            }
+            // Ventana QoS1 llena: procesar PUBACK y reintentar
+            window_full++;
+            mqtt_session_poll_aq();
+        }
+        if (s_qos) mqtt_session_poll_aq();
+    }
+    while (atomic_load(&s_received) < s_msgs) {
+        if (s_qos) mqtt_session_poll_aq();
+    }
+    int64_t t_end = esp_timer_get_time();
+
+    mqtt_service_stats_aq_t st;
+    mqtt_session_get_stats_aq(&st);
+    while (s_qos && st.qos1_inflight) {
+        mqtt_session_poll_aq();
+        mqtt_session_get_stats_aq(&st);
+    }
+    mqtt_session_close_aq(true);
+    close(fd);
+    pthread_join(broker, NULL);
+
+    double secs = (t_end - t_start) / 1e6;
+    qsort(s_lat_us, s_msgs, sizeof(uint32_t), cmp_u32);
+    qsort(s_call_us, s_msgs, sizeof(uint32_t), cmp_u32);
+    printf("RESULT path=%s qos=%u msgs=%u payload=%u rate=%.0f mbps=%.1f p50_us=%u p99_us=%u "
+           "call_p50_us=%u call_p99_us=%u acked=%u window_full=%u\n",
+           s_copy_path ? "copy" : "iovec", s_qos, s_msgs, s_payload_len, s_msgs / secs,
+           (double)s_msgs * s_payload_len * 8 / secs / 1e6, s_lat_us[s_msgs / 2],
+           s_lat_us[(uint64_t)s_msgs * 99 / 100], s_call_us[s_msgs / 2],
+           s_call_us[(uint64_t)s_msgs * 99 / 100], st.qos1_acked, window_full);
+    return 0;
+}
@@ -0,0 +1,15 @@
+#pragma once
+// Valores por defecto del Kconfig de mqtt_service_aq
+#define CONFIG_AQ_MQTT_BROKER_HOST "127.0.0.1"
+#define CONFIG_AQ_MQTT_BROKER_PORT 1883
+#define CONFIG_AQ_MQTT_PANEL_ID "aq-panel-01"
+#define CONFIG_AQ_MQTT_TOPIC_ROOT "aq"
+#define CONFIG_AQ_MQTT_KEEPALIVE_S 30
+#define CONFIG_AQ_MQTT_HEARTBEAT_MS 5000
+#define CONFIG_AQ_MQTT_SEND_TIMEOUT_MS 100
+#define CONFIG_AQ_MQTT_QOS1_SLOTS 8
+#define CONFIG_AQ_MQTT_SLOT_SIZE 512
+#define CONFIG_AQ_MQTT_RX_BUF_SIZE 1024
+#define CONFIG_AQ_MQTT_MAX_TOPICS 16
+#define CONFIG_AQ_MQTT_TOPIC_ARENA 512
+#define CONFIG_AQ_MQTT_MAX_SUBS 8
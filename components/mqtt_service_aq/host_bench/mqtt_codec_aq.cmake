@@ -0,0 +1,9 @@
+# Códec MQTT (src/mqtt_codec_aq.c) como biblioteca de host para otros host_bench: C puro,
+# sin IDF ni mock. Así quien lo usa no depende de la lista de fuentes de este componente:
+#   include(${COMPONENT_DIR}/../mqtt_service_aq/host_bench/mqtt_codec_aq.cmake)
+#   target_link_libraries(x PRIVATE mqtt_codec_aq)      # y #include "mqtt_codec_aq.h"
+if(NOT TARGET mqtt_codec_aq)
+    add_library(mqtt_codec_aq STATIC ${CMAKE_CURRENT_LIST_DIR}/../src/mqtt_codec_aq.c)
+    target_include_directories(mqtt_codec_aq PUBLIC ${CMAKE_CURRENT_LIST_DIR}/../src)
+    target_compile_options(mqtt_codec_aq PRIVATE -Wall -Wno-unused-parameter)
+endif()
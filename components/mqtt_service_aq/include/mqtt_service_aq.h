@@ -0,0 +1,66 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Cliente MQTT 3.1.1 hacia el broker del MASTER, ligado a la interfaz USB-NCM.
+// Todo el estado es estático: publicar no reserva memoria y en QoS0 no copia el payload.
+
+ESP_EVENT_DECLARE_BASE(MQTT_SERVICE_EVENTS);
+
+typedef enum {
+    MQTT_SERVICE_CONNECTED,      // sin datos
+    MQTT_SERVICE_DISCONNECTED,   // sin datos
+} mqtt_service_event_aq_t;
+
+#define MQTT_SERVICE_TOPIC_INVALID_AQ 0xff
+#define MQTT_SERVICE_LAT_BUCKETS_AQ   16
+
+typedef struct {
+    uint32_t published;          // PUBLISH enviados (QoS0 + QoS1)
+    uint32_t published_bytes;    // bytes de payload
+    uint32_t publish_failures;   // error de socket o ventana QoS1 llena
+    uint32_t qos1_inflight;      // slots QoS1 sin PUBACK
+    uint32_t qos1_acked;
+    uint32_t qos1_resent;        // reenvíos con DUP tras reconectar
+    uint32_t received;           // PUBLISH recibidos
+    uint32_t pings;
+    uint32_t reconnects;
+    uint32_t heartbeats;
+    // Coste de mqtt_service_publish_aq en µs, bucket i = [2^i, 2^(i+1))
+    uint32_t publish_us[MQTT_SERVICE_LAT_BUCKETS_AQ];
+} mqtt_service_stats_aq_t;
+
+// Callback de mensaje entrante, en la tarea del servicio (puede publicar). topic no está
+// terminado en '\0'; ambos punteros solo son válidos durante la llamada (buffer RX del servicio).
+typedef void (*mqtt_service_msg_cb_aq_t)(const char *topic, size_t topic_len,
+                                          const uint8_t *payload, size_t len, void *ctx);
+
+// Arranca la tarea del servicio; el socket se liga a la IP y a la interfaz de netif.
+esp_err_t mqtt_service_start_aq(esp_netif_t *netif);
+esp_err_t mqtt_service_stop_aq(void);
+bool      mqtt_service_is_connected_aq(void);
+
+// Interna "<root>/<panel_id>/<suffix>" y devuelve su id para publicar sin formatear
+// el topic cada vez. Idempotente. MQTT_SERVICE_TOPIC_INVALID_AQ si la tabla está llena.
+uint8_t   mqtt_service_topic_aq(const char *suffix);
+// Seguro desde cualquier tarea. qos 0 o 1. ESP_ERR_INVALID_STATE sin conexión,
+// ESP_ERR_NO_MEM si la ventana QoS1 está llena.
+esp_err_t mqtt_service_publish_aq(uint8_t topic, const void *payload, size_t len,
+                                  uint8_t qos, bool retain);
+// Filtro relativo al prefijo del panel (p.ej. "cmd/#"). Se re-suscribe al reconectar.
+esp_err_t mqtt_service_subscribe_aq(const char *filter, mqtt_service_msg_cb_aq_t cb, void *ctx);
+
+void      mqtt_service_get_stats_aq(mqtt_service_stats_aq_t *out);
+void      mqtt_service_reset_stats_aq(void);
+
+#ifdef __cplusplus
+}
+#endif
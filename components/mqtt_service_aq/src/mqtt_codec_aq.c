@@ -0,0 +1,149 @@
+#include "mqtt_codec_aq.h"
+#include <string.h>
+
+static inline uint8_t *put16(uint8_t *p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v & 0xff;
+    return p + 2;
+}
+
+static inline uint8_t *put_str(uint8_t *p, const void *s, uint16_t len) {
+    p = put16(p, len);
+    memcpy(p, s, len);
+    return p + len;
+}
+
+size_t mqtt_encode_remaining_aq(uint8_t *out, uint32_t len) {
+    if (len > MQTT_REMAINING_MAX) return 0;
+    size_t n = 0;
+    do {
+        uint8_t b = len & 0x7f;
+        len >>= 7;
+        out[n++] = len ? (b | 0x80) : b;
+    } while (len);
+    return n;
+}
+
+static size_t remaining_size(uint32_t len) {
+    return len < 128 ? 1 : len < 16384 ? 2 : len < 2097152 ? 3 : 4;
+}
+
+size_t mqtt_encode_connect_aq(uint8_t *buf, size_t cap, const mqtt_connect_opts_aq_t *o) {
+    uint16_t id_len = (uint16_t)strlen(o->client_id);
+    uint16_t wt_len = o->will_topic ? (uint16_t)strlen(o->will_topic) : 0;
+    uint32_t rem = 10 + 2 + id_len;
+    if (o->will_topic) rem += 2 + wt_len + 2 + o->will_len;
+    size_t total = 1 + remaining_size(rem) + rem;
+    if (total > cap) return 0;
+
+    uint8_t flags = o->clean_session ? 0x02 : 0;
+    if (o->will_topic) flags |= 0x04 | (o->will_retain ? 0x20 : 0);  // will QoS0
+
+    uint8_t *p = buf;
+    *p++ = MQTT_PKT_CONNECT << 4;
+    p += mqtt_encode_remaining_aq(p, rem);
+    p = put_str(p, "MQTT", 4);
+    *p++ = 4;  // nivel de protocolo 3.1.1
+    *p++ = flags;
+    p = put16(p, o->keepalive_s);
+    p = put_str(p, o->client_id, id_len);
+    if (o->will_topic) {
+        p = put_str(p, o->will_topic, wt_len);
+        p = put_str(p, o->will_payload, o->will_len);
+    }
+    return (size_t)(p - buf);
+}
+
+size_t mqtt_encode_subscribe_aq(uint8_t *buf, size_t cap, uint16_t pkt_id, const char *filter, uint8_t qos) {
+    uint16_t f_len = (uint16_t)strlen(filter);
+    uint32_t rem = 2 + 2 + f_len + 1;
+    size_t total = 1 + remaining_size(rem) + rem;
+    if (total > cap) return 0;
+    uint8_t *p = buf;
+    *p++ = (MQTT_PKT_SUBSCRIBE << 4) | 0x02;
+    p += mqtt_encode_remaining_aq(p, rem);
+    p = put16(p, pkt_id);
+    p = put_str(p, filter, f_len);
+    *p++ = qos;
+    return (size_t)(p - buf);
+}
+
+size_t mqtt_encode_puback_aq(uint8_t *buf, size_t cap, uint16_t pkt_id) {
+    if (cap < 4) return 0;
+    buf[0] = MQTT_PKT_PUBACK << 4;
+    buf[1] = 2;
+    put16(buf + 2, pkt_id);
+    return 4;
+}
+
+size_t mqtt_encode_simple_aq(uint8_t *buf, size_t cap, uint8_t type) {
+    if (cap < 2) return 0;
+    buf[0] = type << 4;
+    buf[1] = 0;
+    return 2;
+}
+
+size_t mqtt_encode_publish_fixed_aq(uint8_t *out, uint8_t qos, bool retain, size_t topic_enc_len,
+                                    uint32_t payload_len) {
+    uint32_t rem = (uint32_t)topic_enc_len + (qos ? 2 : 0) + payload_len;
+    out[0] = (MQTT_PKT_PUBLISH << 4) | (qos << 1) | (retain ? MQTT_PUBLISH_RETAIN : 0);
+    size_t n = mqtt_encode_remaining_aq(out + 1, rem);
+    return n ? n + 1 : 0;
+}
+
+int mqtt_parse_aq(const uint8_t *buf, size_t len, mqtt_packet_aq_t *pkt, size_t *consumed) {
+    if (len < 2) return 0;
+    uint32_t rem = 0;
+    size_t i = 1;
+    for (int shift = 0;; shift += 7) {
+        if (i >= len) return 0;
+        if (shift > 21) return -1;
+        uint8_t b = buf[i++];
+        rem |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) break;
+    }
+    if (len - i < rem) return 0;
+    pkt->type = buf[0] >> 4;
+    pkt->flags = buf[0] & 0x0f;
+    pkt->len = rem;
+    pkt->body = buf + i;
+    *consumed = i + rem;
+    return 1;
+}
+
+bool mqtt_parse_publish_aq(const mqtt_packet_aq_t *pkt, const char **topic, uint16_t *topic_len,
+                           uint16_t *pkt_id, const uint8_t **payload, size_t *payload_len) {
+    if (pkt->type != MQTT_PKT_PUBLISH || pkt->len < 2) return false;
+    uint16_t tl = (uint16_t)((pkt->body[0] << 8) | pkt->body[1]);
+    uint8_t qos = (pkt->flags >> 1) & 0x03;
+    size_t off = 2 + tl + (qos ? 2 : 0);
+    if (off > pkt->len) return false;
+    *topic = (const char *)pkt->body + 2;
+    *topic_len = tl;
+    *pkt_id = qos ? (uint16_t)((pkt->body[2 + tl] << 8) | pkt->body[3 + tl]) : 0;
+    *payload = pkt->body + off;
+    *payload_len = pkt->len - off;
+    return true;
+}
+
+bool mqtt_topic_match_aq(const char *filter, const char *topic, size_t topic_len) {
+    const char *t = topic;
+    const char *end = topic + topic_len;
+    while (*filter) {
+        if (*filter == '#') {
+            return true;  // resto del árbol (incluido el nivel padre)
+        }
+        if (*filter == '+') {
+            while (t < end && *t != '/') t++;
+            filter++;
+        } else {
+            if (t == end || *filter != *t) {
+                // "a/#" también coincide con "a"
+                return t == end && filter[0] == '/' && filter[1] == '#' && filter[2] == '\0';
+            }
+            filter++;
+            t++;
+        }
+    }
+    return t == end;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Codificación/decodificación de paquetes MQTT 3.1.1 (C puro, sin IDF).
+// Solo lo que usa el servicio: CONNECT, PUBLISH, SUBSCRIBE, PUBACK, PINGREQ, DISCONNECT.
+
+#define MQTT_PKT_CONNECT     1
+#define MQTT_PKT_CONNACK     2
+#define MQTT_PKT_PUBLISH     3
+#define MQTT_PKT_PUBACK      4
+#define MQTT_PKT_SUBSCRIBE   8
+#define MQTT_PKT_SUBACK      9
+#define MQTT_PKT_PINGREQ     12
+#define MQTT_PKT_PINGRESP    13
+#define MQTT_PKT_DISCONNECT  14
+
+#define MQTT_PUBLISH_DUP     0x08
+#define MQTT_PUBLISH_RETAIN  0x01
+#define MQTT_FIXED_HDR_MAX   5     // tipo + hasta 4 bytes de longitud restante
+#define MQTT_REMAINING_MAX   268435455u
+
+typedef struct {
+    const char *client_id;
+    const char *will_topic;     // NULL = sin last will
+    const void *will_payload;
+    uint16_t will_len;
+    bool will_retain;
+    uint16_t keepalive_s;
+    bool clean_session;
+} mqtt_connect_opts_aq_t;
+
+typedef struct {
+    uint8_t type;               // MQTT_PKT_*
+    uint8_t flags;              // nibble bajo del primer byte
+    uint32_t len;               // longitud restante
+    const uint8_t *body;        // apunta dentro del buffer de entrada
+} mqtt_packet_aq_t;
+
+// Longitud restante en 1..4 bytes; devuelve los bytes escritos (0 si no cabe en MQTT)
+size_t mqtt_encode_remaining_aq(uint8_t *out, uint32_t len);
+
+// Cada encoder devuelve la longitud del paquete o 0 si no cabe en cap
+size_t mqtt_encode_connect_aq(uint8_t *buf, size_t cap, const mqtt_connect_opts_aq_t *o);
+size_t mqtt_encode_subscribe_aq(uint8_t *buf, size_t cap, uint16_t pkt_id, const char *filter, uint8_t qos);
+size_t mqtt_encode_puback_aq(uint8_t *buf, size_t cap, uint16_t pkt_id);
+size_t mqtt_encode_simple_aq(uint8_t *buf, size_t cap, uint8_t type);  // PINGREQ / DISCONNECT
+
+// Cabecera fija de un PUBLISH cuyo cuerpo es [topic codificado][pkt_id si qos>0][payload].
+// Se envía junto al topic y al payload sin copiarlos (iovec).
+size_t mqtt_encode_publish_fixed_aq(uint8_t *out, uint8_t qos, bool retain, size_t topic_enc_len,
+                                    uint32_t payload_len);
+
+// 1 = paquete completo en *pkt, 0 = faltan bytes, -1 = malformado.
+// *consumed = bytes totales del paquete (cabecera + cuerpo).
+int mqtt_parse_aq(const uint8_t *buf, size_t len, mqtt_packet_aq_t *pkt, size_t *consumed);
+// Topic, pkt_id (0 si QoS0) y payload de un PUBLISH ya parseado
+bool mqtt_parse_publish_aq(const mqtt_packet_aq_t *pkt, const char **topic, uint16_t *topic_len,
+                           uint16_t *pkt_id, const uint8_t **payload, size_t *payload_len);
+// Coincidencia de un topic con un filtro con comodines '+' y '#'
+bool mqtt_topic_match_aq(const char *filter, const char *topic, size_t topic_len);
@@ -0,0 +1,353 @@
+#include "mqtt_service_aq.h"
+#include <errno.h>
+#include <string.h>
+#include "esp_app_desc.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include "mqtt_session_aq.h"
+#include "mqtt_topic_aq.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "mqtt_service_aq";
+
+ESP_EVENT_DEFINE_BASE(MQTT_SERVICE_EVENTS);
+
+#if CONFIG_FREERTOS_UNICORE
+#define MQTT_TASK_CORE_AQ 0
+#else
+#define MQTT_TASK_CORE_AQ (CONFIG_AQ_MQTT_TASK_CORE < 0 ? tskNO_AFFINITY : CONFIG_AQ_MQTT_TASK_CORE)
+#endif
+
+#define MQTT_FILTER_MAX_AQ   64
+// Prefijo "<root>/<panel_id>/" común a todos los topics del panel. Los buffers se
+// dimensionan con el literal: un id largo no desborda nada, falla al compilar.
+#define MQTT_PREFIX_AQ       CONFIG_AQ_MQTT_TOPIC_ROOT "/" CONFIG_AQ_MQTT_PANEL_ID "/"
+_Static_assert(sizeof(MQTT_PREFIX_AQ) <= MQTT_TOPIC_PREFIX_MAX_AQ,
+               "AQ_MQTT_TOPIC_ROOT + AQ_MQTT_PANEL_ID too long for the topic prefix");
+_Static_assert(sizeof(MQTT_PREFIX_AQ "master/heartbeat") <= MQTT_FILTER_MAX_AQ,
+               "AQ_MQTT_TOPIC_ROOT + AQ_MQTT_PANEL_ID leave no room for subscription filters");
+#define MQTT_BACKOFF_MIN_MS  500
+#define MQTT_BACKOFF_MAX_MS  8000
+
+typedef struct {
+    char filter[MQTT_FILTER_MAX_AQ];   // filtro completo, con el prefijo del panel
+    mqtt_service_msg_cb_aq_t cb;
+    void *ctx;
+} sub_entry_t;
+
+static StaticSemaphore_t s_lock_buf;
+static SemaphoreHandle_t s_lock;
+static TaskHandle_t s_task;
+static esp_netif_t *s_netif;
+static volatile bool s_run;
+static volatile bool s_connected;
+static int s_sock = -1;
+static sub_entry_t s_subs[CONFIG_AQ_MQTT_MAX_SUBS];
+static int s_sub_count;
+static uint8_t s_topic_hb;
+static uint8_t s_topic_status;
+static uint32_t s_reconnects;
+static uint32_t s_heartbeats;
+static char s_prefix[sizeof(MQTT_PREFIX_AQ)];
+static char s_will_topic[sizeof(MQTT_PREFIX_AQ "status")];
+
+static void dispatch(const char *topic, uint16_t topic_len, const uint8_t *payload, size_t len) {
+    // Con s_lock tomado desde la tarea del servicio; es recursivo para que el callback pueda publicar
+    for (int i = 0; i < s_sub_count; i++) {
+        if (mqtt_topic_match_aq(s_subs[i].filter, topic, topic_len)) {
+            s_subs[i].cb(topic, topic_len, payload, len, s_subs[i].ctx);
+        }
+    }
+}
+
+// Socket TCP ligado a la IP y a la interfaz USB: el tráfico MQTT nunca sale por otra netif
+static int open_socket(void) {
+    esp_netif_ip_info_t ip;
+    if (esp_netif_get_ip_info(s_netif, &ip) != ESP_OK || ip.ip.addr == 0) return -1;
+
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0) return -1;
+
+    struct ifreq ifr = {0};
+    if (esp_netif_get_netif_impl_name(s_netif, ifr.ifr_name) == ESP_OK) {
+        setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, &ifr, sizeof(ifr));
+    }
+    struct sockaddr_in local = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = ip.ip.addr,
+    };
+    int one = 1;
+    struct timeval snd_to = {
+        .tv_sec = CONFIG_AQ_MQTT_SEND_TIMEOUT_MS / 1000,
+        .tv_usec = (CONFIG_AQ_MQTT_SEND_TIMEOUT_MS % 1000) * 1000,
+    };
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &snd_to, sizeof(snd_to));
+
+    struct sockaddr_in broker = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_AQ_MQTT_BROKER_PORT),
+    };
+    inet_aton(CONFIG_AQ_MQTT_BROKER_HOST, &broker.sin_addr);
+    if (bind(fd, (struct sockaddr *)&local, sizeof(local)) != 0 ||
+        connect(fd, (struct sockaddr *)&broker, sizeof(broker)) != 0) {
+        ESP_LOGW(TAG, "Cannot connect to %s:%d (errno %d)", CONFIG_AQ_MQTT_BROKER_HOST,
+                 CONFIG_AQ_MQTT_BROKER_PORT, errno);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static esp_err_t connect_session(void) {
+    s_sock = open_socket();
+    if (s_sock < 0) return ESP_FAIL;
+
+    static const char offline[] = "offline";
+    mqtt_connect_opts_aq_t opts = {
+        .client_id = CONFIG_AQ_MQTT_PANEL_ID,
+        .will_topic = s_will_topic,
+        .will_payload = offline,
+        .will_len = sizeof(offline) - 1,
+        .will_retain = true,
+        .keepalive_s = CONFIG_AQ_MQTT_KEEPALIVE_S,
+        .clean_session = true,
+    };
+    xSemaphoreTakeRecursive(s_lock, portMAX_DELAY);
+    esp_err_t err = mqtt_session_open_aq(s_sock, &opts, 3000);
+    for (int i = 0; err == ESP_OK && i < s_sub_count; i++) {
+        err = mqtt_session_subscribe_aq(s_subs[i].filter, 1);
+    }
+    if (err == ESP_OK) {
+        err = mqtt_session_publish_aq(s_topic_status, "online", 6, 0, true);
+    }
+    if (err != ESP_OK) {
+        mqtt_session_close_aq(false);
+    }
+    xSemaphoreGiveRecursive(s_lock);
+
+    if (err != ESP_OK) {
+        close(s_sock);
+        s_sock = -1;
+        return err;
+    }
+    s_connected = true;
+    esp_event_post(MQTT_SERVICE_EVENTS, MQTT_SERVICE_CONNECTED, NULL, 0, 0);
+    ESP_LOGI(TAG, "Connected to %s:%d", CONFIG_AQ_MQTT_BROKER_HOST, CONFIG_AQ_MQTT_BROKER_PORT);
+    return ESP_OK;
+}
+
+static void disconnect_session(bool graceful) {
+    xSemaphoreTakeRecursive(s_lock, portMAX_DELAY);
+    mqtt_session_close_aq(graceful);
+    s_connected = false;
+    xSemaphoreGiveRecursive(s_lock);
+    if (s_sock >= 0) {
+        close(s_sock);
+        s_sock = -1;
+    }
+    esp_event_post(MQTT_SERVICE_EVENTS, MQTT_SERVICE_DISCONNECTED, NULL, 0, 0);
+}
+
+static char *put_str(char *p, const char *s) {
+    while (*s) *p++ = *s++;
+    return p;
+}
+
+static char *put_strn(char *p, const char *s, size_t max) {
+    while (max-- && *s) *p++ = *s++;
+    return p;
+}
+
+static char *put_u32(char *p, uint32_t v) {
+    char tmp[10];
+    int n = 0;
+    do {
+        tmp[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    while (n) *p++ = tmp[--n];
+    return p;
+}
+
+// Caso peor del heartbeat: las partes fijas, la versión (char[32] con terminador) y
+// cuatro u32 de 10 dígitos
+#define HB_HEAD_AQ "{\"id\":\"" CONFIG_AQ_MQTT_PANEL_ID "\",\"api_version\":\"1.0\",\"fw_version\":\""
+#define HB_MAX_AQ                                                                                  \
+    (sizeof(HB_HEAD_AQ) + sizeof(((esp_app_desc_t *)0)->version) + sizeof("\",\"seq\":") +          \
+     sizeof(",\"up_s\":") + sizeof(",\"heap\":") + sizeof(",\"min_heap\":") + 4 * 10 + 1)
+
+// Heartbeat sin snprintf ni heap: JSON formateado a mano en un buffer de pila
+static void publish_heartbeat(uint32_t seq) {
+    char buf[HB_MAX_AQ];
+    char *p = buf;
+    const esp_app_desc_t *app = esp_app_get_description();
+    p = put_str(p, HB_HEAD_AQ);
+    p = put_strn(p, app->version, sizeof(app->version));
+    p = put_str(p, "\",\"seq\":");
+    p = put_u32(p, seq);
+    p = put_str(p, ",\"up_s\":");
+    p = put_u32(p, (uint32_t)(esp_timer_get_time() / 1000000));
+    p = put_str(p, ",\"heap\":");
+    p = put_u32(p, esp_get_free_heap_size());
+    p = put_str(p, ",\"min_heap\":");
+    p = put_u32(p, esp_get_minimum_free_heap_size());
+    *p++ = '}';
+    if (mqtt_service_publish_aq(s_topic_hb, buf, p - buf, 0, false) == ESP_OK) {
+        s_heartbeats++;
+    }
+}
+
+// Estado estático común; se puede internar topics y suscribirse antes de arrancar
+static void init_once(void) {
+    if (s_lock) return;
+    s_lock = xSemaphoreCreateRecursiveMutexStatic(&s_lock_buf);
+    char *p = put_str(s_prefix, MQTT_PREFIX_AQ);
+    *p = '\0';
+    p = put_str(put_str(s_will_topic, s_prefix), "status");
+    *p = '\0';
+    mqtt_topic_init_aq(s_prefix);
+    mqtt_session_init_aq(dispatch);
+    s_topic_hb = mqtt_topic_intern_aq("heartbeat");
+    s_topic_status = mqtt_topic_intern_aq("status");
+}
+
+static void mqtt_task(void *arg) {
+    uint32_t backoff_ms = MQTT_BACKOFF_MIN_MS;
+    uint32_t hb_seq = 0;
+    int64_t next_hb_us = 0;
+
+    while (s_run) {
+        if (!s_connected) {
+            if (connect_session() != ESP_OK) {
+                vTaskDelay(pdMS_TO_TICKS(backoff_ms));
+                backoff_ms = backoff_ms * 2 > MQTT_BACKOFF_MAX_MS ? MQTT_BACKOFF_MAX_MS : backoff_ms * 2;
+                continue;
+            }
+            backoff_ms = MQTT_BACKOFF_MIN_MS;
+            next_hb_us = 0;
+        }
+
+        // Esperar datos del broker como mucho hasta el próximo heartbeat
+        int64_t now = esp_timer_get_time();
+        int64_t wait_us = next_hb_us > now ? next_hb_us - now : 0;
+        if (wait_us > 1000000) wait_us = 1000000;
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(s_sock, &rfds);
+        struct timeval tv = {.tv_sec = wait_us / 1000000, .tv_usec = wait_us % 1000000};
+        select(s_sock + 1, &rfds, NULL, NULL, &tv);
+
+        xSemaphoreTakeRecursive(s_lock, portMAX_DELAY);
+        esp_err_t err = mqtt_session_poll_aq();
+        xSemaphoreGiveRecursive(s_lock);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Connection lost, reconnecting");
+            disconnect_session(false);
+            s_reconnects++;
+            continue;
+        }
+
+        now = esp_timer_get_time();
+        if (now >= next_hb_us) {
+            publish_heartbeat(hb_seq++);
+            next_hb_us = now + (int64_t)CONFIG_AQ_MQTT_HEARTBEAT_MS * 1000;
+        }
+    }
+
+    if (s_connected) {
+        disconnect_session(true);
+    }
+    s_task = NULL;
+    vTaskDelete(NULL);
+}
+
+esp_err_t mqtt_service_start_aq(esp_netif_t *netif) {
+    if (netif == NULL) return ESP_ERR_INVALID_ARG;
+    if (s_task) return ESP_ERR_INVALID_STATE;
+
+    init_once();
+    s_netif = netif;
+    s_run = true;
+    BaseType_t ok = xTaskCreatePinnedToCore(mqtt_task, "mqtt_aq", 4096, NULL, CONFIG_AQ_MQTT_TASK_PRIO,
+                                            &s_task, MQTT_TASK_CORE_AQ);
+    if (ok != pdPASS) {
+        s_run = false;
+        s_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "MQTT service started, broker %s:%d, prefix %s", CONFIG_AQ_MQTT_BROKER_HOST,
+             CONFIG_AQ_MQTT_BROKER_PORT, s_prefix);
+    return ESP_OK;
+}
+
+esp_err_t mqtt_service_stop_aq(void) {
+    if (s_task == NULL) return ESP_ERR_INVALID_STATE;
+    s_run = false;
+    // La tarea sale en como mucho un ciclo de select (1 s) o un backoff
+    for (int i = 0; i < 100 && s_task; i++) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    return s_task ? ESP_ERR_TIMEOUT : ESP_OK;
+}
+
+bool mqtt_service_is_connected_aq(void) {
+    return s_connected;
+}
+
+uint8_t mqtt_service_topic_aq(const char *suffix) {
+    init_once();
+    xSemaphoreTakeRecursive(s_lock, portMAX_DELAY);
+    uint8_t id = mqtt_topic_intern_aq(suffix);
+    xSemaphoreGiveRecursive(s_lock);
+    return id;
+}
+
+esp_err_t mqtt_service_publish_aq(uint8_t topic, const void *payload, size_t len,
+                                  uint8_t qos, bool retain) {
+    if (!s_connected) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTakeRecursive(s_lock, portMAX_DELAY);
+    esp_err_t err = mqtt_session_publish_aq(topic, payload, len, qos, retain);
+    xSemaphoreGiveRecursive(s_lock);
+    return err;
+}
+
+esp_err_t mqtt_service_subscribe_aq(const char *filter, mqtt_service_msg_cb_aq_t cb, void *ctx) {
+    if (filter == NULL || cb == NULL) return ESP_ERR_INVALID_ARG;
+    init_once();
+    if (strlen(s_prefix) + strlen(filter) >= MQTT_FILTER_MAX_AQ) return ESP_ERR_INVALID_SIZE;
+
+    esp_err_t err = ESP_OK;
+    xSemaphoreTakeRecursive(s_lock, portMAX_DELAY);
+    if (s_sub_count >= CONFIG_AQ_MQTT_MAX_SUBS) {
+        err = ESP_ERR_NO_MEM;
+    } else {
+        sub_entry_t *e = &s_subs[s_sub_count++];
+        char *p = put_str(put_str(e->filter, s_prefix), filter);
+        *p = '\0';
+        e->cb = cb;
+        e->ctx = ctx;
+        if (mqtt_session_is_open_aq()) {
+            err = mqtt_session_subscribe_aq(e->filter, 1);
+        }
+    }
+    xSemaphoreGiveRecursive(s_lock);
+    return err;
+}
+
+void mqtt_service_get_stats_aq(mqtt_service_stats_aq_t *out) {
+    mqtt_session_get_stats_aq(out);
+    out->reconnects = s_reconnects;
+    out->heartbeats = s_heartbeats;
+}
+
+void mqtt_service_reset_stats_aq(void) {
+    mqtt_session_reset_stats_aq();
+    s_reconnects = 0;
+    s_heartbeats = 0;
+}
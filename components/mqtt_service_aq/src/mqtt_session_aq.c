@@ -0,0 +1,356 @@
+#include "mqtt_session_aq.h"
+#include <errno.h>
+#include <stdatomic.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include "mqtt_topic_aq.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "mqtt_session_aq";
+
+typedef struct {
+    uint16_t pkt_id;   // 0 = libre
+    uint16_t len;
+    uint8_t data[CONFIG_AQ_MQTT_SLOT_SIZE];
+} qos1_slot_t;
+
+static int s_fd = -1;
+static mqtt_session_msg_cb_aq_t s_on_msg;
+static uint8_t s_rx[CONFIG_AQ_MQTT_RX_BUF_SIZE];
+static size_t s_rx_len;
+static qos1_slot_t s_slots[CONFIG_AQ_MQTT_QOS1_SLOTS];
+static uint16_t s_next_id = 1;
+static uint16_t s_keepalive_s;
+static int64_t s_last_tx_us;
+static int64_t s_ping_sent_us;   // 0 = sin PINGREQ pendiente
+static bool s_broken;            // fallo de envío: el siguiente poll fuerza la reconexión
+
+// Contadores leídos desde otras tareas sin el mutex del servicio
+static struct {
+    atomic_uint_least32_t published;
+    atomic_uint_least32_t bytes;
+    atomic_uint_least32_t failures;
+    atomic_uint_least32_t acked;
+    atomic_uint_least32_t resent;
+    atomic_uint_least32_t received;
+    atomic_uint_least32_t pings;
+    atomic_uint_least32_t publish_us[MQTT_SERVICE_LAT_BUCKETS_AQ];
+} s_st;
+
+static inline void st_add(atomic_uint_least32_t *c, uint32_t v) {
+    atomic_fetch_add_explicit(c, v, memory_order_relaxed);
+}
+
+static inline uint32_t st_get(atomic_uint_least32_t *c) {
+    return atomic_load_explicit(c, memory_order_relaxed);
+}
+
+static void st_latency(uint32_t us) {
+    int b = 0;
+    while (us > 1 && b < MQTT_SERVICE_LAT_BUCKETS_AQ - 1) {
+        us >>= 1;
+        b++;
+    }
+    st_add(&s_st.publish_us[b], 1);
+}
+
+static uint16_t next_pkt_id(void) {
+    uint16_t id = s_next_id++;
+    if (s_next_id == 0) s_next_id = 1;
+    return id;
+}
+
+// Envía el iovec completo. Una escritura parcial seguida de timeout deja el stream
+// a medias, así que cualquier fallo invalida la sesión.
+static esp_err_t send_iov(struct iovec *iov, int iovcnt) {
+    while (iovcnt > 0) {
+        struct msghdr msg = {
+            .msg_iov = iov,
+            .msg_iovlen = iovcnt,
+        };
+        ssize_t n = sendmsg(s_fd, &msg, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ESP_LOGW(TAG, "sendmsg failed: errno %d", errno);
+            s_broken = true;
+            return ESP_FAIL;
+        }
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    s_last_tx_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+static esp_err_t send_buf(const void *buf, size_t len) {
+    struct iovec iov = {.iov_base = (void *)buf, .iov_len = len};
+    return send_iov(&iov, 1);
+}
+
+void mqtt_session_init_aq(mqtt_session_msg_cb_aq_t on_msg) {
+    s_on_msg = on_msg;
+    s_fd = -1;
+    memset(s_slots, 0, sizeof(s_slots));
+}
+
+bool mqtt_session_is_open_aq(void) {
+    return s_fd >= 0;
+}
+
+static esp_err_t resend_inflight(void) {
+    for (int i = 0; i < CONFIG_AQ_MQTT_QOS1_SLOTS; i++) {
+        if (s_slots[i].pkt_id == 0) continue;
+        s_slots[i].data[0] |= MQTT_PUBLISH_DUP;
+        if (send_buf(s_slots[i].data, s_slots[i].len) != ESP_OK) return ESP_FAIL;
+        st_add(&s_st.resent, 1);
+    }
+    return ESP_OK;
+}
+
+esp_err_t mqtt_session_open_aq(int fd, const mqtt_connect_opts_aq_t *opts, uint32_t timeout_ms) {
+    uint8_t buf[256];
+    size_t n = mqtt_encode_connect_aq(buf, sizeof(buf), opts);
+    if (n == 0) return ESP_ERR_INVALID_SIZE;
+
+    s_fd = fd;
+    s_rx_len = 0;
+    s_ping_sent_us = 0;
+    s_broken = false;
+    s_keepalive_s = opts->keepalive_s;
+    if (send_buf(buf, n) != ESP_OK) goto fail;
+
+    // CONNACK: 4 bytes, [0x20][0x02][session present][return code]
+    int64_t deadline = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    while (s_rx_len < 4) {
+        int64_t left_us = deadline - esp_timer_get_time();
+        if (left_us <= 0) {
+            ESP_LOGW(TAG, "CONNACK timeout");
+            goto fail;
+        }
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(fd, &rfds);
+        struct timeval tv = {.tv_sec = left_us / 1000000, .tv_usec = left_us % 1000000};
+        if (select(fd + 1, &rfds, NULL, NULL, &tv) <= 0) continue;
+        ssize_t r = recv(fd, s_rx + s_rx_len, 4 - s_rx_len, 0);
+        if (r <= 0) goto fail;
+        s_rx_len += r;
+    }
+    if (s_rx[0] != (MQTT_PKT_CONNACK << 4) || s_rx[1] != 2 || s_rx[3] != 0) {
+        ESP_LOGE(TAG, "Broker refused connection (rc %u)", s_rx[3]);
+        goto fail;
+    }
+    s_rx_len = 0;
+    if (resend_inflight() != ESP_OK) goto fail;
+    return ESP_OK;
+
+fail:
+    s_fd = -1;
+    return ESP_FAIL;
+}
+
+void mqtt_session_close_aq(bool graceful) {
+    if (s_fd < 0) return;
+    if (graceful) {
+        uint8_t buf[2];
+        send_buf(buf, mqtt_encode_simple_aq(buf, sizeof(buf), MQTT_PKT_DISCONNECT));
+    }
+    // El socket lo cierra el dueño (mqtt_service_aq.c); los QoS1 pendientes se conservan
+    s_fd = -1;
+}
+
+esp_err_t mqtt_session_publish_aq(uint8_t topic_id, const void *payload, size_t len,
+                                  uint8_t qos, bool retain) {
+    if (s_fd < 0 || s_broken) return ESP_ERR_INVALID_STATE;
+    if (qos > 1) return ESP_ERR_NOT_SUPPORTED;
+    size_t topic_len;
+    const uint8_t *topic = mqtt_topic_encoded_aq(topic_id, &topic_len);
+    if (topic == NULL) return ESP_ERR_INVALID_ARG;
+
+    int64_t t0 = esp_timer_get_time();
+    uint8_t hdr[MQTT_FIXED_HDR_MAX];
+    size_t hdr_len = mqtt_encode_publish_fixed_aq(hdr, qos, retain, topic_len, len);
+    if (hdr_len == 0) return ESP_ERR_INVALID_SIZE;
+    esp_err_t err;
+
+    if (qos == 0) {
+        struct iovec iov[3] = {
+            {.iov_base = hdr, .iov_len = hdr_len},
+            {.iov_base = (void *)topic, .iov_len = topic_len},
+            {.iov_base = (void *)payload, .iov_len = len},
+        };
+        err = send_iov(iov, len ? 3 : 2);
+    } else {
+        size_t total = hdr_len + topic_len + 2 + len;
+        if (total > CONFIG_AQ_MQTT_SLOT_SIZE) return ESP_ERR_INVALID_SIZE;
+        qos1_slot_t *slot = NULL;
+        for (int i = 0; i < CONFIG_AQ_MQTT_QOS1_SLOTS; i++) {
+            if (s_slots[i].pkt_id == 0) {
+                slot = &s_slots[i];
+                break;
+            }
+        }
+        if (slot == NULL) {
+            st_add(&s_st.failures, 1);
+            return ESP_ERR_NO_MEM;  // ventana QoS1 llena, reintentar tras los PUBACK
+        }
+        uint16_t id = next_pkt_id();
+        uint8_t *p = slot->data;
+        memcpy(p, hdr, hdr_len);
+        p += hdr_len;
+        memcpy(p, topic, topic_len);
+        p += topic_len;
+        *p++ = id >> 8;
+        *p++ = id & 0xff;
+        memcpy(p, payload, len);
+        slot->len = (uint16_t)total;
+        slot->pkt_id = id;
+        // Si falla el envío el slot se queda y se reenvía al reconectar
+        err = send_buf(slot->data, slot->len);
+    }
+
+    if (err != ESP_OK) {
+        st_add(&s_st.failures, 1);
+        return err;
+    }
+    st_add(&s_st.published, 1);
+    st_add(&s_st.bytes, (uint32_t)len);
+    st_latency((uint32_t)(esp_timer_get_time() - t0));
+    return ESP_OK;
+}
+
+esp_err_t mqtt_session_subscribe_aq(const char *filter, uint8_t qos) {
+    if (s_fd < 0) return ESP_ERR_INVALID_STATE;
+    uint8_t buf[160];
+    size_t n = mqtt_encode_subscribe_aq(buf, sizeof(buf), next_pkt_id(), filter, qos);
+    if (n == 0) return ESP_ERR_INVALID_SIZE;
+    return send_buf(buf, n);
+}
+
+static esp_err_t handle_packet(const mqtt_packet_aq_t *pkt) {
+    switch (pkt->type) {
+    case MQTT_PKT_PUBACK:
+        if (pkt->len >= 2) {
+            uint16_t id = (uint16_t)((pkt->body[0] << 8) | pkt->body[1]);
+            for (int i = 0; i < CONFIG_AQ_MQTT_QOS1_SLOTS; i++) {
+                if (s_slots[i].pkt_id == id) {
+                    s_slots[i].pkt_id = 0;
+                    st_add(&s_st.acked, 1);
+                    break;
+                }
+            }
+        }
+        break;
+    case MQTT_PKT_PINGRESP:
+        s_ping_sent_us = 0;
+        break;
+    case MQTT_PKT_PUBLISH: {
+        const char *topic;
+        uint16_t topic_len, id;
+        const uint8_t *payload;
+        size_t payload_len;
+        if (!mqtt_parse_publish_aq(pkt, &topic, &topic_len, &id, &payload, &payload_len)) {
+            return ESP_FAIL;
+        }
+        st_add(&s_st.received, 1);
+        if (s_on_msg) s_on_msg(topic, topic_len, payload, payload_len);
+        if (id) {
+            uint8_t ack[4];
+            return send_buf(ack, mqtt_encode_puback_aq(ack, sizeof(ack), id));
+        }
+        break;
+    }
+    case MQTT_PKT_SUBACK:
+        if (pkt->len >= 3 && pkt->body[2] == 0x80) {
+            ESP_LOGW(TAG, "Subscription rejected by broker");
+        }
+        break;
+    default:
+        break;
+    }
+    return ESP_OK;
+}
+
+esp_err_t mqtt_session_poll_aq(void) {
+    if (s_fd < 0) return ESP_ERR_INVALID_STATE;
+    if (s_broken) return ESP_FAIL;
+
+    for (;;) {
+        ssize_t r = recv(s_fd, s_rx + s_rx_len, sizeof(s_rx) - s_rx_len, MSG_DONTWAIT);
+        if (r == 0) return ESP_FAIL;  // el broker cerró
+        if (r < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR) continue;
+            return ESP_FAIL;
+        }
+        s_rx_len += r;
+
+        size_t off = 0;
+        for (;;) {
+            mqtt_packet_aq_t pkt;
+            size_t used;
+            int rc = mqtt_parse_aq(s_rx + off, s_rx_len - off, &pkt, &used);
+            if (rc < 0) return ESP_FAIL;
+            if (rc == 0) break;
+            if (handle_packet(&pkt) != ESP_OK) return ESP_FAIL;
+            off += used;
+        }
+        if (off) {
+            memmove(s_rx, s_rx + off, s_rx_len - off);
+            s_rx_len -= off;
+        } else if (s_rx_len == sizeof(s_rx)) {
+            ESP_LOGE(TAG, "Incoming packet larger than RX buffer (%u)", (unsigned)sizeof(s_rx));
+            return ESP_FAIL;
+        }
+    }
+
+    // Keepalive: PINGREQ a mitad de periodo sin tráfico; sin PINGRESP en un periodo = caída
+    if (s_keepalive_s) {
+        int64_t now = esp_timer_get_time();
+        int64_t ka_us = (int64_t)s_keepalive_s * 1000000;
+        if (s_ping_sent_us && now - s_ping_sent_us > ka_us) {
+            ESP_LOGW(TAG, "No PINGRESP from broker");
+            return ESP_FAIL;
+        }
+        if (!s_ping_sent_us && now - s_last_tx_us > ka_us / 2) {
+            uint8_t buf[2];
+            if (send_buf(buf, mqtt_encode_simple_aq(buf, sizeof(buf), MQTT_PKT_PINGREQ)) != ESP_OK) {
+                return ESP_FAIL;
+            }
+            s_ping_sent_us = now;
+            st_add(&s_st.pings, 1);
+        }
+    }
+    return ESP_OK;
+}
+
+void mqtt_session_get_stats_aq(mqtt_service_stats_aq_t *out) {
+    out->published = st_get(&s_st.published);
+    out->published_bytes = st_get(&s_st.bytes);
+    out->publish_failures = st_get(&s_st.failures);
+    out->qos1_acked = st_get(&s_st.acked);
+    out->qos1_resent = st_get(&s_st.resent);
+    out->received = st_get(&s_st.received);
+    out->pings = st_get(&s_st.pings);
+    uint32_t inflight = 0;
+    for (int i = 0; i < CONFIG_AQ_MQTT_QOS1_SLOTS; i++) {
+        if (s_slots[i].pkt_id) inflight++;
+    }
+    out->qos1_inflight = inflight;
+    for (int i = 0; i < MQTT_SERVICE_LAT_BUCKETS_AQ; i++) {
+        out->publish_us[i] = st_get(&s_st.publish_us[i]);
+    }
+}
+
+void mqtt_session_reset_stats_aq(void) {
+    memset(&s_st, 0, sizeof(s_st));
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "mqtt_codec_aq.h"
+#include "mqtt_service_aq.h"
+
+// Sesión MQTT sobre un socket TCP ya conectado. Sin memoria dinámica:
+// buffer RX y slots QoS1 estáticos. No es thread-safe; mqtt_service_aq.c
+// serializa las llamadas con su mutex.
+
+typedef void (*mqtt_session_msg_cb_aq_t)(const char *topic, uint16_t topic_len,
+                                          const uint8_t *payload, size_t len);
+
+void      mqtt_session_init_aq(mqtt_session_msg_cb_aq_t on_msg);
+// Envía CONNECT y espera CONNACK. Reenvía (DUP) los QoS1 pendientes de la sesión anterior.
+esp_err_t mqtt_session_open_aq(int fd, const mqtt_connect_opts_aq_t *opts, uint32_t timeout_ms);
+void      mqtt_session_close_aq(bool graceful);
+bool      mqtt_session_is_open_aq(void);
+
+// QoS0: una sola sendmsg con [cabecera fija][topic internado][payload], sin copias.
+// QoS1: el paquete se copia a un slot para poder reenviarlo tras reconectar.
+esp_err_t mqtt_session_publish_aq(uint8_t topic_id, const void *payload, size_t len,
+                                  uint8_t qos, bool retain);
+esp_err_t mqtt_session_subscribe_aq(const char *filter, uint8_t qos);
+// Lee lo disponible sin bloquear, despacha mensajes y mantiene el keepalive.
+// Devuelve error si la conexión se ha perdido.
+esp_err_t mqtt_session_poll_aq(void);
+
+void      mqtt_session_get_stats_aq(mqtt_service_stats_aq_t *out);
+void      mqtt_session_reset_stats_aq(void);
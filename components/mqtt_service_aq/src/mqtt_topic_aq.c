@@ -0,0 +1,57 @@
+#include "mqtt_topic_aq.h"
+#include <string.h>
+#include "sdkconfig.h"
+
+typedef struct {
+    uint16_t off;  // offset en el arena de la cadena codificada
+    uint16_t len;  // longitud codificada (2 + topic)
+} topic_entry_t;
+
+static uint8_t s_arena[CONFIG_AQ_MQTT_TOPIC_ARENA];
+static size_t s_arena_used;
+static topic_entry_t s_topics[CONFIG_AQ_MQTT_MAX_TOPICS];
+static uint8_t s_count;
+static char s_prefix[MQTT_TOPIC_PREFIX_MAX_AQ];
+static size_t s_prefix_len;
+
+void mqtt_topic_init_aq(const char *prefix) {
+    s_arena_used = 0;
+    s_count = 0;
+    s_prefix_len = strnlen(prefix, sizeof(s_prefix) - 1);
+    memcpy(s_prefix, prefix, s_prefix_len);
+    s_prefix[s_prefix_len] = '\0';
+}
+
+uint8_t mqtt_topic_intern_aq(const char *suffix) {
+    size_t suffix_len = strlen(suffix);
+    size_t topic_len = s_prefix_len + suffix_len;
+
+    // Búsqueda lineal: la tabla es pequeña y solo se recorre al internar, no al publicar
+    for (uint8_t i = 0; i < s_count; i++) {
+        const uint8_t *e = s_arena + s_topics[i].off;
+        if (s_topics[i].len == topic_len + 2 && memcmp(e + 2 + s_prefix_len, suffix, suffix_len) == 0) {
+            return i;
+        }
+    }
+
+    if (s_count >= CONFIG_AQ_MQTT_MAX_TOPICS || topic_len > UINT16_MAX ||
+        s_arena_used + topic_len + 2 > sizeof(s_arena)) {
+        return MQTT_TOPIC_INVALID_AQ;
+    }
+
+    uint8_t *p = s_arena + s_arena_used;
+    p[0] = topic_len >> 8;
+    p[1] = topic_len & 0xff;
+    memcpy(p + 2, s_prefix, s_prefix_len);
+    memcpy(p + 2 + s_prefix_len, suffix, suffix_len);
+    s_topics[s_count].off = (uint16_t)s_arena_used;
+    s_topics[s_count].len = (uint16_t)(topic_len + 2);
+    s_arena_used += topic_len + 2;
+    return s_count++;
+}
+
+const uint8_t *mqtt_topic_encoded_aq(uint8_t id, size_t *enc_len) {
+    if (id >= s_count) return NULL;
+    *enc_len = s_topics[id].len;
+    return s_arena + s_topics[id].off;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Tabla de topics internados. Cada topic se guarda una sola vez ya codificado
+// como cadena MQTT ([len16][prefijo][sufijo]) en un arena estático, así publicar
+// no formatea ni copia el topic: se envía directamente desde el arena.
+// MQTT 3.1.1 no tiene topic aliases; esto es el equivalente en el lado del cliente.
+
+#define MQTT_TOPIC_INVALID_AQ    0xff
+#define MQTT_TOPIC_PREFIX_MAX_AQ 64   // con el terminador
+
+void    mqtt_topic_init_aq(const char *prefix);
+// Devuelve el id (>=0) del topic "<prefijo><suffix>", creándolo si no existe;
+// MQTT_TOPIC_INVALID_AQ si la tabla o el arena están llenos.
+uint8_t mqtt_topic_intern_aq(const char *suffix);
+// Topic codificado listo para el iovec; NULL si el id no existe
+const uint8_t *mqtt_topic_encoded_aq(uint8_t id, size_t *enc_len);
@@ -0,0 +1,494 @@
+// Benchmark de host (Linux) del receptor OTA de ota_aq, y emisor de pruebas.
+//
+// Compila ota_stream_aq.c y ota_proto_aq.c reales sobre sockets POSIX y FreeRTOS
+// simulado con pthreads. Un hilo emisor local (el papel del MASTER) sirve una imagen
+// por TCP en loopback limitando el caudal al del enlace USB; el receptor escribe en una
+// flash simulada con tiempos de borrado de sector y programación de página. Compara:
+//   - ingenua: borrado de toda la región al empezar y luego recv -> SHA256 -> escritura
+//   - serie: igual pero borrando cada sector al llegar a él
+//   - pipeline de ota_stream_aq con 2 (doble buffer) y 4 buffers
+// y comprueba casos de error (SHA incorrecto, imagen truncada, cabecera inválida).
+//
+// Con -S fichero hace solo de emisor: escucha en -l puerto y sirve el fichero al panel
+// real que se conecte (ota_start_aq con la IP de este host).
+//
+// Con -C solo comprueba: los casos de error y una transferencia por modo sin límite de
+// caudal ni tiempos de flash. Es lo que ejecuta ctest.
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <openssl/evp.h>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include "mbedtls/sha256.h"
+#include "ota_proto_aq.h"
+#include "ota_stream_aq.h"
+
+#define SECTOR_SIZE 4096
+#define PAGE_SIZE   256
+
+// ---------- flash simulada ----------
+
+typedef struct {
+    uint8_t *mem;
+    uint32_t size;
+    uint32_t pos;
+    uint32_t erased_to;      // borrado secuencial como OTA_WITH_SEQUENTIAL_WRITES
+    uint32_t erase_us;       // por sector de 4 KiB
+    uint32_t page_us;        // por página de 256 B
+    bool erase_upfront;      // esp_ota_begin(tamaño): borra todo antes de recibir nada
+    int finish_calls;
+    bool committed;
+} sim_flash_t;
+
+static void sleep_us(uint64_t us) {
+    struct timespec ts = { .tv_sec = (time_t)(us / 1000000), .tv_nsec = (long)(us % 1000000) * 1000 };
+    while (nanosleep(&ts, &ts) != 0) {
+    }
+}
+
+static esp_err_t flash_begin(void *ctx, uint32_t image_size) {
+    sim_flash_t *f = ctx;
+    if (image_size > f->size) return ESP_ERR_INVALID_SIZE;
+    f->pos = 0;
+    f->erased_to = 0;
+    f->finish_calls = 0;
+    f->committed = false;
+    if (f->erase_upfront) {
+        uint32_t sectors = (image_size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+        f->erased_to = sectors * SECTOR_SIZE;
+        sleep_us((uint64_t)sectors * f->erase_us);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t flash_write(void *ctx, const void *data, size_t len) {
+    sim_flash_t *f = ctx;
+    if (f->pos + len > f->size) return ESP_ERR_INVALID_SIZE;
+    uint64_t cost = 0;
+    while (f->erased_to < f->pos + len) {
+        f->erased_to += SECTOR_SIZE;
+        cost += f->erase_us;
+    }
+    cost += (uint64_t)((len + PAGE_SIZE - 1) / PAGE_SIZE) * f->page_us;
+    memcpy(f->mem + f->pos, data, len);
+    f->pos += (uint32_t)len;
+    if (cost) sleep_us(cost);
+    return ESP_OK;
+}
+
+static esp_err_t flash_finish(void *ctx, bool commit) {
+    sim_flash_t *f = ctx;
+    f->finish_calls++;
+    f->committed = commit;
+    return ESP_OK;
+}
+
+// ---------- emisor (MASTER) ----------
+
+// Ventana TCP del receptor. En loopback Linux acepta megas en el buffer del socket, lo
+// que haría de pipeline gratuito; el panel tiene la ventana de lwIP (TCP_WND, ~5.7 KiB).
+// Linux duplica el valor pedido, así que se pide la mitad.
+static int s_window = 5760;
+
+static void set_buf(int fd, int opt) {
+    int half = s_window / 2;
+    if (s_window) setsockopt(fd, SOL_SOCKET, opt, &half, sizeof(half));
+}
+
+typedef struct {
+    int listen_fd;
+    const uint8_t *image;
+    uint32_t size;
+    uint32_t rate_kbps;        // 0 = sin límite
+    uint32_t truncate_at;      // cerrar tras N bytes de imagen (0 = completa)
+    bool corrupt_sha;
+    bool bad_magic;
+    // resultados
+    esp_err_t status;
+    bool got_result;
+    bool sha_match;
+} sender_t;
+
+static void sha256(const uint8_t *data, size_t len, uint8_t out[32]) {
+    EVP_Digest(data, len, out, NULL, EVP_sha256(), NULL);
+}
+
+// Limita al caudal del enlace sin ráfagas de recuperación: si el receptor se paró, el
+// tiempo perdido no se recupera (un enlace de 12 Mbit/s no puede ir más rápido después)
+static int send_paced(int fd, const uint8_t *buf, size_t len, uint32_t rate_kbps, int64_t *due_us) {
+    while (len) {
+        size_t n = len < 1460 ? len : 1460;
+        ssize_t w = send(fd, buf, n, MSG_NOSIGNAL);
+        if (w <= 0) return -1;
+        buf += w;
+        len -= (size_t)w;
+        if (rate_kbps) {
+            int64_t now = esp_timer_get_time();
+            if (*due_us < now) *due_us = now;
+            *due_us += (int64_t)w * 8000 / rate_kbps;
+            if (*due_us > now + 1000) sleep_us((uint64_t)(*due_us - now));
+        }
+    }
+    return 0;
+}
+
+static void *sender_thread(void *arg) {
+    sender_t *s = arg;
+    s->got_result = false;
+    int fd = accept(s->listen_fd, NULL, NULL);
+    if (fd < 0) return NULL;
+    set_buf(fd, SO_SNDBUF);
+
+    ota_header_aq_t hdr = { .image_size = s->size };
+    sha256(s->image, s->size, hdr.sha256);
+    uint8_t expected[32];
+    memcpy(expected, hdr.sha256, 32);
+    if (s->corrupt_sha) hdr.sha256[0] ^= 0xff;
+    uint8_t raw[OTA_HDR_LEN_AQ];
+    ota_header_encode_aq(&hdr, raw);
+    if (s->bad_magic) raw[0] ^= 0xff;
+
+    int64_t due = 0;
+    uint32_t len = s->truncate_at ? s->truncate_at : s->size;
+    if (send_paced(fd, raw, sizeof(raw), s->rate_kbps, &due) == 0 &&
+        send_paced(fd, s->image, len, s->rate_kbps, &due) == 0) {
+        if (s->truncate_at) shutdown(fd, SHUT_WR);
+        uint8_t rr[OTA_RESULT_LEN_AQ];
+        size_t got = 0;
+        while (got < sizeof(rr)) {
+            ssize_t n = recv(fd, rr + got, sizeof(rr) - got, 0);
+            if (n <= 0) break;
+            got += (size_t)n;
+        }
+        ota_result_aq_t res;
+        if (got == sizeof(rr) && ota_result_decode_aq(rr, &res) == ESP_OK) {
+            s->got_result = true;
+            s->status = res.status;
+            s->sha_match = memcmp(res.sha256, expected, 32) == 0;
+        }
+    }
+    close(fd);
+    return NULL;
+}
+
+static int listen_on(uint16_t port, uint32_t addr, uint16_t *bound) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    // Heredado por el socket aceptado; hay que fijarlo antes de listen
+    set_buf(fd, SO_RCVBUF);
+    struct sockaddr_in sa = { .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = addr };
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0 || listen(fd, 1) != 0) {
+        perror("listen");
+        exit(2);
+    }
+    socklen_t sl = sizeof(sa);
+    getsockname(fd, (struct sockaddr *)&sa, &sl);
+    *bound = ntohs(sa.sin_port);
+    return fd;
+}
+
+static int connect_to(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    set_buf(fd, SO_RCVBUF);
+    struct sockaddr_in sa = { .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    struct timeval to = { .tv_sec = 5 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &to, sizeof(to));
+    if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+        perror("connect");
+        exit(2);
+    }
+    return fd;
+}
+
+// ---------- receptores ----------
+
+// Implementación ingenua para comparar: todo en una tarea, sin solape
+static esp_err_t run_serial(int sock, size_t chunk, const ota_sink_aq_t *sink, ota_stats_aq_t *st) {
+    memset(st, 0, sizeof(*st));
+    int64_t start = esp_timer_get_time();
+    uint8_t raw[OTA_HDR_LEN_AQ];
+    ota_header_aq_t hdr;
+    if (recv(sock, raw, sizeof(raw), MSG_WAITALL) != (ssize_t)sizeof(raw) || ota_header_decode_aq(raw, &hdr) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    uint8_t *buf = malloc(chunk);
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    esp_err_t err = sink->begin(sink->ctx, hdr.image_size);
+    uint32_t remaining = hdr.image_size;
+    while (err == ESP_OK && remaining) {
+        size_t len = remaining < chunk ? remaining : chunk;
+        int64_t t0 = esp_timer_get_time();
+        if (recv(sock, buf, len, MSG_WAITALL) != (ssize_t)len) {
+            err = ESP_FAIL;
+            break;
+        }
+        st->recv_us += (uint32_t)(esp_timer_get_time() - t0);
+        t0 = esp_timer_get_time();
+        mbedtls_sha256_update(&sha, buf, len);
+        st->hash_us += (uint32_t)(esp_timer_get_time() - t0);
+        t0 = esp_timer_get_time();
+        err = sink->write(sink->ctx, buf, len);
+        st->flash_us += (uint32_t)(esp_timer_get_time() - t0);
+        st->bytes += (uint32_t)len;
+        remaining -= (uint32_t)len;
+    }
+    ota_result_aq_t res = { .bytes = st->bytes };
+    mbedtls_sha256_finish(&sha, res.sha256);
+    mbedtls_sha256_free(&sha);
+    if (err == ESP_OK && memcmp(res.sha256, hdr.sha256, 32) != 0) err = ESP_ERR_INVALID_CRC;
+    sink->finish(sink->ctx, err == ESP_OK);
+    res.status = err;
+    ota_result_encode_aq(&res, raw);
+    send(sock, raw, OTA_RESULT_LEN_AQ, MSG_NOSIGNAL);
+    free(buf);
+    st->result = err;
+    st->total_us = (uint32_t)(esp_timer_get_time() - start);
+    st->kbps = (uint32_t)((uint64_t)st->bytes * 8000 / st->total_us);
+    return err;
+}
+
+typedef struct {
+    int sock;
+    int buffers;               // 0 = serie
+    ota_stream_cfg_aq_t cfg;
+    ota_sink_aq_t sink;
+    ota_stats_aq_t stats;
+    esp_err_t err;
+    QueueHandle_t done;
+} recv_job_t;
+
+static void receiver_task(void *arg) {
+    recv_job_t *j = arg;
+    if (j->buffers == 0) {
+        j->err = run_serial(j->sock, j->cfg.chunk_size, &j->sink, &j->stats);
+    } else {
+        j->err = ota_stream_run_aq(j->sock, &j->cfg, &j->sink, &j->stats);
+    }
+    int one = 1;
+    xQueueSend(j->done, &one, portMAX_DELAY);
+    vTaskDelete(NULL);
+}
+
+typedef struct {
+    uint32_t size;
+    uint32_t rate_kbps;
+    uint32_t erase_us;
+    uint32_t page_us;
+    size_t chunk;
+} bench_cfg_t;
+
+static uint8_t *s_image;
+static sim_flash_t s_flash;
+
+static esp_err_t run_one(const bench_cfg_t *bc, int buffers, bool erase_upfront, sender_t *snd,
+                         ota_stats_aq_t *out) {
+    uint16_t port;
+    snd->listen_fd = listen_on(0, htonl(INADDR_LOOPBACK), &port);
+    snd->image = s_image;
+    snd->size = bc->size;
+    snd->rate_kbps = bc->rate_kbps;
+    pthread_t th;
+    pthread_create(&th, NULL, sender_thread, snd);
+
+    s_flash.erase_us = bc->erase_us;
+    s_flash.page_us = bc->page_us;
+    s_flash.erase_upfront = erase_upfront;
+    memset(s_flash.mem, 0xff, s_flash.size);
+    recv_job_t j = {
+        .sock = connect_to(port),
+        .buffers = buffers,
+        .cfg = {
+            .chunk_size = bc->chunk,
+            .buffers = (uint8_t)buffers,
+            .writer_prio = 4,
+            .writer_core = -1,
+        },
+        .sink = { flash_begin, flash_write, flash_finish, &s_flash },
+        .done = xQueueCreate(1, sizeof(int)),
+    };
+    xTaskCreate(receiver_task, "ota_rx", 4096, &j, 5, NULL);
+    int one;
+    xQueueReceive(j.done, &one, portMAX_DELAY);
+    vQueueDelete(j.done);
+    close(j.sock);
+    pthread_join(th, NULL);
+    close(snd->listen_fd);
+    *out = j.stats;
+    return j.err;
+}
+
+static int s_failures;
+
+static void check(bool cond, const char *what) {
+    if (!cond) {
+        printf("FAIL: %s\n", what);
+        s_failures++;
+    }
+}
+
+static void print_result(const char *mode, const bench_cfg_t *bc, const ota_stats_aq_t *st) {
+    printf("RESULT mode=%s size=%u link_kbps=%u erase_us=%u page_us=%u total_ms=%.1f kbps=%u "
+           "recv_ms=%.1f hash_ms=%.1f flash_ms=%.1f rx_stall_ms=%.1f writer_idle_ms=%.1f\n",
+           mode, bc->size, bc->rate_kbps, bc->erase_us, bc->page_us, st->total_us / 1000.0, st->kbps,
+           st->recv_us / 1000.0, st->hash_us / 1000.0, st->flash_us / 1000.0,
+           st->rx_stall_us / 1000.0, st->writer_idle_us / 1000.0);
+}
+
+static void run_bench(const bench_cfg_t *bc) {
+    static const struct { const char *name; int buffers; bool erase_upfront; } modes[] = {
+        { "naive", 0, true }, { "serial", 0, false }, { "double_buffer", 2, false }, { "pipeline_4", 4, false },
+    };
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        sender_t snd = { 0 };
+        ota_stats_aq_t st;
+        esp_err_t err = run_one(bc, modes[m].buffers, modes[m].erase_upfront, &snd, &st);
+        check(err == ESP_OK && snd.got_result && snd.status == ESP_OK && snd.sha_match, "transfer result");
+        check(s_flash.pos == bc->size && memcmp(s_flash.mem, s_image, bc->size) == 0, "flash contents");
+        check(s_flash.finish_calls == 1 && s_flash.committed, "image committed");
+        print_result(modes[m].name, bc, &st);
+    }
+}
+
+static void run_error_cases(const bench_cfg_t *base) {
+    bench_cfg_t bc = *base;
+    bc.size = 64 * 1024 + 123;
+    bc.rate_kbps = 0;
+    bc.erase_us = 0;
+    bc.page_us = 0;
+    ota_stats_aq_t st;
+
+    sender_t snd = { .corrupt_sha = true };
+    esp_err_t err = run_one(&bc, 2, false, &snd, &st);
+    check(err == ESP_ERR_INVALID_CRC && snd.got_result && snd.status == ESP_ERR_INVALID_CRC, "sha mismatch rejected");
+    check(s_flash.finish_calls == 1 && !s_flash.committed, "sha mismatch aborts image");
+
+    sender_t trunc = { .truncate_at = bc.size / 2 };
+    err = run_one(&bc, 2, false, &trunc, &st);
+    check(err == ESP_ERR_INVALID_SIZE && trunc.got_result && trunc.status == ESP_ERR_INVALID_SIZE, "truncated stream rejected");
+    check(s_flash.finish_calls == 1 && !s_flash.committed, "truncated stream aborts image");
+
+    sender_t magic = { .bad_magic = true };
+    err = run_one(&bc, 2, false, &magic, &st);
+    check(err == ESP_ERR_INVALID_ARG && !magic.got_result, "bad header rejected");
+
+    printf("RESULT error_cases=%s\n", s_failures ? "FAIL" : "ok");
+}
+
+// ---------- emisor para un panel real ----------
+
+static int serve_file(const char *path, uint16_t port, uint32_t rate_kbps) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return 2;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *img = malloc((size_t)size);
+    if (size <= 0 || img == NULL || fread(img, 1, (size_t)size, f) != (size_t)size) {
+        fprintf(stderr, "cannot read %s\n", path);
+        return 2;
+    }
+    fclose(f);
+
+    uint16_t bound;
+    sender_t snd = { .image = img, .size = (uint32_t)size, .rate_kbps = rate_kbps };
+    snd.listen_fd = listen_on(port, htonl(INADDR_ANY), &bound);
+    printf("serving %s (%ld bytes) on port %u, waiting for the panel...\n", path, size, bound);
+    int64_t t0 = esp_timer_get_time();
+    sender_thread(&snd);
+    double secs = (esp_timer_get_time() - t0) / 1e6;
+    close(snd.listen_fd);
+    free(img);
+    if (!snd.got_result) {
+        printf("no result from panel\n");
+        return 1;
+    }
+    printf("panel status %d, sha %s, %.2f s (%.0f kbit/s)\n", snd.status, snd.sha_match ? "match" : "MISMATCH",
+           secs, size * 8 / 1000.0 / secs);
+    return snd.status == 0 && snd.sha_match ? 0 : 1;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-z image_bytes] [-r link_kbps] [-E erase_us_per_4k] [-P program_us_per_256b] [-c chunk]\n"
+                    "          [-w tcp_window (0 = kernel default)] [-C]\n"
+                    "  -C only the checks, without link or flash timing (ctest)\n"
+                    "       %s -S image.bin [-l port] [-r kbps]    serve a real panel\n", prog, prog);
+}
+
+int main(int argc, char **argv) {
+    bench_cfg_t bc = {
+        .size = 1024 * 1024,
+        .rate_kbps = 12000,      // USB full speed
+        .erase_us = 18000,       // borrado de sector típico de la flash SPI del módulo
+        .page_us = 250,
+        .chunk = 4096,
+    };
+    const char *serve = NULL;
+    uint16_t port = 3232;
+    bool check_only = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "z:r:E:P:c:w:S:l:Ch")) != -1) {
+        switch (opt) {
+        case 'z': bc.size = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'r': bc.rate_kbps = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'E': bc.erase_us = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'P': bc.page_us = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'c': bc.chunk = strtoul(optarg, NULL, 0); break;
+        case 'w': s_window = atoi(optarg); break;
+        case 'S': serve = optarg; break;
+        case 'l': port = (uint16_t)strtoul(optarg, NULL, 0); break;
+        case 'C': check_only = true; break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (serve) return serve_file(serve, port, bc.rate_kbps);
+    if (bc.size == 0 || bc.chunk < 256) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    s_image = malloc(bc.size);
+    srand(1);
+    for (uint32_t i = 0; i < bc.size; i++) s_image[i] = (uint8_t)rand();
+    s_flash.size = bc.size + SECTOR_SIZE;
+    s_flash.mem = malloc(s_flash.size);
+
+    run_error_cases(&bc);
+    if (check_only) {
+        // Los cuatro modos deben escribir y confirmar la imagen; el tiempo no importa
+        bench_cfg_t quick = bc;
+        quick.rate_kbps = 0;
+        quick.erase_us = 0;
+        quick.page_us = 0;
+        run_bench(&quick);
+    } else {
+        run_bench(&bc);
+        // Sin flash: solo red + hash, para ver el coste del propio pipeline
+        bench_cfg_t fast = bc;
+        fast.erase_us = 0;
+        fast.page_us = 0;
+        run_bench(&fast);
+    }
+
+    free(s_image);
+    free(s_flash.mem);
+    if (s_failures) {
+        printf("FAILED: %d\n", s_failures);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <pthread.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+// Subconjunto de FreeRTOS sobre pthreads. Los ticks son milisegundos.
+typedef int32_t  BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+#define portMAX_DELAY        ((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ   1000
+#define configMAX_PRIORITIES 25
+#define pdMS_TO_TICKS(ms)    ((TickType_t)(ms))
+#define tskNO_AFFINITY       0x7FFFFFFF
+
+typedef pthread_mutex_t portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED PTHREAD_MUTEX_INITIALIZER
+#define taskENTER_CRITICAL(mux)      pthread_mutex_lock(mux)
+#define taskEXIT_CRITICAL(mux)       pthread_mutex_unlock(mux)
+#define taskENTER_CRITICAL_ISR(mux)  pthread_mutex_lock(mux)
+#define taskEXIT_CRITICAL_ISR(mux)   pthread_mutex_unlock(mux)
+
+typedef struct mock_task *TaskHandle_t;
+typedef struct mock_queue *QueueHandle_t;
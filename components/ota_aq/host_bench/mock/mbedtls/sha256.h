@@ -0,0 +1,29 @@
+#pragma once
+#include <stddef.h>
+#include <openssl/evp.h>
+
+// mbedtls_sha256_* sobre OpenSSL; en el panel es el SHA acelerado por hardware
+typedef struct {
+    EVP_MD_CTX *md;
+} mbedtls_sha256_context;
+
+static inline void mbedtls_sha256_init(mbedtls_sha256_context *ctx) {
+    ctx->md = EVP_MD_CTX_new();
+}
+
+static inline void mbedtls_sha256_free(mbedtls_sha256_context *ctx) {
+    EVP_MD_CTX_free(ctx->md);
+    ctx->md = NULL;
+}
+
+static inline int mbedtls_sha256_starts(mbedtls_sha256_context *ctx, int is224) {
+    return EVP_DigestInit_ex(ctx->md, EVP_sha256(), NULL) == 1 ? 0 : -1;
+}
+
+static inline int mbedtls_sha256_update(mbedtls_sha256_context *ctx, const unsigned char *in, size_t len) {
+    return EVP_DigestUpdate(ctx->md, in, len) == 1 ? 0 : -1;
+}
+
+static inline int mbedtls_sha256_finish(mbedtls_sha256_context *ctx, unsigned char out[32]) {
+    return EVP_DigestFinal_ex(ctx->md, out, NULL) == 1 ? 0 : -1;
+}
@@ -0,0 +1,230 @@
+#include <errno.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+// Subconjunto de IDF/FreeRTOS sobre pthreads para ota_stream_aq.c (mismo esquema que
+// el mock de usb_netif_aq)
+
+// ---------- heap ----------
+
+void *heap_caps_malloc(size_t size, uint32_t caps) {
+    (void)caps;
+    return malloc(size);
+}
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps) {
+    (void)caps;
+    return calloc(n, size);
+}
+
+void heap_caps_free(void *ptr) {
+    free(ptr);
+}
+
+// ---------- tiempo ----------
+
+int64_t esp_timer_get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void deadline_after(struct timespec *ts, uint64_t us) {
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += us / 1000000;
+    ts->tv_nsec += (long)(us % 1000000) * 1000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+static void cond_init_monotonic(pthread_cond_t *c) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(c, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static void unlock_cleanup(void *m) {
+    pthread_mutex_unlock((pthread_mutex_t *)m);
+}
+
+// Espera en c con el timeout en ticks (ms) de FreeRTOS. false si venció.
+static bool cond_wait_ticks(pthread_cond_t *c, pthread_mutex_t *m, TickType_t ticks,
+                            const struct timespec *deadline) {
+    if (ticks == portMAX_DELAY) {
+        pthread_cond_wait(c, m);
+        return true;
+    }
+    return pthread_cond_timedwait(c, m, deadline) != ETIMEDOUT;
+}
+
+// ---------- tareas ----------
+
+struct mock_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+};
+
+static __thread struct mock_task *s_current;
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return s_current;
+}
+
+static void *task_entry(void *p) {
+    struct mock_task *t = p;
+    s_current = t;
+    t->fn(t->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *out, BaseType_t core) {
+    (void)name; (void)stack; (void)prio; (void)core;
+    struct mock_task *t = calloc(1, sizeof(*t));
+    if (t == NULL) return pdFAIL;
+    t->fn = fn;
+    t->arg = arg;
+    pthread_mutex_init(&t->lock, NULL);
+    cond_init_monotonic(&t->cond);
+    if (pthread_create(&t->thread, NULL, task_entry, t) != 0) {
+        free(t);
+        return pdFAIL;
+    }
+    if (out) *out = t;
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL) pthread_exit(NULL);
+    pthread_cancel(task->thread);
+    pthread_join(task->thread, NULL);
+    free(task);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    struct timespec ts = { .tv_sec = ticks / 1000, .tv_nsec = (long)(ticks % 1000) * 1000000 };
+    if (ticks == 0) {
+        sched_yield();
+    } else {
+        nanosleep(&ts, NULL);
+    }
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+    struct mock_task *t = s_current;
+    struct timespec deadline;
+    deadline_after(&deadline, (uint64_t)ticks * 1000);
+    uint32_t val;
+    pthread_mutex_lock(&t->lock);
+    pthread_cleanup_push(unlock_cleanup, &t->lock);
+    while (t->notify == 0 && ticks != 0) {
+        if (!cond_wait_ticks(&t->cond, &t->lock, ticks, &deadline)) break;
+    }
+    val = t->notify;
+    if (val) t->notify = clear_on_exit ? 0 : val - 1;
+    pthread_cleanup_pop(1);
+    return val;
+}
+
+// ---------- colas ----------
+
+struct mock_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    uint8_t *storage;
+    UBaseType_t length, item_size, head, count;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    struct mock_queue *q = calloc(1, sizeof(*q));
+    if (q == NULL) return NULL;
+    q->storage = malloc((size_t)length * item_size);
+    if (q->storage == NULL) {
+        free(q);
+        return NULL;
+    }
+    q->length = length;
+    q->item_size = item_size;
+    pthread_mutex_init(&q->lock, NULL);
+    cond_init_monotonic(&q->not_empty);
+    cond_init_monotonic(&q->not_full);
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q) {
+    free(q->storage);
+    free(q);
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks) {
+    struct timespec deadline;
+    deadline_after(&deadline, (uint64_t)ticks * 1000);
+    BaseType_t ok = pdFALSE;
+    pthread_mutex_lock(&q->lock);
+    pthread_cleanup_push(unlock_cleanup, &q->lock);
+    while (q->count == q->length && ticks != 0) {
+        if (!cond_wait_ticks(&q->not_full, &q->lock, ticks, &deadline)) break;
+    }
+    if (q->count < q->length) {
+        UBaseType_t tail = (q->head + q->count) % q->length;
+        memcpy(q->storage + (size_t)tail * q->item_size, item, q->item_size);
+        q->count++;
+        pthread_cond_signal(&q->not_empty);
+        ok = pdTRUE;
+    }
+    pthread_cleanup_pop(1);
+    return ok;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks) {
+    struct timespec deadline;
+    deadline_after(&deadline, (uint64_t)ticks * 1000);
+    BaseType_t ok = pdFALSE;
+    pthread_mutex_lock(&q->lock);
+    pthread_cleanup_push(unlock_cleanup, &q->lock);
+    while (q->count == 0 && ticks != 0) {
+        if (!cond_wait_ticks(&q->not_empty, &q->lock, ticks, &deadline)) break;
+    }
+    if (q->count) {
+        memcpy(item, q->storage + (size_t)q->head * q->item_size, q->item_size);
+        q->head = (q->head + 1) % q->length;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+        ok = pdTRUE;
+    }
+    pthread_cleanup_pop(1);
+    return ok;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t n = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
@@ -0,0 +1,6 @@
+#pragma once
+// Valores por defecto del Kconfig de ota_aq
+#define CONFIG_AQ_OTA_CHUNK_SIZE 4096
+#define CONFIG_AQ_OTA_BUFFERS 2
+#define CONFIG_AQ_OTA_RECV_TIMEOUT_MS 5000
+#define CONFIG_AQ_OTA_WRITER_TASK_PRIO 4
@@ -0,0 +1,56 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Actualización OTA en streaming desde el MASTER por TCP sobre la netif USB.
+// El panel se conecta al emisor del MASTER, recibe cabecera + imagen y la escribe en la
+// partición OTA inactiva. Recepción, SHA256 y borrado/programación de flash se solapan
+// con un pipeline de CONFIG_AQ_OTA_BUFFERS buffers. Protocolo: README.md.
+
+ESP_EVENT_DECLARE_BASE(OTA_EVENTS);
+
+typedef enum {
+    OTA_STARTED,      // sin datos; conectado al emisor
+    OTA_PROGRESS,     // datos: uint32_t porcentaje, cada CONFIG_AQ_OTA_PROGRESS_STEP
+    OTA_DONE,         // datos: ota_stats_aq_t; imagen verificada y marcada para arrancar
+    OTA_FAILED,       // datos: ota_stats_aq_t (result con el error)
+} ota_event_aq_t;
+
+typedef struct {
+    esp_err_t result;
+    uint32_t image_size;
+    uint32_t bytes;             // recibidos y escritos
+    uint32_t total_us;          // cabecera -> resultado enviado
+    uint32_t connect_us;
+    uint32_t recv_us;           // bloqueado en recv()
+    uint32_t hash_us;           // SHA256 incremental
+    uint32_t flash_us;          // esp_ota_write (borrado + programación), en la tarea de escritura
+    uint32_t finalize_us;       // esp_ota_end (validación de la imagen) + partición de arranque
+    uint32_t rx_stall_us;       // recepción esperando buffer libre: la flash es el cuello de botella
+    uint32_t writer_idle_us;    // escritura esperando datos: la red es el cuello de botella
+    uint32_t kbps;              // throughput extremo a extremo, kbit/s
+} ota_stats_aq_t;
+
+// Lanza la actualización en su propia tarea y vuelve. host:port es el emisor del
+// MASTER; el socket se liga a la IP de netif. ESP_ERR_INVALID_STATE si ya hay una.
+esp_err_t ota_start_aq(esp_netif_t *netif, const char *host, uint16_t port);
+bool      ota_in_progress_aq(void);
+// Resultado de la última actualización (o de la que está en curso)
+void      ota_get_stats_aq(ota_stats_aq_t *out);
+// Confirma la imagen actual y cancela el rollback del bootloader. Llamar cuando el
+// firmware nuevo ha demostrado funcionar (p.ej. MASTER alcanzado).
+esp_err_t ota_mark_valid_aq(void);
+// Al arrancar: si la imagen está pendiente de verificar y no se confirma en
+// CONFIG_AQ_OTA_VERIFY_TIMEOUT_S, se marca inválida y se reinicia en la anterior.
+esp_err_t ota_verify_start_aq(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,203 @@
+#include "ota_aq.h"
+#include <errno.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include "ota_sink_aq.h"
+#include "ota_stream_aq.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "ota_aq";
+
+ESP_EVENT_DEFINE_BASE(OTA_EVENTS);
+
+#if CONFIG_FREERTOS_UNICORE
+#define OTA_RX_CORE_AQ     0
+#define OTA_WRITER_CORE_AQ 0
+#else
+#define OTA_RX_CORE_AQ     (CONFIG_AQ_OTA_RX_TASK_CORE < 0 ? tskNO_AFFINITY : CONFIG_AQ_OTA_RX_TASK_CORE)
+#define OTA_WRITER_CORE_AQ CONFIG_AQ_OTA_WRITER_TASK_CORE
+#endif
+
+typedef struct {
+    esp_netif_t *netif;
+    struct sockaddr_in peer;
+} ota_job_aq_t;
+
+static ota_job_aq_t s_job;
+static volatile bool s_busy;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static ota_stats_aq_t s_stats;
+static uint32_t s_next_pct;
+static esp_timer_handle_t s_verify_timer;
+
+// Socket TCP ligado a la IP y a la interfaz USB, como el de mqtt_service_aq
+static int open_socket(const ota_job_aq_t *job) {
+    esp_netif_ip_info_t ip;
+    if (esp_netif_get_ip_info(job->netif, &ip) != ESP_OK || ip.ip.addr == 0) return -1;
+
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0) return -1;
+
+    struct ifreq ifr = {0};
+    if (esp_netif_get_netif_impl_name(job->netif, ifr.ifr_name) == ESP_OK) {
+        setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, &ifr, sizeof(ifr));
+    }
+    struct sockaddr_in local = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = ip.ip.addr,
+    };
+    struct timeval rcv_to = {
+        .tv_sec = CONFIG_AQ_OTA_RECV_TIMEOUT_MS / 1000,
+        .tv_usec = (CONFIG_AQ_OTA_RECV_TIMEOUT_MS % 1000) * 1000,
+    };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &rcv_to, sizeof(rcv_to));
+
+    if (bind(fd, (struct sockaddr *)&local, sizeof(local)) != 0 ||
+        connect(fd, (struct sockaddr *)&job->peer, sizeof(job->peer)) != 0) {
+        ESP_LOGW(TAG, "Cannot connect to OTA sender (errno %d)", errno);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void on_progress(uint32_t bytes, uint32_t total, void *ctx) {
+    uint32_t pct = (uint32_t)((uint64_t)bytes * 100 / total);
+    if (pct < s_next_pct) return;
+    s_next_pct = (pct / CONFIG_AQ_OTA_PROGRESS_STEP + 1) * CONFIG_AQ_OTA_PROGRESS_STEP;
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats.bytes = bytes;
+    taskEXIT_CRITICAL(&s_stats_lock);
+    esp_event_post(OTA_EVENTS, OTA_PROGRESS, &pct, sizeof(pct), 0);
+}
+
+static void ota_task(void *arg) {
+    ota_job_aq_t *job = (ota_job_aq_t *)arg;
+    ota_stats_aq_t st = {0};
+    esp_err_t err;
+
+    int64_t t0 = esp_timer_get_time();
+    int fd = open_socket(job);
+    st.connect_us = (uint32_t)(esp_timer_get_time() - t0);
+    if (fd < 0) {
+        err = ESP_ERR_INVALID_STATE;
+        st.result = err;
+    } else {
+        ota_sink_aq_t sink;
+        ota_sink_esp_ota_aq(&sink);
+        const ota_stream_cfg_aq_t cfg = {
+            .chunk_size = CONFIG_AQ_OTA_CHUNK_SIZE,
+            .buffers = CONFIG_AQ_OTA_BUFFERS,
+            .writer_prio = CONFIG_AQ_OTA_WRITER_TASK_PRIO,
+            .writer_core = OTA_WRITER_CORE_AQ,
+            .progress = on_progress,
+        };
+        s_next_pct = CONFIG_AQ_OTA_PROGRESS_STEP;
+        esp_event_post(OTA_EVENTS, OTA_STARTED, NULL, 0, 0);
+        err = ota_stream_run_aq(fd, &cfg, &sink, &st);
+        close(fd);
+    }
+
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats = st;
+    taskEXIT_CRITICAL(&s_stats_lock);
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "OTA done: %lu bytes in %lu ms (%lu kbit/s); recv %lu ms, hash %lu ms, flash %lu ms, "
+                 "finalize %lu ms, rx stall %lu ms, writer idle %lu ms",
+                 (unsigned long)st.bytes, (unsigned long)(st.total_us / 1000), (unsigned long)st.kbps,
+                 (unsigned long)(st.recv_us / 1000), (unsigned long)(st.hash_us / 1000),
+                 (unsigned long)(st.flash_us / 1000), (unsigned long)(st.finalize_us / 1000),
+                 (unsigned long)(st.rx_stall_us / 1000), (unsigned long)(st.writer_idle_us / 1000));
+        esp_event_post(OTA_EVENTS, OTA_DONE, &st, sizeof(st), 0);
+    } else {
+        ESP_LOGE(TAG, "OTA failed after %lu bytes: %s", (unsigned long)st.bytes, esp_err_to_name(err));
+        esp_event_post(OTA_EVENTS, OTA_FAILED, &st, sizeof(st), 0);
+    }
+
+#if CONFIG_AQ_OTA_AUTO_REBOOT
+    if (err == ESP_OK) {
+        ESP_LOGW(TAG, "Rebooting into the new image in %d ms", CONFIG_AQ_OTA_REBOOT_DELAY_MS);
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_AQ_OTA_REBOOT_DELAY_MS));
+        esp_restart();
+    }
+#endif
+    s_busy = false;
+    vTaskDelete(NULL);
+}
+
+esp_err_t ota_start_aq(esp_netif_t *netif, const char *host, uint16_t port) {
+    if (netif == NULL || host == NULL || port == 0) return ESP_ERR_INVALID_ARG;
+    struct sockaddr_in peer = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+    };
+    if (inet_aton(host, &peer.sin_addr) == 0) return ESP_ERR_INVALID_ARG;
+
+    taskENTER_CRITICAL(&s_stats_lock);
+    bool busy = s_busy;
+    s_busy = true;
+    taskEXIT_CRITICAL(&s_stats_lock);
+    if (busy) return ESP_ERR_INVALID_STATE;
+
+    s_job.netif = netif;
+    s_job.peer = peer;
+    ESP_LOGI(TAG, "Starting OTA from %s:%u", host, port);
+    if (xTaskCreatePinnedToCore(ota_task, "ota_aq", 4096, &s_job, CONFIG_AQ_OTA_RX_TASK_PRIO, NULL,
+                                OTA_RX_CORE_AQ) != pdPASS) {
+        s_busy = false;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+bool ota_in_progress_aq(void) {
+    return s_busy;
+}
+
+void ota_get_stats_aq(ota_stats_aq_t *out) {
+    taskENTER_CRITICAL(&s_stats_lock);
+    *out = s_stats;
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+static bool pending_verify(void) {
+    esp_ota_img_states_t state;
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    return esp_ota_get_state_partition(running, &state) == ESP_OK && state == ESP_OTA_IMG_PENDING_VERIFY;
+}
+
+esp_err_t ota_mark_valid_aq(void) {
+    if (!pending_verify()) {
+        return ESP_OK;  // sin rollback pendiente (o partición factory)
+    }
+    if (s_verify_timer) esp_timer_stop(s_verify_timer);
+    ESP_LOGI(TAG, "New firmware confirmed, cancelling rollback");
+    return esp_ota_mark_app_valid_cancel_rollback();
+}
+
+// Una imagen que arranca pero nunca llega al MASTER no se confirma; sin este plazo el
+// bootloader solo volvería a la anterior tras un reset
+static void verify_timeout(void *arg) {
+    ESP_LOGE(TAG, "New firmware not confirmed in %d s, rolling back", CONFIG_AQ_OTA_VERIFY_TIMEOUT_S);
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+}
+
+esp_err_t ota_verify_start_aq(void) {
+    if (CONFIG_AQ_OTA_VERIFY_TIMEOUT_S == 0 || s_verify_timer || !pending_verify()) return ESP_OK;
+    const esp_timer_create_args_t args = {
+        .callback = verify_timeout,
+        .name = "ota_verify",
+    };
+    esp_err_t err = esp_timer_create(&args, &s_verify_timer);
+    if (err != ESP_OK) return err;
+    ESP_LOGW(TAG, "Running an unconfirmed image, rollback in %d s unless the MASTER is reached",
+             CONFIG_AQ_OTA_VERIFY_TIMEOUT_S);
+    return esp_timer_start_once(s_verify_timer, (uint64_t)CONFIG_AQ_OTA_VERIFY_TIMEOUT_S * 1000000);
+}
@@ -0,0 +1,61 @@
+#include "ota_proto_aq.h"
+#include <string.h>
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void ota_header_encode_aq(const ota_header_aq_t *hdr, uint8_t out[OTA_HDR_LEN_AQ]) {
+    put_u32(out, OTA_MAGIC_AQ);
+    put_u16(out + 4, OTA_VERSION_AQ);
+    put_u16(out + 6, OTA_HDR_LEN_AQ);
+    put_u32(out + 8, hdr->image_size);
+    put_u32(out + 12, hdr->flags);
+    memcpy(out + 16, hdr->sha256, 32);
+}
+
+esp_err_t ota_header_decode_aq(const uint8_t in[OTA_HDR_LEN_AQ], ota_header_aq_t *out) {
+    if (get_u32(in) != OTA_MAGIC_AQ) return ESP_ERR_INVALID_ARG;
+    out->version = get_u16(in + 4);
+    out->header_len = get_u16(in + 6);
+    // Versiones posteriores pueden alargar la cabecera pero no cambiar estos campos
+    if (out->version < OTA_VERSION_AQ || out->header_len < OTA_HDR_LEN_AQ ||
+        out->header_len > OTA_HDR_MAX_LEN_AQ) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    out->image_size = get_u32(in + 8);
+    out->flags = get_u32(in + 12);
+    memcpy(out->sha256, in + 16, 32);
+    return out->image_size ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+void ota_result_encode_aq(const ota_result_aq_t *res, uint8_t out[OTA_RESULT_LEN_AQ]) {
+    put_u32(out, OTA_RESULT_MAGIC_AQ);
+    put_u32(out + 4, (uint32_t)res->status);
+    put_u32(out + 8, res->bytes);
+    memcpy(out + 12, res->sha256, 32);
+}
+
+esp_err_t ota_result_decode_aq(const uint8_t in[OTA_RESULT_LEN_AQ], ota_result_aq_t *out) {
+    if (get_u32(in) != OTA_RESULT_MAGIC_AQ) return ESP_ERR_INVALID_ARG;
+    out->status = (int32_t)get_u32(in + 4);
+    out->bytes = get_u32(in + 8);
+    memcpy(out->sha256, in + 12, 32);
+    return ESP_OK;
+}
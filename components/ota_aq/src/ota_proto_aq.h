@@ -0,0 +1,49 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Formato en el cable (little-endian). Independiente de IDF: el emisor de Linux del
+// host_bench usa este mismo código.
+//
+//   emisor -> panel: cabecera (OTA_HDR_LEN_AQ) seguida de image_size bytes
+//     0  u32 magic "AQOT"
+//     4  u16 version (1)
+//     6  u16 header_len (48; los bytes extra de versiones futuras se ignoran)
+//     8  u32 image_size
+//    12  u32 flags (0)
+//    16  u8  sha256[32] de la imagen
+//
+//   panel -> emisor: resultado (OTA_RESULT_LEN_AQ)
+//     0  u32 magic "AQOR"
+//     4  i32 status (esp_err_t; 0 = imagen verificada y marcada para arrancar)
+//     8  u32 bytes recibidos
+//    12  u8  sha256[32] calculado por el panel
+
+#define OTA_MAGIC_AQ          0x544f5141u   // "AQOT"
+#define OTA_RESULT_MAGIC_AQ   0x524f5141u   // "AQOR"
+#define OTA_VERSION_AQ        1
+#define OTA_HDR_LEN_AQ        48
+#define OTA_RESULT_LEN_AQ     44
+#define OTA_HDR_MAX_LEN_AQ    256
+
+typedef struct {
+    uint16_t version;
+    uint16_t header_len;
+    uint32_t image_size;
+    uint32_t flags;
+    uint8_t  sha256[32];
+} ota_header_aq_t;
+
+typedef struct {
+    int32_t  status;
+    uint32_t bytes;
+    uint8_t  sha256[32];
+} ota_result_aq_t;
+
+void      ota_header_encode_aq(const ota_header_aq_t *hdr, uint8_t out[OTA_HDR_LEN_AQ]);
+// Valida magic/versión/longitudes. Los primeros OTA_HDR_LEN_AQ bytes bastan.
+esp_err_t ota_header_decode_aq(const uint8_t in[OTA_HDR_LEN_AQ], ota_header_aq_t *out);
+void      ota_result_encode_aq(const ota_result_aq_t *res, uint8_t out[OTA_RESULT_LEN_AQ]);
+esp_err_t ota_result_decode_aq(const uint8_t in[OTA_RESULT_LEN_AQ], ota_result_aq_t *out);
@@ -0,0 +1,51 @@
+#include "ota_sink_aq.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+
+static const char *TAG = "ota_sink_aq";
+
+static const esp_partition_t *s_part;
+static esp_ota_handle_t s_handle;
+
+static esp_err_t sink_begin(void *ctx, uint32_t image_size) {
+    s_part = esp_ota_get_next_update_partition(NULL);
+    if (s_part == NULL) {
+        ESP_LOGE(TAG, "No OTA partition (partition table needs two OTA slots)");
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (image_size > s_part->size) {
+        ESP_LOGE(TAG, "Image of %lu bytes does not fit in %s (%lu bytes)", (unsigned long)image_size,
+                 s_part->label, (unsigned long)s_part->size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    // Sin borrado previo de toda la partición: esp_ota_write borra cada sector al llegar a
+    // él, en la tarea de escritura, mientras la recepción sigue llenando el otro buffer.
+    esp_err_t err = esp_ota_begin(s_part, OTA_WITH_SEQUENTIAL_WRITES, &s_handle);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Writing to %s at 0x%lx", s_part->label, (unsigned long)s_part->address);
+    }
+    return err;
+}
+
+static esp_err_t sink_write(void *ctx, const void *data, size_t len) {
+    return esp_ota_write(s_handle, data, len);
+}
+
+static esp_err_t sink_finish(void *ctx, bool commit) {
+    if (!commit) {
+        return esp_ota_abort(s_handle);
+    }
+    // esp_ota_end comprueba la cabecera de la app y su hash/firmas
+    esp_err_t err = esp_ota_end(s_handle);
+    if (err == ESP_OK) {
+        err = esp_ota_set_boot_partition(s_part);
+    }
+    return err;
+}
+
+void ota_sink_esp_ota_aq(ota_sink_aq_t *out) {
+    out->begin = sink_begin;
+    out->write = sink_write;
+    out->finish = sink_finish;
+    out->ctx = NULL;
+}
@@ -0,0 +1,6 @@
+#pragma once
+#include "ota_stream_aq.h"
+
+// Sumidero sobre esp_ota_ops: partición OTA inactiva, borrado secuencial sector a
+// sector dentro de esp_ota_write (se solapa con la recepción) y validación en finish.
+void ota_sink_esp_ota_aq(ota_sink_aq_t *out);
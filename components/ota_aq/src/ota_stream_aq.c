@@ -0,0 +1,223 @@
+#include "ota_stream_aq.h"
+#include <errno.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include "mbedtls/sha256.h"
+#include "ota_proto_aq.h"
+
+static const char *TAG = "ota_stream_aq";
+
+#define OTA_MAX_BUFFERS_AQ 8
+#define OTA_BUF_STOP_AQ    0xff
+
+// Dos colas de índices: free_q (buffers vacíos, hacia la recepción) y full_q (buffers
+// llenos y ya con hash, hacia la escritura). full_q tiene hueco extra para STOP.
+typedef struct {
+    const ota_stream_cfg_aq_t *cfg;
+    const ota_sink_aq_t *sink;
+    uint8_t *mem;
+    uint32_t lens[OTA_MAX_BUFFERS_AQ];
+    QueueHandle_t free_q;
+    QueueHandle_t full_q;
+    TaskHandle_t waiter;
+    volatile esp_err_t write_err;
+    uint32_t image_size;
+    uint32_t written;
+    uint32_t flash_us;
+    uint32_t idle_us;
+} ota_pipe_aq_t;
+
+static inline uint32_t elapsed_us(int64_t since) {
+    return (uint32_t)(esp_timer_get_time() - since);
+}
+
+static void writer_task(void *arg) {
+    ota_pipe_aq_t *p = (ota_pipe_aq_t *)arg;
+    while (1) {
+        uint8_t idx;
+        int64_t t0 = esp_timer_get_time();
+        xQueueReceive(p->full_q, &idx, portMAX_DELAY);
+        p->idle_us += elapsed_us(t0);
+        if (idx == OTA_BUF_STOP_AQ) break;
+
+        // Tras un error se siguen devolviendo buffers para que la recepción no se bloquee
+        if (p->write_err == ESP_OK) {
+            t0 = esp_timer_get_time();
+            esp_err_t err = p->sink->write(p->sink->ctx, p->mem + (size_t)idx * p->cfg->chunk_size, p->lens[idx]);
+            p->flash_us += elapsed_us(t0);
+            if (err != ESP_OK) {
+                p->write_err = err;
+            } else {
+                p->written += p->lens[idx];
+                if (p->cfg->progress) p->cfg->progress(p->written, p->image_size, p->cfg->progress_ctx);
+            }
+        }
+        xQueueSend(p->free_q, &idx, portMAX_DELAY);
+    }
+    xTaskNotifyGive(p->waiter);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t recv_exact(int sock, uint8_t *buf, size_t len, uint32_t *recv_us) {
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = ESP_OK;
+    while (len) {
+        ssize_t n = recv(sock, buf, len, 0);
+        if (n > 0) {
+            buf += n;
+            len -= (size_t)n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            // 0 = el emisor cerró antes de tiempo
+            err = n == 0 ? ESP_ERR_INVALID_SIZE
+                  : (errno == EAGAIN || errno == EWOULDBLOCK) ? ESP_ERR_TIMEOUT : ESP_FAIL;
+            break;
+        }
+    }
+    *recv_us += elapsed_us(t0);
+    return err;
+}
+
+static void send_all(int sock, const uint8_t *buf, size_t len) {
+    while (len) {
+        ssize_t n = send(sock, buf, len, 0);
+        if (n <= 0) return;
+        buf += n;
+        len -= (size_t)n;
+    }
+}
+
+static esp_err_t read_header(int sock, ota_header_aq_t *hdr, uint32_t *recv_us) {
+    uint8_t raw[OTA_HDR_LEN_AQ];
+    esp_err_t err = recv_exact(sock, raw, sizeof(raw), recv_us);
+    if (err == ESP_OK) err = ota_header_decode_aq(raw, hdr);
+    // Campos de versiones futuras: se descartan
+    for (size_t extra = err == ESP_OK ? hdr->header_len - OTA_HDR_LEN_AQ : 0; extra && err == ESP_OK;) {
+        size_t n = extra < sizeof(raw) ? extra : sizeof(raw);
+        err = recv_exact(sock, raw, n, recv_us);
+        extra -= n;
+    }
+    return err;
+}
+
+// Recepción + hash en esta tarea mientras la de escritura vacía los buffers llenos
+static esp_err_t run_pipeline(int sock, ota_pipe_aq_t *p, mbedtls_sha256_context *sha, ota_stats_aq_t *st) {
+    const ota_stream_cfg_aq_t *cfg = p->cfg;
+    p->free_q = xQueueCreate(cfg->buffers, sizeof(uint8_t));
+    p->full_q = xQueueCreate(cfg->buffers + 1, sizeof(uint8_t));
+    p->waiter = xTaskGetCurrentTaskHandle();
+    if (p->free_q == NULL || p->full_q == NULL) return ESP_ERR_NO_MEM;
+    for (uint8_t i = 0; i < cfg->buffers; i++) {
+        xQueueSend(p->free_q, &i, 0);
+    }
+    BaseType_t core = cfg->writer_core < 0 ? tskNO_AFFINITY : cfg->writer_core;
+    if (xTaskCreatePinnedToCore(writer_task, "ota_writer", 4096, p, cfg->writer_prio, NULL, core) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = ESP_OK;
+    uint32_t remaining = p->image_size;
+    while (remaining && err == ESP_OK && p->write_err == ESP_OK) {
+        uint8_t idx;
+        int64_t t0 = esp_timer_get_time();
+        xQueueReceive(p->free_q, &idx, portMAX_DELAY);
+        st->rx_stall_us += elapsed_us(t0);
+
+        uint8_t *buf = p->mem + (size_t)idx * cfg->chunk_size;
+        uint32_t len = remaining < cfg->chunk_size ? remaining : (uint32_t)cfg->chunk_size;
+        err = recv_exact(sock, buf, len, &st->recv_us);
+        if (err != ESP_OK) break;
+
+        t0 = esp_timer_get_time();
+        mbedtls_sha256_update(sha, buf, len);
+        st->hash_us += elapsed_us(t0);
+
+        p->lens[idx] = len;
+        xQueueSend(p->full_q, &idx, portMAX_DELAY);
+        remaining -= len;
+    }
+
+    uint8_t stop = OTA_BUF_STOP_AQ;
+    xQueueSend(p->full_q, &stop, portMAX_DELAY);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    return err != ESP_OK ? err : p->write_err;
+}
+
+esp_err_t ota_stream_run_aq(int sock, const ota_stream_cfg_aq_t *cfg, const ota_sink_aq_t *sink,
+                            ota_stats_aq_t *stats) {
+    if (cfg == NULL || sink == NULL || stats == NULL || cfg->chunk_size == 0 ||
+        cfg->buffers < 2 || cfg->buffers > OTA_MAX_BUFFERS_AQ) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int64_t start = esp_timer_get_time();
+    uint32_t connect_us = stats->connect_us;
+    memset(stats, 0, sizeof(*stats));
+    stats->connect_us = connect_us;
+
+    ota_header_aq_t hdr;
+    esp_err_t err = read_header(sock, &hdr, &stats->recv_us);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Bad OTA header: %s", esp_err_to_name(err));
+        stats->result = err;
+        return err;
+    }
+    stats->image_size = hdr.image_size;
+    ESP_LOGI(TAG, "Receiving %lu byte image (%u x %u byte buffers)", (unsigned long)hdr.image_size,
+             cfg->buffers, (unsigned)cfg->chunk_size);
+
+    ota_pipe_aq_t pipe = {
+        .cfg = cfg,
+        .sink = sink,
+        .image_size = hdr.image_size,
+        .write_err = ESP_OK,
+    };
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    ota_result_aq_t res = { 0 };
+
+    // Solo durante la actualización; RAM interna para que la flash pueda leerla directamente
+    pipe.mem = heap_caps_malloc(cfg->chunk_size * cfg->buffers, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    err = pipe.mem ? sink->begin(sink->ctx, hdr.image_size) : ESP_ERR_NO_MEM;
+    bool begun = err == ESP_OK;
+    if (err == ESP_OK) {
+        err = run_pipeline(sock, &pipe, &sha, stats);
+    }
+    mbedtls_sha256_finish(&sha, res.sha256);
+    mbedtls_sha256_free(&sha);
+    if (err == ESP_OK && memcmp(res.sha256, hdr.sha256, sizeof(res.sha256)) != 0) {
+        ESP_LOGE(TAG, "SHA256 mismatch, discarding image");
+        err = ESP_ERR_INVALID_CRC;
+    }
+
+    if (begun) {
+        int64_t t0 = esp_timer_get_time();
+        esp_err_t fin = sink->finish(sink->ctx, err == ESP_OK);
+        stats->finalize_us = elapsed_us(t0);
+        if (err == ESP_OK) err = fin;
+    }
+    if (pipe.free_q) vQueueDelete(pipe.free_q);
+    if (pipe.full_q) vQueueDelete(pipe.full_q);
+    heap_caps_free(pipe.mem);
+
+    res.status = err;
+    res.bytes = pipe.written;
+    uint8_t raw[OTA_RESULT_LEN_AQ];
+    ota_result_encode_aq(&res, raw);
+    send_all(sock, raw, sizeof(raw));
+
+    stats->result = err;
+    stats->bytes = pipe.written;
+    stats->flash_us = pipe.flash_us;
+    stats->writer_idle_us = pipe.idle_us;
+    stats->total_us = elapsed_us(start);
+    stats->kbps = stats->total_us ? (uint32_t)((uint64_t)pipe.written * 8000 / stats->total_us) : 0;
+    return err;
+}
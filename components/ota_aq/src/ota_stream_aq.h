@@ -0,0 +1,37 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "ota_aq.h"
+
+// Receptor del protocolo (cabecera, imagen, resultado) con el pipeline de buffers.
+// No sabe nada de particiones: escribe a través de un ota_sink_aq_t. En el panel el
+// sumidero es esp_ota (ota_sink_aq.c); en el host_bench, una flash simulada.
+//
+// Tarea que llama a ota_stream_run_aq: recv() + SHA256 de cada buffer en cuanto se llena.
+// Tarea de escritura (creada aquí): sink->write de los buffers llenos, en orden.
+
+typedef struct {
+    // Prepara el destino para image_size bytes (ESP_ERR_INVALID_SIZE si no cabe)
+    esp_err_t (*begin)(void *ctx, uint32_t image_size);
+    esp_err_t (*write)(void *ctx, const void *data, size_t len);
+    // commit=true: validar y activar la imagen; false: abortar
+    esp_err_t (*finish)(void *ctx, bool commit);
+    void *ctx;
+} ota_sink_aq_t;
+
+typedef void (*ota_progress_cb_aq_t)(uint32_t bytes, uint32_t total, void *ctx);
+
+typedef struct {
+    size_t chunk_size;
+    uint8_t buffers;              // >= 2
+    uint8_t writer_prio;
+    int writer_core;              // -1 = sin afinidad
+    ota_progress_cb_aq_t progress;   // opcional, desde la tarea de escritura
+    void *progress_ctx;
+} ota_stream_cfg_aq_t;
+
+// sock ya conectado y con SO_RCVTIMEO. Envía siempre el resultado al emisor si la
+// cabecera era válida. stats se rellena también en caso de error.
+esp_err_t ota_stream_run_aq(int sock, const ota_stream_cfg_aq_t *cfg, const ota_sink_aq_t *sink,
+                            ota_stats_aq_t *stats);
@@ -0,0 +1,233 @@
+// Benchmark de host (Linux) de rules_engine_aq.
+//
+// Compila el compilador y la VM reales. Primero comprueba la semántica con un juego
+// de reglas conocido (all/any/not, sig2, else, prioridades, errores de compilación)
+// y después mide, para N reglas generadas: tiempo de compilación, coste por tick
+// (medio, p99, máximo, instrucciones) y la alternativa de interpretar el JSON en
+// cada tick (compilar + ejecutar), que es el coste de recorrer el texto por tick.
+// -C solo comprueba la semántica, sin medir: es lo que ejecuta ctest.
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "rules_bytecode_aq.h"
+
+static rules_symtab_aq_t s_syms;
+static rules_prog_aq_t s_prog;
+static rules_vm_state_aq_t s_vm;
+static uint32_t s_changes;
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void count_change(uint8_t signal, float value, void *ctx) {
+    s_changes++;
+}
+
+static float reg(const char *name) {
+    return s_vm.regs[rules_symtab_intern_aq(&s_syms, name, strlen(name))];
+}
+
+static void set(const char *name, float v) {
+    s_vm.regs[rules_symtab_intern_aq(&s_syms, name, strlen(name))] = v;
+}
+
+static int s_failures;
+
+#define CHECK(cond)                                                  \
+    do {                                                             \
+        if (!(cond)) {                                               \
+            fprintf(stderr, "CHECK failed line %d: %s\n", __LINE__, #cond); \
+            s_failures++;                                            \
+        }                                                            \
+    } while (0)
+
+static const char s_semantics_json[] =
+    "{\"rules\": ["
+    " {\"id\":\"heater\", \"prio\": 1,"
+    "  \"when\": {\"all\": [{\"sig\":\"temp\",\"op\":\"<\",\"value\":24.5},"
+    "                      {\"not\": {\"sig\":\"door\",\"op\":\"==\",\"value\":1}}]},"
+    "  \"then\": [{\"set\":\"heater\",\"value\":1}], \"else\": [{\"set\":\"heater\",\"value\":0}]},"
+    " {\"id\":\"override\", \"prio\": 5, \"when\": {\"sig\":\"maint\",\"op\":\">=\",\"value\":1},"
+    "  \"then\": [{\"set\":\"heater\",\"value\":0}]},"
+    " {\"id\":\"mirror\", \"when\": {\"any\": [{\"sig\":\"a\",\"op\":\">\",\"sig2\":\"b\"}, false]},"
+    "  \"then\": [{\"set\":\"out\",\"sig\":\"a\"}]},"
+    " {\"id\":\"off\", \"enabled\": false, \"then\": [{\"set\":\"heater\",\"value\":7}]}"
+    "]}";
+
+static void check_semantics(void) {
+    rules_compile_err_aq_t err;
+    esp_err_t rc = rules_compile_aq(s_semantics_json, sizeof(s_semantics_json) - 1, &s_syms, &s_prog, &err);
+    CHECK(rc == ESP_OK);
+    if (rc != ESP_OK) {
+        fprintf(stderr, "compile: %s at %zu (rule %d)\n", err.msg, err.offset, err.rule);
+        return;
+    }
+    CHECK(s_prog.rule_count == 3);
+
+    set("temp", 23.0f);
+    rules_vm_run_aq(&s_prog, &s_vm, count_change, NULL);
+    CHECK(reg("heater") == 1.0f);
+    set("door", 1.0f);
+    rules_vm_run_aq(&s_prog, &s_vm, count_change, NULL);
+    CHECK(reg("heater") == 0.0f);
+    set("door", 0.0f);
+    set("maint", 1.0f);  // prioridad 5 escribe después y gana
+    s_changes = 0;
+    rules_vm_run_aq(&s_prog, &s_vm, count_change, NULL);
+    CHECK(reg("heater") == 0.0f);
+    CHECK(s_changes == 0);  // 0 -> 1 -> 0 dentro del mismo tick no notifica
+    set("maint", 0.0f);
+    set("a", 3.0f);
+    set("b", 2.0f);
+    s_changes = 0;
+    rules_vm_run_aq(&s_prog, &s_vm, count_change, NULL);
+    CHECK(reg("out") == 3.0f);
+    CHECK(reg("heater") == 1.0f);
+    CHECK(s_changes == 2);
+
+    // Errores: el programa y la tabla de símbolos anteriores no deben cambiar
+    static const char *bad[] = {
+        "{\"rules\": [{\"when\": {\"sig\":\"x\",\"op\":\"~\",\"value\":1}, \"then\": []}]}",
+        "[{\"when\": {\"sig\":\"x\",\"op\":\"<\"}, \"then\": [{\"set\":\"y\",\"value\":1}]}]",
+        "[{\"then\": [{\"set\":\"y\"}]}]",
+        "[{\"when\": true}]",
+        "[{\"then\": [{\"set\":\"y\",\"value\":1}]}",
+        "[{\"when\": {\"not\":{\"not\":{\"not\":{\"not\":{\"not\":{\"not\":{\"not\":{\"not\":{\"not\":true}}}}}}}}},"
+        " \"then\": [{\"set\":\"z\",\"value\":1}]}]",
+    };
+    uint16_t syms_before = s_syms.count;
+    static rules_prog_aq_t scratch;
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        CHECK(rules_compile_aq(bad[i], strlen(bad[i]), &s_syms, &scratch, &err) != ESP_OK);
+        CHECK(s_syms.count == syms_before);
+    }
+
+    // Recargas rechazadas una y otra vez, cada una con señales nuevas antes del error:
+    // no deben agotar la tabla, y después un juego válido con señales nuevas debe cargar
+    char buf[160];
+    for (int i = 0; i < 2 * CONFIG_AQ_RULES_MAX_SIGNALS; i++) {
+        int n = snprintf(buf, sizeof(buf),
+                         "[{\"when\": {\"sig\":\"bad_in_%d\",\"op\":\">\",\"value\":1},"
+                         " \"then\": [{\"set\":\"bad_out_%d\",\"value\":1}]}, {\"when\": true}]", i, i);
+        CHECK(rules_compile_aq(buf, (size_t)n, &s_syms, &scratch, &err) != ESP_OK);
+        CHECK(s_syms.count == syms_before);
+    }
+    static const char good[] =
+        "[{\"when\": {\"sig\":\"new_in\",\"op\":\">\",\"value\":1}, \"then\": [{\"set\":\"new_out\",\"value\":1}]}]";
+    CHECK(rules_compile_aq(good, sizeof(good) - 1, &s_syms, &scratch, &err) == ESP_OK);
+    CHECK(s_syms.count == syms_before + 2);
+    // Búsqueda sin crear (comando "set" del MASTER)
+    CHECK(rules_symtab_find_aq(&s_syms, "new_in", 6) == rules_symtab_intern_aq(&s_syms, "new_in", 6));
+    CHECK(rules_symtab_find_aq(&s_syms, "nosuch", 6) == RULES_SIGNAL_INVALID_AQ);
+    CHECK(s_syms.count == syms_before + 2);
+    printf("SEMANTICS %s\n", s_failures ? "FAIL" : "OK");
+}
+
+// ---- Reglas generadas ----
+
+// Regla típica de acuario: dos comparaciones (una contra otra señal), not, then/else
+static size_t gen_rules(char *buf, size_t cap, int n, int sensors) {
+    size_t len = (size_t)snprintf(buf, cap, "{\"rules\": [");
+    for (int i = 0; i < n && len < cap; i++) {
+        len += (size_t)snprintf(buf + len, cap - len,
+            "%s{\"id\":\"r%d\",\"prio\":%d,\"when\":{\"all\":[{\"sig\":\"s%d\",\"op\":\"<\",\"value\":%d.5},"
+            "{\"any\":[{\"sig\":\"s%d\",\"op\":\">=\",\"sig2\":\"s%d\"},{\"not\":{\"sig\":\"mode\",\"op\":\"==\",\"value\":2}}]}]},"
+            "\"then\":[{\"set\":\"o%d\",\"value\":1}],\"else\":[{\"set\":\"o%d\",\"value\":0}]}",
+            i ? "," : "", i, i % 7, i % sensors, 20 + i % 10, (i + 1) % sensors, (i + 2) % sensors,
+            i % 64, i % 64);
+    }
+    len += (size_t)snprintf(buf + len, cap - len, "]}");
+    return len;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int bench(int n_rules, uint32_t ticks) {
+    static char json[1 << 20];
+    size_t len = gen_rules(json, sizeof(json), n_rules, 32);
+    memset(&s_syms, 0, sizeof(s_syms));
+    memset(&s_vm, 0, sizeof(s_vm));
+    rules_compile_err_aq_t err;
+
+    int64_t t0 = now_ns();
+    if (rules_compile_aq(json, len, &s_syms, &s_prog, &err) != ESP_OK) {
+        fprintf(stderr, "compile %d rules failed: %s at %zu\n", n_rules, err.msg, err.offset);
+        return 1;
+    }
+    int64_t compile_ns = now_ns() - t0;
+
+    uint32_t *lat = malloc(ticks * sizeof(uint32_t));
+    uint32_t insns = 0;
+    uint64_t total = 0;
+    srand(1);
+    for (uint32_t t = 0; t < ticks; t++) {
+        // Entradas cambiantes para que se ejecuten ambas ramas
+        for (int s = 0; s < 32; s++) s_vm.regs[s] = (float)(15 + rand() % 20);
+        int64_t a = now_ns();
+        insns = rules_vm_run_aq(&s_prog, &s_vm, count_change, NULL);
+        lat[t] = (uint32_t)(now_ns() - a);
+        total += lat[t];
+    }
+    qsort(lat, ticks, sizeof(uint32_t), cmp_u32);
+
+    // Alternativa: recorrer el JSON en cada tick
+    uint32_t reparse_ticks = ticks / 10 ? ticks / 10 : 1;
+    static rules_prog_aq_t scratch;
+    t0 = now_ns();
+    for (uint32_t t = 0; t < reparse_ticks; t++) {
+        rules_compile_aq(json, len, &s_syms, &scratch, &err);
+        rules_vm_run_aq(&scratch, &s_vm, count_change, NULL);
+    }
+    double reparse_ns = (double)(now_ns() - t0) / reparse_ticks;
+
+    printf("RESULT rules=%d json_bytes=%zu insns=%u consts=%u compile_us=%.1f tick_mean_ns=%.0f "
+           "tick_p99_ns=%u tick_max_ns=%u ns_per_rule=%.1f reparse_tick_ns=%.0f\n",
+           n_rules, len, s_prog.code_len, s_prog.const_count, compile_ns / 1000.0, (double)total / ticks,
+           lat[(uint64_t)ticks * 99 / 100], lat[ticks - 1], (double)total / ticks / n_rules, reparse_ns);
+    (void)insns;
+    free(lat);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-r rules] [-t ticks] [-C]\n  without -r runs 16, 100, 300 and 1000 rules\n"
+                    "  -C only checks the semantics (ctest)\n", prog);
+}
+
+int main(int argc, char **argv) {
+    int rules = 0;
+    uint32_t ticks = 20000;
+    bool check_only = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:t:Ch")) != -1) {
+        switch (opt) {
+        case 'r': rules = atoi(optarg); break;
+        case 't': ticks = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'C': check_only = true; break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (rules < 0 || rules > CONFIG_AQ_RULES_MAX_RULES || ticks == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    check_semantics();
+    if (s_failures) return 1;
+    if (check_only) return 0;
+    if (rules) return bench(rules, ticks);
+    static const int sizes[] = {16, 100, 300, 1000};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        if (bench(sizes[i], ticks)) return 1;
+    }
+    return 0;
+}
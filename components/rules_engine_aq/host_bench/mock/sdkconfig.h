@@ -0,0 +1,6 @@
+#pragma once
+// Límites máximos del Kconfig de rules_engine_aq, para medir con cientos de reglas
+#define CONFIG_AQ_RULES_MAX_RULES 1024
+#define CONFIG_AQ_RULES_MAX_SIGNALS 254
+#define CONFIG_AQ_RULES_MAX_CODE 16384
+#define CONFIG_AQ_RULES_MAX_CONSTS 1024
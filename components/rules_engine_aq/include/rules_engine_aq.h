@@ -0,0 +1,86 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_event.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Motor de reglas local (Trigger/Condition/Action) para la autonomía en SAFE MODE.
+// Las reglas JSON se compilan una vez (al cargar o en hot reload) a un bytecode plano;
+// cada tick lo ejecuta un intérprete sin asignaciones y con coste acotado por la
+// longitud del programa (solo hay saltos hacia delante).
+//
+// Formato:
+//   { "rules": [
+//       { "id": "heater", "prio": 10,
+//         "when": { "all": [ { "sig": "temp_sump", "op": "<", "value": 24.5 },
+//                            { "not": { "sig": "door_open", "op": "==", "value": 1 } } ] },
+//         "then": [ { "set": "heater_1", "value": 1 } ],
+//         "else": [ { "set": "heater_1", "value": 0 } ] } ] }
+//   Condición: all / any / not, o comparación (<, <=, >, >=, ==, !=) de "sig" con
+//   "value" o con otra señal "sig2". Acción: "set" a "value" o al valor de "sig".
+//   Las reglas se ejecutan en orden ascendente de "prio": la de mayor prioridad
+//   escribe la última y gana. "enabled": false la omite.
+
+ESP_EVENT_DECLARE_BASE(RULES_EVENTS);
+
+typedef enum {
+    RULES_OUTPUT_CHANGED,    // datos: rules_output_aq_t
+    RULES_LOADED,            // datos: rules_stats_aq_t
+} rules_event_aq_t;
+
+#define RULES_SIGNAL_INVALID_AQ 0xff
+#define RULES_LAT_BUCKETS_AQ    16
+
+typedef struct {
+    uint8_t signal;
+    float value;
+} rules_output_aq_t;
+
+typedef struct {
+    size_t offset;       // posición en el JSON
+    int rule;            // índice de la regla (-1 fuera de una regla)
+    const char *msg;
+} rules_compile_err_aq_t;
+
+typedef struct {
+    uint16_t rules;              // reglas activas en el programa cargado
+    uint16_t code_len;           // instrucciones
+    uint16_t consts;
+    uint16_t signals;            // señales con nombre
+    uint32_t loads;
+    uint32_t load_failures;
+    uint32_t last_compile_us;
+    uint32_t ticks;
+    uint32_t last_tick_us;
+    uint32_t max_tick_us;
+    uint32_t last_insns;         // instrucciones ejecutadas en el último tick
+    uint32_t tick_us[RULES_LAT_BUCKETS_AQ];  // bucket i = [2^i, 2^(i+1)) µs
+} rules_stats_aq_t;
+
+// Opcional; sin callback los cambios de salida solo se publican como RULES_OUTPUT_CHANGED
+typedef void (*rules_output_cb_aq_t)(uint8_t signal, float value, void *ctx);
+
+esp_err_t rules_init_aq(rules_output_cb_aq_t cb, void *ctx);
+// Compila y sustituye el programa activo de forma atómica entre ticks. Si falla, el
+// programa anterior sigue activo y *err (opcional) indica dónde.
+esp_err_t rules_load_aq(const char *json, size_t len, rules_compile_err_aq_t *err);
+// Índice de una señal por nombre, creándola si no existe (entradas y salidas comparten
+// el banco de registros). RULES_SIGNAL_INVALID_AQ si el banco está lleno.
+uint8_t   rules_signal_aq(const char *name);
+// Como rules_signal_aq pero sin crearla: para nombres que llegan de fuera (comandos del
+// MASTER), que no deben gastar registros. RULES_SIGNAL_INVALID_AQ si no existe.
+uint8_t   rules_find_signal_aq(const char *name);
+esp_err_t rules_set_input_aq(uint8_t signal, float value);
+float     rules_get_aq(uint8_t signal);
+// Evalúa todas las reglas una vez. Llamar periódicamente (app_manager_aq lo hace).
+esp_err_t rules_tick_aq(void);
+void      rules_get_stats_aq(rules_stats_aq_t *out);
+
+#ifdef __cplusplus
+}
+#endif
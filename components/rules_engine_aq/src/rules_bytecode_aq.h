@@ -0,0 +1,73 @@
+#pragma once
+#include <stdint.h>
+#include "rules_engine_aq.h"
+#include "sdkconfig.h"
+
+// Bytecode del motor de reglas. Instrucciones de 4 bytes (op, a, b); máquina de pila
+// de profundidad fija con los registros del banco de señales como memoria.
+// Los saltos son relativos y siempre hacia delante: cada instrucción se ejecuta como
+// mucho una vez por tick, así que el coste está acotado por code_len.
+
+#define RULES_STACK_DEPTH_AQ    16
+#define RULES_SIGNAL_NAME_MAX_AQ 24
+
+typedef enum {
+    RULES_OP_END = 0,
+    RULES_OP_LD_REG,     // push regs[a]
+    RULES_OP_LD_CONST,   // push consts[b]
+    RULES_OP_LT,         // pop y, x; push x < y
+    RULES_OP_LE,
+    RULES_OP_GT,
+    RULES_OP_GE,
+    RULES_OP_EQ,
+    RULES_OP_NE,
+    RULES_OP_LT_RK,      // push regs[a] < consts[b] (comparación fusionada, el caso común)
+    RULES_OP_LE_RK,
+    RULES_OP_GT_RK,
+    RULES_OP_GE_RK,
+    RULES_OP_EQ_RK,
+    RULES_OP_NE_RK,
+    RULES_OP_AND,        // pop y, x; push x && y
+    RULES_OP_OR,
+    RULES_OP_NOT,
+    RULES_OP_JF,         // pop; si es falso pc += b
+    RULES_OP_JMP,        // pc += b
+    RULES_OP_ST_CONST,   // regs[a] = consts[b]
+    RULES_OP_ST_REG,     // regs[a] = regs[b]
+} rules_op_aq_t;
+
+typedef struct {
+    uint8_t op;
+    uint8_t a;
+    uint16_t b;
+} rules_insn_aq_t;
+
+typedef struct {
+    rules_insn_aq_t code[CONFIG_AQ_RULES_MAX_CODE];
+    float consts[CONFIG_AQ_RULES_MAX_CONSTS];
+    uint16_t code_len;
+    uint16_t const_count;
+    uint16_t rule_count;
+    uint8_t max_depth;
+} rules_prog_aq_t;
+
+typedef struct {
+    char names[CONFIG_AQ_RULES_MAX_SIGNALS][RULES_SIGNAL_NAME_MAX_AQ];
+    uint16_t count;
+} rules_symtab_aq_t;
+
+// Banco de registros y seguimiento de cambios de salida dentro de un tick
+typedef struct {
+    float regs[CONFIG_AQ_RULES_MAX_SIGNALS];
+    float prev[CONFIG_AQ_RULES_MAX_SIGNALS];   // valor antes de la primera escritura del tick
+    uint32_t dirty[(CONFIG_AQ_RULES_MAX_SIGNALS + 31) / 32];
+} rules_vm_state_aq_t;
+
+uint8_t   rules_symtab_find_aq(const rules_symtab_aq_t *t, const char *name, size_t len);
+uint8_t   rules_symtab_intern_aq(rules_symtab_aq_t *t, const char *name, size_t len);
+esp_err_t rules_compile_aq(const char *json, size_t len, rules_symtab_aq_t *syms, rules_prog_aq_t *out,
+                           rules_compile_err_aq_t *err);
+// Ejecuta el programa; cb recibe las salidas cuyo valor final difiere del inicial.
+// Devuelve el número de instrucciones ejecutadas.
+uint32_t  rules_vm_run_aq(const rules_prog_aq_t *p, rules_vm_state_aq_t *st, rules_output_cb_aq_t cb,
+                          void *ctx);
@@ -0,0 +1,506 @@
+#include <stdlib.h>
+#include <string.h>
+#include "rules_bytecode_aq.h"
+
+// Compilador JSON -> bytecode. Lee el texto directamente (sin árbol de nodos ni heap):
+// primera pasada para localizar las reglas y ordenarlas por prioridad, segunda para
+// generar el código de cada una. No es reentrante; rules_engine_aq.c lo serializa.
+
+#define RULES_MAX_NESTING_AQ 8
+
+typedef struct {
+    const char *p;
+    const char *end;
+} span_t;
+
+typedef struct {
+    span_t body;
+    int32_t prio;
+    uint16_t index;    // orden en el texto, para el mensaje de error y un orden estable
+} rule_ref_t;
+
+typedef struct {
+    const char *base;
+    const char *p;
+    const char *end;
+    rules_symtab_aq_t *syms;
+    rules_prog_aq_t *prog;
+    int rule;
+    int sp;            // profundidad de pila estimada durante la generación
+    esp_err_t rc;
+    const char *msg;
+    const char *at;
+} cc_t;
+
+static rule_ref_t s_refs[CONFIG_AQ_RULES_MAX_RULES];
+
+// ---- Errores ----
+
+static bool fail(cc_t *c, esp_err_t rc, const char *msg) {
+    if (c->rc == ESP_OK) {
+        c->rc = rc;
+        c->msg = msg;
+        c->at = c->p;
+    }
+    return false;
+}
+
+// ---- Lectura de JSON ----
+
+static void skip_ws(cc_t *c) {
+    while (c->p < c->end && (*c->p == ' ' || *c->p == '\t' || *c->p == '\n' || *c->p == '\r')) c->p++;
+}
+
+static bool peek(cc_t *c, char ch) {
+    skip_ws(c);
+    return c->p < c->end && *c->p == ch;
+}
+
+static bool accept(cc_t *c, char ch) {
+    if (!peek(c, ch)) return false;
+    c->p++;
+    return true;
+}
+
+static bool expect(cc_t *c, char ch) {
+    if (accept(c, ch)) return true;
+    switch (ch) {
+    case '{': return fail(c, ESP_ERR_INVALID_ARG, "expected '{'");
+    case '}': return fail(c, ESP_ERR_INVALID_ARG, "expected '}'");
+    case '[': return fail(c, ESP_ERR_INVALID_ARG, "expected '['");
+    case ']': return fail(c, ESP_ERR_INVALID_ARG, "expected ']'");
+    case ':': return fail(c, ESP_ERR_INVALID_ARG, "expected ':'");
+    default: return fail(c, ESP_ERR_INVALID_ARG, "expected string");
+    }
+}
+
+static bool scan_str(cc_t *c, const char **s, size_t *n) {
+    if (!expect(c, '"')) return false;
+    const char *start = c->p;
+    while (c->p < c->end && *c->p != '"') {
+        if (*c->p == '\\') c->p++;
+        c->p++;
+    }
+    if (c->p >= c->end) return fail(c, ESP_ERR_INVALID_ARG, "unterminated string");
+    *s = start;
+    *n = (size_t)(c->p - start);
+    c->p++;
+    return true;
+}
+
+static bool key_is(const char *s, size_t n, const char *lit) {
+    return strlen(lit) == n && memcmp(s, lit, n) == 0;
+}
+
+static bool literal(cc_t *c, const char *lit) {
+    size_t n = strlen(lit);
+    skip_ws(c);
+    if ((size_t)(c->end - c->p) < n || memcmp(c->p, lit, n) != 0) return false;
+    c->p += n;
+    return true;
+}
+
+static bool scan_number(cc_t *c, float *out) {
+    skip_ws(c);
+    char tmp[32];
+    size_t n = 0;
+    while (c->p < c->end && n < sizeof(tmp) - 1 && strchr("+-0123456789.eE", *c->p)) tmp[n++] = *c->p++;
+    tmp[n] = '\0';
+    char *endp;
+    *out = strtof(tmp, &endp);
+    if (n == 0 || *endp != '\0') return fail(c, ESP_ERR_INVALID_ARG, "expected number");
+    return true;
+}
+
+static bool scan_bool(cc_t *c, bool *out) {
+    if (literal(c, "true")) {
+        *out = true;
+        return true;
+    }
+    if (literal(c, "false")) {
+        *out = false;
+        return true;
+    }
+    return fail(c, ESP_ERR_INVALID_ARG, "expected true/false");
+}
+
+static bool skip_value(cc_t *c, int depth) {
+    if (depth > RULES_MAX_NESTING_AQ * 2) return fail(c, ESP_ERR_INVALID_ARG, "nested too deep");
+    const char *s;
+    size_t n;
+    skip_ws(c);
+    if (c->p >= c->end) return fail(c, ESP_ERR_INVALID_ARG, "unexpected end");
+    char ch = *c->p;
+    if (ch == '"') return scan_str(c, &s, &n);
+    if (ch == '{' || ch == '[') {
+        char close = ch == '{' ? '}' : ']';
+        c->p++;
+        if (accept(c, close)) return true;
+        do {
+            if (ch == '{' && (!scan_str(c, &s, &n) || !expect(c, ':'))) return false;
+            if (!skip_value(c, depth + 1)) return false;
+        } while (accept(c, ','));
+        return expect(c, close);
+    }
+    if (literal(c, "true") || literal(c, "false") || literal(c, "null")) return true;
+    float f;
+    return scan_number(c, &f);
+}
+
+// Valor completo como span, para compilarlo después en el orden que convenga
+static bool take_span(cc_t *c, span_t *sp) {
+    skip_ws(c);
+    sp->p = c->p;
+    if (!skip_value(c, 0)) return false;
+    sp->end = c->p;
+    return true;
+}
+
+static void enter(cc_t *c, span_t sp, span_t *saved) {
+    saved->p = c->p;
+    saved->end = c->end;
+    c->p = sp.p;
+    c->end = sp.end;
+}
+
+static void leave(cc_t *c, const span_t *saved) {
+    c->p = saved->p;
+    c->end = saved->end;
+}
+
+// ---- Símbolos, constantes y emisión ----
+
+uint8_t rules_symtab_find_aq(const rules_symtab_aq_t *t, const char *name, size_t len) {
+    if (len == 0 || len >= RULES_SIGNAL_NAME_MAX_AQ) return RULES_SIGNAL_INVALID_AQ;
+    for (uint16_t i = 0; i < t->count; i++) {
+        if (strncmp(t->names[i], name, len) == 0 && t->names[i][len] == '\0') return (uint8_t)i;
+    }
+    return RULES_SIGNAL_INVALID_AQ;
+}
+
+uint8_t rules_symtab_intern_aq(rules_symtab_aq_t *t, const char *name, size_t len) {
+    if (len == 0 || len >= RULES_SIGNAL_NAME_MAX_AQ) return RULES_SIGNAL_INVALID_AQ;
+    uint8_t idx = rules_symtab_find_aq(t, name, len);
+    if (idx != RULES_SIGNAL_INVALID_AQ) return idx;
+    if (t->count >= CONFIG_AQ_RULES_MAX_SIGNALS) return RULES_SIGNAL_INVALID_AQ;
+    memcpy(t->names[t->count], name, len);
+    t->names[t->count][len] = '\0';
+    return (uint8_t)t->count++;
+}
+
+static bool signal_ref(cc_t *c, uint8_t *reg) {
+    const char *s;
+    size_t n;
+    if (!scan_str(c, &s, &n)) return false;
+    *reg = rules_symtab_intern_aq(c->syms, s, n);
+    if (*reg == RULES_SIGNAL_INVALID_AQ) return fail(c, ESP_ERR_INVALID_SIZE, "bad signal name or too many signals");
+    return true;
+}
+
+static bool constant(cc_t *c, float v, uint16_t *idx) {
+    rules_prog_aq_t *p = c->prog;
+    for (uint16_t i = 0; i < p->const_count; i++) {
+        if (memcmp(&p->consts[i], &v, sizeof(v)) == 0) {
+            *idx = i;
+            return true;
+        }
+    }
+    if (p->const_count >= CONFIG_AQ_RULES_MAX_CONSTS) return fail(c, ESP_ERR_INVALID_SIZE, "too many constants");
+    p->consts[p->const_count] = v;
+    *idx = p->const_count++;
+    return true;
+}
+
+static bool emit(cc_t *c, uint8_t op, uint8_t a, uint16_t b, int stack_delta) {
+    rules_prog_aq_t *p = c->prog;
+    if (p->code_len >= CONFIG_AQ_RULES_MAX_CODE) return fail(c, ESP_ERR_INVALID_SIZE, "program too large");
+    c->sp += stack_delta;
+    if (c->sp > RULES_STACK_DEPTH_AQ) return fail(c, ESP_ERR_INVALID_SIZE, "condition nested too deep");
+    if (c->sp > p->max_depth) p->max_depth = (uint8_t)c->sp;
+    p->code[p->code_len++] = (rules_insn_aq_t){.op = op, .a = a, .b = b};
+    return true;
+}
+
+static bool emit_const(cc_t *c, float v) {
+    uint16_t k;
+    return constant(c, v, &k) && emit(c, RULES_OP_LD_CONST, 0, k, +1);
+}
+
+// Salto hacia delante a parchear cuando se conozca el destino
+static void patch(cc_t *c, uint16_t at) {
+    c->prog->code[at].b = (uint16_t)(c->prog->code_len - at - 1);
+}
+
+// ---- Condiciones ----
+
+static int op_index(const char *s, size_t n) {
+    static const char *const ops[] = {"<", "<=", ">", ">=", "==", "!="};
+    for (int i = 0; i < 6; i++) {
+        if (key_is(s, n, ops[i])) return i;
+    }
+    return -1;
+}
+
+static bool compile_cond(cc_t *c, int depth);
+
+static bool compile_list(cc_t *c, span_t list, bool all, int depth) {
+    span_t saved;
+    enter(c, list, &saved);
+    int n = 0;
+    if (!expect(c, '[')) return false;
+    if (!accept(c, ']')) {
+        do {
+            if (!compile_cond(c, depth + 1)) return false;
+            if (n++ && !emit(c, all ? RULES_OP_AND : RULES_OP_OR, 0, 0, -1)) return false;
+        } while (accept(c, ','));
+        if (!expect(c, ']')) return false;
+    }
+    leave(c, &saved);
+    // all([]) es verdadero y any([]) falso
+    return n ? true : emit_const(c, all ? 1.0f : 0.0f);
+}
+
+static bool compile_cond(cc_t *c, int depth) {
+    if (depth > RULES_MAX_NESTING_AQ) return fail(c, ESP_ERR_INVALID_SIZE, "condition nested too deep");
+    if (literal(c, "true")) return emit_const(c, 1.0f);
+    if (literal(c, "false")) return emit_const(c, 0.0f);
+    if (!expect(c, '{')) return false;
+
+    span_t list = {0}, inner = {0};
+    bool all = false, has_value = false, has_sig = false, has_sig2 = false;
+    uint8_t sig = 0, sig2 = 0;
+    float value = 0;
+    int op = -1;
+    const char *s;
+    size_t n;
+    do {
+        if (!scan_str(c, &s, &n) || !expect(c, ':')) return false;
+        if (key_is(s, n, "all") || key_is(s, n, "any")) {
+            all = s[1] == 'l';
+            if (!take_span(c, &list)) return false;
+        } else if (key_is(s, n, "not")) {
+            if (!take_span(c, &inner)) return false;
+        } else if (key_is(s, n, "sig")) {
+            if (!signal_ref(c, &sig)) return false;
+            has_sig = true;
+        } else if (key_is(s, n, "sig2")) {
+            if (!signal_ref(c, &sig2)) return false;
+            has_sig2 = true;
+        } else if (key_is(s, n, "op")) {
+            const char *o;
+            size_t on;
+            if (!scan_str(c, &o, &on)) return false;
+            if ((op = op_index(o, on)) < 0) return fail(c, ESP_ERR_INVALID_ARG, "unknown operator");
+        } else if (key_is(s, n, "value")) {
+            if (!scan_number(c, &value)) return false;
+            has_value = true;
+        } else if (!skip_value(c, depth)) {
+            return false;
+        }
+    } while (accept(c, ','));
+    if (!expect(c, '}')) return false;
+
+    if (list.p) return compile_list(c, list, all, depth);
+    if (inner.p) {
+        span_t saved;
+        enter(c, inner, &saved);
+        bool ok = compile_cond(c, depth + 1);
+        leave(c, &saved);
+        return ok && emit(c, RULES_OP_NOT, 0, 0, 0);
+    }
+    if (!has_sig || op < 0 || has_value == has_sig2) {
+        return fail(c, ESP_ERR_INVALID_ARG, "comparison needs sig, op and one of value/sig2");
+    }
+    if (has_value) {
+        uint16_t k;
+        return constant(c, value, &k) && emit(c, RULES_OP_LT_RK + op, sig, k, +1);
+    }
+    return emit(c, RULES_OP_LD_REG, sig, 0, +1) && emit(c, RULES_OP_LD_REG, sig2, 0, +1) &&
+           emit(c, RULES_OP_LT + op, 0, 0, -1);
+}
+
+// ---- Acciones ----
+
+static bool compile_actions(cc_t *c, span_t list) {
+    span_t saved;
+    enter(c, list, &saved);
+    if (!expect(c, '[')) return false;
+    if (!accept(c, ']')) {
+        do {
+            uint8_t dst = 0, src = 0;
+            bool has_dst = false, has_value = false, has_src = false;
+            float value = 0;
+            const char *s;
+            size_t n;
+            if (!expect(c, '{')) return false;
+            do {
+                if (!scan_str(c, &s, &n) || !expect(c, ':')) return false;
+                if (key_is(s, n, "set")) {
+                    if (!signal_ref(c, &dst)) return false;
+                    has_dst = true;
+                } else if (key_is(s, n, "value")) {
+                    if (!scan_number(c, &value)) return false;
+                    has_value = true;
+                } else if (key_is(s, n, "sig")) {
+                    if (!signal_ref(c, &src)) return false;
+                    has_src = true;
+                } else if (!skip_value(c, 0)) {
+                    return false;
+                }
+            } while (accept(c, ','));
+            if (!expect(c, '}')) return false;
+            if (!has_dst || has_value == has_src) {
+                return fail(c, ESP_ERR_INVALID_ARG, "action needs set and one of value/sig");
+            }
+            uint16_t k;
+            if (has_value ? !(constant(c, value, &k) && emit(c, RULES_OP_ST_CONST, dst, k, 0))
+                          : !emit(c, RULES_OP_ST_REG, dst, src, 0)) {
+                return false;
+            }
+        } while (accept(c, ','));
+        if (!expect(c, ']')) return false;
+    }
+    leave(c, &saved);
+    return true;
+}
+
+// ---- Reglas ----
+
+// Primera pasada sobre una regla: prioridad y si está habilitada
+static bool scan_rule(cc_t *c, rule_ref_t *ref, bool *enabled) {
+    const char *s;
+    size_t n;
+    float prio = 0;
+    *enabled = true;
+    if (!take_span(c, &ref->body)) return false;
+    span_t saved;
+    enter(c, ref->body, &saved);
+    if (!expect(c, '{')) return false;
+    if (!accept(c, '}')) {
+        do {
+            if (!scan_str(c, &s, &n) || !expect(c, ':')) return false;
+            if (key_is(s, n, "prio")) {
+                if (!scan_number(c, &prio)) return false;
+            } else if (key_is(s, n, "enabled")) {
+                if (!scan_bool(c, enabled)) return false;
+            } else if (!skip_value(c, 0)) {
+                return false;
+            }
+        } while (accept(c, ','));
+        if (!expect(c, '}')) return false;
+    }
+    leave(c, &saved);
+    ref->prio = (int32_t)prio;
+    return true;
+}
+
+static bool compile_rule(cc_t *c, const rule_ref_t *ref) {
+    span_t when = {0}, then = {0}, other = {0}, saved;
+    const char *s;
+    size_t n;
+    enter(c, ref->body, &saved);
+    expect(c, '{');
+    if (!accept(c, '}')) {
+        do {
+            if (!scan_str(c, &s, &n) || !expect(c, ':')) return false;
+            if (key_is(s, n, "when")) {
+                if (!take_span(c, &when)) return false;
+            } else if (key_is(s, n, "then")) {
+                if (!take_span(c, &then)) return false;
+            } else if (key_is(s, n, "else")) {
+                if (!take_span(c, &other)) return false;
+            } else if (!skip_value(c, 0)) {
+                return false;
+            }
+        } while (accept(c, ','));
+    }
+    leave(c, &saved);
+    if (!then.p && !other.p) return fail(c, ESP_ERR_INVALID_ARG, "rule without actions");
+
+    // Sin "when" la regla se aplica siempre
+    if (!when.p) return then.p ? compile_actions(c, then) : true;
+
+    enter(c, when, &saved);
+    bool ok = compile_cond(c, 0);
+    leave(c, &saved);
+    uint16_t jf = c->prog->code_len;
+    if (!ok || !emit(c, RULES_OP_JF, 0, 0, -1)) return false;
+    if (then.p && !compile_actions(c, then)) return false;
+    if (other.p) {
+        uint16_t jmp = c->prog->code_len;
+        if (!emit(c, RULES_OP_JMP, 0, 0, 0)) return false;
+        patch(c, jf);
+        if (!compile_actions(c, other)) return false;
+        patch(c, jmp);
+    } else {
+        patch(c, jf);
+    }
+    return true;
+}
+
+esp_err_t rules_compile_aq(const char *json, size_t len, rules_symtab_aq_t *syms, rules_prog_aq_t *out,
+                           rules_compile_err_aq_t *err) {
+    cc_t c = {.base = json, .p = json, .end = json + len, .syms = syms, .prog = out, .rule = -1};
+    uint16_t sym_count = syms->count;
+    uint16_t count = 0;
+    out->code_len = out->const_count = out->rule_count = 0;
+    out->max_depth = 0;
+
+    // Se acepta {"rules": [...]} o directamente [...]
+    bool wrapped = accept(&c, '{');
+    if (wrapped) {
+        const char *s;
+        size_t n;
+        if (!scan_str(&c, &s, &n) || !key_is(s, n, "rules")) {
+            fail(&c, ESP_ERR_INVALID_ARG, "expected \"rules\"");
+            goto out;
+        }
+        if (!expect(&c, ':')) goto out;
+    }
+    if (!expect(&c, '[')) goto out;
+    if (!accept(&c, ']')) {
+        do {
+            bool enabled;
+            c.rule = count;
+            if (count >= CONFIG_AQ_RULES_MAX_RULES) {
+                fail(&c, ESP_ERR_INVALID_SIZE, "too many rules");
+                goto out;
+            }
+            s_refs[count].index = count;
+            if (!scan_rule(&c, &s_refs[count], &enabled)) goto out;
+            if (enabled) count++;
+        } while (accept(&c, ','));
+        if (!expect(&c, ']')) goto out;
+    }
+    if (wrapped && !expect(&c, '}')) goto out;
+
+    // Orden ascendente de prioridad (estable): la de mayor prioridad escribe la última
+    for (uint16_t i = 1; i < count; i++) {
+        rule_ref_t r = s_refs[i];
+        int j = i - 1;
+        while (j >= 0 && s_refs[j].prio > r.prio) {
+            s_refs[j + 1] = s_refs[j];
+            j--;
+        }
+        s_refs[j + 1] = r;
+    }
+    for (uint16_t i = 0; i < count; i++) {
+        c.rule = s_refs[i].index;
+        c.sp = 0;
+        if (!compile_rule(&c, &s_refs[i])) goto out;
+    }
+    c.rule = -1;
+    out->rule_count = count;
+    if (!emit(&c, RULES_OP_END, 0, 0, 0)) goto out;
+
+out:
+    if (c.rc != ESP_OK) {
+        syms->count = sym_count;  // descartar señales creadas por el programa fallido
+        if (err) {
+            err->offset = (size_t)(c.at - json);
+            err->rule = c.rule;
+            err->msg = c.msg;
+        }
+    }
+    return c.rc;
+}
@@ -0,0 +1,148 @@
+#include "rules_engine_aq.h"
+#include <stdatomic.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "rules_bytecode_aq.h"
+
+static const char *TAG = "rules_engine_aq";
+
+ESP_EVENT_DEFINE_BASE(RULES_EVENTS);
+
+// Doble buffer: se compila en el programa inactivo y se intercambia entre ticks
+static rules_prog_aq_t s_progs[2];
+static atomic_int s_active = -1;       // -1 = sin programa
+static rules_symtab_aq_t s_syms;
+static rules_vm_state_aq_t s_vm;
+static rules_stats_aq_t s_stats;
+static rules_output_cb_aq_t s_cb;
+static void *s_cb_ctx;
+
+// s_lock: tick, intercambio y estadísticas (se retiene microsegundos).
+// s_load_lock: compilación y tabla de símbolos (puede durar milisegundos).
+static StaticSemaphore_t s_lock_buf;
+static StaticSemaphore_t s_load_lock_buf;
+static SemaphoreHandle_t s_lock;
+static SemaphoreHandle_t s_load_lock;
+
+static void on_output(uint8_t signal, float value, void *ctx) {
+    rules_output_aq_t out = {.signal = signal, .value = value};
+    if (s_cb) s_cb(signal, value, s_cb_ctx);
+    esp_event_post(RULES_EVENTS, RULES_OUTPUT_CHANGED, &out, sizeof(out), 0);
+}
+
+esp_err_t rules_init_aq(rules_output_cb_aq_t cb, void *ctx) {
+    if (s_lock) return ESP_ERR_INVALID_STATE;
+    s_lock = xSemaphoreCreateMutexStatic(&s_lock_buf);
+    s_load_lock = xSemaphoreCreateMutexStatic(&s_load_lock_buf);
+    s_cb = cb;
+    s_cb_ctx = ctx;
+    ESP_LOGI(TAG, "Rules engine ready: %d rules, %d signals, %d insns max", CONFIG_AQ_RULES_MAX_RULES,
+             CONFIG_AQ_RULES_MAX_SIGNALS, CONFIG_AQ_RULES_MAX_CODE);
+    return ESP_OK;
+}
+
+esp_err_t rules_load_aq(const char *json, size_t len, rules_compile_err_aq_t *err) {
+    if (s_lock == NULL) return ESP_ERR_INVALID_STATE;
+    if (json == NULL) return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake(s_load_lock, portMAX_DELAY);
+    int next = atomic_load(&s_active) == 0 ? 1 : 0;
+    rules_compile_err_aq_t e = {0};
+    // Un programa rechazado no debe quedarse registros: si no, cada recarga fallida en
+    // <prefix>rules gasta huecos hasta que ni las reglas válidas caben
+    uint16_t sym_count = s_syms.count;
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t rc = rules_compile_aq(json, len, &s_syms, &s_progs[next], &e);
+    uint32_t dt = (uint32_t)(esp_timer_get_time() - t0);
+    if (rc != ESP_OK) s_syms.count = sym_count;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (rc == ESP_OK) {
+        atomic_store(&s_active, next);
+        s_stats.loads++;
+        s_stats.rules = s_progs[next].rule_count;
+        s_stats.code_len = s_progs[next].code_len;
+        s_stats.consts = s_progs[next].const_count;
+        s_stats.last_compile_us = dt;
+    } else {
+        s_stats.load_failures++;
+    }
+    s_stats.signals = s_syms.count;
+    rules_stats_aq_t snap = s_stats;
+    xSemaphoreGive(s_lock);
+    xSemaphoreGive(s_load_lock);
+
+    if (rc != ESP_OK) {
+        ESP_LOGE(TAG, "Rules rejected at offset %u (rule %d): %s", (unsigned)e.offset, e.rule, e.msg);
+        if (err) *err = e;
+        return rc;
+    }
+    ESP_LOGI(TAG, "Loaded %u rules: %u insns, %u consts, compiled in %lu us", snap.rules, snap.code_len,
+             snap.consts, (unsigned long)dt);
+    esp_event_post(RULES_EVENTS, RULES_LOADED, &snap, sizeof(snap), 0);
+    return ESP_OK;
+}
+
+uint8_t rules_signal_aq(const char *name) {
+    if (s_lock == NULL || name == NULL) return RULES_SIGNAL_INVALID_AQ;
+    xSemaphoreTake(s_load_lock, portMAX_DELAY);
+    uint8_t idx = rules_symtab_intern_aq(&s_syms, name, strlen(name));
+    xSemaphoreGive(s_load_lock);
+    return idx;
+}
+
+uint8_t rules_find_signal_aq(const char *name) {
+    if (s_lock == NULL || name == NULL) return RULES_SIGNAL_INVALID_AQ;
+    xSemaphoreTake(s_load_lock, portMAX_DELAY);
+    uint8_t idx = rules_symtab_find_aq(&s_syms, name, strlen(name));
+    xSemaphoreGive(s_load_lock);
+    return idx;
+}
+
+// Escritura de una palabra alineada: atómica en Xtensa, sin lock desde cualquier tarea
+esp_err_t rules_set_input_aq(uint8_t signal, float value) {
+    if (signal >= CONFIG_AQ_RULES_MAX_SIGNALS) return ESP_ERR_INVALID_ARG;
+    ((volatile float *)s_vm.regs)[signal] = value;
+    return ESP_OK;
+}
+
+float rules_get_aq(uint8_t signal) {
+    if (signal >= CONFIG_AQ_RULES_MAX_SIGNALS) return 0.0f;
+    return ((volatile float *)s_vm.regs)[signal];
+}
+
+esp_err_t rules_tick_aq(void) {
+    if (s_lock == NULL) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int active = atomic_load(&s_active);
+    if (active < 0) {
+        xSemaphoreGive(s_lock);
+        return ESP_ERR_NOT_FOUND;
+    }
+    int64_t t0 = esp_timer_get_time();
+    uint32_t insns = rules_vm_run_aq(&s_progs[active], &s_vm, on_output, NULL);
+    uint32_t dt = (uint32_t)(esp_timer_get_time() - t0);
+
+    int b = 0;
+    for (uint32_t v = dt; v > 1 && b < RULES_LAT_BUCKETS_AQ - 1; v >>= 1) b++;
+    s_stats.tick_us[b]++;
+    s_stats.ticks++;
+    s_stats.last_tick_us = dt;
+    s_stats.last_insns = insns;
+    if (dt > s_stats.max_tick_us) s_stats.max_tick_us = dt;
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+void rules_get_stats_aq(rules_stats_aq_t *out) {
+    if (s_lock == NULL) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = s_stats;
+    xSemaphoreGive(s_lock);
+}
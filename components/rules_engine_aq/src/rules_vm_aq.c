@@ -0,0 +1,71 @@
+#include <string.h>
+#include "rules_bytecode_aq.h"
+
+// Intérprete: sin asignaciones, sin recursión y sin saltos hacia atrás.
+// El compilador garantiza que la pila nunca supera RULES_STACK_DEPTH_AQ.
+
+static inline void store(rules_vm_state_aq_t *st, uint8_t r, float v) {
+    uint32_t bit = 1u << (r & 31);
+    if (!(st->dirty[r >> 5] & bit)) {
+        st->dirty[r >> 5] |= bit;
+        st->prev[r] = st->regs[r];
+    }
+    st->regs[r] = v;
+}
+
+uint32_t rules_vm_run_aq(const rules_prog_aq_t *p, rules_vm_state_aq_t *st, rules_output_cb_aq_t cb,
+                         void *ctx) {
+    float stack[RULES_STACK_DEPTH_AQ];
+    int sp = 0;
+    uint32_t executed = 0;
+    const rules_insn_aq_t *code = p->code;
+    const float *k = p->consts;
+    float *regs = st->regs;
+    uint32_t pc = 0;
+
+    while (pc < p->code_len) {
+        const rules_insn_aq_t in = code[pc++];
+        executed++;
+        switch (in.op) {
+        case RULES_OP_LD_REG: stack[sp++] = regs[in.a]; break;
+        case RULES_OP_LD_CONST: stack[sp++] = k[in.b]; break;
+        case RULES_OP_LT: sp--; stack[sp - 1] = stack[sp - 1] < stack[sp]; break;
+        case RULES_OP_LE: sp--; stack[sp - 1] = stack[sp - 1] <= stack[sp]; break;
+        case RULES_OP_GT: sp--; stack[sp - 1] = stack[sp - 1] > stack[sp]; break;
+        case RULES_OP_GE: sp--; stack[sp - 1] = stack[sp - 1] >= stack[sp]; break;
+        case RULES_OP_EQ: sp--; stack[sp - 1] = stack[sp - 1] == stack[sp]; break;
+        case RULES_OP_NE: sp--; stack[sp - 1] = stack[sp - 1] != stack[sp]; break;
+        case RULES_OP_LT_RK: stack[sp++] = regs[in.a] < k[in.b]; break;
+        case RULES_OP_LE_RK: stack[sp++] = regs[in.a] <= k[in.b]; break;
+        case RULES_OP_GT_RK: stack[sp++] = regs[in.a] > k[in.b]; break;
+        case RULES_OP_GE_RK: stack[sp++] = regs[in.a] >= k[in.b]; break;
+        case RULES_OP_EQ_RK: stack[sp++] = regs[in.a] == k[in.b]; break;
+        case RULES_OP_NE_RK: stack[sp++] = regs[in.a] != k[in.b]; break;
+        case RULES_OP_AND: sp--; stack[sp - 1] = (stack[sp - 1] != 0.0f) && (stack[sp] != 0.0f); break;
+        case RULES_OP_OR: sp--; stack[sp - 1] = (stack[sp - 1] != 0.0f) || (stack[sp] != 0.0f); break;
+        case RULES_OP_NOT: stack[sp - 1] = stack[sp - 1] == 0.0f; break;
+        case RULES_OP_JF:
+            if (stack[--sp] == 0.0f) pc += in.b;
+            break;
+        case RULES_OP_JMP: pc += in.b; break;
+        case RULES_OP_ST_CONST: store(st, in.a, k[in.b]); break;
+        case RULES_OP_ST_REG: store(st, in.a, regs[in.b]); break;
+        case RULES_OP_END:
+        default:
+            pc = p->code_len;
+            break;
+        }
+    }
+
+    // Notificar solo las salidas cuyo valor final ha cambiado en este tick
+    for (int w = 0; w < (int)(sizeof(st->dirty) / sizeof(st->dirty[0])); w++) {
+        uint32_t bits = st->dirty[w];
+        st->dirty[w] = 0;
+        while (bits) {
+            int r = w * 32 + __builtin_ctz(bits);
+            bits &= bits - 1;
+            if (regs[r] != st->prev[r] && cb) cb((uint8_t)r, regs[r], ctx);
+        }
+    }
+    return executed;
+}
@@ -0,0 +1,296 @@
+// Benchmark de host (Linux) de telemetry_codec_aq.
+//
+// Para cada mensaje del esquema mide bytes en el cable, tiempo de codificar y de
+// decodificar y pico de heap en tres variantes: CBOR, JSON de respaldo (ambos de
+// este componente) y cJSON, que es lo que proponía el documento de diseño.
+// cJSON solo entra si el CMake lo encuentra (HAVE_CJSON). Antes de medir se
+// comprueba que cada variante decodifica exactamente lo que codificó.
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "telemetry_codec_aq.h"
+#include "tlm_schema_aq.h"
+#ifdef HAVE_CJSON
+#include "cJSON.h"
+#endif
+
+#define OUT_CAP 2048
+
+static uint32_t s_iters = 100000;
+static uint16_t s_burst = 16;
+static uint8_t s_arena_buf[CONFIG_AQ_TLM_ARENA_SIZE];
+static volatile size_t s_sink;   // evita que el compilador elimine el trabajo
+
+typedef struct {
+    const char *codec;
+    size_t bytes;
+    double enc_ns;
+    double dec_ns;
+    size_t heap_peak;        // heap (cJSON) o arena (este componente)
+    uint32_t allocs_per_msg;
+} result_t;
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void print_result(const char *msg, const result_t *r) {
+    printf("RESULT msg=%s codec=%s bytes=%zu enc_ns=%.0f dec_ns=%.0f peak_mem=%zu allocs_per_msg=%u\n",
+           msg, r->codec, r->bytes, r->enc_ns, r->dec_ns, r->heap_peak, r->allocs_per_msg);
+}
+
+// ---- Mensajes de ejemplo ----
+
+static float s_values[TLM_MAX_FLOATS_AQ];
+
+static void build_samples(tlm_msg_aq_t *msgs) {
+    for (int i = 0; i < s_burst; i++) s_values[i] = 25.0f + 0.125f * i;
+    const char *id = "aq-panel-01", *api = "1.0", *fw = "5.2";
+
+    msgs[0].type = TLM_MSG_HEARTBEAT_AQ;
+    msgs[0].heartbeat = (tlm_heartbeat_aq_t){id, api, fw, 1234, 86400, 187000, 152000};
+    msgs[1].type = TLM_MSG_SENSOR_AQ;
+    msgs[1].sensor = (tlm_sensor_aq_t){id, api, fw, 77, 123456789, "temp_sump", "C", {s_values, s_burst}};
+    msgs[2].type = TLM_MSG_COMMAND_AQ;
+    msgs[2].command = (tlm_command_aq_t){id, api, fw, 42, "set", "heater_1", 25.5f};
+    msgs[3].type = TLM_MSG_ACK_AQ;
+    msgs[3].ack = (tlm_ack_aq_t){id, api, fw, 42, false, "target \"heater_1\" busy"};
+}
+
+static bool same_msg(const tlm_msg_aq_t *a, const tlm_msg_aq_t *b) {
+    const tlm_schema_desc_aq_t *s = tlm_schema_get_aq(a->type);
+    if (a->type != b->type) return false;
+    const uint8_t *pa = (const uint8_t *)&a->heartbeat, *pb = (const uint8_t *)&b->heartbeat;
+    for (int i = 0; i < s->count; i++) {
+        const tlm_field_desc_aq_t *f = &s->fields[i];
+        const void *va = pa + f->offset, *vb = pb + f->offset;
+        switch (f->type) {
+        case TLM_T_U32:
+            if (*(const uint32_t *)va != *(const uint32_t *)vb) return false;
+            break;
+        case TLM_T_F32:
+            if (fabsf(*(const float *)va - *(const float *)vb) > 1e-6f) return false;
+            break;
+        case TLM_T_BOOL:
+            if (*(const bool *)va != *(const bool *)vb) return false;
+            break;
+        case TLM_T_STR: {
+            const char *sa = *(const char *const *)va, *sb = *(const char *const *)vb;
+            if ((sa == NULL) != (sb == NULL) || (sa && strcmp(sa, sb) != 0)) return false;
+            break;
+        }
+        case TLM_T_F32_ARR: {
+            const tlm_f32_arr_aq_t *x = va, *y = vb;
+            if (x->n != y->n) return false;
+            for (int k = 0; k < x->n; k++) {
+                if (fabsf(x->v[k] - y->v[k]) > 1e-6f) return false;
+            }
+            break;
+        }
+        }
+    }
+    return true;
+}
+
+// ---- Este componente ----
+
+static bool bench_aq(tlm_format_aq_t fmt, const tlm_msg_aq_t *msg, result_t *r) {
+    static uint8_t out[OUT_CAP];
+    tlm_arena_aq_t arena;
+    tlm_arena_init_aq(&arena, s_arena_buf, sizeof(s_arena_buf));
+    size_t len = 0;
+    tlm_msg_aq_t dec;
+
+    if (tlm_encode_aq(fmt, msg, out, sizeof(out), &len) != ESP_OK ||
+        tlm_decode_aq(fmt, out, len, &arena, &dec) != ESP_OK || !same_msg(msg, &dec)) {
+        fprintf(stderr, "%s round trip failed for %s\n", tlm_format_name_aq(fmt), tlm_msg_name_aq(msg->type));
+        return false;
+    }
+
+    int64_t t0 = now_ns();
+    for (uint32_t i = 0; i < s_iters; i++) {
+        tlm_encode_aq(fmt, msg, out, sizeof(out), &len);
+        s_sink += len;
+    }
+    int64_t t1 = now_ns();
+    for (uint32_t i = 0; i < s_iters; i++) {
+        tlm_arena_reset_aq(&arena);
+        tlm_decode_aq(fmt, out, len, &arena, &dec);
+        s_sink += dec.type;
+    }
+    int64_t t2 = now_ns();
+
+    r->codec = tlm_format_name_aq(fmt);
+    r->bytes = len;
+    r->enc_ns = (double)(t1 - t0) / s_iters;
+    r->dec_ns = (double)(t2 - t1) / s_iters;
+    r->heap_peak = arena.peak;
+    r->allocs_per_msg = 0;
+    return true;
+}
+
+#ifdef HAVE_CJSON
+// ---- cJSON con un asignador que cuenta ----
+
+typedef struct {
+    size_t size;
+    size_t pad;     // mantiene la alineación de 16 del bloque devuelto
+} alloc_hdr_t;
+
+static size_t s_heap_now, s_heap_peak;
+static uint32_t s_allocs;
+
+static void *count_malloc(size_t n) {
+    alloc_hdr_t *h = malloc(sizeof(*h) + n);
+    if (h == NULL) return NULL;
+    h->size = n;
+    s_heap_now += n;
+    if (s_heap_now > s_heap_peak) s_heap_peak = s_heap_now;
+    s_allocs++;
+    return h + 1;
+}
+
+static void count_free(void *p) {
+    if (p == NULL) return;
+    alloc_hdr_t *h = (alloc_hdr_t *)p - 1;
+    s_heap_now -= h->size;
+    free(h);
+}
+
+static char *cjson_encode(const tlm_msg_aq_t *msg) {
+    const tlm_schema_desc_aq_t *s = tlm_schema_get_aq(msg->type);
+    const uint8_t *b = (const uint8_t *)&msg->heartbeat;
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "type", s->name);
+    for (int i = 0; i < s->count; i++) {
+        const tlm_field_desc_aq_t *f = &s->fields[i];
+        const void *v = b + f->offset;
+        switch (f->type) {
+        case TLM_T_U32: cJSON_AddNumberToObject(root, f->name, *(const uint32_t *)v); break;
+        case TLM_T_F32: cJSON_AddNumberToObject(root, f->name, *(const float *)v); break;
+        case TLM_T_BOOL: cJSON_AddBoolToObject(root, f->name, *(const bool *)v); break;
+        case TLM_T_STR:
+            if (*(const char *const *)v) cJSON_AddStringToObject(root, f->name, *(const char *const *)v);
+            break;
+        case TLM_T_F32_ARR: {
+            const tlm_f32_arr_aq_t *a = v;
+            if (a->n) cJSON_AddItemToObject(root, f->name, cJSON_CreateFloatArray(a->v, a->n));
+            break;
+        }
+        }
+    }
+    char *out = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return out;
+}
+
+// Decodificar = parsear y leer cada campo del esquema, como haría el firmware
+static size_t cjson_decode(const char *text) {
+    size_t acc = 0;
+    cJSON *root = cJSON_Parse(text);
+    if (root == NULL) return 0;
+    const cJSON *type = cJSON_GetObjectItem(root, "type");
+    tlm_msg_type_aq_t t = type && cJSON_IsString(type) ? tlm_schema_by_name_aq(type->valuestring,
+                                                                              strlen(type->valuestring))
+                                                       : TLM_MSG_NONE_AQ;
+    const tlm_schema_desc_aq_t *s = tlm_schema_get_aq(t);
+    for (int i = 0; s && i < s->count; i++) {
+        const cJSON *it = cJSON_GetObjectItem(root, s->fields[i].name);
+        if (it == NULL) continue;
+        if (cJSON_IsArray(it)) {
+            for (const cJSON *e = it->child; e; e = e->next) acc += (size_t)e->valuedouble;
+        } else if (cJSON_IsString(it)) {
+            acc += strlen(it->valuestring);
+        } else {
+            acc += (size_t)it->valuedouble;
+        }
+    }
+    cJSON_Delete(root);
+    return acc + 1;
+}
+
+static bool bench_cjson(const tlm_msg_aq_t *msg, result_t *r) {
+    s_heap_now = s_heap_peak = 0;
+    s_allocs = 0;
+    char *text = cjson_encode(msg);
+    size_t enc_peak = s_heap_peak;
+    uint32_t enc_allocs = s_allocs;
+    if (text == NULL || cjson_decode(text) == 0) {
+        fprintf(stderr, "cJSON round trip failed for %s\n", tlm_msg_name_aq(msg->type));
+        return false;
+    }
+    size_t len = strlen(text);
+
+    int64_t t0 = now_ns();
+    for (uint32_t i = 0; i < s_iters; i++) {
+        char *t = cjson_encode(msg);
+        s_sink += t[0];
+        cJSON_free(t);
+    }
+    int64_t t1 = now_ns();
+    s_heap_now = s_heap_peak = 0;
+    s_allocs = 0;
+    for (uint32_t i = 0; i < s_iters; i++) {
+        s_sink += cjson_decode(text);
+    }
+    int64_t t2 = now_ns();
+    size_t dec_peak = s_heap_peak;
+    uint32_t dec_allocs = s_allocs / s_iters;
+    cJSON_free(text);
+
+    r->codec = "cjson";
+    r->bytes = len;
+    r->enc_ns = (double)(t1 - t0) / s_iters;
+    r->dec_ns = (double)(t2 - t1) / s_iters;
+    r->heap_peak = enc_peak > dec_peak ? enc_peak : dec_peak;
+    r->allocs_per_msg = enc_allocs + dec_allocs;
+    return true;
+}
+#endif
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-n iterations] [-b sensor_burst]\n", prog);
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "n:b:h")) != -1) {
+        switch (opt) {
+        case 'n': s_iters = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'b': s_burst = (uint16_t)strtoul(optarg, NULL, 0); break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (s_iters == 0 || s_burst == 0 || s_burst > TLM_MAX_FLOATS_AQ) {
+        usage(argv[0]);
+        return 2;
+    }
+#ifdef HAVE_CJSON
+    cJSON_Hooks hooks = {count_malloc, count_free};
+    cJSON_InitHooks(&hooks);
+#else
+    printf("NOTICE built without cJSON (set CJSON_DIR or IDF_PATH): no codec=cjson rows\n");
+#endif
+
+    tlm_msg_aq_t msgs[4];
+    build_samples(msgs);
+    for (int m = 0; m < 4; m++) {
+        result_t r;
+        const char *name = tlm_msg_name_aq(msgs[m].type);
+        if (!bench_aq(TLM_FMT_CBOR_AQ, &msgs[m], &r)) return 1;
+        print_result(name, &r);
+        if (!bench_aq(TLM_FMT_JSON_AQ, &msgs[m], &r)) return 1;
+        print_result(name, &r);
+#ifdef HAVE_CJSON
+        if (!bench_cjson(&msgs[m], &r)) return 1;
+        print_result(name, &r);
+#endif
+    }
+    return 0;
+}
@@ -0,0 +1,4 @@
+#pragma once
+// Valores por defecto del Kconfig de telemetry_codec_aq
+#define CONFIG_AQ_TLM_DEFAULT_CBOR 1
+#define CONFIG_AQ_TLM_ARENA_SIZE 1024
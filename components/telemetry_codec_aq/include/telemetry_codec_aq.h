@@ -0,0 +1,52 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "telemetry_schema_aq.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Códec de mensajes panel <-> MASTER. CBOR compacto (claves enteras del esquema)
+// con JSON del contrato como alternativa negociada. Sin heap: codificar escribe en
+// el buffer del llamante y decodificar solo usa un arena que se reinicia por mensaje.
+
+typedef enum {
+    TLM_FMT_CBOR_AQ,
+    TLM_FMT_JSON_AQ,
+} tlm_format_aq_t;
+
+// Arena de asignación lineal; free no existe, se reinicia entero por mensaje
+typedef struct {
+    uint8_t *base;
+    size_t cap;
+    size_t used;
+    size_t peak;   // máximo usado desde init, para dimensionar AQ_TLM_ARENA_SIZE
+} tlm_arena_aq_t;
+
+void  tlm_arena_init_aq(tlm_arena_aq_t *a, void *buf, size_t cap);
+void *tlm_arena_alloc_aq(tlm_arena_aq_t *a, size_t size, size_t align);
+static inline void tlm_arena_reset_aq(tlm_arena_aq_t *a) { a->used = 0; }
+
+// Campos STR NULL y F32_ARR vacíos no se emiten. ESP_ERR_INVALID_SIZE si no cabe en cap.
+esp_err_t tlm_encode_aq(tlm_format_aq_t fmt, const tlm_msg_aq_t *msg, uint8_t *out, size_t cap,
+                        size_t *out_len);
+// Decodifica en *msg; cadenas y arrays se copian al arena (las cadenas con '\0').
+// Los campos ausentes quedan a cero y las claves desconocidas se ignoran.
+esp_err_t tlm_decode_aq(tlm_format_aq_t fmt, const uint8_t *in, size_t len, tlm_arena_aq_t *arena,
+                        tlm_msg_aq_t *msg);
+// Formato de un mensaje recibido: '{' => JSON, mapa CBOR => CBOR
+esp_err_t tlm_detect_format_aq(const uint8_t *in, size_t len, tlm_format_aq_t *fmt);
+
+// Formato de salida negociado con el MASTER. Arranca con AQ_TLM_DEFAULT_FORMAT.
+// offer es una lista "cbor,json" en orden de preferencia del MASTER; se elige el
+// primero soportado. ESP_ERR_NOT_SUPPORTED si ninguno lo está (se mantiene el actual).
+esp_err_t       tlm_negotiate_aq(const char *offer);
+tlm_format_aq_t tlm_get_format_aq(void);
+const char     *tlm_format_name_aq(tlm_format_aq_t fmt);
+const char     *tlm_msg_name_aq(tlm_msg_type_aq_t type);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,90 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// Esquema de los mensajes panel <-> MASTER, resuelto en tiempo de compilación.
+// Cada campo es X(clave, nombre, tipo):
+//   clave  -> clave entera del mapa CBOR (< 24 para que ocupe un solo byte)
+//   nombre -> miembro del struct y clave del objeto JSON
+//   tipo   -> U32, F32, BOOL, STR, F32_ARR
+// Una misma clave significa siempre el mismo campo en todos los mensajes.
+// Añadir un mensaje: lista de campos + entrada en TLM_MSG_LIST_AQ.
+
+typedef struct {
+    const float *v;
+    uint16_t n;
+} tlm_f32_arr_aq_t;
+
+#define TLM_CTYPE_U32     uint32_t
+#define TLM_CTYPE_F32     float
+#define TLM_CTYPE_BOOL    bool
+#define TLM_CTYPE_STR     const char *
+#define TLM_CTYPE_F32_ARR tlm_f32_arr_aq_t
+
+// Sobre común del contrato: { "id", "api_version", "fw_version", ... }
+#define TLM_ENVELOPE_FIELDS_AQ(X) \
+    X(1, id, STR)                 \
+    X(2, api_version, STR)        \
+    X(3, fw_version, STR)
+
+#define TLM_HEARTBEAT_FIELDS_AQ(X) \
+    TLM_ENVELOPE_FIELDS_AQ(X)      \
+    X(4, seq, U32)                 \
+    X(5, up_s, U32)                \
+    X(6, heap, U32)                \
+    X(7, min_heap, U32)
+
+// Ráfaga de lecturas de un sensor
+#define TLM_SENSOR_FIELDS_AQ(X) \
+    TLM_ENVELOPE_FIELDS_AQ(X)   \
+    X(4, seq, U32)              \
+    X(8, ts_ms, U32)            \
+    X(9, sensor, STR)           \
+    X(10, unit, STR)            \
+    X(11, values, F32_ARR)
+
+// Orden del MASTER al panel
+#define TLM_COMMAND_FIELDS_AQ(X) \
+    TLM_ENVELOPE_FIELDS_AQ(X)    \
+    X(12, req, U32)              \
+    X(13, cmd, STR)              \
+    X(14, target, STR)           \
+    X(15, value, F32)
+
+// Respuesta del panel a un COMMAND (req = req del comando)
+#define TLM_ACK_FIELDS_AQ(X)  \
+    TLM_ENVELOPE_FIELDS_AQ(X) \
+    X(12, req, U32)           \
+    X(16, ok, BOOL)           \
+    X(17, err, STR)
+
+// M(TIPO, valor, nombre JSON, campos, miembro de la unión)
+#define TLM_MSG_LIST_AQ(M)                                              \
+    M(HEARTBEAT, 1, "heartbeat", TLM_HEARTBEAT_FIELDS_AQ, heartbeat)    \
+    M(SENSOR,    2, "sensor",    TLM_SENSOR_FIELDS_AQ,    sensor)       \
+    M(COMMAND,   3, "command",   TLM_COMMAND_FIELDS_AQ,   command)      \
+    M(ACK,       4, "ack",       TLM_ACK_FIELDS_AQ,       ack)
+
+#define TLM_FIELD_MEMBER_AQ(key, name, type) TLM_CTYPE_##type name;
+
+typedef struct { TLM_HEARTBEAT_FIELDS_AQ(TLM_FIELD_MEMBER_AQ) } tlm_heartbeat_aq_t;
+typedef struct { TLM_SENSOR_FIELDS_AQ(TLM_FIELD_MEMBER_AQ) } tlm_sensor_aq_t;
+typedef struct { TLM_COMMAND_FIELDS_AQ(TLM_FIELD_MEMBER_AQ) } tlm_command_aq_t;
+typedef struct { TLM_ACK_FIELDS_AQ(TLM_FIELD_MEMBER_AQ) } tlm_ack_aq_t;
+
+#define TLM_MSG_ENUM_AQ(T, v, n, f, m) TLM_MSG_##T##_AQ = v,
+typedef enum {
+    TLM_MSG_NONE_AQ = 0,
+    TLM_MSG_LIST_AQ(TLM_MSG_ENUM_AQ)
+    TLM_MSG_COUNT_AQ
+} tlm_msg_type_aq_t;
+
+typedef struct {
+    tlm_msg_type_aq_t type;
+    union {
+        tlm_heartbeat_aq_t heartbeat;
+        tlm_sensor_aq_t sensor;
+        tlm_command_aq_t command;
+        tlm_ack_aq_t ack;
+    };
+} tlm_msg_aq_t;
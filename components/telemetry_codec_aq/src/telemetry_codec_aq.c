@@ -0,0 +1,142 @@
+#include "telemetry_codec_aq.h"
+#include <string.h>
+#include "sdkconfig.h"
+#include "tlm_schema_aq.h"
+
+// ---- Tablas del esquema ----
+
+#define TLM_DESC_AQ(k, n, t) {k, TLM_T_##t, (uint16_t)offsetof(TLM_CUR_T, n), #n},
+#define TLM_KEY_CHECK_AQ(k, n, t) _Static_assert((k) > 0 && (k) < 24, "schema key " #n " must be 1..23");
+
+#define TLM_CUR_T tlm_heartbeat_aq_t
+static const tlm_field_desc_aq_t s_heartbeat_fields[] = {TLM_HEARTBEAT_FIELDS_AQ(TLM_DESC_AQ)};
+#undef TLM_CUR_T
+#define TLM_CUR_T tlm_sensor_aq_t
+static const tlm_field_desc_aq_t s_sensor_fields[] = {TLM_SENSOR_FIELDS_AQ(TLM_DESC_AQ)};
+#undef TLM_CUR_T
+#define TLM_CUR_T tlm_command_aq_t
+static const tlm_field_desc_aq_t s_command_fields[] = {TLM_COMMAND_FIELDS_AQ(TLM_DESC_AQ)};
+#undef TLM_CUR_T
+#define TLM_CUR_T tlm_ack_aq_t
+static const tlm_field_desc_aq_t s_ack_fields[] = {TLM_ACK_FIELDS_AQ(TLM_DESC_AQ)};
+#undef TLM_CUR_T
+
+// Claves de un solo byte en CBOR (1..23); el 0 es el tipo de mensaje
+TLM_HEARTBEAT_FIELDS_AQ(TLM_KEY_CHECK_AQ)
+TLM_SENSOR_FIELDS_AQ(TLM_KEY_CHECK_AQ)
+TLM_COMMAND_FIELDS_AQ(TLM_KEY_CHECK_AQ)
+TLM_ACK_FIELDS_AQ(TLM_KEY_CHECK_AQ)
+
+#define TLM_SCHEMA_AQ(T, v, n, f, m) \
+    [v] = {n, s_##m##_fields, (uint8_t)(sizeof(s_##m##_fields) / sizeof(s_##m##_fields[0]))},
+static const tlm_schema_desc_aq_t s_schemas[TLM_MSG_COUNT_AQ] = {TLM_MSG_LIST_AQ(TLM_SCHEMA_AQ)};
+
+const tlm_schema_desc_aq_t *tlm_schema_get_aq(tlm_msg_type_aq_t type) {
+    if (type <= TLM_MSG_NONE_AQ || type >= TLM_MSG_COUNT_AQ || s_schemas[type].fields == NULL) {
+        return NULL;
+    }
+    return &s_schemas[type];
+}
+
+tlm_msg_type_aq_t tlm_schema_by_name_aq(const char *name, size_t len) {
+    for (int t = 1; t < TLM_MSG_COUNT_AQ; t++) {
+        const char *n = s_schemas[t].name;
+        if (n && strlen(n) == len && memcmp(n, name, len) == 0) return (tlm_msg_type_aq_t)t;
+    }
+    return TLM_MSG_NONE_AQ;
+}
+
+const char *tlm_msg_name_aq(tlm_msg_type_aq_t type) {
+    const tlm_schema_desc_aq_t *s = tlm_schema_get_aq(type);
+    return s ? s->name : "?";
+}
+
+// ---- Arena ----
+
+void tlm_arena_init_aq(tlm_arena_aq_t *a, void *buf, size_t cap) {
+    a->base = buf;
+    a->cap = cap;
+    a->used = 0;
+    a->peak = 0;
+}
+
+void *tlm_arena_alloc_aq(tlm_arena_aq_t *a, size_t size, size_t align) {
+    size_t off = (a->used + align - 1) & ~(align - 1);
+    if (off + size > a->cap) return NULL;
+    a->used = off + size;
+    if (a->used > a->peak) a->peak = a->used;
+    return a->base + off;
+}
+
+// ---- Codificación / decodificación ----
+
+esp_err_t tlm_encode_aq(tlm_format_aq_t fmt, const tlm_msg_aq_t *msg, uint8_t *out, size_t cap,
+                        size_t *out_len) {
+    const tlm_schema_desc_aq_t *s = tlm_schema_get_aq(msg->type);
+    if (s == NULL || out == NULL || out_len == NULL) return ESP_ERR_INVALID_ARG;
+    // La unión empieza en el mismo sitio para todos los mensajes
+    const void *body = &msg->heartbeat;
+    return fmt == TLM_FMT_CBOR_AQ ? tlm_cbor_encode_aq(s, msg->type, body, out, cap, out_len)
+                                  : tlm_json_encode_aq(s, body, out, cap, out_len);
+}
+
+esp_err_t tlm_decode_aq(tlm_format_aq_t fmt, const uint8_t *in, size_t len, tlm_arena_aq_t *arena,
+                        tlm_msg_aq_t *msg) {
+    if (in == NULL || arena == NULL || msg == NULL) return ESP_ERR_INVALID_ARG;
+    memset(msg, 0, sizeof(*msg));
+    return fmt == TLM_FMT_CBOR_AQ ? tlm_cbor_decode_aq(in, len, arena, msg)
+                                  : tlm_json_decode_aq(in, len, arena, msg);
+}
+
+esp_err_t tlm_detect_format_aq(const uint8_t *in, size_t len, tlm_format_aq_t *fmt) {
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = in[i];
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') continue;
+        if (c == '{') {
+            *fmt = TLM_FMT_JSON_AQ;
+            return ESP_OK;
+        }
+        if ((c >> 5) == 5) {  // tipo mayor 5: mapa
+            *fmt = TLM_FMT_CBOR_AQ;
+            return ESP_OK;
+        }
+        break;
+    }
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+// ---- Negociación ----
+
+#if CONFIG_AQ_TLM_DEFAULT_JSON
+static tlm_format_aq_t s_format = TLM_FMT_JSON_AQ;
+#else
+static tlm_format_aq_t s_format = TLM_FMT_CBOR_AQ;
+#endif
+
+const char *tlm_format_name_aq(tlm_format_aq_t fmt) {
+    return fmt == TLM_FMT_CBOR_AQ ? "cbor" : "json";
+}
+
+esp_err_t tlm_negotiate_aq(const char *offer) {
+    if (offer == NULL) return ESP_ERR_INVALID_ARG;
+    const char *p = offer;
+    while (*p) {
+        while (*p == ' ' || *p == ',') p++;
+        const char *tok = p;
+        while (*p && *p != ',' && *p != ' ') p++;
+        size_t n = (size_t)(p - tok);
+        if (n == 4 && memcmp(tok, "cbor", 4) == 0) {
+            s_format = TLM_FMT_CBOR_AQ;
+            return ESP_OK;
+        }
+        if (n == 4 && memcmp(tok, "json", 4) == 0) {
+            s_format = TLM_FMT_JSON_AQ;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+tlm_format_aq_t tlm_get_format_aq(void) {
+    return s_format;
+}
@@ -0,0 +1,320 @@
+#include <string.h>
+#include "tlm_schema_aq.h"
+
+// Subconjunto de CBOR (RFC 8949) que necesita el esquema: enteros sin signo, cadenas
+// de texto, float32, bool, arrays y mapas de longitud definida. Al decodificar se
+// aceptan además half/double y enteros en campos F32, y se saltan claves desconocidas.
+
+#define CBOR_UINT   0
+#define CBOR_NINT   1
+#define CBOR_BYTES  2
+#define CBOR_TEXT   3
+#define CBOR_ARRAY  4
+#define CBOR_MAP    5
+#define CBOR_TAG    6
+#define CBOR_SIMPLE 7
+
+#define CBOR_FALSE  0xf4
+#define CBOR_TRUE   0xf5
+#define CBOR_F16    0xf9
+#define CBOR_F32    0xfa
+#define CBOR_F64    0xfb
+
+typedef struct {
+    uint8_t *p;
+    uint8_t *end;
+    bool overflow;
+} cbor_w_t;
+
+static void put_head(cbor_w_t *w, uint8_t major, uint32_t v) {
+    uint8_t hdr[5];
+    size_t n;
+    if (v < 24) {
+        hdr[0] = (major << 5) | v;
+        n = 1;
+    } else if (v <= 0xff) {
+        hdr[0] = (major << 5) | 24;
+        hdr[1] = v;
+        n = 2;
+    } else if (v <= 0xffff) {
+        hdr[0] = (major << 5) | 25;
+        hdr[1] = v >> 8;
+        hdr[2] = v;
+        n = 3;
+    } else {
+        hdr[0] = (major << 5) | 26;
+        hdr[1] = v >> 24;
+        hdr[2] = v >> 16;
+        hdr[3] = v >> 8;
+        hdr[4] = v;
+        n = 5;
+    }
+    if (w->end - w->p < (ptrdiff_t)n) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->p, hdr, n);
+    w->p += n;
+}
+
+static void put_f32(cbor_w_t *w, float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    if (w->end - w->p < 5) {
+        w->overflow = true;
+        return;
+    }
+    w->p[0] = CBOR_F32;
+    w->p[1] = u >> 24;
+    w->p[2] = u >> 16;
+    w->p[3] = u >> 8;
+    w->p[4] = u;
+    w->p += 5;
+}
+
+static void put_text(cbor_w_t *w, const char *s) {
+    size_t n = strlen(s);
+    put_head(w, CBOR_TEXT, (uint32_t)n);
+    if (w->overflow || (size_t)(w->end - w->p) < n) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->p, s, n);
+    w->p += n;
+}
+
+static bool field_present(const tlm_field_desc_aq_t *f, const uint8_t *body) {
+    if (f->type == TLM_T_STR) return *(const char *const *)(body + f->offset) != NULL;
+    if (f->type == TLM_T_F32_ARR) return ((const tlm_f32_arr_aq_t *)(body + f->offset))->n != 0;
+    return true;
+}
+
+esp_err_t tlm_cbor_encode_aq(const tlm_schema_desc_aq_t *s, tlm_msg_type_aq_t type, const void *body,
+                             uint8_t *out, size_t cap, size_t *out_len) {
+    const uint8_t *b = body;
+    cbor_w_t w = {.p = out, .end = out + cap};
+    uint32_t n = 1;
+    for (int i = 0; i < s->count; i++) {
+        n += field_present(&s->fields[i], b);
+    }
+    put_head(&w, CBOR_MAP, n);
+    put_head(&w, CBOR_UINT, TLM_KEY_TYPE_AQ);
+    put_head(&w, CBOR_UINT, type);
+
+    for (int i = 0; i < s->count; i++) {
+        const tlm_field_desc_aq_t *f = &s->fields[i];
+        if (!field_present(f, b)) continue;
+        const uint8_t *v = b + f->offset;
+        put_head(&w, CBOR_UINT, f->key);
+        switch (f->type) {
+        case TLM_T_U32:
+            put_head(&w, CBOR_UINT, *(const uint32_t *)v);
+            break;
+        case TLM_T_F32:
+            put_f32(&w, *(const float *)v);
+            break;
+        case TLM_T_BOOL:
+            put_head(&w, CBOR_SIMPLE, *(const bool *)v ? 21 : 20);
+            break;
+        case TLM_T_STR:
+            put_text(&w, *(const char *const *)v);
+            break;
+        case TLM_T_F32_ARR: {
+            const tlm_f32_arr_aq_t *a = (const tlm_f32_arr_aq_t *)v;
+            put_head(&w, CBOR_ARRAY, a->n);
+            for (uint16_t k = 0; k < a->n && !w.overflow; k++) put_f32(&w, a->v[k]);
+            break;
+        }
+        }
+        if (w.overflow) break;
+    }
+    if (w.overflow) return ESP_ERR_INVALID_SIZE;
+    *out_len = (size_t)(w.p - out);
+    return ESP_OK;
+}
+
+// ---- Lectura ----
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} cbor_r_t;
+
+// Cabecera de un item: tipo mayor, info adicional y argumento. false si está truncado
+// o usa longitud indefinida (no la emitimos y no la aceptamos).
+static bool get_head(cbor_r_t *r, uint8_t *major, uint8_t *info, uint64_t *arg) {
+    if (r->p >= r->end) return false;
+    uint8_t b = *r->p++;
+    *major = b >> 5;
+    *info = b & 0x1f;
+    if (*info < 24) {
+        *arg = *info;
+        return true;
+    }
+    if (*info > 27) return false;
+    size_t n = (size_t)1 << (*info - 24);
+    if ((size_t)(r->end - r->p) < n) return false;
+    uint64_t v = 0;
+    for (size_t i = 0; i < n; i++) v = (v << 8) | *r->p++;
+    *arg = v;
+    return true;
+}
+
+static float half_to_float(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    int exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    float f;
+    if (exp == 0) {
+        f = (float)mant / (1 << 24);  // subnormal
+    } else if (exp == 31) {
+        uint32_t u = 0x7f800000 | (mant << 13);
+        memcpy(&f, &u, sizeof(f));
+    } else {
+        uint32_t u = ((uint32_t)(exp + 112) << 23) | (mant << 13);
+        memcpy(&f, &u, sizeof(f));
+    }
+    if (sign) f = -f;
+    return f;
+}
+
+// Número (entero o flotante) como float
+static bool get_number(cbor_r_t *r, float *out) {
+    uint8_t major, info;
+    uint64_t arg;
+    if (!get_head(r, &major, &info, &arg)) return false;
+    if (major == CBOR_UINT) {
+        *out = (float)arg;
+    } else if (major == CBOR_NINT) {
+        *out = -1.0f - (float)arg;
+    } else if (major == CBOR_SIMPLE && info == 25) {
+        *out = half_to_float((uint16_t)arg);
+    } else if (major == CBOR_SIMPLE && info == 26) {
+        uint32_t u = (uint32_t)arg;
+        memcpy(out, &u, sizeof(*out));
+    } else if (major == CBOR_SIMPLE && info == 27) {
+        double d;
+        memcpy(&d, &arg, sizeof(d));
+        *out = (float)d;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool skip_item(cbor_r_t *r, int depth) {
+    uint8_t major, info;
+    uint64_t arg;
+    if (depth > TLM_MAX_DEPTH_AQ || !get_head(r, &major, &info, &arg)) return false;
+    switch (major) {
+    case CBOR_BYTES:
+    case CBOR_TEXT:
+        if ((uint64_t)(r->end - r->p) < arg) return false;
+        r->p += arg;
+        return true;
+    case CBOR_ARRAY:
+    case CBOR_MAP: {
+        uint64_t items = major == CBOR_MAP ? arg * 2 : arg;
+        for (uint64_t i = 0; i < items; i++) {
+            if (!skip_item(r, depth + 1)) return false;
+        }
+        return true;
+    }
+    case CBOR_TAG:
+        return skip_item(r, depth + 1);
+    default:
+        return true;
+    }
+}
+
+static const tlm_field_desc_aq_t *find_key(const tlm_schema_desc_aq_t *s, uint64_t key) {
+    for (int i = 0; i < s->count; i++) {
+        if (s->fields[i].key == key) return &s->fields[i];
+    }
+    return NULL;
+}
+
+static bool read_field(cbor_r_t *r, const tlm_field_desc_aq_t *f, uint8_t *v, tlm_arena_aq_t *arena) {
+    uint8_t major, info;
+    uint64_t arg;
+    switch (f->type) {
+    case TLM_T_U32:
+        if (!get_head(r, &major, &info, &arg) || major != CBOR_UINT || arg > UINT32_MAX) return false;
+        *(uint32_t *)v = (uint32_t)arg;
+        return true;
+    case TLM_T_F32:
+        return get_number(r, (float *)v);
+    case TLM_T_BOOL:
+        if (!get_head(r, &major, &info, &arg) || major != CBOR_SIMPLE || (arg != 20 && arg != 21)) {
+            return false;
+        }
+        *(bool *)v = arg == 21;
+        return true;
+    case TLM_T_STR: {
+        if (!get_head(r, &major, &info, &arg) || major != CBOR_TEXT) return false;
+        if ((uint64_t)(r->end - r->p) < arg) return false;
+        char *s = tlm_arena_alloc_aq(arena, (size_t)arg + 1, 1);
+        if (s == NULL) return false;
+        memcpy(s, r->p, (size_t)arg);
+        s[arg] = '\0';
+        r->p += arg;
+        *(const char **)v = s;
+        return true;
+    }
+    case TLM_T_F32_ARR: {
+        if (!get_head(r, &major, &info, &arg) || major != CBOR_ARRAY || arg > TLM_MAX_FLOATS_AQ) return false;
+        tlm_f32_arr_aq_t *a = (tlm_f32_arr_aq_t *)v;
+        float *vals = tlm_arena_alloc_aq(arena, (size_t)arg * sizeof(float), sizeof(float));
+        if (vals == NULL && arg) return false;
+        for (uint64_t i = 0; i < arg; i++) {
+            if (!get_number(r, &vals[i])) return false;
+        }
+        a->v = vals;
+        a->n = (uint16_t)arg;
+        return true;
+    }
+    }
+    return false;
+}
+
+esp_err_t tlm_cbor_decode_aq(const uint8_t *in, size_t len, tlm_arena_aq_t *arena, tlm_msg_aq_t *msg) {
+    cbor_r_t r = {.p = in, .end = in + len};
+    uint8_t major, info;
+    uint64_t pairs, key, type;
+    if (!get_head(&r, &major, &info, &pairs) || major != CBOR_MAP) return ESP_ERR_INVALID_ARG;
+
+    // Nuestro codificador pone el tipo primero; si no, se busca en una pasada previa
+    cbor_r_t scan = r;
+    type = TLM_MSG_NONE_AQ;
+    for (uint64_t i = 0; i < pairs; i++) {
+        if (!get_head(&scan, &major, &info, &key)) return ESP_ERR_INVALID_ARG;
+        if (major == CBOR_UINT && key == TLM_KEY_TYPE_AQ) {
+            if (!get_head(&scan, &major, &info, &type) || major != CBOR_UINT) return ESP_ERR_INVALID_ARG;
+            break;
+        }
+        if ((major == CBOR_TEXT || major == CBOR_BYTES) && (uint64_t)(scan.end - scan.p) >= key) {
+            scan.p += key;
+        } else if (major != CBOR_UINT && major != CBOR_NINT) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (!skip_item(&scan, 0)) return ESP_ERR_INVALID_ARG;
+    }
+    const tlm_schema_desc_aq_t *s = tlm_schema_get_aq((tlm_msg_type_aq_t)type);
+    if (s == NULL) return ESP_ERR_NOT_SUPPORTED;
+    msg->type = (tlm_msg_type_aq_t)type;
+    uint8_t *body = (uint8_t *)&msg->heartbeat;
+
+    for (uint64_t i = 0; i < pairs; i++) {
+        const uint8_t *key_start = r.p;
+        if (!get_head(&r, &major, &info, &key)) return ESP_ERR_INVALID_ARG;
+        const tlm_field_desc_aq_t *f = major == CBOR_UINT ? find_key(s, key) : NULL;
+        if (f) {
+            if (!read_field(&r, f, body + f->offset, arena)) return ESP_ERR_INVALID_ARG;
+            continue;
+        }
+        // Clave desconocida (o la del tipo): saltar clave y valor
+        r.p = key_start;
+        if (!skip_item(&r, 0) || !skip_item(&r, 0)) return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
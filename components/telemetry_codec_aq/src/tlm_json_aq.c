@@ -0,0 +1,432 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tlm_schema_aq.h"
+
+// JSON del contrato: { "type": "<mensaje>", "id": ..., "api_version": ..., ... }.
+// Sin árbol de nodos: se codifica directamente desde el struct y se decodifica
+// guiado por el esquema, copiando solo cadenas y arrays al arena.
+
+typedef struct {
+    char *p;
+    char *end;
+    bool overflow;
+} json_w_t;
+
+static void put_raw(json_w_t *w, const char *s, size_t n) {
+    if ((size_t)(w->end - w->p) < n) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->p, s, n);
+    w->p += n;
+}
+
+static void put_lit(json_w_t *w, const char *s) {
+    put_raw(w, s, strlen(s));
+}
+
+static void put_u32(json_w_t *w, uint32_t v) {
+    char tmp[10];
+    int n = 0;
+    do {
+        tmp[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    if (w->end - w->p < n) {
+        w->overflow = true;
+        return;
+    }
+    while (n) *w->p++ = tmp[--n];
+}
+
+static void put_f32(json_w_t *w, float f) {
+    // JSON no admite NaN/Inf
+    if (f != f || f > 3.4e38f || f < -3.4e38f) {
+        put_lit(w, "null");
+        return;
+    }
+    // Camino rápido para las magnitudes de sensores: punto fijo con 6 decimales
+    // (más que los ~7 dígitos significativos de un float en este rango)
+    float mag = f < 0 ? -f : f;
+    if (mag == 0.0f || (mag >= 1e-3f && mag < 1e7f)) {
+        int64_t scaled = (int64_t)((double)mag * 1000000.0 + 0.5);
+        uint32_t ip = (uint32_t)(scaled / 1000000);
+        uint32_t fp = (uint32_t)(scaled % 1000000);
+        if (f < 0) put_raw(w, "-", 1);
+        put_u32(w, ip);
+        if (fp) {
+            char frac[7] = {'.'};
+            int n = 6;
+            while (fp % 10 == 0) {
+                fp /= 10;
+                n--;
+            }
+            for (int i = n; i > 0; i--) {
+                frac[i] = '0' + fp % 10;
+                fp /= 10;
+            }
+            put_raw(w, frac, (size_t)n + 1);
+        }
+        return;
+    }
+    char tmp[24];
+    int n = snprintf(tmp, sizeof(tmp), "%.9g", (double)f);
+    put_raw(w, tmp, (size_t)n);
+}
+
+static void put_str(json_w_t *w, const char *s) {
+    static const char hex[] = "0123456789abcdef";
+    put_raw(w, "\"", 1);
+    const char *run = s;
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        put_raw(w, run, (size_t)(s - run));
+        run = s + 1;
+        switch (c) {
+        case '"': put_raw(w, "\\\"", 2); break;
+        case '\\': put_raw(w, "\\\\", 2); break;
+        case '\n': put_raw(w, "\\n", 2); break;
+        case '\r': put_raw(w, "\\r", 2); break;
+        case '\t': put_raw(w, "\\t", 2); break;
+        default: {
+            char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+            put_raw(w, esc, sizeof(esc));
+        }
+        }
+    }
+    put_raw(w, run, (size_t)(s - run));
+    put_raw(w, "\"", 1);
+}
+
+esp_err_t tlm_json_encode_aq(const tlm_schema_desc_aq_t *s, const void *body, uint8_t *out, size_t cap,
+                             size_t *out_len) {
+    const uint8_t *b = body;
+    json_w_t w = {.p = (char *)out, .end = (char *)out + cap};
+    put_lit(&w, "{\"type\":\"");
+    put_lit(&w, s->name);
+    put_lit(&w, "\"");
+    for (int i = 0; i < s->count && !w.overflow; i++) {
+        const tlm_field_desc_aq_t *f = &s->fields[i];
+        const uint8_t *v = b + f->offset;
+        if (f->type == TLM_T_STR && *(const char *const *)v == NULL) continue;
+        if (f->type == TLM_T_F32_ARR && ((const tlm_f32_arr_aq_t *)v)->n == 0) continue;
+        put_lit(&w, ",\"");
+        put_lit(&w, f->name);
+        put_lit(&w, "\":");
+        switch (f->type) {
+        case TLM_T_U32:
+            put_u32(&w, *(const uint32_t *)v);
+            break;
+        case TLM_T_F32:
+            put_f32(&w, *(const float *)v);
+            break;
+        case TLM_T_BOOL:
+            put_lit(&w, *(const bool *)v ? "true" : "false");
+            break;
+        case TLM_T_STR:
+            put_str(&w, *(const char *const *)v);
+            break;
+        case TLM_T_F32_ARR: {
+            const tlm_f32_arr_aq_t *a = (const tlm_f32_arr_aq_t *)v;
+            put_raw(&w, "[", 1);
+            for (uint16_t k = 0; k < a->n && !w.overflow; k++) {
+                if (k) put_raw(&w, ",", 1);
+                put_f32(&w, a->v[k]);
+            }
+            put_raw(&w, "]", 1);
+            break;
+        }
+        }
+    }
+    put_raw(&w, "}", 1);
+    if (w.overflow) return ESP_ERR_INVALID_SIZE;
+    *out_len = (size_t)(w.p - (char *)out);
+    return ESP_OK;
+}
+
+// ---- Lectura ----
+
+typedef struct {
+    const char *p;
+    const char *end;
+} json_r_t;
+
+static void skip_ws(json_r_t *r) {
+    while (r->p < r->end && (*r->p == ' ' || *r->p == '\t' || *r->p == '\n' || *r->p == '\r')) r->p++;
+}
+
+static bool expect(json_r_t *r, char c) {
+    skip_ws(r);
+    if (r->p >= r->end || *r->p != c) return false;
+    r->p++;
+    return true;
+}
+
+// Cadena sin copiar: [*s, *s + *n) con los escapes todavía sin resolver
+static bool scan_str(json_r_t *r, const char **s, size_t *n) {
+    if (!expect(r, '"')) return false;
+    const char *start = r->p;
+    while (r->p < r->end && *r->p != '"') {
+        if (*r->p == '\\') r->p++;
+        r->p++;
+    }
+    if (r->p >= r->end) return false;
+    *s = start;
+    *n = (size_t)(r->p - start);
+    r->p++;
+    return true;
+}
+
+static int hex_val(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Copia al arena resolviendo escapes (\uXXXX del BMP a UTF-8)
+static const char *unescape(tlm_arena_aq_t *arena, const char *s, size_t n) {
+    char *out = tlm_arena_alloc_aq(arena, n + 1, 1);  // el resultado nunca es más largo
+    if (out == NULL) return NULL;
+    char *o = out;
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] != '\\') {
+            *o++ = s[i];
+            continue;
+        }
+        if (++i >= n) return NULL;
+        switch (s[i]) {
+        case 'n': *o++ = '\n'; break;
+        case 'r': *o++ = '\r'; break;
+        case 't': *o++ = '\t'; break;
+        case 'b': *o++ = '\b'; break;
+        case 'f': *o++ = '\f'; break;
+        case 'u': {
+            if (i + 4 >= n) return NULL;
+            int cp = 0;
+            for (int k = 1; k <= 4; k++) {
+                int h = hex_val(s[i + k]);
+                if (h < 0) return NULL;
+                cp = (cp << 4) | h;
+            }
+            i += 4;
+            if (cp < 0x80) {
+                *o++ = (char)cp;
+            } else if (cp < 0x800) {
+                *o++ = (char)(0xc0 | (cp >> 6));
+                *o++ = (char)(0x80 | (cp & 0x3f));
+            } else {
+                *o++ = (char)(0xe0 | (cp >> 12));
+                *o++ = (char)(0x80 | ((cp >> 6) & 0x3f));
+                *o++ = (char)(0x80 | (cp & 0x3f));
+            }
+            break;
+        }
+        default: *o++ = s[i]; break;  // \" \\ \/
+        }
+    }
+    *o = '\0';
+    return out;
+}
+
+// Decimal corto (el caso normal) sin strtof: mantisa entera y potencia de 10 exacta
+static bool fast_number(const char *t, size_t n, float *out) {
+    static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+                                   1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+    size_t i = 0;
+    bool neg = false;
+    if (t[i] == '-') {
+        neg = true;
+        i++;
+    }
+    uint64_t mant = 0;
+    int digits = 0, frac = 0;
+    bool dot = false;
+    for (; i < n; i++) {
+        if (t[i] == '.' && !dot) {
+            dot = true;
+            continue;
+        }
+        if (t[i] < '0' || t[i] > '9' || ++digits > 15) return false;  // exponente o demasiados dígitos
+        mant = mant * 10 + (uint64_t)(t[i] - '0');
+        frac += dot;
+    }
+    if (digits == 0) return false;
+    double d = (double)mant / pow10[frac];
+    *out = (float)(neg ? -d : d);
+    return true;
+}
+
+static bool scan_number(json_r_t *r, float *out) {
+    skip_ws(r);
+    char tmp[32];
+    size_t n = 0;
+    while (r->p < r->end && n < sizeof(tmp) - 1 && strchr("+-0123456789.eE", *r->p)) {
+        tmp[n++] = *r->p++;
+    }
+    if (n == 0) {
+        // null (NaN/Inf al codificar)
+        if (r->end - r->p >= 4 && memcmp(r->p, "null", 4) == 0) {
+            r->p += 4;
+            *out = 0.0f;
+            return true;
+        }
+        return false;
+    }
+    if (fast_number(tmp, n, out)) return true;
+    tmp[n] = '\0';
+    char *endp;
+    *out = strtof(tmp, &endp);
+    return *endp == '\0';
+}
+
+static bool skip_value(json_r_t *r, int depth) {
+    skip_ws(r);
+    if (r->p >= r->end || depth > TLM_MAX_DEPTH_AQ) return false;
+    char c = *r->p;
+    if (c == '"') {
+        const char *s;
+        size_t n;
+        return scan_str(r, &s, &n);
+    }
+    if (c == '{' || c == '[') {
+        char close = c == '{' ? '}' : ']';
+        r->p++;
+        if (expect(r, close)) return true;
+        do {
+            if (c == '{') {
+                const char *s;
+                size_t n;
+                if (!scan_str(r, &s, &n) || !expect(r, ':')) return false;
+            }
+            if (!skip_value(r, depth + 1)) return false;
+        } while (expect(r, ','));
+        return expect(r, close);
+    }
+    // número, true, false, null
+    while (r->p < r->end && *r->p != ',' && *r->p != '}' && *r->p != ']' && *r->p != ' ' &&
+           *r->p != '\n' && *r->p != '\r' && *r->p != '\t') {
+        r->p++;
+    }
+    return true;
+}
+
+static bool read_field(json_r_t *r, const tlm_field_desc_aq_t *f, uint8_t *v, tlm_arena_aq_t *arena) {
+    skip_ws(r);
+    switch (f->type) {
+    case TLM_T_U32: {
+        float tmp;
+        json_r_t save = *r;
+        // Entero exacto hasta 2^32-1 (float perdería precisión)
+        uint64_t acc = 0;
+        size_t digits = 0;
+        while (r->p < r->end && *r->p >= '0' && *r->p <= '9' && digits < 10) {
+            acc = acc * 10 + (uint64_t)(*r->p++ - '0');
+            digits++;
+        }
+        if (digits && acc <= UINT32_MAX && (r->p >= r->end || !strchr(".eE0123456789", *r->p))) {
+            *(uint32_t *)v = (uint32_t)acc;
+            return true;
+        }
+        *r = save;
+        if (!scan_number(r, &tmp) || tmp < 0) return false;
+        *(uint32_t *)v = (uint32_t)tmp;
+        return true;
+    }
+    case TLM_T_F32:
+        return scan_number(r, (float *)v);
+    case TLM_T_BOOL:
+        if (r->end - r->p >= 4 && memcmp(r->p, "true", 4) == 0) {
+            r->p += 4;
+            *(bool *)v = true;
+            return true;
+        }
+        if (r->end - r->p >= 5 && memcmp(r->p, "false", 5) == 0) {
+            r->p += 5;
+            *(bool *)v = false;
+            return true;
+        }
+        return false;
+    case TLM_T_STR: {
+        const char *s;
+        size_t n;
+        if (!scan_str(r, &s, &n)) return false;
+        const char *copy = unescape(arena, s, n);
+        if (copy == NULL) return false;
+        *(const char **)v = copy;
+        return true;
+    }
+    case TLM_T_F32_ARR: {
+        // Contar primero para reservar el array de una vez en el arena
+        json_r_t count = *r;
+        if (!expect(&count, '[')) return false;
+        size_t n = 0;
+        if (!expect(&count, ']')) {
+            do {
+                if (!skip_value(&count, 0) || ++n > TLM_MAX_FLOATS_AQ) return false;
+            } while (expect(&count, ','));
+            if (!expect(&count, ']')) return false;
+        }
+        float *vals = n ? tlm_arena_alloc_aq(arena, n * sizeof(float), sizeof(float)) : NULL;
+        if (n && vals == NULL) return false;
+        expect(r, '[');
+        for (size_t i = 0; i < n; i++) {
+            if (!scan_number(r, &vals[i])) return false;
+            expect(r, ',');
+        }
+        expect(r, ']');
+        tlm_f32_arr_aq_t *a = (tlm_f32_arr_aq_t *)v;
+        a->v = vals;
+        a->n = (uint16_t)n;
+        return true;
+    }
+    }
+    return false;
+}
+
+static const tlm_field_desc_aq_t *find_name(const tlm_schema_desc_aq_t *s, const char *name, size_t n) {
+    for (int i = 0; i < s->count; i++) {
+        if (strlen(s->fields[i].name) == n && memcmp(s->fields[i].name, name, n) == 0) return &s->fields[i];
+    }
+    return NULL;
+}
+
+esp_err_t tlm_json_decode_aq(const uint8_t *in, size_t len, tlm_arena_aq_t *arena, tlm_msg_aq_t *msg) {
+    json_r_t r = {.p = (const char *)in, .end = (const char *)in + len};
+    const char *key;
+    size_t key_len;
+    if (!expect(&r, '{')) return ESP_ERR_INVALID_ARG;
+
+    // Primera pasada: localizar "type" para saber qué esquema aplicar
+    json_r_t scan = r;
+    tlm_msg_type_aq_t type = TLM_MSG_NONE_AQ;
+    if (!expect(&scan, '}')) {
+        do {
+            if (!scan_str(&scan, &key, &key_len) || !expect(&scan, ':')) return ESP_ERR_INVALID_ARG;
+            if (key_len == 4 && memcmp(key, "type", 4) == 0) {
+                const char *name;
+                size_t name_len;
+                if (!scan_str(&scan, &name, &name_len)) return ESP_ERR_INVALID_ARG;
+                type = tlm_schema_by_name_aq(name, name_len);
+                break;
+            }
+            if (!skip_value(&scan, 0)) return ESP_ERR_INVALID_ARG;
+        } while (expect(&scan, ','));
+    }
+    const tlm_schema_desc_aq_t *s = tlm_schema_get_aq(type);
+    if (s == NULL) return ESP_ERR_NOT_SUPPORTED;
+    msg->type = type;
+    uint8_t *body = (uint8_t *)&msg->heartbeat;
+
+    if (expect(&r, '}')) return ESP_OK;
+    do {
+        if (!scan_str(&r, &key, &key_len) || !expect(&r, ':')) return ESP_ERR_INVALID_ARG;
+        const tlm_field_desc_aq_t *f = find_name(s, key, key_len);
+        if (f ? !read_field(&r, f, body + f->offset, arena) : !skip_value(&r, 0)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    } while (expect(&r, ','));
+    return expect(&r, '}') ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "telemetry_codec_aq.h"
+
+// Tablas de descriptores generadas desde telemetry_schema_aq.h (solo lectura, en flash)
+
+typedef enum {
+    TLM_T_U32,
+    TLM_T_F32,
+    TLM_T_BOOL,
+    TLM_T_STR,
+    TLM_T_F32_ARR,
+} tlm_field_type_aq_t;
+
+typedef struct {
+    uint8_t key;
+    uint8_t type;       // tlm_field_type_aq_t
+    uint16_t offset;    // dentro de la unión de tlm_msg_aq_t
+    const char *name;
+} tlm_field_desc_aq_t;
+
+typedef struct {
+    const char *name;
+    const tlm_field_desc_aq_t *fields;
+    uint8_t count;
+} tlm_schema_desc_aq_t;
+
+#define TLM_KEY_TYPE_AQ   0    // clave CBOR del tipo de mensaje
+#define TLM_MAX_DEPTH_AQ  8    // anidamiento máximo al saltar valores desconocidos
+#define TLM_MAX_FLOATS_AQ 256  // límite de F32_ARR al decodificar
+
+const tlm_schema_desc_aq_t *tlm_schema_get_aq(tlm_msg_type_aq_t type);
+tlm_msg_type_aq_t           tlm_schema_by_name_aq(const char *name, size_t len);
+
+esp_err_t tlm_cbor_encode_aq(const tlm_schema_desc_aq_t *s, tlm_msg_type_aq_t type, const void *body,
+                             uint8_t *out, size_t cap, size_t *out_len);
+esp_err_t tlm_cbor_decode_aq(const uint8_t *in, size_t len, tlm_arena_aq_t *arena, tlm_msg_aq_t *msg);
+esp_err_t tlm_json_encode_aq(const tlm_schema_desc_aq_t *s, const void *body, uint8_t *out, size_t cap,
+                             size_t *out_len);
+esp_err_t tlm_json_decode_aq(const uint8_t *in, size_t len, tlm_arena_aq_t *arena, tlm_msg_aq_t *msg);
@@ -0,0 +1,431 @@
+// Benchmark de host (Linux) de timesync_aq.
+//
+// Compila timesync_core_aq.c real contra un bus USB simulado en tiempo discreto (ns):
+//   bus:    el host emite un SOF por milisegundo de su reloj (con su propio error de
+//           frecuencia) y número de trama de 11 bits;
+//   panel:  cada uno con su cristal (ppm distintos), arranque a destiempo y esp_timer en
+//           µs. El SOF le llega con la latencia ISR -> tarea usb_device: base, cola
+//           exponencial, picos sueltos, SOF perdidos y bloqueos de decenas de ms en los
+//           que la cola de eventos de TinyUSB se llena y los entrega de golpe;
+//   MASTER: reloj Unix con su propia deriva, intercambio UDP con retardos asimétricos,
+//           colas ocasionales, pérdidas y respuestas tan tardías que llegan tras la
+//           siguiente petición.
+// Mide en cada escenario el error del tiempo de bus frente al SOF ideal, el acuerdo entre
+// paneles, el error frente al MASTER, el tiempo de enganche y la deriva estimada.
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "timesync_core_aq.h"
+
+#define NS_MS       1000000LL
+#define NS_S        1000000000LL
+#define MAX_PANELS  8
+#define TUSB_QUEUE  16          // eventos que caben en la cola de TinyUSB durante un bloqueo
+#define SAMPLE_NS   (10 * NS_MS)
+#define MASTER_T0   1760000000000000000LL
+
+typedef struct {
+    const char *name;
+    double   sof_base_us;       // latencia mínima ISR -> tarea
+    double   sof_exp_us;        // media de la cola exponencial
+    double   spike_p;           // probabilidad de pico por SOF
+    double   spike_us;          // pico máximo (uniforme)
+    double   miss_p;            // SOF perdido
+    double   block_per_s;       // bloqueos de la tarea usb_device por segundo
+    double   block_ms;          // duración máxima (uniforme desde la mitad)
+    int64_t  suspend_at_ns;     // bus sin SOF desde aquí ...
+    int64_t  suspend_ns;        // ... durante tanto (0 = nunca)
+    double   up_us, dn_us;      // retardo base del intercambio, subida y bajada
+    double   net_exp_us;
+    double   queue_p;           // probabilidad de cola de hasta queue_us en un sentido
+    double   queue_us;
+    double   lost_p;
+    double   late_p;            // respuesta retenida 200 ms
+    uint32_t sof_window;
+    bool     checked;
+} scenario_t;
+
+typedef struct {
+    double   ppm;
+    int64_t  start_ns;          // arranque (true time)
+    int64_t  local0_ns;         // esp_timer en el arranque
+    ts_core_aq_t core;
+    int64_t  blocked_until;
+    int      queued;
+    int64_t  lock_ns, sync_ns;
+} panel_t;
+
+typedef enum { EV_TICK, EV_SOF, EV_REQ, EV_RESP, EV_SAMPLE } ev_type_t;
+
+typedef struct {
+    int64_t t;
+    uint32_t seq;               // orden estable a igual t
+    ev_type_t type;
+    int panel;
+    uint32_t frame;
+    timesync_frame_aq_t f;
+} event_t;
+
+static event_t *s_heap;
+static size_t s_heap_n, s_heap_cap;
+static uint32_t s_ev_seq;
+static uint64_t s_rng = 0x9E3779B97F4A7C15ull;
+static int s_panels = 4;
+static double s_seconds = 120;
+static double s_host_ppm = 18;
+static double s_master_ppm = -7;
+static int s_failures;
+
+static const double s_panel_ppm[MAX_PANELS] = { -40, 25, 37, -12, 8, -28, 45, 0 };
+
+static double uniform(void) {
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (double)(s_rng >> 11) / (double)(1ull << 53);
+}
+
+static double expo(double mean) {
+    return -mean * log(1 - uniform());
+}
+
+static void check(bool ok, const char *scenario, const char *what) {
+    if (!ok) {
+        fprintf(stderr, "check failed: %s: %s\n", scenario, what);
+        s_failures++;
+    }
+}
+
+static void push(event_t e) {
+    if (s_heap_n == s_heap_cap) {
+        s_heap_cap = s_heap_cap ? s_heap_cap * 2 : 1024;
+        s_heap = realloc(s_heap, s_heap_cap * sizeof(event_t));
+    }
+    e.seq = s_ev_seq++;
+    size_t i = s_heap_n++;
+    while (i > 0) {
+        size_t p = (i - 1) / 2;
+        if (s_heap[p].t < e.t || (s_heap[p].t == e.t && s_heap[p].seq < e.seq)) break;
+        s_heap[i] = s_heap[p];
+        i = p;
+    }
+    s_heap[i] = e;
+}
+
+static event_t pop(void) {
+    event_t top = s_heap[0], last = s_heap[--s_heap_n];
+    size_t i = 0;
+    while (1) {
+        size_t c = 2 * i + 1;
+        if (c >= s_heap_n) break;
+        if (c + 1 < s_heap_n && (s_heap[c + 1].t < s_heap[c].t ||
+                                 (s_heap[c + 1].t == s_heap[c].t && s_heap[c + 1].seq < s_heap[c].seq))) c++;
+        if (last.t < s_heap[c].t || (last.t == s_heap[c].t && last.seq < s_heap[c].seq)) break;
+        s_heap[i] = s_heap[c];
+        i = c;
+    }
+    s_heap[i] = last;
+    return top;
+}
+
+// Relojes: t es el tiempo real de la simulación
+static int64_t sof_time(int64_t k) {
+    return (int64_t)llround(k * NS_MS * (1 + s_host_ppm * 1e-6));
+}
+
+static double ideal_bus(int64_t t, uint32_t f0) {
+    return f0 * (double)NS_MS + t / (1 + s_host_ppm * 1e-6);
+}
+
+static int64_t master_clock(int64_t t) {
+    return MASTER_T0 + t + (int64_t)llround(t * s_master_ppm * 1e-6);
+}
+
+// esp_timer: µs enteros
+static int64_t local_ns(const panel_t *p, int64_t t) {
+    int64_t ns = p->local0_ns + (t - p->start_ns) + (int64_t)llround((t - p->start_ns) * p->ppm * 1e-6);
+    return ns / 1000 * 1000;
+}
+
+static int64_t wrap_err(int64_t e) {
+    e %= TS_WRAP_NS_AQ;
+    if (e > TS_WRAP_NS_AQ / 2) e -= TS_WRAP_NS_AQ;
+    if (e < -TS_WRAP_NS_AQ / 2) e += TS_WRAP_NS_AQ;
+    return e;
+}
+
+static int cmp_i64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+typedef struct {
+    int64_t *v;
+    size_t n, cap;
+} series_t;
+
+static void series_add(series_t *s, int64_t v) {
+    if (s->n == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 4096;
+        s->v = realloc(s->v, s->cap * sizeof(int64_t));
+    }
+    s->v[s->n++] = v;
+}
+
+// Percentil de |v| en µs
+static double pct_us(series_t *s, double q) {
+    if (s->n == 0) return -1;
+    for (size_t i = 0; i < s->n; i++) s->v[i] = s->v[i] < 0 ? -s->v[i] : s->v[i];
+    qsort(s->v, s->n, sizeof(int64_t), cmp_i64);
+    size_t i = (size_t)(q * (s->n - 1));
+    return s->v[i] / 1000.0;
+}
+
+// Percentil con signo (mediana del sesgo frente al MASTER)
+static double median_signed_us(series_t *s) {
+    if (s->n == 0) return 0;
+    int64_t *tmp = malloc(s->n * sizeof(int64_t));
+    memcpy(tmp, s->v, s->n * sizeof(int64_t));
+    qsort(tmp, s->n, sizeof(int64_t), cmp_i64);
+    double m = tmp[s->n / 2] / 1000.0;
+    free(tmp);
+    return m;
+}
+
+static void sof_deliver(const scenario_t *sc, panel_t *p, int idx, int64_t t, uint32_t frame) {
+    if (t < p->start_ns) return;
+    if (uniform() < sc->miss_p) return;
+    double lat = sc->sof_base_us + expo(sc->sof_exp_us);
+    if (uniform() < sc->spike_p) lat += uniform() * sc->spike_us;
+    int64_t at = t + (int64_t)(lat * 1000);
+    if (t < p->blocked_until) {
+        // Tarea bloqueada: la cola de eventos se llena y el resto se pierde
+        if (p->queued >= TUSB_QUEUE) return;
+        at = p->blocked_until + (int64_t)(++p->queued) * 5000;
+    } else {
+        p->queued = 0;
+        if (uniform() < sc->block_per_s / 1000) {
+            p->blocked_until = t + (int64_t)((0.5 + 0.5 * uniform()) * sc->block_ms * NS_MS);
+        }
+    }
+    push((event_t){ .t = at, .type = EV_SOF, .panel = idx, .frame = frame });
+}
+
+static void exchange(const scenario_t *sc, panel_t *p, int idx, int64_t t) {
+    timesync_frame_aq_t f;
+    if (!ts_core_request_aq(&p->core, local_ns(p, t), &f)) return;
+    if (uniform() < sc->lost_p) return;
+    double up = sc->up_us + expo(sc->net_exp_us), dn = sc->dn_us + expo(sc->net_exp_us);
+    if (uniform() < sc->queue_p) up += uniform() * sc->queue_us;
+    if (uniform() < sc->queue_p) dn += uniform() * sc->queue_us;
+    int64_t t2 = t + (int64_t)(up * 1000);
+    int64_t t3 = t2 + (int64_t)((30 + 50 * uniform()) * 1000);
+    f.type = TIMESYNC_RESP_AQ;
+    f.t2_ns = master_clock(t2);
+    f.t3_ns = master_clock(t3);
+    int64_t at = t3 + (int64_t)(dn * 1000);
+    if (uniform() < sc->late_p) at += 200 * NS_MS;
+    push((event_t){ .t = at, .type = EV_RESP, .panel = idx, .f = f });
+}
+
+static void run(const scenario_t *sc) {
+    panel_t panels[MAX_PANELS];
+    int64_t end = (int64_t)(s_seconds * NS_S);
+    uint32_t f0 = (uint32_t)(uniform() * 2048);
+    series_t bus_err = {0}, pair = {0}, master_err = {0};
+    uint32_t epoch_mismatch = 0;
+    double drift_err_ppm = 0;
+
+    s_heap_n = 0;
+    for (int i = 0; i < s_panels; i++) {
+        panel_t *p = &panels[i];
+        memset(p, 0, sizeof(*p));
+        p->ppm = s_panel_ppm[i % MAX_PANELS];
+        p->start_ns = (int64_t)(uniform() * 700 * NS_MS);
+        p->local0_ns = (int64_t)(uniform() * 5 * NS_S);
+        p->lock_ns = p->sync_ns = -1;
+        ts_core_init_aq(&p->core, sc->sof_window, CONFIG_AQ_TIMESYNC_EXCHANGE_WINDOW);
+        push((event_t){ .t = p->start_ns + CONFIG_AQ_TIMESYNC_INTERVAL_MS * NS_MS, .type = EV_REQ, .panel = i });
+    }
+    push((event_t){ .t = 0, .type = EV_TICK });
+    push((event_t){ .t = SAMPLE_NS, .type = EV_SAMPLE });
+
+    int64_t k = 0;
+    while (s_heap_n) {
+        event_t e = pop();
+        if (e.t > end) break;
+        panel_t *p = &panels[e.panel];
+        switch (e.type) {
+        case EV_TICK: {
+            int64_t t = sof_time(k);
+            bool suspended = sc->suspend_ns && t >= sc->suspend_at_ns && t < sc->suspend_at_ns + sc->suspend_ns;
+            if (!suspended) {
+                for (int i = 0; i < s_panels; i++) sof_deliver(sc, &panels[i], i, t, (uint32_t)((f0 + k) & 0x7FF));
+            }
+            k++;
+            push((event_t){ .t = sof_time(k), .type = EV_TICK });
+            break;
+        }
+        case EV_SOF:
+            ts_core_sof_aq(&p->core, e.frame, local_ns(p, e.t));
+            break;
+        case EV_REQ:
+            exchange(sc, p, e.panel, e.t);
+            push((event_t){ .t = e.t + CONFIG_AQ_TIMESYNC_INTERVAL_MS * NS_MS, .type = EV_REQ, .panel = e.panel });
+            break;
+        case EV_RESP:
+            ts_core_response_aq(&p->core, (const uint8_t *)&e.f, sizeof(e.f), local_ns(p, e.t));
+            break;
+        case EV_SAMPLE: {
+            int64_t bus[MAX_PANELS], master[MAX_PANELS];
+            uint32_t all = TIMESYNC_SOF_LOCKED_AQ | TIMESYNC_MASTER_SYNC_AQ;
+            for (int i = 0; i < s_panels; i++) {
+                panel_t *q = &panels[i];
+                uint32_t fl = e.t >= q->start_ns ? ts_core_time_aq(&q->core, local_ns(q, e.t), &bus[i], &master[i]) : 0;
+                if ((fl & TIMESYNC_SOF_LOCKED_AQ) && q->lock_ns < 0) q->lock_ns = e.t - q->start_ns;
+                if ((fl & TIMESYNC_MASTER_SYNC_AQ) && q->sync_ns < 0) q->sync_ns = e.t - q->start_ns;
+                all &= fl;
+                if (fl & TIMESYNC_SOF_LOCKED_AQ) series_add(&bus_err, wrap_err(bus[i] - (int64_t)llround(ideal_bus(e.t, f0))));
+                if (fl & TIMESYNC_MASTER_SYNC_AQ) series_add(&master_err, master[i] - master_clock(e.t));
+            }
+            // Sin época los paneles solo coinciden módulo 2,048 s
+            if (all & TIMESYNC_SOF_LOCKED_AQ) {
+                for (int i = 1; i < s_panels; i++) {
+                    int64_t d = bus[i] - bus[0];
+                    if (!(all & TIMESYNC_MASTER_SYNC_AQ)) {
+                        d = wrap_err(d);
+                    } else if (d > TS_WRAP_NS_AQ / 2 || d < -TS_WRAP_NS_AQ / 2) {
+                        epoch_mismatch++;
+                    }
+                    series_add(&pair, d);
+                }
+            }
+            push((event_t){ .t = e.t + SAMPLE_NS, .type = EV_SAMPLE });
+            break;
+        }
+        }
+    }
+
+    int64_t lock_max = 0, sync_max = 0;
+    uint32_t steps = 0, outliers = 0, missed = 0, replies = 0, rejected = 0, msteps = 0;
+    bool all_locked = true;
+    for (int i = 0; i < s_panels; i++) {
+        timesync_stats_aq_t st;
+        panel_t *q = &panels[i];
+        ts_core_stats_aq(&q->core, local_ns(q, end), &st);
+        // y = x * (1 + freq): por ns real el bus avanza 1/(1+host) y el reloj local 1+ppm
+        double ratio = (1.0 / (1 + s_host_ppm * 1e-6)) / (1 + q->ppm * 1e-6);
+        double err = fabs(st.drift_ppb - (ratio - 1) * 1e9) / 1000;
+        if (err > drift_err_ppm) drift_err_ppm = err;
+        if (q->lock_ns < 0 || q->sync_ns < 0) all_locked = false;
+        if (q->lock_ns > lock_max) lock_max = q->lock_ns;
+        if (q->sync_ns > sync_max) sync_max = q->sync_ns;
+        steps += st.sof_steps;
+        outliers += st.sof_outliers;
+        missed += st.sof_missed;
+        replies += st.replies;
+        rejected += st.rejected;
+        msteps += st.master_steps;
+    }
+    double m_bias = median_signed_us(&master_err);
+    double bus_p50 = pct_us(&bus_err, 0.5), bus_p99 = pct_us(&bus_err, 0.99), bus_max = pct_us(&bus_err, 1);
+    double pair_p99 = pct_us(&pair, 0.99), pair_max = pct_us(&pair, 1);
+    for (size_t i = 0; i < master_err.n; i++) master_err.v[i] -= (int64_t)(m_bias * 1000);
+    double m_p99 = pct_us(&master_err, 0.99);
+    printf("RESULT scenario=%s panels=%d window=%u lock_ms=%lld sync_ms=%lld bus_err_p50_us=%.1f "
+           "bus_err_p99_us=%.1f bus_err_max_us=%.1f pair_p99_us=%.1f pair_max_us=%.1f epoch_mismatch=%u "
+           "master_bias_us=%.1f master_p99_us=%.1f drift_err_ppm=%.3f sof_missed=%u sof_outliers=%u "
+           "sof_steps=%u replies=%u rejected=%u master_steps=%u\n",
+           sc->name, s_panels, sc->sof_window, (long long)(lock_max / NS_MS), (long long)(sync_max / NS_MS),
+           bus_p50, bus_p99, bus_max, pair_p99, pair_max, epoch_mismatch, m_bias, m_p99, drift_err_ppm, missed,
+           outliers, steps, replies, rejected, msteps);
+
+    if (sc->checked) {
+        check(all_locked, sc->name, "every panel locks and syncs with the MASTER");
+        check(lock_max < 2 * NS_S, sc->name, "SOF lock within 2 s");
+        check(bus_p99 >= 0 && bus_p99 < 20, sc->name, "bus time p99 < 20 us");
+        check(pair_p99 >= 0 && pair_p99 < 25, sc->name, "panels agree within 25 us (p99)");
+        check(epoch_mismatch == 0, sc->name, "same epoch on every panel");
+        check(fabs(m_bias) < 200 && m_p99 < 100, sc->name, "MASTER offset bias < 200 us, spread p99 < 100 us");
+        check(drift_err_ppm < 1, sc->name, "drift estimate within 1 ppm");
+        check(msteps == 0, sc->name, "no MASTER steps");
+        check(sc->suspend_ns || steps == 0, sc->name, "no SOF phase steps");
+    }
+    free(bus_err.v);
+    free(pair.v);
+    free(master_err.v);
+}
+
+// Casos del intercambio que no dependen de la simulación
+static void protocol_checks(void) {
+    ts_core_aq_t c;
+    timesync_frame_aq_t f, r;
+    const char *n = "protocol";
+    ts_core_init_aq(&c, 1, 1);
+    check(!ts_core_request_aq(&c, 0, &f), n, "no request before the first SOF");
+    for (uint32_t i = 0; i < 4; i++) ts_core_sof_aq(&c, i, (int64_t)i * NS_MS);
+    check(ts_core_request_aq(&c, 4 * NS_MS, &f), n, "request after SOF");
+    r = f;
+    r.type = TIMESYNC_RESP_AQ;
+    r.t2_ns = MASTER_T0;
+    r.t3_ns = MASTER_T0 + 1000;
+    timesync_frame_aq_t bad = r;
+    bad.seq++;
+    check(!ts_core_response_aq(&c, (uint8_t *)&bad, sizeof(bad), 5 * NS_MS), n, "foreign seq rejected");
+    bad = r;
+    bad.magic = 0;
+    check(!ts_core_response_aq(&c, (uint8_t *)&bad, sizeof(bad), 5 * NS_MS), n, "bad magic rejected");
+    check(!ts_core_response_aq(&c, (uint8_t *)&r, sizeof(r) - 1, 5 * NS_MS), n, "short frame rejected");
+    bad = r;
+    bad.t3_ns = bad.t2_ns + 10 * NS_MS;
+    check(!ts_core_response_aq(&c, (uint8_t *)&bad, sizeof(bad), 5 * NS_MS), n, "negative delay rejected");
+    check(ts_core_response_aq(&c, (uint8_t *)&r, sizeof(r), 5 * NS_MS), n, "valid response accepted");
+    check(!ts_core_response_aq(&c, (uint8_t *)&r, sizeof(r), 5 * NS_MS), n, "duplicate rejected");
+    // Una respuesta tardía a la petición anterior no vale para la nueva
+    check(ts_core_request_aq(&c, 6 * NS_MS, &f), n, "second request");
+    check(!ts_core_response_aq(&c, (uint8_t *)&r, sizeof(r), 7 * NS_MS), n, "late reply to old seq rejected");
+    int64_t bus, master;
+    uint32_t fl = ts_core_time_aq(&c, 7 * NS_MS, &bus, &master);
+    check(fl & TIMESYNC_MASTER_SYNC_AQ, n, "MASTER sync after one window");
+    check(llabs(bus - master) < TS_WRAP_NS_AQ / 2, n, "epoch brings bus time within 1.024 s of the MASTER");
+    timesync_stats_aq_t st;
+    ts_core_stats_aq(&c, 7 * NS_MS, &st);
+    check(st.replies == 1 && st.rejected == 6 && st.exchanges == 2, n, "exchange counters");
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "p:s:h")) != -1) {
+        switch (opt) {
+        case 'p': s_panels = atoi(optarg); break;
+        case 's': s_seconds = atof(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-p panels (2..%d)] [-s seconds]\n", argv[0], MAX_PANELS);
+            return 2;
+        }
+    }
+    if (s_panels < 2) s_panels = 2;
+    if (s_panels > MAX_PANELS) s_panels = MAX_PANELS;
+
+    protocol_checks();
+    const scenario_t scenarios[] = {
+        { .name = "clean", .sof_base_us = 12, .sof_exp_us = 3, .up_us = 180, .dn_us = 240, .net_exp_us = 20,
+          .sof_window = CONFIG_AQ_TIMESYNC_SOF_WINDOW, .checked = true },
+        { .name = "jitter", .sof_base_us = 15, .sof_exp_us = 25, .spike_p = 0.01, .spike_us = 800, .miss_p = 0.005,
+          .block_per_s = 0.2, .block_ms = 40, .up_us = 180, .dn_us = 240, .net_exp_us = 60, .queue_p = 0.05,
+          .queue_us = 3000, .lost_p = 0.01, .late_p = 0.005, .sof_window = CONFIG_AQ_TIMESYNC_SOF_WINDOW,
+          .checked = true },
+        { .name = "jitter_w1", .sof_base_us = 15, .sof_exp_us = 25, .spike_p = 0.01, .spike_us = 800, .miss_p = 0.005,
+          .block_per_s = 0.2, .block_ms = 40, .up_us = 180, .dn_us = 240, .net_exp_us = 60, .queue_p = 0.05,
+          .queue_us = 3000, .lost_p = 0.01, .late_p = 0.005, .sof_window = 1 },
+        { .name = "suspend", .sof_base_us = 15, .sof_exp_us = 25, .spike_p = 0.01, .spike_us = 800, .miss_p = 0.005,
+          .suspend_at_ns = 30 * NS_S, .suspend_ns = 5 * NS_S, .up_us = 180, .dn_us = 240, .net_exp_us = 60,
+          .lost_p = 0.01, .sof_window = CONFIG_AQ_TIMESYNC_SOF_WINDOW, .checked = true },
+    };
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) run(&scenarios[i]);
+    printf("RESULT check=%s failures=%d\n", s_failures ? "FAIL" : "ok", s_failures);
+    return s_failures ? 1 : 0;
+}
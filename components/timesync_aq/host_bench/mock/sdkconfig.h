@@ -0,0 +1,6 @@
+#pragma once
+// Valores por defecto del Kconfig de timesync_aq
+#define CONFIG_AQ_TIMESYNC_PORT 5517
+#define CONFIG_AQ_TIMESYNC_INTERVAL_MS 125
+#define CONFIG_AQ_TIMESYNC_EXCHANGE_WINDOW 8
+#define CONFIG_AQ_TIMESYNC_SOF_WINDOW 16
@@ -0,0 +1,86 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_netif.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Base de tiempo común a los paneles de un mismo bus USB. El reloj local (esp_timer) se
+// disciplina con el start-of-frame de 1 ms que el host envía a todos los dispositivos del
+// bus, y un intercambio de cuatro marcas con el MASTER por UDP sobre la netif USB fija la
+// época y el desfase con el reloj del MASTER. Protocolo y precisión: README.md.
+
+#define TIMESYNC_MAGIC_AQ     0x5451  // "QT" en little-endian
+#define TIMESYNC_VERSION_AQ   1
+#define TIMESYNC_FRAME_LEN_AQ 32
+
+#define TIMESYNC_REQ_AQ       1
+#define TIMESYNC_RESP_AQ      2
+
+// Trama de 32 B, little-endian, igual en los dos sentidos. El MASTER contesta copiando
+// seq y t1 y rellenando t2/t3 con su reloj.
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t  version;
+    uint8_t  type;        // TIMESYNC_REQ_AQ / TIMESYNC_RESP_AQ
+    uint32_t seq;
+    int64_t  t1_ns;       // salida de la petición, tiempo de bus del panel
+    int64_t  t2_ns;       // llegada al MASTER, su reloj
+    int64_t  t3_ns;       // salida de la respuesta, su reloj
+} timesync_frame_aq_t;
+
+_Static_assert(sizeof(timesync_frame_aq_t) == TIMESYNC_FRAME_LEN_AQ, "timesync frame layout");
+
+// flags de timesync_time_aq_t y timesync_stats_aq_t
+#define TIMESYNC_SOF_LOCKED_AQ  0x01  // fase enganchada al SOF: bus_us común a los paneles módulo 2,048 s
+#define TIMESYNC_MASTER_SYNC_AQ 0x02  // época fijada con el MASTER: bus_us común sin ambigüedad y master_us válido
+
+typedef struct {
+    int64_t  bus_us;      // tiempo de bus (el mismo en todos los paneles del hub)
+    int64_t  master_us;   // reloj del MASTER (tiempo Unix con el responder de tools/)
+    uint32_t flags;       // TIMESYNC_*_AQ
+} timesync_time_aq_t;
+
+typedef struct {
+    uint32_t flags;
+    // SOF: reloj local -> bus
+    uint32_t sof;               // SOF recibidos
+    uint32_t sof_missed;        // números de trama saltados (SOF perdidos o bus suspendido)
+    uint32_t sof_updates;       // actualizaciones del servo (una por ventana)
+    uint32_t sof_outliers;      // ventanas descartadas por error fuera de rango
+    uint32_t sof_steps;         // saltos de fase (reenganche)
+    int32_t  sof_offset_ns;     // último error de fase tras el filtro de mínimos
+    uint32_t sof_jitter_ns;     // media móvil de |sof_offset_ns|
+    int32_t  drift_ppb;         // corrección de frecuencia del reloj local frente al bus
+    // MASTER: bus -> reloj del MASTER
+    uint32_t exchanges;         // peticiones enviadas
+    uint32_t replies;           // respuestas aceptadas
+    uint32_t rejected;          // malformadas, seq distinta de la pendiente o retardo negativo
+    uint32_t master_updates;
+    uint32_t master_outliers;
+    uint32_t master_steps;
+    uint32_t delay_ns;          // ida y vuelta elegido en la última ventana
+    int32_t  master_offset_ns;  // último error de fase frente al MASTER
+    uint32_t master_jitter_ns;
+    int32_t  master_drift_ppb;  // reloj del MASTER frente al bus
+} timesync_stats_aq_t;
+
+// Engancha el SOF (usb_netif_set_sof_cb_aq) y abre el pcb UDP en CONFIG_AQ_TIMESYNC_PORT
+// ligado a la netif, con peticiones al gateway (el MASTER) cada
+// CONFIG_AQ_TIMESYNC_INTERVAL_MS. Tras usb_netif_start_aq; el puerto se registra como
+// tráfico de control para que las tramas no esperen a la agregación NCM.
+esp_err_t timesync_start_aq(esp_netif_t *netif);
+esp_err_t timesync_stop_aq(void);
+// Cualquier tarea, no ISR. ESP_ERR_INVALID_STATE hasta el primer SOF; después siempre
+// ESP_OK y flags dice qué campos valen (sin SOF recientes el reloj sigue por inercia).
+esp_err_t timesync_now_aq(timesync_time_aq_t *out);
+// Igual para una marca esp_timer_get_time() tomada antes, p.ej. al leer un sensor
+esp_err_t timesync_from_local_aq(int64_t local_us, timesync_time_aq_t *out);
+esp_err_t timesync_get_stats_aq(timesync_stats_aq_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,161 @@
+#include "timesync_aq.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_netif_net_stack.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "lwip/ip4_addr.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/timeouts.h"
+#include "lwip/udp.h"
+#include "sdkconfig.h"
+#include "usb_netif_aq.h"
+#include "timesync_core_aq.h"
+
+static const char *TAG = "timesync_aq";
+
+// s_core lo tocan la tarea usb_device (SOF), la tcpip (UDP) y quien consulte la hora:
+// secciones críticas cortas, sin llamadas dentro
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static ts_core_aq_t s_core;
+static bool s_core_ready;
+// Solo la tarea tcpip
+static struct udp_pcb *s_pcb;
+static struct netif *s_lwip_netif;
+
+static int64_t local_ns(void) {
+    return esp_timer_get_time() * 1000;
+}
+
+// Tarea usb_device, 1000 veces por segundo
+static void on_sof(uint32_t frame, int64_t t_us, void *ctx) {
+    taskENTER_CRITICAL(&s_lock);
+    ts_core_sof_aq(&s_core, frame, t_us * 1000);
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+static void ts_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    int64_t t4 = local_ns();
+    uint8_t copy[TIMESYNC_FRAME_LEN_AQ];
+    const uint8_t *frame = p->payload;
+    size_t len = p->tot_len;
+    if (p->len != p->tot_len && len == sizeof(copy)) {
+        pbuf_copy_partial(p, copy, sizeof(copy), 0);
+        frame = copy;
+    }
+    taskENTER_CRITICAL(&s_lock);
+    ts_core_response_aq(&s_core, frame, len, t4);
+    taskEXIT_CRITICAL(&s_lock);
+    pbuf_free(p);
+}
+
+// Temporizador de lwIP: corre en la tarea tcpip, como el envío. t1 se toma justo antes de
+// udp_sendto; la trama va por la cola de control de usb_netif_aq sin esperar agregación.
+static void ts_request(void *arg) {
+    sys_timeout(CONFIG_AQ_TIMESYNC_INTERVAL_MS, ts_request, NULL);
+    const ip4_addr_t *gw = netif_ip4_gw(s_lwip_netif);
+    if (gw == NULL || ip4_addr_isany(gw) || !netif_is_up(s_lwip_netif)) return;
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, TIMESYNC_FRAME_LEN_AQ, PBUF_RAM);
+    if (p == NULL) return;
+    timesync_frame_aq_t f;
+    taskENTER_CRITICAL(&s_lock);
+    bool ok = ts_core_request_aq(&s_core, local_ns(), &f);
+    taskEXIT_CRITICAL(&s_lock);
+    if (ok) {
+        ip_addr_t dst;
+        ip_addr_copy_from_ip4(dst, *gw);
+        memcpy(p->payload, &f, sizeof(f));
+        udp_sendto(s_pcb, p, &dst, CONFIG_AQ_TIMESYNC_PORT);
+    }
+    pbuf_free(p);
+}
+
+static esp_err_t ts_open(void *ctx) {
+    struct netif *lwip_netif = esp_netif_get_netif_impl((esp_netif_t *)ctx);
+    if (lwip_netif == NULL) return ESP_ERR_INVALID_STATE;
+    struct udp_pcb *pcb = udp_new_ip_type(IPADDR_TYPE_V4);
+    if (pcb == NULL) return ESP_ERR_NO_MEM;
+    if (udp_bind(pcb, IP4_ADDR_ANY, CONFIG_AQ_TIMESYNC_PORT) != ERR_OK) {
+        udp_remove(pcb);
+        return ESP_FAIL;
+    }
+    // Solo la netif USB: el MASTER contesta por donde preguntamos
+    udp_bind_netif(pcb, lwip_netif);
+    udp_recv(pcb, ts_recv, NULL);
+    s_pcb = pcb;
+    s_lwip_netif = lwip_netif;
+    sys_timeout(CONFIG_AQ_TIMESYNC_INTERVAL_MS, ts_request, NULL);
+    return ESP_OK;
+}
+
+static esp_err_t ts_close(void *ctx) {
+    sys_untimeout(ts_request, NULL);
+    if (s_pcb) {
+        udp_remove(s_pcb);
+        s_pcb = NULL;
+    }
+    s_lwip_netif = NULL;
+    return ESP_OK;
+}
+
+esp_err_t timesync_start_aq(esp_netif_t *netif) {
+    if (netif == NULL) return ESP_ERR_INVALID_ARG;
+    if (s_pcb) return ESP_ERR_INVALID_STATE;
+    if (!s_core_ready) {
+        ts_core_init_aq(&s_core, CONFIG_AQ_TIMESYNC_SOF_WINDOW, CONFIG_AQ_TIMESYNC_EXCHANGE_WINDOW);
+        s_core_ready = true;
+    }
+    esp_err_t err = usb_netif_set_sof_cb_aq(on_sof, NULL);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "SOF hook: %s", esp_err_to_name(err));
+        return err;
+    }
+    // Sin la cola de control la petición esperaría al flush de agregación NCM y el
+    // retardo de subida dejaría de parecerse al de bajada
+    err = usb_netif_tx_add_ctrl_port_aq(CONFIG_AQ_TIMESYNC_PORT);
+    if (err != ESP_OK) ESP_LOGW(TAG, "Port %d not classified as control: %s", CONFIG_AQ_TIMESYNC_PORT, esp_err_to_name(err));
+    err = esp_netif_tcpip_exec(ts_open, netif);
+    if (err != ESP_OK) {
+        usb_netif_set_sof_cb_aq(NULL, NULL);
+        ESP_LOGE(TAG, "UDP %d not opened: %s", CONFIG_AQ_TIMESYNC_PORT, esp_err_to_name(err));
+        return err;
+    }
+    ESP_LOGI(TAG, "SOF time sync, MASTER exchange on UDP %d every %d ms", CONFIG_AQ_TIMESYNC_PORT,
+             CONFIG_AQ_TIMESYNC_INTERVAL_MS);
+    return ESP_OK;
+}
+
+// El estado del núcleo se conserva: un nuevo start sigue con la misma época
+esp_err_t timesync_stop_aq(void) {
+    usb_netif_set_sof_cb_aq(NULL, NULL);
+    usb_netif_tx_remove_ctrl_port_aq(CONFIG_AQ_TIMESYNC_PORT);
+    return esp_netif_tcpip_exec(ts_close, NULL);
+}
+
+esp_err_t timesync_from_local_aq(int64_t local_us, timesync_time_aq_t *out) {
+    if (out == NULL) return ESP_ERR_INVALID_ARG;
+    if (!s_core_ready) return ESP_ERR_INVALID_STATE;
+    int64_t bus, master;
+    taskENTER_CRITICAL(&s_lock);
+    bool valid = s_core.sof.valid;
+    out->flags = ts_core_time_aq(&s_core, local_us * 1000, &bus, &master);
+    taskEXIT_CRITICAL(&s_lock);
+    out->bus_us = bus / 1000;
+    out->master_us = master / 1000;
+    return valid ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t timesync_now_aq(timesync_time_aq_t *out) {
+    return timesync_from_local_aq(esp_timer_get_time(), out);
+}
+
+esp_err_t timesync_get_stats_aq(timesync_stats_aq_t *out) {
+    if (out == NULL) return ESP_ERR_INVALID_ARG;
+    if (!s_core_ready) return ESP_ERR_INVALID_STATE;
+    int64_t now = local_ns();
+    taskENTER_CRITICAL(&s_lock);
+    ts_core_stats_aq(&s_core, now, out);
+    taskEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
@@ -0,0 +1,269 @@
+#include "timesync_core_aq.h"
+#include <string.h>
+
+#define NS_PER_S        1000000000LL
+#define Q16(x)          ((int32_t)((x) * 65536))
+#define LOCK_AFTER      4
+#define MAX_SLEW_PPB    100000000LL              // 10 %: tope del término proporcional
+
+// SOF: la latencia ISR -> tarea usb_device ronda las decenas de µs; más de 500 µs en
+// toda una ventana es un bloqueo, no un error de fase. Ganancias bajas: con ventanas de
+// 16 ms y marcas de 1 µs cada medida de frecuencia lleva decenas de ppm de ruido.
+#define SOF_KP          Q16(0.05)
+#define SOF_KI          Q16(0.0005)
+#define SOF_ACQ_NS      (2 * NS_PER_S)
+#define SOF_STEP_NS     500000LL
+#define SOF_LOCK_NS     50000LL
+// MASTER: ida y vuelta por USB y la pila de red de los dos extremos; una corrección por
+// segundo, así que el integral tiene que ser más rápido para recoger la deriva
+#define MASTER_KP       Q16(0.3)
+#define MASTER_KI       Q16(0.02)
+#define MASTER_ACQ_NS   (8 * NS_PER_S)
+#define MASTER_STEP_NS  5000000LL
+#define MASTER_LOCK_NS  500000LL
+
+static int64_t clamp64(int64_t v, int64_t lim) {
+    return v > lim ? lim : (v < -lim ? -lim : v);
+}
+
+static int64_t abs64(int64_t v) {
+    return v < 0 ? -v : v;
+}
+
+// División redondeando al más cercano, también con a negativo
+static int64_t round_div(int64_t a, int64_t b) {
+    return a >= 0 ? (a + b / 2) / b : -((-a + b / 2) / b);
+}
+
+// dx * ppb / 1e9 sin desbordar con dx de horas
+static int64_t mul_ppb(int64_t dx, int64_t ppb) {
+    return (dx / NS_PER_S) * ppb + (dx % NS_PER_S) * ppb / NS_PER_S;
+}
+
+void ts_servo_init_aq(ts_servo_aq_t *s, int32_t kp_q16, int32_t ki_q16, int64_t acq_ns, int64_t step_ns,
+                      int64_t lock_ns) {
+    memset(s, 0, sizeof(*s));
+    s->kp_q16 = kp_q16;
+    s->ki_q16 = ki_q16;
+    s->acq_ns = acq_ns;
+    s->step_ns = step_ns;
+    s->lock_ns = lock_ns;
+}
+
+int64_t ts_servo_map_aq(const ts_servo_aq_t *s, int64_t x) {
+    int64_t dx = x - s->x0;
+    int64_t slew_dx = dx < 0 ? 0 : (dx > s->slew_ns ? s->slew_ns : dx);
+    return s->y0 + dx + mul_ppb(dx, s->freq_q16 >> 16) + mul_ppb(slew_dx, s->slew_ppb);
+}
+
+bool ts_servo_locked_aq(const ts_servo_aq_t *s) {
+    return s->valid && s->good >= LOCK_AFTER;
+}
+
+static void servo_reset_phase(ts_servo_aq_t *s, int64_t x, int64_t y) {
+    s->x0 = s->acq_x = x;
+    s->y0 = s->acq_y = y;
+    s->acq_next = s->acq_ns / 8;
+    s->slew_ppb = 0;
+    s->slew_ns = 0;
+    s->outliers = 0;
+    s->good = 0;
+}
+
+int64_t ts_servo_update_aq(ts_servo_aq_t *s, int64_t x, int64_t y) {
+    if (!s->valid) {
+        servo_reset_phase(s, x, y);
+        s->valid = true;
+        return 0;
+    }
+    int64_t yp = ts_servo_map_aq(s, x);
+    int64_t e = y - yp;
+    int64_t dt = x - s->x0;
+    if (abs64(e) > s->step_ns) {
+        // Una ventana mala se ignora; varias seguidas son un salto real del reloj
+        s->outliers_total++;
+        s->good = 0;
+        if (++s->outliers < TS_STEP_AFTER_AQ) return e;
+        servo_reset_phase(s, x, y);
+        s->steps++;
+        s->last_err = e;
+        return e;
+    }
+    if (dt <= 0) return e;
+
+    s->updates++;
+    s->outliers = 0;
+    s->last_err = e;
+    s->abs_err_avg += (abs64(e) - s->abs_err_avg) / 16;
+    s->good = abs64(e) <= s->lock_ns ? s->good + 1 : 0;
+
+    // Fase continua: el mapa nuevo arranca donde acaba el viejo
+    int64_t ppb = e * NS_PER_S / dt;
+    s->freq_q16 = clamp64(s->freq_q16 + ppb * s->ki_q16, (int64_t)TS_MAX_PPB_AQ << 16);
+    if (s->acq_next && x - s->acq_x >= s->acq_next) {
+        // Pendiente entre la muestra inicial y esta: el ruido de una sola medida se divide
+        // por toda la base. Primero con acq_ns/8 para no arrastrar retraso de fase y luego
+        // con bases del doble hasta acq_ns.
+        int64_t span = x - s->acq_x;
+        int64_t acq_ppb = ((y - s->acq_y) - span) * NS_PER_S / span;
+        s->freq_q16 = clamp64(acq_ppb, TS_MAX_PPB_AQ) << 16;
+        s->acq_next = s->acq_next < s->acq_ns ? s->acq_next * 2 : 0;
+    }
+    s->slew_ppb = clamp64((ppb * s->kp_q16) >> 16, MAX_SLEW_PPB);
+    s->slew_ns = dt;
+    s->x0 = x;
+    s->y0 = yp;
+    return e;
+}
+
+void ts_core_init_aq(ts_core_aq_t *c, uint32_t sof_window, uint32_t exch_window) {
+    memset(c, 0, sizeof(*c));
+    c->sof_window = sof_window ? sof_window : 1;
+    c->exch_window = exch_window ? exch_window : 1;
+    ts_servo_init_aq(&c->sof, SOF_KP, SOF_KI, SOF_ACQ_NS, SOF_STEP_NS, SOF_LOCK_NS);
+    ts_servo_init_aq(&c->master, MASTER_KP, MASTER_KI, MASTER_ACQ_NS, MASTER_STEP_NS, MASTER_LOCK_NS);
+}
+
+// Tiempo de bus interno previsto para local_ns; antes del primer ajuste, el último SOF
+// más lo transcurrido en el reloj local
+static int64_t predict_bus(const ts_core_aq_t *c, int64_t local_ns) {
+    if (c->sof.valid) return ts_servo_map_aq(&c->sof, local_ns);
+    return c->ext_frame * TS_FRAME_NS_AQ + (local_ns - c->last_sof_local);
+}
+
+void ts_core_sof_aq(ts_core_aq_t *c, uint32_t frame, int64_t local_ns) {
+    frame &= 0x7FF;
+    c->stats.sof++;
+    if (!c->have_frame) {
+        // El eje interno arranca en el número de trama: todos los paneles del bus quedan
+        // a un múltiplo de 2,048 s entre sí
+        c->ext_frame = frame;
+        c->have_frame = true;
+    } else {
+        // La vuelta de 11 bits la resuelve el reloj: basta con que la predicción no se
+        // desvíe más de ±1,024 s, también tras una suspensión larga
+        int64_t pf = round_div(predict_bus(c, local_ns), TS_FRAME_NS_AQ);
+        int64_t d = ((int64_t)frame - pf) & 0x7FF;
+        if (d >= 1024) d -= 2048;
+        int64_t ext = pf + d;
+        if (ext <= c->ext_frame) return;  // repetido o fuera de orden
+        c->stats.sof_missed += (uint32_t)(ext - c->ext_frame - 1);
+        c->ext_frame = ext;
+    }
+    c->last_sof_local = local_ns;
+
+    // Filtro de mínimos: la latencia solo retrasa la marca local, así que la muestra más
+    // adelantada frente al mapa es la más limpia de la ventana
+    int64_t y = c->ext_frame * TS_FRAME_NS_AQ;
+    int64_t e = y - (c->sof.valid ? ts_servo_map_aq(&c->sof, local_ns) : local_ns);
+    if (c->win_n == 0 || e > c->win_e) {
+        c->win_e = e;
+        c->win_x = local_ns;
+        c->win_y = y;
+    }
+    if (++c->win_n < c->sof_window) return;
+    c->win_n = 0;
+    uint32_t steps = c->sof.steps;
+    ts_servo_update_aq(&c->sof, c->win_x, c->win_y);
+    if (c->sof.steps != steps) {
+        // Salto del eje de bus (p.ej. otro host): la época y el servo del MASTER se
+        // calculaban sobre el eje viejo
+        ts_servo_init_aq(&c->master, MASTER_KP, MASTER_KI, MASTER_ACQ_NS, MASTER_STEP_NS, MASTER_LOCK_NS);
+        c->epoch_set = false;
+        c->epoch_ns = 0;
+        c->ex_n = 0;
+    }
+}
+
+bool ts_core_request_aq(ts_core_aq_t *c, int64_t local_ns, timesync_frame_aq_t *out) {
+    if (!c->sof.valid) return false;
+    c->seq++;
+    c->pending = true;
+    *out = (timesync_frame_aq_t){
+        .magic = TIMESYNC_MAGIC_AQ, .version = TIMESYNC_VERSION_AQ, .type = TIMESYNC_REQ_AQ,
+        .seq = c->seq, .t1_ns = ts_servo_map_aq(&c->sof, local_ns),
+    };
+    c->stats.exchanges++;
+    return true;
+}
+
+bool ts_core_response_aq(ts_core_aq_t *c, const uint8_t *frame, size_t len, int64_t local_ns) {
+    timesync_frame_aq_t f;
+    if (len != sizeof(f)) {
+        c->stats.rejected++;
+        return false;
+    }
+    memcpy(&f, frame, sizeof(f));
+    if (f.magic != TIMESYNC_MAGIC_AQ || f.version != TIMESYNC_VERSION_AQ || f.type != TIMESYNC_RESP_AQ ||
+        !c->pending || f.seq != c->seq) {
+        c->stats.rejected++;
+        return false;
+    }
+    // t1 vuelve tal cual: se mide con el mismo mapa que t4
+    int64_t t4 = ts_servo_map_aq(&c->sof, local_ns);
+    int64_t delay = (t4 - f.t1_ns) - (f.t3_ns - f.t2_ns);
+    if (delay < 0 || f.t3_ns < f.t2_ns) {
+        c->stats.rejected++;
+        return false;
+    }
+    c->pending = false;
+    c->stats.replies++;
+
+    // Puntos medios de los dos lados: desfase = ((t2 - t1) + (t3 - t4)) / 2. De la
+    // ventana vale la de menor ida y vuelta, la que menos cola ha pisado.
+    int64_t x = f.t1_ns + (t4 - f.t1_ns) / 2;
+    int64_t y = f.t2_ns + (f.t3_ns - f.t2_ns) / 2;
+    if (c->ex_n == 0 || delay < c->ex_delay) {
+        c->ex_delay = delay;
+        c->ex_x = x;
+        c->ex_y = y;
+    }
+    if (++c->ex_n < c->exch_window) return true;
+    c->ex_n = 0;
+    c->stats.delay_ns = (uint32_t)(c->ex_delay > UINT32_MAX ? UINT32_MAX : c->ex_delay);
+    if (!c->epoch_set) {
+        // Desfase MASTER - bus interno redondeado a vueltas de 2,048 s: todos los paneles
+        // llegan a la misma época mientras su error frente al MASTER sea < 1,024 s
+        c->epoch_ns = round_div(c->ex_y - c->ex_x, TS_WRAP_NS_AQ) * TS_WRAP_NS_AQ;
+        c->epoch_set = true;
+    }
+    ts_servo_update_aq(&c->master, c->ex_x, c->ex_y);
+    return true;
+}
+
+uint32_t ts_core_time_aq(const ts_core_aq_t *c, int64_t local_ns, int64_t *bus_ns, int64_t *master_ns) {
+    *master_ns = 0;
+    if (!c->sof.valid) {
+        *bus_ns = local_ns;
+        return 0;
+    }
+    uint32_t flags = 0;
+    int64_t b = ts_servo_map_aq(&c->sof, local_ns);
+    if (ts_servo_locked_aq(&c->sof) && local_ns - c->last_sof_local < TS_SOF_TIMEOUT_NS_AQ) {
+        flags |= TIMESYNC_SOF_LOCKED_AQ;
+    }
+    *bus_ns = b + c->epoch_ns;
+    if (c->master.valid) {
+        *master_ns = ts_servo_map_aq(&c->master, b);
+        flags |= TIMESYNC_MASTER_SYNC_AQ;
+    }
+    return flags;
+}
+
+void ts_core_stats_aq(const ts_core_aq_t *c, int64_t local_ns, timesync_stats_aq_t *out) {
+    int64_t bus, master;
+    *out = c->stats;
+    out->flags = ts_core_time_aq(c, local_ns, &bus, &master);
+    out->sof_updates = c->sof.updates;
+    out->sof_outliers = c->sof.outliers_total;
+    out->sof_steps = c->sof.steps;
+    out->sof_offset_ns = (int32_t)clamp64(c->sof.last_err, INT32_MAX);
+    out->sof_jitter_ns = (uint32_t)clamp64(c->sof.abs_err_avg, INT32_MAX);
+    out->drift_ppb = (int32_t)(c->sof.freq_q16 >> 16);
+    out->master_updates = c->master.updates;
+    out->master_outliers = c->master.outliers_total;
+    out->master_steps = c->master.steps;
+    out->master_offset_ns = (int32_t)clamp64(c->master.last_err, INT32_MAX);
+    out->master_jitter_ns = (uint32_t)clamp64(c->master.abs_err_avg, INT32_MAX);
+    out->master_drift_ppb = (int32_t)(c->master.freq_q16 >> 16);
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "timesync_aq.h"
+
+// Núcleo de timesync_aq: extensión del número de trama, filtros de mínimos, servos PI e
+// intercambio con el MASTER. C puro, enteros de 64 bits en ns (sin double: el FPU del S3
+// es de precisión simple) y sin bloqueos; timesync_aq.c lo serializa con un spinlock y el
+// benchmark de host lo alimenta con SOF y UDP simulados.
+
+#define TS_FRAME_NS_AQ  1000000LL                // 1 ms por trama en full speed
+#define TS_WRAP_NS_AQ   (2048 * TS_FRAME_NS_AQ)  // el número de trama es de 11 bits
+
+// Servo PI de un reloj: y = y0 + (x - x0) * (1 + freq + slew), todo en ns. Cada
+// actualización corrige la fase de forma continua: el término proporcional (slew) reparte
+// kp * error a lo largo del intervalo siguiente y el integral acumula la frecuencia. Tras
+// arrancar o saltar, la pendiente desde la muestra inicial fija la frecuencia de golpe
+// hasta una base de acq_ns (con ganancias bajas el integral tardaría minutos). Un error
+// mayor que step_ns en TS_STEP_AFTER_AQ actualizaciones seguidas salta de fase.
+#define TS_STEP_AFTER_AQ 3
+#define TS_MAX_PPB_AQ    1000000                 // ±1000 ppm
+
+typedef struct {
+    int64_t  x0, y0;
+    int64_t  freq_q16;      // ppb << 16
+    int64_t  slew_ppb;
+    int64_t  slew_ns;       // duración del término proporcional (el último intervalo)
+    int32_t  kp_q16, ki_q16;
+    int64_t  step_ns;
+    int64_t  acq_ns;
+    int64_t  acq_x, acq_y;  // muestra inicial para la frecuencia
+    int64_t  acq_next;      // base de la próxima estimación directa (0 = ya no)
+    bool     valid;
+    uint8_t  outliers;      // seguidos
+    uint32_t good;          // actualizaciones seguidas dentro de lock_ns
+    int64_t  lock_ns;
+    uint32_t updates, outliers_total, steps;
+    int64_t  last_err;
+    int64_t  abs_err_avg;   // media móvil 1/16 de |error|
+} ts_servo_aq_t;
+
+void    ts_servo_init_aq(ts_servo_aq_t *s, int32_t kp_q16, int32_t ki_q16, int64_t acq_ns, int64_t step_ns,
+                         int64_t lock_ns);
+int64_t ts_servo_map_aq(const ts_servo_aq_t *s, int64_t x);
+// Nueva medida: en x el reloj de referencia marca y. Devuelve el error frente al mapa.
+int64_t ts_servo_update_aq(ts_servo_aq_t *s, int64_t x, int64_t y);
+bool    ts_servo_locked_aq(const ts_servo_aq_t *s);
+
+typedef struct {
+    // SOF: x = reloj local, y = tiempo de bus interno (trama extendida * 1 ms)
+    uint32_t sof_window;
+    bool     have_frame;
+    int64_t  ext_frame;
+    int64_t  last_sof_local;
+    uint32_t win_n;
+    int64_t  win_e, win_x, win_y;
+    ts_servo_aq_t sof;
+    // MASTER: x = tiempo de bus interno, y = reloj del MASTER
+    uint32_t exch_window;
+    uint32_t seq;
+    bool     pending;
+    uint32_t ex_n;
+    int64_t  ex_delay, ex_x, ex_y;
+    ts_servo_aq_t master;
+    bool     epoch_set;
+    int64_t  epoch_ns;      // múltiplo de 2,048 s que se suma al tiempo de bus interno
+    timesync_stats_aq_t stats;
+} ts_core_aq_t;
+
+// Sin SOF durante este tiempo se pierde TIMESYNC_SOF_LOCKED_AQ (el reloj sigue por inercia)
+#define TS_SOF_TIMEOUT_NS_AQ (100 * TS_FRAME_NS_AQ)
+
+void ts_core_init_aq(ts_core_aq_t *c, uint32_t sof_window, uint32_t exch_window);
+// SOF número frame (11 bits) visto en local_ns
+void ts_core_sof_aq(ts_core_aq_t *c, uint32_t frame, int64_t local_ns);
+// Petición que sale ahora; false hasta tener tiempo de bus. Deja pendiente su seq: una
+// respuesta anterior que llegue tarde se rechaza.
+bool ts_core_request_aq(ts_core_aq_t *c, int64_t local_ns, timesync_frame_aq_t *out);
+// Respuesta de len bytes recibida en local_ns; true si se acepta
+bool ts_core_response_aq(ts_core_aq_t *c, const uint8_t *frame, size_t len, int64_t local_ns);
+// Tiempo de bus (con época) y del MASTER para local_ns; devuelve los flags válidos
+uint32_t ts_core_time_aq(const ts_core_aq_t *c, int64_t local_ns, int64_t *bus_ns, int64_t *master_ns);
+void ts_core_stats_aq(const ts_core_aq_t *c, int64_t local_ns, timesync_stats_aq_t *out);
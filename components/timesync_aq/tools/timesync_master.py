@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+"""Responder de timesync_aq en el MASTER: contesta las peticiones de los paneles con su reloj.
+
+Uso (en el MASTER, que es el gateway de la red USB de los paneles):
+    python components/timesync_aq/tools/timesync_master.py                # puerto 5517
+    python components/timesync_aq/tools/timesync_master.py --port 5517 -v  # una línea por panel y minuto
+
+Trama de 32 B little-endian: u16 magic = 0x5451, u8 version = 1, u8 type (1 = petición,
+2 = respuesta), u32 seq, i64 t1_ns, i64 t2_ns, i64 t3_ns. La respuesta copia seq y t1 y
+pone en t2 la llegada y en t3 la salida, en ns de CLOCK_REALTIME: el master_us de los
+paneles queda en tiempo Unix. t2 sale del kernel (SO_TIMESTAMPNS) cuando está disponible,
+para no contar la espera hasta que el proceso despierta.
+"""
+import argparse
+import socket
+import struct
+import sys
+import time
+
+FRAME = struct.Struct('<HBBIqqq')
+MAGIC = 0x5451
+VERSION = 1
+REQ = 1
+RESP = 2
+# Python no exporta la constante; 35 es la de Linux
+SO_TIMESTAMPNS = getattr(socket, 'SO_TIMESTAMPNS', 35 if sys.platform.startswith('linux') else None)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument('--port', type=int, default=5517)
+    ap.add_argument('--bind', default='0.0.0.0')
+    ap.add_argument('-v', '--verbose', action='store_true')
+    args = ap.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    # EF, como el resto del tráfico de control hacia los paneles
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_TOS, 46 << 2)
+    kernel_ts = SO_TIMESTAMPNS is not None
+    if kernel_ts:
+        sock.setsockopt(socket.SOL_SOCKET, SO_TIMESTAMPNS, 1)
+    sock.bind((args.bind, args.port))
+    print(f'timesync responder on UDP {args.port} ({"kernel" if kernel_ts else "user"} rx stamps)')
+
+    peers = {}
+    last_report = time.monotonic()
+    while True:
+        data, anc, _, addr = sock.recvmsg(FRAME.size + 1, socket.CMSG_SPACE(16))
+        t2 = time.time_ns()
+        for level, kind, payload in anc:
+            if kernel_ts and level == socket.SOL_SOCKET and kind == SO_TIMESTAMPNS and len(payload) >= 16:
+                sec, nsec = struct.unpack('qq', payload[:16])
+                t2 = sec * 1_000_000_000 + nsec
+        if len(data) != FRAME.size:
+            continue
+        magic, version, kind, seq, t1, _, _ = FRAME.unpack(data)
+        if magic != MAGIC or version != VERSION or kind != REQ:
+            continue
+        sock.sendto(FRAME.pack(MAGIC, VERSION, RESP, seq, t1, t2, time.time_ns()), addr)
+        peers[addr[0]] = peers.get(addr[0], 0) + 1
+
+        if args.verbose and time.monotonic() - last_report >= 60:
+            last_report = time.monotonic()
+            print(' '.join(f'{ip}:{n}' for ip, n in sorted(peers.items())))
+
+
+if __name__ == '__main__':
+    main()
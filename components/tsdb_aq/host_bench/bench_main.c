@@ -0,0 +1,310 @@
+// Benchmark de host (Linux) de tsdb_aq.
+//
+// Genera H horas de telemetría de un panel (8 canales con sus periodos, ruido de sensor
+// y jitter del planificador en las marcas de tiempo) y mide:
+//   codec:    bytes por muestra de cada canal frente a la muestra cruda (ts int64 + float,
+//             12 bytes) y al JSON que publicaría el panel, y ns por muestra al codificar
+//             y decodificar;
+//   store:    coste de tsdb_append_aq con el anillo en RAM desbordando a una partición
+//             simulada (NOR en RAM), y ritmo de tsdb_replay_aq decodificando lo recibido;
+//   recovery: la mitad del backlog se reenvía, se "reinicia" la flash y se comprueba
+//             que se recupera exactamente lo que quedaba.
+// Todo lo decodificado se compara con lo generado (exacto, o al paso de cuantización).
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "esp_partition.h"
+#include "tsdb_aq.h"
+#include "tsdb_codec_aq.h"
+#include "tsdb_flash_aq.h"
+
+extern bool g_mock_log_verbose_aq;
+
+#define T0_MS     1760000000000LL
+#define RAW_BYTES 12
+
+typedef struct {
+    const char *name;
+    uint32_t period_ms;
+    float res;            // 0 = float exacto
+} chan_def_t;
+
+static const chan_def_t s_defs[] = {
+    { "temp_sump", 10000, 0 },        // DS18B20: múltiplos de 1/16 °C
+    { "ph",        5000,  0.001f },
+    { "orp_mv",    10000, 1.0f },
+    { "cond_ms",   10000, 0.01f },
+    { "level_mm",  1000,  0 },        // entero guardado como float
+    { "flow_lpm",  1000,  0.1f },
+    { "power_w",   1000,  0 },        // float de ADC con mantisa completa: el peor caso
+    { "par",       60000, 0 },
+};
+#define NCH ((int)(sizeof(s_defs) / sizeof(s_defs[0])))
+
+typedef struct {
+    int64_t *ts;
+    float *v;
+    uint32_t n;
+    uint32_t cursor;      // verificación del replay
+    uint64_t json_bytes;
+} chan_data_t;
+
+static chan_data_t s_data[NCH];
+static double s_hours = 24;
+static int s_jitter_ms = 2;
+static uint32_t s_part_kb = 2048;
+static uint64_t s_rng = 0x9E3779B97F4A7C15ull;
+static uint64_t s_mismatch;
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static double uniform(void) {
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (double)(s_rng >> 11) / (double)(1ull << 53);
+}
+
+static double gauss(double sigma) {
+    double u = uniform(), w = uniform();
+    return sigma * sqrt(-2 * log(u + 1e-300)) * cos(2 * M_PI * w);
+}
+
+// ---- Datos ----
+
+static float gen_value(int ch, double h) {
+    double day = 2 * M_PI * h / 24, hod = fmod(h, 24);
+    bool lights = hod >= 10 && hod < 20;
+    switch (ch) {
+    case 0: return (float)(round((25.5 + 0.4 * sin(day) + gauss(0.03)) * 16) / 16);
+    case 1: return (float)(8.15 + 0.12 * sin(day - 1.5) + gauss(0.005));
+    case 2: return (float)(380 + 20 * sin(day) + gauss(2));
+    case 3: return (float)(53.0 + 0.2 * sin(h / 6) + gauss(0.02));
+    case 4: return (float)floor(450 - fmod(h, 8) * 1.5);           // evaporación y rellenado
+    case 5: return (float)(12.0 + gauss(0.15));
+    case 6: return (float)((180 + (lights ? 60 : 0) + (fmod(h, 0.5) < 0.1 ? 100 : 0) + gauss(0.5)) * 1.0037);
+    default: return lights ? (float)round(350 * sin(M_PI * (hod - 10) / 10)) : 0.0f;
+    }
+}
+
+static void generate(void) {
+    for (int ch = 0; ch < NCH; ch++) {
+        chan_data_t *d = &s_data[ch];
+        d->n = (uint32_t)(s_hours * 3600000 / s_defs[ch].period_ms);
+        d->ts = malloc(d->n * sizeof(*d->ts));
+        d->v = malloc(d->n * sizeof(*d->v));
+        for (uint32_t i = 0; i < d->n; i++) {
+            int64_t t = (int64_t)i * s_defs[ch].period_ms;
+            int jitter = s_jitter_ms ? (int)(uniform() * (2 * s_jitter_ms + 1)) - s_jitter_ms : 0;
+            d->ts[i] = T0_MS + t + (i ? jitter : 0);
+            d->v[i] = gen_value(ch, t / 3600000.0);
+            char json[96];
+            d->json_bytes += (uint64_t)snprintf(json, sizeof(json), "{\"sensor\":\"%s\",\"ts\":%lld,\"v\":%.7g}",
+                                                s_defs[ch].name, (long long)d->ts[i], d->v[i]);
+        }
+    }
+}
+
+// Lo que debe devolver el lector para una muestra
+static float expected(int ch, float v, float res) {
+    int32_t q;
+    if (res > 0 && tsdb_quantize_aq(v, res, &q)) return (float)((double)q * res);
+    return v;
+}
+
+// ---- Códec ----
+
+static void bench_codec(void) {
+    static uint8_t seg[CONFIG_AQ_TSDB_SEG_SIZE];
+    uint64_t all_samples = 0, all_bytes = 0, all_json = 0;
+    for (int ch = 0; ch < NCH; ch++) {
+        chan_data_t *d = &s_data[ch];
+        float res = s_defs[ch].res;
+        size_t cap = 0, used = 0;
+        uint8_t *out = NULL;
+        tsdb_enc_aq_t e;
+        bool open = false;
+
+        int64_t t0 = now_ns();
+        for (uint32_t i = 0; i < d->n; i++) {
+            if (open && tsdb_enc_append_aq(&e, d->ts[i], d->v[i])) continue;
+            if (open) {
+                size_t len = tsdb_enc_seal_aq(&e, 0);
+                if (used + len > cap) out = realloc(out, cap = (cap + len) * 2);
+                memcpy(out + used, seg, len);
+                used += len;
+            }
+            open = tsdb_enc_begin_aq(&e, seg, sizeof(seg), (uint8_t)ch, res, d->ts[i], d->v[i]);
+        }
+        if (open) {
+            size_t len = tsdb_enc_seal_aq(&e, 0);
+            if (used + len > cap) out = realloc(out, cap = (cap + len) * 2);
+            memcpy(out + used, seg, len);
+            used += len;
+        }
+        int64_t t1 = now_ns();
+
+        uint32_t k = 0, segs = 0;
+        for (size_t off = 0; off < used; segs++) {
+            tsdb_reader_aq_t r;
+            if (tsdb_reader_init_aq(&r, out + off, used - off) != ESP_OK) break;
+            int64_t ts;
+            float v;
+            while (tsdb_reader_next_aq(&r, &ts, &v)) {
+                float want = expected(ch, d->v[k], res);
+                if (k >= d->n || ts != d->ts[k] || memcmp(&v, &want, sizeof(v)) != 0) s_mismatch++;
+                k++;
+            }
+            off += tsdb_seg_len_aq(&r.hdr);
+        }
+        int64_t t2 = now_ns();
+        if (k != d->n) s_mismatch++;
+
+        double bps = (double)used / d->n;
+        printf("RESULT phase=codec ch=%s period_ms=%u res=%g samples=%u segments=%u bytes_per_sample=%.2f "
+               "raw=%d json=%.1f ratio_raw=%.1f enc_ns=%.0f dec_ns=%.0f\n",
+               s_defs[ch].name, s_defs[ch].period_ms, res, d->n, segs, bps, RAW_BYTES,
+               (double)d->json_bytes / d->n, RAW_BYTES / bps, (double)(t1 - t0) / d->n, (double)(t2 - t1) / d->n);
+        all_samples += d->n;
+        all_bytes += used;
+        all_json += d->json_bytes;
+        free(out);
+    }
+    printf("RESULT phase=codec ch=all samples=%llu bytes_per_sample=%.2f raw=%d json=%.1f ratio_raw=%.1f "
+           "ratio_json=%.1f\n",
+           (unsigned long long)all_samples, (double)all_bytes / all_samples, RAW_BYTES,
+           (double)all_json / all_samples, (double)RAW_BYTES * all_samples / all_bytes,
+           (double)all_json / all_bytes);
+}
+
+// ---- Almacén + flash ----
+
+typedef struct {
+    uint64_t samples;
+    uint64_t bytes;
+    uint32_t last_seq;
+    uint32_t out_of_order;
+} replay_ctx_t;
+
+static esp_err_t replay_cb(const uint8_t *seg, size_t len, void *arg) {
+    replay_ctx_t *c = arg;
+    tsdb_reader_aq_t r;
+    if (tsdb_reader_init_aq(&r, seg, len) != ESP_OK) {
+        s_mismatch++;
+        return ESP_OK;
+    }
+    if (r.hdr.seq <= c->last_seq) c->out_of_order++;
+    c->last_seq = r.hdr.seq;
+    chan_data_t *d = &s_data[r.hdr.channel];
+    int64_t ts;
+    float v;
+    while (tsdb_reader_next_aq(&r, &ts, &v)) {
+        // Lo que se perdió con la flash llena aparece como hueco: se salta
+        while (d->cursor < d->n && d->ts[d->cursor] < ts) d->cursor++;
+        float want = d->cursor < d->n ? expected(r.hdr.channel, d->v[d->cursor], r.hdr.resolution) : 0;
+        if (d->cursor >= d->n || d->ts[d->cursor] != ts || memcmp(&v, &want, sizeof(v)) != 0) s_mismatch++;
+        d->cursor++;
+        c->samples++;
+    }
+    c->bytes += len;
+    return ESP_OK;
+}
+
+static void print_stats(const char *phase) {
+    tsdb_stats_aq_t st;
+    tsdb_get_stats_aq(&st);
+    printf("RESULT phase=%s samples=%u pending=%u dropped=%u replayed=%u seg_ram=%u seg_flash=%u/%u "
+           "spilled=%u replayed_segments=%u\n",
+           phase, st.samples, st.pending_samples, st.dropped_samples, st.replayed_samples, st.segments_ram,
+           st.segments_flash, st.flash_capacity, st.spilled_segments, st.replayed_segments);
+}
+
+static void bench_store(void) {
+    mock_partition_create_aq("tsdb", s_part_kb * 1024);
+    tsdb_init_aq("tsdb");
+    for (int ch = 0; ch < NCH; ch++) tsdb_channel_config_aq((uint8_t)ch, s_defs[ch].res);
+
+    // Orden de llegada real: por marca de tiempo entre canales
+    uint32_t idx[NCH] = { 0 };
+    uint64_t total = 0, rejected = 0;
+    int64_t t0 = now_ns();
+    for (;;) {
+        int best = -1;
+        for (int ch = 0; ch < NCH; ch++) {
+            if (idx[ch] < s_data[ch].n && (best < 0 || s_data[ch].ts[idx[ch]] < s_data[best].ts[idx[best]])) best = ch;
+        }
+        if (best < 0) break;
+        if (tsdb_append_aq((uint8_t)best, s_data[best].ts[idx[best]], s_data[best].v[idx[best]]) != ESP_OK) rejected++;
+        idx[best]++;
+        total++;
+    }
+    tsdb_seal_aq();
+    int64_t t1 = now_ns();
+    mock_flash_stats_aq_t fs;
+    mock_flash_get_aq(&fs);
+    printf("RESULT phase=append samples=%llu rejected=%llu ns_per_sample=%.0f flash_erases=%llu flash_written=%llu\n",
+           (unsigned long long)total, (unsigned long long)rejected, (double)(t1 - t0) / total,
+           (unsigned long long)fs.erases, (unsigned long long)fs.written_bytes);
+    print_stats("after_append");
+
+    // Mitad del backlog, "reinicio" de la flash y el resto
+    tsdb_stats_aq_t st;
+    tsdb_get_stats_aq(&st);
+    replay_ctx_t rc = { 0 };
+    uint32_t n1 = 0, n2 = 0;
+    int64_t t2 = now_ns();
+    tsdb_replay_aq(replay_cb, &rc, (st.segments_flash + st.segments_ram) / 2, &n1);
+    int64_t t3 = now_ns();
+
+    uint16_t before = tsdb_flash_count_aq();
+    uint32_t pending_before = tsdb_flash_pending_samples_aq();
+    tsdb_flash_open_aq("tsdb", CONFIG_AQ_TSDB_SEG_SIZE);
+    bool recovered = tsdb_flash_count_aq() == before && tsdb_flash_pending_samples_aq() == pending_before;
+    printf("RESULT phase=recovery flash_segments=%u pending_samples=%u recovered=%s\n", before, pending_before,
+           recovered ? "yes" : "NO");
+
+    int64_t t4 = now_ns();
+    tsdb_replay_aq(replay_cb, &rc, UINT32_MAX, &n2);
+    int64_t t5 = now_ns();
+    double secs = (double)(t3 - t2 + t5 - t4) / 1e9;
+    mock_flash_get_aq(&fs);
+    printf("RESULT phase=replay segments=%u samples=%llu bytes=%llu msamples_per_s=%.1f mbytes_per_s=%.1f "
+           "out_of_order=%u bad_flash_writes=%llu\n",
+           n1 + n2, (unsigned long long)rc.samples, (unsigned long long)rc.bytes, rc.samples / secs / 1e6,
+           rc.bytes / secs / 1e6, rc.out_of_order, (unsigned long long)fs.bad_writes);
+    print_stats("after_replay");
+
+    tsdb_get_stats_aq(&st);
+    if (!recovered || rc.out_of_order || fs.bad_writes || st.pending_samples ||
+        rc.samples + st.dropped_samples != total - rejected) {
+        s_mismatch++;
+    }
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "H:j:p:v")) != -1) {
+        switch (opt) {
+        case 'H': s_hours = atof(optarg); break;
+        case 'j': s_jitter_ms = atoi(optarg); break;
+        case 'p': s_part_kb = (uint32_t)atoi(optarg); break;
+        case 'v': g_mock_log_verbose_aq = true; break;
+        default:
+            fprintf(stderr, "usage: %s [-H hours] [-j jitter_ms] [-p partition_kb] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    generate();
+    bench_codec();
+    bench_store();
+    printf("RESULT check=%s mismatches=%llu\n", s_mismatch ? "FAIL" : "ok", (unsigned long long)s_mismatch);
+    return s_mismatch ? 1 : 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Partición en RAM con semántica NOR: el borrado pone 0xFF y escribir solo baja bits
+typedef enum {
+    ESP_PARTITION_TYPE_APP = 0x00,
+    ESP_PARTITION_TYPE_DATA = 0x01,
+} esp_partition_type_t;
+
+typedef enum {
+    ESP_PARTITION_SUBTYPE_ANY = 0xff,
+} esp_partition_subtype_t;
+
+typedef struct {
+    esp_partition_type_t type;
+    esp_partition_subtype_t subtype;
+    uint32_t address;
+    uint32_t size;
+    uint32_t erase_size;
+    char label[17];
+} esp_partition_t;
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label);
+esp_err_t esp_partition_read(const esp_partition_t *p, size_t off, void *dst, size_t len);
+esp_err_t esp_partition_write(const esp_partition_t *p, size_t off, const void *src, size_t len);
+esp_err_t esp_partition_erase_range(const esp_partition_t *p, size_t off, size_t len);
+
+// Crea (o vacía) la partición del mock; sobrevive a un "reinicio" del componente
+void mock_partition_create_aq(const char *label, uint32_t size);
+typedef struct {
+    uint64_t erases;
+    uint64_t written_bytes;
+    uint64_t bad_writes;      // intentos de subir un bit a 1 sin borrar
+} mock_flash_stats_aq_t;
+void mock_flash_get_aq(mock_flash_stats_aq_t *out);
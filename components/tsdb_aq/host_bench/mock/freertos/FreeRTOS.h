@@ -0,0 +1,16 @@
+#pragma once
+#include <pthread.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+// Subconjunto de FreeRTOS sobre pthreads: solo el mutex que usa tsdb_aq
+typedef int32_t  BaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+
+typedef struct {
+    pthread_mutex_t mutex;
+} StaticSemaphore_t;
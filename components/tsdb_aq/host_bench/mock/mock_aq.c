@@ -0,0 +1,78 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "freertos/semphr.h"
+
+// ---------- semphr ----------
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buf) {
+    pthread_mutex_init(&buf->mutex, NULL);
+    return buf;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+    (void)ticks;
+    return pthread_mutex_lock(&sem->mutex) == 0 ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    return pthread_mutex_unlock(&sem->mutex) == 0 ? pdTRUE : pdFALSE;
+}
+
+// ---------- esp_partition (NOR en RAM) ----------
+
+static esp_partition_t s_part;
+static uint8_t *s_flash;
+static mock_flash_stats_aq_t s_fst;
+
+void mock_partition_create_aq(const char *label, uint32_t size) {
+    free(s_flash);
+    s_flash = malloc(size);
+    memset(s_flash, 0xff, size);
+    s_part = (esp_partition_t){
+        .type = ESP_PARTITION_TYPE_DATA,
+        .subtype = 0x80,
+        .size = size,
+        .erase_size = 4096,
+    };
+    strncpy(s_part.label, label, sizeof(s_part.label) - 1);
+    memset(&s_fst, 0, sizeof(s_fst));
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label) {
+    if (s_flash == NULL || type != s_part.type) return NULL;
+    if (subtype != ESP_PARTITION_SUBTYPE_ANY && subtype != s_part.subtype) return NULL;
+    if (label && strcmp(label, s_part.label) != 0) return NULL;
+    return &s_part;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *p, size_t off, void *dst, size_t len) {
+    if (off + len > p->size) return ESP_ERR_INVALID_SIZE;
+    memcpy(dst, s_flash + off, len);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *p, size_t off, const void *src, size_t len) {
+    if (off + len > p->size) return ESP_ERR_INVALID_SIZE;
+    const uint8_t *s = src;
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] & ~s_flash[off + i]) s_fst.bad_writes++;
+        s_flash[off + i] &= s[i];
+    }
+    s_fst.written_bytes += len;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *p, size_t off, size_t len) {
+    if (off % p->erase_size || len % p->erase_size || off + len > p->size) return ESP_ERR_INVALID_ARG;
+    memset(s_flash + off, 0xff, len);
+    s_fst.erases += len / p->erase_size;
+    return ESP_OK;
+}
+
+void mock_flash_get_aq(mock_flash_stats_aq_t *out) {
+    *out = s_fst;
+}
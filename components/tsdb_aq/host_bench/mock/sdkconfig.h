@@ -0,0 +1,5 @@
+#pragma once
+// Valores por defecto del Kconfig de tsdb_aq para el build de host
+#define CONFIG_AQ_TSDB_MAX_CHANNELS 8
+#define CONFIG_AQ_TSDB_SEG_SIZE 256
+#define CONFIG_AQ_TSDB_RAM_SEGMENTS 64
@@ -0,0 +1,98 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Almacén de series temporales del panel para cuando el MASTER no está: cada canal se
+// comprime al estilo Gorilla (delta-of-delta de marcas de tiempo, XOR o delta de valores)
+// en segmentos de tamaño fijo de un anillo en RAM. Con una partición configurada, los
+// segmentos más antiguos pasan a flash en vez de perderse. tsdb_replay_aq entrega el
+// backlog segmento a segmento, tal cual, para enviarlo en bloque al reconectar.
+// Formato del segmento: README.md; tools/tsdb_decode.py lo decodifica en el MASTER.
+
+#define TSDB_SEG_MAGIC_AQ   0x5354  // "TS" en little-endian
+#define TSDB_SEG_HDR_LEN_AQ 28
+
+// Cabecera del segmento, little-endian; le siguen `bits` bits de muestras (MSB primero)
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t  state;       // flash: 0xFE vivo, 0x00 ya reenviado; RAM: 0xFE
+    uint8_t  channel;
+    uint32_t seq;         // orden de sellado, creciente; es el orden de replay
+    int64_t  t0_ms;       // marca de la primera muestra
+    uint16_t count;       // muestras, incluida la primera
+    uint16_t bits;        // bits de payload usados tras la cabecera
+    float    resolution;  // 0: valores float exactos (XOR); > 0: cuantizados a este paso (delta)
+    uint32_t v0;          // primer valor: bits del float o entero cuantizado
+} tsdb_seg_hdr_aq_t;
+
+_Static_assert(sizeof(tsdb_seg_hdr_aq_t) == TSDB_SEG_HDR_LEN_AQ, "tsdb segment header layout");
+
+typedef struct {
+    uint32_t samples;            // aceptadas desde init
+    uint32_t pending_samples;    // aún no reenviadas: segmentos abiertos, sellados y en flash
+    uint32_t dropped_samples;    // perdidas con el anillo lleno (sin flash, o flash también llena)
+    uint32_t replayed_samples;
+    uint16_t segments_open;
+    uint16_t segments_ram;       // sellados esperando replay
+    uint16_t segments_free;
+    uint16_t segments_flash;     // vivos en la partición
+    uint16_t flash_capacity;     // segmentos que caben en la partición; 0 sin flash
+    uint32_t spilled_segments;   // pasados de RAM a flash
+    uint32_t replayed_segments;
+    uint32_t payload_bytes;      // cabeceras + bits de los segmentos sellados desde init
+    uint32_t sealed_samples;     // muestras de esos segmentos (bytes/muestra = payload/sealed)
+} tsdb_stats_aq_t;
+
+// Recibe un segmento sellado (cabecera + payload, len bytes). ESP_OK lo da por entregado y
+// se libera; cualquier otro valor detiene el replay y el segmento se queda para el siguiente.
+typedef esp_err_t (*tsdb_replay_cb_aq_t)(const uint8_t *seg, size_t len, void *ctx);
+
+// partition: etiqueta de una partición de datos (cualquier subtipo) para el desbordamiento;
+// NULL o "" = solo RAM. Los segmentos que queden en flash de un arranque anterior se
+// recuperan y se reenvían primero. Si la partición no vale se sigue solo con RAM.
+esp_err_t tsdb_init_aq(const char *partition);
+
+// Paso de cuantización del canal (0 = float exacto). Se aplica al siguiente segmento del
+// canal; los que ya existen conservan el suyo.
+esp_err_t tsdb_channel_config_aq(uint8_t channel, float resolution);
+
+// Seguro desde cualquier tarea. ts_ms: el reloj que use la aplicación (idealmente Unix ms);
+// no decreciente por canal. Puede bloquear mientras se escribe un segmento en flash.
+// ESP_ERR_INVALID_ARG: canal fuera de rango, marca anterior a la última o valor que no
+// cabe en 32 bits con la resolución del canal.
+esp_err_t tsdb_append_aq(uint8_t channel, int64_t ts_ms, float value);
+
+// Sella los segmentos abiertos para que el próximo replay incluya las últimas muestras
+esp_err_t tsdb_seal_aq(void);
+
+// Entrega hasta max_segments segmentos, del más antiguo al más nuevo (primero los de
+// flash). El callback corre sin el lock: los productores siguen añadiendo mientras tanto.
+// out_segments (opcional): cuántos se entregaron. Devuelve el error del callback si paró.
+esp_err_t tsdb_replay_aq(tsdb_replay_cb_aq_t cb, void *ctx, uint32_t max_segments, uint32_t *out_segments);
+
+esp_err_t tsdb_get_stats_aq(tsdb_stats_aq_t *out);
+
+// Decodificación de un segmento (p.ej. en el lado que lo recibe, o para comprobarlo)
+typedef struct {
+    const uint8_t *seg;
+    tsdb_seg_hdr_aq_t hdr;
+    uint32_t pos;          // bit actual del payload
+    uint16_t left;         // muestras por leer
+    int64_t ts;
+    int64_t delta;
+    uint32_t prev;         // bits del float o entero cuantizado
+    uint8_t lead, trail;   // ventana XOR
+} tsdb_reader_aq_t;
+
+esp_err_t tsdb_reader_init_aq(tsdb_reader_aq_t *r, const uint8_t *seg, size_t len);
+bool      tsdb_reader_next_aq(tsdb_reader_aq_t *r, int64_t *ts_ms, float *value);
+
+#ifdef __cplusplus
+}
+#endif
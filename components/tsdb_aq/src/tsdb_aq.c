@@ -0,0 +1,220 @@
+#include "tsdb_aq.h"
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+#include "tsdb_codec_aq.h"
+#include "tsdb_flash_aq.h"
+
+static const char *TAG = "tsdb_aq";
+
+#define SEG_SIZE  CONFIG_AQ_TSDB_SEG_SIZE
+#define RAM_SEGS  CONFIG_AQ_TSDB_RAM_SEGMENTS
+#define MAX_CH    CONFIG_AQ_TSDB_MAX_CHANNELS
+#define NO_SLOT   (-1)
+
+typedef struct {
+    tsdb_enc_aq_t enc;
+    int16_t slot;        // segmento abierto en s_ram; NO_SLOT si no hay
+    float resolution;    // para el siguiente segmento
+    int64_t last_ts;
+    bool has_ts;
+} channel_t;
+
+// Anillo en RAM: pila de huecos libres + FIFO de sellados en orden de seq
+static uint8_t s_ram[RAM_SEGS][SEG_SIZE];
+static uint16_t s_free[RAM_SEGS];
+static uint16_t s_nfree;
+static uint16_t s_fifo[RAM_SEGS];
+static uint16_t s_fifo_head, s_fifo_count;
+static channel_t s_ch[MAX_CH];
+static uint32_t s_seq;
+static uint32_t s_pending_ram;
+
+static SemaphoreHandle_t s_lock = NULL;
+static StaticSemaphore_t s_lock_buf;
+static uint8_t s_replay_buf[SEG_SIZE];
+static bool s_replaying;
+static tsdb_stats_aq_t s_st;
+
+static const tsdb_seg_hdr_aq_t *hdr_of(uint16_t slot) {
+    return (const tsdb_seg_hdr_aq_t *)s_ram[slot];
+}
+
+static void seal_channel(channel_t *c) {
+    size_t len = tsdb_enc_seal_aq(&c->enc, ++s_seq);
+    s_fifo[(s_fifo_head + s_fifo_count) % RAM_SEGS] = (uint16_t)c->slot;
+    s_fifo_count++;
+    s_st.payload_bytes += len;
+    s_st.sealed_samples += c->enc.count;
+    c->slot = NO_SLOT;
+}
+
+// Hueco libre; si no hay, el sellado más antiguo pasa a flash (o se pierde)
+static int take_slot(void) {
+    if (s_nfree) return s_free[--s_nfree];
+    if (s_fifo_count == 0) return NO_SLOT;  // todos abiertos: más canales activos que huecos
+    uint16_t slot = s_fifo[s_fifo_head];
+    s_fifo_head = (s_fifo_head + 1) % RAM_SEGS;
+    s_fifo_count--;
+    const tsdb_seg_hdr_aq_t *h = hdr_of(slot);
+    uint32_t dropped = 0;
+    if (tsdb_flash_enabled_aq() && tsdb_flash_push_aq(s_ram[slot], tsdb_seg_len_aq(h), &dropped) == ESP_OK) {
+        s_st.spilled_segments++;
+        s_st.dropped_samples += dropped;
+    } else {
+        s_st.dropped_samples += h->count;
+    }
+    s_pending_ram -= h->count;
+    return slot;
+}
+
+// Retira el segmento ya entregado si sigue siendo el más antiguo (un append pudo
+// desalojarlo a flash, o perderlo, mientras corría el callback)
+static void retire(uint32_t seq) {
+    size_t len;
+    uint32_t oldest;
+    if (tsdb_flash_enabled_aq() && tsdb_flash_peek_aq(s_replay_buf, &len, &oldest) == ESP_OK) {
+        if (oldest == seq) tsdb_flash_pop_aq();
+        return;
+    }
+    if (s_fifo_count && hdr_of(s_fifo[s_fifo_head])->seq == seq) {
+        uint16_t slot = s_fifo[s_fifo_head];
+        s_fifo_head = (s_fifo_head + 1) % RAM_SEGS;
+        s_fifo_count--;
+        s_pending_ram -= hdr_of(slot)->count;
+        s_free[s_nfree++] = slot;
+    }
+}
+
+esp_err_t tsdb_init_aq(const char *partition) {
+    if (s_lock) return ESP_OK;
+    for (uint16_t i = 0; i < RAM_SEGS; i++) s_free[i] = RAM_SEGS - 1 - i;
+    s_nfree = RAM_SEGS;
+    for (int i = 0; i < MAX_CH; i++) s_ch[i].slot = NO_SLOT;
+    if (partition && partition[0] && tsdb_flash_open_aq(partition, SEG_SIZE) != ESP_OK) {
+        ESP_LOGW(TAG, "Flash spill disabled, RAM only");
+    }
+    // Los seq siguen a los que quedaron en flash para que el replay respete el orden
+    s_seq = tsdb_flash_max_seq_aq();
+    s_lock = xSemaphoreCreateMutexStatic(&s_lock_buf);
+    ESP_LOGI(TAG, "%d RAM segments of %d bytes, %d channels", RAM_SEGS, SEG_SIZE, MAX_CH);
+    return ESP_OK;
+}
+
+esp_err_t tsdb_channel_config_aq(uint8_t channel, float resolution) {
+    if (channel >= MAX_CH || !(resolution >= 0)) return ESP_ERR_INVALID_ARG;
+    if (s_lock == NULL) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_ch[channel].resolution = resolution;
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+esp_err_t tsdb_append_aq(uint8_t channel, int64_t ts_ms, float value) {
+    if (channel >= MAX_CH) return ESP_ERR_INVALID_ARG;
+    if (s_lock == NULL) return ESP_ERR_INVALID_STATE;
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    channel_t *c = &s_ch[channel];
+    float res = c->slot != NO_SLOT ? c->enc.resolution : c->resolution;
+    int32_t q;
+    if ((c->has_ts && ts_ms < c->last_ts) || (res > 0 && !tsdb_quantize_aq(value, res, &q))) {
+        err = ESP_ERR_INVALID_ARG;
+    } else if (c->slot == NO_SLOT || !tsdb_enc_append_aq(&c->enc, ts_ms, value)) {
+        if (c->slot != NO_SLOT) seal_channel(c);
+        int slot = take_slot();
+        if (slot == NO_SLOT) {
+            s_st.dropped_samples++;
+            err = ESP_ERR_NO_MEM;
+        } else if (!tsdb_enc_begin_aq(&c->enc, s_ram[slot], SEG_SIZE, channel, c->resolution, ts_ms, value)) {
+            s_free[s_nfree++] = (uint16_t)slot;
+            err = ESP_ERR_INVALID_ARG;
+        } else {
+            c->slot = (int16_t)slot;
+        }
+    }
+    if (err == ESP_OK) {
+        c->last_ts = ts_ms;
+        c->has_ts = true;
+        s_st.samples++;
+        s_pending_ram++;
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t tsdb_seal_aq(void) {
+    if (s_lock == NULL) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < MAX_CH; i++) {
+        if (s_ch[i].slot != NO_SLOT) seal_channel(&s_ch[i]);
+    }
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
+
+esp_err_t tsdb_replay_aq(tsdb_replay_cb_aq_t cb, void *ctx, uint32_t max_segments, uint32_t *out_segments) {
+    if (cb == NULL) return ESP_ERR_INVALID_ARG;
+    if (s_lock == NULL) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool busy = s_replaying;
+    s_replaying = true;
+    xSemaphoreGive(s_lock);
+    if (busy) return ESP_ERR_INVALID_STATE;
+
+    esp_err_t err = ESP_OK;
+    uint32_t n = 0;
+    while (n < max_segments) {
+        size_t len;
+        uint32_t seq;
+        // Primero flash: ahí solo llegan los más antiguos
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        if (!(tsdb_flash_enabled_aq() && tsdb_flash_peek_aq(s_replay_buf, &len, &seq) == ESP_OK)) {
+            if (s_fifo_count == 0) {
+                xSemaphoreGive(s_lock);
+                break;
+            }
+            const tsdb_seg_hdr_aq_t *h = hdr_of(s_fifo[s_fifo_head]);
+            len = tsdb_seg_len_aq(h);
+            seq = h->seq;
+            memcpy(s_replay_buf, h, len);
+        }
+        xSemaphoreGive(s_lock);
+
+        uint16_t count = ((const tsdb_seg_hdr_aq_t *)s_replay_buf)->count;
+        err = cb(s_replay_buf, len, ctx);
+        if (err != ESP_OK) break;
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        retire(seq);
+        s_st.replayed_segments++;
+        s_st.replayed_samples += count;
+        xSemaphoreGive(s_lock);
+        n++;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_replaying = false;
+    xSemaphoreGive(s_lock);
+    if (out_segments) *out_segments = n;
+    return err;
+}
+
+esp_err_t tsdb_get_stats_aq(tsdb_stats_aq_t *out) {
+    if (out == NULL) return ESP_ERR_INVALID_ARG;
+    if (s_lock == NULL) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = s_st;
+    uint16_t open = 0;
+    for (int i = 0; i < MAX_CH; i++) open += s_ch[i].slot != NO_SLOT;
+    out->segments_open = open;
+    out->segments_ram = s_fifo_count;
+    out->segments_free = s_nfree;
+    out->segments_flash = tsdb_flash_count_aq();
+    out->flash_capacity = tsdb_flash_capacity_aq();
+    out->pending_samples = s_pending_ram + tsdb_flash_pending_samples_aq();
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+}
@@ -0,0 +1,237 @@
+#include "tsdb_codec_aq.h"
+#include <math.h>
+#include <string.h>
+
+typedef struct {
+    uint64_t v;
+    uint8_t  n;
+} code_t;
+
+static uint32_t f2u(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+static float u2f(uint32_t u) {
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+// El payload se pone a cero al abrir el segmento: escribir es solo OR
+static void put_bits(uint8_t *p, uint32_t *pos, uint64_t v, uint8_t n) {
+    while (n) {
+        uint32_t off = *pos & 7;
+        uint8_t take = 8 - off < n ? 8 - off : n;
+        uint8_t chunk = (uint8_t)((v >> (n - take)) & ((1u << take) - 1));
+        p[*pos >> 3] |= (uint8_t)(chunk << (8 - off - take));
+        *pos += take;
+        n -= take;
+    }
+}
+
+static bool get_bits(const uint8_t *p, uint32_t *pos, uint32_t end, uint8_t n, uint64_t *out) {
+    if (*pos + n > end) return false;
+    uint64_t v = 0;
+    while (n) {
+        uint32_t off = *pos & 7;
+        uint8_t take = 8 - off < n ? 8 - off : n;
+        v = v << take | ((p[*pos >> 3] >> (8 - off - take)) & ((1u << take) - 1));
+        *pos += take;
+        n -= take;
+    }
+    *out = v;
+    return true;
+}
+
+// Cubos de delta-of-delta (y de delta de valores cuantizados)
+static bool bucket(int64_t d, code_t *c) {
+    if (d == 0) {
+        *c = (code_t){ 0, 1 };
+    } else if (d >= -63 && d <= 64) {
+        *c = (code_t){ 0x2ull << 7 | (uint64_t)(d + 63), 9 };
+    } else if (d >= -255 && d <= 256) {
+        *c = (code_t){ 0x6ull << 9 | (uint64_t)(d + 255), 12 };
+    } else if (d >= -2047 && d <= 2048) {
+        *c = (code_t){ 0xEull << 12 | (uint64_t)(d + 2047), 16 };
+    } else if (d >= INT32_MIN && d <= INT32_MAX) {
+        *c = (code_t){ 0xFull << 32 | (uint32_t)(int32_t)d, 36 };
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool unbucket(const uint8_t *p, uint32_t *pos, uint32_t end, int64_t *d) {
+    uint64_t b, v;
+    int prefix = 0;
+    // Hasta cuatro unos: el número de unos elige el cubo
+    while (prefix < 4) {
+        if (!get_bits(p, pos, end, 1, &b)) return false;
+        if (b == 0) break;
+        prefix++;
+    }
+    static const uint8_t width[] = { 0, 7, 9, 12, 32 };
+    static const int16_t bias[] = { 0, 63, 255, 2047, 0 };
+    if (prefix == 0) {
+        *d = 0;
+        return true;
+    }
+    if (!get_bits(p, pos, end, width[prefix], &v)) return false;
+    *d = prefix == 4 ? (int64_t)(int32_t)(uint32_t)v : (int64_t)v - bias[prefix];
+    return true;
+}
+
+bool tsdb_quantize_aq(float value, float resolution, int32_t *out) {
+    double q = round((double)value / resolution);
+    if (!(q >= INT32_MIN && q <= INT32_MAX)) return false;  // también NaN
+    *out = (int32_t)q;
+    return true;
+}
+
+size_t tsdb_seg_len_aq(const tsdb_seg_hdr_aq_t *h) {
+    return TSDB_SEG_HDR_LEN_AQ + ((size_t)h->bits + 7) / 8;
+}
+
+bool tsdb_enc_begin_aq(tsdb_enc_aq_t *e, uint8_t *seg, size_t cap, uint8_t channel, float resolution,
+                       int64_t ts_ms, float value) {
+    uint32_t v0 = f2u(value);
+    if (resolution > 0) {
+        int32_t q;
+        if (!tsdb_quantize_aq(value, resolution, &q)) return false;
+        v0 = (uint32_t)q;
+    }
+    memset(seg, 0, cap);
+    tsdb_seg_hdr_aq_t h = {
+        .magic = TSDB_SEG_MAGIC_AQ,
+        .state = 0xFE,
+        .channel = channel,
+        .t0_ms = ts_ms,
+        .count = 1,
+        .resolution = resolution,
+        .v0 = v0,
+    };
+    memcpy(seg, &h, sizeof(h));
+    *e = (tsdb_enc_aq_t){
+        .seg = seg,
+        .cap_bits = (uint32_t)(cap - TSDB_SEG_HDR_LEN_AQ) * 8,
+        .count = 1,
+        .ts = ts_ms,
+        .prev = v0,
+        .lead = 0xff,
+        .resolution = resolution,
+    };
+    // bits de la cabecera es u16
+    if (e->cap_bits > UINT16_MAX) e->cap_bits = UINT16_MAX;
+    return true;
+}
+
+bool tsdb_enc_append_aq(tsdb_enc_aq_t *e, int64_t ts_ms, float value) {
+    if (e->count == UINT16_MAX) return false;
+    int64_t delta = ts_ms - e->ts;
+    code_t ct, cv;
+    if (!bucket(delta - e->delta, &ct)) return false;
+
+    uint32_t cur;
+    uint8_t lead = e->lead, trail = e->trail;
+    if (e->resolution > 0) {
+        int32_t q;
+        if (!tsdb_quantize_aq(value, e->resolution, &q)) return false;
+        cur = (uint32_t)q;
+        if (!bucket((int64_t)q - (int32_t)e->prev, &cv)) return false;
+    } else {
+        cur = f2u(value);
+        uint32_t x = cur ^ e->prev;
+        if (x == 0) {
+            cv = (code_t){ 0, 1 };
+        } else {
+            uint8_t l = (uint8_t)__builtin_clz(x), t = (uint8_t)__builtin_ctz(x);
+            if (e->lead != 0xff && l >= e->lead && t >= e->trail) {
+                uint8_t len = 32 - e->lead - e->trail;
+                cv = (code_t){ 0x2ull << len | (x >> e->trail), (uint8_t)(2 + len) };
+            } else {
+                uint8_t len = 32 - l - t;
+                cv = (code_t){ ((0x3ull << 11 | (uint64_t)l << 6 | len) << len) | (x >> t), (uint8_t)(13 + len) };
+                lead = l;
+                trail = t;
+            }
+        }
+    }
+    if (e->bits + ct.n + cv.n > e->cap_bits) return false;
+
+    uint8_t *p = e->seg + TSDB_SEG_HDR_LEN_AQ;
+    put_bits(p, &e->bits, ct.v, ct.n);
+    put_bits(p, &e->bits, cv.v, cv.n);
+    e->delta = delta;
+    e->ts = ts_ms;
+    e->prev = cur;
+    e->lead = lead;
+    e->trail = trail;
+    e->count++;
+    return true;
+}
+
+size_t tsdb_enc_seal_aq(tsdb_enc_aq_t *e, uint32_t seq) {
+    tsdb_seg_hdr_aq_t *h = (tsdb_seg_hdr_aq_t *)e->seg;
+    h->seq = seq;
+    h->count = e->count;
+    h->bits = (uint16_t)e->bits;
+    return tsdb_seg_len_aq(h);
+}
+
+esp_err_t tsdb_reader_init_aq(tsdb_reader_aq_t *r, const uint8_t *seg, size_t len) {
+    if (r == NULL || seg == NULL || len < TSDB_SEG_HDR_LEN_AQ) return ESP_ERR_INVALID_ARG;
+    memcpy(&r->hdr, seg, sizeof(r->hdr));
+    if (r->hdr.magic != TSDB_SEG_MAGIC_AQ || r->hdr.count == 0) return ESP_ERR_INVALID_ARG;
+    if (tsdb_seg_len_aq(&r->hdr) > len) return ESP_ERR_INVALID_SIZE;
+    r->seg = seg;
+    r->pos = 0;
+    r->left = r->hdr.count;
+    r->ts = r->hdr.t0_ms;
+    r->delta = 0;
+    r->prev = r->hdr.v0;
+    r->lead = r->trail = 0;
+    return ESP_OK;
+}
+
+static float reader_value(const tsdb_reader_aq_t *r) {
+    if (r->hdr.resolution > 0) return (float)((double)(int32_t)r->prev * r->hdr.resolution);
+    return u2f(r->prev);
+}
+
+bool tsdb_reader_next_aq(tsdb_reader_aq_t *r, int64_t *ts_ms, float *value) {
+    if (r->left == 0) return false;
+    if (r->left < r->hdr.count) {
+        const uint8_t *p = r->seg + TSDB_SEG_HDR_LEN_AQ;
+        uint32_t end = r->hdr.bits;
+        int64_t dod, d;
+        if (!unbucket(p, &r->pos, end, &dod)) return false;
+        r->delta += dod;
+        r->ts += r->delta;
+        if (r->hdr.resolution > 0) {
+            if (!unbucket(p, &r->pos, end, &d)) return false;
+            r->prev += (uint32_t)d;  // módulo 2^32, como en el codificador
+        } else {
+            uint64_t b, v;
+            if (!get_bits(p, &r->pos, end, 1, &b)) return false;
+            if (b) {
+                if (!get_bits(p, &r->pos, end, 1, &b)) return false;
+                if (b) {
+                    uint64_t l, len;
+                    if (!get_bits(p, &r->pos, end, 5, &l) || !get_bits(p, &r->pos, end, 6, &len)) return false;
+                    if (len == 0 || l + len > 32) return false;
+                    r->lead = (uint8_t)l;
+                    r->trail = (uint8_t)(32 - l - len);
+                }
+                uint8_t len = 32 - r->lead - r->trail;
+                if (!get_bits(p, &r->pos, end, len, &v)) return false;
+                r->prev ^= (uint32_t)(v << r->trail);
+            }
+        }
+    }
+    *ts_ms = r->ts;
+    *value = reader_value(r);
+    r->left--;
+    return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "tsdb_aq.h"
+
+// Codificador de un segmento (un canal). C puro, sin lock: el almacén lo llama con el
+// suyo tomado y el benchmark de host lo usa directamente.
+//
+// Marca de tiempo: delta-of-delta (dod) respecto a la muestra anterior, en ms
+//   '0' dod = 0 | '10' + 7 bits | '110' + 9 bits | '1110' + 12 bits | '1111' + 32 bits
+// Valor con resolución > 0: delta del entero cuantizado con los mismos cubos.
+// Valor con resolución 0 (XOR de los bits del float, como Gorilla):
+//   '0' igual | '10' + bits significativos en la ventana anterior
+//   | '11' + 5 bits ceros iniciales + 6 bits longitud + bits significativos
+
+typedef struct {
+    uint8_t *seg;          // cabecera + payload
+    uint32_t cap_bits;     // payload disponible
+    uint32_t bits;
+    uint16_t count;
+    int64_t  ts;
+    int64_t  delta;
+    uint32_t prev;
+    uint8_t  lead, trail;  // ventana XOR; lead = 0xff sin ventana
+    float    resolution;
+} tsdb_enc_aq_t;
+
+// Abre el segmento con la primera muestra. false si el valor no se puede cuantizar.
+bool   tsdb_enc_begin_aq(tsdb_enc_aq_t *e, uint8_t *seg, size_t cap, uint8_t channel, float resolution,
+                         int64_t ts_ms, float value);
+// false si la muestra no cabe (o su dod no cabe en 32 bits): sellar y abrir otro
+bool   tsdb_enc_append_aq(tsdb_enc_aq_t *e, int64_t ts_ms, float value);
+// Escribe count, bits y seq en la cabecera; devuelve los bytes usados
+size_t tsdb_enc_seal_aq(tsdb_enc_aq_t *e, uint32_t seq);
+
+// Valor cuantizado; false si no cabe en int32
+bool   tsdb_quantize_aq(float value, float resolution, int32_t *out);
+size_t tsdb_seg_len_aq(const tsdb_seg_hdr_aq_t *h);
@@ -0,0 +1,174 @@
+#include "tsdb_flash_aq.h"
+#include <stddef.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "tsdb_codec_aq.h"
+
+static const char *TAG = "tsdb_aq";
+
+static const esp_partition_t *s_part = NULL;
+static size_t s_seg;
+static uint16_t s_slots;
+static uint16_t s_per_sector;
+static uint16_t s_head;          // siguiente hueco a escribir
+static uint16_t s_tail;          // segmento vivo más antiguo
+static uint16_t s_count;         // vivos, contiguos desde s_tail
+static uint32_t s_pending;
+static uint32_t s_max_seq;
+
+// Los segmentos no cruzan sectores: el resto de cada sector queda sin usar
+static size_t slot_off(uint16_t i) {
+    return (size_t)(i / s_per_sector) * s_part->erase_size + (size_t)(i % s_per_sector) * s_seg;
+}
+
+static uint16_t next(uint16_t i) {
+    return (uint16_t)((i + 1) % s_slots);
+}
+
+static bool read_hdr(uint16_t i, tsdb_seg_hdr_aq_t *h) {
+    return esp_partition_read(s_part, slot_off(i), h, sizeof(*h)) == ESP_OK && h->magic == TSDB_SEG_MAGIC_AQ &&
+           h->count > 0 && tsdb_seg_len_aq(h) <= s_seg;
+}
+
+static bool slot_blank(uint16_t i) {
+    tsdb_seg_hdr_aq_t h;
+    if (esp_partition_read(s_part, slot_off(i), &h, sizeof(h)) != ESP_OK) return false;
+    const uint8_t *p = (const uint8_t *)&h;
+    for (size_t k = 0; k < sizeof(h); k++) {
+        if (p[k] != 0xff) return false;
+    }
+    return true;
+}
+
+// Recupera el anillo: vivos (state 0xFE) desde el de menor seq, escritura tras el de mayor
+esp_err_t tsdb_flash_open_aq(const char *label, size_t seg_size) {
+    s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (s_part == NULL) {
+        ESP_LOGE(TAG, "No data partition '%s'", label);
+        return ESP_ERR_NOT_FOUND;
+    }
+    size_t sector = s_part->erase_size;
+    size_t sectors = s_part->size / sector;
+    // Con un solo sector cada vuelta borraría todo lo guardado
+    if (seg_size > sector || sectors < 2 || sectors * (sector / seg_size) > UINT16_MAX) {
+        ESP_LOGE(TAG, "Partition '%s' (%lu bytes) does not fit %u-byte segments", label,
+                 (unsigned long)s_part->size, (unsigned)seg_size);
+        s_part = NULL;
+        return ESP_ERR_INVALID_SIZE;
+    }
+    s_seg = seg_size;
+    s_per_sector = (uint16_t)(sector / seg_size);
+    s_slots = (uint16_t)(sectors * s_per_sector);
+    s_head = s_tail = s_count = 0;
+    s_pending = s_max_seq = 0;
+
+    bool any = false, live = false;
+    uint32_t min_live = 0;
+    uint16_t last = 0;
+    for (uint16_t i = 0; i < s_slots; i++) {
+        tsdb_seg_hdr_aq_t h;
+        if (!read_hdr(i, &h)) continue;
+        if (!any || h.seq > s_max_seq) {
+            s_max_seq = h.seq;
+            last = i;
+        }
+        any = true;
+        if (h.state != 0xFE) continue;
+        if (!live || h.seq < min_live) {
+            min_live = h.seq;
+            s_tail = i;
+        }
+        live = true;
+        s_count++;
+        s_pending += h.count;
+    }
+    if (any) s_head = next(last);
+    // Un hueco sucio a mitad de sector (apagón durante un borrado): se sigue en el siguiente
+    if (s_head % s_per_sector && !slot_blank(s_head)) {
+        s_head = (uint16_t)((s_head / s_per_sector + 1) * s_per_sector % s_slots);
+    }
+    ESP_LOGI(TAG, "Flash spill on '%s': %u segments of %u bytes, %u pending (%lu samples)", label,
+             s_slots, (unsigned)seg_size, s_count, (unsigned long)s_pending);
+    return ESP_OK;
+}
+
+bool tsdb_flash_enabled_aq(void) {
+    return s_part != NULL;
+}
+
+uint16_t tsdb_flash_count_aq(void) {
+    return s_count;
+}
+
+uint16_t tsdb_flash_capacity_aq(void) {
+    return s_part ? s_slots : 0;
+}
+
+uint32_t tsdb_flash_pending_samples_aq(void) {
+    return s_pending;
+}
+
+uint32_t tsdb_flash_max_seq_aq(void) {
+    return s_max_seq;
+}
+
+// Saca del anillo el vivo más antiguo; devuelve sus muestras
+static uint32_t drop_tail(void) {
+    tsdb_seg_hdr_aq_t h;
+    uint32_t n = read_hdr(s_tail, &h) ? h.count : 0;
+    s_tail = next(s_tail);
+    s_count--;
+    s_pending -= n < s_pending ? n : s_pending;
+    return n;
+}
+
+esp_err_t tsdb_flash_push_aq(const uint8_t *seg, size_t len, uint32_t *dropped) {
+    if (s_part == NULL) return ESP_ERR_INVALID_STATE;
+    if (len > s_seg) return ESP_ERR_INVALID_SIZE;
+    *dropped = 0;
+    if (s_head % s_per_sector == 0) {
+        // Sector nuevo: si el anillo ya dio la vuelta, sus vivos son los más antiguos
+        uint16_t first = s_head, end = (uint16_t)(s_head + s_per_sector);
+        while (s_count && s_tail >= first && s_tail < end) {
+            *dropped += drop_tail();
+        }
+        esp_err_t err = esp_partition_erase_range(s_part, slot_off(s_head), s_part->erase_size);
+        if (err != ESP_OK) return err;
+    }
+    esp_err_t err = esp_partition_write(s_part, slot_off(s_head), seg, len);
+    if (err != ESP_OK) return err;
+    tsdb_seg_hdr_aq_t h;
+    memcpy(&h, seg, sizeof(h));
+    if (s_count == 0) s_tail = s_head;
+    s_head = next(s_head);
+    s_count++;
+    s_pending += h.count;
+    s_max_seq = h.seq;
+    return ESP_OK;
+}
+
+esp_err_t tsdb_flash_peek_aq(uint8_t *out, size_t *len, uint32_t *seq) {
+    // Un hueco ilegible entre los vivos se salta en vez de bloquear el replay para siempre
+    while (s_count) {
+        tsdb_seg_hdr_aq_t h;
+        if (read_hdr(s_tail, &h) && h.state == 0xFE) {
+            size_t n = tsdb_seg_len_aq(&h);
+            esp_err_t err = esp_partition_read(s_part, slot_off(s_tail), out, n);
+            if (err != ESP_OK) return err;
+            *len = n;
+            *seq = h.seq;
+            return ESP_OK;
+        }
+        drop_tail();
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t tsdb_flash_pop_aq(void) {
+    if (s_count == 0) return ESP_ERR_NOT_FOUND;
+    uint8_t done = 0x00;
+    esp_err_t err = esp_partition_write(s_part, slot_off(s_tail) + offsetof(tsdb_seg_hdr_aq_t, state), &done, 1);
+    drop_tail();
+    return err;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Desbordamiento a flash: la partición es un anillo de huecos de tamaño de segmento.
+// Se escribe en orden; al entrar en un sector se borra y, si aún tenía segmentos vivos
+// (el anillo dio la vuelta), se pierden los más antiguos. Un segmento reenviado se marca
+// poniendo a 0 su byte state (NOR: sin borrar), así el arranque siguiente no lo repite.
+// Sin lock propio: lo llama tsdb_aq.c con el suyo tomado.
+
+esp_err_t tsdb_flash_open_aq(const char *label, size_t seg_size);
+bool      tsdb_flash_enabled_aq(void);
+uint16_t  tsdb_flash_count_aq(void);     // segmentos vivos
+uint16_t  tsdb_flash_capacity_aq(void);
+uint32_t  tsdb_flash_pending_samples_aq(void);
+uint32_t  tsdb_flash_max_seq_aq(void);   // mayor seq visto (vivo o no); 0 si ninguno
+
+// Escribe un segmento sellado de len bytes. dropped: muestras de los segmentos vivos
+// que se perdieron al borrar el sector.
+esp_err_t tsdb_flash_push_aq(const uint8_t *seg, size_t len, uint32_t *dropped);
+// Copia el más antiguo en out (seg_size bytes). ESP_ERR_NOT_FOUND si no hay.
+esp_err_t tsdb_flash_peek_aq(uint8_t *out, size_t *len, uint32_t *seq);
+// Marca el más antiguo como reenviado
+esp_err_t tsdb_flash_pop_aq(void);
@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+"""Decodifica segmentos de tsdb_aq a CSV (channel,ts_ms,value).
+
+Uso (en el MASTER):
+    python components/tsdb_aq/tools/tsdb_decode.py seg1.bin seg2.bin ...     # segmentos concatenados o sueltos
+    python components/tsdb_aq/tools/tsdb_decode.py --mqtt 192.168.7.1 --panel aq-panel-01 > backlog.csv
+
+--mqtt se suscribe a <root>/<panel>/tsdb (necesita paho-mqtt) y escribe cada segmento del
+replay según llega. Cabecera de 28 B little-endian (ver README): u16 magic = 0x5354, u8 state,
+u8 channel, u32 seq, i64 t0_ms, u16 count, u16 bits, f32 resolution, u32 v0; le siguen `bits`
+bits de muestras, MSB primero.
+"""
+import argparse
+import struct
+import sys
+
+HDR = struct.Struct('<HBBIqHHfI')
+MAGIC = 0x5354
+
+
+class Bits:
+    def __init__(self, data, nbits):
+        self.data = data
+        self.end = nbits
+        self.pos = 0
+
+    def get(self, n):
+        if self.pos + n > self.end:
+            raise ValueError('truncated segment')
+        v = 0
+        for _ in range(n):
+            v = v << 1 | (self.data[self.pos >> 3] >> (7 - (self.pos & 7))) & 1
+            self.pos += 1
+        return v
+
+
+def unbucket(b):
+    prefix = 0
+    while prefix < 4 and b.get(1):
+        prefix += 1
+    if prefix == 0:
+        return 0
+    width = (0, 7, 9, 12, 32)[prefix]
+    v = b.get(width)
+    if prefix == 4:
+        return v - (1 << 32) if v & 0x80000000 else v
+    return v - (0, 63, 255, 2047)[prefix]
+
+
+def f32(u):
+    return struct.unpack('<f', struct.pack('<I', u & 0xffffffff))[0]
+
+
+def i32(u):
+    u &= 0xffffffff
+    return u - (1 << 32) if u & 0x80000000 else u
+
+
+def decode(seg):
+    """Devuelve (cabecera, [(ts_ms, value), ...]) y los bytes consumidos."""
+    magic, state, ch, seq, t0, count, nbits, res, v0 = HDR.unpack_from(seg)
+    if magic != MAGIC or count == 0:
+        raise ValueError('not a tsdb segment')
+    size = HDR.size + (nbits + 7) // 8
+    b = Bits(seg[HDR.size:size], nbits)
+    ts, delta, prev, lead, trail = t0, 0, v0, 0, 0
+    value = (lambda p: i32(p) * res) if res > 0 else f32
+    out = [(ts, value(prev))]
+    for _ in range(count - 1):
+        delta += unbucket(b)
+        ts += delta
+        if res > 0:
+            prev = (prev + unbucket(b)) & 0xffffffff
+        elif b.get(1):
+            if b.get(1):
+                lead = b.get(5)
+                trail = 32 - lead - b.get(6)
+            prev ^= b.get(32 - lead - trail) << trail
+        out.append((ts, value(prev)))
+    return {'channel': ch, 'seq': seq, 'state': state, 'resolution': res}, out, size
+
+
+def dump(data, w=sys.stdout):
+    off = 0
+    while off + HDR.size <= len(data):
+        hdr, samples, size = decode(data[off:])
+        for ts, v in samples:
+            w.write(f"{hdr['channel']},{ts},{v:.7g}\n")
+        off += size
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('files', nargs='*')
+    ap.add_argument('--mqtt', help='broker host')
+    ap.add_argument('--port', type=int, default=1883)
+    ap.add_argument('--root', default='aq')
+    ap.add_argument('--panel', default='aq-panel-01')
+    a = ap.parse_args()
+
+    print('channel,ts_ms,value')
+    for name in a.files:
+        with open(name, 'rb') as f:
+            dump(f.read())
+    if not a.mqtt:
+        return
+
+    import paho.mqtt.client as mqtt
+    c = mqtt.Client()
+    c.on_connect = lambda c, u, f, rc: c.subscribe(f'{a.root}/{a.panel}/tsdb', qos=1)
+
+    def on_message(c, u, m):
+        try:
+            dump(m.payload)
+            sys.stdout.flush()
+        except ValueError as e:
+            print(f'bad segment: {e}', file=sys.stderr)
+
+    c.on_message = on_message
+    c.connect(a.mqtt, a.port)
+    c.loop_forever()
+
+
+if __name__ == '__main__':
+    main()
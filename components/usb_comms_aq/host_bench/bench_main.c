@@ -0,0 +1,320 @@
+// Benchmark de host (Linux) del detector de liveness de usb_comms_aq.
+//
+// Compila el núcleo real (usb_liveness_core_aq.c) contra un MASTER simulado:
+//
+// 1. Simulación en tiempo virtual (ms). Cada prueba monta, levanta el enlace, recibe
+//    heartbeats cada P ms con jitter y, en un instante aleatorio, falla de una de tres
+//    formas: el MASTER deja de enviar heartbeats (broker muerto o pila colgada), se
+//    desmonta el USB o cae el enlace NCM. Los eventos llegan con retardo aleatorio del
+//    bucle de eventos y una fracción se pierde (solo los recoge la comprobación
+//    periódica leyendo el estado de montaje). El timer de comprobación también tiene
+//    jitter. Se mide la latencia real (detección - fallo) y la registrada por el núcleo,
+//    y se cuentan falsos positivos mientras el MASTER está vivo.
+// 2. Estrés con hilos: heartbeats, caídas de enlace y dos evaluadores concurrentes
+//    (timer y bucle de eventos). Cada transición debe publicarse una sola vez.
+// 3. Coste de live_core_eval_aq.
+// -C ejecuta 1 y 2 sin la medida de coste: es lo que ejecuta ctest.
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "sdkconfig.h"
+#include "usb_liveness_core_aq.h"
+
+#define BOUND_MS   CONFIG_AQ_LIVENESS_BOUND_MS
+#define TIMEOUT_MS CONFIG_AQ_LIVENESS_HB_TIMEOUT_MS
+#define CHECK_MS   CONFIG_AQ_LIVENESS_CHECK_MS
+
+enum { FAIL_HEARTBEAT, FAIL_UNMOUNT, FAIL_LINK, FAIL_KINDS };
+static const char *const s_fail_names[FAIL_KINDS] = { "heartbeat", "unmount", "link" };
+
+typedef struct {
+    uint32_t hb_period_ms;
+    uint32_t hb_jitter_ms;     // ± sobre el periodo
+    uint32_t check_jitter_ms;  // retraso extra del timer de comprobación
+    uint32_t event_delay_ms;   // retraso máximo del bucle de eventos
+    uint32_t drop_pct;         // eventos de desmontaje perdidos
+} sim_cfg_t;
+
+typedef struct {
+    uint32_t trials;
+    uint32_t max_true_ms;
+    uint32_t max_recorded_ms;
+    uint64_t sum_true_ms;
+    uint32_t over_bound;
+    uint32_t missed;
+    uint32_t wrong_cause;
+} fail_result_t;
+
+static uint32_t s_false_positives;
+static uint32_t s_no_exit;
+static uint32_t s_hist[8];  // latencia real en tramos de 500 ms
+
+static uint32_t rnd(uint32_t n) {
+    return n ? (uint32_t)(rand() % n) : 0;
+}
+
+// Una prueba: MASTER sano hasta t_fail, luego falla de la forma indicada
+static void run_trial(const sim_cfg_t *cfg, int kind, fail_result_t *res) {
+    live_core_aq_t core;
+    live_core_aq_t *c = &core;
+    uint32_t base = 1000 + rnd(1u << 20);  // reloj arbitrario, a veces cerca de la vuelta
+    if (rnd(4) == 0) base = UINT32_MAX - 3000 - rnd(3000);
+    live_core_init_aq(c, TIMEOUT_MS, true, base);
+
+    uint32_t t_fail = 4000 + rnd(cfg->hb_period_ms * 2);
+    uint32_t t_end = t_fail + BOUND_MS * 2;
+    uint32_t next_hb = 100;
+    uint32_t next_check = CHECK_MS + rnd(cfg->check_jitter_ms);
+    uint32_t evt_at = UINT32_MAX;         // entrega del evento de pérdida
+    bool evt_dropped = kind == FAIL_UNMOUNT && rnd(100) < cfg->drop_pct;
+    bool netif_mounted = false;            // lo que vería usb_netif_is_link_up_aq()
+    bool exited = false;
+    uint32_t detected = 0;
+    uint8_t cause = 0;
+    uint32_t lat = 0;
+
+    for (uint32_t t = 0; t < t_end; t++) {
+        uint32_t now = base + t;
+        bool eval = false;
+        if (t == 10) {
+            netif_mounted = true;
+            live_core_set_mounted_aq(c, true, now);
+            eval = true;
+        }
+        if (t == 60) {
+            live_core_set_link_aq(c, true, now);
+            eval = true;
+        }
+        if (t == t_fail) {
+            if (kind == FAIL_UNMOUNT) netif_mounted = false;
+            if (kind != FAIL_HEARTBEAT && !evt_dropped) evt_at = t + rnd(cfg->event_delay_ms + 1);
+        }
+        if (t == next_hb) {
+            // El MASTER deja de hablar con cualquier fallo (sin USB no llega nada)
+            if (t < t_fail) live_core_heartbeat_aq(c, now);
+            int32_t j = (int32_t)rnd(cfg->hb_jitter_ms * 2 + 1) - (int32_t)cfg->hb_jitter_ms;
+            next_hb = t + (uint32_t)((int32_t)cfg->hb_period_ms + j);
+        }
+        if (t == evt_at) {
+            // usb_link_aq pone en el evento el instante en que procesó el desmontaje
+            uint32_t at = base + t_fail;
+            if (kind == FAIL_UNMOUNT) live_core_set_mounted_aq(c, false, at);
+            else live_core_set_link_aq(c, false, at);
+            eval = true;
+        }
+        if (t == next_check) {
+            if ((live_core_state_aq(c) & LIVE_BIT_MOUNTED) && !netif_mounted) {
+                live_core_set_mounted_aq(c, false, now);
+            }
+            next_check = t + CHECK_MS + rnd(cfg->check_jitter_ms);
+            eval = true;
+        }
+        if (!eval) continue;
+
+        uint8_t why;
+        uint32_t l;
+        live_transition_aq_t tr = live_core_eval_aq(c, now, &why, &l);
+        if (tr == LIVE_EXIT_SAFE) {
+            exited = true;
+        } else if (tr == LIVE_ENTER_SAFE) {
+            if (t < t_fail) {
+                s_false_positives++;
+            } else if (!detected) {
+                detected = t;
+                cause = why;
+                lat = l;
+                break;
+            }
+        }
+    }
+
+    res->trials++;
+    if (!exited) s_no_exit++;
+    if (!detected) {
+        res->missed++;
+        return;
+    }
+    uint32_t true_ms = detected - t_fail;
+    static const uint8_t expected[FAIL_KINDS] = { LIVE_CAUSE_HEARTBEAT, LIVE_CAUSE_UNMOUNT, LIVE_CAUSE_LINK_DOWN };
+    if (cause != expected[kind]) res->wrong_cause++;
+    if (true_ms >= BOUND_MS) res->over_bound++;
+    if (true_ms > res->max_true_ms) res->max_true_ms = true_ms;
+    if (lat > res->max_recorded_ms) res->max_recorded_ms = lat;
+    res->sum_true_ms += true_ms;
+    s_hist[true_ms / 500 < 7 ? true_ms / 500 : 7]++;
+}
+
+// --- Estrés concurrente ---
+
+static live_core_aq_t s_core;
+static volatile int s_stop;
+static _Atomic uint32_t s_enters, s_exits;
+
+static uint32_t wall_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void *evaluator(void *arg) {
+    while (!s_stop) {
+        uint8_t why;
+        uint32_t l;
+        live_transition_aq_t tr = live_core_eval_aq(&s_core, wall_ms(), &why, &l);
+        if (tr == LIVE_ENTER_SAFE) atomic_fetch_add(&s_enters, 1);
+        if (tr == LIVE_EXIT_SAFE) atomic_fetch_add(&s_exits, 1);
+    }
+    return NULL;
+}
+
+static void *feeder(void *arg) {
+    while (!s_stop) {
+        live_core_heartbeat_aq(&s_core, wall_ms());
+        usleep(100);
+    }
+    return NULL;
+}
+
+static void *flapper(void *arg) {
+    unsigned seed = 7;
+    while (!s_stop) {
+        live_core_set_link_aq(&s_core, false, wall_ms());
+        usleep(rand_r(&seed) % 200);
+        live_core_set_link_aq(&s_core, true, wall_ms());
+        usleep(rand_r(&seed) % 200);
+    }
+    return NULL;
+}
+
+static int run_stress(uint32_t seconds) {
+    live_core_init_aq(&s_core, TIMEOUT_MS, true, wall_ms());
+    live_core_set_mounted_aq(&s_core, true, wall_ms());
+    live_core_set_link_aq(&s_core, true, wall_ms());
+    live_core_heartbeat_aq(&s_core, wall_ms());
+
+    pthread_t th[4];
+    pthread_create(&th[0], NULL, evaluator, NULL);
+    pthread_create(&th[1], NULL, evaluator, NULL);
+    pthread_create(&th[2], NULL, feeder, NULL);
+    pthread_create(&th[3], NULL, flapper, NULL);
+    sleep(seconds);
+    s_stop = 1;
+    for (int i = 0; i < 4; i++) pthread_join(th[i], NULL);
+
+    // Tras el último cambio del flapper (enlace arriba) una evaluación final fija el estado
+    uint8_t why;
+    uint32_t l;
+    live_transition_aq_t tr = live_core_eval_aq(&s_core, wall_ms(), &why, &l);
+    if (tr == LIVE_ENTER_SAFE) s_enters++;
+    if (tr == LIVE_EXIT_SAFE) s_exits++;
+
+    // Se arranca en SAFE MODE: las transiciones alternan EXIT, ENTER, EXIT...
+    bool safe = live_core_state_aq(&s_core) & LIVE_BIT_SAFE;
+    uint32_t enters = s_enters, exits = s_exits;
+    bool ok = safe ? exits == enters : exits == enters + 1;
+    printf("RESULT stress_s=%u enters=%u exits=%u final_safe=%d consistent=%s\n",
+           seconds, enters, exits, safe, ok ? "yes" : "NO");
+    return ok ? 0 : 1;
+}
+
+static void run_eval_cost(void) {
+    live_core_aq_t c;
+    live_core_init_aq(&c, TIMEOUT_MS, true, 0);
+    live_core_set_mounted_aq(&c, true, 0);
+    live_core_set_link_aq(&c, true, 0);
+    const uint32_t n = 10000000;
+    volatile uint32_t sink = 0;
+    int64_t t0 = now_ns();
+    for (uint32_t i = 0; i < n; i++) {
+        uint8_t why;
+        uint32_t l;
+        live_core_heartbeat_aq(&c, i / 1000);
+        sink += live_core_eval_aq(&c, i / 1000, &why, &l);
+    }
+    double per = (double)(now_ns() - t0) / n;
+    printf("RESULT heartbeat_plus_eval_ns=%.1f\n", per);
+    (void)sink;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-n trials] [-p hb_period_ms] [-j hb_jitter_ms] [-c check_jitter_ms]\n"
+                    "          [-e event_delay_ms] [-d drop_pct] [-s stress_seconds] [-C]\n"
+                    "  -C only the simulation and the stress run, without the cost measurement (ctest)\n", prog);
+}
+
+int main(int argc, char **argv) {
+    sim_cfg_t cfg = {
+        .hb_period_ms = 500,
+        .hb_jitter_ms = 100,
+        .check_jitter_ms = 20,
+        .event_delay_ms = 50,
+        .drop_pct = 10,
+    };
+    uint32_t trials = 20000;
+    uint32_t stress_s = 2;
+    bool check_only = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:p:j:c:e:d:s:Ch")) != -1) {
+        switch (opt) {
+        case 'n': trials = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'p': cfg.hb_period_ms = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'j': cfg.hb_jitter_ms = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'c': cfg.check_jitter_ms = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'e': cfg.event_delay_ms = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'd': cfg.drop_pct = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 's': stress_s = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'C': check_only = true; break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (trials == 0 || cfg.hb_period_ms == 0 || cfg.hb_jitter_ms >= cfg.hb_period_ms) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    printf("bound %d ms, heartbeat timeout %d ms, check %d ms (+%u jitter), MASTER every %u±%u ms\n",
+           BOUND_MS, TIMEOUT_MS, CHECK_MS, cfg.check_jitter_ms, cfg.hb_period_ms, cfg.hb_jitter_ms);
+
+    srand(1);
+    fail_result_t res[FAIL_KINDS] = { 0 };
+    for (uint32_t i = 0; i < trials; i++) {
+        int kind = (int)(i % FAIL_KINDS);
+        run_trial(&cfg, kind, &res[kind]);
+    }
+
+    int failures = 0;
+    for (int k = 0; k < FAIL_KINDS; k++) {
+        fail_result_t *r = &res[k];
+        uint32_t det = r->trials - r->missed;
+        printf("RESULT fail=%s trials=%u mean_ms=%.0f max_ms=%u max_recorded_ms=%u over_bound=%u "
+               "missed=%u wrong_cause=%u\n",
+               s_fail_names[k], r->trials, det ? (double)r->sum_true_ms / det : 0.0, r->max_true_ms,
+               r->max_recorded_ms, r->over_bound, r->missed, r->wrong_cause);
+        failures += r->over_bound + r->missed + r->wrong_cause;
+    }
+    printf("latency histogram (500 ms buckets):");
+    for (int i = 0; i < 8; i++) printf(" %u", s_hist[i]);
+    printf("\nRESULT false_positives=%u no_exit=%u\n", s_false_positives, s_no_exit);
+    failures += s_false_positives + s_no_exit;
+
+    failures += run_stress(stress_s);
+    if (!check_only) run_eval_cost();
+
+    if (failures) {
+        printf("FAILED: %d\n", failures);
+        return 1;
+    }
+    printf("OK: every transition under %d ms\n", BOUND_MS);
+    return 0;
+}
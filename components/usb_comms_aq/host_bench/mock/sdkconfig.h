@@ -0,0 +1,6 @@
+#pragma once
+// Valores por defecto del Kconfig de usb_comms_aq
+#define CONFIG_AQ_LIVENESS_BOUND_MS 3000
+#define CONFIG_AQ_LIVENESS_REQUIRE_MASTER_HB 1
+#define CONFIG_AQ_LIVENESS_HB_TIMEOUT_MS 2000
+#define CONFIG_AQ_LIVENESS_CHECK_MS 100
@@ -1,9 +1,63 @@
 #pragma once
 #include "esp_netif.h"
 #include "esp_err.h"
+#include "esp_event.h"
 #include "freertos/FreeRTOS.h"
 #include <stdbool.h>
+#include <stdint.h>
 
 esp_err_t usb_comms_init_aq(void);
 esp_err_t usb_comms_wait_link_aq(TickType_t timeout, esp_ip4_addr_t *out_ip);
 esp_err_t usb_comms_stop_aq(void);
+
+// --- Liveness del MASTER / SAFE MODE ---
+// Combina montaje USB, enlace NCM (USB_NET_UP/DOWN) y el heartbeat de aplicación del
+// MASTER. Arranca en SAFE MODE y sale cuando las tres señales están bien. La entrada
+// está acotada a CONFIG_AQ_LIVENESS_BOUND_MS (comprobado en compilación).
+ESP_EVENT_DECLARE_BASE(USB_COMMS_EVENTS);
+
+typedef enum {
+    USB_COMMS_SAFE_MODE_ENTER,   // datos: usb_comms_safe_mode_aq_t
+    USB_COMMS_SAFE_MODE_EXIT,    // datos: usb_comms_safe_mode_aq_t
+} usb_comms_event_aq_t;
+
+typedef enum {
+    USB_COMMS_CAUSE_BOOT = 0,    // aún no se ha visto al MASTER
+    USB_COMMS_CAUSE_UNMOUNT,
+    USB_COMMS_CAUSE_LINK_DOWN,
+    USB_COMMS_CAUSE_HEARTBEAT,   // montado y con enlace, pero el MASTER no responde
+    USB_COMMS_CAUSE_COUNT,
+} usb_comms_safe_cause_aq_t;
+
+typedef struct {
+    usb_comms_safe_cause_aq_t cause;  // en EXIT, la causa con la que se entró
+    uint32_t latency_ms;              // ENTER: detección desde la pérdida; EXIT: tiempo en SAFE MODE
+} usb_comms_safe_mode_aq_t;
+
+// Instantánea coherente (una sola carga atómica), válida desde cualquier núcleo
+typedef struct {
+    bool mounted;
+    bool link_up;
+    bool master_alive;
+    bool safe_mode;
+    usb_comms_safe_cause_aq_t cause;
+} usb_comms_liveness_aq_t;
+
+typedef struct {
+    uint32_t entries;
+    uint32_t exits;
+    uint32_t by_cause[USB_COMMS_CAUSE_COUNT];
+    uint32_t last_detect_ms;
+    uint32_t max_detect_ms;
+    uint32_t bound_violations;    // detecciones por encima de CONFIG_AQ_LIVENESS_BOUND_MS
+    uint32_t heartbeats;
+} usb_comms_liveness_stats_aq_t;
+
+// Requiere el bucle de eventos por defecto. Llamar antes de usb_comms_init_aq para no
+// perder el primer USB_NET_MOUNTED.
+esp_err_t usb_comms_liveness_start_aq(void);
+// Heartbeat de aplicación recibido del MASTER. Sin bloqueo; cualquier tarea.
+void      usb_comms_master_heartbeat_aq(void);
+bool      usb_comms_in_safe_mode_aq(void);
+void      usb_comms_get_liveness_aq(usb_comms_liveness_aq_t *out);
+void      usb_comms_get_liveness_stats_aq(usb_comms_liveness_stats_aq_t *out);
@@ -0,0 +1,149 @@
+#include "usb_comms_aq.h"
+#include "usb_netif_aq.h"
+#include "usb_liveness_core_aq.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "usb_liveness_aq";
+
+ESP_EVENT_DEFINE_BASE(USB_COMMS_EVENTS);
+
+#if CONFIG_AQ_LIVENESS_REQUIRE_MASTER_HB
+#define LIVE_REQUIRE_MASTER true
+#define LIVE_HB_TIMEOUT_MS  CONFIG_AQ_LIVENESS_HB_TIMEOUT_MS
+#else
+#define LIVE_REQUIRE_MASTER false
+#define LIVE_HB_TIMEOUT_MS  0
+#endif
+
+// Peor caso de detección: silencio del heartbeat + un periodo de comprobación. Las
+// pérdidas de montaje/enlace entran al procesar el evento (o, si la cola se pierde,
+// en la siguiente comprobación, que lee el estado de montaje atómico del driver).
+#if LIVE_HB_TIMEOUT_MS + CONFIG_AQ_LIVENESS_CHECK_MS >= CONFIG_AQ_LIVENESS_BOUND_MS
+#error "AQ_LIVENESS_HB_TIMEOUT_MS + AQ_LIVENESS_CHECK_MS must stay below AQ_LIVENESS_BOUND_MS"
+#endif
+
+_Static_assert((int)LIVE_CAUSE_UNMOUNT == (int)USB_COMMS_CAUSE_UNMOUNT &&
+               (int)LIVE_CAUSE_LINK_DOWN == (int)USB_COMMS_CAUSE_LINK_DOWN &&
+               (int)LIVE_CAUSE_HEARTBEAT == (int)USB_COMMS_CAUSE_HEARTBEAT, "cause mismatch");
+
+static live_core_aq_t s_core;
+static esp_timer_handle_t s_check_timer;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static usb_comms_liveness_stats_aq_t s_stats;
+
+static const char *const s_cause_names[USB_COMMS_CAUSE_COUNT] = {
+    "boot", "unmount", "link down", "heartbeat",
+};
+
+static inline uint32_t now_ms(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void evaluate(void) {
+    uint8_t cause;
+    uint32_t latency_ms;
+    live_transition_aq_t tr = live_core_eval_aq(&s_core, now_ms(), &cause, &latency_ms);
+    if (tr == LIVE_NO_CHANGE) return;
+
+    usb_comms_safe_mode_aq_t data = { .cause = cause, .latency_ms = latency_ms };
+    if (tr == LIVE_ENTER_SAFE) {
+        bool violated = latency_ms >= CONFIG_AQ_LIVENESS_BOUND_MS;
+        taskENTER_CRITICAL(&s_stats_lock);
+        s_stats.entries++;
+        s_stats.by_cause[cause]++;
+        s_stats.last_detect_ms = latency_ms;
+        if (latency_ms > s_stats.max_detect_ms) s_stats.max_detect_ms = latency_ms;
+        if (violated) s_stats.bound_violations++;
+        taskEXIT_CRITICAL(&s_stats_lock);
+        if (violated) {
+            ESP_LOGE(TAG, "SAFE MODE (%s) detected in %lu ms, over the %d ms bound",
+                     s_cause_names[cause], (unsigned long)latency_ms, CONFIG_AQ_LIVENESS_BOUND_MS);
+        } else {
+            ESP_LOGW(TAG, "SAFE MODE (%s) detected in %lu ms", s_cause_names[cause], (unsigned long)latency_ms);
+        }
+        esp_event_post(USB_COMMS_EVENTS, USB_COMMS_SAFE_MODE_ENTER, &data, sizeof(data), 0);
+    } else {
+        taskENTER_CRITICAL(&s_stats_lock);
+        s_stats.exits++;
+        taskEXIT_CRITICAL(&s_stats_lock);
+        ESP_LOGI(TAG, "MASTER alive, leaving SAFE MODE after %lu ms (%s)",
+                 (unsigned long)latency_ms, s_cause_names[cause]);
+        esp_event_post(USB_COMMS_EVENTS, USB_COMMS_SAFE_MODE_EXIT, &data, sizeof(data), 0);
+    }
+}
+
+static void on_usb_net(void *arg, esp_event_base_t base, int32_t id, void *event_data) {
+    uint32_t at_ms = now_ms();
+    if ((id == USB_NET_UNMOUNTED || id == USB_NET_DOWN) && event_data) {
+        at_ms = (uint32_t)(((const usb_net_down_data_aq_t *)event_data)->at_us / 1000);
+    }
+    switch (id) {
+    case USB_NET_MOUNTED:   live_core_set_mounted_aq(&s_core, true, at_ms); break;
+    case USB_NET_UNMOUNTED: live_core_set_mounted_aq(&s_core, false, at_ms); break;
+    case USB_NET_UP:        live_core_set_link_aq(&s_core, true, at_ms); break;
+    case USB_NET_DOWN:      live_core_set_link_aq(&s_core, false, at_ms); break;
+    default: return;
+    }
+    evaluate();
+}
+
+static void check_cb(void *arg) {
+    // Red de seguridad por si el bus de eventos descartó un UNMOUNTED
+    if ((live_core_state_aq(&s_core) & LIVE_BIT_MOUNTED) && !usb_netif_is_link_up_aq()) {
+        live_core_set_mounted_aq(&s_core, false, now_ms());
+    }
+    evaluate();
+}
+
+esp_err_t usb_comms_liveness_start_aq(void) {
+    if (s_check_timer) return ESP_ERR_INVALID_STATE;
+    live_core_init_aq(&s_core, LIVE_HB_TIMEOUT_MS, LIVE_REQUIRE_MASTER, now_ms());
+
+    esp_err_t err = esp_event_handler_register(USB_NET_EVENTS, ESP_EVENT_ANY_ID, on_usb_net, NULL);
+    if (err != ESP_OK) return err;
+
+    const esp_timer_create_args_t args = {
+        .callback = check_cb,
+        .name = "usb_liveness",
+    };
+    err = esp_timer_create(&args, &s_check_timer);
+    if (err == ESP_OK) {
+        err = esp_timer_start_periodic(s_check_timer, (uint64_t)CONFIG_AQ_LIVENESS_CHECK_MS * 1000);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot start liveness timer: %s", esp_err_to_name(err));
+        esp_event_handler_unregister(USB_NET_EVENTS, ESP_EVENT_ANY_ID, on_usb_net);
+        return err;
+    }
+    ESP_LOGI(TAG, "Liveness started (heartbeat timeout %d ms, check %d ms, bound %d ms)",
+             LIVE_HB_TIMEOUT_MS, CONFIG_AQ_LIVENESS_CHECK_MS, CONFIG_AQ_LIVENESS_BOUND_MS);
+    return ESP_OK;
+}
+
+void usb_comms_master_heartbeat_aq(void) {
+    live_core_heartbeat_aq(&s_core, now_ms());
+    taskENTER_CRITICAL(&s_stats_lock);
+    s_stats.heartbeats++;
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
+
+bool usb_comms_in_safe_mode_aq(void) {
+    return (live_core_state_aq(&s_core) & LIVE_BIT_SAFE) != 0;
+}
+
+void usb_comms_get_liveness_aq(usb_comms_liveness_aq_t *out) {
+    uint32_t s = live_core_state_aq(&s_core);
+    out->mounted = s & LIVE_BIT_MOUNTED;
+    out->link_up = s & LIVE_BIT_LINK;
+    out->master_alive = s & LIVE_BIT_MASTER;
+    out->safe_mode = s & LIVE_BIT_SAFE;
+    out->cause = (usb_comms_safe_cause_aq_t)((s & LIVE_CAUSE_MASK) >> LIVE_CAUSE_SHIFT);
+}
+
+void usb_comms_get_liveness_stats_aq(usb_comms_liveness_stats_aq_t *out) {
+    taskENTER_CRITICAL(&s_stats_lock);
+    *out = s_stats;
+    taskEXIT_CRITICAL(&s_stats_lock);
+}
@@ -0,0 +1,102 @@
+#include "usb_liveness_core_aq.h"
+
+// Los tiempos son ms de 32 bits (esp_timer / 1000): las restas sin signo siguen siendo
+// correctas al dar la vuelta (~49 días) y en Xtensa son atómicos sin libatomic.
+
+void live_core_init_aq(live_core_aq_t *c, uint32_t hb_timeout_ms, bool require_master, uint32_t now_ms) {
+    c->hb_timeout_ms = hb_timeout_ms;
+    c->require_master = require_master;
+    atomic_store(&c->last_hb_ms, 0);
+    atomic_store(&c->hb_seen, 0);
+    atomic_store(&c->lost_ms, now_ms);
+    atomic_store(&c->safe_since_ms, now_ms);
+    atomic_store(&c->state, LIVE_BIT_SAFE | ((uint32_t)LIVE_CAUSE_BOOT << LIVE_CAUSE_SHIFT));
+}
+
+static void mark_lost(live_core_aq_t *c, uint32_t bit, uint32_t at_ms) {
+    uint32_t old = atomic_fetch_and_explicit(&c->state, ~bit, memory_order_acq_rel);
+    if ((old & bit) && !(old & LIVE_BIT_SAFE)) {
+        // Solo la primera pérdida cuenta (DOWN y UNMOUNT llegan con el mismo instante)
+        uint32_t seen_mask = LIVE_BIT_MOUNTED | LIVE_BIT_LINK;
+        if ((old & seen_mask) == seen_mask) {
+            atomic_store_explicit(&c->lost_ms, at_ms, memory_order_release);
+        }
+    }
+}
+
+void live_core_set_mounted_aq(live_core_aq_t *c, bool mounted, uint32_t at_ms) {
+    if (mounted) {
+        // Heartbeats anteriores al montaje no demuestran nada del MASTER actual
+        atomic_store_explicit(&c->hb_seen, 0, memory_order_relaxed);
+        atomic_fetch_or_explicit(&c->state, LIVE_BIT_MOUNTED, memory_order_acq_rel);
+    } else {
+        mark_lost(c, LIVE_BIT_MOUNTED, at_ms);
+    }
+}
+
+void live_core_set_link_aq(live_core_aq_t *c, bool up, uint32_t at_ms) {
+    if (up) {
+        atomic_fetch_or_explicit(&c->state, LIVE_BIT_LINK, memory_order_acq_rel);
+    } else {
+        mark_lost(c, LIVE_BIT_LINK, at_ms);
+    }
+}
+
+void live_core_heartbeat_aq(live_core_aq_t *c, uint32_t now_ms) {
+    atomic_store_explicit(&c->last_hb_ms, now_ms, memory_order_release);
+    atomic_fetch_add_explicit(&c->hb_seen, 1, memory_order_release);
+}
+
+live_transition_aq_t live_core_eval_aq(live_core_aq_t *c, uint32_t now_ms,
+                                       uint8_t *cause, uint32_t *latency_ms) {
+    uint32_t s = atomic_load_explicit(&c->state, memory_order_acquire);
+    for (;;) {
+        uint32_t last_hb = atomic_load_explicit(&c->last_hb_ms, memory_order_acquire);
+        // Con signo: un heartbeat apuntado en otro núcleo puede ir unos µs por delante de now
+        bool master = !c->require_master ||
+                      (atomic_load_explicit(&c->hb_seen, memory_order_acquire) != 0 &&
+                       (int32_t)(now_ms - last_hb) <= (int32_t)c->hb_timeout_ms);
+
+        uint8_t why;
+        if (!(s & LIVE_BIT_MOUNTED)) {
+            why = LIVE_CAUSE_UNMOUNT;
+        } else if (!(s & LIVE_BIT_LINK)) {
+            why = LIVE_CAUSE_LINK_DOWN;
+        } else if (!master) {
+            why = LIVE_CAUSE_HEARTBEAT;
+        } else {
+            why = LIVE_CAUSE_BOOT;  // sin fallo
+        }
+        bool fail = why != LIVE_CAUSE_BOOT;
+
+        uint32_t n = (s & (LIVE_BIT_MOUNTED | LIVE_BIT_LINK)) | (master ? LIVE_BIT_MASTER : 0);
+        if (fail) {
+            // Ya en SAFE MODE se conserva la causa de entrada
+            n |= LIVE_BIT_SAFE | ((s & LIVE_BIT_SAFE) ? (s & LIVE_CAUSE_MASK)
+                                                       : ((uint32_t)why << LIVE_CAUSE_SHIFT));
+        }
+        if (n == s) return LIVE_NO_CHANGE;
+        if (!atomic_compare_exchange_weak_explicit(&c->state, &s, n, memory_order_acq_rel,
+                                                   memory_order_acquire)) {
+            continue;  // otro contexto cambió el estado: recalcular con el nuevo
+        }
+
+        if (fail && !(s & LIVE_BIT_SAFE)) {
+            uint32_t since = why == LIVE_CAUSE_HEARTBEAT
+                                 ? last_hb
+                                 : atomic_load_explicit(&c->lost_ms, memory_order_acquire);
+            int32_t lat = (int32_t)(now_ms - since);
+            if (lat < 0) lat = 0;  // mismo caso: instante de pérdida apuntado algo por delante
+            atomic_store_explicit(&c->safe_since_ms, now_ms, memory_order_release);
+            *cause = why;
+            *latency_ms = (uint32_t)lat;
+            return LIVE_ENTER_SAFE;
+        }
+        if (!fail && (s & LIVE_BIT_SAFE)) {
+            *cause = (uint8_t)((s & LIVE_CAUSE_MASK) >> LIVE_CAUSE_SHIFT);
+            *latency_ms = now_ms - atomic_load_explicit(&c->safe_since_ms, memory_order_acquire);
+            return LIVE_EXIT_SAFE;
+        }
+        return LIVE_NO_CHANGE;  // solo cambió un bit informativo
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Núcleo del detector de vida del MASTER, sin dependencias de IDF (se prueba en host).
+// Combina tres señales: montaje USB, enlace NCM (IP) y heartbeat de aplicación.
+//
+// Todo el estado visible cabe en una palabra atómica, así que cualquier núcleo lo lee
+// con una sola carga. Los setters y el heartbeat son stores/RMW atómicos y pueden
+// llamarse desde cualquier tarea; live_core_eval_aq puede correr en varios contextos
+// a la vez (timer y bucle de eventos): la transición la publica quien gana el CAS.
+
+#define LIVE_BIT_MOUNTED   (1u << 0)
+#define LIVE_BIT_LINK      (1u << 1)
+#define LIVE_BIT_MASTER    (1u << 2)
+#define LIVE_BIT_SAFE      (1u << 3)
+#define LIVE_CAUSE_SHIFT   8
+#define LIVE_CAUSE_MASK    (0xffu << LIVE_CAUSE_SHIFT)
+
+// Mismos valores que usb_comms_safe_cause_aq_t
+enum {
+    LIVE_CAUSE_BOOT = 0,
+    LIVE_CAUSE_UNMOUNT,
+    LIVE_CAUSE_LINK_DOWN,
+    LIVE_CAUSE_HEARTBEAT,
+};
+
+typedef enum {
+    LIVE_NO_CHANGE = 0,
+    LIVE_ENTER_SAFE,
+    LIVE_EXIT_SAFE,
+} live_transition_aq_t;
+
+typedef struct {
+    _Atomic uint32_t state;       // LIVE_BIT_* | causa << LIVE_CAUSE_SHIFT
+    _Atomic uint32_t last_hb_ms;
+    _Atomic uint32_t hb_seen;     // heartbeats desde el último montaje
+    _Atomic uint32_t lost_ms;     // primera evidencia de pérdida de montaje/enlace
+    _Atomic uint32_t safe_since_ms;
+    uint32_t hb_timeout_ms;
+    bool require_master;
+} live_core_aq_t;
+
+// Arranca en SAFE MODE (causa BOOT) hasta que las tres señales estén bien.
+void live_core_init_aq(live_core_aq_t *c, uint32_t hb_timeout_ms, bool require_master, uint32_t now_ms);
+void live_core_set_mounted_aq(live_core_aq_t *c, bool mounted, uint32_t at_ms);
+void live_core_set_link_aq(live_core_aq_t *c, bool up, uint32_t at_ms);
+void live_core_heartbeat_aq(live_core_aq_t *c, uint32_t now_ms);
+
+// Recalcula el estado. En ENTER, *cause y *latency_ms (desde la primera evidencia de la
+// pérdida: desmontaje, caída del enlace o último heartbeat). En EXIT, *latency_ms es el
+// tiempo pasado en SAFE MODE.
+live_transition_aq_t live_core_eval_aq(live_core_aq_t *c, uint32_t now_ms,
+                                       uint8_t *cause, uint32_t *latency_ms);
+
+static inline uint32_t live_core_state_aq(live_core_aq_t *c) {
+    return atomic_load_explicit(&c->state, memory_order_acquire);
+}
@@ -0,0 +1,1897 @@
+// Benchmark de host (Linux) de la ruta de datos de usb_netif_aq.
+//
+// Compila las etapas RX/TX reales del componente (pool RX, colas, clasificador,
+// política de agregación, estadísticas) sobre la capa simulada de mock/, y hace de
+// TinyUSB y de lwIP en los extremos:
+//   RX: generador -> NTB -> decoder -> usb_rx_input_aq -> usb_rx_task -> esp_netif_receive
+//   TX: generador -> usb_tx_enqueue_aq -> usb_tx_task -> tinyusb_net_send_sync -> NTB
+// Cada trama lleva su marca de tiempo, así la latencia medida es extremo a extremo.
+// -m stream compara el canal vendor (usb_vchan_aq) con MQTT sobre TCP en el mismo enlace.
+// -x full|trust_rx|min añade en los extremos "lwIP" el trabajo de checksums de cada perfil
+// de usb_netif_csum_profile_aq_t: verificar al recibir, generar UDP e IP al enviar.
+// -m perf ejecuta el protocolo del servicio de medida (usb_perf_proto_aq) detrás de sockets
+// UDP de loopback: el hilo "panel" hace de sumidero iperf 2 y de eco, el principal de MASTER.
+// -m filter mide el filtro RX (usb_rx_filter_aq): coste por trama, cambios de reglas en
+// caliente y el callback completo ante ráfagas de multicast del host, con y sin filtro.
+// -m flow simula una transferencia TCP del MASTER con el consumidor a tirones y compara el
+// goodput descartando con el anillo RX lleno y con control de flujo (NAK al host).
+// -m task modela la tarea usb_device con sondeo de 1 ms y con espera de eventos: latencia
+// de ida y vuelta de un ping y despertares/CPU en reposo.
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "mock_aq.h"
+#include "mqtt_codec_aq.h"
+#include "ncm_ntb_aq.h"
+#include "usb_dlog_aq.h"
+#include "usb_mem_aq.h"
+#include "usb_netif_aq.h"
+#include "usb_perf_proto_aq.h"
+#include "usb_rx_aq.h"
+#include "usb_rx_filter_aq.h"
+#include "usb_stats_aq.h"
+#include "usb_tx_aq.h"
+#include "usb_vchan_aq.h"
+
+#define ETH_HDR_LEN   14
+#define IP_HDR_LEN    20
+#define UDP_HDR_LEN   8
+#define STAMP_OFFSET  (ETH_HDR_LEN + IP_HDR_LEN + UDP_HDR_LEN)
+#define MIN_FRAME     (STAMP_OFFSET + 8)
+#define MAX_FRAME     1514
+#define NTB_SIZE      CONFIG_AQ_USB_NCM_OUT_NTB_MAX_SIZE
+#define TX_PBUF_COUNT 64
+
+typedef struct {
+    const char *name;
+    uint32_t *lat_ns;        // una muestra por trama
+    atomic_uint done;
+    uint64_t bytes;
+    uint32_t rejected;       // reintentos por backpressure del driver
+    int64_t t_start_ns;
+    int64_t t_end_ns;
+    int64_t cpu_ns;          // RX: CPU de usb_rx_task, driver y extremo lwIP
+    int64_t csum_ns;         // trabajo de checksums del extremo lwIP
+} dir_result_t;
+
+static uint32_t s_packets = 200000;
+static uint16_t s_frame_len = MAX_FRAME;
+static uint32_t s_rate_pps = 0;       // 0 = tan rápido como acepte el driver
+static uint32_t s_ctrl_every = 0;     // 1 de cada N tramas TX con DSCP EF
+static uint16_t s_rx_batch = CONFIG_AQ_USB_NCM_MAX_DATAGRAMS_PER_NTB;
+static uint8_t s_template[MAX_FRAME];
+static int s_csum = -1;               // usb_netif_csum_profile_aq_t; -1 = sin modelar
+static uint32_t s_csum_errors;
+static dir_result_t s_rx = { .name = "rx" };
+static dir_result_t s_tx = { .name = "tx" };
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int64_t thread_cpu_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void pace(int64_t t0, uint32_t i) {
+    if (s_rate_pps == 0) return;
+    int64_t due = t0 + (int64_t)i * 1000000000 / s_rate_pps;
+    while (now_ns() < due) {
+        sched_yield();
+    }
+}
+
+// ---------- checksums como lwIP: suma en complemento a uno de palabras de 16 bits ----------
+
+static uint32_t csum_add(uint32_t acc, const uint8_t *p, size_t len) {
+    for (; len > 1; len -= 2, p += 2) {
+        acc += (uint32_t)p[0] << 8 | p[1];
+    }
+    if (len) acc += (uint32_t)p[0] << 8;
+    return acc;
+}
+
+static uint16_t csum_fold(uint32_t acc) {
+    while (acc >> 16) {
+        acc = (acc & 0xffff) + (acc >> 16);
+    }
+    return (uint16_t)acc;
+}
+
+// Pseudo-cabecera IPv4 + datagrama; con el campo de checksum correcto el resultado es 0
+static uint16_t udp_chksum(const uint8_t *frame) {
+    const uint8_t *ip = frame + ETH_HDR_LEN;
+    const uint8_t *udp = ip + IP_HDR_LEN;
+    uint16_t udp_len = (uint16_t)(udp[4] << 8 | udp[5]);
+    uint32_t acc = csum_add(0, ip + 12, 8);
+    acc += 17 + udp_len;
+    return (uint16_t)~csum_fold(csum_add(acc, udp, udp_len));
+}
+
+static void put16(uint8_t *p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v & 0xff;
+}
+
+// Lo que hace ip4_output + udp_sendto en el panel según el perfil
+static void csum_generate(uint8_t *frame) {
+    uint8_t *ip = frame + ETH_HDR_LEN;
+    uint8_t *udp = ip + IP_HDR_LEN;
+    put16(ip + 10, 0);
+    put16(ip + 10, (uint16_t)~csum_fold(csum_add(0, ip, IP_HDR_LEN)));
+    put16(udp + 6, 0);
+    if (s_csum != USB_NETIF_CSUM_MIN_AQ) {
+        uint16_t c = udp_chksum(frame);
+        put16(udp + 6, c ? c : 0xffff);  // 0 en UDP significa "sin checksum"
+    }
+}
+
+// El MASTER sella la trama tras calcular el checksum: ajuste incremental (RFC 1624)
+// de los 8 bytes de la marca, que en la plantilla valen 0
+static void csum_restamp(uint8_t *frame) {
+    uint8_t *udp = frame + ETH_HDR_LEN + IP_HDR_LEN;
+    uint32_t acc = (uint16_t)~(udp[6] << 8 | udp[7]);
+    acc = csum_add(acc, frame + STAMP_OFFSET, 8);
+    uint16_t c = (uint16_t)~csum_fold(acc);
+    put16(udp + 6, c ? c : 0xffff);
+}
+
+static const char *const s_csum_names[] = { "kconfig", "full", "trust_rx", "min" };
+
+static const char *csum_name(int profile) {
+    return s_csum_names[profile];
+}
+
+static int csum_parse(const char *name) {
+    for (int i = USB_NETIF_CSUM_FULL_AQ; i <= USB_NETIF_CSUM_MIN_AQ; i++) {
+        if (strcmp(name, s_csum_names[i]) == 0) return i;
+    }
+    return -2;
+}
+
+static void build_template(void) {
+    uint8_t *f = s_template;
+    static const uint8_t dst[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+    static const uint8_t src[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+    memcpy(f, dst, 6);
+    memcpy(f + 6, src, 6);
+    f[12] = 0x08;  // IPv4
+    f[13] = 0x00;
+    uint8_t *ip = f + ETH_HDR_LEN;
+    uint16_t ip_len = (uint16_t)(s_frame_len - ETH_HDR_LEN);
+    ip[0] = 0x45;
+    ip[2] = ip_len >> 8;
+    ip[3] = ip_len & 0xff;
+    ip[8] = 64;
+    ip[9] = 17;  // UDP
+    uint8_t *udp = ip + IP_HDR_LEN;
+    uint16_t udp_len = (uint16_t)(ip_len - IP_HDR_LEN);
+    udp[0] = 5000 >> 8; udp[1] = 5000 & 0xff;
+    udp[2] = 5001 >> 8; udp[3] = 5001 & 0xff;
+    udp[4] = udp_len >> 8;
+    udp[5] = udp_len & 0xff;
+    for (int i = MIN_FRAME; i < s_frame_len; i++) {
+        f[i] = (uint8_t)i;
+    }
+    if (s_csum >= 0) {
+        int profile = s_csum;
+        s_csum = USB_NETIF_CSUM_FULL_AQ;  // lo que manda el MASTER: con todos los checksums
+        csum_generate(f);
+        s_csum = profile;
+    }
+}
+
+static void stamp(uint8_t *frame) {
+    int64_t t = now_ns();
+    memcpy(frame + STAMP_OFFSET, &t, sizeof(t));
+}
+
+static void record(dir_result_t *r, const void *frame, size_t len) {
+    int64_t t;
+    memcpy(&t, (const uint8_t *)frame + STAMP_OFFSET, sizeof(t));
+    int64_t end = now_ns();
+    // Un solo consumidor por sentido (usb_rx_task / usb_tx_task)
+    unsigned i = atomic_load_explicit(&r->done, memory_order_relaxed);
+    if (i < s_packets) {
+        r->lat_ns[i] = (uint32_t)(end - t);
+        r->bytes += len;
+        r->t_end_ns = end;
+    }
+    atomic_store_explicit(&r->done, i + 1, memory_order_release);
+}
+
+// ---------- RX: hace de TinyUSB (OUT NTB -> datagramas) y de lwIP ----------
+
+static esp_err_t rx_sink(const void *buffer, size_t len) {
+    // Corre en usb_rx_task: su CPU de la primera a la última trama
+    unsigned i = atomic_load_explicit(&s_rx.done, memory_order_relaxed);
+    if (i == 0) s_rx.cpu_ns = -thread_cpu_ns();
+    // ip4_input / udp_input (tcp_input igual) con la verificación activa
+    if (s_csum == USB_NETIF_CSUM_FULL_AQ) {
+        int64_t t0 = now_ns();
+        const uint8_t *ip = (const uint8_t *)buffer + ETH_HDR_LEN;
+        if (csum_fold(csum_add(0, ip, IP_HDR_LEN)) != 0xffff || udp_chksum(buffer) != 0) s_csum_errors++;
+        s_rx.csum_ns += now_ns() - t0;
+    }
+    record(&s_rx, buffer, len);
+    if (i + 1 == s_packets) s_rx.cpu_ns += thread_cpu_ns();
+    return ESP_OK;
+}
+
+static void *rx_producer(void *arg) {
+    static uint8_t ntb[NTB_SIZE];
+    ncm_ntb_encoder_aq_t enc;
+    ncm_ntb_decoder_aq_t dec;
+    uint16_t seq = 0;
+    s_rx.t_start_ns = now_ns();
+    for (uint32_t i = 0; i < s_packets;) {
+        // El host empaqueta varias tramas por NTB; TinyUSB las separa y llama al
+        // callback de recepción una vez por datagrama
+        ncm_ntb_encoder_init_aq(&enc, ntb, sizeof(ntb), seq++, s_rx_batch, 4);
+        uint32_t n = 0;
+        while (i + n < s_packets) {
+            uint8_t *d = ncm_ntb_encoder_reserve_aq(&enc, s_frame_len);
+            if (d == NULL) break;
+            memcpy(d, s_template, s_frame_len);
+            n++;
+        }
+        size_t len = ncm_ntb_encoder_finish_aq(&enc);
+        ncm_ntb_decoder_init_aq(&dec, ntb, len);
+        const uint8_t *dg;
+        uint16_t dg_len;
+        uint32_t k = 0;
+        while (ncm_ntb_decoder_next_aq(&dec, &dg, &dg_len) == NCM_NTB_OK && dg_len) {
+            // La latencia RX cuenta desde la entrada al callback, no desde que el host
+            // llenó el NTB
+            pace(s_rx.t_start_ns, i + k++);
+            stamp((uint8_t *)dg);
+            if (s_csum >= 0) csum_restamp((uint8_t *)dg);
+            while (usb_rx_input_aq((void *)dg, dg_len, NULL) != ESP_OK) {
+                s_rx.rejected++;
+                sched_yield();
+            }
+        }
+        i += n;
+    }
+    return NULL;
+}
+
+// ---------- TX: hace de lwIP (pbufs propios) y de TinyUSB (IN NTB) ----------
+
+typedef struct {
+    struct pbuf_custom pc;
+    uint8_t data[MAX_FRAME];
+} bench_pbuf_t;
+
+static bench_pbuf_t s_pbufs[TX_PBUF_COUNT];
+static bench_pbuf_t *s_pbuf_free[TX_PBUF_COUNT];
+static int s_pbuf_top;
+static pthread_mutex_t s_pbuf_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void bench_pbuf_release(struct pbuf *p) {
+    pthread_mutex_lock(&s_pbuf_lock);
+    s_pbuf_free[s_pbuf_top++] = (bench_pbuf_t *)p;
+    pthread_mutex_unlock(&s_pbuf_lock);
+}
+
+static bench_pbuf_t *bench_pbuf_get(void) {
+    bench_pbuf_t *b = NULL;
+    while (b == NULL) {
+        pthread_mutex_lock(&s_pbuf_lock);
+        if (s_pbuf_top) b = s_pbuf_free[--s_pbuf_top];
+        pthread_mutex_unlock(&s_pbuf_lock);
+        if (b == NULL) sched_yield();
+    }
+    b->pc.pbuf.ref = 1;
+    return b;
+}
+
+static esp_err_t tx_sink(const void *buffer, size_t len) {
+    static uint8_t ntb[NTB_SIZE];
+    static ncm_ntb_encoder_aq_t enc;
+    static uint16_t seq;
+    // Coste de TinyUSB: copiar el datagrama al NTB en curso y cerrarlo cuando se llena
+    if (enc.buf == NULL || ncm_ntb_encoder_add_aq(&enc, buffer, (uint16_t)len) != NCM_NTB_OK) {
+        if (enc.buf) ncm_ntb_encoder_finish_aq(&enc);
+        ncm_ntb_encoder_init_aq(&enc, ntb, sizeof(ntb), seq++, CONFIG_AQ_USB_NCM_MAX_DATAGRAMS_PER_NTB, 4);
+        ncm_ntb_encoder_add_aq(&enc, buffer, (uint16_t)len);
+    }
+    record(&s_tx, buffer, len);
+    return ESP_OK;
+}
+
+static void *tx_producer(void *arg) {
+    for (int i = 0; i < TX_PBUF_COUNT; i++) {
+        bench_pbuf_t *b = &s_pbufs[i];
+        b->pc.pbuf.payload = b->data;
+        b->pc.pbuf.len = b->pc.pbuf.tot_len = s_frame_len;
+        b->pc.pbuf.flags = PBUF_FLAG_IS_CUSTOM;
+        b->pc.custom_free_function = bench_pbuf_release;
+        memcpy(b->data, s_template, s_frame_len);
+        s_pbuf_free[s_pbuf_top++] = b;
+    }
+    s_tx.t_start_ns = now_ns();
+    for (uint32_t i = 0; i < s_packets; i++) {
+        bench_pbuf_t *b = bench_pbuf_get();
+        b->data[ETH_HDR_LEN + 1] = (s_ctrl_every && i % s_ctrl_every == 0) ? USB_NETIF_TOS_CONTROL_AQ : 0;
+        pace(s_tx.t_start_ns, i);
+        stamp(b->data);
+        if (s_csum >= 0) {
+            int64_t t0 = now_ns();
+            csum_generate(b->data);
+            s_tx.csum_ns += now_ns() - t0;
+        }
+        // Igual que lwIP en linkoutput: el driver toma su referencia y el stack
+        // suelta la suya al volver; con la cola llena, ERR_MEM y reintento
+        while (usb_tx_enqueue_aq(b->data, s_frame_len, &b->pc.pbuf) != ESP_OK) {
+            s_tx.rejected++;
+            sched_yield();
+        }
+        pbuf_free(&b->pc.pbuf);
+    }
+    return NULL;
+}
+
+// ---------- log diferido: hace de la tarea usb_log ----------
+
+#define LOG_PRODUCERS 4
+#define LOG_BATCH     64
+
+static atomic_bool s_log_stop;
+static uint64_t s_log_formatted;
+static uint32_t s_log_sink;
+
+// Igual que usb_log: vaciar el anillo y formatear cada registro, aquí sin UART
+static uint32_t log_drain(void) {
+    usb_dlog_rec_aq_t rec;
+    char line[96];
+    uint32_t n = 0;
+    while (usb_dlog_pop_aq(&rec)) {
+        const usb_dlog_desc_aq_t *d = &g_usb_dlog_desc_aq[rec.id];
+        snprintf(line, sizeof(line), d->fmt, (unsigned)rec.args[0], (unsigned)rec.args[1], (unsigned)rec.args[2],
+                 (unsigned)rec.args[3]);
+        s_log_sink += (uint8_t)line[0];
+        n++;
+    }
+    return n;
+}
+
+static void *log_consumer(void *arg) {
+    const struct timespec period = { .tv_nsec = 1000000 };
+    while (!atomic_load(&s_log_stop)) {
+        s_log_formatted += log_drain();
+        nanosleep(&period, NULL);
+    }
+    s_log_formatted += log_drain();
+    return NULL;
+}
+
+static uint32_t s_mp_last[LOG_PRODUCERS];
+static uint32_t s_mp_received;
+static uint32_t s_mp_errors;
+
+static void *log_producer(void *arg) {
+    uint32_t id = (uint32_t)(uintptr_t)arg;
+    for (uint32_t i = 1; i <= s_packets; i++) {
+        usb_dlog_put_aq(USB_DLOG_RX_FRAME_AQ, i, id, 0, 0);
+        // Ceder de vez en cuando: sin pausas solo se mediría el anillo lleno
+        if ((i & 15) == 0) sched_yield();
+    }
+    return NULL;
+}
+
+// Cada productor numera sus registros desde 1: por productor deben llegar en orden
+// creciente, sin repetidos, y recibidos + perdidos deben sumar lo escrito
+static void *log_checker(void *arg) {
+    usb_dlog_rec_aq_t rec;
+    for (;;) {
+        bool stop = atomic_load(&s_log_stop);
+        while (usb_dlog_pop_aq(&rec)) {
+            uint32_t p = rec.args[1];
+            if (p >= LOG_PRODUCERS || rec.args[0] <= s_mp_last[p]) {
+                s_mp_errors++;
+            } else {
+                s_mp_last[p] = rec.args[0];
+            }
+            s_mp_received++;
+        }
+        if (stop) break;
+        sched_yield();
+    }
+    return NULL;
+}
+
+static int run_log_bench(void) {
+    uint32_t n = s_packets - s_packets % LOG_BATCH;
+    if (n == 0) return 2;
+
+    // 1. Coste del productor sin contención; el anillo se vacía entre lotes, fuera de la medida
+    usb_dlog_init_aq();
+    int64_t put_ns = 0;
+    for (uint32_t i = 0; i < n; i += LOG_BATCH) {
+        int64_t t0 = now_ns();
+        for (uint32_t j = 0; j < LOG_BATCH; j++) {
+            usb_dlog_put_aq(USB_DLOG_RX_FRAME_AQ, i + j, 0, 0, 0);
+        }
+        put_ns += now_ns() - t0;
+        usb_dlog_discard_aq();
+    }
+
+    // 2. Lo que pagaba cada ESP_LOGI por trama antes de llegar a la UART: formatear la línea
+    char line[96];
+    int64_t t0 = now_ns();
+    for (uint32_t i = 0; i < n; i++) {
+        snprintf(line, sizeof(line), "I (%lu) %s: USB RX callback: %d bytes", (unsigned long)i, "usb_netif_aq",
+                 (int)(i & 2047));
+        s_log_sink += (uint8_t)line[4];
+    }
+    int64_t fmt_ns = now_ns() - t0;
+
+    // 3. Varios productores a la vez contra un consumidor
+    usb_dlog_init_aq();
+    atomic_store(&s_log_stop, false);
+    pthread_t prod[LOG_PRODUCERS], checker;
+    pthread_create(&checker, NULL, log_checker, NULL);
+    for (uintptr_t p = 0; p < LOG_PRODUCERS; p++) {
+        pthread_create(&prod[p], NULL, log_producer, (void *)p);
+    }
+    for (int p = 0; p < LOG_PRODUCERS; p++) {
+        pthread_join(prod[p], NULL);
+    }
+    atomic_store(&s_log_stop, true);
+    pthread_join(checker, NULL);
+
+    usb_netif_log_stats_aq_t st;
+    usb_dlog_stats_aq(&st);
+    uint32_t total = LOG_PRODUCERS * s_packets;
+    if (st.recorded != s_mp_received || s_mp_received + st.dropped != total) s_mp_errors++;
+    printf("log: put %.1f ns/record uncontended, formatting %.1f ns/line (the old per-frame ESP_LOGI, "
+           "without UART)\n", (double)put_ns / n, (double)fmt_ns / n);
+    printf("log: %u producers x %u records, ring %u: %u received, %u dropped, %u errors\n", LOG_PRODUCERS,
+           s_packets, st.ring_capacity, s_mp_received, st.dropped, s_mp_errors);
+    printf("RESULT log put_ns=%.1f fmt_ns=%.1f mp_records=%u mp_dropped=%u mp_errors=%u\n", (double)put_ns / n,
+           (double)fmt_ns / n, s_mp_received, st.dropped, s_mp_errors);
+    return s_mp_errors ? 1 : 0;
+}
+
+// ---------- canal vendor frente a MQTT (-m stream) ----------
+
+// Enlace USB full speed simulado: el dispositivo no puede sacar más de ~19 paquetes bulk
+// de 64 B por trama de 1 ms. Las dos rutas pasan por el mismo enlace y lo que se compara
+// es el payload útil que llega al host y la CPU del productor para ponerlo en el cable.
+#define FS_PACKET          64
+#define FS_PACKETS_PER_MS  19
+#define STREAM_TOPIC       "aq/panel/adc"
+#define STREAM_SOCK_BUF    16384
+// NCM + IP + TCP por segmento: Ethernet, IPv4, TCP y entrada NDP con relleno medio
+#define TCP_MSS            1460
+#define NCM_SEG_OVERHEAD   (ETH_HDR_LEN + IP_HDR_LEN + 20 + 8)
+
+typedef struct {
+    uint32_t blocks;
+    uint64_t bytes;          // payload comprobado en el host
+    uint64_t wire_bytes;     // lo que ocupa el enlace (cabeceras y relleno incluidos)
+    int64_t cpu_ns;          // CPU del hilo productor
+    uint32_t waits;          // el productor esperó a que el enlace le dejara sitio
+    uint32_t errors;
+    int64_t t0_ns, t1_ns;
+} stream_result_t;
+
+static uint32_t s_stream_len;
+static uint32_t s_stream_rate;    // bloques/s del productor; 0 = tan rápido como deje el enlace
+static int64_t s_wire_t0_ns;
+static uint64_t s_wire_pkts;
+
+// Ocupa el enlace el tiempo que tardan `bytes` en paquetes de 64 B. Si estuvo parado no
+// acumula crédito: se mide el caudal que sostiene el productor, no una ráfaga.
+static void wire_wait(uint64_t bytes) {
+    int64_t now = now_ns();
+    int64_t due = s_wire_t0_ns + (int64_t)(s_wire_pkts * 1000000 / FS_PACKETS_PER_MS);
+    if (due < now) {
+        s_wire_t0_ns = now;
+        s_wire_pkts = 0;
+    }
+    s_wire_pkts += (bytes + FS_PACKET - 1) / FS_PACKET;
+    due = s_wire_t0_ns + (int64_t)(s_wire_pkts * 1000000 / FS_PACKETS_PER_MS);
+    struct timespec ts = { .tv_sec = due / 1000000000, .tv_nsec = due % 1000000000 };
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+// Muestras de 16 bits derivadas del número de bloque: el host las comprueba todas
+static void fill_samples(uint8_t *p, uint32_t len, uint32_t block) {
+    for (uint32_t i = 0; i + 1 < len; i += 2) {
+        uint16_t v = (uint16_t)(block * 7919u + i);
+        memcpy(p + i, &v, 2);
+    }
+}
+
+static bool check_samples(const uint8_t *p, uint32_t len, uint32_t block) {
+    for (uint32_t i = 0; i + 1 < len; i += 2) {
+        uint16_t v;
+        memcpy(&v, p + i, 2);
+        if (v != (uint16_t)(block * 7919u + i)) return false;
+    }
+    return true;
+}
+
+// Ritmo del productor, como el timer de muestreo del panel. La CPU se mide solo entre
+// despertar y entregar el bloque: las esperas no cuentan en ninguna de las dos rutas.
+static void stream_pace(int64_t t0, uint32_t i) {
+    if (s_stream_rate == 0) return;
+    int64_t due = t0 + (int64_t)i * 1000000000 / s_stream_rate;
+    struct timespec ts = { .tv_sec = due / 1000000000, .tv_nsec = due % 1000000000 };
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+// --- Canal vendor: el usb_vchan_aq real con el endpoint bulk IN simulado ---
+
+static usb_vchan_aq_t s_vch;
+static pthread_mutex_t s_vlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_vcond = PTHREAD_COND_INITIALIZER;
+static bool s_vkick;
+static uint8_t *s_vxfer;
+static uint32_t s_vxfer_len;
+static stream_result_t s_vres;
+
+static bool vbench_xfer(void *ctx, uint8_t *buf, uint32_t len) {
+    s_vxfer = buf;
+    s_vxfer_len = len;
+    return true;
+}
+
+// En el dispositivo es usbd_defer_func: despierta a tud_task
+static void vbench_kick(void *ctx) {
+    pthread_mutex_lock(&s_vlock);
+    s_vkick = true;
+    pthread_cond_signal(&s_vcond);
+    pthread_mutex_unlock(&s_vlock);
+}
+
+// Hace de tud_task (pump, fin de transferencia) y de host (lee y comprueba cada trama)
+static void *vendor_transport(void *arg) {
+    uint32_t expect_seq = 0;
+    usb_vchan_open_aq(&s_vch, FS_PACKET);  // montaje: puede haber bloques encolados ya
+    while (s_vres.blocks < s_packets) {
+        while (s_vxfer) {
+            uint8_t *b = s_vxfer;
+            uint32_t n = s_vxfer_len;
+            s_vxfer = NULL;
+            wire_wait(n);
+            usb_vchan_hdr_aq_t h;
+            memcpy(&h, b, sizeof(h));
+            if (h.magic != USB_VCHAN_MAGIC_AQ || h.version != USB_VCHAN_VERSION_AQ || h.seq != expect_seq ||
+                h.len != s_stream_len || n < USB_VCHAN_HDR_AQ + h.len || n % FS_PACKET == 0 ||
+                !check_samples(b + USB_VCHAN_HDR_AQ, h.len, h.seq)) {
+                s_vres.errors++;
+            }
+            expect_seq = h.seq + 1;
+            s_vres.blocks++;
+            s_vres.bytes += h.len;
+            s_vres.wire_bytes += n;
+            s_vres.t1_ns = now_ns();
+            usb_vchan_done_aq(&s_vch, true, n);  // puede lanzar la siguiente (s_vxfer)
+        }
+        if (s_vres.blocks >= s_packets) break;
+        // Sin transferencia en curso: a dormir hasta el próximo aviso del productor
+        struct timespec to;
+        clock_gettime(CLOCK_REALTIME, &to);
+        to.tv_sec += 2;
+        pthread_mutex_lock(&s_vlock);
+        int rc = 0;
+        while (!s_vkick && rc == 0) {
+            rc = pthread_cond_timedwait(&s_vcond, &s_vlock, &to);
+        }
+        s_vkick = false;
+        pthread_mutex_unlock(&s_vlock);
+        if (rc != 0) {
+            fprintf(stderr, "vendor: transport not woken with %u blocks pending\n", s_packets - s_vres.blocks);
+            s_vres.errors++;
+            break;
+        }
+        usb_vchan_pump_aq(&s_vch);
+    }
+    return NULL;
+}
+
+static void *vendor_producer(void *arg) {
+    const struct timespec wait = { .tv_nsec = 50000 };
+    int64_t t0 = now_ns();
+    for (uint32_t i = 0; i < s_packets; i++) {
+        size_t cap;
+        uint8_t *p;
+        stream_pace(t0, i);
+        int64_t c0 = thread_cpu_ns();
+        // Sin bloque libre el host va por detrás: el panel descartaría la muestra o esperaría
+        while ((p = usb_vchan_get_aq(&s_vch, &cap)) == NULL) {
+            s_vres.cpu_ns += thread_cpu_ns() - c0;
+            s_vres.waits++;
+            nanosleep(&wait, NULL);
+            c0 = thread_cpu_ns();
+        }
+        fill_samples(p, s_stream_len, i);
+        if (usb_vchan_send_aq(&s_vch, p, s_stream_len, 1, (uint32_t)(now_ns() / 1000)) != ESP_OK) {
+            s_vres.errors++;
+        }
+        s_vres.cpu_ns += thread_cpu_ns() - c0;
+    }
+    return NULL;
+}
+
+static int run_vendor_stream(void) {
+    memset(&s_vres, 0, sizeof(s_vres));
+    uint32_t bytes = CONFIG_AQ_USB_VENDOR_BLOCKS * usb_vchan_block_size_aq(CONFIG_AQ_USB_VENDOR_BLOCK_SIZE);
+    uint8_t *mem = usb_mem_alloc_aq(USB_MEM_VENDOR_AQ, bytes);
+    const usb_vchan_ops_aq_t ops = { .xfer = vbench_xfer, .kick = vbench_kick };
+    if (mem == NULL ||
+        usb_vchan_init_aq(&s_vch, mem, CONFIG_AQ_USB_VENDOR_BLOCKS, CONFIG_AQ_USB_VENDOR_BLOCK_SIZE, &ops) != ESP_OK) {
+        return 1;
+    }
+    pthread_t prod, transport;
+    s_vres.t0_ns = now_ns();
+    pthread_create(&prod, NULL, vendor_producer, NULL);
+    pthread_create(&transport, NULL, vendor_transport, NULL);
+    pthread_join(prod, NULL);
+    pthread_join(transport, NULL);
+
+    usb_netif_vendor_stats_aq_t st;
+    usb_vchan_stats_aq(&s_vch, &st);
+    if (st.blocks_sent != s_packets || st.dropped != 0 || st.no_block != s_vres.waits) s_vres.errors++;
+    usb_vchan_close_aq(&s_vch);
+    usb_vchan_deinit_aq(&s_vch);
+    usb_mem_free_aq(USB_MEM_VENDOR_AQ, mem, bytes);
+    return 0;
+}
+
+// --- MQTT: PUBLISH QoS 0 con el codec de mqtt_service_aq sobre TCP (loopback) ---
+
+static int s_mq_tx = -1, s_mq_rx = -1;
+static stream_result_t s_mres;
+
+static void *mqtt_producer(void *arg) {
+    uint8_t *payload = malloc(s_stream_len);
+    uint8_t topic[2 + sizeof(STREAM_TOPIC) - 1];
+    topic[0] = 0;
+    topic[1] = sizeof(STREAM_TOPIC) - 1;
+    memcpy(topic + 2, STREAM_TOPIC, sizeof(STREAM_TOPIC) - 1);
+    uint8_t fixed[MQTT_FIXED_HDR_MAX];
+    int64_t t0 = now_ns();
+    for (uint32_t i = 0; payload && i < s_packets; i++) {
+        stream_pace(t0, i);
+        int64_t c0 = thread_cpu_ns();
+        fill_samples(payload, s_stream_len, i);
+        size_t fl = mqtt_encode_publish_fixed_aq(fixed, 0, false, sizeof(topic), s_stream_len);
+        struct iovec iov[3] = {
+            { fixed, fl }, { topic, sizeof(topic) }, { payload, s_stream_len },
+        };
+        // Socket bloqueante: writev solo vuelve corto si lo interrumpe una señal
+        size_t left = fl + sizeof(topic) + s_stream_len;
+        struct iovec *v = iov;
+        while (left > 0) {
+            ssize_t w = writev(s_mq_tx, v, (int)(iov + 3 - v));
+            if (w <= 0) {
+                s_mres.errors++;
+                free(payload);
+                return NULL;
+            }
+            left -= (size_t)w;
+            while (v < iov + 3 && (size_t)w >= v->iov_len) {
+                w -= (ssize_t)v->iov_len;
+                v++;
+            }
+            if (v < iov + 3) {
+                v->iov_base = (uint8_t *)v->iov_base + w;
+                v->iov_len -= (size_t)w;
+            }
+        }
+        // Con el enlace saturado incluye lo que el kernel gasta en bloquear y despertar
+        s_mres.cpu_ns += thread_cpu_ns() - c0;
+    }
+    free(payload);
+    return NULL;
+}
+
+// Hace de broker/host: el flujo TCP pasa por el enlace con la sobrecarga de NCM por segmento
+static void *mqtt_receiver(void *arg) {
+    size_t cap = 2 * (s_stream_len + 64) + STREAM_SOCK_BUF;
+    uint8_t *buf = malloc(cap);
+    size_t have = 0;
+    uint64_t stream = 0, wire_prev = 0;
+    while (buf && s_mres.blocks < s_packets) {
+        ssize_t r = recv(s_mq_rx, buf + have, cap - have, 0);
+        if (r <= 0) {
+            s_mres.errors++;
+            break;
+        }
+        stream += (uint64_t)r;
+        uint64_t wire = stream + (stream + TCP_MSS - 1) / TCP_MSS * NCM_SEG_OVERHEAD;
+        wire_wait(wire - wire_prev);
+        s_mres.wire_bytes += wire - wire_prev;
+        wire_prev = wire;
+        have += (size_t)r;
+
+        size_t off = 0, used;
+        mqtt_packet_aq_t pkt;
+        int rc;
+        while ((rc = mqtt_parse_aq(buf + off, have - off, &pkt, &used)) == 1) {
+            const char *topic;
+            uint16_t topic_len, pkt_id;
+            const uint8_t *payload;
+            size_t len;
+            if (pkt.type != MQTT_PKT_PUBLISH ||
+                !mqtt_parse_publish_aq(&pkt, &topic, &topic_len, &pkt_id, &payload, &len) ||
+                len != s_stream_len || !check_samples(payload, (uint32_t)len, s_mres.blocks)) {
+                s_mres.errors++;
+            }
+            s_mres.blocks++;
+            s_mres.bytes += len;
+            off += used;
+        }
+        if (rc < 0) {
+            s_mres.errors++;
+            break;
+        }
+        memmove(buf, buf + off, have - off);
+        have -= off;
+        s_mres.t1_ns = now_ns();
+    }
+    free(buf);
+    return NULL;
+}
+
+static int run_mqtt_stream(void) {
+    memset(&s_mres, 0, sizeof(s_mres));
+    int lst = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t alen = sizeof(addr);
+    int sz = STREAM_SOCK_BUF;
+    s_mq_tx = socket(AF_INET, SOCK_STREAM, 0);
+    // Búferes del orden de los de lwIP (TCP_SND_BUF/TCP_WND) para que el enlace frene al productor
+    setsockopt(s_mq_tx, SOL_SOCKET, SO_SNDBUF, &sz, sizeof(sz));
+    setsockopt(lst, SOL_SOCKET, SO_RCVBUF, &sz, sizeof(sz));
+    if (lst < 0 || s_mq_tx < 0 || bind(lst, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(lst, 1) != 0 ||
+        getsockname(lst, (struct sockaddr *)&addr, &alen) != 0 ||
+        connect(s_mq_tx, (struct sockaddr *)&addr, sizeof(addr)) != 0 || (s_mq_rx = accept(lst, NULL, NULL)) < 0) {
+        perror("mqtt loopback");
+        return 1;
+    }
+    close(lst);
+    pthread_t prod, recv_thread;
+    s_mres.t0_ns = now_ns();
+    pthread_create(&prod, NULL, mqtt_producer, NULL);
+    pthread_create(&recv_thread, NULL, mqtt_receiver, NULL);
+    pthread_join(prod, NULL);
+    pthread_join(recv_thread, NULL);
+    close(s_mq_tx);
+    close(s_mq_rx);
+    return 0;
+}
+
+static void stream_print(const char *path, const stream_result_t *sat, const stream_result_t *paced,
+                         double fill_ns) {
+    double secs = (double)(sat->t1_ns - sat->t0_ns) / 1e9;
+    double kbs = sat->bytes / secs / 1024;
+    double pct = sat->wire_bytes ? 100.0 * sat->bytes / sat->wire_bytes : 0;
+    double cpu_us = paced->cpu_ns / 1e3 / s_packets;
+    double over_ns_kb = (paced->cpu_ns - fill_ns * s_packets) / (paced->bytes / 1024.0);
+    printf("%s: %.1f KB/s payload (%.1f%% of the link bytes), producer CPU at %u blocks/s %.2f us/block, "
+           "%.0f ns/KB on top of filling the samples, %u errors\n",
+           path, kbs, pct, s_stream_rate, cpu_us, over_ns_kb, sat->errors + paced->errors);
+    printf("RESULT stream path=%s kbps=%.1f payload_pct=%.1f cpu_us_per_block=%.2f cpu_ns_per_kb=%.0f errors=%u\n",
+           path, kbs, pct, cpu_us, over_ns_kb, sat->errors + paced->errors);
+}
+
+// Cada ruta corre dos veces: saturando el enlace (caudal) y al ritmo -r (CPU del productor;
+// saturado, el vendor esperaría sondeando y MQTT bloqueado en el kernel, y eso no se compara)
+static int run_stream_bench(uint32_t rate) {
+    if (rate == 0) {
+        // 75% de lo que el enlace lleva en bloques de este tamaño
+        uint32_t pkts = (USB_VCHAN_HDR_AQ + s_stream_len + 1 + FS_PACKET - 1) / FS_PACKET;
+        rate = FS_PACKETS_PER_MS * 1000 * 3 / 4 / pkts;
+    }
+    // Coste de generar las muestras, igual en las dos rutas; se descuenta en el informe
+    uint8_t *scratch = malloc(s_stream_len);
+    if (scratch == NULL) return 1;
+    int64_t fill = 0;
+    for (uint32_t i = 0; i < s_packets; i++) {
+        int64_t c0 = thread_cpu_ns();
+        fill_samples(scratch, s_stream_len, i);
+        fill += thread_cpu_ns() - c0;
+        s_log_sink += scratch[i % s_stream_len];
+    }
+    double fill_ns = (double)fill / s_packets;
+    free(scratch);
+
+    stream_result_t v_sat, v_paced, m_sat, m_paced;
+    s_stream_rate = 0;
+    if (run_vendor_stream() != 0) return 1;
+    v_sat = s_vres;
+    if (run_mqtt_stream() != 0) return 1;
+    m_sat = s_mres;
+    s_stream_rate = rate;
+    if (run_vendor_stream() != 0) return 1;
+    v_paced = s_vres;
+    if (run_mqtt_stream() != 0) return 1;
+    m_paced = s_mres;
+
+    printf("stream: %u blocks x %u B over a simulated full-speed link (%d x %d-byte bulk packets per ms), "
+           "fill %.0f ns/block\n", s_packets, s_stream_len, FS_PACKETS_PER_MS, FS_PACKET, fill_ns);
+    printf("vendor: %u of %u blocks, producer found no free block %u times while saturating\n",
+           CONFIG_AQ_USB_VENDOR_BLOCKS, CONFIG_AQ_USB_VENDOR_BLOCK_SIZE, v_sat.waits);
+    stream_print("vendor", &v_sat, &v_paced, fill_ns);
+    stream_print("mqtt", &m_sat, &m_paced, fill_ns);
+    return v_sat.errors || v_paced.errors || m_sat.errors || m_paced.errors ? 1 : 0;
+}
+
+// ---------- servicio de medida: iperf 2 UDP y eco ----------
+
+#define PERF_PKT_LEN   PERF_UDP_DEFAULT_LEN_AQ
+#define PERF_SOCK_BUF  (4 * 1024 * 1024)
+
+static int s_pf_sink = -1, s_pf_echo = -1;
+static atomic_bool s_pf_stop;
+static perf_udp_rx_aq_t s_pf_rx;
+static int64_t s_pf_cpu_ns;          // CPU del hilo panel en la sesión UDP en curso
+static int64_t s_pf_sess_cpu_ns;     // la de la última sesión cerrada con FIN
+static uint32_t s_pf_sess_packets;
+
+static int64_t now_us(void) {
+    return now_ns() / 1000;
+}
+
+// Mismo recorrido que udp_sink_read/echo_read en usb_perf_aq.c, con sockets POSIX
+static void *perf_panel(void *arg) {
+    uint8_t buf[2048], report[PERF_UDP_REPORT_LEN_AQ];
+    uint64_t report_peer = 0;
+    struct pollfd pfd[2] = { { .fd = s_pf_sink, .events = POLLIN }, { .fd = s_pf_echo, .events = POLLIN } };
+    while (!atomic_load(&s_pf_stop)) {
+        if (poll(pfd, 2, 50) <= 0) continue;
+        struct sockaddr_in a;
+        socklen_t alen = sizeof(a);
+        if (pfd[0].revents & POLLIN) {
+            int64_t c0 = thread_cpu_ns();
+            ssize_t n = recvfrom(s_pf_sink, buf, sizeof(buf), 0, (struct sockaddr *)&a, &alen);
+            uint64_t key = (uint64_t)a.sin_addr.s_addr << 16 | a.sin_port;
+            perf_udp_kind_aq_t k = n > 0 ? perf_udp_rx_aq(&s_pf_rx, key, buf, (size_t)n, now_us()) : PERF_UDP_BAD_AQ;
+            if (k == PERF_UDP_FIN_AQ) {
+                perf_udp_report_put_aq(&s_pf_rx, buf, report);
+                report_peer = key;
+                s_pf_rx.active = false;
+                sendto(s_pf_sink, report, sizeof(report), 0, (struct sockaddr *)&a, alen);
+                s_pf_sess_cpu_ns = s_pf_cpu_ns + thread_cpu_ns() - c0;
+                s_pf_sess_packets = s_pf_rx.packets;
+                s_pf_cpu_ns = 0;
+                continue;
+            }
+            if (k == PERF_UDP_BAD_AQ && key == report_peer && n >= PERF_UDP_HDR_LEN_AQ) {
+                sendto(s_pf_sink, report, sizeof(report), 0, (struct sockaddr *)&a, alen);
+            }
+            s_pf_cpu_ns += thread_cpu_ns() - c0;
+        }
+        if (pfd[1].revents & POLLIN) {
+            alen = sizeof(a);
+            ssize_t n = recvfrom(s_pf_echo, buf, sizeof(buf), 0, (struct sockaddr *)&a, &alen);
+            int64_t t_rx = now_us();
+            if (n > 0 && perf_echo_stamp_aq(buf, (size_t)n, t_rx, now_us())) {
+                sendto(s_pf_echo, buf, (size_t)n, 0, (struct sockaddr *)&a, alen);
+            }
+        }
+    }
+    return NULL;
+}
+
+static int perf_socket(struct sockaddr_in *bound) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int sz = PERF_SOCK_BUF;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &sz, sizeof(sz));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sz, sizeof(sz));
+    struct sockaddr_in a = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t alen = sizeof(a);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&a, sizeof(a)) != 0 ||
+        getsockname(fd, (struct sockaddr *)&a, &alen) != 0) {
+        perror("perf socket");
+        exit(1);
+    }
+    if (bound) *bound = a;
+    struct timeval tv = { .tv_sec = 0, .tv_usec = 250000 };  // como el cliente iperf con el FIN
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+// MASTER: iperf -u con n datagramas. drop_every/swap_every inyectan pérdidas y desorden
+// (0 = nada) para comprobar la contabilidad del sumidero contra lo que se sabe enviado.
+static bool perf_udp_client(int fd, uint32_t n, uint32_t drop_every, uint32_t swap_every,
+                            perf_udp_report_aq_t *rep, double *secs) {
+    uint8_t buf[PERF_PKT_LEN] = {0};
+    int64_t t0 = now_ns();
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t id = i;
+        if (swap_every && i % swap_every == 1) id = i + 1;   // i+1 sale antes que i
+        else if (swap_every && i % swap_every == 2) id = i - 1;
+        if (drop_every && id % drop_every == drop_every - 1) continue;
+        perf_udp_hdr_put_aq(buf, (int32_t)id, now_us());
+        if (send(fd, buf, sizeof(buf), 0) < 0) return false;
+        // Con pérdidas inyectadas se va despacio: la cola de loopback no debe añadir las suyas
+        if (drop_every && (i & 63) == 63) usleep(200);
+    }
+    *secs = (now_ns() - t0) / 1e9;
+    for (int tries = 0; tries < 10; tries++) {
+        perf_udp_hdr_put_aq(buf, -(int32_t)n, now_us());
+        send(fd, buf, PERF_UDP_HDR_LEN_AQ, 0);
+        ssize_t r = recv(fd, buf, sizeof(buf), 0);
+        if (r > 0 && perf_udp_report_get_aq(buf, (size_t)r, rep)) return true;
+    }
+    return false;
+}
+
+static int cmp_i64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static int run_perf_bench(void) {
+    struct sockaddr_in sink, echo;
+    s_pf_sink = perf_socket(&sink);
+    s_pf_echo = perf_socket(&echo);
+    pthread_t panel;
+    pthread_create(&panel, NULL, perf_panel, NULL);
+    int errors = 0;
+
+    // 1. Contabilidad: 2% perdido, un par cruzado cada 100, FIN repetido
+    int cl = perf_socket(NULL);
+    connect(cl, (struct sockaddr *)&sink, sizeof(sink));
+    perf_udp_report_aq_t rep, rep2;
+    double secs;
+    const uint32_t n_chk = 5000, drop = 50, swap = 100;
+    uint32_t exp_lost = 0;
+    for (uint32_t id = 0; id < n_chk; id++) exp_lost += id % drop == drop - 1;
+    if (!perf_udp_client(cl, n_chk, drop, swap, &rep, &secs)) {
+        printf("check report: no server report\n");
+        errors++;
+    } else {
+        // Cada par cruzado cuenta una vez: el tardío estaba contado como perdido y se descuenta
+        uint32_t exp_ooo = 0;
+        for (uint32_t i = 1; i + 1 < n_chk; i += swap) exp_ooo += (i % drop != drop - 1) && (i + 1) % drop != drop - 1;
+        bool ok = rep.lost == exp_lost && rep.out_of_order == exp_ooo &&
+                  rep.bytes == (uint64_t)(n_chk - exp_lost) * PERF_PKT_LEN;
+        printf("check report: lost %u (expected %u), out of order %u (expected %u), bytes %llu: %s\n", rep.lost,
+               exp_lost, rep.out_of_order, exp_ooo, (unsigned long long)rep.bytes, ok ? "ok" : "FAIL");
+        errors += !ok;
+        // Un FIN repetido (el informe se perdió) recibe el mismo informe
+        uint8_t fin[PERF_UDP_HDR_LEN_AQ], buf[PERF_UDP_REPORT_LEN_AQ];
+        perf_udp_hdr_put_aq(fin, -(int32_t)n_chk, now_us());
+        send(cl, fin, sizeof(fin), 0);
+        ssize_t r = recv(cl, buf, sizeof(buf), 0);
+        ok = r > 0 && perf_udp_report_get_aq(buf, (size_t)r, &rep2) && memcmp(&rep, &rep2, sizeof(rep)) == 0;
+        printf("check duplicate FIN: %s\n", ok ? "ok" : "FAIL");
+        errors += !ok;
+    }
+
+    // 2. Caudal del sumidero a máxima velocidad, sin inyectar nada
+    if (!perf_udp_client(cl, s_packets, 0, 0, &rep, &secs)) {
+        printf("udp sink: no server report\n");
+        errors++;
+    } else {
+        double mbps = rep.bytes * 8 / 1e6 / (rep.duration_ms ? rep.duration_ms / 1e3 : secs);
+        printf("udp sink: %u datagrams x %d B, %.1f Mbit/s, lost %u, ooo %u, jitter %.3f ms, panel CPU %.0f ns/datagram\n",
+               rep.datagrams, PERF_PKT_LEN, mbps, rep.lost, rep.out_of_order, rep.jitter_us / 1e3,
+               (double)s_pf_sess_cpu_ns / (s_pf_sess_packets ? s_pf_sess_packets : 1));
+        printf("RESULT perf proto=udp mbps=%.1f pps=%.0f lost=%u ooo=%u jitter_ms=%.3f cpu_ns_per_pkt=%.0f\n", mbps,
+               mbps * 1e6 / 8 / PERF_PKT_LEN, rep.lost, rep.out_of_order, rep.jitter_us / 1e3,
+               (double)s_pf_sess_cpu_ns / (s_pf_sess_packets ? s_pf_sess_packets : 1));
+    }
+    close(cl);
+
+    // 3. Eco: rtt y tiempo dentro del "panel", un datagrama en vuelo
+    int ec = perf_socket(NULL);
+    connect(ec, (struct sockaddr *)&echo, sizeof(echo));
+    uint32_t n_echo = s_packets / 10 ? s_packets / 10 : 1;
+    int64_t *rtt = calloc(n_echo, sizeof(int64_t));
+    uint32_t got = 0;
+    uint64_t resid = 0;
+    uint8_t e[64] = {0};
+    for (uint32_t i = 0; rtt && i < n_echo; i++) {
+        uint32_t magic = PERF_ECHO_MAGIC_AQ;
+        int64_t t0 = now_ns();
+        memcpy(e, &magic, 4);
+        memcpy(e + 4, &i, 4);
+        memcpy(e + 8, &t0, 8);
+        send(ec, e, sizeof(e), 0);
+        if (recv(ec, e, sizeof(e), 0) != (ssize_t)sizeof(e)) continue;
+        int64_t t_sent, t_rx, t_tx;
+        uint32_t seq;
+        memcpy(&seq, e + 4, 4);
+        memcpy(&t_sent, e + 8, 8);
+        memcpy(&t_rx, e + 16, 8);
+        memcpy(&t_tx, e + 24, 8);
+        if (seq != i || t_sent != t0 || t_tx < t_rx) {
+            errors++;
+            continue;
+        }
+        rtt[got++] = now_ns() - t0;
+        resid += (uint64_t)(t_tx - t_rx);
+    }
+    if (got) {
+        qsort(rtt, got, sizeof(int64_t), cmp_i64);
+        printf("echo: %u/%u round trips, p50 %.1f us, p99 %.1f us, %.2f us inside the panel\n", got, n_echo,
+               rtt[got / 2] / 1e3, rtt[got * 99 / 100] / 1e3, (double)resid / got);
+        printf("RESULT perf proto=echo p50_us=%.1f p99_us=%.1f\n", rtt[got / 2] / 1e3, rtt[got * 99 / 100] / 1e3);
+    }
+    errors += got != n_echo;
+    free(rtt);
+    close(ec);
+
+    atomic_store(&s_pf_stop, true);
+    pthread_join(panel, NULL);
+    close(s_pf_sink);
+    close(s_pf_echo);
+    return errors ? 1 : 0;
+}
+
+// ---------- filtro RX (-m filter) ----------
+
+#define FB_FRAME_LEN 128
+#define FB_BURST     16      // tramas de charla por cada trama real en la prueba de ráfagas
+#define FB_REAL_PORT 5001
+
+typedef struct {
+    const char *name;
+    bool expect_pass;        // con las reglas por defecto sin IPv6
+    uint8_t frame[FB_FRAME_LEN];
+} fb_frame_t;
+
+// Trama IPv4/UDP o IPv6/UDP mínima: lo que mira el filtro más un payload
+static void fb_build(fb_frame_t *f, const char *name, bool pass, const uint8_t mac[6], uint16_t ethertype,
+                     const uint8_t *dst_ip, uint16_t dport) {
+    static const uint8_t src[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+    memset(f, 0, sizeof(*f));
+    f->name = name;
+    f->expect_pass = pass;
+    uint8_t *p = f->frame;
+    memcpy(p, mac, 6);
+    memcpy(p + 6, src, 6);
+    put16(p + 12, ethertype);
+    uint8_t *ip = p + ETH_HDR_LEN;
+    if (ethertype == 0x0800) {
+        ip[0] = 0x45;
+        put16(ip + 2, FB_FRAME_LEN - ETH_HDR_LEN);
+        ip[8] = 1;
+        ip[9] = 17;
+        ip[12] = 192; ip[13] = 168; ip[14] = 7; ip[15] = 1;
+        memcpy(ip + 16, dst_ip, 4);
+        put16(ip + IP_HDR_LEN + 2, dport);
+    } else if (ethertype == 0x86DD) {
+        ip[0] = 0x60;
+        put16(ip + 4, FB_FRAME_LEN - ETH_HDR_LEN - 40);
+        ip[6] = 17;
+        ip[7] = 255;
+        ip[8] = 0xFE; ip[9] = 0x80; ip[23] = 0x01;
+        memcpy(ip + 24, dst_ip, 16);
+        put16(ip + 40 + 2, dport);
+    } else {
+        // ARP request: who-has 192.168.7.2
+        put16(ip, 1); put16(ip + 2, 0x0800); ip[4] = 6; ip[5] = 4; put16(ip + 6, 1);
+        ip[24] = 192; ip[25] = 168; ip[26] = 7; ip[27] = 2;
+    }
+}
+
+enum { FB_TCP, FB_UDP, FB_ARP, FB_DHCP, FB_MDNS4, FB_LLMNR, FB_SSDP, FB_NETBIOS, FB_RA, FB_NS, FB_MDNS6, FB_MLD,
+       FB_COUNT };
+static fb_frame_t s_fb[FB_COUNT];
+
+static void fb_build_all(void) {
+    static const uint8_t me[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+    static const uint8_t bcast[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+    static const uint8_t ip_me[4] = { 192, 168, 7, 2 };
+    static const uint8_t ip_bcast[4] = { 255, 255, 255, 255 };
+    static const uint8_t ip_subnet_bcast[4] = { 192, 168, 7, 255 };
+    static const uint8_t ip_mdns[4] = { 224, 0, 0, 251 };
+    static const uint8_t ip_llmnr[4] = { 224, 0, 0, 252 };
+    static const uint8_t ip_ssdp[4] = { 239, 255, 255, 250 };
+    static const uint8_t ip6_all[16] = { 0xFF, 0x02, [15] = 0x01 };
+    static const uint8_t ip6_sn[16] = { 0xFF, 0x02, [11] = 0x01, [12] = 0xFF, [15] = 0x02 };
+    static const uint8_t ip6_mdns[16] = { 0xFF, 0x02, [15] = 0xFB };
+    static const uint8_t ip6_mld[16] = { 0xFF, 0x02, [15] = 0x16 };
+    uint8_t mac[6];
+
+    fb_build(&s_fb[FB_TCP], "tcp_unicast", true, me, 0x0800, ip_me, 1883);
+    s_fb[FB_TCP].frame[ETH_HDR_LEN + 9] = 6;
+    fb_build(&s_fb[FB_UDP], "udp_unicast", true, me, 0x0800, ip_me, FB_REAL_PORT);
+    fb_build(&s_fb[FB_ARP], "arp_bcast", true, bcast, 0x0806, NULL, 0);
+    fb_build(&s_fb[FB_DHCP], "dhcp_bcast", true, bcast, 0x0800, ip_bcast, 68);
+    memcpy(mac, (uint8_t[]){ 0x01, 0x00, 0x5E, 0x00, 0x00, 0xFB }, 6);
+    fb_build(&s_fb[FB_MDNS4], "mdns4", false, mac, 0x0800, ip_mdns, 5353);
+    mac[5] = 0xFC;
+    fb_build(&s_fb[FB_LLMNR], "llmnr4", false, mac, 0x0800, ip_llmnr, 5355);
+    memcpy(mac, (uint8_t[]){ 0x01, 0x00, 0x5E, 0x7F, 0xFF, 0xFA }, 6);
+    fb_build(&s_fb[FB_SSDP], "ssdp", false, mac, 0x0800, ip_ssdp, 1900);
+    fb_build(&s_fb[FB_NETBIOS], "netbios_bcast", false, bcast, 0x0800, ip_subnet_bcast, 137);
+    memcpy(mac, (uint8_t[]){ 0x33, 0x33, 0x00, 0x00, 0x00, 0x01 }, 6);
+    fb_build(&s_fb[FB_RA], "ipv6_ra", CONFIG_AQ_USB_RX_FILTER_IPV6, mac, 0x86DD, ip6_all, 0);
+    s_fb[FB_RA].frame[ETH_HDR_LEN + 6] = 58;
+    memcpy(mac, (uint8_t[]){ 0x33, 0x33, 0xFF, 0x00, 0x00, 0x02 }, 6);
+    fb_build(&s_fb[FB_NS], "ipv6_ns", CONFIG_AQ_USB_RX_FILTER_IPV6, mac, 0x86DD, ip6_sn, 0);
+    s_fb[FB_NS].frame[ETH_HDR_LEN + 6] = 58;
+    memcpy(mac, (uint8_t[]){ 0x33, 0x33, 0x00, 0x00, 0x00, 0xFB }, 6);
+    fb_build(&s_fb[FB_MDNS6], "mdns6", false, mac, 0x86DD, ip6_mdns, 5353);
+    memcpy(mac, (uint8_t[]){ 0x33, 0x33, 0x00, 0x00, 0x00, 0x16 }, 6);
+    fb_build(&s_fb[FB_MLD], "mld", false, mac, 0x86DD, ip6_mld, 0);
+    s_fb[FB_MLD].frame[ETH_HDR_LEN + 6] = 0;  // hop-by-hop, como los informes MLDv2
+}
+
+static atomic_uint s_fb_real;
+static atomic_uint s_fb_other;
+
+static esp_err_t fb_sink(const void *buffer, size_t len) {
+    const uint8_t *f = buffer;
+    bool real = len >= ETH_HDR_LEN + IP_HDR_LEN + 4 && f[0] == 0x02 && f[12] == 0x08 && f[13] == 0x00 &&
+                ((f[ETH_HDR_LEN + IP_HDR_LEN + 2] << 8) | f[ETH_HDR_LEN + IP_HDR_LEN + 3]) == FB_REAL_PORT;
+    atomic_fetch_add(real ? &s_fb_real : &s_fb_other, 1);
+    return ESP_OK;
+}
+
+// ns por llamada de usb_rx_filter_pass_aq con la trama en caché, como en el callback
+static double fb_cost(const fb_frame_t *f, uint32_t iters, bool *verdict) {
+    bool v = false;
+    int64_t t0 = now_ns();
+    for (uint32_t i = 0; i < iters; i++) {
+        v = usb_rx_filter_pass_aq(f->frame, FB_FRAME_LEN);
+        __asm__ volatile("" ::: "memory");
+    }
+    *verdict = v;
+    return (double)(now_ns() - t0) / iters;
+}
+
+static bool s_fb_writer_stop;
+static uint32_t s_fb_updates;
+
+// Cambia la tabla sin pausa mientras el hilo principal filtra
+static void *fb_writer(void *arg) {
+    const esp_ip4_addr_t ssdp = { .addr = htonl(0xEFFFFFFA) };
+    while (!__atomic_load_n(&s_fb_writer_stop, __ATOMIC_RELAXED)) {
+        usb_netif_rx_filter_join_ip4_aq(ssdp);
+        usb_netif_rx_filter_leave_ip4_aq(ssdp);
+        s_fb_updates += 2;
+    }
+    return NULL;
+}
+
+static int run_filter_bench(void) {
+    int errors = 0;
+    fb_build_all();
+    static struct { int dummy; } netif;
+    mock_set_rx_sink_aq(fb_sink, usb_rx_free_aq);
+    usb_dlog_init_aq();
+    ESP_ERROR_CHECK(usb_rx_init_aq());
+
+    // 1. Veredictos con las reglas por defecto y coste por tipo de trama
+    uint32_t iters = s_packets * 5;
+    printf("filter cost, default rules (%u iterations per frame):\n", iters);
+    for (int i = 0; i < FB_COUNT; i++) {
+        bool pass;
+        double ns = fb_cost(&s_fb[i], iters, &pass);
+        bool ok = pass == s_fb[i].expect_pass;
+        errors += !ok;
+        printf("RESULT filter frame=%s verdict=%s ns=%.1f%s\n", s_fb[i].name, pass ? "pass" : "drop", ns,
+               ok ? "" : " UNEXPECTED");
+    }
+
+    // 2. Tabla llena: el peor caso recorre todos los huecos
+    usb_netif_rx_rule_aq_t extra = { .type = USB_NETIF_RX_RULE_GROUP_AQ, .prefix_len = 32, .addr = { 239, 1, 1 } };
+    usb_netif_rx_filter_stats_aq_t fs;
+    usb_netif_rx_filter_get_stats_aq(&fs);
+    for (uint32_t n = fs.rules; n < fs.capacity; n++) {
+        extra.addr[3] = (uint8_t)n;
+        ESP_ERROR_CHECK(usb_netif_rx_filter_add_aq(&extra));
+    }
+    extra.addr[3] = 0xEE;
+    errors += usb_netif_rx_filter_add_aq(&extra) != ESP_ERR_NO_MEM;
+    for (int i = 0; i < FB_COUNT; i += FB_COUNT - 1) {
+        bool pass;
+        double ns = fb_cost(&s_fb[i == 0 ? FB_TCP : FB_SSDP], iters, &pass);
+        printf("RESULT filter frame=%s rules=%u ns=%.1f\n", s_fb[i == 0 ? FB_TCP : FB_SSDP].name, fs.capacity, ns);
+    }
+    usb_netif_rx_filter_reset_aq();
+
+    // 3. Reglas en caliente: unirse a mDNS deja pasar mdns4 y cuenta en su regla
+    const esp_ip4_addr_t mdns = { .addr = htonl(0xE00000FB) };
+    ESP_ERROR_CHECK(usb_netif_rx_filter_join_ip4_aq(mdns));
+    for (int i = 0; i < 3; i++) {
+        errors += !usb_rx_filter_pass_aq(s_fb[FB_MDNS4].frame, FB_FRAME_LEN);
+    }
+    usb_netif_rx_rule_info_aq_t rules[CONFIG_AQ_USB_RX_FILTER_MAX_RULES];
+    size_t nrules = 0;
+    usb_netif_rx_filter_get_rules_aq(rules, CONFIG_AQ_USB_RX_FILTER_MAX_RULES, &nrules);
+    uint32_t mdns_hits = 0;
+    for (size_t i = 0; i < nrules; i++) {
+        if (rules[i].rule.type == USB_NETIF_RX_RULE_GROUP_AQ && rules[i].rule.addr[3] == 251) mdns_hits = rules[i].hits;
+    }
+    ESP_ERROR_CHECK(usb_netif_rx_filter_leave_ip4_aq(mdns));
+    errors += usb_rx_filter_pass_aq(s_fb[FB_MDNS4].frame, FB_FRAME_LEN);
+    errors += usb_netif_rx_filter_leave_ip4_aq(mdns) != ESP_ERR_NOT_FOUND;
+    printf("RESULT filter runtime_rule=mdns4 hits=%u%s\n", mdns_hits, mdns_hits == 3 ? "" : " UNEXPECTED");
+    errors += mdns_hits != 3;
+
+    // 4. Escritor sin pausa contra el lector: nunca un veredicto contrario a una regla
+    //    estable; mdns4 solo pasa cuando el lector se rindió (unfiltered)
+    usb_netif_rx_filter_get_stats_aq(&fs);
+    uint32_t unfiltered0 = fs.unfiltered;
+    pthread_t writer;
+    s_fb_writer_stop = false;
+    pthread_create(&writer, NULL, fb_writer, NULL);
+    uint32_t n_race = s_packets * 5, wrong = 0, mdns_passed = 0;
+    for (uint32_t i = 0; i < n_race; i++) {
+        wrong += !usb_rx_filter_pass_aq(s_fb[FB_TCP].frame, FB_FRAME_LEN);
+        mdns_passed += usb_rx_filter_pass_aq(s_fb[FB_MDNS4].frame, FB_FRAME_LEN);
+        usb_rx_filter_pass_aq(s_fb[FB_SSDP].frame, FB_FRAME_LEN);
+    }
+    __atomic_store_n(&s_fb_writer_stop, true, __ATOMIC_RELAXED);
+    pthread_join(writer, NULL);
+    usb_netif_rx_filter_get_stats_aq(&fs);
+    uint32_t unfiltered = fs.unfiltered - unfiltered0;
+    bool race_ok = wrong == 0 && mdns_passed <= unfiltered && fs.rules == (uint32_t)(4 + 3 * CONFIG_AQ_USB_RX_FILTER_IPV6);
+    printf("RESULT filter concurrent_updates=%u lookups=%u wrong=%u unfiltered=%u%s\n", s_fb_updates, n_race * 3,
+           wrong, unfiltered, race_ok ? "" : " UNEXPECTED");
+    errors += !race_ok;
+    usb_netif_rx_filter_reset_aq();
+
+    // 5. Callback completo ante ráfagas de charla: FB_BURST tramas multicast/broadcast y
+    //    luego una real, sin dejar correr a usb_rx_task en medio (así llegan en un NTB)
+    ESP_ERROR_CHECK(usb_rx_start_aq((esp_netif_t *)&netif));
+    static const int chatter[] = { FB_MDNS4, FB_LLMNR, FB_SSDP, FB_NETBIOS, FB_RA, FB_NS, FB_MDNS6, FB_MLD };
+    uint32_t rounds = s_packets / (FB_BURST + 1);
+    usb_netif_rx_filter_get_stats_aq(&fs);
+    uint32_t filtered0 = fs.dropped[USB_NETIF_RX_FILTER_ETHERTYPE_AQ] + fs.dropped[USB_NETIF_RX_FILTER_GROUP_AQ];
+    for (int on = 0; on <= 1; on++) {
+        usb_netif_rx_filter_enable_aq(on);
+        usb_stats_reset_aq();
+        atomic_store(&s_fb_real, 0);
+        atomic_store(&s_fb_other, 0);
+        int64_t busy = 0;
+        for (uint32_t r = 0; r < rounds; r++) {
+            int64_t t0 = now_ns();
+            for (int i = 0; i < FB_BURST; i++) {
+                fb_frame_t *f = &s_fb[chatter[(r + i) % (sizeof(chatter) / sizeof(chatter[0]))]];
+                usb_rx_input_aq(f->frame, FB_FRAME_LEN, NULL);
+            }
+            usb_rx_input_aq(s_fb[FB_UDP].frame, FB_FRAME_LEN, NULL);
+            busy += now_ns() - t0;
+            uint32_t used, cap;
+            do {
+                sched_yield();
+                usb_rx_ring_usage_aq(&used, &cap);
+            } while (used);
+        }
+        // La última trama sacada del anillo puede estar aún camino del sumidero
+        usb_netif_stats_aq_t st;
+        usb_stats_snapshot_aq(&st);
+        usb_netif_rx_filter_get_stats_aq(&fs);
+        uint32_t filtered = fs.dropped[USB_NETIF_RX_FILTER_ETHERTYPE_AQ] + fs.dropped[USB_NETIF_RX_FILTER_GROUP_AQ];
+        uint32_t queued = rounds * (FB_BURST + 1) - (on ? filtered - filtered0 : 0) -
+                          st.drops[USB_NETIF_DROP_RX_QUEUE_FULL_AQ] - st.drops[USB_NETIF_DROP_RX_ALLOC_FAIL_AQ];
+        while (atomic_load(&s_fb_real) + atomic_load(&s_fb_other) < queued) {
+            sched_yield();
+        }
+        printf("RESULT filter callback=%s frames=%u callback_ns=%.1f real_delivered=%u/%u chatter_to_lwip=%u "
+               "ring_full=%u\n",
+               on ? "on" : "off", rounds * (FB_BURST + 1), (double)busy / (rounds * (FB_BURST + 1)),
+               atomic_load(&s_fb_real), rounds, atomic_load(&s_fb_other), st.drops[USB_NETIF_DROP_RX_QUEUE_FULL_AQ]);
+        if (on) errors += atomic_load(&s_fb_real) != rounds || atomic_load(&s_fb_other) != 0;
+    }
+    usb_netif_rx_filter_get_stats_aq(&fs);
+    printf("filter counters: passed %u, dropped runt %u ethertype %u group %u, unfiltered %u\n", fs.passed,
+           fs.dropped[USB_NETIF_RX_FILTER_RUNT_AQ], fs.dropped[USB_NETIF_RX_FILTER_ETHERTYPE_AQ],
+           fs.dropped[USB_NETIF_RX_FILTER_GROUP_AQ], fs.unfiltered);
+    printf("RESULT filter check=%s\n", errors ? "FAIL" : "ok");
+    return errors ? 1 : 0;
+}
+
+// ---------- control de flujo RX: transferencia TCP del MASTER al panel ----------
+//
+// El MASTER manda un fichero (OTA) por TCP a través del enlace full speed simulado. El
+// panel consume cada segmento con un coste fijo y, cada FL_STALL_EVERY segmentos, se para
+// FL_STALL_MS como al borrar flash: durante la parada el enlace trae más tramas de las que
+// caben en el anillo RX. Sin control de flujo (esp_tinyusb tal cual) las que no caben se
+// pierden y el emisor recupera con fast retransmit o RTO; con él, el host recibe NAK.
+// El emisor es un TCP Reno simplificado: slow start y evitación de congestión, fast
+// retransmit con 3 ACK duplicados, retroceso hasta el primer hueco (el receptor no guarda
+// fuera de orden) y RTO mínimo de 200 ms como Linux. Los ACK vuelven al MASTER FL_ACK_US
+// después de generarse (NTB IN agregado + sondeo del host), como en el enlace real.
+
+#define FL_RWND        44      // ventana anunciada en segmentos (~64 KB)
+#define FL_IW          10      // ventana inicial (RFC 6928)
+#define FL_RTO_MIN_NS  200000000LL
+#define FL_APP_NS      300000  // coste de tcpip + aplicación por segmento
+#define FL_STALL_EVERY 32
+#define FL_STALL_MS    25
+#define FL_ACK_US      2000
+#define FL_SEQ_OFFSET  (ETH_HDR_LEN + IP_HDR_LEN + 20)
+#define FL_ACK_RING    8192
+
+typedef struct {
+    uint32_t sent;           // segmentos puestos en el cable, retransmisiones incluidas
+    uint32_t retransmits;
+    uint32_t fast_rtx;
+    uint32_t timeouts;
+    uint32_t naks;           // veces que el host encontró el endpoint en pausa
+    int64_t t0_ns, t1_ns;
+} flow_result_t;
+
+static uint8_t s_fl_frame[TCP_MSS + FL_SEQ_OFFSET];
+static bool s_fl_flow;                 // esta vuelta usa usb_rx_input_flow_aq
+// ACK generados por el receptor, en orden: el emisor los aplica FL_ACK_US más tarde
+typedef struct {
+    int64_t t_ns;
+    uint32_t ack;            // rcv_nxt
+    uint32_t dups;           // segmentos fuera de orden recibidos hasta ahora
+} fl_ack_t;
+
+static fl_ack_t s_fl_acks[FL_ACK_RING];
+static atomic_uint s_fl_nacks;
+static uint32_t s_fl_rcv_nxt, s_fl_dups;  // estado del receptor (solo usb_rx_task)
+static int64_t s_fl_app_due;           // reloj del consumidor (solo usb_rx_task)
+static pthread_mutex_t s_fl_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_fl_cond = PTHREAD_COND_INITIALIZER;
+static bool s_fl_paused;               // endpoint OUT sin armar: el host recibe NAK
+
+// Hace de lwIP + aplicación: solo acepta el siguiente segmento en orden
+static esp_err_t fl_sink(const void *buffer, size_t len) {
+    uint32_t seq;
+    memcpy(&seq, (const uint8_t *)buffer + FL_SEQ_OFFSET, sizeof(seq));
+    if (seq == s_fl_rcv_nxt) {
+        int64_t now = now_ns();
+        if (s_fl_app_due < now) s_fl_app_due = now;
+        s_fl_app_due += FL_APP_NS;
+        if ((seq + 1) % FL_STALL_EVERY == 0) s_fl_app_due += FL_STALL_MS * 1000000LL;
+        struct timespec ts = { .tv_sec = s_fl_app_due / 1000000000, .tv_nsec = s_fl_app_due % 1000000000 };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        s_fl_rcv_nxt++;
+    } else if (seq > s_fl_rcv_nxt) {
+        s_fl_dups++;
+    }
+    // Cada segmento genera un ACK (los repetidos son los duplicados que ve el emisor)
+    uint32_t n = atomic_load_explicit(&s_fl_nacks, memory_order_relaxed);
+    s_fl_acks[n % FL_ACK_RING] = (fl_ack_t){ .t_ns = now_ns(), .ack = s_fl_rcv_nxt, .dups = s_fl_dups };
+    atomic_store_explicit(&s_fl_nacks, n + 1, memory_order_release);
+    return ESP_OK;
+}
+
+// En el dispositivo es usbd_defer_func(tud_network_recv_renew): el host deja de recibir NAK
+static void fl_resume(void) {
+    pthread_mutex_lock(&s_fl_lock);
+    s_fl_paused = false;
+    pthread_cond_signal(&s_fl_cond);
+    pthread_mutex_unlock(&s_fl_lock);
+}
+
+// Un segmento por el enlace: espera a que el endpoint esté armado, ocupa el cable y
+// entrega al callback como haría TinyUSB
+static bool fl_transmit(uint32_t seq, flow_result_t *r) {
+    if (s_fl_flow) {
+        struct timespec to;
+        clock_gettime(CLOCK_REALTIME, &to);
+        to.tv_sec += 2;
+        pthread_mutex_lock(&s_fl_lock);
+        r->naks += s_fl_paused;
+        int rc = 0;
+        while (s_fl_paused && rc == 0) {
+            rc = pthread_cond_timedwait(&s_fl_cond, &s_fl_lock, &to);
+        }
+        pthread_mutex_unlock(&s_fl_lock);
+        if (rc != 0) {
+            fprintf(stderr, "flow: reception not resumed after 2 s\n");
+            return false;
+        }
+    }
+    wire_wait(TCP_MSS + NCM_SEG_OVERHEAD);
+    memcpy(s_fl_frame + FL_SEQ_OFFSET, &seq, sizeof(seq));
+    if (s_fl_flow) {
+        // La pausa se marca antes de que el consumidor pueda reanudar
+        pthread_mutex_lock(&s_fl_lock);
+        if (!usb_rx_input_flow_aq(s_fl_frame, sizeof(s_fl_frame))) s_fl_paused = true;
+        pthread_mutex_unlock(&s_fl_lock);
+    } else {
+        // esp_tinyusb: on_recv_callback y tud_network_recv_renew pase lo que pase
+        usb_rx_input_aq(s_fl_frame, sizeof(s_fl_frame), NULL);
+    }
+    r->sent++;
+    return true;
+}
+
+static bool fl_send_file(uint32_t segs, flow_result_t *r) {
+    uint32_t snd_una = 0, snd_nxt = 0, high = 0, recover = 0, dup_base = 0;
+    uint32_t ack = 0, dups = 0, nread = 0;
+    double cwnd = FL_IW, ssthresh = FL_RWND;
+    bool recovery = false;
+    int64_t rto = FL_RTO_MIN_NS;
+    int64_t last_progress = now_ns();
+    r->t0_ns = last_progress;
+    while (snd_una < segs) {
+        int64_t now = now_ns();
+        uint32_t nacks = atomic_load_explicit(&s_fl_nacks, memory_order_acquire);
+        while (nread < nacks && s_fl_acks[nread % FL_ACK_RING].t_ns + FL_ACK_US * 1000LL <= now) {
+            ack = s_fl_acks[nread % FL_ACK_RING].ack;
+            dups = s_fl_acks[nread % FL_ACK_RING].dups;
+            nread++;
+        }
+        if (ack > snd_una) {
+            for (uint32_t i = snd_una; i < ack; i++) {
+                cwnd += cwnd < ssthresh ? 1.0 : 1.0 / cwnd;
+            }
+            if (cwnd > FL_RWND) cwnd = FL_RWND;
+            snd_una = ack;
+            if (snd_nxt < snd_una) snd_nxt = snd_una;
+            if (recovery && snd_una >= recover) recovery = false;
+            dup_base = dups;
+            rto = FL_RTO_MIN_NS;
+            last_progress = now;
+        } else if (!recovery && snd_nxt > snd_una && dups - dup_base >= 3) {
+            ssthresh = (snd_nxt - snd_una) / 2.0 > 2 ? (snd_nxt - snd_una) / 2.0 : 2;
+            cwnd = ssthresh;
+            recover = snd_nxt;
+            recovery = true;
+            snd_nxt = snd_una;
+            dup_base = dups;
+            r->fast_rtx++;
+        } else if (snd_nxt > snd_una && now - last_progress > rto) {
+            ssthresh = (snd_nxt - snd_una) / 2.0 > 2 ? (snd_nxt - snd_una) / 2.0 : 2;
+            cwnd = 1;
+            recover = snd_nxt;
+            recovery = true;
+            snd_nxt = snd_una;
+            dup_base = dups;
+            rto *= 2;
+            last_progress = now;
+            r->timeouts++;
+        }
+        if (snd_nxt < segs && snd_nxt - snd_una < (uint32_t)cwnd) {
+            if (snd_nxt < high) r->retransmits++;
+            if (!fl_transmit(snd_nxt, r)) return false;
+            if (++snd_nxt > high) high = snd_nxt;
+        } else {
+            struct timespec ts = { 0, 20000 };
+            nanosleep(&ts, NULL);
+        }
+    }
+    r->t1_ns = now_ns();
+    return true;
+}
+
+static int run_flow_bench(uint32_t segs) {
+    int errors = 0;
+    static struct { int dummy; } netif;
+    memset(s_fl_frame, 0, sizeof(s_fl_frame));
+    const uint8_t dst[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 }, src[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+    memcpy(s_fl_frame, dst, 6);
+    memcpy(s_fl_frame + 6, src, 6);
+    put16(s_fl_frame + 12, 0x0800);
+    s_fl_frame[ETH_HDR_LEN] = 0x45;
+    put16(s_fl_frame + ETH_HDR_LEN + 2, TCP_MSS + IP_HDR_LEN + 20);
+    s_fl_frame[ETH_HDR_LEN + 8] = 64;
+    s_fl_frame[ETH_HDR_LEN + 9] = 6;
+    mock_set_rx_sink_aq(fl_sink, usb_rx_free_aq);
+    usb_dlog_init_aq();
+    ESP_ERROR_CHECK(usb_rx_init_aq());
+    usb_rx_set_resume_aq(fl_resume);
+    ESP_ERROR_CHECK(usb_rx_start_aq((esp_netif_t *)&netif));
+
+    printf("flow: %u segments of %u B over full speed, ring %u, pool %u, app %u us/segment + %u ms every %u, "
+           "rwnd %u, ack delay %u us\n", segs, TCP_MSS, CONFIG_AQ_USB_RX_RING_LEN, CONFIG_AQ_USB_RX_POOL_SIZE,
+           FL_APP_NS / 1000, FL_STALL_MS, FL_STALL_EVERY, FL_RWND, FL_ACK_US);
+    double goodput[2] = { 0 };
+    for (int flow = 0; flow < 2; flow++) {
+        s_fl_flow = flow;
+        s_fl_paused = false;
+        s_fl_app_due = 0;
+        s_fl_rcv_nxt = 0;
+        s_fl_dups = 0;
+        atomic_store(&s_fl_nacks, 0);
+        s_wire_t0_ns = 0;
+        s_wire_pkts = 0;
+        usb_stats_reset_aq();
+        flow_result_t r = { 0 };
+        if (!fl_send_file(segs, &r)) {
+            errors++;
+            break;
+        }
+        // Los duplicados que aún queden en el anillo no cuentan para el fichero
+        uint32_t used, cap;
+        do {
+            sched_yield();
+            usb_rx_ring_usage_aq(&used, &cap);
+        } while (used);
+        usb_netif_stats_aq_t st;
+        usb_stats_snapshot_aq(&st);
+        double secs = (double)(r.t1_ns - r.t0_ns) / 1e9;
+        uint32_t drops = st.drops[USB_NETIF_DROP_RX_QUEUE_FULL_AQ] + st.drops[USB_NETIF_DROP_RX_ALLOC_FAIL_AQ];
+        goodput[flow] = (double)segs * TCP_MSS / secs / 1e3;
+        printf("RESULT flow mode=%s goodput_kBps=%.1f secs=%.2f wire_efficiency=%.3f drops=%u retransmits=%u "
+               "fast_rtx=%u rto=%u pauses=%u resumes=%u paused_ms=%.1f naks=%u\n",
+               flow ? "pause" : "drop", goodput[flow], secs, (double)segs / r.sent, drops, r.retransmits, r.fast_rtx,
+               r.timeouts, st.rx_pauses, st.rx_resumes, st.rx_paused_us / 1e3, r.naks);
+        if (flow) errors += drops != 0 || r.retransmits != 0 || st.rx_pauses != st.rx_resumes;
+    }
+    if (!errors) printf("RESULT flow gain=%.2fx\n", goodput[1] / goodput[0]);
+    printf("RESULT flow check=%s\n", errors ? "FAIL" : "ok");
+    return errors ? 1 : 0;
+}
+
+// ---------- informe ----------
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void print_hist(const char *name, const uint32_t *hist) {
+    printf("  %s log2 histogram (us):", name);
+    for (int i = 0; i < USB_NETIF_LAT_BUCKETS_AQ; i++) {
+        if (hist[i]) printf(" [%u..%u)=%u", i ? 1u << i : 0u, 2u << i, hist[i]);
+    }
+    printf("\n");
+}
+
+static void report(dir_result_t *r, const mock_heap_aq_t *h0, const mock_heap_aq_t *h1) {
+    uint32_t n = s_packets;
+    qsort(r->lat_ns, n, sizeof(uint32_t), cmp_u32);
+    double secs = (double)(r->t_end_ns - r->t_start_ns) / 1e9;
+    double pps = n / secs;
+    double mbps = (double)r->bytes * 8 / secs / 1e6;
+    double p50 = r->lat_ns[n / 2] / 1e3;
+    double p99 = r->lat_ns[(uint32_t)((uint64_t)n * 99 / 100)] / 1e3;
+    double max = r->lat_ns[n - 1] / 1e3;
+    double allocs = (double)(h1->allocs - h0->allocs) / n;
+    printf("%s: %u frames x %u B in %.3f s: %.0f pps, %.1f Mbit/s, latency p50 %.1f us, "
+           "p99 %.1f us, max %.1f us, backpressure retries %u\n",
+           r->name, n, s_frame_len, secs, pps, mbps, p50, p99, max, r->rejected);
+    printf("RESULT dir=%s pps=%.0f mbps=%.1f p50_us=%.1f p99_us=%.1f allocs_per_pkt=%.3f",
+           r->name, pps, mbps, p50, p99, allocs);
+    if (s_csum >= 0) {
+        printf(" csum=%s csum_ns_per_pkt=%.1f", csum_name(s_csum), (double)r->csum_ns / n);
+        if (r->cpu_ns) printf(" cpu_ns_per_pkt=%.1f", (double)r->cpu_ns / n);
+    }
+    printf("\n");
+}
+
+// ---------- tarea usb_device: bucle de sondeo frente a eventos (-m task) ----------
+//
+// Modela usb_device_task de usb_netif_aq.c con la cola de eventos de TinyUSB
+// (CFG_TUD_TASK_QUEUE_SZ = 16) sobre la cola del mock. Un hilo "host" hace de ping y de
+// ISR: encola la petición sellada, la tarea la despacha y la pasa a un hilo "tcpip" que
+// contesta (la misma ruta en los dos modos). Tras cada respuesta la ISR encola además
+// el fin de la transferencia IN, que no retrasa la respuesta pero sí despierta a la tarea.
+//   poll:  tud_task() vacía la cola y la tarea duerme hasta el siguiente tick (1 ms),
+//          como vTaskDelay(1) en FreeRTOS, no 1 ms desde ahora como el mock
+//   event: tud_task_ext(UINT32_MAX) bloquea en la cola hasta el siguiente evento
+// En reposo cuenta despertares/s y CPU de la tarea; "sof" es el modo event con el SOF
+// activado (timesync_aq), un evento por ms de bus.
+
+#define TK_QUEUE_LEN   16
+#define TK_IDLE_S      2
+#define TK_S3_WAKE_US  4   // coste supuesto de un despertar vacío en el S3 a 240 MHz (no medido)
+
+enum { TK_EV_STOP, TK_EV_PING, TK_EV_XFER, TK_EV_SOF };
+
+typedef struct {
+    int32_t kind;
+    int64_t t_ns;
+} tk_event_t;
+
+static QueueHandle_t s_tk_usb_q;      // cola de eventos de TinyUSB
+static QueueHandle_t s_tk_ip_q;       // mensajes hacia el hilo tcpip
+static QueueHandle_t s_tk_reply_q;    // respuestas de vuelta al host
+static bool s_tk_poll;
+static atomic_bool s_tk_stop;
+static atomic_uint s_tk_wakeups;
+static int64_t s_tk_t0_ns;
+
+static void tk_sleep_until(int64_t t_ns) {
+    struct timespec ts = { .tv_sec = t_ns / 1000000000, .tv_nsec = t_ns % 1000000000 };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {
+    }
+}
+
+static bool tk_dispatch(const tk_event_t *ev) {
+    if (ev->kind == TK_EV_STOP) return false;
+    if (ev->kind == TK_EV_PING) xQueueSend(s_tk_ip_q, ev, portMAX_DELAY);
+    return true;
+}
+
+static void *tk_usb_task(void *arg) {
+    (void)arg;
+    tk_event_t ev;
+    bool run = true;
+    while (run) {
+        if (s_tk_poll) {
+            while (run && xQueueReceive(s_tk_usb_q, &ev, 0)) {
+                run = tk_dispatch(&ev);
+            }
+            atomic_fetch_add(&s_tk_wakeups, 1);
+            if (atomic_load(&s_tk_stop)) break;
+            int64_t now = now_ns() - s_tk_t0_ns;
+            tk_sleep_until(s_tk_t0_ns + (now / 1000000 + 1) * 1000000);
+        } else {
+            xQueueReceive(s_tk_usb_q, &ev, portMAX_DELAY);
+            atomic_fetch_add(&s_tk_wakeups, 1);
+            run = tk_dispatch(&ev);
+            while (run && xQueueReceive(s_tk_usb_q, &ev, 0)) {
+                run = tk_dispatch(&ev);
+            }
+        }
+    }
+    return NULL;
+}
+
+static void *tk_tcpip(void *arg) {
+    (void)arg;
+    tk_event_t ev;
+    for (;;) {
+        xQueueReceive(s_tk_ip_q, &ev, portMAX_DELAY);
+        if (ev.kind == TK_EV_STOP) return NULL;
+        xQueueSend(s_tk_reply_q, &ev, portMAX_DELAY);
+    }
+}
+
+static void *tk_sof(void *arg) {
+    (void)arg;
+    int64_t due = now_ns();
+    while (!atomic_load(&s_tk_stop)) {
+        due += 1000000;
+        tk_sleep_until(due);
+        tk_event_t ev = { .kind = TK_EV_SOF, .t_ns = due };
+        xQueueSend(s_tk_usb_q, &ev, 0);
+    }
+    return NULL;
+}
+
+typedef struct {
+    double rtt_p50_us, rtt_p99_us, rtt_avg_us;
+    double idle_wakeups_s, idle_cpu_pct, s3_cpu_pct;
+    double ping_wakeups_s;
+} tk_result_t;
+
+static void tk_run(const char *name, bool poll, bool sof, uint32_t pings, uint32_t rate, tk_result_t *r) {
+    s_tk_poll = poll;
+    atomic_store(&s_tk_stop, false);
+    s_tk_usb_q = xQueueCreate(TK_QUEUE_LEN, sizeof(tk_event_t));
+    s_tk_ip_q = xQueueCreate(4, sizeof(tk_event_t));
+    s_tk_reply_q = xQueueCreate(4, sizeof(tk_event_t));
+    s_tk_t0_ns = now_ns();
+    pthread_t usb, ip, sof_thread;
+    pthread_create(&usb, NULL, tk_usb_task, NULL);
+    pthread_create(&ip, NULL, tk_tcpip, NULL);
+    if (sof) pthread_create(&sof_thread, NULL, tk_sof, NULL);
+
+    // Reposo: solo despertares y CPU de la tarea
+    tk_sleep_until(now_ns() + 100000000);
+    unsigned w0 = atomic_load(&s_tk_wakeups);
+    struct timespec c0, c1;
+    clockid_t cid;
+    pthread_getcpuclockid(usb, &cid);
+    clock_gettime(cid, &c0);
+    int64_t t0 = now_ns();
+    tk_sleep_until(t0 + (int64_t)TK_IDLE_S * 1000000000);
+    int64_t t1 = now_ns();
+    clock_gettime(cid, &c1);
+    unsigned w1 = atomic_load(&s_tk_wakeups);
+    double idle_s = (double)(t1 - t0) / 1e9;
+    double cpu_ns = (double)(c1.tv_sec - c0.tv_sec) * 1e9 + (double)(c1.tv_nsec - c0.tv_nsec);
+    r->idle_wakeups_s = (w1 - w0) / idle_s;
+    r->idle_cpu_pct = cpu_ns / (idle_s * 1e9) * 100;
+    r->s3_cpu_pct = r->idle_wakeups_s * TK_S3_WAKE_US / 1e6 * 100;
+
+    // ping -i 1/rate: cada petición llega con una fase aleatoria respecto al tick
+    uint32_t *rtt = calloc(pings, sizeof(uint32_t));
+    uint64_t sum = 0;
+    uint32_t seed = 0x2545F491u;
+    w0 = atomic_load(&s_tk_wakeups);
+    t0 = now_ns();
+    int64_t due = t0;
+    for (uint32_t i = 0; i < pings; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        tk_sleep_until(due + (int64_t)(seed % 1000) * 1000);
+        due += 1000000000 / rate;
+        tk_event_t ev = { .kind = TK_EV_PING, .t_ns = now_ns() };
+        xQueueSend(s_tk_usb_q, &ev, portMAX_DELAY);
+        xQueueReceive(s_tk_reply_q, &ev, portMAX_DELAY);
+        rtt[i] = (uint32_t)(now_ns() - ev.t_ns);
+        sum += rtt[i];
+        tk_event_t done = { .kind = TK_EV_XFER, .t_ns = now_ns() };
+        xQueueSend(s_tk_usb_q, &done, portMAX_DELAY);
+    }
+    t1 = now_ns();
+    r->ping_wakeups_s = (atomic_load(&s_tk_wakeups) - w0) / ((double)(t1 - t0) / 1e9);
+    qsort(rtt, pings, sizeof(uint32_t), cmp_u32);
+    r->rtt_p50_us = rtt[pings / 2] / 1e3;
+    r->rtt_p99_us = rtt[(uint32_t)((uint64_t)pings * 99 / 100)] / 1e3;
+    r->rtt_avg_us = (double)sum / pings / 1e3;
+    free(rtt);
+
+    atomic_store(&s_tk_stop, true);
+    if (sof) pthread_join(sof_thread, NULL);
+    tk_event_t stop = { .kind = TK_EV_STOP };
+    xQueueSend(s_tk_usb_q, &stop, portMAX_DELAY);
+    pthread_join(usb, NULL);
+    xQueueSend(s_tk_ip_q, &stop, portMAX_DELAY);
+    pthread_join(ip, NULL);
+    vQueueDelete(s_tk_usb_q);
+    vQueueDelete(s_tk_ip_q);
+    vQueueDelete(s_tk_reply_q);
+
+    printf("RESULT task mode=%s rtt_p50_us=%.1f rtt_avg_us=%.1f rtt_p99_us=%.1f idle_wakeups_s=%.0f "
+           "idle_cpu_pct=%.3f s3_idle_cpu_pct=%.2f ping_wakeups_s=%.0f\n",
+           name, r->rtt_p50_us, r->rtt_avg_us, r->rtt_p99_us, r->idle_wakeups_s, r->idle_cpu_pct, r->s3_cpu_pct,
+           r->ping_wakeups_s);
+}
+
+static int run_task_bench(uint32_t pings, uint32_t rate) {
+    printf("task: %u pings at %u/s per mode, idle %u s, tick 1 ms, event queue %u, S3 wakeup cost %u us (assumed)\n",
+           pings, rate, TK_IDLE_S, TK_QUEUE_LEN, TK_S3_WAKE_US);
+    tk_result_t poll, event, sof;
+    tk_run("poll", true, false, pings, rate, &poll);
+    tk_run("event", false, false, pings, rate, &event);
+    tk_run("event_sof", false, true, pings, rate, &sof);
+    printf("RESULT task rtt_saved_avg_us=%.1f\n", poll.rtt_avg_us - event.rtt_avg_us);
+    // El modo event no debe despertar sin trabajo ni perder contra el sondeo
+    bool ok = event.idle_wakeups_s < 1 && poll.idle_wakeups_s > 500 && event.rtt_avg_us < poll.rtt_avg_us;
+    printf("RESULT task check=%s\n", ok ? "ok" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-m rx|tx|both|log|stream|perf|filter|flow|task] [-n frames] [-s frame_len] [-r pps] [-c ctrl_every] [-b rx_batch]\n"
+            "          [-x full|trust_rx|min] [-v]\n"
+            "  -r 0 (default) runs as fast as the driver accepts frames\n"
+            "  -c N marks every Nth TX frame with DSCP EF (control class)\n"
+            "  -b N datagrams per OUT NTB on the RX side\n"
+            "  -m log measures the deferred log ring alone (-n records per producer)\n"
+            "  -m stream compares the vendor channel with MQTT over TCP (-n blocks, -s payload bytes,\n"
+            "            -r blocks/s for the CPU run, default 75%% of the link)\n"
+            "  -m perf checks the iperf 2 UDP accounting and report of the benchmark service, then measures\n"
+            "          its UDP sink (-n datagrams) and UDP echo (-n/10 round trips) on loopback\n"
+            "  -m filter measures the RX filter per frame type, under concurrent rule updates and in the\n"
+            "            RX callback against bursts of host multicast (-n frames)\n"
+            "  -m flow compares TCP goodput from the MASTER with RX drops against RX flow control\n"
+            "          (-n segments, default 2048)\n"
+            "  -m task models the usb_device task in polling and event-driven mode: idle wakeups/CPU and\n"
+            "          ping round trip (-n pings, default 1000, -r pings/s, default 100)\n"
+            "  -x checksum work of a usb_netif_csum_profile_aq_t at the lwIP ends (default: none)\n"
+            "  -v print driver warnings/errors (one per dropped frame under overload)\n", prog);
+}
+
+int main(int argc, char **argv) {
+    const char *mode = "both";
+    bool len_set = false, n_set = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "m:n:s:r:c:b:x:vh")) != -1) {
+        switch (opt) {
+        case 'm': mode = optarg; break;
+        case 'n': s_packets = (uint32_t)strtoul(optarg, NULL, 0); n_set = true; break;
+        case 's': s_frame_len = (uint16_t)strtoul(optarg, NULL, 0); len_set = true; break;
+        case 'r': s_rate_pps = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'c': s_ctrl_every = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'b': s_rx_batch = (uint16_t)strtoul(optarg, NULL, 0); break;
+        case 'x':
+            s_csum = csum_parse(optarg);
+            if (s_csum < 0) {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        case 'v': g_mock_log_verbose_aq = true; break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (strcmp(mode, "log") == 0) {
+        return run_log_bench();
+    }
+    if (strcmp(mode, "filter") == 0) {
+        return s_packets ? run_filter_bench() : 2;
+    }
+    if (strcmp(mode, "flow") == 0) {
+        return s_packets ? run_flow_bench(n_set ? s_packets : 2048) : 2;
+    }
+    if (strcmp(mode, "task") == 0) {
+        uint32_t rate = s_rate_pps ? s_rate_pps : 100;
+        return s_packets && rate <= 1000 ? run_task_bench(n_set ? s_packets : 1000, rate) : 2;
+    }
+    if (strcmp(mode, "perf") == 0) {
+        return s_packets ? run_perf_bench() : 2;
+    }
+    if (strcmp(mode, "stream") == 0) {
+        s_stream_len = len_set ? s_frame_len : CONFIG_AQ_USB_VENDOR_BLOCK_SIZE;
+        if (s_packets == 0 || s_stream_len < 2 || s_stream_len > CONFIG_AQ_USB_VENDOR_BLOCK_SIZE) {
+            usage(argv[0]);
+            return 2;
+        }
+        return run_stream_bench(s_rate_pps);
+    }
+    bool do_rx = strcmp(mode, "tx") != 0;
+    bool do_tx = strcmp(mode, "rx") != 0;
+    if (s_packets == 0 || s_frame_len < MIN_FRAME || s_frame_len > MAX_FRAME ||
+        s_rx_batch == 0 || s_rx_batch > NCM_NTB_MAX_DATAGRAMS) {
+        usage(argv[0]);
+        return 2;
+    }
+    build_template();
+    s_rx.lat_ns = calloc(s_packets, sizeof(uint32_t));
+    s_tx.lat_ns = calloc(s_packets, sizeof(uint32_t));
+    if (s_rx.lat_ns == NULL || s_tx.lat_ns == NULL) return 1;
+
+    static struct { int dummy; } netif;
+    mock_set_rx_sink_aq(rx_sink, usb_rx_free_aq);
+    mock_set_tx_sink_aq(tx_sink);
+    mock_heap_aq_t hs;
+    mock_heap_get_aq(&hs);
+    usb_dlog_init_aq();
+    ESP_ERROR_CHECK(usb_rx_init_aq());
+    ESP_ERROR_CHECK(usb_tx_init_aq());
+    ESP_ERROR_CHECK(usb_rx_start_aq((esp_netif_t *)&netif));
+    ESP_ERROR_CHECK(usb_tx_start_aq());
+
+    // Churn del heap medido solo durante el tráfico, tras las reservas de arranque
+    mock_heap_aq_t h0, h1;
+    mock_heap_get_aq(&h0);
+    usb_netif_mem_report_aq_t mem;
+    usb_mem_report_aq(&mem);
+    // Reservas de arranque de rx/tx (pool, anillos; esp_timer del mock incluido)
+    printf("RESULT setup static=%d heap_allocs=%llu heap_bytes=%llu bss_bytes=%u\n", mem.static_alloc,
+           (unsigned long long)(h0.allocs - hs.allocs), (unsigned long long)(h0.bytes - hs.bytes),
+           (unsigned)mem.bytes_static);
+    pthread_t rx_thread, tx_thread, log_thread;
+    pthread_create(&log_thread, NULL, log_consumer, NULL);
+    if (do_rx) pthread_create(&rx_thread, NULL, rx_producer, NULL);
+    if (do_tx) pthread_create(&tx_thread, NULL, tx_producer, NULL);
+    if (do_rx) pthread_join(rx_thread, NULL);
+    if (do_tx) pthread_join(tx_thread, NULL);
+    while ((do_rx && atomic_load(&s_rx.done) < s_packets) || (do_tx && atomic_load(&s_tx.done) < s_packets)) {
+        sched_yield();
+    }
+    mock_heap_get_aq(&h1);
+    atomic_store(&s_log_stop, true);
+    pthread_join(log_thread, NULL);
+
+    usb_netif_stats_aq_t st;
+    usb_stats_snapshot_aq(&st);
+    if (do_rx) report(&s_rx, &h0, &h1);
+    if (do_tx) report(&s_tx, &h0, &h1);
+    printf("heap during traffic: %llu allocs, %llu frees, %llu bytes\n",
+           (unsigned long long)(h1.allocs - h0.allocs), (unsigned long long)(h1.frees - h0.frees),
+           (unsigned long long)(h1.bytes - h0.bytes));
+    printf("driver: rx queue high-water %u, drops:", st.rx_queue_high_water);
+    for (int i = 0; i < USB_NETIF_DROP_COUNT_AQ; i++) {
+        printf(" %u", st.drops[i]);
+    }
+    printf("\n");
+    if (do_rx) print_hist("rx", st.rx_latency_us);
+    if (do_tx) print_hist("tx", st.tx_latency_us);
+    usb_netif_log_stats_aq_t ls;
+    usb_dlog_stats_aq(&ls);
+    printf("log (level %d): %u records, %u dropped, %llu formatted, ring high-water %u\n", CONFIG_AQ_USB_LOG_LEVEL,
+           ls.recorded, ls.dropped, (unsigned long long)s_log_formatted, ls.ring_high_water);
+    if (s_csum == USB_NETIF_CSUM_FULL_AQ && do_rx) {
+        printf("RESULT rx_csum_errors=%u\n", s_csum_errors);
+        if (s_csum_errors) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,5 @@
+#pragma once
+// Atributos de sección de IDF: en el host todo es memoria normal
+#define WORD_ALIGNED_ATTR __attribute__((aligned(4)))
+#define DMA_ATTR          WORD_ALIGNED_ATTR
+#define EXT_RAM_BSS_ATTR
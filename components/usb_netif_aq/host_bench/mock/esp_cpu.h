@@ -0,0 +1,5 @@
+#pragma once
+// Núcleo actual: en el host no hay afinidad, todo cuenta como núcleo 0
+static inline int esp_cpu_get_core_id(void) {
+    return 0;
+}
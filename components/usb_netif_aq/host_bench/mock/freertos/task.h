@@ -0,0 +1,20 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+typedef struct { uint8_t opaque[352]; } StaticTask_t;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *out, BaseType_t core);
+#define xTaskCreate(fn, name, stack, arg, prio, out) \
+    xTaskCreatePinnedToCore(fn, name, stack, arg, prio, out, tskNO_AFFINITY)
+// Los buffers se ignoran: la tarea es un pthread igual que las dinámicas
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                           UBaseType_t prio, StackType_t *stack_buf, StaticTask_t *tcb,
+                                           BaseType_t core);
+// Sin pila medible en pthreads: siempre 0
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+void     vTaskDelete(TaskHandle_t task);
+void     vTaskDelay(TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks);
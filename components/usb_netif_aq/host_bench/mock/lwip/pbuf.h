@@ -0,0 +1,30 @@
+#pragma once
+#include <stdint.h>
+
+typedef uint16_t u16_t;
+typedef uint8_t  u8_t;
+
+typedef enum { PBUF_TRANSPORT, PBUF_IP, PBUF_LINK, PBUF_RAW_TX, PBUF_RAW } pbuf_layer;
+typedef enum { PBUF_RAM, PBUF_ROM, PBUF_REF, PBUF_POOL } pbuf_type;
+
+#define PBUF_FLAG_IS_CUSTOM 0x02U
+
+struct pbuf {
+    struct pbuf *next;
+    void *payload;
+    u16_t tot_len;
+    u16_t len;
+    u8_t flags;
+    volatile int ref;
+};
+
+// Como en lwIP: el benchmark hace de stack con sus propios pbufs preasignados
+struct pbuf_custom {
+    struct pbuf pbuf;
+    void (*custom_free_function)(struct pbuf *p);
+};
+
+// pbuf_alloc cuenta como reserva de heap (el driver solo la usa en la ruta de copia)
+struct pbuf *pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type);
+void         pbuf_ref(struct pbuf *p);
+u8_t         pbuf_free(struct pbuf *p);
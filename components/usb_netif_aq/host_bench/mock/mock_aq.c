@@ -0,0 +1,422 @@
+#include <errno.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "mock_aq.h"
+#include "esp_event.h"
+#include "esp_heap_caps.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "tinyusb_net.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "lwip/pbuf.h"
+
+// ---------- heap ----------
+
+static atomic_ullong s_allocs, s_frees, s_alloc_bytes;
+
+void *heap_caps_malloc(size_t size, uint32_t caps) {
+    (void)caps;
+    atomic_fetch_add(&s_allocs, 1);
+    atomic_fetch_add(&s_alloc_bytes, size);
+    return malloc(size);
+}
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps) {
+    void *p = heap_caps_malloc(n * size, caps);
+    if (p) memset(p, 0, n * size);
+    return p;
+}
+
+void heap_caps_free(void *ptr) {
+    if (ptr == NULL) return;
+    atomic_fetch_add(&s_frees, 1);
+    free(ptr);
+}
+
+void mock_heap_get_aq(mock_heap_aq_t *out) {
+    out->allocs = atomic_load(&s_allocs);
+    out->frees = atomic_load(&s_frees);
+    out->bytes = atomic_load(&s_alloc_bytes);
+}
+
+// ---------- tiempo ----------
+
+int64_t esp_timer_get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void deadline_after(struct timespec *ts, uint64_t us) {
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += us / 1000000;
+    ts->tv_nsec += (long)(us % 1000000) * 1000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+static void cond_init_monotonic(pthread_cond_t *c) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(c, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static void unlock_cleanup(void *m) {
+    pthread_mutex_unlock((pthread_mutex_t *)m);
+}
+
+// Espera en c con el timeout en ticks (ms) de FreeRTOS. false si venció.
+static bool cond_wait_ticks(pthread_cond_t *c, pthread_mutex_t *m, TickType_t ticks,
+                            const struct timespec *deadline) {
+    if (ticks == portMAX_DELAY) {
+        pthread_cond_wait(c, m);
+        return true;
+    }
+    return pthread_cond_timedwait(c, m, deadline) != ETIMEDOUT;
+}
+
+// ---------- tareas ----------
+
+struct mock_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+};
+
+static __thread struct mock_task *s_current;
+
+static void *task_entry(void *p) {
+    struct mock_task *t = p;
+    s_current = t;
+    t->fn(t->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *out, BaseType_t core) {
+    (void)name; (void)stack; (void)prio; (void)core;
+    struct mock_task *t = calloc(1, sizeof(*t));
+    if (t == NULL) return pdFAIL;
+    t->fn = fn;
+    t->arg = arg;
+    pthread_mutex_init(&t->lock, NULL);
+    cond_init_monotonic(&t->cond);
+    if (pthread_create(&t->thread, NULL, task_entry, t) != 0) {
+        free(t);
+        return pdFAIL;
+    }
+    if (out) *out = t;
+    return pdPASS;
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                           UBaseType_t prio, StackType_t *stack_buf, StaticTask_t *tcb,
+                                           BaseType_t core) {
+    (void)stack_buf; (void)tcb;
+    TaskHandle_t h = NULL;
+    xTaskCreatePinnedToCore(fn, name, stack, arg, prio, &h, core);
+    return h;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    (void)task;
+    return 0;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL) pthread_exit(NULL);
+    pthread_cancel(task->thread);
+    pthread_join(task->thread, NULL);
+    free(task);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    struct timespec ts = { .tv_sec = ticks / 1000, .tv_nsec = (long)(ticks % 1000) * 1000000 };
+    if (ticks == 0) {
+        sched_yield();
+    } else {
+        nanosleep(&ts, NULL);
+    }
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+    struct mock_task *t = s_current;
+    struct timespec deadline;
+    deadline_after(&deadline, (uint64_t)ticks * 1000);
+    uint32_t val;
+    pthread_mutex_lock(&t->lock);
+    pthread_cleanup_push(unlock_cleanup, &t->lock);
+    while (t->notify == 0 && ticks != 0) {
+        if (!cond_wait_ticks(&t->cond, &t->lock, ticks, &deadline)) break;
+    }
+    val = t->notify;
+    if (val) t->notify = clear_on_exit ? 0 : val - 1;
+    pthread_cleanup_pop(1);
+    return val;
+}
+
+// ---------- colas ----------
+
+struct mock_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    uint8_t *storage;
+    UBaseType_t length, item_size, head, count;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    struct mock_queue *q = calloc(1, sizeof(*q));
+    if (q == NULL) return NULL;
+    q->storage = malloc((size_t)length * item_size);
+    if (q->storage == NULL) {
+        free(q);
+        return NULL;
+    }
+    q->length = length;
+    q->item_size = item_size;
+    pthread_mutex_init(&q->lock, NULL);
+    cond_init_monotonic(&q->not_empty);
+    cond_init_monotonic(&q->not_full);
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q) {
+    free(q->storage);
+    free(q);
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks) {
+    struct timespec deadline;
+    deadline_after(&deadline, (uint64_t)ticks * 1000);
+    BaseType_t ok = pdFALSE;
+    pthread_mutex_lock(&q->lock);
+    pthread_cleanup_push(unlock_cleanup, &q->lock);
+    while (q->count == q->length && ticks != 0) {
+        if (!cond_wait_ticks(&q->not_full, &q->lock, ticks, &deadline)) break;
+    }
+    if (q->count < q->length) {
+        UBaseType_t tail = (q->head + q->count) % q->length;
+        memcpy(q->storage + (size_t)tail * q->item_size, item, q->item_size);
+        q->count++;
+        pthread_cond_signal(&q->not_empty);
+        ok = pdTRUE;
+    }
+    pthread_cleanup_pop(1);
+    return ok;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks) {
+    struct timespec deadline;
+    deadline_after(&deadline, (uint64_t)ticks * 1000);
+    BaseType_t ok = pdFALSE;
+    pthread_mutex_lock(&q->lock);
+    pthread_cleanup_push(unlock_cleanup, &q->lock);
+    while (q->count == 0 && ticks != 0) {
+        if (!cond_wait_ticks(&q->not_empty, &q->lock, ticks, &deadline)) break;
+    }
+    if (q->count) {
+        memcpy(item, q->storage + (size_t)q->head * q->item_size, q->item_size);
+        q->head = (q->head + 1) % q->length;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+        ok = pdTRUE;
+    }
+    pthread_cleanup_pop(1);
+    return ok;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t n = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+// ---------- esp_timer: un hilo por timer ----------
+
+struct esp_timer {
+    esp_timer_create_args_t args;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct timespec due;
+    uint64_t period_us;
+    bool armed;
+    bool quit;
+};
+
+static void *timer_thread(void *p) {
+    struct esp_timer *t = p;
+    pthread_mutex_lock(&t->lock);
+    while (!t->quit) {
+        if (!t->armed) {
+            pthread_cond_wait(&t->cond, &t->lock);
+            continue;
+        }
+        if (pthread_cond_timedwait(&t->cond, &t->lock, &t->due) != ETIMEDOUT) {
+            continue;  // rearmado, parado o borrado: reevaluar
+        }
+        if (t->period_us) {
+            deadline_after(&t->due, t->period_us);
+        } else {
+            t->armed = false;
+        }
+        pthread_mutex_unlock(&t->lock);
+        t->args.callback(t->args.arg);
+        pthread_mutex_lock(&t->lock);
+    }
+    pthread_mutex_unlock(&t->lock);
+    return NULL;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out) {
+    struct esp_timer *t = calloc(1, sizeof(*t));
+    if (t == NULL) return ESP_ERR_NO_MEM;
+    t->args = *args;
+    pthread_mutex_init(&t->lock, NULL);
+    cond_init_monotonic(&t->cond);
+    if (pthread_create(&t->thread, NULL, timer_thread, t) != 0) {
+        free(t);
+        return ESP_ERR_NO_MEM;
+    }
+    *out = t;
+    return ESP_OK;
+}
+
+static esp_err_t timer_arm(esp_timer_handle_t t, uint64_t us, uint64_t period_us) {
+    pthread_mutex_lock(&t->lock);
+    esp_err_t err = t->armed ? ESP_ERR_INVALID_STATE : ESP_OK;
+    if (err == ESP_OK) {
+        deadline_after(&t->due, us);
+        t->period_us = period_us;
+        t->armed = true;
+        pthread_cond_signal(&t->cond);
+    }
+    pthread_mutex_unlock(&t->lock);
+    return err;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t t, uint64_t timeout_us) {
+    return timer_arm(t, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t t, uint64_t period_us) {
+    return timer_arm(t, period_us, period_us);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t t) {
+    pthread_mutex_lock(&t->lock);
+    esp_err_t err = t->armed ? ESP_OK : ESP_ERR_INVALID_STATE;
+    t->armed = false;
+    pthread_cond_signal(&t->cond);
+    pthread_mutex_unlock(&t->lock);
+    return err;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t t) {
+    pthread_mutex_lock(&t->lock);
+    t->quit = true;
+    pthread_cond_signal(&t->cond);
+    pthread_mutex_unlock(&t->lock);
+    pthread_join(t->thread, NULL);
+    free(t);
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t t) {
+    pthread_mutex_lock(&t->lock);
+    bool armed = t->armed;
+    pthread_mutex_unlock(&t->lock);
+    return armed;
+}
+
+// ---------- esp_event ----------
+
+// En el firmware la define usb_link_aq.c, que no entra en el build de host
+ESP_EVENT_DEFINE_BASE(USB_NET_EVENTS);
+
+esp_err_t esp_event_post(esp_event_base_t base, int32_t id, const void *data, size_t size,
+                         TickType_t ticks_to_wait) {
+    (void)base; (void)id; (void)data; (void)size; (void)ticks_to_wait;
+    return ESP_OK;
+}
+
+// ---------- pbuf ----------
+
+struct pbuf *pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type) {
+    (void)layer; (void)type;
+    struct pbuf *p = heap_caps_malloc(sizeof(*p) + length, MALLOC_CAP_DEFAULT);
+    if (p == NULL) return NULL;
+    p->next = NULL;
+    p->payload = p + 1;
+    p->tot_len = p->len = length;
+    p->flags = 0;
+    p->ref = 1;
+    return p;
+}
+
+void pbuf_ref(struct pbuf *p) {
+    if (p) __atomic_add_fetch(&p->ref, 1, __ATOMIC_RELAXED);
+}
+
+u8_t pbuf_free(struct pbuf *p) {
+    if (p == NULL) return 0;
+    if (__atomic_sub_fetch(&p->ref, 1, __ATOMIC_ACQ_REL) == 0) {
+        if (p->flags & PBUF_FLAG_IS_CUSTOM) {
+            ((struct pbuf_custom *)p)->custom_free_function(p);
+        } else {
+            heap_caps_free(p);
+        }
+        return 1;
+    }
+    return 0;
+}
+
+// ---------- TinyUSB / esp_netif ----------
+
+static mock_rx_sink_aq_t s_rx_sink;
+static mock_free_rx_aq_t s_free_rx;
+static mock_tx_sink_aq_t s_tx_sink;
+
+void mock_set_rx_sink_aq(mock_rx_sink_aq_t sink, mock_free_rx_aq_t free_rx) {
+    s_rx_sink = sink;
+    s_free_rx = free_rx;
+}
+
+void mock_set_tx_sink_aq(mock_tx_sink_aq_t sink) {
+    s_tx_sink = sink;
+}
+
+esp_err_t esp_netif_receive(esp_netif_t *esp_netif, void *buffer, size_t len, void *eb) {
+    (void)esp_netif;
+    esp_err_t err = s_rx_sink ? s_rx_sink(buffer, len) : ESP_OK;
+    if (s_free_rx) s_free_rx(NULL, eb);
+    return err;
+}
+
+esp_err_t tinyusb_net_send_sync(void *buffer, size_t len, void *buff_free_arg, TickType_t timeout) {
+    (void)buff_free_arg; (void)timeout;
+    return s_tx_sink ? s_tx_sink(buffer, len) : ESP_OK;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_log.h"
+
+// Ganchos del benchmark sobre la capa simulada (TinyUSB, esp_netif, heap)
+
+typedef esp_err_t (*mock_rx_sink_aq_t)(const void *buffer, size_t len);
+typedef esp_err_t (*mock_tx_sink_aq_t)(const void *buffer, size_t len);
+typedef void (*mock_free_rx_aq_t)(void *h, void *buffer);
+
+typedef struct {
+    uint64_t allocs;   // heap_caps_* + pbuf_alloc
+    uint64_t frees;
+    uint64_t bytes;
+} mock_heap_aq_t;
+
+// Sustituye a lwIP: recibe cada trama entregada por esp_netif_receive
+void mock_set_rx_sink_aq(mock_rx_sink_aq_t sink, mock_free_rx_aq_t free_rx);
+// Sustituye a TinyUSB: recibe cada trama de tinyusb_net_send_sync
+void mock_set_tx_sink_aq(mock_tx_sink_aq_t sink);
+void mock_heap_get_aq(mock_heap_aq_t *out);
@@ -0,0 +1,39 @@
+#pragma once
+// Valores por defecto del Kconfig de usb_netif_aq para el build de host
+#define CONFIG_AQ_USB_RX_POOL_SIZE 16
+#define CONFIG_AQ_USB_STATS_PERIOD_MS 0
+#define CONFIG_AQ_USB_RX_RING_LEN 10
+#define CONFIG_AQ_USB_RX_FLOW_CONTROL 1
+#define CONFIG_AQ_USB_RX_RESUME_LEVEL 4
+#define CONFIG_AQ_USB_RX_TASK_PRIO 5
+#define CONFIG_AQ_USB_DEVICE_TASK_CORE 0
+#define CONFIG_AQ_USB_RX_TASK_CORE 1
+#define CONFIG_AQ_USB_TX_TASK_CORE 0
+#define CONFIG_AQ_USB_TX_CTRL_QUEUE_LEN 8
+#define CONFIG_AQ_USB_TX_BULK_QUEUE_LEN 16
+#define CONFIG_AQ_USB_TX_CTRL_DSCP_MIN 40
+#define CONFIG_AQ_USB_TX_CTRL_PORT 0
+#define CONFIG_AQ_USB_TX_TIMEOUT_MS 200
+#define CONFIG_AQ_USB_TX_TASK_PRIO 19
+#define CONFIG_AQ_USB_NCM_IN_NTB_MAX_SIZE 4096
+#define CONFIG_AQ_USB_NCM_OUT_NTB_MAX_SIZE 4096
+#define CONFIG_AQ_USB_NCM_MAX_DATAGRAMS_PER_NTB 8
+#define CONFIG_AQ_USB_NCM_FLUSH_US 500
+#define CONFIG_AQ_USB_NCM_ADAPTIVE_FLUSH 1
+#define CONFIG_AQ_USB_DEVICE_TASK_STACK 4096
+#define CONFIG_AQ_USB_RX_TASK_STACK 8192
+#define CONFIG_AQ_USB_TX_TASK_STACK 3072
+#define CONFIG_AQ_USB_LINK_TASK_STACK 3072
+#define CONFIG_AQ_USB_LOG_TASK_STACK 3072
+#ifndef CONFIG_AQ_USB_LOG_LEVEL
+#define CONFIG_AQ_USB_LOG_LEVEL 3
+#endif
+#define CONFIG_AQ_USB_DLOG_RING_LEN 128
+#define CONFIG_AQ_USB_VENDOR_CHANNEL 1
+#define CONFIG_AQ_USB_VENDOR_BLOCKS 4
+#define CONFIG_AQ_USB_VENDOR_BLOCK_SIZE 2048
+#define CONFIG_AQ_USB_RX_FILTER 1
+#define CONFIG_AQ_USB_RX_FILTER_MAX_RULES 16
+#ifndef CONFIG_AQ_USB_RX_FILTER_IPV6
+#define CONFIG_AQ_USB_RX_FILTER_IPV6 0
+#endif
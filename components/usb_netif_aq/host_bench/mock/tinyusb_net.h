@@ -0,0 +1,7 @@
+#pragma once
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+// Entrega al sumidero TX del benchmark (hace de TinyUSB copiando la trama a un NTB)
+esp_err_t tinyusb_net_send_sync(void *buffer, size_t len, void *buff_free_arg, TickType_t timeout);
@@ -0,0 +1,309 @@
+// Tests de host (Linux) del códec NTB16 (ncm_ntb_aq) y de la política de agregación
+// (ncm_agg_aq). C puro, sin la capa mock/: ctest los ejecuta sin el benchmark.
+//   ida y vuelta encoder -> decoder, límites de datagramas y de tamaño, relleno a cero,
+//   NTH/NDP corruptos rechazados (firma, longitudes, offsets, sin terminadora, cadena
+//   de NDP en bucle), mutaciones aleatorias sin salirse del bloque, y las decisiones
+//   IDLE/HOLD/FLUSH con deadline y con el modo adaptativo.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ncm_agg_aq.h"
+#include "ncm_ntb_aq.h"
+
+static int s_failures;
+static int s_checks;
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        s_checks++;                                                         \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "CHECK failed line %d: %s\n", __LINE__, #cond); \
+            s_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+static uint64_t s_rng = 0x2545F4914F6CDD1Dull;
+
+static uint32_t rnd(void) {
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (uint32_t)(s_rng >> 32);
+}
+
+static void wr16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static uint16_t rd16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void fill(uint8_t *p, uint16_t len, uint32_t tag) {
+    for (uint16_t i = 0; i < len; i++) p[i] = (uint8_t)(tag * 31 + i);
+}
+
+// Decodifica todo el bloque; devuelve el número de datagramas o -err
+static int decode_all(const uint8_t *ntb, size_t len, const uint8_t **dg, uint16_t *dg_len, int max) {
+    ncm_ntb_decoder_aq_t dec;
+    ncm_ntb_err_aq_t err = ncm_ntb_decoder_init_aq(&dec, ntb, len);
+    if (err != NCM_NTB_OK) return -(int)err;
+    int n = 0;
+    for (;;) {
+        const uint8_t *p;
+        uint16_t l;
+        err = ncm_ntb_decoder_next_aq(&dec, &p, &l);
+        if (err != NCM_NTB_OK) return -(int)err;
+        if (l == 0) return n;
+        if (n < max) {
+            dg[n] = p;
+            dg_len[n] = l;
+        }
+        n++;
+    }
+}
+
+// Bloque válido de referencia: tres datagramas de 60, 61 y 62 bytes
+static size_t build_ref(uint8_t *buf, size_t cap) {
+    ncm_ntb_encoder_aq_t enc;
+    ncm_ntb_encoder_init_aq(&enc, buf, cap, 7, 0, 4);
+    uint8_t dg[64];
+    for (int i = 0; i < 3; i++) {
+        fill(dg, (uint16_t)(60 + i), (uint32_t)i);
+        ncm_ntb_encoder_add_aq(&enc, dg, (uint16_t)(60 + i));
+    }
+    return ncm_ntb_encoder_finish_aq(&enc);
+}
+
+static void test_round_trip(void) {
+    static uint8_t buf[16384], dg[1514];
+    static const uint16_t aligns[] = { 1, 4, 8 };
+    for (int iter = 0; iter < 300; iter++) {
+        uint16_t align = aligns[iter % 3];
+        uint16_t seq = (uint16_t)rnd();
+        size_t cap = 256 + rnd() % (sizeof(buf) - 256);
+        ncm_ntb_encoder_aq_t enc;
+        CHECK(ncm_ntb_encoder_init_aq(&enc, buf, cap, seq, (uint16_t)(1 + rnd() % NCM_NTB_MAX_DATAGRAMS), align) ==
+              NCM_NTB_OK);
+        uint16_t lens[NCM_NTB_MAX_DATAGRAMS];
+        int n = 0;
+        for (;;) {
+            uint16_t len = (uint16_t)(1 + rnd() % sizeof(dg));
+            fill(dg, len, (uint32_t)(iter * 64 + n));
+            ncm_ntb_err_aq_t err;
+            if (iter & 1) {
+                uint8_t *dst = ncm_ntb_encoder_reserve_aq(&enc, len);
+                err = dst ? NCM_NTB_OK : NCM_NTB_ERR_FULL;
+                if (dst) memcpy(dst, dg, len);
+            } else {
+                err = ncm_ntb_encoder_add_aq(&enc, dg, len);
+            }
+            if (err != NCM_NTB_OK) {
+                CHECK(err == NCM_NTB_ERR_FULL);
+                break;
+            }
+            lens[n++] = len;
+        }
+        size_t total = ncm_ntb_encoder_finish_aq(&enc);
+        CHECK(n == 0 ? total == 0 : total > 0 && total <= cap);
+        if (n == 0) continue;
+        CHECK(rd16(buf + 6) == seq);
+        CHECK(rd16(buf + 8) == total);
+
+        const uint8_t *out[NCM_NTB_MAX_DATAGRAMS];
+        uint16_t out_len[NCM_NTB_MAX_DATAGRAMS];
+        int m = decode_all(buf, total, out, out_len, NCM_NTB_MAX_DATAGRAMS);
+        CHECK(m == n);
+        for (int i = 0; i < n && i < m; i++) {
+            fill(dg, lens[i], (uint32_t)(iter * 64 + i));
+            CHECK(out_len[i] == lens[i]);
+            CHECK(((out[i] - buf) & (align - 1)) == 0);
+            CHECK(memcmp(out[i], dg, lens[i]) == 0);
+        }
+    }
+}
+
+static void test_limits(void) {
+    static uint8_t buf[2048], dg[1514];
+    ncm_ntb_encoder_aq_t enc;
+
+    // Argumentos
+    CHECK(ncm_ntb_encoder_init_aq(&enc, buf, sizeof(buf), 0, 4, 3) == NCM_NTB_ERR_ARG);
+    CHECK(ncm_ntb_encoder_init_aq(&enc, buf, sizeof(buf), 0, 4, 0) == NCM_NTB_ERR_ARG);
+    CHECK(ncm_ntb_encoder_init_aq(&enc, buf, 20, 0, 4, 4) == NCM_NTB_ERR_ARG);
+    CHECK(ncm_ntb_encoder_init_aq(&enc, buf, 65536, 0, 4, 4) == NCM_NTB_ERR_ARG);
+    CHECK(ncm_ntb_encoder_init_aq(&enc, buf, sizeof(buf), 0, 4, 4) == NCM_NTB_OK);
+    CHECK(ncm_ntb_encoder_add_aq(&enc, dg, 0) == NCM_NTB_ERR_ARG);
+    CHECK(ncm_ntb_encoder_add_aq(&enc, NULL, 10) == NCM_NTB_ERR_ARG);
+    CHECK(ncm_ntb_encoder_finish_aq(&enc) == 0);  // vacío
+
+    // Máximo de datagramas
+    CHECK(ncm_ntb_encoder_init_aq(&enc, buf, sizeof(buf), 0, 3, 4) == NCM_NTB_OK);
+    for (int i = 0; i < 3; i++) CHECK(ncm_ntb_encoder_add_aq(&enc, dg, 10) == NCM_NTB_OK);
+    CHECK(ncm_ntb_encoder_room_aq(&enc) == 0);
+    CHECK(ncm_ntb_encoder_add_aq(&enc, dg, 1) == NCM_NTB_ERR_FULL);
+    CHECK(ncm_ntb_encoder_init_aq(&enc, buf, sizeof(buf), 0, 0, 4) == NCM_NTB_OK);
+    CHECK(enc.max_datagrams == NCM_NTB_MAX_DATAGRAMS);
+    CHECK(ncm_ntb_encoder_init_aq(&enc, buf, sizeof(buf), 0, 200, 4) == NCM_NTB_OK);
+    CHECK(enc.max_datagrams == NCM_NTB_MAX_DATAGRAMS);
+
+    // Tamaño: room es exacto, un byte más no cabe y el bloque nunca pasa de cap
+    for (size_t cap = 40; cap <= sizeof(buf); cap += 37) {
+        CHECK(ncm_ntb_encoder_init_aq(&enc, buf, cap, 0, 0, 4) == NCM_NTB_OK);
+        for (;;) {
+            size_t room = ncm_ntb_encoder_room_aq(&enc);
+            if (room == 0) break;
+            uint16_t len = (uint16_t)(room > sizeof(dg) ? sizeof(dg) : room);
+            if (len == room) {
+                ncm_ntb_encoder_aq_t probe = enc;
+                CHECK(ncm_ntb_encoder_add_aq(&probe, dg, (uint16_t)(room + 1)) == NCM_NTB_ERR_FULL);
+            }
+            CHECK(ncm_ntb_encoder_add_aq(&enc, dg, len) == NCM_NTB_OK);
+        }
+        size_t total = ncm_ntb_encoder_finish_aq(&enc);
+        CHECK(total <= cap);
+        const uint8_t *out[NCM_NTB_MAX_DATAGRAMS];
+        uint16_t out_len[NCM_NTB_MAX_DATAGRAMS];
+        CHECK(decode_all(buf, total, out, out_len, NCM_NTB_MAX_DATAGRAMS) == enc.count);
+    }
+
+    // Datagrama máximo de Ethernet en el NTB por defecto de TinyUSB (3200 B): caben dos
+    static uint8_t big[3200];
+    CHECK(ncm_ntb_encoder_init_aq(&enc, big, sizeof(big), 0, 0, 4) == NCM_NTB_OK);
+    CHECK(ncm_ntb_encoder_add_aq(&enc, dg, 1514) == NCM_NTB_OK);
+    CHECK(ncm_ntb_encoder_add_aq(&enc, dg, 1514) == NCM_NTB_OK);
+    CHECK(ncm_ntb_encoder_add_aq(&enc, dg, 1514) == NCM_NTB_ERR_FULL);
+
+    // El relleno de alineación se escribe a cero: no filtra datos viejos del buffer
+    memset(buf, 0xAA, sizeof(buf));
+    CHECK(ncm_ntb_encoder_init_aq(&enc, buf, sizeof(buf), 0, 0, 8) == NCM_NTB_OK);
+    memset(dg, 0x55, 16);
+    CHECK(ncm_ntb_encoder_add_aq(&enc, dg, 3) == NCM_NTB_OK);
+    CHECK(ncm_ntb_encoder_add_aq(&enc, dg, 5) == NCM_NTB_OK);
+    size_t total = ncm_ntb_encoder_finish_aq(&enc);
+    bool clean = true;
+    for (size_t i = 0; i < total; i++) clean &= buf[i] != 0xAA;
+    CHECK(clean);
+}
+
+static void test_corrupt(void) {
+    static uint8_t ref[512], buf[512];
+    const uint8_t *out[8];
+    uint16_t out_len[8];
+    size_t len = build_ref(ref, sizeof(ref));
+    uint16_t ndp = rd16(ref + 10);
+    CHECK(decode_all(ref, len, out, out_len, 8) == 3);
+
+#define MUTATE(stmt, expect)                                              \
+    do {                                                                  \
+        memcpy(buf, ref, len);                                            \
+        stmt;                                                             \
+        CHECK(decode_all(buf, len, out, out_len, 8) == -(int)(expect));   \
+    } while (0)
+
+    // NTH16
+    MUTATE(buf[0] ^= 1, NCM_NTB_ERR_SIGNATURE);
+    MUTATE(wr16(buf + 4, 16), NCM_NTB_ERR_LENGTH);                     // wHeaderLength
+    MUTATE(wr16(buf + 8, (uint16_t)(len + 4)), NCM_NTB_ERR_LENGTH);    // wBlockLength > transferencia
+    CHECK(decode_all(ref, 11, out, out_len, 8) == -(int)NCM_NTB_ERR_LENGTH);
+    MUTATE(wr16(buf + 10, 8), NCM_NTB_ERR_BOUNDS);                     // NDP dentro de la NTH
+    MUTATE(wr16(buf + 10, (uint16_t)(ndp + 2)), NCM_NTB_ERR_BOUNDS);   // NDP sin alinear
+    MUTATE(wr16(buf + 10, (uint16_t)len), NCM_NTB_ERR_BOUNDS);         // NDP fuera del bloque
+    // wBlockLength = 0: hasta el final de la transferencia
+    memcpy(buf, ref, len);
+    wr16(buf + 8, 0);
+    CHECK(decode_all(buf, len, out, out_len, 8) == 3);
+
+    // NDP16
+    MUTATE(buf[ndp] ^= 1, NCM_NTB_ERR_SIGNATURE);
+    memcpy(buf, ref, len);
+    buf[ndp + 3] = '1';  // "NCM1": NDP con CRC, también válida
+    CHECK(decode_all(buf, len, out, out_len, 8) == 3);
+    MUTATE(wr16(buf + ndp + 4, 12), NCM_NTB_ERR_LENGTH);               // menos de una entrada + terminadora
+    MUTATE(wr16(buf + ndp + 4, 26), NCM_NTB_ERR_LENGTH);               // no múltiplo de 4
+    MUTATE(wr16(buf + ndp + 4, (uint16_t)(len - ndp + 4)), NCM_NTB_ERR_LENGTH);  // sale del bloque
+    MUTATE(wr16(buf + ndp + 8, (uint16_t)(len - 10)), NCM_NTB_ERR_BOUNDS);  // datagrama sale del bloque
+    MUTATE(wr16(buf + ndp + 8, 4), NCM_NTB_ERR_BOUNDS);                // datagrama dentro de la NTH
+    // Sin terminadora: la última entrada (0,0) pasa a ser un datagrama
+    MUTATE((wr16(buf + ndp + 20, 12), wr16(buf + ndp + 22, 4)), NCM_NTB_ERR_LENGTH);
+    // Cadena de NDP que vuelve atrás: se corta en vez de dar vueltas
+    MUTATE(wr16(buf + ndp + 6, ndp), NCM_NTB_ERR_BOUNDS);
+    MUTATE(wr16(buf + ndp + 6, (uint16_t)(ndp + 4)), NCM_NTB_ERR_SIGNATURE);
+#undef MUTATE
+
+    // Mutaciones aleatorias: puede fallar o no, pero nunca sale del bloque
+    int rejected = 0;
+    for (int iter = 0; iter < 200000; iter++) {
+        memcpy(buf, ref, len);
+        int flips = 1 + rnd() % 4;
+        for (int f = 0; f < flips; f++) buf[rnd() % len] = (uint8_t)rnd();
+        size_t cut = (rnd() & 7) == 0 ? rnd() % len : len;
+        int n = decode_all(buf, cut, out, out_len, 8);
+        if (n < 0) {
+            rejected++;
+            continue;
+        }
+        for (int i = 0; i < n && i < 8; i++) {
+            CHECK(out[i] >= buf + NCM_NTH16_LEN && out[i] + out_len[i] <= buf + cut);
+        }
+    }
+    CHECK(rejected > 0);
+}
+
+static void test_agg(void) {
+    ncm_agg_aq_t agg;
+    const int64_t t0 = 1000000;
+
+    // Sin agregación: siempre FLUSH con algo pendiente
+    ncm_agg_init_aq(&agg, &(ncm_agg_cfg_aq_t){ .max_datagrams = 8, .flush_us = 0 });
+    CHECK(ncm_agg_decide_aq(&agg, t0, 0) == NCM_AGG_IDLE);
+    CHECK(ncm_agg_decide_aq(&agg, t0, 1) == NCM_AGG_FLUSH);
+
+    // Fijo: espera hasta flush_us desde la trama más antigua o hasta llenar el NTB
+    ncm_agg_init_aq(&agg, &(ncm_agg_cfg_aq_t){ .max_datagrams = 8, .flush_us = 500 });
+    CHECK(ncm_agg_decide_aq(&agg, t0, 1) == NCM_AGG_HOLD);
+    CHECK(ncm_agg_deadline_aq(&agg) == t0 + 500);
+    CHECK(ncm_agg_decide_aq(&agg, t0 + 300, 3) == NCM_AGG_HOLD);
+    CHECK(ncm_agg_deadline_aq(&agg) == t0 + 500);   // no se reinicia con cada trama
+    CHECK(ncm_agg_decide_aq(&agg, t0 + 499, 3) == NCM_AGG_HOLD);
+    CHECK(ncm_agg_decide_aq(&agg, t0 + 500, 3) == NCM_AGG_FLUSH);
+    ncm_agg_flushed_aq(&agg, 3);
+    CHECK(ncm_agg_decide_aq(&agg, t0 + 600, 2) == NCM_AGG_HOLD);
+    CHECK(ncm_agg_deadline_aq(&agg) == t0 + 1100);  // nueva ventana tras el flush
+    CHECK(ncm_agg_decide_aq(&agg, t0 + 700, 8) == NCM_AGG_FLUSH);
+    ncm_agg_flushed_aq(&agg, 8);
+    CHECK(ncm_agg_decide_aq(&agg, t0 + 800, 1) == NCM_AGG_HOLD);
+    CHECK(ncm_agg_decide_aq(&agg, t0 + 900, 0) == NCM_AGG_IDLE);  // la cola se vació por otro lado
+    CHECK(ncm_agg_decide_aq(&agg, t0 + 2000, 1) == NCM_AGG_HOLD);
+    CHECK(ncm_agg_deadline_aq(&agg) == t0 + 2500);
+    CHECK(agg.batches == 2 && agg.datagrams == 11);
+    ncm_agg_init_aq(&agg, &(ncm_agg_cfg_aq_t){ .max_datagrams = 0, .flush_us = 500 });
+    CHECK(ncm_agg_decide_aq(&agg, t0, 1) == NCM_AGG_FLUSH);  // 0 se trata como 1
+
+    // Adaptativo: ocioso envía al momento; bajo carga agrupa; vuelve a ocioso
+    ncm_agg_init_aq(&agg, &(ncm_agg_cfg_aq_t){ .max_datagrams = 8, .flush_us = 500, .adaptive = true });
+    CHECK(ncm_agg_decide_aq(&agg, t0, 1) == NCM_AGG_FLUSH);
+    ncm_agg_flushed_aq(&agg, 1);
+    CHECK(ncm_agg_decide_aq(&agg, t0 + 10, 1) == NCM_AGG_FLUSH);
+    ncm_agg_flushed_aq(&agg, 8);   // ráfaga: la carga media sube
+    CHECK(ncm_agg_decide_aq(&agg, t0 + 20, 1) == NCM_AGG_HOLD);
+    CHECK(ncm_agg_decide_aq(&agg, t0 + 520, 1) == NCM_AGG_FLUSH);  // el deadline se respeta
+    int singles = 0;
+    for (;;) {
+        ncm_agg_flushed_aq(&agg, 1);
+        singles++;
+        if (ncm_agg_decide_aq(&agg, t0 + 1000 + singles, 1) == NCM_AGG_FLUSH || singles > 32) break;
+    }
+    CHECK(singles >= 2 && singles <= 8);  // unos pocos lotes de 1 y vuelve a enviar al momento
+}
+
+int main(void) {
+    test_round_trip();
+    test_limits();
+    test_corrupt();
+    test_agg();
+    printf("ncm_test: %d checks, %d failed\n", s_checks, s_failures);
+    return s_failures ? 1 : 0;
+}
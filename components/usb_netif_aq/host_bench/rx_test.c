@@ -0,0 +1,477 @@
+// Tests de host (Linux) de la entrada RX de usb_netif_aq sobre la capa simulada de mock/.
+// Sin medidas, solo comprobaciones; ctest ejecuta cada grupo por separado:
+//   rx_test filter   filtro L2 (usb_rx_filter_aq): reglas por defecto, tramas que pasan y
+//                    que no con su motivo, contadores por motivo y por regla, cambios de la
+//                    tabla en caliente (join/leave, llena, quitar y reset), el bypass, y que
+//                    lo descartado no gasta buffer del pool ni hueco del anillo.
+//   rx_test flow     control de flujo RX (usb_rx_input_flow_aq): pausa justo al llenarse el
+//                    anillo o agotarse el pool, reanudación una sola vez al bajar a
+//                    CONFIG_AQ_USB_RX_RESUME_LEVEL o al devolver lwIP un buffer, y ninguna
+//                    trama perdida, duplicada ni desordenada.
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "mock_aq.h"
+#include "sdkconfig.h"
+#include "usb_netif_aq.h"
+#include "usb_rx_aq.h"
+#include "usb_rx_filter_aq.h"
+#include "usb_stats_aq.h"
+
+static int s_failures;
+static int s_checks;
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        s_checks++;                                                         \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "CHECK failed line %d: %s\n", __LINE__, #cond); \
+            s_failures++;                                                   \
+        }                                                                   \
+    } while (0)
+
+#define FRAME_LEN   96
+#define ETH_HDR_LEN 14
+#define PASS        USB_NETIF_RX_FILTER_REASON_COUNT_AQ   // veredicto esperado: sigue a lwIP
+
+static const uint8_t k_me[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+static const uint8_t k_bcast[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+static void put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+// Ethernet + IPv4/UDP mínima hacia dst_ip; vlan mete una etiqueta 802.1Q
+static void build_ip4(uint8_t *f, const uint8_t mac[6], const uint8_t dst_ip[4], uint16_t dport, bool vlan) {
+    static const uint8_t src[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+    memset(f, 0, FRAME_LEN);
+    memcpy(f, mac, 6);
+    memcpy(f + 6, src, 6);
+    uint8_t *p = f + 12;
+    if (vlan) {
+        put16(p, 0x8100);
+        put16(p + 2, 7);
+        p += 4;
+    }
+    put16(p, 0x0800);
+    uint8_t *ip = p + 2;
+    ip[0] = 0x45;
+    ip[8] = 1;
+    ip[9] = 17;
+    ip[12] = 192; ip[13] = 168; ip[14] = 7; ip[15] = 1;
+    memcpy(ip + 16, dst_ip, 4);
+    put16(ip + 22, dport);
+}
+
+static void build_eth(uint8_t *f, const uint8_t mac[6], uint16_t ethertype) {
+    memset(f, 0, FRAME_LEN);
+    memcpy(f, mac, 6);
+    f[6] = 0x02;
+    put16(f + 12, ethertype);
+}
+
+static void filter_stats(usb_netif_rx_filter_stats_aq_t *fs) {
+    memset(fs, 0xA5, sizeof(*fs));
+    CHECK(usb_netif_rx_filter_get_stats_aq(fs) == ESP_OK);
+}
+
+// Aciertos de la primera regla igual a want (0 si no está)
+static uint32_t rule_hits(const usb_netif_rx_rule_aq_t *want, bool *found) {
+    usb_netif_rx_rule_info_aq_t rules[CONFIG_AQ_USB_RX_FILTER_MAX_RULES];
+    size_t n = 0;
+    CHECK(usb_netif_rx_filter_get_rules_aq(rules, CONFIG_AQ_USB_RX_FILTER_MAX_RULES, &n) == ESP_OK);
+    for (size_t i = 0; i < n; i++) {
+        if (memcmp(&rules[i].rule, want, sizeof(*want)) == 0) {
+            *found = true;
+            return rules[i].hits;
+        }
+    }
+    *found = false;
+    return 0;
+}
+
+// Reglas como las deja normalize: el resto de campos a cero
+static usb_netif_rx_rule_aq_t ethertype_rule(uint16_t ethertype) {
+    usb_netif_rx_rule_aq_t r;
+    memset(&r, 0, sizeof(r));
+    r.type = USB_NETIF_RX_RULE_ETHERTYPE_AQ;
+    r.ethertype = ethertype;
+    return r;
+}
+
+static usb_netif_rx_rule_aq_t group4_rule(uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+    usb_netif_rx_rule_aq_t r;
+    memset(&r, 0, sizeof(r));
+    r.type = USB_NETIF_RX_RULE_GROUP_AQ;
+    r.prefix_len = 32;
+    r.addr[0] = a; r.addr[1] = b; r.addr[2] = c; r.addr[3] = d;
+    return r;
+}
+
+static void test_filter(void) {
+    static const uint8_t ip_me[4] = { 192, 168, 7, 2 };
+    static const uint8_t ip_bcast[4] = { 255, 255, 255, 255 };
+    static const uint8_t ip_subnet_bcast[4] = { 192, 168, 7, 255 };
+    static const uint8_t ip_mdns[4] = { 224, 0, 0, 251 };
+    static const uint8_t ip_ssdp[4] = { 239, 255, 255, 250 };
+    static const uint8_t mac_mdns[6] = { 0x01, 0x00, 0x5E, 0x00, 0x00, 0xFB };
+    static const uint8_t mac_ssdp[6] = { 0x01, 0x00, 0x5E, 0x7F, 0xFF, 0xFA };
+    enum { F_TCP, F_VLAN, F_ARP, F_DHCP, F_MDNS4, F_SSDP, F_NETBIOS, F_IPV6, F_LLDP, F_RUNT, F_COUNT };
+    static uint8_t frames[F_COUNT][FRAME_LEN];
+    build_ip4(frames[F_TCP], k_me, ip_me, 1883, false);
+    frames[F_TCP][ETH_HDR_LEN + 9] = 6;
+    build_ip4(frames[F_VLAN], k_me, ip_me, 5001, true);
+    build_eth(frames[F_ARP], k_bcast, 0x0806);
+    build_ip4(frames[F_DHCP], k_bcast, ip_bcast, 68, false);
+    build_ip4(frames[F_MDNS4], mac_mdns, ip_mdns, 5353, false);
+    build_ip4(frames[F_SSDP], mac_ssdp, ip_ssdp, 1900, false);
+    build_ip4(frames[F_NETBIOS], k_bcast, ip_subnet_bcast, 137, false);
+    build_eth(frames[F_IPV6], k_me, 0x86DD);
+    build_eth(frames[F_LLDP], k_me, 0x88CC);
+    const struct {
+        int frame;
+        size_t len;
+        int verdict;
+    } cases[] = {
+        { F_TCP, FRAME_LEN, PASS },
+        { F_VLAN, FRAME_LEN, PASS },                               // ethertype tras la etiqueta
+        { F_ARP, FRAME_LEN, PASS },                                // regla MAC broadcast + ARP
+        { F_DHCP, FRAME_LEN, PASS },                               // regla GROUP 255.255.255.255
+        { F_MDNS4, FRAME_LEN, USB_NETIF_RX_FILTER_GROUP_AQ },
+        { F_SSDP, FRAME_LEN, USB_NETIF_RX_FILTER_GROUP_AQ },
+        { F_NETBIOS, FRAME_LEN, USB_NETIF_RX_FILTER_GROUP_AQ },    // broadcast de subred
+        { F_IPV6, FRAME_LEN, CONFIG_AQ_USB_RX_FILTER_IPV6 ? PASS : USB_NETIF_RX_FILTER_ETHERTYPE_AQ },
+        { F_LLDP, FRAME_LEN, USB_NETIF_RX_FILTER_ETHERTYPE_AQ },
+        { F_RUNT, ETH_HDR_LEN - 1, USB_NETIF_RX_FILTER_RUNT_AQ },
+    };
+    const size_t ncases = sizeof(cases) / sizeof(cases[0]);
+    const uint32_t default_rules = 4 + 3 * CONFIG_AQ_USB_RX_FILTER_IPV6;
+
+    // Reglas por defecto, contadores a cero
+    usb_rx_filter_init_aq();
+    usb_netif_rx_filter_stats_aq_t fs;
+    filter_stats(&fs);
+    CHECK(fs.enabled);
+    CHECK(fs.rules == default_rules);
+    CHECK(fs.capacity == CONFIG_AQ_USB_RX_FILTER_MAX_RULES);
+    CHECK(fs.passed == 0 && fs.unfiltered == 0);
+    for (int r = 0; r < USB_NETIF_RX_FILTER_REASON_COUNT_AQ; r++) CHECK(fs.dropped[r] == 0);
+
+    // Lista blanca: cada trama pasa o cae por su motivo, y cada veredicto cuenta una vez
+    uint32_t want[USB_NETIF_RX_FILTER_REASON_COUNT_AQ + 1] = { 0 };
+    for (int round = 0; round < 3; round++) {
+        for (size_t i = 0; i < ncases; i++) {
+            bool pass = usb_rx_filter_pass_aq(frames[cases[i].frame], cases[i].len);
+            if (round == 0 && pass != (cases[i].verdict == PASS)) {
+                fprintf(stderr, "frame %d: %s\n", cases[i].frame, pass ? "passed" : "dropped");
+            }
+            CHECK(pass == (cases[i].verdict == PASS));
+            want[cases[i].verdict]++;
+        }
+    }
+    filter_stats(&fs);
+    CHECK(fs.passed == want[PASS]);
+    for (int r = 0; r < USB_NETIF_RX_FILTER_REASON_COUNT_AQ; r++) CHECK(fs.dropped[r] == want[r]);
+    CHECK(fs.unfiltered == 0);
+
+    // Aciertos por regla: decide la regla más específica (GROUP/MAC para multicast)
+    bool found;
+    usb_netif_rx_rule_aq_t ip4 = ethertype_rule(0x0800), arp = ethertype_rule(0x0806);
+    usb_netif_rx_rule_aq_t dhcp = group4_rule(255, 255, 255, 255);
+    CHECK(rule_hits(&ip4, &found) == 3 * 2 && found);   // TCP y VLAN
+    CHECK(rule_hits(&arp, &found) == 0 && found);       // el broadcast ARP lo decide su regla MAC
+    CHECK(rule_hits(&dhcp, &found) == 3 && found);
+
+    // Tabla en caliente: join deja pasar mDNS y cuenta en su regla; SSDP sigue fuera
+    const esp_ip4_addr_t mdns = { .addr = htonl(0xE00000FB) };
+    usb_netif_rx_rule_aq_t mdns_rule = group4_rule(224, 0, 0, 251);
+    CHECK(usb_netif_rx_filter_join_ip4_aq(mdns) == ESP_OK);
+    CHECK(usb_netif_rx_filter_join_ip4_aq(mdns) == ESP_OK);   // ya estaba: no duplica
+    filter_stats(&fs);
+    CHECK(fs.rules == default_rules + 1);
+    CHECK(rule_hits(&mdns_rule, &found) == 0 && found);
+    CHECK(usb_rx_filter_pass_aq(frames[F_MDNS4], FRAME_LEN));
+    CHECK(usb_rx_filter_pass_aq(frames[F_MDNS4], FRAME_LEN));
+    CHECK(!usb_rx_filter_pass_aq(frames[F_SSDP], FRAME_LEN));
+    CHECK(rule_hits(&mdns_rule, &found) == 2 && found);
+    CHECK(usb_netif_rx_filter_leave_ip4_aq(mdns) == ESP_OK);
+    CHECK(!usb_rx_filter_pass_aq(frames[F_MDNS4], FRAME_LEN));
+    CHECK(usb_netif_rx_filter_leave_ip4_aq(mdns) == ESP_ERR_NOT_FOUND);
+    rule_hits(&mdns_rule, &found);
+    CHECK(!found);
+
+    // Un prefijo cubre el grupo; los bits fuera del prefijo no cuentan para remove
+    usb_netif_rx_rule_aq_t site = group4_rule(239, 255, 0, 0);
+    site.prefix_len = 16;
+    CHECK(usb_netif_rx_filter_add_aq(&site) == ESP_OK);
+    CHECK(usb_rx_filter_pass_aq(frames[F_SSDP], FRAME_LEN));
+    site.addr[3] = 0x55;
+    CHECK(usb_netif_rx_filter_remove_aq(&site) == ESP_OK);
+    CHECK(!usb_rx_filter_pass_aq(frames[F_SSDP], FRAME_LEN));
+
+    // Reglas inválidas
+    usb_netif_rx_rule_aq_t bad = { .type = USB_NETIF_RX_RULE_MAC_AQ, .mac = { 0x02, 0, 0, 0, 0, 9 } };
+    CHECK(usb_netif_rx_filter_add_aq(&bad) == ESP_ERR_INVALID_ARG);   // MAC unicast
+    bad = (usb_netif_rx_rule_aq_t){ .type = USB_NETIF_RX_RULE_GROUP_AQ, .prefix_len = 33 };
+    CHECK(usb_netif_rx_filter_add_aq(&bad) == ESP_ERR_INVALID_ARG);
+    bad = (usb_netif_rx_rule_aq_t){ .type = USB_NETIF_RX_RULE_ETHERTYPE_AQ };
+    CHECK(usb_netif_rx_filter_add_aq(&bad) == ESP_ERR_INVALID_ARG);
+    CHECK(usb_netif_rx_filter_add_aq(NULL) == ESP_ERR_INVALID_ARG);
+
+    // Tabla llena: NO_MEM sin tocar lo que hay; al quitar una vuelve a haber hueco
+    filter_stats(&fs);
+    for (uint32_t n = fs.rules; n < fs.capacity; n++) {
+        usb_netif_rx_rule_aq_t g = group4_rule(239, 1, 1, (uint8_t)n);
+        CHECK(usb_netif_rx_filter_add_aq(&g) == ESP_OK);
+    }
+    usb_netif_rx_rule_aq_t extra = group4_rule(239, 1, 2, 1);
+    CHECK(usb_netif_rx_filter_add_aq(&extra) == ESP_ERR_NO_MEM);
+    filter_stats(&fs);
+    CHECK(fs.rules == fs.capacity);
+    CHECK(usb_rx_filter_pass_aq(frames[F_TCP], FRAME_LEN));
+    usb_netif_rx_rule_aq_t last = group4_rule(239, 1, 1, (uint8_t)(fs.capacity - 1));
+    CHECK(usb_netif_rx_filter_remove_aq(&last) == ESP_OK);
+    CHECK(usb_netif_rx_filter_add_aq(&extra) == ESP_OK);
+
+    // Sin la regla de IPv4 el unicast cae por ethertype
+    CHECK(usb_netif_rx_filter_remove_aq(&ip4) == ESP_OK);
+    filter_stats(&fs);
+    uint32_t ethertype0 = fs.dropped[USB_NETIF_RX_FILTER_ETHERTYPE_AQ];
+    CHECK(!usb_rx_filter_pass_aq(frames[F_TCP], FRAME_LEN));
+    filter_stats(&fs);
+    CHECK(fs.dropped[USB_NETIF_RX_FILTER_ETHERTYPE_AQ] == ethertype0 + 1);
+
+    // reset: reglas por defecto y contadores a cero
+    CHECK(usb_netif_rx_filter_reset_aq() == ESP_OK);
+    filter_stats(&fs);
+    CHECK(fs.rules == default_rules && fs.passed == 0 && fs.unfiltered == 0);
+    for (int r = 0; r < USB_NETIF_RX_FILTER_REASON_COUNT_AQ; r++) CHECK(fs.dropped[r] == 0);
+    CHECK(usb_rx_filter_pass_aq(frames[F_TCP], FRAME_LEN));
+    CHECK(rule_hits(&ip4, &found) == 1 && found);
+
+    // Bypass: todo pasa sin contar y las reglas se conservan
+    CHECK(usb_netif_rx_filter_enable_aq(false) == ESP_OK);
+    filter_stats(&fs);
+    uint32_t passed0 = fs.passed;
+    CHECK(!fs.enabled);
+    for (size_t i = 0; i < ncases; i++) CHECK(usb_rx_filter_pass_aq(frames[cases[i].frame], cases[i].len));
+    filter_stats(&fs);
+    CHECK(fs.passed == passed0 && fs.dropped[USB_NETIF_RX_FILTER_GROUP_AQ] == 0);
+    CHECK(fs.rules == default_rules);
+    CHECK(usb_netif_rx_filter_enable_aq(true) == ESP_OK);
+    CHECK(!usb_rx_filter_pass_aq(frames[F_MDNS4], FRAME_LEN));
+
+    // En la entrada RX, lo descartado no toma buffer del pool ni hueco del anillo
+    CHECK(usb_rx_init_aq() == ESP_OK);
+    uint32_t used, cap;
+    CHECK(usb_rx_input_aq(frames[F_MDNS4], FRAME_LEN, NULL) == ESP_OK);
+    CHECK(usb_rx_input_aq(frames[F_LLDP], FRAME_LEN, NULL) == ESP_OK);
+    usb_rx_ring_usage_aq(&used, &cap);
+    CHECK(used == 0);
+    CHECK(usb_rx_input_aq(frames[F_TCP], FRAME_LEN, NULL) == ESP_OK);
+    usb_rx_ring_usage_aq(&used, &cap);
+    CHECK(used == 1);
+    usb_rx_deinit_aq();
+}
+
+// ---------- control de flujo ----------
+
+#define FL_SEQ_OFF  40      // número de secuencia dentro de la trama, tras la cabecera IP
+#define FL_WAIT_MS  2000
+#define FL_OPEN     UINT32_MAX
+
+// El sink hace de lwIP: se bloquea hasta tener permiso, así el test decide cuándo
+// avanza usb_rx_task y cuántas tramas quedan en el anillo en cada momento.
+static pthread_mutex_t s_fl_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_fl_cond = PTHREAD_COND_INITIALIZER;
+static uint32_t s_fl_entered;     // tramas que han llegado al sink
+static uint32_t s_fl_delivered;   // tramas que lo han pasado
+static uint32_t s_fl_done;        // buffers devueltos o retenidos tras el sink
+static uint32_t s_fl_permits;     // FL_OPEN: sin bloqueo
+static uint32_t s_fl_bad_seq;
+static bool s_fl_hold;            // lwIP retiene los buffers en vez de devolverlos
+static void *s_fl_held[CONFIG_AQ_USB_RX_POOL_SIZE];
+static uint32_t s_fl_nheld;
+static atomic_uint s_fl_resumes;
+static atomic_uint s_fl_resume_used;
+static uint8_t s_fl_frame[FRAME_LEN];
+
+static esp_err_t fl_sink(const void *buffer, size_t len) {
+    uint32_t seq;
+    memcpy(&seq, (const uint8_t *)buffer + FL_SEQ_OFF, sizeof(seq));
+    pthread_mutex_lock(&s_fl_lock);
+    s_fl_entered++;
+    pthread_cond_broadcast(&s_fl_cond);
+    while (s_fl_permits == 0) pthread_cond_wait(&s_fl_cond, &s_fl_lock);
+    if (s_fl_permits != FL_OPEN) s_fl_permits--;
+    if (seq != s_fl_delivered) s_fl_bad_seq++;
+    s_fl_delivered++;
+    pthread_cond_broadcast(&s_fl_cond);
+    pthread_mutex_unlock(&s_fl_lock);
+    return ESP_OK;
+}
+
+static void fl_free(void *h, void *buffer) {
+    pthread_mutex_lock(&s_fl_lock);
+    bool hold = s_fl_hold && s_fl_nheld < CONFIG_AQ_USB_RX_POOL_SIZE;
+    if (hold) s_fl_held[s_fl_nheld++] = buffer;
+    pthread_mutex_unlock(&s_fl_lock);
+    if (!hold) usb_rx_free_aq(h, buffer);
+    pthread_mutex_lock(&s_fl_lock);
+    s_fl_done++;
+    pthread_cond_broadcast(&s_fl_cond);
+    pthread_mutex_unlock(&s_fl_lock);
+}
+
+// Lo que haría el driver: tud_network_recv_renew. Aquí solo se anota con qué ocupación
+static void fl_resume(void) {
+    uint32_t used, cap;
+    usb_rx_ring_usage_aq(&used, &cap);
+    atomic_store(&s_fl_resume_used, used);
+    atomic_fetch_add(&s_fl_resumes, 1);
+}
+
+static void fl_release(uint32_t n) {
+    pthread_mutex_lock(&s_fl_lock);
+    s_fl_permits = n == FL_OPEN ? FL_OPEN : s_fl_permits + n;
+    pthread_cond_broadcast(&s_fl_cond);
+    pthread_mutex_unlock(&s_fl_lock);
+}
+
+// Espera a que *counter llegue a want; false si no llega en FL_WAIT_MS
+static bool fl_wait(const uint32_t *counter, uint32_t want) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += FL_WAIT_MS / 1000;
+    pthread_mutex_lock(&s_fl_lock);
+    int err = 0;
+    while (*counter < want && err != ETIMEDOUT) {
+        err = pthread_cond_timedwait(&s_fl_cond, &s_fl_lock, &deadline);
+    }
+    bool ok = *counter >= want;
+    pthread_mutex_unlock(&s_fl_lock);
+    return ok;
+}
+
+// El callback de TinyUSB con la trama seq; devuelve si pide la siguiente
+static bool fl_input(uint32_t seq) {
+    memcpy(s_fl_frame + FL_SEQ_OFF, &seq, sizeof(seq));
+    return usb_rx_input_flow_aq(s_fl_frame, FRAME_LEN);
+}
+
+static uint32_t fl_ring_used(void) {
+    uint32_t used, cap;
+    usb_rx_ring_usage_aq(&used, &cap);
+    return used;
+}
+
+static void fl_check_no_loss(uint32_t sent) {
+    usb_netif_stats_aq_t st;
+    CHECK(fl_wait(&s_fl_done, sent));
+    CHECK(s_fl_delivered == sent && s_fl_bad_seq == 0);
+    usb_stats_snapshot_aq(&st);
+    CHECK(st.drops[USB_NETIF_DROP_RX_QUEUE_FULL_AQ] == 0);
+    CHECK(st.drops[USB_NETIF_DROP_RX_ALLOC_FAIL_AQ] == 0);
+    CHECK(st.rx_packets == sent);
+    CHECK(st.rx_pauses == 1 && st.rx_resumes == 1);
+}
+
+static void test_flow(void) {
+    static const uint8_t ip_me[4] = { 192, 168, 7, 2 };
+    static struct { int dummy; } netif;
+    build_ip4(s_fl_frame, k_me, ip_me, 1883, false);
+    usb_netif_stats_aq_t st;
+    uint32_t seq = 0;
+
+    mock_set_rx_sink_aq(fl_sink, fl_free);
+    CHECK(usb_rx_init_aq() == ESP_OK);
+    usb_rx_set_resume_aq(fl_resume);
+    usb_stats_reset_aq();
+    CHECK(usb_rx_start_aq((esp_netif_t *)&netif) == ESP_OK);
+
+    // Anillo: con usb_rx_task parado en el sink, la trama que llena el anillo pausa
+    CHECK(fl_input(seq++));
+    CHECK(fl_wait(&s_fl_entered, 1));
+    for (uint32_t i = 1; i < CONFIG_AQ_USB_RX_RING_LEN; i++) CHECK(fl_input(seq++));
+    CHECK(!fl_input(seq++));
+    CHECK(fl_ring_used() == CONFIG_AQ_USB_RX_RING_LEN);
+    usb_stats_snapshot_aq(&st);
+    CHECK(st.rx_pauses == 1 && st.rx_resumes == 0);
+    CHECK(atomic_load(&s_fl_resumes) == 0);
+
+    // Vaciado de uno en uno: una sola reanudación, justo al bajar al nivel (histéresis)
+    for (uint32_t j = 1; j <= CONFIG_AQ_USB_RX_RING_LEN; j++) {
+        fl_release(1);
+        CHECK(fl_wait(&s_fl_entered, j + 1));
+        bool below = CONFIG_AQ_USB_RX_RING_LEN + 1 - j <= CONFIG_AQ_USB_RX_RESUME_LEVEL;
+        CHECK(atomic_load(&s_fl_resumes) == (below ? 1u : 0u));
+    }
+    CHECK(atomic_load(&s_fl_resume_used) == CONFIG_AQ_USB_RX_RESUME_LEVEL);
+
+    // Reanudado, TinyUSB sigue entregando; lo que cabe no vuelve a pausar
+    for (uint32_t i = 1; i < CONFIG_AQ_USB_RX_RING_LEN; i++) CHECK(fl_input(seq++));
+    fl_release(FL_OPEN);
+    fl_check_no_loss(seq);
+    CHECK(fl_ring_used() == 0);
+
+    // Pool: lwIP retiene los buffers. Con el anillo ya vacío en cada trama, pausa la que
+    // gasta el último buffer, aunque el anillo tenga sitio
+    usb_stats_reset_aq();
+    pthread_mutex_lock(&s_fl_lock);
+    s_fl_hold = true;
+    s_fl_delivered = s_fl_entered = s_fl_done = 0;
+    pthread_mutex_unlock(&s_fl_lock);
+    atomic_store(&s_fl_resumes, 0);
+    seq = 0;
+    for (uint32_t i = 1; i < CONFIG_AQ_USB_RX_POOL_SIZE; i++) {
+        CHECK(fl_input(seq++));
+        CHECK(fl_wait(&s_fl_done, seq));
+    }
+    CHECK(!fl_input(seq++));
+    CHECK(fl_wait(&s_fl_done, seq));
+    CHECK(s_fl_nheld == CONFIG_AQ_USB_RX_POOL_SIZE);
+    CHECK(fl_ring_used() == 0);
+    usb_stats_snapshot_aq(&st);
+    CHECK(st.rx_pauses == 1 && st.rx_resumes == 0);
+    CHECK(atomic_load(&s_fl_resumes) == 0);
+
+    // El primer buffer que devuelve lwIP (hilo tcpip) reanuda; los demás ya no
+    pthread_mutex_lock(&s_fl_lock);
+    s_fl_hold = false;
+    pthread_mutex_unlock(&s_fl_lock);
+    for (uint32_t i = 0; i < CONFIG_AQ_USB_RX_POOL_SIZE; i++) {
+        usb_rx_free_aq(NULL, s_fl_held[i]);
+        CHECK(atomic_load(&s_fl_resumes) == 1);
+    }
+    s_fl_nheld = 0;
+    CHECK(atomic_load(&s_fl_resume_used) == 0);
+    for (uint32_t i = 1; i < CONFIG_AQ_USB_RX_RING_LEN; i++) CHECK(fl_input(seq++));
+    fl_check_no_loss(seq);
+
+    usb_rx_stop_aq();
+    usb_rx_deinit_aq();
+    usb_rx_set_resume_aq(NULL);
+    mock_set_rx_sink_aq(NULL, NULL);
+}
+
+int main(int argc, char **argv) {
+    const char *group = argc > 1 ? argv[1] : "all";
+    bool all = strcmp(group, "all") == 0;
+    bool filter = all || strcmp(group, "filter") == 0;
+    bool flow = all || strcmp(group, "flow") == 0;
+    if (!filter && !flow) {
+        fprintf(stderr, "usage: %s [filter|flow|all]\n", argv[0]);
+        return 2;
+    }
+    if (filter) test_filter();
+    if (flow) test_flow();
+    printf("rx_test %s: %d checks, %d failed\n", group, s_checks, s_failures);
+    return s_failures ? 1 : 0;
+}
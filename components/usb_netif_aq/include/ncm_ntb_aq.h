@@ -0,0 +1,59 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Codificador/decodificador de bloques NTB16 de USB CDC-NCM (NTH16 + NDP16).
+// Solo C estándar, sin dependencias de IDF ni TinyUSB, para poder compilarlo en Linux.
+
+#define NCM_NTH16_SIGNATURE  0x484D434Eu  // "NCMH"
+#define NCM_NDP16_SIGNATURE  0x304D434Eu  // "NCM0" (sin CRC)
+#define NCM_NTH16_LEN        12
+#define NCM_NDP16_HDR_LEN    8
+#define NCM_NDP16_ENTRY_LEN  4
+#define NCM_NTB_MAX_DATAGRAMS 32
+
+typedef enum {
+    NCM_NTB_OK = 0,
+    NCM_NTB_ERR_ARG,
+    NCM_NTB_ERR_FULL,        // no cabe el datagrama (o se alcanzó max_datagrams)
+    NCM_NTB_ERR_SIGNATURE,
+    NCM_NTB_ERR_LENGTH,      // wBlockLength / wHeaderLength / wLength incoherentes o NDP sin terminadora
+    NCM_NTB_ERR_BOUNDS,      // índice o longitud fuera del bloque
+} ncm_ntb_err_aq_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t used;             // fin de los datos escritos (cabecera + datagramas)
+    uint16_t seq;
+    uint16_t count;
+    uint16_t max_datagrams;
+    uint16_t align;          // wNdpInPayloadRemainder = 0, divisor = align
+    uint16_t idx[NCM_NTB_MAX_DATAGRAMS];
+    uint16_t len[NCM_NTB_MAX_DATAGRAMS];
+} ncm_ntb_encoder_aq_t;
+
+// align debe ser potencia de 2 (4 es el valor habitual de wNdpInDivisor)
+ncm_ntb_err_aq_t ncm_ntb_encoder_init_aq(ncm_ntb_encoder_aq_t *enc, uint8_t *buf, size_t cap,
+                                         uint16_t seq, uint16_t max_datagrams, uint16_t align);
+ncm_ntb_err_aq_t ncm_ntb_encoder_add_aq(ncm_ntb_encoder_aq_t *enc, const void *datagram, uint16_t len);
+// Reserva espacio para un datagrama y devuelve el puntero para escribirlo en sitio
+uint8_t *ncm_ntb_encoder_reserve_aq(ncm_ntb_encoder_aq_t *enc, uint16_t len);
+// Escribe NDP16 y NTH16; devuelve la longitud total del bloque (0 si está vacío)
+size_t ncm_ntb_encoder_finish_aq(ncm_ntb_encoder_aq_t *enc);
+// Bytes libres para el siguiente datagrama teniendo en cuenta la NDP que falta por escribir
+size_t ncm_ntb_encoder_room_aq(const ncm_ntb_encoder_aq_t *enc);
+
+typedef struct {
+    const uint8_t *ntb;
+    size_t len;
+    uint16_t seq;
+    uint16_t ndp;            // offset de la NDP actual
+    uint16_t entry;          // siguiente entrada dentro de la NDP
+} ncm_ntb_decoder_aq_t;
+
+ncm_ntb_err_aq_t ncm_ntb_decoder_init_aq(ncm_ntb_decoder_aq_t *dec, const uint8_t *ntb, size_t len);
+// Devuelve NCM_NTB_OK y el siguiente datagrama (puntero dentro del NTB, sin copia);
+// *out_len = 0 cuando no quedan más.
+ncm_ntb_err_aq_t ncm_ntb_decoder_next_aq(ncm_ntb_decoder_aq_t *dec, const uint8_t **out, uint16_t *out_len);
@@ -1,6 +1,8 @@
 #ifndef _TUSB_CONFIG_H_
 #define _TUSB_CONFIG_H_
 
+#include "sdkconfig.h"
+
 //--------------------------------------------------------------------
 // COMMON CONFIGURATION
 //--------------------------------------------------------------------
@@ -21,7 +23,14 @@
 //--------------------------------------------------------------------
 #define CFG_TUD_NCM                 1
 #define CFG_TUD_NCM_MAX_SEGMENT_SIZE 1514
+// Tamaños de NTB y agregación desde Kconfig (menu usb_netif_aq > NCM aggregation)
+#ifdef CONFIG_AQ_USB_NCM_IN_NTB_MAX_SIZE
+#define CFG_TUD_NCM_IN_NTB_MAX_SIZE CONFIG_AQ_USB_NCM_IN_NTB_MAX_SIZE
+#define CFG_TUD_NCM_OUT_NTB_MAX_SIZE CONFIG_AQ_USB_NCM_OUT_NTB_MAX_SIZE
+#define CFG_TUD_NCM_IN_MAX_DATAGRAMS_PER_NTB CONFIG_AQ_USB_NCM_MAX_DATAGRAMS_PER_NTB
+#else
 #define CFG_TUD_NCM_IN_NTB_MAX_SIZE (4 * 1024)
 #define CFG_TUD_NCM_OUT_NTB_MAX_SIZE (4 * 1024)
+#endif
 
 #endif // _TUSB_CONFIG_H_
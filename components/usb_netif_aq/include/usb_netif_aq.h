@@ -1,21 +1,336 @@
 #pragma once
 #include "esp_netif.h"
 #include "esp_err.h"
+#include "esp_event.h"
 #include "freertos/FreeRTOS.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+// Checksums IP/TCP/UDP/ICMP en la netif USB_NCM; el resto de interfaces no cambian.
+// Requiere CONFIG_AQ_USB_CSUM_CTRL (LWIP_CHECKSUM_CTRL_PER_NETIF en lwIP).
+typedef enum {
+    USB_NETIF_CSUM_KCONFIG_AQ = 0,  // el de CONFIG_AQ_USB_CSUM_PROFILE
+    USB_NETIF_CSUM_FULL_AQ,         // lo de lwIP: se generan y se verifican
+    USB_NETIF_CSUM_TRUST_RX_AQ,     // no se verifican al recibir (el CRC de USB ya protege la trama)
+    USB_NETIF_CSUM_MIN_AQ,          // además UDP sale sin checksum (0, válido solo en IPv4)
+} usb_netif_csum_profile_aq_t;
+
 typedef struct {
     uint8_t  mac_addr[6];    // Debe coincidir con iMacAddress
     bool     use_ecm_fallback; // true=ECM, false=NCM
     const char *hostname;    // opcional; NULL para omitir
+    usb_netif_csum_profile_aq_t csum_profile;
 } usb_netif_cfg_aq_t;
 
+// Eventos del enlace USB publicados en el bus esp_event por usb_link_aq
+ESP_EVENT_DECLARE_BASE(USB_NET_EVENTS);
+
+typedef enum {
+    USB_NET_MOUNTED,     // el host ha configurado el dispositivo
+    USB_NET_UNMOUNTED,   // datos: usb_net_down_data_aq_t
+    USB_NET_UP,          // con IP; datos: usb_net_up_data_aq_t
+    USB_NET_DOWN,        // se perdió el enlace o la IP después de tenerla; datos: usb_net_down_data_aq_t
+    USB_NET_STATS,       // periódico; datos: usb_netif_stats_aq_t
+    USB_NET_PERF,        // fin de una prueba del servicio de medida; datos: usb_netif_perf_result_aq_t
+} usb_net_event_aq_t;
+
+typedef struct {
+    esp_ip4_addr_t ip;
+    uint32_t mount_to_ip_us;  // desde tud_mount_cb hasta GOT_IP
+    bool fast_path;           // IP reutilizada de caché (o estática), sin esperar a DHCP
+} usb_net_up_data_aq_t;
+
+typedef struct {
+    int64_t at_us;            // esp_timer_get_time() al procesar el desmontaje o la pérdida de IP
+} usb_net_down_data_aq_t;
+
+// Tiempos de arranque del enlace (montaje -> GOT_IP)
+typedef struct {
+    uint32_t mounts;
+    uint32_t last_mount_to_ip_us;
+    uint32_t best_mount_to_ip_us;
+    uint32_t worst_mount_to_ip_us;
+    bool     last_fast_path;
+} usb_netif_link_timing_aq_t;
+
+// Actividad de la tarea USB (tud_task). Para el consumo en reposo, comparar dos lecturas
+// separadas en el tiempo: wakeups/s y run_time_us/uptime_us (este último requiere
+// CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS, si no vale 0).
+typedef struct {
+    uint32_t wakeups;      // veces que tud_task ha vuelto tras procesar eventos
+    uint64_t run_time_us;  // tiempo de CPU consumido por la tarea
+    int64_t  uptime_us;    // tiempo desde que se creó la tarea
+} usb_netif_task_stats_aq_t;
+
+// Servicio de medida (CONFIG_AQ_USB_PERF): sumideros TCP/UDP compatibles con iperf 2
+// (`iperf -c <panel>` desde el MASTER), fuente hacia `iperf -s` y eco UDP con marcas de tiempo
+typedef enum {
+    USB_NETIF_PERF_TCP_AQ = 0,
+    USB_NETIF_PERF_UDP_AQ,
+    USB_NETIF_PERF_ECHO_AQ,
+} usb_netif_perf_proto_aq_t;
+
+typedef struct {
+    usb_netif_perf_proto_aq_t proto;
+    bool     source;           // true: el panel enviaba; false: sumidero o eco
+    esp_ip4_addr_t peer;
+    uint64_t bytes;            // payload de aplicación
+    uint32_t packets;          // datagramas UDP/eco, o recv/send TCP
+    uint32_t duration_ms;
+    float    mbps;
+    uint32_t pps;
+    uint32_t lost;             // UDP: huecos de id (sumidero) o según el informe del servidor (fuente)
+    uint32_t out_of_order;
+    float    jitter_ms;        // UDP, estimador de RFC 3550 (el mismo que iperf)
+    int8_t   cpu_pct[2];       // ocupación por núcleo durante la prueba; -1 sin run-time stats
+} usb_netif_perf_result_aq_t;
+
+typedef struct {
+    usb_netif_perf_proto_aq_t proto;  // TCP o UDP
+    esp_ip4_addr_t host;       // 0 = pasarela de la netif USB (el MASTER)
+    uint16_t port;             // 0 = CONFIG_AQ_USB_PERF_PORT
+    uint32_t duration_ms;      // 0 = 10 s, como iperf
+    uint32_t udp_kbps;         // UDP: caudal objetivo; 0 = 1 Mbit/s, como iperf
+    uint16_t len;              // bytes por send; 0 = 1470 en UDP, CONFIG_AQ_USB_PERF_BUF_SIZE en TCP
+} usb_netif_perf_source_cfg_aq_t;
+
+// Clases de prioridad de la etapa TX. Control/seguridad siempre sale antes que bulk.
+typedef enum {
+    USB_NETIF_TX_CLASS_CONTROL_AQ = 0,
+    USB_NETIF_TX_CLASS_BULK_AQ,
+    USB_NETIF_TX_CLASS_COUNT_AQ,
+} usb_netif_tx_class_aq_t;
+
+// Pista desde la aplicación: un socket con IP_TOS = USB_NETIF_TOS_CONTROL_AQ (DSCP EF)
+// se clasifica como control. ARP, ICMP/ICMPv6 y DHCP siempre van por control.
+#define USB_NETIF_TOS_CONTROL_AQ 0xB8
+
+// Filtro L2 de entrada (CONFIG_AQ_USB_RX_FILTER): se evalúa en el callback de TinyUSB sobre
+// la trama aún en el buffer de USB, antes de tomar un buffer del pool y de copiar. Una trama
+// pasa si su ethertype está permitido y, si va a una dirección de grupo (multicast o
+// broadcast), si una regla GROUP acepta su IP de destino o una regla MAC su MAC de destino.
+// El unicast no se filtra por MAC: el enlace NCM es punto a punto.
+typedef enum {
+    USB_NETIF_RX_RULE_ETHERTYPE_AQ = 0,  // ethertype permitido (tras una etiqueta VLAN)
+    USB_NETIF_RX_RULE_MAC_AQ,            // MAC de grupo permitida, opcionalmente solo con un ethertype
+    USB_NETIF_RX_RULE_GROUP_AQ,          // prefijo de destino IPv4/IPv6 (grupo multicast o broadcast)
+} usb_netif_rx_rule_type_aq_t;
+
+typedef struct {
+    usb_netif_rx_rule_type_aq_t type;
+    uint16_t ethertype;      // ETHERTYPE: el permitido; MAC: 0 = cualquiera
+    uint8_t  mac[6];         // MAC
+    bool     ipv6;           // GROUP: addr es IPv6 (16 B) o IPv4 (4 primeros bytes)
+    uint8_t  prefix_len;     // GROUP: bits de addr que deben coincidir (32/128 = dirección exacta)
+    uint8_t  addr[16];       // GROUP, en orden de red
+} usb_netif_rx_rule_aq_t;
+
+typedef struct {
+    usb_netif_rx_rule_aq_t rule;
+    uint32_t hits;           // tramas aceptadas por esta regla desde que se añadió
+} usb_netif_rx_rule_info_aq_t;
+
+// Motivos de descarte del filtro; no cuentan en usb_netif_stats_aq_t.drops
+typedef enum {
+    USB_NETIF_RX_FILTER_RUNT_AQ = 0,     // más corta que una cabecera Ethernet
+    USB_NETIF_RX_FILTER_ETHERTYPE_AQ,    // ethertype sin regla
+    USB_NETIF_RX_FILTER_GROUP_AQ,        // multicast/broadcast sin regla GROUP ni MAC
+    USB_NETIF_RX_FILTER_REASON_COUNT_AQ,
+} usb_netif_rx_filter_reason_aq_t;
+
+typedef struct {
+    bool     enabled;
+    uint32_t passed;
+    uint32_t dropped[USB_NETIF_RX_FILTER_REASON_COUNT_AQ];
+    uint32_t unfiltered;     // dejadas pasar sin evaluar porque la tabla cambiaba en ese momento
+    uint32_t rules;          // reglas en uso
+    uint32_t capacity;       // CONFIG_AQ_USB_RX_FILTER_MAX_RULES
+} usb_netif_rx_filter_stats_aq_t;
+
+// Estado del pool de buffers RX preasignado
+typedef struct {
+    uint32_t capacity;    // buffers reservados en usb_netif_install_aq
+    uint32_t in_use;      // buffers en cola o retenidos por lwIP
+    uint32_t high_water;  // máximo de in_use desde el arranque
+    uint32_t exhausted;   // paquetes descartados por pool agotado
+} usb_netif_rx_pool_stats_aq_t;
+
+// Causas de descarte contadas en usb_netif_stats_aq_t.drops
+typedef enum {
+    USB_NETIF_DROP_RX_QUEUE_FULL_AQ = 0,  // cola RX llena en el callback de TinyUSB
+    USB_NETIF_DROP_RX_ALLOC_FAIL_AQ,      // pool RX agotado o lwIP sin pbuf
+    USB_NETIF_DROP_RX_NO_NETIF_AQ,        // trama recibida sin netif/cola creados
+    USB_NETIF_DROP_RX_OVERSIZE_AQ,        // trama mayor que un buffer del pool
+    USB_NETIF_DROP_TX_QUEUE_FULL_AQ,      // cola TX llena (lwIP recibe ERR_MEM)
+    USB_NETIF_DROP_TX_ALLOC_FAIL_AQ,      // sin uso: TX ya no copia tramas sin pbuf; se mantiene el índice
+    USB_NETIF_DROP_TX_TIMEOUT_AQ,         // TinyUSB no aceptó la trama a tiempo
+    USB_NETIF_DROP_TX_USB_ERROR_AQ,       // otro error de tinyusb_net_send_sync
+    USB_NETIF_DROP_COUNT_AQ,
+} usb_netif_drop_aq_t;
+
+// Cubetas log2 de los histogramas de latencia: la i cuenta muestras en [2^i, 2^(i+1)) µs,
+// la 0 incluye < 1 µs y la última todo lo que pase de 2^15 µs (~33 ms)
+#define USB_NETIF_LAT_BUCKETS_AQ 16
+
+// Contadores de la ruta de datos. Son de 32 bits y dan la vuelta (bytes a ~4 GB):
+// el consumidor debe trabajar con diferencias entre dos lecturas.
+typedef struct {
+    int64_t  timestamp_us;     // esp_timer_get_time() de la lectura
+    uint32_t rx_packets;       // entregados a esp_netif_receive
+    uint32_t rx_bytes;
+    uint32_t tx_packets;       // aceptados por TinyUSB
+    uint32_t tx_bytes;
+    uint32_t drops[USB_NETIF_DROP_COUNT_AQ];
+    uint32_t rx_queue_high_water;
+    uint32_t rx_latency_us[USB_NETIF_LAT_BUCKETS_AQ];  // callback USB -> esp_netif_receive
+    uint32_t tx_latency_us[USB_NETIF_LAT_BUCKETS_AQ];  // transmit de lwIP -> entregada a TinyUSB
+    // Control de flujo RX (CONFIG_AQ_USB_RX_FLOW_CONTROL): veces que se dejó de pedir tramas
+    // a TinyUSB (host en NAK) y que se reanudó. rx_pauses != rx_resumes: en pausa ahora.
+    uint32_t rx_pauses;
+    uint32_t rx_resumes;
+    uint32_t rx_paused_us;     // tiempo total en pausa, de las pausas ya terminadas
+} usb_netif_stats_aq_t;
+
+// Tareas del componente, en el orden de usb_netif_mem_report_aq_t.tasks
+typedef enum {
+    USB_NETIF_TASK_DEVICE_AQ = 0,  // usb_device (tud_task)
+    USB_NETIF_TASK_RX_AQ,          // usb_rx
+    USB_NETIF_TASK_TX_AQ,          // usb_tx
+    USB_NETIF_TASK_LINK_AQ,        // usb_link
+    USB_NETIF_TASK_LOG_AQ,         // usb_log (formatea el log diferido)
+    USB_NETIF_TASK_COUNT_AQ,
+} usb_netif_task_aq_t;
+
+typedef struct {
+    const char *name;
+    uint32_t stack_size;       // bytes (CONFIG_AQ_USB_*_TASK_STACK)
+    uint32_t stack_free_min;   // high-water mark: mínimo de pila libre visto, en bytes
+    bool     running;          // false: tarea no creada o detenida (stack_free_min = 0)
+} usb_netif_task_mem_aq_t;
+
+// Huella de memoria del componente. Los bytes son los reservados (no los usados) y
+// separan .bss (modo estático) de heap; esp_timer y tinyusb no se incluyen.
+typedef struct {
+    bool     static_alloc;      // CONFIG_AQ_USB_STATIC_ALLOC
+    bool     rx_pool_psram;     // pool RX en PSRAM
+    usb_netif_task_mem_aq_t tasks[USB_NETIF_TASK_COUNT_AQ];
+    usb_netif_rx_pool_stats_aq_t rx_pool;
+    uint32_t rx_ring_used;
+    uint32_t rx_ring_capacity;
+    uint32_t tx_ring_used[USB_NETIF_TX_CLASS_COUNT_AQ];
+    uint32_t tx_ring_capacity[USB_NETIF_TX_CLASS_COUNT_AQ];
+    uint32_t bytes_stacks;      // pilas + TCB de las tareas
+    uint32_t bytes_buffers;     // pool RX, bloques vendor y anillos (incluido el del log diferido)
+    uint32_t bytes_sync;        // semáforo y grupo de eventos
+    uint32_t bytes_static;      // total en .bss
+    uint32_t bytes_heap;        // total en el heap
+} usb_netif_mem_report_aq_t;
+
+// Log diferido de la ruta de datos (anillo binario + tarea usb_log)
+typedef struct {
+    uint32_t recorded;         // registros aceptados en el anillo
+    uint32_t dropped;          // perdidos con el anillo lleno
+    uint32_t formatted;        // escritos con ESP_LOG por la tarea usb_log
+    uint32_t streamed;         // enviados en crudo por UDP (CONFIG_AQ_USB_DLOG_UDP)
+    uint32_t ring_capacity;    // CONFIG_AQ_USB_DLOG_RING_LEN
+    uint32_t ring_high_water;  // máximo de registros pendientes visto por usb_log
+} usb_netif_log_stats_aq_t;
+
+// Canal vendor bulk (CONFIG_AQ_USB_VENDOR_CHANNEL): interfaz 0xFF junto a NCM con un
+// endpoint bulk IN para flujos de muestras que no necesitan IP/TCP/MQTT
+typedef struct {
+    bool     open;              // el host configuró la interfaz
+    uint32_t blocks_sent;
+    uint32_t bytes_sent;        // payload, sin cabeceras
+    uint32_t no_block;          // usb_netif_vendor_block_get_aq sin bloque libre
+    uint32_t dropped;           // descartados al desmontar o por error del endpoint
+    uint32_t queue_high_water;  // máximo de bloques esperando al host
+    uint32_t blocks;            // CONFIG_AQ_USB_VENDOR_BLOCKS
+    uint32_t payload_max;       // CONFIG_AQ_USB_VENDOR_BLOCK_SIZE
+} usb_netif_vendor_stats_aq_t;
+
+// Coste en ciclos de CPU de una función de la ruta caliente (usb_netif_cycle_bench_aq)
+#define USB_NETIF_CYCLE_FNS_AQ 5
+typedef struct {
+    const char *name;
+    bool     in_iram;        // según CONFIG_AQ_USB_IRAM_PROFILE y el fragmento linker.lf
+    uint32_t warm_min;       // caché caliente
+    uint32_t warm_median;
+    uint32_t cold_median;    // caché de instrucciones invalidada antes de cada llamada (0 = no soportado)
+} usb_netif_cycle_aq_t;
+
 esp_err_t usb_netif_install_aq(const usb_netif_cfg_aq_t *cfg);
 esp_err_t usb_netif_start_aq(void);     // tinyusb_driver_install + tinyusb_net_init + crear/attach esp_netif
 esp_err_t usb_netif_stop_aq(void);
 esp_err_t usb_netif_get_esp_netif_aq(esp_netif_t **out);
-bool      usb_netif_is_link_up_aq(void);
+bool      usb_netif_is_link_up_aq(void);  // montado; lectura atómica, cualquier núcleo
+esp_err_t usb_netif_get_rx_pool_stats_aq(usb_netif_rx_pool_stats_aq_t *out);
+// Pilas por tarea, ocupación de pool y anillos y bytes reservados; cualquier tarea
+esp_err_t usb_netif_get_mem_report_aq(usb_netif_mem_report_aq_t *out);
+// Mide la ruta caliente RX/TX, iterations muestras por función (máx. 4096). Requiere
+// CONFIG_AQ_USB_CYCLE_BENCH y llamarse entre usb_netif_install_aq y usb_netif_start_aq
+// (ESP_ERR_INVALID_STATE si no): inyecta tramas en el anillo RX y las descarta.
+esp_err_t usb_netif_cycle_bench_aq(uint32_t iterations, usb_netif_cycle_aq_t out[USB_NETIF_CYCLE_FNS_AQ]);
+// Ciclos (mediana) del checksum de lwIP sobre un segmento de seg_len bytes: lo que cada
+// paquete deja de pagar al verificar o generar con el perfil reducido. CONFIG_AQ_USB_CYCLE_BENCH.
+esp_err_t usb_netif_csum_bench_aq(uint16_t seg_len, uint32_t iterations, uint32_t *cycles);
+// Cambia el perfil de checksums en caliente (p.ej. para medir con y sin él); tras start
+esp_err_t usb_netif_set_csum_profile_aq(usb_netif_csum_profile_aq_t profile);
+usb_netif_csum_profile_aq_t usb_netif_get_csum_profile_aq(void);
+esp_err_t usb_netif_get_task_stats_aq(usb_netif_task_stats_aq_t *out);
+esp_err_t usb_netif_get_log_stats_aq(usb_netif_log_stats_aq_t *out);
+esp_err_t usb_netif_get_stats_aq(usb_netif_stats_aq_t *out);
+void      usb_netif_reset_stats_aq(void);
+esp_err_t usb_netif_get_link_timing_aq(usb_netif_link_timing_aq_t *out);
+// Olvida la concesión guardada (RTC + NVS); el próximo montaje irá por DHCP completo
+esp_err_t usb_netif_clear_lease_cache_aq(void);
+
+// Canal vendor sin copias, una sola tarea productora. get devuelve el área de payload de un
+// bloque de DMA libre (NULL si no hay: el host no lee lo bastante rápido); la aplicación
+// escribe ahí las muestras y lo entrega con send, o lo devuelve sin enviar con release.
+// Tras send el bloque pertenece al driver. ESP_ERR_NOT_SUPPORTED sin el Kconfig.
+uint8_t  *usb_netif_vendor_block_get_aq(size_t *capacity);
+esp_err_t usb_netif_vendor_block_send_aq(uint8_t *block, size_t len, uint8_t stream);
+void      usb_netif_vendor_block_release_aq(uint8_t *block);
+esp_err_t usb_netif_vendor_get_stats_aq(usb_netif_vendor_stats_aq_t *out);
+
+// Puertos TCP/UDP (origen o destino) que se tratan como tráfico de control
+esp_err_t usb_netif_tx_add_ctrl_port_aq(uint16_t port);
+esp_err_t usb_netif_tx_remove_ctrl_port_aq(uint16_t port);
+
+// Filtro RX, modificable en caliente desde cualquier tarea (no ISR). add devuelve
+// ESP_ERR_NO_MEM con la tabla llena y ESP_OK si la regla ya existía; remove busca una regla
+// igual (ESP_ERR_NOT_FOUND si no la hay). reset vuelve a las reglas por defecto del Kconfig
+// y pone los contadores a cero. ESP_ERR_NOT_SUPPORTED sin CONFIG_AQ_USB_RX_FILTER.
+esp_err_t usb_netif_rx_filter_add_aq(const usb_netif_rx_rule_aq_t *rule);
+esp_err_t usb_netif_rx_filter_remove_aq(const usb_netif_rx_rule_aq_t *rule);
+esp_err_t usb_netif_rx_filter_reset_aq(void);
+// Sin filtro todas las tramas siguen al pool; las reglas se conservan
+esp_err_t usb_netif_rx_filter_enable_aq(bool enable);
+// Reglas en uso con sus contadores; *count = las copiadas (como mucho max)
+esp_err_t usb_netif_rx_filter_get_rules_aq(usb_netif_rx_rule_info_aq_t *out, size_t max, size_t *count);
+esp_err_t usb_netif_rx_filter_get_stats_aq(usb_netif_rx_filter_stats_aq_t *out);
+// Atajo: grupo multicast IPv4 (a.b.c.d en orden de red) que la aplicación escucha, p.ej. mDNS
+esp_err_t usb_netif_rx_filter_join_ip4_aq(esp_ip4_addr_t group);
+esp_err_t usb_netif_rx_filter_leave_ip4_aq(esp_ip4_addr_t group);
+
+// Servicio de medida. start abre los sumideros y el eco en la netif USB (idempotente; con
+// CONFIG_AQ_USB_PERF_AUTOSTART lo hace usb_netif_wait_got_ip_aq). source lanza una
+// prueba hacia el MASTER sin bloquear; el resultado llega en USB_NET_PERF y en get_last.
+// ESP_ERR_NOT_SUPPORTED sin CONFIG_AQ_USB_PERF.
+esp_err_t usb_netif_perf_start_aq(void);
+esp_err_t usb_netif_perf_stop_aq(void);
+esp_err_t usb_netif_perf_source_aq(const usb_netif_perf_source_cfg_aq_t *cfg);
+esp_err_t usb_netif_perf_get_last_aq(usb_netif_perf_result_aq_t *out);
+
+// Start-of-frame del host (1 ms en full speed). frame es el número de trama de 11 bits y
+// t_us el esp_timer_get_time() al atenderlo en la tarea usb_device, no en la ISR: la
+// latencia ISR->tarea es el jitter de la marca. Corre en el contexto de TinyUSB y no debe
+// bloquear. Con un callback la tarea usb_device despierta 1000 veces por segundo; NULL lo
+// quita y apaga el evento. Tras usb_netif_start_aq (ESP_ERR_INVALID_STATE si no).
+typedef void (*usb_netif_sof_cb_aq_t)(uint32_t frame, int64_t t_us, void *ctx);
+esp_err_t usb_netif_set_sof_cb_aq(usb_netif_sof_cb_aq_t cb, void *ctx);
 
 // Bloquea hasta GOT_IP o timeout; devuelve IP si se solicita
 esp_err_t usb_netif_wait_got_ip_aq(TickType_t timeout, esp_ip4_addr_t *out_ip);
@@ -0,0 +1,7 @@
+# El control de checksums por netif de lwIP (NETIF_SET_CHECKSUM_CTRL) solo existe con
+# LWIP_CHECKSUM_CTRL_PER_NETIF, que se lee en lwip/opt.h: tiene que llegar a todo el
+# build, lwip incluido. Se incluye antes de procesar los componentes, con el sdkconfig ya
+# cargado. Las netif que no toca usb_netif_aq quedan con NETIF_CHECKSUM_ENABLE_ALL.
+if(CONFIG_AQ_USB_CSUM_CTRL)
+    idf_build_set_property(COMPILE_DEFINITIONS "LWIP_CHECKSUM_CTRL_PER_NETIF=1" APPEND)
+endif()
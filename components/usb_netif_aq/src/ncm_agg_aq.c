@@ -0,0 +1,46 @@
+#include "ncm_agg_aq.h"
+
+// Por debajo de 1.5 tramas por lote se considera enlace ocioso
+#define IDLE_LOAD_Q4 24
+
+void ncm_agg_init_aq(ncm_agg_aq_t *agg, const ncm_agg_cfg_aq_t *cfg) {
+    agg->cfg = *cfg;
+    if (agg->cfg.max_datagrams == 0) agg->cfg.max_datagrams = 1;
+    agg->first_us = 0;
+    agg->load_q4 = 16;
+    agg->batches = 0;
+    agg->datagrams = 0;
+}
+
+ncm_agg_decision_aq_t ncm_agg_decide_aq(ncm_agg_aq_t *agg, int64_t now_us, uint16_t pending) {
+    if (pending == 0) {
+        agg->first_us = 0;
+        return NCM_AGG_IDLE;
+    }
+    if (agg->first_us == 0) {
+        agg->first_us = now_us;
+    }
+    if (agg->cfg.flush_us == 0 || pending >= agg->cfg.max_datagrams) {
+        return NCM_AGG_FLUSH;
+    }
+    if (now_us - agg->first_us >= (int64_t)agg->cfg.flush_us) {
+        return NCM_AGG_FLUSH;
+    }
+    if (agg->cfg.adaptive && agg->load_q4 < IDLE_LOAD_Q4) {
+        return NCM_AGG_FLUSH;
+    }
+    return NCM_AGG_HOLD;
+}
+
+int64_t ncm_agg_deadline_aq(const ncm_agg_aq_t *agg) {
+    return agg->first_us + agg->cfg.flush_us;
+}
+
+void ncm_agg_flushed_aq(ncm_agg_aq_t *agg, uint16_t sent) {
+    // EWMA con alfa = 1/4 sobre el tamaño de lote
+    uint32_t sample = (uint32_t)sent << 4;
+    agg->load_q4 = (agg->load_q4 * 3 + sample) >> 2;
+    agg->first_us = 0;
+    agg->batches++;
+    agg->datagrams += sent;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+// Política de agregación de datagramas por NTB (C puro, sin IDF).
+// La tarea TX la consulta cada vez que despierta con tramas bulk pendientes:
+//  - FLUSH: entregar ya hasta max_datagrams tramas a TinyUSB.
+//  - HOLD:  esperar a más tramas hasta el deadline para empaquetarlas en el mismo NTB.
+// En modo adaptativo, si la carga reciente es baja (lotes de ~1 trama) se envía al
+// momento; bajo carga se acumula hasta llenar el NTB o agotar flush_us.
+
+typedef struct {
+    uint16_t max_datagrams;  // datagramas por NTB
+    uint32_t flush_us;       // espera máxima de una trama pendiente (0 = sin agregación)
+    bool adaptive;
+} ncm_agg_cfg_aq_t;
+
+typedef enum {
+    NCM_AGG_IDLE = 0,        // nada pendiente
+    NCM_AGG_HOLD,
+    NCM_AGG_FLUSH,
+} ncm_agg_decision_aq_t;
+
+typedef struct {
+    ncm_agg_cfg_aq_t cfg;
+    int64_t first_us;        // llegada de la trama más antigua pendiente (0 = ninguna)
+    uint32_t load_q4;        // media móvil del tamaño de lote, punto fijo Q4
+    uint32_t batches;
+    uint32_t datagrams;
+} ncm_agg_aq_t;
+
+void ncm_agg_init_aq(ncm_agg_aq_t *agg, const ncm_agg_cfg_aq_t *cfg);
+ncm_agg_decision_aq_t ncm_agg_decide_aq(ncm_agg_aq_t *agg, int64_t now_us, uint16_t pending);
+// Instante en que vence la espera actual (solo válido tras NCM_AGG_HOLD)
+int64_t ncm_agg_deadline_aq(const ncm_agg_aq_t *agg);
+void ncm_agg_flushed_aq(ncm_agg_aq_t *agg, uint16_t sent);
@@ -0,0 +1,164 @@
+#include "ncm_ntb_aq.h"
+#include <string.h>
+
+static inline void wr16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void wr32(uint8_t *p, uint32_t v) {
+    wr16(p, (uint16_t)v);
+    wr16(p + 2, (uint16_t)(v >> 16));
+}
+
+static inline uint16_t rd16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t rd32(const uint8_t *p) {
+    return (uint32_t)rd16(p) | ((uint32_t)rd16(p + 2) << 16);
+}
+
+static inline size_t align_up(size_t v, size_t a) {
+    return (v + a - 1) & ~(a - 1);
+}
+
+// Tamaño de la NDP16 para n datagramas más la entrada terminadora (0,0)
+static inline size_t ndp_size(uint16_t n) {
+    return NCM_NDP16_HDR_LEN + (size_t)(n + 1) * NCM_NDP16_ENTRY_LEN;
+}
+
+ncm_ntb_err_aq_t ncm_ntb_encoder_init_aq(ncm_ntb_encoder_aq_t *enc, uint8_t *buf, size_t cap,
+                                         uint16_t seq, uint16_t max_datagrams, uint16_t align) {
+    if (!enc || !buf || align == 0 || (align & (align - 1)) != 0) return NCM_NTB_ERR_ARG;
+    if (cap > UINT16_MAX || cap < NCM_NTH16_LEN + ndp_size(1)) return NCM_NTB_ERR_ARG;
+    if (max_datagrams == 0 || max_datagrams > NCM_NTB_MAX_DATAGRAMS) max_datagrams = NCM_NTB_MAX_DATAGRAMS;
+    enc->buf = buf;
+    enc->cap = cap;
+    enc->used = NCM_NTH16_LEN;
+    enc->seq = seq;
+    enc->count = 0;
+    enc->max_datagrams = max_datagrams;
+    enc->align = align;
+    return NCM_NTB_OK;
+}
+
+size_t ncm_ntb_encoder_room_aq(const ncm_ntb_encoder_aq_t *enc) {
+    if (enc->count >= enc->max_datagrams) return 0;
+    size_t start = align_up(enc->used, enc->align);
+    size_t tail = ndp_size(enc->count + 1) + 3;  // NDP alineada a 4
+    if (start + tail >= enc->cap) return 0;
+    return enc->cap - start - tail;
+}
+
+uint8_t *ncm_ntb_encoder_reserve_aq(ncm_ntb_encoder_aq_t *enc, uint16_t len) {
+    if (len == 0 || ncm_ntb_encoder_room_aq(enc) < len) return NULL;
+    size_t start = align_up(enc->used, enc->align);
+    // Relleno de alineación a cero para no filtrar datos antiguos del buffer
+    memset(enc->buf + enc->used, 0, start - enc->used);
+    enc->idx[enc->count] = (uint16_t)start;
+    enc->len[enc->count] = len;
+    enc->count++;
+    enc->used = start + len;
+    return enc->buf + start;
+}
+
+ncm_ntb_err_aq_t ncm_ntb_encoder_add_aq(ncm_ntb_encoder_aq_t *enc, const void *datagram, uint16_t len) {
+    if (!datagram || len == 0) return NCM_NTB_ERR_ARG;
+    uint8_t *dst = ncm_ntb_encoder_reserve_aq(enc, len);
+    if (!dst) return NCM_NTB_ERR_FULL;
+    memcpy(dst, datagram, len);
+    return NCM_NTB_OK;
+}
+
+size_t ncm_ntb_encoder_finish_aq(ncm_ntb_encoder_aq_t *enc) {
+    if (enc->count == 0) return 0;
+
+    size_t ndp = align_up(enc->used, 4);
+    memset(enc->buf + enc->used, 0, ndp - enc->used);
+    uint8_t *p = enc->buf + ndp;
+    wr32(p, NCM_NDP16_SIGNATURE);
+    wr16(p + 4, (uint16_t)ndp_size(enc->count));
+    wr16(p + 6, 0);  // wNextNdpIndex: una sola NDP por bloque
+    p += NCM_NDP16_HDR_LEN;
+    for (uint16_t i = 0; i < enc->count; i++, p += NCM_NDP16_ENTRY_LEN) {
+        wr16(p, enc->idx[i]);
+        wr16(p + 2, enc->len[i]);
+    }
+    wr32(p, 0);
+    size_t total = ndp + ndp_size(enc->count);
+
+    uint8_t *h = enc->buf;
+    wr32(h, NCM_NTH16_SIGNATURE);
+    wr16(h + 4, NCM_NTH16_LEN);
+    wr16(h + 6, enc->seq);
+    wr16(h + 8, (uint16_t)total);
+    wr16(h + 10, (uint16_t)ndp);
+    return total;
+}
+
+static ncm_ntb_err_aq_t check_ndp(const ncm_ntb_decoder_aq_t *dec, uint16_t off) {
+    if (off < NCM_NTH16_LEN || (off & 3) || (size_t)off + NCM_NDP16_HDR_LEN > dec->len) return NCM_NTB_ERR_BOUNDS;
+    const uint8_t *p = dec->ntb + off;
+    uint32_t sig = rd32(p);
+    if (sig != NCM_NDP16_SIGNATURE && sig != 0x314D434Eu) return NCM_NTB_ERR_SIGNATURE;  // "NCM1" (CRC)
+    uint16_t ndp_len = rd16(p + 4);
+    if (ndp_len < NCM_NDP16_HDR_LEN + 2 * NCM_NDP16_ENTRY_LEN || (ndp_len & 3) ||
+        (size_t)off + ndp_len > dec->len) {
+        return NCM_NTB_ERR_LENGTH;
+    }
+    return NCM_NTB_OK;
+}
+
+ncm_ntb_err_aq_t ncm_ntb_decoder_init_aq(ncm_ntb_decoder_aq_t *dec, const uint8_t *ntb, size_t len) {
+    if (!dec || !ntb) return NCM_NTB_ERR_ARG;
+    if (len < NCM_NTH16_LEN) return NCM_NTB_ERR_LENGTH;
+    if (rd32(ntb) != NCM_NTH16_SIGNATURE) return NCM_NTB_ERR_SIGNATURE;
+    uint16_t hdr_len = rd16(ntb + 4);
+    uint16_t block_len = rd16(ntb + 8);
+    if (hdr_len != NCM_NTH16_LEN) return NCM_NTB_ERR_LENGTH;
+    // wBlockLength = 0 significa "hasta el final de la transferencia"
+    if (block_len != 0) {
+        if (block_len > len) return NCM_NTB_ERR_LENGTH;
+        len = block_len;
+    }
+    dec->ntb = ntb;
+    dec->len = len;
+    dec->seq = rd16(ntb + 6);
+    dec->ndp = rd16(ntb + 10);
+    dec->entry = 0;
+    return check_ndp(dec, dec->ndp);
+}
+
+ncm_ntb_err_aq_t ncm_ntb_decoder_next_aq(ncm_ntb_decoder_aq_t *dec, const uint8_t **out, uint16_t *out_len) {
+    *out = NULL;
+    *out_len = 0;
+    while (dec->ndp != 0) {
+        const uint8_t *ndp = dec->ntb + dec->ndp;
+        uint16_t ndp_len = rd16(ndp + 4);
+        size_t pos = NCM_NDP16_HDR_LEN + (size_t)dec->entry * NCM_NDP16_ENTRY_LEN;
+        // La tabla termina con una entrada (0,0) dentro de wLength
+        if (pos + NCM_NDP16_ENTRY_LEN > ndp_len) return NCM_NTB_ERR_LENGTH;
+        uint16_t idx = rd16(ndp + pos);
+        uint16_t len = rd16(ndp + pos + 2);
+        if (idx != 0 && len != 0) {
+            if ((size_t)idx + len > dec->len || idx < NCM_NTH16_LEN) return NCM_NTB_ERR_BOUNDS;
+            dec->entry++;
+            *out = dec->ntb + idx;
+            *out_len = len;
+            return NCM_NTB_OK;
+        }
+        // Fin de esta NDP: seguir la cadena si hay otra
+        uint16_t next = rd16(ndp + 6);
+        if (next == 0) break;
+        if (next <= dec->ndp) return NCM_NTB_ERR_BOUNDS;  // evita bucles en NTBs corruptos
+        ncm_ntb_decoder_aq_t probe = *dec;
+        probe.ndp = next;
+        ncm_ntb_err_aq_t err = check_ndp(&probe, next);
+        if (err != NCM_NTB_OK) return err;
+        dec->ndp = next;
+        dec->entry = 0;
+    }
+    dec->ndp = 0;
+    return NCM_NTB_OK;
+}
@@ -0,0 +1,83 @@
+#include "usb_csum_aq.h"
+#include "esp_log.h"
+#include "esp_netif_net_stack.h"
+#include "lwip/netif.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "usb_csum_aq";
+
+#if CONFIG_AQ_USB_CSUM_CTRL && !LWIP_CHECKSUM_CTRL_PER_NETIF
+#error "CONFIG_AQ_USB_CSUM_CTRL needs LWIP_CHECKSUM_CTRL_PER_NETIF=1 (set by project_include.cmake)"
+#endif
+
+static usb_netif_csum_profile_aq_t s_profile = USB_NETIF_CSUM_FULL_AQ;
+
+static usb_netif_csum_profile_aq_t resolve(usb_netif_csum_profile_aq_t profile) {
+    if (profile != USB_NETIF_CSUM_KCONFIG_AQ) return profile;
+#if CONFIG_AQ_USB_CSUM_PROFILE_MIN
+    return USB_NETIF_CSUM_MIN_AQ;
+#elif CONFIG_AQ_USB_CSUM_PROFILE_TRUST_RX
+    return USB_NETIF_CSUM_TRUST_RX_AQ;
+#else
+    return USB_NETIF_CSUM_FULL_AQ;
+#endif
+}
+
+esp_err_t usb_csum_check_profile_aq(usb_netif_csum_profile_aq_t profile) {
+    profile = resolve(profile);
+    if (profile > USB_NETIF_CSUM_MIN_AQ) return ESP_ERR_INVALID_ARG;
+#if !CONFIG_AQ_USB_CSUM_CTRL
+    if (profile != USB_NETIF_CSUM_FULL_AQ) return ESP_ERR_NOT_SUPPORTED;
+#endif
+    return ESP_OK;
+}
+
+#if CONFIG_AQ_USB_CSUM_CTRL
+// Generación de IP/TCP/ICMP siempre activa: el driver cdc_ncm del MASTER no marca las
+// tramas como verificadas y su stack descartaría las que lleguen sin checksum
+static uint16_t profile_flags(usb_netif_csum_profile_aq_t profile) {
+    uint16_t flags = NETIF_CHECKSUM_ENABLE_ALL;
+    if (profile >= USB_NETIF_CSUM_TRUST_RX_AQ) {
+        flags &= ~(NETIF_CHECKSUM_CHECK_IP | NETIF_CHECKSUM_CHECK_UDP | NETIF_CHECKSUM_CHECK_TCP |
+                   NETIF_CHECKSUM_CHECK_ICMP | NETIF_CHECKSUM_CHECK_ICMP6);
+    }
+    if (profile == USB_NETIF_CSUM_MIN_AQ) {
+        flags &= ~NETIF_CHECKSUM_GEN_UDP;
+    }
+    return flags;
+}
+
+// chksum_flags lo leen ip4_input/tcp_input/udp_output: se cambia desde la tarea tcpip
+static esp_err_t apply_in_tcpip(void *ctx) {
+    struct netif *n = (struct netif *)ctx;
+    NETIF_SET_CHECKSUM_CTRL(n, profile_flags(s_profile));
+    return ESP_OK;
+}
+#endif
+
+esp_err_t usb_csum_apply_aq(esp_netif_t *netif, usb_netif_csum_profile_aq_t profile) {
+    esp_err_t err = usb_csum_check_profile_aq(profile);
+    if (err != ESP_OK) return err;
+    profile = resolve(profile);
+#if CONFIG_AQ_USB_CSUM_CTRL
+    struct netif *n = esp_netif_get_netif_impl(netif);
+    if (n == NULL) return ESP_ERR_INVALID_STATE;
+    s_profile = profile;
+    err = esp_netif_tcpip_exec(apply_in_tcpip, n);
+    if (err != ESP_OK) return err;
+    ESP_LOGI(TAG, "USB netif checksum profile: %s",
+             profile == USB_NETIF_CSUM_MIN_AQ ? "min" : profile == USB_NETIF_CSUM_TRUST_RX_AQ ? "trust-rx" : "full");
+#endif
+    return ESP_OK;
+}
+
+usb_netif_csum_profile_aq_t usb_netif_get_csum_profile_aq(void) {
+    return s_profile;
+}
+
+esp_err_t usb_netif_set_csum_profile_aq(usb_netif_csum_profile_aq_t profile) {
+    esp_netif_t *netif = NULL;
+    usb_netif_get_esp_netif_aq(&netif);
+    if (netif == NULL) return ESP_ERR_INVALID_STATE;
+    return usb_csum_apply_aq(netif, profile);
+}
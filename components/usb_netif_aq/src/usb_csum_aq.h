@@ -0,0 +1,9 @@
+#pragma once
+#include "esp_err.h"
+#include "esp_netif.h"
+#include "usb_netif_aq.h"
+
+// Perfil de checksums de la netif USB_NCM (usb_csum_aq.c). Sin CONFIG_AQ_USB_CSUM_CTRL
+// solo se acepta el perfil completo, que es el de lwIP.
+esp_err_t usb_csum_check_profile_aq(usb_netif_csum_profile_aq_t profile);  // en install
+esp_err_t usb_csum_apply_aq(esp_netif_t *netif, usb_netif_csum_profile_aq_t profile);
@@ -0,0 +1,218 @@
+#include "usb_netif_aq.h"
+#include "sdkconfig.h"
+
+#if CONFIG_AQ_USB_CYCLE_BENCH
+#include <stdlib.h>
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "esp_memory_utils.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/prot/ip.h"
+#include "lwip/ip_addr.h"
+#include "lwip/pbuf.h"
+#include "usb_dlog_aq.h"
+#include "usb_rx_aq.h"
+#include "usb_rx_pool_aq.h"
+#include "usb_tx_class_aq.h"
+#if CONFIG_IDF_TARGET_ESP32S3
+#include "esp32s3/rom/cache.h"
+#endif
+
+static const char *TAG = "usb_cycle_bench";
+
+// Microbenchmark de la ruta caliente en ciclos de CPU. Cada función se mide sola, con la
+// caché caliente (la misma llamada en bucle) y fría (invalidando la caché de instrucciones
+// antes de cada muestra): la colocación en IRAM solo se nota en el segundo caso.
+// El arnés y los envoltorios van en IRAM para que sus propios fallos de caché no cuenten.
+
+typedef void (*bench_fn_t)(void *ctx);
+
+typedef struct {
+    const char *name;
+    const void *addr;   // función medida, para saber si quedó en IRAM
+    bench_fn_t before;  // fuera de la medida: preparar la muestra
+    bench_fn_t fn;
+    bench_fn_t after;   // fuera de la medida: devolver el estado inicial
+} bench_case_t;
+
+static uint8_t s_frame[64];
+static void *s_buf;
+
+static IRAM_ATTR void empty_fn(void *ctx) {
+}
+
+static IRAM_ATTR void bench_rx_input(void *ctx) {
+    usb_rx_input_aq(s_frame, sizeof(s_frame), NULL);
+}
+
+// Sin la tarea usb_log (aún no hay start) el anillo del log se vacía a mano
+static void after_rx_input(void *ctx) {
+    usb_rx_discard_aq();
+    usb_dlog_discard_aq();
+}
+
+static IRAM_ATTR void bench_pool_alloc(void *ctx) {
+    s_buf = usb_rx_pool_alloc_aq();
+}
+
+static void after_pool_alloc(void *ctx) {
+    usb_rx_pool_free_aq(s_buf);
+}
+
+static void before_rx_free(void *ctx) {
+    s_buf = usb_rx_pool_alloc_aq();
+}
+
+static IRAM_ATTR void bench_rx_free(void *ctx) {
+    usb_rx_free_aq(NULL, s_buf);
+}
+
+static IRAM_ATTR void bench_classify(void *ctx) {
+    volatile usb_netif_tx_class_aq_t cls = usb_tx_classify_aq(s_frame, sizeof(s_frame));
+    (void)cls;
+}
+
+static IRAM_ATTR void bench_dlog_put(void *ctx) {
+    usb_dlog_put_aq(USB_DLOG_RX_FRAME_AQ, sizeof(s_frame), 0, 0, 0);
+}
+
+static void after_dlog_put(void *ctx) {
+    usb_dlog_discard_aq();
+}
+
+static const bench_case_t s_cases[USB_NETIF_CYCLE_FNS_AQ] = {
+    { "usb_rx_input_aq", (const void *)usb_rx_input_aq, NULL, bench_rx_input, after_rx_input },
+    { "usb_rx_pool_alloc_aq", (const void *)usb_rx_pool_alloc_aq, NULL, bench_pool_alloc, after_pool_alloc },
+    { "usb_rx_free_aq", (const void *)usb_rx_free_aq, before_rx_free, bench_rx_free, NULL },
+    { "usb_tx_classify_aq", (const void *)usb_tx_classify_aq, NULL, bench_classify, NULL },
+    { "usb_dlog_put_aq", (const void *)usb_dlog_put_aq, NULL, bench_dlog_put, after_dlog_put },
+};
+
+static IRAM_ATTR uint32_t measure(bench_fn_t fn, bool cold) {
+#if CONFIG_IDF_TARGET_ESP32S3
+    if (cold) Cache_Invalidate_ICache_All();
+#endif
+    uint32_t t0 = esp_cpu_get_cycle_count();
+    fn(NULL);
+    return esp_cpu_get_cycle_count() - t0;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Deja las muestras ordenadas: samples[0] es el mínimo y samples[n / 2] la mediana.
+// Mediana en vez de media: una interrupción a mitad de muestra no la desplaza.
+static void run_case(const bench_case_t *c, uint32_t n, uint32_t *samples, uint32_t overhead, bool cold) {
+    for (uint32_t i = 0; i < n; i++) {
+        if (c->before) c->before(NULL);
+        uint32_t cyc = measure(c->fn, cold);
+        samples[i] = cyc > overhead ? cyc - overhead : 0;
+        if (c->after) c->after(NULL);
+    }
+    qsort(samples, n, sizeof(*samples), cmp_u32);
+}
+
+esp_err_t usb_netif_cycle_bench_aq(uint32_t iterations, usb_netif_cycle_aq_t out[USB_NETIF_CYCLE_FNS_AQ]) {
+    if (out == NULL || iterations == 0 || iterations > 4096) return ESP_ERR_INVALID_ARG;
+    // Pool y anillo creados (install) pero sin tareas: usb_rx_input_aq no debe llegar a lwIP
+    esp_netif_t *netif = NULL;
+    usb_netif_get_esp_netif_aq(&netif);
+    if (usb_rx_pool_buf_size_aq() == 0 || netif != NULL) return ESP_ERR_INVALID_STATE;
+
+    uint32_t *samples = malloc(iterations * sizeof(uint32_t));
+    if (samples == NULL) return ESP_ERR_NO_MEM;
+
+    // TCP/IPv4 sin DSCP ni puertos de control: el clasificador recorre la cabecera entera
+    memset(s_frame, 0, sizeof(s_frame));
+    static const uint8_t hdr[] = {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x02, 0x00, 0x00, 0x00, 0x00, 0x01, 0x08, 0x00,
+        0x45, 0x00, 0x00, 0x32, 0x00, 0x00, 0x40, 0x00, 0x40, 0x06,
+    };
+    memcpy(s_frame, hdr, sizeof(hdr));
+    s_frame[34] = 0xc0;  // puerto origen 49152
+    s_frame[37] = 80;    // puerto destino 80
+
+    // Coste de la propia medida (llamada indirecta + lectura de CCOUNT)
+    const bench_case_t empty = { .name = "empty", .fn = empty_fn };
+    run_case(&empty, iterations, samples, 0, false);
+    uint32_t overhead = samples[0];
+
+    // El log de la ruta RX sí entra en la medida: es un registro en el anillo, no UART
+    for (int i = 0; i < USB_NETIF_CYCLE_FNS_AQ; i++) {
+        const bench_case_t *c = &s_cases[i];
+        usb_netif_cycle_aq_t *r = &out[i];
+        r->name = c->name;
+        r->in_iram = esp_ptr_in_iram(c->addr);
+        run_case(c, iterations, samples, overhead, false);
+        r->warm_min = samples[0];
+        r->warm_median = samples[iterations / 2];
+#if CONFIG_IDF_TARGET_ESP32S3
+        run_case(c, iterations, samples, overhead, true);
+        r->cold_median = samples[iterations / 2];
+#else
+        r->cold_median = 0;
+#endif
+        ESP_LOGI(TAG, "%-22s %-5s warm min %5lu med %5lu  cold med %5lu cycles", r->name,
+                 r->in_iram ? "IRAM" : "flash", (unsigned long)r->warm_min, (unsigned long)r->warm_median,
+                 (unsigned long)r->cold_median);
+    }
+    free(samples);
+    return ESP_OK;
+}
+
+// Lo que lwIP hace por segmento con el checksum activo: tcp_input al verificar, y
+// tcp_output/udp_sendto al generar, sobre la pseudo-cabecera más el segmento entero
+static struct pbuf *s_seg;
+static ip_addr_t s_src, s_dst;
+static volatile uint16_t s_sum;
+
+static IRAM_ATTR void bench_csum(void *ctx) {
+    s_sum = ip_chksum_pseudo(s_seg, IP_PROTO_TCP, s_seg->tot_len, &s_src, &s_dst);
+}
+
+esp_err_t usb_netif_csum_bench_aq(uint16_t seg_len, uint32_t iterations, uint32_t *cycles) {
+    if (cycles == NULL || seg_len == 0 || iterations == 0 || iterations > 4096) return ESP_ERR_INVALID_ARG;
+    uint32_t *samples = malloc(iterations * sizeof(uint32_t));
+    s_seg = pbuf_alloc(PBUF_RAW, seg_len, PBUF_RAM);
+    if (samples == NULL || s_seg == NULL) {
+        free(samples);
+        if (s_seg) pbuf_free(s_seg);
+        return ESP_ERR_NO_MEM;
+    }
+    uint8_t *d = s_seg->payload;
+    for (uint16_t i = 0; i < seg_len; i++) {
+        d[i] = (uint8_t)(i * 31 + 7);
+    }
+    IP_ADDR4(&s_src, 192, 168, 7, 1);
+    IP_ADDR4(&s_dst, 192, 168, 7, 2);
+
+    const bench_case_t empty = { .name = "empty", .fn = empty_fn };
+    run_case(&empty, iterations, samples, 0, false);
+    uint32_t overhead = samples[0];
+    const bench_case_t c = { .name = "ip_chksum_pseudo", .fn = bench_csum };
+    run_case(&c, iterations, samples, overhead, false);
+    *cycles = samples[iterations / 2];
+    ESP_LOGI(TAG, "checksum of a %u-byte segment: median %lu cycles (%.1f cycles/byte)", seg_len,
+             (unsigned long)*cycles, (double)*cycles / seg_len);
+
+    pbuf_free(s_seg);
+    s_seg = NULL;
+    free(samples);
+    return ESP_OK;
+}
+
+#else
+
+esp_err_t usb_netif_cycle_bench_aq(uint32_t iterations, usb_netif_cycle_aq_t out[USB_NETIF_CYCLE_FNS_AQ]) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t usb_netif_csum_bench_aq(uint16_t seg_len, uint32_t iterations, uint32_t *cycles) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
@@ -1,5 +1,6 @@
 // usb_descriptors_aq.c - VERSION CORREGIDA
 #include <string.h>
+#include "sdkconfig.h"
 #include "tusb.h"
 #include "usb_descriptors_aq.h"
 
@@ -16,7 +17,11 @@ const tusb_desc_device_t g_tusb_device_descriptor_aq = {
     .bMaxPacketSize0    = CFG_TUD_ENDPOINT0_SIZE,
     .idVendor           = 0x303A,   // Espressif
     .idProduct          = 0x4021,   
+#if CONFIG_AQ_USB_VENDOR_CHANNEL
+    .bcdDevice          = 0x0101,   // otra configuración: que el host no reutilice la caché de descriptores
+#else
     .bcdDevice          = 0x0100,
+#endif
     .iManufacturer      = 1,
     .iProduct           = 2,
     .iSerialNumber      = 3,
@@ -24,19 +29,33 @@ const tusb_desc_device_t g_tusb_device_descriptor_aq = {
 };
 
 //--------------------------------------------------------------------+
-// Configuration Descriptor (NCM)
+// Configuration Descriptor (NCM, + vendor bulk IN con CONFIG_AQ_USB_VENDOR_CHANNEL)
 //--------------------------------------------------------------------+
 enum {
     ITF_NUM_CDC = 0,
     ITF_NUM_CDC_DATA,
+#if CONFIG_AQ_USB_VENDOR_CHANNEL
+    ITF_NUM_VENDOR,
+#endif
     ITF_NUM_TOTAL
 };
 
+// Interfaz 0xFF con un solo endpoint bulk IN (TUD_VENDOR_DESCRIPTOR trae también OUT)
+#define TUD_VENDOR_IN_DESC_LEN_AQ (9 + 7)
+#define TUD_VENDOR_IN_DESCRIPTOR_AQ(_itfnum, _stridx, _epin, _epsize) \
+    9, TUSB_DESC_INTERFACE, _itfnum, 0, 1, TUSB_CLASS_VENDOR_SPECIFIC, 0x00, 0x00, _stridx, \
+    7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0
+
+#if CONFIG_AQ_USB_VENDOR_CHANNEL
+#define CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + TUD_CDC_NCM_DESC_LEN + TUD_VENDOR_IN_DESC_LEN_AQ)
+#else
 #define CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + TUD_CDC_NCM_DESC_LEN)
+#endif
 
 #define EPNUM_CDC_NOTIF   0x81
 #define EPNUM_CDC_OUT     0x02
 #define EPNUM_CDC_IN      0x82
+#define EPNUM_VENDOR_IN   0x83
 
 const uint8_t g_tusb_fs_configuration_descriptor_aq[] = {
     // Config number, interface count, string index, total length, attribute, power in mA
@@ -44,6 +63,11 @@ const uint8_t g_tusb_fs_configuration_descriptor_aq[] = {
 
     // CDC-NCM: _itfnum, _desc_stridx, _mac_stridx, _ep_notif, _ep_notif_size, _epout, _epin, _epsize, _maxsegmentsize
     TUD_CDC_NCM_DESCRIPTOR(ITF_NUM_CDC, 0, 4, EPNUM_CDC_NOTIF, 8, EPNUM_CDC_OUT, EPNUM_CDC_IN, 64, 1514),
+
+#if CONFIG_AQ_USB_VENDOR_CHANNEL
+    // Vendor: _itfnum, _stridx, _epin, _epsize (bulk FS: 64)
+    TUD_VENDOR_IN_DESCRIPTOR_AQ(ITF_NUM_VENDOR, 5, EPNUM_VENDOR_IN, 64),
+#endif
 };
 
 //--------------------------------------------------------------------+
@@ -58,6 +82,9 @@ const char * const g_tusb_string_descriptor_aq[] = {
     "ESP32-S3 USB NCM",          // 2: Product  
     "AC-ESP32S3-001",           // 3: Serial Number
     s_mac_str,                   // 4: MAC Address (NCM uses this)
+#if CONFIG_AQ_USB_VENDOR_CHANNEL
+    "AQ raw stream",             // 5: Vendor interface
+#endif
 };
 
 const size_t g_tusb_string_descriptor_aq_count = sizeof(g_tusb_string_descriptor_aq)/sizeof(g_tusb_string_descriptor_aq[0]);
@@ -0,0 +1,116 @@
+#include "usb_dlog_aq.h"
+#include <stdatomic.h>
+#include "esp_cpu.h"
+#include "usb_stats_aq.h"
+
+#define DLOG_RING_LEN_AQ  CONFIG_AQ_USB_DLOG_RING_LEN
+#define DLOG_RING_MASK_AQ (DLOG_RING_LEN_AQ - 1)
+_Static_assert((DLOG_RING_LEN_AQ & DLOG_RING_MASK_AQ) == 0, "CONFIG_AQ_USB_DLOG_RING_LEN must be a power of 2");
+
+const usb_dlog_desc_aq_t g_usb_dlog_desc_aq[USB_DLOG_MSG_COUNT_AQ] = {
+#define USB_DLOG_DESC_AQ(id, lvl, tag, fmt) [USB_DLOG_##id##_AQ] = { ESP_LOG_##lvl, tag, fmt },
+    USB_DLOG_MSGS_AQ(USB_DLOG_DESC_AQ)
+#undef USB_DLOG_DESC_AQ
+};
+
+// Anillo acotado de varios productores y un consumidor con número de secuencia por hueco
+// (esquema de Vyukov). El hueco i está libre para la posición pos cuando seq == pos y
+// publicado cuando seq == pos + 1; el consumidor lo devuelve con seq = pos + LEN.
+// Un productor reserva con un CAS sobre head y publica con un store release: ni
+// secciones críticas ni llamadas a FreeRTOS, así que se puede llamar desde una ISR.
+typedef struct {
+    _Atomic uint32_t seq;
+    usb_dlog_rec_aq_t rec;
+} dlog_slot_t;
+
+static dlog_slot_t s_ring[DLOG_RING_LEN_AQ];
+static _Atomic uint32_t s_head;     // posiciones reservadas = registros aceptados
+static uint32_t s_tail;             // solo el consumidor
+static atomic_bool s_ready;
+static atomic_uint s_dropped;
+static atomic_uint s_formatted;
+static atomic_uint s_streamed;
+static uint32_t s_high_water;
+
+void usb_dlog_init_aq(void) {
+    atomic_store_explicit(&s_ready, false, memory_order_relaxed);
+    for (uint32_t i = 0; i < DLOG_RING_LEN_AQ; i++) {
+        atomic_store_explicit(&s_ring[i].seq, i, memory_order_relaxed);
+    }
+    atomic_store_explicit(&s_head, 0, memory_order_relaxed);
+    s_tail = 0;
+    s_high_water = 0;
+    atomic_store_explicit(&s_dropped, 0, memory_order_relaxed);
+    atomic_store_explicit(&s_formatted, 0, memory_order_relaxed);
+    atomic_store_explicit(&s_streamed, 0, memory_order_relaxed);
+    atomic_store_explicit(&s_ready, true, memory_order_release);
+}
+
+void usb_dlog_put_aq(usb_dlog_msg_aq_t id, uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+    if (!atomic_load_explicit(&s_ready, memory_order_acquire)) return;
+    uint32_t pos = atomic_load_explicit(&s_head, memory_order_relaxed);
+    dlog_slot_t *slot;
+    for (;;) {
+        slot = &s_ring[pos & DLOG_RING_MASK_AQ];
+        int32_t diff = (int32_t)(atomic_load_explicit(&slot->seq, memory_order_acquire) - pos);
+        if (diff == 0) {
+            // Si otro productor gana, el CAS deja en pos el head actual y se reintenta
+            if (atomic_compare_exchange_weak_explicit(&s_head, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Lleno: se pierde el registro nuevo, nunca se bloquea la ruta de datos
+            atomic_fetch_add_explicit(&s_dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&s_head, memory_order_relaxed);
+        }
+    }
+    usb_dlog_rec_aq_t *r = &slot->rec;
+    r->ts_us = usb_stats_stamp_aq();
+    r->id = (uint16_t)id;
+    r->core = (uint16_t)esp_cpu_get_core_id();
+    r->args[0] = a;
+    r->args[1] = b;
+    r->args[2] = c;
+    r->args[3] = d;
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+}
+
+bool usb_dlog_pop_aq(usb_dlog_rec_aq_t *out) {
+    dlog_slot_t *slot = &s_ring[s_tail & DLOG_RING_MASK_AQ];
+    // Un productor interrumpido entre reservar y publicar retiene los siguientes
+    // registros hasta que termina; el consumidor los recoge en la próxima pasada.
+    if (atomic_load_explicit(&slot->seq, memory_order_acquire) != s_tail + 1) return false;
+    uint32_t depth = atomic_load_explicit(&s_head, memory_order_relaxed) - s_tail;
+    if (depth > s_high_water) s_high_water = depth;
+    *out = slot->rec;
+    atomic_store_explicit(&slot->seq, s_tail + DLOG_RING_LEN_AQ, memory_order_release);
+    s_tail++;
+    return true;
+}
+
+void usb_dlog_discard_aq(void) {
+    usb_dlog_rec_aq_t rec;
+    while (usb_dlog_pop_aq(&rec)) {
+    }
+}
+
+uint32_t usb_dlog_ring_bytes_aq(void) {
+    return sizeof(s_ring);
+}
+
+void usb_dlog_note_sent_aq(uint32_t formatted, uint32_t streamed) {
+    atomic_fetch_add_explicit(&s_formatted, formatted, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s_streamed, streamed, memory_order_relaxed);
+}
+
+void usb_dlog_stats_aq(usb_netif_log_stats_aq_t *out) {
+    out->recorded = atomic_load_explicit(&s_head, memory_order_relaxed);
+    out->dropped = atomic_load_explicit(&s_dropped, memory_order_relaxed);
+    out->formatted = atomic_load_explicit(&s_formatted, memory_order_relaxed);
+    out->streamed = atomic_load_explicit(&s_streamed, memory_order_relaxed);
+    out->ring_capacity = DLOG_RING_LEN_AQ;
+    out->ring_high_water = s_high_water;
+}
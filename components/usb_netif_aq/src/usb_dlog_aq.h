@@ -0,0 +1,71 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "sdkconfig.h"
+#include "usb_dlog_msgs_aq.h"
+#include "usb_netif_aq.h"
+
+// Log diferido de la ruta de datos. En el productor solo se copia un registro binario
+// (id del mensaje, marca de tiempo y hasta 4 argumentos de 32 bits) a un anillo
+// lock-free de varios productores: sin formatear, sin UART y sin secciones críticas,
+// así que vale desde cualquier tarea, núcleo o ISR. La tarea usb_log los formatea con
+// ESP_LOG más tarde o, con CONFIG_AQ_USB_DLOG_UDP, los envía en crudo al MASTER.
+// Un mensaje por encima de CONFIG_AQ_USB_LOG_LEVEL no genera código.
+
+#define USB_DLOG_ARGS_AQ 4
+
+typedef enum {
+#define USB_DLOG_ID_AQ(id, lvl, tag, fmt) USB_DLOG_##id##_AQ,
+    USB_DLOG_MSGS_AQ(USB_DLOG_ID_AQ)
+#undef USB_DLOG_ID_AQ
+    USB_DLOG_MSG_COUNT_AQ,
+} usb_dlog_msg_aq_t;
+
+// Nivel de cada mensaje como constante: el if de USB_DLOG_AQ se resuelve al compilar
+enum {
+#define USB_DLOG_LVL_AQ(id, lvl, tag, fmt) USB_DLOG_LVL_##id##_AQ = ESP_LOG_##lvl,
+    USB_DLOG_MSGS_AQ(USB_DLOG_LVL_AQ)
+#undef USB_DLOG_LVL_AQ
+};
+
+typedef struct {
+    uint32_t ts_us;   // usb_stats_stamp_aq() en el productor
+    uint16_t id;      // usb_dlog_msg_aq_t
+    uint16_t core;
+    uint32_t args[USB_DLOG_ARGS_AQ];
+} usb_dlog_rec_aq_t;
+
+typedef struct {
+    esp_log_level_t level;
+    const char *tag;
+    const char *fmt;
+} usb_dlog_desc_aq_t;
+
+extern const usb_dlog_desc_aq_t g_usb_dlog_desc_aq[USB_DLOG_MSG_COUNT_AQ];
+
+// USB_DLOG_AQ(RX_FRAME, len): los argumentos que falten valen 0
+#define USB_DLOG_AQ(msg, ...) USB_DLOG_PUT_AQ(msg, ##__VA_ARGS__, 0, 0, 0, 0)
+#define USB_DLOG_PUT_AQ(msg, a, b, c, d, ...)                                                   \
+    do {                                                                                        \
+        if (USB_DLOG_LVL_##msg##_AQ <= CONFIG_AQ_USB_LOG_LEVEL) {                               \
+            usb_dlog_put_aq(USB_DLOG_##msg##_AQ, (uint32_t)(uintptr_t)(a), (uint32_t)(uintptr_t)(b), \
+                            (uint32_t)(uintptr_t)(c), (uint32_t)(uintptr_t)(d));                \
+        }                                                                                       \
+    } while (0)
+
+// Anillo (usb_dlog_aq.c). Hasta usb_dlog_init_aq los registros se ignoran.
+void usb_dlog_init_aq(void);
+void usb_dlog_put_aq(usb_dlog_msg_aq_t id, uint32_t a, uint32_t b, uint32_t c, uint32_t d);
+bool usb_dlog_pop_aq(usb_dlog_rec_aq_t *out);           // solo el consumidor
+void usb_dlog_discard_aq(void);                         // vacía el anillo sin formatear
+uint32_t usb_dlog_ring_bytes_aq(void);
+void usb_dlog_stats_aq(usb_netif_log_stats_aq_t *out);  // contadores del anillo
+void usb_dlog_note_sent_aq(uint32_t formatted, uint32_t streamed);
+
+// Tarea usb_log (usb_dlog_task_aq.c). stop formatea lo pendiente antes de volver.
+esp_err_t usb_dlog_start_aq(esp_netif_t *netif);
+void      usb_dlog_stop_aq(void);
+uint32_t  usb_dlog_bytes_aq(void);  // anillo + lotes de la tarea, todo en .bss
@@ -0,0 +1,21 @@
+#pragma once
+
+// Catálogo de mensajes del log diferido: X(id, nivel, tag, formato).
+// El orden fija el identificador que viaja en cada registro, así que solo se añade
+// al final. tools/dlog_decode.py lee este fichero para formatear en el MASTER: un
+// mensaje por línea y formatos solo con %u, %d, %x, %X o %08x (argumentos de 32 bits).
+#define USB_DLOG_MSGS_AQ(X)                                                                      \
+    X(RX_FRAME,        DEBUG, "usb_netif_aq", "USB RX callback: %u bytes")                      \
+    X(RX_QUEUED,       DEBUG, "usb_netif_aq", "Packet queued for netif processing (depth %u)")  \
+    X(RX_DELIVER,      DEBUG, "usb_netif_aq", "RX task processing %u bytes")                    \
+    X(RX_NETIF_RESULT, DEBUG, "usb_netif_aq", "esp_netif_receive result: 0x%x")                 \
+    X(RX_OVERSIZE,     WARN,  "usb_netif_aq", "RX frame too large (%u bytes), dropped")         \
+    X(RX_RING_FULL,    ERROR, "usb_netif_aq", "RX ring full, packet dropped")                   \
+    X(RX_POOL_EMPTY,   ERROR, "usb_netif_aq", "RX pool exhausted, packet dropped")              \
+    X(RX_NOT_READY,    WARN,  "usb_netif_aq", "RX ring not available, dropping packet")         \
+    X(RX_NO_NETIF,     WARN,  "usb_netif_aq", "Netif not available, dropping packet")           \
+    X(RX_FOREIGN_BUF,  ERROR, "usb_netif_aq", "free_rx: buffer 0x%08x does not belong to the RX pool") \
+    X(TX_FAILED,       DEBUG, "usb_tx_aq",    "TX %u bytes failed: 0x%x")                      \
+    X(RX_FILTERED,     DEBUG, "usb_netif_aq", "RX frame filtered (%u bytes)")                   \
+    X(RX_PAUSE,        DEBUG, "usb_netif_aq", "RX paused, host NAKed (ring %u)")                \
+    X(RX_RESUME,       DEBUG, "usb_netif_aq", "RX resumed (ring %u)")
@@ -0,0 +1,202 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "usb_dlog_aq.h"
+#include "usb_mem_aq.h"
+#if CONFIG_AQ_USB_DLOG_UDP
+#include <errno.h>
+#include "lwip/sockets.h"
+#endif
+
+static const char *TAG = "usb_dlog_aq";
+
+// Consumidor del log diferido. Se despierta cada CONFIG_AQ_USB_DLOG_FLUSH_MS, vacía el
+// anillo por lotes y formatea con ESP_LOG o envía el lote en crudo por UDP. Si la consola
+// no da abasto el anillo se llena y los registros nuevos se cuentan como perdidos: el
+// coste para la ruta de datos sigue siendo el mismo.
+
+#define DLOG_BATCH_AQ 32
+
+static TaskHandle_t s_task = NULL;
+static esp_netif_t *s_netif = NULL;
+static atomic_bool s_stop = false;
+static atomic_bool s_exited = false;
+static uint32_t s_dropped_seen;
+static usb_dlog_rec_aq_t s_batch[DLOG_BATCH_AQ];
+
+static void format_rec(const usb_dlog_rec_aq_t *r) {
+    if (r->id >= USB_DLOG_MSG_COUNT_AQ) return;
+    const usb_dlog_desc_aq_t *d = &g_usb_dlog_desc_aq[r->id];
+    char line[96];
+    // Los formatos del catálogo solo usan conversiones de 32 bits (usb_dlog_msgs_aq.h)
+    snprintf(line, sizeof(line), d->fmt, (unsigned)r->args[0], (unsigned)r->args[1], (unsigned)r->args[2],
+             (unsigned)r->args[3]);
+    ESP_LOG_LEVEL(d->level, d->tag, "%s [%lu us]", line, (unsigned long)r->ts_us);
+}
+
+#if CONFIG_AQ_USB_DLOG_UDP
+// Datagrama en little-endian: cabecera y count registros. tools/dlog_decode.py lo decodifica.
+#define DLOG_UDP_MAGIC_AQ   0x474C5141u  // "AQLG"
+#define DLOG_UDP_VERSION_AQ 1
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint32_t seq;       // número de datagrama, para detectar pérdidas en el MASTER
+    uint32_t dropped;   // registros perdidos con el anillo lleno desde el arranque
+} dlog_udp_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t ts_us;
+    uint16_t id;
+    uint8_t  level;
+    uint8_t  core;
+    uint32_t args[USB_DLOG_ARGS_AQ];
+} dlog_udp_rec_t;
+
+static int s_sock = -1;
+static struct sockaddr_in s_dest;
+static uint32_t s_udp_seq;
+static uint8_t s_dgram[sizeof(dlog_udp_hdr_t) + DLOG_BATCH_AQ * sizeof(dlog_udp_rec_t)];
+
+static void udp_close(void) {
+    if (s_sock >= 0) {
+        close(s_sock);
+        s_sock = -1;
+    }
+}
+
+// Socket ligado a la netif USB; destino el host del Kconfig o, vacío, la pasarela (MASTER)
+static bool udp_open(void) {
+    if (!usb_netif_is_link_up_aq()) {
+        udp_close();
+        return false;
+    }
+    if (s_sock >= 0) return true;
+    esp_netif_ip_info_t ip;
+    if (s_netif == NULL || esp_netif_get_ip_info(s_netif, &ip) != ESP_OK || ip.ip.addr == 0) return false;
+
+    s_dest = (struct sockaddr_in){
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_AQ_USB_DLOG_UDP_PORT),
+    };
+    if (CONFIG_AQ_USB_DLOG_UDP_HOST[0] == '\0' || inet_aton(CONFIG_AQ_USB_DLOG_UDP_HOST, &s_dest.sin_addr) == 0) {
+        s_dest.sin_addr.s_addr = ip.gw.addr;
+    }
+    if (s_dest.sin_addr.s_addr == 0) return false;
+
+    int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (fd < 0) return false;
+    struct ifreq ifr = {0};
+    if (esp_netif_get_netif_impl_name(s_netif, ifr.ifr_name) == ESP_OK) {
+        setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, &ifr, sizeof(ifr));
+    }
+    s_sock = fd;
+    ESP_LOGI(TAG, "Streaming log records to %s:%d", inet_ntoa(s_dest.sin_addr), CONFIG_AQ_USB_DLOG_UDP_PORT);
+    return true;
+}
+
+// false si el lote no salió: el llamador lo formatea en la consola
+static bool stream_batch(const usb_dlog_rec_aq_t *recs, uint32_t n) {
+    if (!udp_open()) return false;
+    dlog_udp_hdr_t *h = (dlog_udp_hdr_t *)s_dgram;
+    usb_netif_log_stats_aq_t st;
+    usb_dlog_stats_aq(&st);
+    h->magic = DLOG_UDP_MAGIC_AQ;
+    h->version = DLOG_UDP_VERSION_AQ;
+    h->count = (uint16_t)n;
+    h->seq = s_udp_seq++;
+    h->dropped = st.dropped;
+    dlog_udp_rec_t *w = (dlog_udp_rec_t *)(s_dgram + sizeof(*h));
+    for (uint32_t i = 0; i < n; i++) {
+        w[i].ts_us = recs[i].ts_us;
+        w[i].id = recs[i].id;
+        w[i].level = recs[i].id < USB_DLOG_MSG_COUNT_AQ ? (uint8_t)g_usb_dlog_desc_aq[recs[i].id].level : 0;
+        w[i].core = (uint8_t)recs[i].core;
+        memcpy(w[i].args, recs[i].args, sizeof(w[i].args));
+    }
+    size_t len = sizeof(*h) + n * sizeof(dlog_udp_rec_t);
+    if (sendto(s_sock, s_dgram, len, 0, (struct sockaddr *)&s_dest, sizeof(s_dest)) < 0) {
+        ESP_LOGW(TAG, "Log stream send failed (errno %d), back to console", errno);
+        udp_close();
+        return false;
+    }
+    return true;
+}
+#else
+static bool stream_batch(const usb_dlog_rec_aq_t *recs, uint32_t n) {
+    return false;
+}
+#endif
+
+static void drain(void) {
+    uint32_t n;
+    do {
+        n = 0;
+        while (n < DLOG_BATCH_AQ && usb_dlog_pop_aq(&s_batch[n])) {
+            n++;
+        }
+        if (n == 0) break;
+        if (stream_batch(s_batch, n)) {
+            usb_dlog_note_sent_aq(0, n);
+        } else {
+            for (uint32_t i = 0; i < n; i++) {
+                format_rec(&s_batch[i]);
+            }
+            usb_dlog_note_sent_aq(n, 0);
+        }
+    } while (n == DLOG_BATCH_AQ);
+
+    usb_netif_log_stats_aq_t st;
+    usb_dlog_stats_aq(&st);
+    if (st.dropped != s_dropped_seen) {
+        ESP_LOGW(TAG, "%lu log records dropped (ring full)", (unsigned long)(st.dropped - s_dropped_seen));
+        s_dropped_seen = st.dropped;
+    }
+}
+
+static void usb_log_task(void *arg) {
+    while (!atomic_load_explicit(&s_stop, memory_order_acquire)) {
+        drain();
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_AQ_USB_DLOG_FLUSH_MS));
+    }
+    // Último vaciado y socket cerrado; usb_dlog_stop_aq borra la tarea cuando ve s_exited
+    drain();
+#if CONFIG_AQ_USB_DLOG_UDP
+    udp_close();
+#endif
+    atomic_store_explicit(&s_exited, true, memory_order_release);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+uint32_t usb_dlog_bytes_aq(void) {
+#if CONFIG_AQ_USB_DLOG_UDP
+    return usb_dlog_ring_bytes_aq() + sizeof(s_batch) + sizeof(s_dgram);
+#else
+    return usb_dlog_ring_bytes_aq() + sizeof(s_batch);
+#endif
+}
+
+esp_err_t usb_dlog_start_aq(esp_netif_t *netif) {
+    s_netif = netif;
+    atomic_store(&s_stop, false);
+    atomic_store(&s_exited, false);
+    return usb_mem_task_create_aq(USB_NETIF_TASK_LOG_AQ, usb_log_task, NULL, CONFIG_AQ_USB_LOG_TASK_PRIO,
+                                  tskNO_AFFINITY, &s_task);
+}
+
+void usb_dlog_stop_aq(void) {
+    if (s_task == NULL) return;
+    atomic_store_explicit(&s_stop, true, memory_order_release);
+    xTaskNotifyGive(s_task);
+    // Acotado: un envío UDP bloqueado no debe colgar usb_netif_stop_aq
+    for (int i = 0; i < 50 && !atomic_load_explicit(&s_exited, memory_order_acquire); i++) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    usb_mem_task_delete_aq(USB_NETIF_TASK_LOG_AQ);
+    s_task = NULL;
+    s_netif = NULL;
+}
@@ -0,0 +1,385 @@
+#include "usb_link_aq.h"
+#include <stddef.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_event.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "usb_netif_aq.h"
+#include "usb_mem_aq.h"
+
+static const char *TAG = "usb_link_aq";
+
+ESP_EVENT_DEFINE_BASE(USB_NET_EVENTS);
+
+#define LINK_TASK_PRIO       5
+#define DHCP_RETRY_MAX_MS    16000
+#define LEASE_MAGIC          0x4C534541u  // "LSEA"
+#define LEASE_NVS_NAMESPACE  "usb_netif_aq"
+#define LEASE_NVS_KEY        "lease"
+
+typedef enum {
+    LINK_ST_DOWN = 0,   // USB sin montar
+    LINK_ST_DHCP,       // esperando concesión DHCP
+    LINK_ST_FAST_IP,    // IP de caché/estática aplicada (montaje o renovación), esperando GOT_IP
+    LINK_ST_UP,         // con IP
+} link_state_t;
+
+typedef struct {
+    uint32_t magic;
+    esp_netif_ip_info_t ip_info;
+    uint32_t crc;
+} lease_cache_t;
+
+// Sobrevive a reinicios en caliente; la copia en NVS cubre los arranques en frío
+static RTC_NOINIT_ATTR lease_cache_t s_rtc_lease;
+
+static esp_netif_t *s_netif = NULL;
+static TaskHandle_t s_link_task = NULL;
+static link_state_t s_state = LINK_ST_DOWN;
+static bool s_renew_pending = false;   // falta lanzar DHCP en segundo plano
+static bool s_renewing = false;        // DHCP en marcha tras el fast path, sin respuesta aún
+static bool s_up_posted = false;       // USB_NET_UP publicado y sin su USB_NET_DOWN
+static esp_ip4_addr_t s_up_ip;         // la publicada en USB_NET_UP
+static esp_netif_ip_info_t s_up_info;  // la concesión en uso, para restore_lease
+static int64_t s_deadline_us = 0;      // 0 = sin temporizador
+static uint32_t s_dhcp_retry_ms = CONFIG_AQ_USB_DHCP_RETRY_MS;
+static int64_t s_mount_us = 0;
+static esp_netif_ip_info_t s_got_ip_info;
+static portMUX_TYPE s_ip_lock = portMUX_INITIALIZER_UNLOCKED;
+static usb_netif_link_timing_aq_t s_timing;
+
+static uint32_t lease_crc(const lease_cache_t *c) {
+    return esp_rom_crc32_le(0, (const uint8_t *)c, offsetof(lease_cache_t, crc));
+}
+
+static bool lease_valid(const lease_cache_t *c) {
+    return c->magic == LEASE_MAGIC && c->crc == lease_crc(c) && c->ip_info.ip.addr != 0;
+}
+
+static bool lease_load(esp_netif_ip_info_t *out) {
+    if (lease_valid(&s_rtc_lease)) {
+        *out = s_rtc_lease.ip_info;
+        return true;
+    }
+    nvs_handle_t h;
+    if (nvs_open(LEASE_NVS_NAMESPACE, NVS_READONLY, &h) != ESP_OK) {
+        return false;
+    }
+    lease_cache_t c;
+    size_t len = sizeof(c);
+    bool ok = nvs_get_blob(h, LEASE_NVS_KEY, &c, &len) == ESP_OK && len == sizeof(c) && lease_valid(&c);
+    nvs_close(h);
+    if (ok) {
+        s_rtc_lease = c;
+        *out = c.ip_info;
+    }
+    return ok;
+}
+
+static void lease_store(const esp_netif_ip_info_t *ip_info) {
+    // Solo se escribe flash si la concesión cambia
+    if (lease_valid(&s_rtc_lease) && memcmp(&s_rtc_lease.ip_info, ip_info, sizeof(*ip_info)) == 0) {
+        return;
+    }
+    s_rtc_lease.magic = LEASE_MAGIC;
+    s_rtc_lease.ip_info = *ip_info;
+    s_rtc_lease.crc = lease_crc(&s_rtc_lease);
+
+    nvs_handle_t h;
+    if (nvs_open(LEASE_NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK) {
+        ESP_LOGW(TAG, "NVS not available, lease cached in RTC memory only");
+        return;
+    }
+    if (nvs_set_blob(h, LEASE_NVS_KEY, &s_rtc_lease, sizeof(s_rtc_lease)) == ESP_OK) {
+        nvs_commit(h);
+    }
+    nvs_close(h);
+}
+
+static void post_event(usb_net_event_aq_t id, const void *data, size_t len) {
+    esp_err_t err = esp_event_post(USB_NET_EVENTS, id, data, len, 0);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Cannot post link event %d: %s", id, esp_err_to_name(err));
+    }
+}
+
+static void start_dhcp(void) {
+    esp_netif_dhcpc_stop(s_netif);
+    esp_err_t ret = esp_netif_dhcpc_start(s_netif);
+    ESP_LOGI(TAG, "DHCP client start: %s", esp_err_to_name(ret));
+    s_deadline_us = esp_timer_get_time() + (int64_t)s_dhcp_retry_ms * 1000;
+}
+
+static void apply_fallback_dns(void) {
+    if (CONFIG_AQ_USB_FALLBACK_DNS[0] == '\0') return;
+    esp_netif_dns_info_t dns = { 0 };
+    if (esp_netif_str_to_ip4(CONFIG_AQ_USB_FALLBACK_DNS, &dns.ip.u_addr.ip4) == ESP_OK) {
+        dns.ip.type = ESP_IPADDR_TYPE_V4;
+        esp_netif_set_dns_info(s_netif, ESP_NETIF_DNS_BACKUP, &dns);
+    }
+}
+
+// Renovación tras el fast path, solo con la API de esp_netif (nada de tocar la struct netif
+// ni llamar a dhcp_* desde fuera de esp_netif). esp_netif_dhcpc_start deja la netif en 0.0.0.0
+// durante el intercambio, pero sin netif_set_addr: lwIP no aborta los pcb TCP ligados a la IP
+// (la sesión MQTT), solo se retransmiten sus segmentos. El cliente parte de parado (on_mount
+// o restore_lease), así que dhcp_release_and_stop no quita ninguna dirección. La ventana es
+// siempre CONFIG_AQ_USB_DHCP_RETRY_MS; el backoff alarga el tiempo entre intentos, con la
+// concesión en uso.
+static void renew_dhcp(void) {
+    esp_netif_dhcpc_stop(s_netif);
+    esp_err_t ret = esp_netif_dhcpc_start(s_netif);
+    ESP_LOGI(TAG, "DHCP client start to confirm " IPSTR ": %s", IP2STR(&s_up_ip), esp_err_to_name(ret));
+    apply_fallback_dns();  // esp_netif_dhcpc_start borra los servidores DNS
+    s_deadline_us = esp_timer_get_time() + (int64_t)CONFIG_AQ_USB_DHCP_RETRY_MS * 1000;
+}
+
+// Sin respuesta a la renovación: se para el cliente y vuelve la concesión en uso con
+// esp_netif_set_ip_info, como en on_mount. Pasar de 0.0.0.0 a la IP tampoco aborta pcb. El
+// GOT_IP que publica set_ip_info no viene del servidor: LINK_ST_FAST_IP hasta on_got_ip.
+static void restore_lease(void) {
+    esp_netif_dhcpc_stop(s_netif);
+    s_state = LINK_ST_FAST_IP;
+    esp_err_t ret = esp_netif_set_ip_info(s_netif, &s_up_info);
+    if (ret != ESP_OK) {
+        s_state = LINK_ST_UP;  // sin GOT_IP que esperar; el siguiente intento sigue con DHCP
+    }
+    ESP_LOGW(TAG, "No DHCP answer, keeping " IPSTR " (next retry %lu ms): %s", IP2STR(&s_up_info.ip),
+             (unsigned long)s_dhcp_retry_ms, esp_err_to_name(ret));
+}
+
+static void backoff_dhcp(void) {
+    s_dhcp_retry_ms = s_dhcp_retry_ms * 2 > DHCP_RETRY_MAX_MS ? DHCP_RETRY_MAX_MS : s_dhcp_retry_ms * 2;
+}
+
+static bool static_ip_info(esp_netif_ip_info_t *out) {
+#if CONFIG_AQ_USB_IP_STATIC
+    memset(out, 0, sizeof(*out));
+    return esp_netif_str_to_ip4(CONFIG_AQ_USB_STATIC_IP, &out->ip) == ESP_OK &&
+           esp_netif_str_to_ip4(CONFIG_AQ_USB_STATIC_NETMASK, &out->netmask) == ESP_OK &&
+           esp_netif_str_to_ip4(CONFIG_AQ_USB_STATIC_GW, &out->gw) == ESP_OK;
+#else
+    return false;
+#endif
+}
+
+static void on_mount(void) {
+    s_mount_us = esp_timer_get_time();
+    s_timing.mounts++;
+    post_event(USB_NET_MOUNTED, NULL, 0);
+
+    esp_netif_action_start(s_netif, NULL, 0, NULL);
+
+    esp_netif_ip_info_t ip_info;
+    bool fast = static_ip_info(&ip_info);
+#if CONFIG_AQ_USB_IP_DHCP && CONFIG_AQ_USB_LEASE_CACHE
+    fast = fast || lease_load(&ip_info);
+#endif
+    s_dhcp_retry_ms = CONFIG_AQ_USB_DHCP_RETRY_MS;
+    s_renewing = false;
+
+    // Con el cliente DHCP parado, action_connected solo levanta la netif: no arranca un
+    // DHCP que el fast path tendría que volver a parar
+    esp_netif_dhcpc_stop(s_netif);
+    esp_netif_action_connected(s_netif, NULL, 0, NULL);
+
+    if (fast) {
+        // Fast path: sin esperar al servidor DHCP. set_ip_info publica GOT_IP.
+        if (esp_netif_set_ip_info(s_netif, &ip_info) == ESP_OK) {
+            ESP_LOGI(TAG, "Fast path: reusing " IPSTR, IP2STR(&ip_info.ip));
+            s_state = LINK_ST_FAST_IP;
+#if CONFIG_AQ_USB_IP_DHCP
+            s_renew_pending = true;
+            s_deadline_us = esp_timer_get_time() + (int64_t)CONFIG_AQ_USB_LEASE_RENEW_DELAY_MS * 1000;
+#endif
+            return;
+        }
+        ESP_LOGW(TAG, "Cached address rejected, falling back to DHCP");
+    }
+    s_state = LINK_ST_DHCP;
+    s_renew_pending = false;
+    start_dhcp();
+}
+
+static void on_umount(void) {
+    usb_net_down_data_aq_t data = { .at_us = esp_timer_get_time() };
+    bool was_up = s_up_posted;
+    esp_netif_dhcpc_stop(s_netif);
+    esp_netif_action_disconnected(s_netif, NULL, 0, NULL);
+    s_state = LINK_ST_DOWN;
+    s_deadline_us = 0;
+    s_renew_pending = false;
+    s_renewing = false;
+    s_up_posted = false;
+    if (was_up) {
+        post_event(USB_NET_DOWN, &data, sizeof(data));
+    }
+    post_event(USB_NET_UNMOUNTED, &data, sizeof(data));
+}
+
+static void on_got_ip(void) {
+    esp_netif_ip_info_t ip_info;
+    taskENTER_CRITICAL(&s_ip_lock);
+    ip_info = s_got_ip_info;
+    taskEXIT_CRITICAL(&s_ip_lock);
+
+    if (s_state == LINK_ST_DOWN) return;  // concesión tardía tras desconectar
+
+    // Solo el GOT_IP de set_ip_info (fast path o restore_lease) no viene del servidor
+    bool from_dhcp = s_state != LINK_ST_FAST_IP;
+    if (s_up_posted && ip_info.ip.addr != s_up_ip.addr) {
+        // El servidor no confirmó la IP en uso: para la aplicación es otro enlace
+        usb_net_down_data_aq_t down = { .at_us = esp_timer_get_time() };
+        ESP_LOGW(TAG, "Lease changed " IPSTR " -> " IPSTR, IP2STR(&s_up_ip), IP2STR(&ip_info.ip));
+        post_event(USB_NET_DOWN, &down, sizeof(down));
+        s_up_posted = false;
+    }
+    bool first = !s_up_posted;
+    s_state = LINK_ST_UP;
+    s_up_info = ip_info;
+    if (from_dhcp) {
+        s_renewing = false;
+    }
+    if (!s_renew_pending && !s_renewing) s_deadline_us = 0;  // si no, queda programada la renovación
+
+#if CONFIG_AQ_USB_IP_DHCP && CONFIG_AQ_USB_LEASE_CACHE
+    if (from_dhcp) {
+        lease_store(&ip_info);  // concesión real del servidor
+    }
+#endif
+    apply_fallback_dns();
+
+    if (first) {
+        s_up_posted = true;
+        s_up_ip = ip_info.ip;
+        usb_net_up_data_aq_t data = {
+            .ip = ip_info.ip,
+            .mount_to_ip_us = (uint32_t)(esp_timer_get_time() - s_mount_us),
+            .fast_path = !from_dhcp,
+        };
+        s_timing.last_mount_to_ip_us = data.mount_to_ip_us;
+        s_timing.last_fast_path = data.fast_path;
+        if (s_timing.best_mount_to_ip_us == 0 || data.mount_to_ip_us < s_timing.best_mount_to_ip_us) {
+            s_timing.best_mount_to_ip_us = data.mount_to_ip_us;
+        }
+        if (data.mount_to_ip_us > s_timing.worst_mount_to_ip_us) {
+            s_timing.worst_mount_to_ip_us = data.mount_to_ip_us;
+        }
+        ESP_LOGI(TAG, "Link UP " IPSTR " in %lu us (%s)", IP2STR(&data.ip),
+                 (unsigned long)data.mount_to_ip_us, data.fast_path ? "fast path" : "DHCP");
+        post_event(USB_NET_UP, &data, sizeof(data));
+    }
+}
+
+static void on_lost_ip(void) {
+    if (!s_up_posted) return;
+    // La concesión caducó sin renovarse: sin IP hasta que DHCP consiga otra
+    usb_net_down_data_aq_t data = { .at_us = esp_timer_get_time() };
+    ESP_LOGW(TAG, "Lease lost on " IPSTR, IP2STR(&s_up_ip));
+    s_state = LINK_ST_DHCP;
+    s_renew_pending = false;
+    s_renewing = false;
+    s_up_posted = false;
+    s_dhcp_retry_ms = CONFIG_AQ_USB_DHCP_RETRY_MS;
+    post_event(USB_NET_DOWN, &data, sizeof(data));
+    start_dhcp();
+}
+
+static void on_timeout(void) {
+    if (s_renew_pending) {
+        // Confirmación en segundo plano tras el fast path, sin soltar la IP en uso
+        s_renew_pending = false;
+        s_renewing = true;
+        ESP_LOGI(TAG, "Renewing cached lease via DHCP");
+        renew_dhcp();
+        return;
+    }
+    if (s_renewing) {
+        // Sin respuesta del servidor: se sigue con la IP de la caché (RFC 2131 3.2) y se
+        // reintenta con backoff. Un NAK u otra IP llegan por on_got_ip/on_lost_ip.
+        s_renewing = false;
+        backoff_dhcp();
+        restore_lease();
+        s_renew_pending = true;
+        s_deadline_us = esp_timer_get_time() + (int64_t)s_dhcp_retry_ms * 1000;
+        return;
+    }
+    if (s_state == LINK_ST_DHCP) {
+        // Sin respuesta: reiniciar el cliente con backoff exponencial
+        backoff_dhcp();
+        ESP_LOGW(TAG, "No DHCP lease yet, restarting client (next retry %lu ms)", (unsigned long)s_dhcp_retry_ms);
+        start_dhcp();
+    }
+}
+
+static void usb_link_task(void *arg) {
+    while (1) {
+        TickType_t wait = portMAX_DELAY;
+        if (s_deadline_us) {
+            int64_t rem_us = s_deadline_us - esp_timer_get_time();
+            wait = rem_us <= 0 ? 0 : pdMS_TO_TICKS((rem_us + 999) / 1000) + 1;
+        }
+        uint32_t events = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &events, wait);
+
+        // Un desmontaje anula cualquier montaje anterior pendiente en el mismo lote
+        if (events & USB_LINK_EVT_UMOUNT) on_umount();
+        if (events & USB_LINK_EVT_MOUNT) on_mount();
+        if (events & USB_LINK_EVT_GOT_IP) on_got_ip();
+        if (events & USB_LINK_EVT_LOST_IP) on_lost_ip();
+        if (s_deadline_us && esp_timer_get_time() >= s_deadline_us) {
+            s_deadline_us = 0;
+            on_timeout();
+        }
+    }
+}
+
+esp_err_t usb_link_start_aq(esp_netif_t *netif) {
+    if (netif == NULL) return ESP_ERR_INVALID_ARG;
+    s_netif = netif;
+    s_state = LINK_ST_DOWN;
+    s_up_posted = false;
+    return usb_mem_task_create_aq(USB_NETIF_TASK_LINK_AQ, usb_link_task, NULL, LINK_TASK_PRIO, tskNO_AFFINITY,
+                                  &s_link_task);
+}
+
+void usb_link_stop_aq(void) {
+    usb_mem_task_delete_aq(USB_NETIF_TASK_LINK_AQ);
+    s_link_task = NULL;
+    s_netif = NULL;
+}
+
+void usb_link_post_aq(uint32_t events) {
+    if (s_link_task) {
+        xTaskNotify(s_link_task, events, eSetBits);
+    }
+}
+
+void usb_link_got_ip_aq(const esp_netif_ip_info_t *ip_info) {
+    taskENTER_CRITICAL(&s_ip_lock);
+    s_got_ip_info = *ip_info;
+    taskEXIT_CRITICAL(&s_ip_lock);
+    usb_link_post_aq(USB_LINK_EVT_GOT_IP);
+}
+
+esp_err_t usb_netif_get_link_timing_aq(usb_netif_link_timing_aq_t *out) {
+    if (out == NULL) return ESP_ERR_INVALID_ARG;
+    *out = s_timing;
+    return ESP_OK;
+}
+
+esp_err_t usb_netif_clear_lease_cache_aq(void) {
+    memset(&s_rtc_lease, 0, sizeof(s_rtc_lease));
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(LEASE_NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+    err = nvs_erase_key(h, LEASE_NVS_KEY);
+    if (err == ESP_OK) nvs_commit(h);
+    nvs_close(h);
+    return err == ESP_ERR_NVS_NOT_FOUND ? ESP_OK : err;
+}
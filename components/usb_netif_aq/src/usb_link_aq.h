@@ -0,0 +1,16 @@
+#pragma once
+#include "esp_err.h"
+#include "esp_netif.h"
+
+// Máquina de estados de arranque del enlace (montaje -> IP). Corre en su propia tarea;
+// los callbacks de TinyUSB y de IP_EVENT solo le notifican eventos y vuelven enseguida.
+
+#define USB_LINK_EVT_MOUNT   (1u << 0)
+#define USB_LINK_EVT_UMOUNT  (1u << 1)
+#define USB_LINK_EVT_GOT_IP  (1u << 2)
+#define USB_LINK_EVT_LOST_IP (1u << 3)
+
+esp_err_t usb_link_start_aq(esp_netif_t *netif);
+void      usb_link_stop_aq(void);
+void      usb_link_post_aq(uint32_t events);
+void      usb_link_got_ip_aq(const esp_netif_ip_info_t *ip_info);
@@ -0,0 +1,203 @@
+#include "usb_mem_aq.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "usb_vchan_aq.h"
+
+static const char *TAG = "usb_mem_aq";
+
+#if CONFIG_AQ_USB_BUF_PSRAM
+#define USB_POOL_CAPS_AQ (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#else
+#define USB_POOL_CAPS_AQ (MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA | MALLOC_CAP_8BIT)
+#endif
+
+typedef struct {
+    const char *name;
+    uint32_t stack;
+} task_desc_t;
+
+static const task_desc_t s_task_desc[USB_NETIF_TASK_COUNT_AQ] = {
+    [USB_NETIF_TASK_DEVICE_AQ] = { "usb_device", CONFIG_AQ_USB_DEVICE_TASK_STACK },
+    [USB_NETIF_TASK_RX_AQ] = { "usb_rx", CONFIG_AQ_USB_RX_TASK_STACK },
+    [USB_NETIF_TASK_TX_AQ] = { "usb_tx", CONFIG_AQ_USB_TX_TASK_STACK },
+    [USB_NETIF_TASK_LINK_AQ] = { "usb_link", CONFIG_AQ_USB_LINK_TASK_STACK },
+    [USB_NETIF_TASK_LOG_AQ] = { "usb_log", CONFIG_AQ_USB_LOG_TASK_STACK },
+};
+
+static TaskHandle_t s_tasks[USB_NETIF_TASK_COUNT_AQ];
+static portMUX_TYPE s_mem_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#if CONFIG_AQ_USB_STATIC_ALLOC
+// En IDF StackType_t es de 1 byte: el tamaño de la pila va en bytes
+static StackType_t s_stack_device[CONFIG_AQ_USB_DEVICE_TASK_STACK];
+static StackType_t s_stack_rx[CONFIG_AQ_USB_RX_TASK_STACK];
+static StackType_t s_stack_tx[CONFIG_AQ_USB_TX_TASK_STACK];
+static StackType_t s_stack_link[CONFIG_AQ_USB_LINK_TASK_STACK];
+static StackType_t s_stack_log[CONFIG_AQ_USB_LOG_TASK_STACK];
+static StackType_t *const s_stacks[USB_NETIF_TASK_COUNT_AQ] = {
+    s_stack_device, s_stack_rx, s_stack_tx, s_stack_link, s_stack_log,
+};
+static StaticTask_t s_tcbs[USB_NETIF_TASK_COUNT_AQ];
+
+// Arenas dimensionadas con el mismo Kconfig que usb_rx_aq y usb_tx_aq; un tamaño
+// distinto en tiempo de ejecución falla en usb_mem_alloc_aq, no corrompe memoria.
+#if CONFIG_AQ_USB_VENDOR_CHANNEL
+// Bloques y sus dos anillos (libres y TX) del canal vendor; ver usb_vchan_block_size_aq
+#define USB_MEM_VENDOR_RING_SLOTS_AQ (2 * (CONFIG_AQ_USB_VENDOR_BLOCKS + 1))
+#define USB_MEM_VENDOR_BYTES_AQ \
+    (CONFIG_AQ_USB_VENDOR_BLOCKS * ((USB_VCHAN_HDR_AQ + CONFIG_AQ_USB_VENDOR_BLOCK_SIZE + 1 + 3) & ~3u))
+#else
+#define USB_MEM_VENDOR_RING_SLOTS_AQ 0
+#define USB_MEM_VENDOR_BYTES_AQ      4
+#endif
+#define USB_MEM_RING_BYTES_AQ                                                        \
+    ((CONFIG_AQ_USB_RX_RING_LEN + 1 + CONFIG_AQ_USB_TX_CTRL_QUEUE_LEN + 1 +          \
+      CONFIG_AQ_USB_TX_BULK_QUEUE_LEN + 1 + USB_MEM_VENDOR_RING_SLOTS_AQ) * USB_MEM_RING_SLOT_AQ)
+#define USB_MEM_POOL_BYTES_AQ (CONFIG_AQ_USB_RX_POOL_SIZE * USB_RX_BUF_SIZE_AQ)
+
+static WORD_ALIGNED_ATTR uint8_t s_ring_arena[USB_MEM_RING_BYTES_AQ];
+#if CONFIG_AQ_USB_BUF_PSRAM
+static EXT_RAM_BSS_ATTR WORD_ALIGNED_ATTR uint8_t s_pool_arena[USB_MEM_POOL_BYTES_AQ];
+#else
+static DMA_ATTR uint8_t s_pool_arena[USB_MEM_POOL_BYTES_AQ];
+#endif
+static DMA_ATTR uint8_t s_vendor_arena[USB_MEM_VENDOR_BYTES_AQ];
+
+// Asignador lineal: el componente reserva todo en install y lo libera todo en stop,
+// así que la arena vuelve a cero cuando no queda ningún bloque vivo.
+typedef struct {
+    uint8_t *base;
+    size_t size;
+    size_t used;
+    uint32_t live;
+} arena_t;
+
+static arena_t s_arenas[USB_MEM_REGION_COUNT_AQ] = {
+    [USB_MEM_RINGS_AQ] = { s_ring_arena, sizeof(s_ring_arena) },
+    [USB_MEM_RX_POOL_AQ] = { s_pool_arena, sizeof(s_pool_arena) },
+    [USB_MEM_VENDOR_AQ] = { s_vendor_arena, sizeof(s_vendor_arena) },
+};
+#else
+static uint32_t s_heap_bytes[USB_MEM_REGION_COUNT_AQ];
+#endif
+
+esp_err_t usb_mem_task_create_aq(usb_netif_task_aq_t id, TaskFunction_t fn, void *arg, UBaseType_t prio,
+                                 BaseType_t core, TaskHandle_t *out) {
+    if (id >= USB_NETIF_TASK_COUNT_AQ || s_tasks[id] != NULL) return ESP_ERR_INVALID_STATE;
+    const task_desc_t *d = &s_task_desc[id];
+#if CONFIG_AQ_USB_STATIC_ALLOC
+    TaskHandle_t h = xTaskCreateStaticPinnedToCore(fn, d->name, d->stack, arg, prio, s_stacks[id], &s_tcbs[id], core);
+    if (h == NULL) return ESP_FAIL;
+#else
+    TaskHandle_t h = NULL;
+    if (xTaskCreatePinnedToCore(fn, d->name, d->stack, arg, prio, &h, core) != pdPASS) {
+        ESP_LOGE(TAG, "No memory for %s task (%lu byte stack)", d->name, (unsigned long)d->stack);
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+    s_tasks[id] = h;
+    if (out) *out = h;
+    return ESP_OK;
+}
+
+void usb_mem_task_delete_aq(usb_netif_task_aq_t id) {
+    if (id >= USB_NETIF_TASK_COUNT_AQ || s_tasks[id] == NULL) return;
+    TaskHandle_t h = s_tasks[id];
+    s_tasks[id] = NULL;
+    vTaskDelete(h);
+}
+
+void *usb_mem_alloc_aq(usb_mem_region_aq_t region, size_t size) {
+    if (region >= USB_MEM_REGION_COUNT_AQ || size == 0) return NULL;
+    void *p = NULL;
+#if CONFIG_AQ_USB_STATIC_ALLOC
+    arena_t *a = &s_arenas[region];
+    size = (size + 3) & ~(size_t)3;
+    taskENTER_CRITICAL(&s_mem_lock);
+    if (a->size - a->used >= size) {
+        p = a->base + a->used;
+        a->used += size;
+        a->live++;
+    }
+    taskEXIT_CRITICAL(&s_mem_lock);
+    if (p == NULL) {
+        ESP_LOGE(TAG, "Static arena %d exhausted (%u of %u bytes used, %u requested)", region,
+                 (unsigned)a->used, (unsigned)a->size, (unsigned)size);
+    }
+#else
+    static const uint32_t caps[USB_MEM_REGION_COUNT_AQ] = {
+        [USB_MEM_RINGS_AQ] = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT,
+        [USB_MEM_RX_POOL_AQ] = USB_POOL_CAPS_AQ,
+        [USB_MEM_VENDOR_AQ] = MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA | MALLOC_CAP_8BIT,
+    };
+    p = heap_caps_malloc(size, caps[region]);
+    if (p) {
+        taskENTER_CRITICAL(&s_mem_lock);
+        s_heap_bytes[region] += size;
+        taskEXIT_CRITICAL(&s_mem_lock);
+    }
+#endif
+    return p;
+}
+
+void usb_mem_free_aq(usb_mem_region_aq_t region, void *ptr, size_t size) {
+    if (ptr == NULL || region >= USB_MEM_REGION_COUNT_AQ) return;
+#if CONFIG_AQ_USB_STATIC_ALLOC
+    arena_t *a = &s_arenas[region];
+    taskENTER_CRITICAL(&s_mem_lock);
+    if (a->live && --a->live == 0) {
+        a->used = 0;
+    }
+    taskEXIT_CRITICAL(&s_mem_lock);
+#else
+    heap_caps_free(ptr);
+    taskENTER_CRITICAL(&s_mem_lock);
+    s_heap_bytes[region] -= size;
+    taskEXIT_CRITICAL(&s_mem_lock);
+#endif
+}
+
+void usb_mem_report_aq(usb_netif_mem_report_aq_t *out) {
+    uint32_t stacks = 0;
+    for (int i = 0; i < USB_NETIF_TASK_COUNT_AQ; i++) {
+        usb_netif_task_mem_aq_t *t = &out->tasks[i];
+        TaskHandle_t h = s_tasks[i];
+        t->name = s_task_desc[i].name;
+        t->stack_size = s_task_desc[i].stack;
+        t->running = h != NULL;
+        // En IDF la marca de agua ya viene en bytes
+        t->stack_free_min = h ? (uint32_t)uxTaskGetStackHighWaterMark(h) : 0;
+#if CONFIG_AQ_USB_STATIC_ALLOC
+        stacks += t->stack_size + sizeof(StaticTask_t);
+#else
+        if (h) stacks += t->stack_size + sizeof(StaticTask_t);
+#endif
+    }
+    out->bytes_stacks = stacks;
+#if CONFIG_AQ_USB_BUF_PSRAM
+    out->rx_pool_psram = true;
+#else
+    out->rx_pool_psram = false;
+#endif
+#if CONFIG_AQ_USB_STATIC_ALLOC
+    out->static_alloc = true;
+    out->bytes_buffers = sizeof(s_ring_arena) + sizeof(s_pool_arena);
+#if CONFIG_AQ_USB_VENDOR_CHANNEL
+    out->bytes_buffers += sizeof(s_vendor_arena);
+#endif
+    out->bytes_static = stacks + out->bytes_buffers;
+    out->bytes_heap = 0;
+#else
+    out->static_alloc = false;
+    taskENTER_CRITICAL(&s_mem_lock);
+    out->bytes_buffers = 0;
+    for (int r = 0; r < USB_MEM_REGION_COUNT_AQ; r++) {
+        out->bytes_buffers += s_heap_bytes[r];
+    }
+    taskEXIT_CRITICAL(&s_mem_lock);
+    out->bytes_static = 0;
+    out->bytes_heap = stacks + out->bytes_buffers;
+#endif
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "usb_netif_aq.h"
+
+// Toda la memoria de larga duración del componente pasa por aquí: pilas de las tareas,
+// anillos SPSC, pool RX y bloques del canal vendor. Con CONFIG_AQ_USB_STATIC_ALLOC sale
+// de .bss (xTaskCreateStatic y arenas dimensionadas con el Kconfig) y el heap no se toca
+// ni al arrancar; sin él se reserva del heap como antes. En ambos casos se contabiliza
+// para usb_netif_get_mem_report_aq.
+
+#define USB_RX_BUF_SIZE_AQ   1536  // MTU Ethernet (1514) redondeado; un datagrama NCM por buffer
+#define USB_MEM_RING_SLOT_AQ (4 * sizeof(void *))  // máximo de un elemento de anillo (rx_packet_t, tx_item_t)
+
+typedef enum {
+    USB_MEM_RINGS_AQ = 0,  // anillos SPSC: siempre RAM interna, se tocan en cada trama desde dos núcleos
+    USB_MEM_RX_POOL_AQ,    // pool RX: RAM interna DMA o PSRAM según CONFIG_AQ_USB_BUF_PLACEMENT
+    USB_MEM_VENDOR_AQ,     // bloques del canal vendor: RAM interna DMA, el USB los lee directamente
+    USB_MEM_REGION_COUNT_AQ,
+} usb_mem_region_aq_t;
+
+esp_err_t usb_mem_task_create_aq(usb_netif_task_aq_t id, TaskFunction_t fn, void *arg, UBaseType_t prio,
+                                 BaseType_t core, TaskHandle_t *out);
+void      usb_mem_task_delete_aq(usb_netif_task_aq_t id);
+
+void *usb_mem_alloc_aq(usb_mem_region_aq_t region, size_t size);
+void  usb_mem_free_aq(usb_mem_region_aq_t region, void *ptr, size_t size);
+
+// Pilas (con su high-water mark) y bytes reservados; el resto del informe lo completa usb_netif_aq.c
+void usb_mem_report_aq(usb_netif_mem_report_aq_t *out);
@@ -1,9 +1,11 @@
 #include "usb_netif_aq.h"
+#include <stdatomic.h>
 #include "esp_log.h"
 #include "esp_netif.h"
 #include "esp_netif_types.h"
 #include "esp_mac.h"
 #include "esp_event.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
@@ -15,12 +17,32 @@
 #include "tinyusb.h"
 #include "tinyusb_net.h"
 #include "tusb.h"
+#include "device/usbd_pvt.h"  // usbd_defer_func
+#include "usb_csum_aq.h"
 #include "usb_descriptors_aq.h"
+#include "usb_dlog_aq.h"
+#include "usb_rx_pool_aq.h"
+#include "usb_rx_aq.h"
+#include "usb_tx_aq.h"
+#include "usb_tx_class_aq.h"
+#include "usb_link_aq.h"
+#include "usb_mem_aq.h"
+#include "usb_stats_aq.h"
+#include "usb_task_aq.h"
+#include "usb_vendor_aq.h"
 
 static const char *TAG = "usb_netif_aq";
 
-#define RX_QUEUE_SIZE 10
-#define RX_TASK_STACK_SIZE 8192
+// usbd_defer_func (usbd_pvt.h) y el --wrap de tud_network_recv_cb no son API pública de
+// TinyUSB: probados solo con tinyusb 0.18 y esp_tinyusb 1.7 (idf_component.yml). Con otra
+// versión el build tiene que fallar aquí y no en el enlazado o con la NCM parada.
+_Static_assert(TUSB_VERSION_MAJOR == 0 && TUSB_VERSION_MINOR == 18,
+               "usb_netif_aq: TinyUSB internals only tested with tinyusb 0.18.x");
+
+#if CONFIG_AQ_USB_TASK_EVENT && !CONFIG_TINYUSB_NO_DEFAULT_TASK
+#warning "Event-driven usb_device task expects CONFIG_TINYUSB_NO_DEFAULT_TASK=y (only one task may run tud_task)"
+#endif
+
 #define USB_CONNECTED_BIT (1 << 0)
 
 // Contexto del driver de bajo nivel (tinyusb)
@@ -34,88 +56,54 @@ typedef struct {
     usb_driver_context_t *impl;
 } usb_netif_driver_t;
 
-typedef struct {
-    uint8_t *buffer;
-    uint16_t len;
-} rx_packet_t;
-
 static usb_driver_context_t s_driver_context = {0};
-static bool s_link_up = false;
+static atomic_bool s_link_up = false;  // se lee desde cualquier núcleo (liveness)
 static SemaphoreHandle_t s_got_ip_sem = NULL;
 static esp_ip4_addr_t s_ip_addr;
 static usb_netif_cfg_aq_t s_netif_cfg;
 static uint8_t s_mac_addr[6];
-static QueueHandle_t s_rx_queue = NULL;
-static TaskHandle_t s_rx_task_handle = NULL;
 static TaskHandle_t s_usb_device_task_handle = NULL;  // CRITICAL: USB device task handle
 static EventGroupHandle_t s_usb_event_group = NULL;
+static volatile uint32_t s_usb_task_wakeups = 0;   // iteraciones del bucle de tud_task
+static int64_t s_usb_task_start_us = 0;
+#if CONFIG_AQ_USB_STATIC_ALLOC
+static StaticSemaphore_t s_got_ip_sem_buf;
+static StaticEventGroup_t s_usb_event_group_buf;
+#endif
 
 // Forward declarations
 static esp_err_t usb_netif_transmit(void *h, void *buffer, size_t len);
-static esp_err_t usb_recv_callback(void *buffer, uint16_t len, void *ctx);
-static void usb_netif_free_rx(void *h, void *buffer);
+static esp_err_t usb_netif_transmit_wrap(void *h, void *buffer, size_t len, void *netstack_buf);
 static esp_err_t usb_post_attach(esp_netif_t *esp_netif, void *args);
-static void usb_rx_task(void *arg);
 static void usb_device_task(void *param);  // CRITICAL: USB device task
 
-// TX: from esp_netif -> USB
-static esp_err_t usb_netif_transmit(void *h, void *buffer, size_t len) {
+// TX: from esp_netif -> TX queue -> USB
+// No bloquea el hilo tcpip: la trama se encola y usb_tx_task la entrega a TinyUSB.
+// Con la cola llena devolvemos ESP_ERR_NO_MEM, que lwIP traduce a ERR_MEM (backpressure).
+static esp_err_t usb_netif_transmit_wrap(void *h, void *buffer, size_t len, void *netstack_buf) {
     (void)h; // h es el handle de nuestro impl, s_driver_context
-    if (tinyusb_net_send_sync(buffer, len, NULL, pdMS_TO_TICKS(200)) == ESP_OK) {
-        return ESP_OK;
-    }
-    return ESP_FAIL;
+    return usb_tx_enqueue_aq(buffer, len, (struct pbuf *)netstack_buf);
 }
 
-// RX: from USB -> Queue
-static esp_err_t usb_recv_callback(void *buffer, uint16_t len, void *ctx) {
-    ESP_LOGI(TAG, "USB RX callback: %d bytes", len);
-    if (s_rx_queue) {
-        rx_packet_t pkt = { .buffer = malloc(len), .len = len };
-        if (pkt.buffer) {
-            memcpy(pkt.buffer, buffer, len);
-            if (xQueueSend(s_rx_queue, &pkt, 0) != pdTRUE) {
-                ESP_LOGE(TAG, "RX Queue full, packet dropped");
-                free(pkt.buffer);
-                return ESP_FAIL;
-            }
-            ESP_LOGI(TAG, "Packet queued for netif processing");
-            return ESP_OK;
-        } else {
-            ESP_LOGE(TAG, "Failed to allocate buffer for RX packet");
-            return ESP_FAIL;
-        }
-    }
-    ESP_LOGW(TAG, "RX queue not available, dropping packet");
-    return ESP_OK;
-}
-
-static void usb_netif_free_rx(void *h, void *buffer) {
-    (void)h;
-    free(buffer);
-}
-
-static void usb_rx_task(void *arg) {
-    rx_packet_t pkt;
-    while (1) {
-        if (xQueueReceive(s_rx_queue, &pkt, portMAX_DELAY) == pdTRUE) {
-            ESP_LOGI(TAG, "RX task processing %d bytes", pkt.len);
-            if (s_driver_context.netif) {
-                esp_err_t ret = esp_netif_receive(s_driver_context.netif, pkt.buffer, pkt.len, NULL);
-                ESP_LOGI(TAG, "esp_netif_receive result: %s", esp_err_to_name(ret));
-            } else {
-                ESP_LOGW(TAG, "Netif not available, dropping packet");
-                free(pkt.buffer);
-            }
-        }
-    }
+static esp_err_t usb_netif_transmit(void *h, void *buffer, size_t len) {
+    return usb_netif_transmit_wrap(h, buffer, len, NULL);
 }
 
 // ========== CRITICAL: USB DEVICE TASK ==========
 // Without this task, TinyUSB cannot process USB events and USB-NCM will not work
 static void usb_device_task(void *param) {
     ESP_LOGI(TAG, "USB device task started - CRITICAL for USB-NCM functionality");
-    
+
+#if CONFIG_AQ_USB_TASK_EVENT
+    // Modo por eventos: tud_task_ext() se bloquea en la cola de eventos de TinyUSB y
+    // solo vuelve cuando la ISR USB ha publicado trabajo y este se ha procesado.
+    // Sin retardo tras cada lote y sin CPU en reposo. El montaje llega como evento
+    // (tud_mount_cb), no hace falta sondearlo.
+    while (1) {
+        tud_task_ext(UINT32_MAX, false);
+        s_usb_task_wakeups++;
+    }
+#else
     // Wait for USB mount with timeout
     int mount_timeout = 50; // 5 seconds
     while (!tud_mounted() && mount_timeout > 0) {
@@ -133,8 +121,10 @@ static void usb_device_task(void *param) {
     // MAIN LOOP - ABSOLUTELY CRITICAL FOR USB FUNCTIONALITY
     while (1) {
         tud_task(); // <-- WITHOUT THIS LINE, USB-NCM WILL NOT WORK
+        s_usb_task_wakeups++;
         vTaskDelay(pdMS_TO_TICKS(1)); // Must be 1ms or less for proper USB timing
     }
+#endif
 }
 
 static esp_err_t usb_post_attach(esp_netif_t *esp_netif, void *args) {
@@ -145,7 +135,8 @@ static esp_err_t usb_post_attach(esp_netif_t *esp_netif, void *args) {
     const esp_netif_driver_ifconfig_t ifcfg = {
         .handle = drv->impl,
         .transmit = usb_netif_transmit,
-        .driver_free_rx_buffer = usb_netif_free_rx,
+        .transmit_wrap = usb_netif_transmit_wrap,
+        .driver_free_rx_buffer = usb_rx_free_aq,
     };
 
     return esp_netif_set_driver_config(esp_netif, &ifcfg);
@@ -155,72 +146,76 @@ static esp_err_t usb_post_attach(esp_netif_t *esp_netif, void *args) {
 // Note: The USB device task with tud_task() is handled by esp_tinyusb managed component
 
 // Callback when USB mounts
+// Corre en el contexto de TinyUSB: no debe bloquear. El arranque de red (netif up,
+// IP de caché o DHCP) lo hace la máquina de estados de usb_link_aq en su tarea.
 void tud_mount_cb(void) {
     ESP_LOGI(TAG, "=== USB MOUNTED EVENT ===");
-    s_link_up = true;
+    atomic_store_explicit(&s_link_up, true, memory_order_release);
     if (s_usb_event_group) {
         xEventGroupSetBits(s_usb_event_group, USB_CONNECTED_BIT);
     }
-    if (s_driver_context.netif) {
-        ESP_LOGI(TAG, "USB mounted, waiting 1s then starting DHCP client");
-        
-        // Give time for network stack to settle
-        vTaskDelay(pdMS_TO_TICKS(1000));
-        
-        // Check current DHCP status
-        esp_netif_dhcp_status_t dhcp_status;
-        esp_netif_dhcpc_get_status(s_driver_context.netif, &dhcp_status);
-        ESP_LOGI(TAG, "DHCP status before restart: %d", dhcp_status);
-        
-        // Ensure interface is up before starting DHCP
-        esp_netif_action_start(s_driver_context.netif, NULL, 0, NULL);
-        
-        // Force stop and restart DHCP client with more aggressive settings
-        esp_netif_dhcpc_stop(s_driver_context.netif);
-        vTaskDelay(pdMS_TO_TICKS(500));  // Longer delay
-        
-        // Configure DHCP options for faster discovery
-        uint32_t dns = esp_netif_htonl(0x08080808); // Google DNS as fallback
-        esp_netif_dhcpc_option(s_driver_context.netif, ESP_NETIF_OP_SET, ESP_NETIF_DOMAIN_NAME_SERVER, &dns, sizeof(dns));
-        
-        // Start DHCP client with explicit configuration
-        esp_err_t ret = esp_netif_dhcpc_start(s_driver_context.netif);
-        ESP_LOGI(TAG, "DHCP client start result: %s", esp_err_to_name(ret));
-        
-        // Check DHCP status after start
-        esp_netif_dhcpc_get_status(s_driver_context.netif, &dhcp_status);
-        ESP_LOGI(TAG, "DHCP status after start: %d", dhcp_status);
-        
-        // Longer delay for DHCP discovery to begin
-        vTaskDelay(pdMS_TO_TICKS(2000));
-        ESP_LOGI(TAG, "DHCP discovery should be active now - forcing refresh");
-        
-        // Force trigger DHCP by restarting after delay
-        ESP_LOGI(TAG, "Triggering additional DHCP restart to force packet transmission");
-        vTaskDelay(pdMS_TO_TICKS(1000));
-        esp_netif_dhcpc_stop(s_driver_context.netif);
-        vTaskDelay(pdMS_TO_TICKS(100));
-        esp_netif_dhcpc_start(s_driver_context.netif);
-    } else {
-        ESP_LOGE(TAG, "CRITICAL: s_driver_context.netif is NULL - DHCP cannot start!");
-    }
+    usb_link_post_aq(USB_LINK_EVT_MOUNT);
 }
 
 // Callback when USB unmounts
 void tud_umount_cb(void) {
     ESP_LOGW(TAG, "=== USB UNMOUNTED EVENT ===");
-    s_link_up = false;
+    atomic_store_explicit(&s_link_up, false, memory_order_release);
     if (s_usb_event_group) {
         xEventGroupClearBits(s_usb_event_group, USB_CONNECTED_BIT);
     }
-    if (s_driver_context.netif) {
-        ESP_LOGI(TAG, "USB unmounted, stopping DHCP client");
-        esp_netif_dhcpc_stop(s_driver_context.netif);
-    }
+    usb_link_post_aq(USB_LINK_EVT_UMOUNT);
 }
 
 // Network init is handled by esp_tinyusb managed component
 
+#if CONFIG_AQ_USB_RX_FLOW_CONTROL
+// El tud_network_recv_cb de esp_tinyusb llama al on_recv_callback y enseguida a
+// tud_network_recv_renew, sin forma de aplazarlo. Con -Wl,--wrap (CMakeLists.txt) la clase
+// NCM llama a esta versión, que solo pide la siguiente trama si hay sitio para ella; si
+// no, usb_rx_aq reanuda más tarde desde usb_rx_task o el hilo tcpip.
+bool __wrap_tud_network_recv_cb(const uint8_t *src, uint16_t size);
+
+// tud_network_recv_renew solo desde la tarea usb_device
+static void rx_flow_renew(void *param) {
+    tud_network_recv_renew();
+}
+
+static void rx_flow_resume(void) {
+    usbd_defer_func(rx_flow_renew, NULL, false);
+}
+
+bool __wrap_tud_network_recv_cb(const uint8_t *src, uint16_t size) {
+    if (usb_rx_input_flow_aq(src, size)) {
+        tud_network_recv_renew();
+    }
+    return true;
+}
+#endif
+
+// SOF para usb_netif_set_sof_cb_aq. s_sof_cb/s_sof_ctx solo los tocan tud_sof_cb y
+// sof_apply, las dos en la tarea usb_device; el llamante deja el par en s_sof_next y la
+// cola de eventos de TinyUSB (usbd_defer_func) hace de barrera.
+typedef struct {
+    usb_netif_sof_cb_aq_t cb;
+    void *ctx;
+} sof_hook_t;
+static sof_hook_t s_sof_next;
+static usb_netif_sof_cb_aq_t s_sof_cb;
+static void *s_sof_ctx;
+
+void tud_sof_cb(uint32_t frame_count) {
+    int64_t t_us = esp_timer_get_time();
+    if (s_sof_cb) s_sof_cb(frame_count, t_us, s_sof_ctx);
+}
+
+// tud_sof_cb_enable toca el controlador: también desde la tarea usb_device
+static void sof_apply(void *param) {
+    s_sof_cb = s_sof_next.cb;
+    s_sof_ctx = s_sof_next.ctx;
+    tud_sof_cb_enable(s_sof_cb != NULL);
+}
+
 // Callback for link state changes (may not be called in esp_tinyusb managed component)
 void tud_network_link_state_cb(bool state) {
     ESP_LOGI(TAG, "Network link: %s", state ? "UP" : "DOWN");
@@ -237,31 +232,73 @@ static void on_got_ip(void *arg, esp_event_base_t event_base, int32_t event_id,
     }
     ESP_LOGI(TAG, "GOT_IP: " IPSTR, IP2STR(&event->ip_info.ip));
     s_ip_addr = event->ip_info.ip;
+    usb_link_got_ip_aq(&event->ip_info);
     xSemaphoreGive(s_got_ip_sem);
 }
 
+static void on_lost_ip(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
+    ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
+    if (s_driver_context.netif != event->esp_netif) {
+        return;
+    }
+    usb_link_post_aq(USB_LINK_EVT_LOST_IP);
+}
+
 esp_err_t usb_netif_install_aq(const usb_netif_cfg_aq_t *cfg) {
     if (cfg == NULL) return ESP_ERR_INVALID_ARG;
+    esp_err_t err = usb_csum_check_profile_aq(cfg->csum_profile);
+    if (err != ESP_OK) return err;
     s_netif_cfg = *cfg;
+    // Antes que RX/TX: sus descartes ya se registran en el log diferido
+    usb_dlog_init_aq();
     
     // Create synchronization primitives
+#if CONFIG_AQ_USB_STATIC_ALLOC
+    s_got_ip_sem = xSemaphoreCreateBinaryStatic(&s_got_ip_sem_buf);
+    s_usb_event_group = xEventGroupCreateStatic(&s_usb_event_group_buf);
+#else
     s_got_ip_sem = xSemaphoreCreateBinary();
     if (s_got_ip_sem == NULL) return ESP_ERR_NO_MEM;
     
-    s_rx_queue = xQueueCreate(RX_QUEUE_SIZE, sizeof(rx_packet_t));
-    if (s_rx_queue == NULL) {
-        vSemaphoreDelete(s_got_ip_sem);
-        return ESP_ERR_NO_MEM;
-    }
-    
     s_usb_event_group = xEventGroupCreate();
+#endif
     if (s_usb_event_group == NULL) {
         vSemaphoreDelete(s_got_ip_sem);
-        vQueueDelete(s_rx_queue);
         return ESP_ERR_NO_MEM;
     }
+
+    // Cola RX + pool de buffers preasignado
+    err = usb_rx_init_aq();
+    if (err != ESP_OK) {
+        vSemaphoreDelete(s_got_ip_sem);
+        vEventGroupDelete(s_usb_event_group);
+        return err;
+    }
+#if CONFIG_AQ_USB_RX_FLOW_CONTROL
+    usb_rx_set_resume_aq(rx_flow_resume);
+#endif
+
+    err = usb_tx_init_aq();
+    if (err != ESP_OK) {
+        vSemaphoreDelete(s_got_ip_sem);
+        vEventGroupDelete(s_usb_event_group);
+        usb_rx_deinit_aq();
+        return err;
+    }
+
+    // Bloques del canal vendor (no hace nada sin CONFIG_AQ_USB_VENDOR_CHANNEL)
+    err = usb_vendor_init_aq();
+    if (err != ESP_OK) {
+        vSemaphoreDelete(s_got_ip_sem);
+        vEventGroupDelete(s_usb_event_group);
+        usb_tx_deinit_aq();
+        usb_rx_deinit_aq();
+        return err;
+    }
     
-    return esp_event_handler_register(IP_EVENT, IP_EVENT_ETH_GOT_IP, &on_got_ip, NULL);
+    err = esp_event_handler_register(IP_EVENT, IP_EVENT_ETH_GOT_IP, &on_got_ip, NULL);
+    if (err != ESP_OK) return err;
+    return esp_event_handler_register(IP_EVENT, IP_EVENT_ETH_LOST_IP, &on_lost_ip, NULL);
 }
 
 esp_err_t usb_netif_start_aq(void) {
@@ -303,6 +340,12 @@ esp_err_t usb_netif_start_aq(void) {
     esp_err_t ret = esp_netif_dhcpc_stop(usb_netif);
     ESP_LOGI(TAG, "DHCP client stop result: %s", esp_err_to_name(ret));
 
+    // Solo esta netif: WiFi y las demás siguen con los checksums de lwIP
+    ret = usb_csum_apply_aq(usb_netif, s_netif_cfg.csum_profile);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Checksum profile not applied: %s", esp_err_to_name(ret));
+    }
+
     // Store netif reference BEFORE attaching driver
     s_driver_context.netif = usb_netif;
     
@@ -318,11 +361,26 @@ esp_err_t usb_netif_start_aq(void) {
         esp_netif_set_hostname(usb_netif, s_netif_cfg.hostname);
     }
 
+    // Tarea usb_log: formatea (o envía por UDP) el log diferido de la ruta de datos
+    if (usb_dlog_start_aq(usb_netif) != ESP_OK) {
+        ESP_LOGW(TAG, "Deferred log task not started, data path records stay in the ring");
+    }
+
+    // La máquina de estados del enlace debe existir antes del primer tud_mount_cb
+    if (usb_link_start_aq(usb_netif) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create USB link task");
+        return ESP_FAIL;
+    }
+
     const tinyusb_config_t tusb_cfg = {
         .external_phy = false,
         .device_descriptor = &g_tusb_device_descriptor_aq,
         .string_descriptor = (const char**)g_tusb_string_descriptor_aq,
         .string_descriptor_count = g_tusb_string_descriptor_aq_count,
+#if CONFIG_AQ_USB_VENDOR_CHANNEL
+        // Compuesto NCM + vendor; sin el canal esp_tinyusb genera el de NCM a partir del Kconfig
+        .configuration_descriptor = g_tusb_fs_configuration_descriptor_aq,
+#endif
     };
     ESP_LOGI(TAG, "Initializing TinyUSB driver...");
     ESP_ERROR_CHECK(tinyusb_driver_install(&tusb_cfg));
@@ -332,7 +390,7 @@ esp_err_t usb_netif_start_aq(void) {
     ESP_LOGI(TAG, "TinyUSB driver initialized via esp_tinyusb");
 
     tinyusb_net_config_t net_cfg = {
-        .on_recv_callback = usb_recv_callback,
+        .on_recv_callback = usb_rx_input_aq,
     };
     memcpy(net_cfg.mac_addr, s_mac_addr, 6);
     ESP_LOGI(TAG, "Initializing TinyUSB network with MAC: %02X:%02X:%02X:%02X:%02X:%02X",
@@ -340,23 +398,37 @@ esp_err_t usb_netif_start_aq(void) {
     ESP_ERROR_CHECK(tinyusb_net_init(TINYUSB_USBDEV_0, &net_cfg));
 
     // Create RX task
-    xTaskCreate(usb_rx_task, "usb_rx", RX_TASK_STACK_SIZE, NULL, 5, &s_rx_task_handle);
+    if (usb_rx_start_aq(usb_netif) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create USB RX task");
+        return ESP_FAIL;
+    }
+
+    // TX task: drena las colas de control y bulk hacia TinyUSB
+    if (usb_tx_start_aq() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create USB TX task");
+        return ESP_FAIL;
+    }
     
     // CRITICAL: Create USB device task - This is essential for USB-NCM functionality
-    BaseType_t task_ret = xTaskCreatePinnedToCore(
+    esp_err_t task_ret = usb_mem_task_create_aq(
+        USB_NETIF_TASK_DEVICE_AQ,  // usb_device, CONFIG_AQ_USB_DEVICE_TASK_STACK
         usb_device_task,           // Task function
-        "usb_device",              // Task name
-        4096,                      // Stack size
         NULL,                      // Parameters
         configMAX_PRIORITIES - 2, // High priority
-        &s_usb_device_task_handle, // Task handle
-        0                          // Core 0 (can try Core 1 if issues)
+        USB_TASK_CORE_AQ(CONFIG_AQ_USB_DEVICE_TASK_CORE),  // USB en un núcleo, lwIP en el otro
+        &s_usb_device_task_handle  // Task handle
     );
     
-    if (task_ret != pdPASS) {
+    if (task_ret != ESP_OK) {
         ESP_LOGE(TAG, "CRITICAL: Failed to create USB device task!");
         return ESP_FAIL;
     }
+    s_usb_task_start_us = esp_timer_get_time();
+
+    // Informe periódico de estadísticas (USB_NET_STATS) para reenviarlo al MASTER
+    if (usb_stats_start_aq(CONFIG_AQ_USB_STATS_PERIOD_MS) != ESP_OK) {
+        ESP_LOGW(TAG, "Stats report timer not started");
+    }
     
     ESP_LOGI(TAG, "CRITICAL: USB device task created - USB-NCM should now work");
     ESP_LOGI(TAG, "USB-NCM initialization complete");
@@ -367,20 +439,18 @@ esp_err_t usb_netif_start_aq(void) {
 esp_err_t usb_netif_stop_aq(void) {
     // Stop USB device task first
     if (s_usb_device_task_handle) {
-        vTaskDelete(s_usb_device_task_handle);
+        usb_mem_task_delete_aq(USB_NETIF_TASK_DEVICE_AQ);
         s_usb_device_task_handle = NULL;
         ESP_LOGI(TAG, "USB device task stopped");
     }
     
-    if (s_rx_task_handle) {
-        vTaskDelete(s_rx_task_handle);
-        s_rx_task_handle = NULL;
-    }
-    
-    if (s_rx_queue) {
-        vQueueDelete(s_rx_queue);
-        s_rx_queue = NULL;
-    }
+    usb_rx_stop_aq();
+
+    usb_stats_stop_aq();
+    usb_tx_stop_aq();
+    usb_link_stop_aq();
+    // Antes de destruir la netif: el último vaciado aún puede salir por UDP
+    usb_dlog_stop_aq();
     
     if (s_usb_event_group) {
         vEventGroupDelete(s_usb_event_group);
@@ -393,6 +463,9 @@ esp_err_t usb_netif_stop_aq(void) {
     }
     
     tinyusb_driver_uninstall();
+    usb_vendor_deinit_aq();
+    usb_tx_deinit_aq();
+    usb_rx_deinit_aq();
     return ESP_OK;
 }
 
@@ -403,12 +476,86 @@ esp_err_t usb_netif_get_esp_netif_aq(esp_netif_t **out) {
 }
 
 bool usb_netif_is_link_up_aq(void) {
-    return s_link_up;
+    return atomic_load_explicit(&s_link_up, memory_order_acquire);
+}
+
+esp_err_t usb_netif_get_task_stats_aq(usb_netif_task_stats_aq_t *out) {
+    if (out == NULL) return ESP_ERR_INVALID_ARG;
+    if (s_usb_device_task_handle == NULL) return ESP_ERR_INVALID_STATE;
+    out->wakeups = s_usb_task_wakeups;
+    out->uptime_us = esp_timer_get_time() - s_usb_task_start_us;
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    // El contador de run-time de IDF avanza en µs (esp_timer)
+    out->run_time_us = ulTaskGetRunTimeCounter(s_usb_device_task_handle);
+#else
+    out->run_time_us = 0;
+#endif
+    return ESP_OK;
+}
+
+esp_err_t usb_netif_get_log_stats_aq(usb_netif_log_stats_aq_t *out) {
+    if (out == NULL) return ESP_ERR_INVALID_ARG;
+    usb_dlog_stats_aq(out);
+    return ESP_OK;
+}
+
+esp_err_t usb_netif_set_sof_cb_aq(usb_netif_sof_cb_aq_t cb, void *ctx) {
+    if (!tud_inited()) return ESP_ERR_INVALID_STATE;
+    s_sof_next = (sof_hook_t){ .cb = cb, .ctx = ctx };
+    usbd_defer_func(sof_apply, NULL, false);
+    return ESP_OK;
+}
+
+esp_err_t usb_netif_tx_add_ctrl_port_aq(uint16_t port) {
+    return usb_tx_class_add_port_aq(port);
+}
+
+esp_err_t usb_netif_tx_remove_ctrl_port_aq(uint16_t port) {
+    return usb_tx_class_remove_port_aq(port);
+}
+
+esp_err_t usb_netif_get_stats_aq(usb_netif_stats_aq_t *out) {
+    if (out == NULL) return ESP_ERR_INVALID_ARG;
+    usb_stats_snapshot_aq(out);
+    return ESP_OK;
+}
+
+void usb_netif_reset_stats_aq(void) {
+    usb_stats_reset_aq();
+}
+
+esp_err_t usb_netif_get_rx_pool_stats_aq(usb_netif_rx_pool_stats_aq_t *out) {
+    if (out == NULL) return ESP_ERR_INVALID_ARG;
+    usb_rx_pool_get_stats_aq(out);
+    return ESP_OK;
+}
+
+esp_err_t usb_netif_get_mem_report_aq(usb_netif_mem_report_aq_t *out) {
+    if (out == NULL) return ESP_ERR_INVALID_ARG;
+    usb_mem_report_aq(out);
+    usb_rx_pool_get_stats_aq(&out->rx_pool);
+    usb_rx_ring_usage_aq(&out->rx_ring_used, &out->rx_ring_capacity);
+    for (int c = 0; c < USB_NETIF_TX_CLASS_COUNT_AQ; c++) {
+        usb_tx_ring_usage_aq((usb_netif_tx_class_aq_t)c, &out->tx_ring_used[c], &out->tx_ring_capacity[c]);
+    }
+    // El anillo del log diferido es un array estático en los dos modos
+    out->bytes_buffers += usb_dlog_bytes_aq();
+    out->bytes_static += usb_dlog_bytes_aq();
+    out->bytes_sync = out->static_alloc || s_got_ip_sem ? sizeof(StaticSemaphore_t) + sizeof(StaticEventGroup_t) : 0;
+    if (out->static_alloc) {
+        out->bytes_static += out->bytes_sync;
+    } else {
+        out->bytes_heap += out->bytes_sync;
+    }
+    return ESP_OK;
 }
 
 esp_err_t usb_netif_wait_got_ip_aq(TickType_t timeout, esp_ip4_addr_t *out_ip) {
     if (xSemaphoreTake(s_got_ip_sem, timeout) == pdTRUE) {
         if (out_ip) *out_ip = s_ip_addr;
+#if CONFIG_AQ_USB_PERF_AUTOSTART
+        usb_netif_perf_start_aq();  // idempotente
+#endif
         return ESP_OK;
     }
     return ESP_ERR_TIMEOUT;
@@ -0,0 +1,453 @@
+#include "usb_netif_aq.h"
+#include "sdkconfig.h"
+
+#if CONFIG_AQ_USB_PERF
+#include <errno.h>
+#include <stdatomic.h>
+#include <string.h>
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include "usb_perf_proto_aq.h"
+
+static const char *TAG = "usb_perf_aq";
+
+// Servicio de medida sobre la netif USB. Una tarea usb_perf atiende con select() los
+// sumideros TCP y UDP (iperf 2 como cliente en el MASTER) y el eco UDP; cada prueba de
+// fuente (usb_netif_perf_source_aq) corre en su propia tarea usb_perf_src y termina sola.
+// Sockets normales de lwIP: se mide lo mismo que verá la aplicación, no un atajo.
+
+#define PERF_TASK_STACK_AQ  4096
+#define PERF_POLL_MS_AQ     200    // cada cuánto mira s_stop y los sumideros inactivos
+#define PERF_IDLE_US_AQ     3000000  // UDP/eco sin tráfico: se cierra la sesión sin FIN
+#define PERF_FIN_TRIES_AQ   10     // como iperf: reintentos del datagrama final
+#define PERF_FIN_WAIT_MS_AQ 250
+
+typedef struct {
+    int64_t  t_us;
+    uint32_t idle_us[2];
+} cpu_mark_t;
+
+static esp_netif_t *s_netif = NULL;
+static TaskHandle_t s_task = NULL;
+static TaskHandle_t s_src_task = NULL;
+static atomic_bool s_stop = false;
+static atomic_bool s_exited = false;
+static portMUX_TYPE s_last_lock = portMUX_INITIALIZER_UNLOCKED;
+static usb_netif_perf_result_aq_t s_last;
+static bool s_have_last = false;
+
+static usb_netif_perf_source_cfg_aq_t s_src_cfg;
+static uint8_t s_buf[CONFIG_AQ_USB_PERF_BUF_SIZE];      // tarea usb_perf
+static uint8_t s_src_buf[CONFIG_AQ_USB_PERF_BUF_SIZE];  // tarea usb_perf_src
+
+// ========== CPU por núcleo ==========
+// Tiempo de la tarea idle de cada núcleo entre dos marcas. El contador de run-time de
+// IDF avanza en µs (esp_timer), igual que usb_netif_get_task_stats_aq.
+static void cpu_mark(cpu_mark_t *m) {
+    m->t_us = esp_timer_get_time();
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    for (int c = 0; c < portNUM_PROCESSORS && c < 2; c++) {
+        m->idle_us[c] = ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(c));
+    }
+#endif
+}
+
+static void cpu_result(const cpu_mark_t *m, int8_t out[2]) {
+    out[0] = out[1] = -1;
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    cpu_mark_t now;
+    cpu_mark(&now);
+    uint32_t wall = (uint32_t)(now.t_us - m->t_us);
+    if (wall == 0) return;
+    for (int c = 0; c < portNUM_PROCESSORS && c < 2; c++) {
+        uint32_t idle = now.idle_us[c] - m->idle_us[c];
+        out[c] = idle >= wall ? 0 : (int8_t)(100 - (uint64_t)idle * 100 / wall);
+    }
+#endif
+}
+
+static void publish(usb_netif_perf_result_aq_t *r, const cpu_mark_t *m) {
+    cpu_result(m, r->cpu_pct);
+    static const char *const names[] = { "tcp", "udp", "echo" };
+    ESP_LOGI(TAG, "%s %s " IPSTR ": %llu bytes in %lu ms, %.2f Mbit/s, %lu pps, lost %lu, ooo %lu, "
+             "jitter %.3f ms, cpu %d%%/%d%%",
+             names[r->proto], r->source ? "source to" : "sink from", IP2STR(&r->peer),
+             (unsigned long long)r->bytes, (unsigned long)r->duration_ms, r->mbps, (unsigned long)r->pps,
+             (unsigned long)r->lost, (unsigned long)r->out_of_order, r->jitter_ms, r->cpu_pct[0], r->cpu_pct[1]);
+    portENTER_CRITICAL(&s_last_lock);
+    s_last = *r;
+    s_have_last = true;
+    portEXIT_CRITICAL(&s_last_lock);
+    esp_event_post(USB_NET_EVENTS, USB_NET_PERF, r, sizeof(*r), 0);
+}
+
+// Socket ligado a la netif USB: las pruebas no pueden salir por otra interfaz
+static int open_socket(int type, uint16_t port) {
+    int fd = socket(AF_INET, type, type == SOCK_STREAM ? IPPROTO_TCP : IPPROTO_UDP);
+    if (fd < 0) return -1;
+    struct ifreq ifr = {0};
+    if (esp_netif_get_netif_impl_name(s_netif, ifr.ifr_name) == ESP_OK) {
+        setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, &ifr, sizeof(ifr));
+    }
+    if (port) {
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        struct sockaddr_in a = {
+            .sin_family = AF_INET,
+            .sin_port = htons(port),
+            .sin_addr.s_addr = htonl(INADDR_ANY),
+        };
+        if (bind(fd, (struct sockaddr *)&a, sizeof(a)) != 0) {
+            ESP_LOGE(TAG, "bind %u failed (errno %d)", port, errno);
+            close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+static uint64_t peer_key(const struct sockaddr_in *a) {
+    return (uint64_t)a->sin_addr.s_addr << 16 | a->sin_port;
+}
+
+// ========== Sumideros y eco (tarea usb_perf) ==========
+typedef struct {
+    int fd;
+    usb_netif_perf_result_aq_t r;
+    int64_t t0_us;
+    cpu_mark_t cpu;
+} tcp_sink_t;
+
+typedef struct {
+    int fd;
+    perf_udp_rx_aq_t rx;
+    esp_ip4_addr_t peer;
+    cpu_mark_t cpu;
+    // Último informe enviado: iperf repite el FIN hasta recibirlo
+    uint64_t report_peer;
+    uint8_t report[PERF_UDP_REPORT_LEN_AQ];
+} udp_sink_t;
+
+typedef struct {
+    int fd;
+    usb_netif_perf_result_aq_t r;
+    int64_t t0_us;
+    int64_t t_last_us;
+    cpu_mark_t cpu;
+} echo_srv_t;
+
+static void tcp_sink_end(tcp_sink_t *t) {
+    perf_result_rates_aq(&t->r, esp_timer_get_time() - t->t0_us);
+    publish(&t->r, &t->cpu);
+    close(t->fd);
+    t->fd = -1;
+}
+
+static void tcp_sink_accept(int listen_fd, tcp_sink_t *t) {
+    struct sockaddr_in a;
+    socklen_t alen = sizeof(a);
+    int fd = accept(listen_fd, (struct sockaddr *)&a, &alen);
+    if (fd < 0) return;
+    if (t->fd >= 0) {
+        close(fd);  // una prueba TCP a la vez
+        return;
+    }
+    t->fd = fd;
+    memset(&t->r, 0, sizeof(t->r));
+    t->r.proto = USB_NETIF_PERF_TCP_AQ;
+    t->r.peer.addr = a.sin_addr.s_addr;
+    t->t0_us = esp_timer_get_time();
+    cpu_mark(&t->cpu);
+}
+
+static void tcp_sink_read(tcp_sink_t *t) {
+    int n = recv(t->fd, s_buf, sizeof(s_buf), 0);
+    if (n <= 0) {
+        tcp_sink_end(t);
+        return;
+    }
+    t->r.bytes += n;
+    t->r.packets++;
+}
+
+static void udp_sink_end(udp_sink_t *u) {
+    usb_netif_perf_result_aq_t r = {0};
+    perf_udp_rx_result_aq(&u->rx, &r);
+    r.peer = u->peer;
+    publish(&r, &u->cpu);
+    u->rx.active = false;
+}
+
+static void udp_sink_read(udp_sink_t *u) {
+    struct sockaddr_in a;
+    socklen_t alen = sizeof(a);
+    int n = recvfrom(u->fd, s_buf, sizeof(s_buf), 0, (struct sockaddr *)&a, &alen);
+    if (n <= 0) return;
+    int64_t now = esp_timer_get_time();
+    uint64_t key = peer_key(&a);
+    bool was_active = u->rx.active && u->rx.peer == key;
+    perf_udp_kind_aq_t kind = perf_udp_rx_aq(&u->rx, key, s_buf, n, now);
+    if (kind == PERF_UDP_DATA_AQ && !was_active) {
+        u->peer.addr = a.sin_addr.s_addr;
+        cpu_mark(&u->cpu);
+    } else if (kind == PERF_UDP_FIN_AQ) {
+        perf_udp_report_put_aq(&u->rx, s_buf, u->report);
+        u->report_peer = key;
+        udp_sink_end(u);
+        sendto(u->fd, u->report, sizeof(u->report), 0, (struct sockaddr *)&a, alen);
+    } else if (kind == PERF_UDP_BAD_AQ && key == u->report_peer && n >= PERF_UDP_HDR_LEN_AQ) {
+        sendto(u->fd, u->report, sizeof(u->report), 0, (struct sockaddr *)&a, alen);  // FIN repetido
+    }
+}
+
+static void echo_end(echo_srv_t *e) {
+    perf_result_rates_aq(&e->r, e->t_last_us - e->t0_us);
+    publish(&e->r, &e->cpu);
+    e->r.packets = 0;
+}
+
+static void echo_read(echo_srv_t *e) {
+    struct sockaddr_in a;
+    socklen_t alen = sizeof(a);
+    int n = recvfrom(e->fd, s_buf, sizeof(s_buf), 0, (struct sockaddr *)&a, &alen);
+    if (n <= 0) return;
+    int64_t t_rx = esp_timer_get_time();
+    if (!perf_echo_stamp_aq(s_buf, n, t_rx, esp_timer_get_time())) return;
+    sendto(e->fd, s_buf, n, 0, (struct sockaddr *)&a, alen);
+    if (e->r.packets == 0) {
+        memset(&e->r, 0, sizeof(e->r));
+        e->r.proto = USB_NETIF_PERF_ECHO_AQ;
+        e->r.peer.addr = a.sin_addr.s_addr;
+        e->t0_us = t_rx;
+        cpu_mark(&e->cpu);
+    }
+    e->r.bytes += n;
+    e->r.packets++;
+    e->t_last_us = t_rx;
+}
+
+static void usb_perf_task(void *arg) {
+    int listen_fd = open_socket(SOCK_STREAM, CONFIG_AQ_USB_PERF_PORT);
+    tcp_sink_t tcp = { .fd = -1 };
+    udp_sink_t udp = { .fd = open_socket(SOCK_DGRAM, CONFIG_AQ_USB_PERF_PORT) };
+    echo_srv_t echo = { .fd = open_socket(SOCK_DGRAM, CONFIG_AQ_USB_PERF_ECHO_PORT) };
+    if (listen_fd >= 0 && listen(listen_fd, 1) != 0) {
+        close(listen_fd);
+        listen_fd = -1;
+    }
+    ESP_LOGI(TAG, "Listening: tcp/udp %d (iperf 2), echo %d", CONFIG_AQ_USB_PERF_PORT,
+             CONFIG_AQ_USB_PERF_ECHO_PORT);
+
+    while (!atomic_load_explicit(&s_stop, memory_order_acquire)) {
+        fd_set rd;
+        FD_ZERO(&rd);
+        int maxfd = -1;
+        int fds[] = { listen_fd, tcp.fd, udp.fd, echo.fd };
+        for (int i = 0; i < 4; i++) {
+            if (fds[i] < 0) continue;
+            FD_SET(fds[i], &rd);
+            if (fds[i] > maxfd) maxfd = fds[i];
+        }
+        struct timeval tv = { .tv_sec = 0, .tv_usec = PERF_POLL_MS_AQ * 1000 };
+        int n = maxfd >= 0 ? select(maxfd + 1, &rd, NULL, NULL, &tv) : 0;
+        if (maxfd < 0) vTaskDelay(pdMS_TO_TICKS(PERF_POLL_MS_AQ));
+        if (n > 0) {
+            if (listen_fd >= 0 && FD_ISSET(listen_fd, &rd)) tcp_sink_accept(listen_fd, &tcp);
+            if (tcp.fd >= 0 && FD_ISSET(tcp.fd, &rd)) tcp_sink_read(&tcp);
+            if (udp.fd >= 0 && FD_ISSET(udp.fd, &rd)) udp_sink_read(&udp);
+            if (echo.fd >= 0 && FD_ISSET(echo.fd, &rd)) echo_read(&echo);
+        }
+        // Emisor que desapareció sin FIN (o eco terminado): se informa de lo recibido
+        int64_t now = esp_timer_get_time();
+        if (udp.rx.active && now - udp.rx.t_last_us > PERF_IDLE_US_AQ) udp_sink_end(&udp);
+        if (echo.r.packets && now - echo.t_last_us > PERF_IDLE_US_AQ) echo_end(&echo);
+    }
+
+    if (tcp.fd >= 0) tcp_sink_end(&tcp);
+    int fds[] = { listen_fd, udp.fd, echo.fd };
+    for (int i = 0; i < 3; i++) {
+        if (fds[i] >= 0) close(fds[i]);
+    }
+    atomic_store_explicit(&s_exited, true, memory_order_release);
+    vTaskDelete(NULL);
+}
+
+// ========== Fuente (tarea usb_perf_src) ==========
+static void source_tcp(int fd, const usb_netif_perf_source_cfg_aq_t *c, usb_netif_perf_result_aq_t *r) {
+    size_t len = c->len ? c->len : sizeof(s_src_buf);
+    int64_t t0 = esp_timer_get_time();
+    int64_t t_end = t0 + (int64_t)c->duration_ms * 1000;
+    int64_t now = t0;
+    while (now < t_end && !atomic_load_explicit(&s_stop, memory_order_acquire)) {
+        int n = send(fd, s_src_buf, len, 0);
+        if (n < 0) {
+            ESP_LOGW(TAG, "TCP send failed (errno %d)", errno);
+            break;
+        }
+        r->bytes += n;
+        r->packets++;
+        now = esp_timer_get_time();
+    }
+    perf_result_rates_aq(r, esp_timer_get_time() - t0);
+}
+
+static void source_udp(int fd, const usb_netif_perf_source_cfg_aq_t *c, usb_netif_perf_result_aq_t *r) {
+    size_t len = c->len ? c->len : PERF_UDP_DEFAULT_LEN_AQ;
+    uint32_t kbps = c->udp_kbps ? c->udp_kbps : 1000;
+    int64_t t0 = esp_timer_get_time();
+    int64_t t_end = t0 + (int64_t)c->duration_ms * 1000;
+    int64_t now = t0;
+    int32_t id = 0;
+    // Ritmo por créditos: en cada tick sale lo que corresponde al tiempo transcurrido
+    while (now < t_end && !atomic_load_explicit(&s_stop, memory_order_acquire)) {
+        uint64_t due = (uint64_t)(now - t0) * kbps / (8000ull * len) + 1;
+        while ((uint64_t)id < due) {
+            perf_udp_hdr_put_aq(s_src_buf, id, now);
+            if (send(fd, s_src_buf, len, 0) < 0) {
+                if (errno != ENOMEM) ESP_LOGW(TAG, "UDP send failed (errno %d)", errno);
+                break;  // sin pbufs o colas llenas: se reintenta en el siguiente tick
+            }
+            r->bytes += len;
+            r->packets++;
+            id++;
+        }
+        vTaskDelay(1);
+        now = esp_timer_get_time();
+    }
+    perf_result_rates_aq(r, now - t0);
+
+    // Datagrama final e informe del servidor con pérdidas y jitter vistos en el MASTER
+    struct timeval tv = { .tv_sec = 0, .tv_usec = PERF_FIN_WAIT_MS_AQ * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    perf_udp_report_aq_t rep;
+    for (int i = 0; i < PERF_FIN_TRIES_AQ; i++) {
+        perf_udp_hdr_put_aq(s_src_buf, -id, esp_timer_get_time());
+        send(fd, s_src_buf, PERF_UDP_HDR_LEN_AQ, 0);
+        int n = recv(fd, s_src_buf, sizeof(s_src_buf), 0);
+        if (n > 0 && perf_udp_report_get_aq(s_src_buf, n, &rep)) {
+            r->lost = rep.lost;
+            r->out_of_order = rep.out_of_order;
+            r->jitter_ms = rep.jitter_us / 1000.0f;
+            return;
+        }
+    }
+    ESP_LOGW(TAG, "No server report after %d FIN datagrams", PERF_FIN_TRIES_AQ);
+}
+
+static void usb_perf_src_task(void *arg) {
+    const usb_netif_perf_source_cfg_aq_t *c = &s_src_cfg;
+    usb_netif_perf_result_aq_t r = { .proto = c->proto, .source = true, .peer = c->host };
+    bool tcp = c->proto == USB_NETIF_PERF_TCP_AQ;
+    int fd = open_socket(tcp ? SOCK_STREAM : SOCK_DGRAM, 0);
+    struct sockaddr_in a = {
+        .sin_family = AF_INET,
+        .sin_port = htons(c->port),
+        .sin_addr.s_addr = c->host.addr,
+    };
+    if (fd < 0 || connect(fd, (struct sockaddr *)&a, sizeof(a)) != 0) {
+        ESP_LOGE(TAG, "Cannot reach " IPSTR ":%u (errno %d)", IP2STR(&c->host), c->port, errno);
+    } else {
+        // Payload a ceros: iperf 2.1 lee los flags de cabecera tras el id y los quiere a 0
+        memset(s_src_buf, 0, sizeof(s_src_buf));
+        cpu_mark_t cpu;
+        cpu_mark(&cpu);
+        if (tcp) {
+            source_tcp(fd, c, &r);
+        } else {
+            source_udp(fd, c, &r);
+        }
+        publish(&r, &cpu);
+    }
+    if (fd >= 0) close(fd);
+    s_src_task = NULL;
+    vTaskDelete(NULL);
+}
+
+// ========== API ==========
+esp_err_t usb_netif_perf_start_aq(void) {
+    if (s_task != NULL) return ESP_OK;
+    usb_netif_get_esp_netif_aq(&s_netif);
+    if (s_netif == NULL) return ESP_ERR_INVALID_STATE;
+    atomic_store(&s_stop, false);
+    atomic_store(&s_exited, false);
+    if (xTaskCreatePinnedToCore(usb_perf_task, "usb_perf", PERF_TASK_STACK_AQ, NULL, CONFIG_AQ_USB_PERF_TASK_PRIO,
+                                &s_task, CONFIG_AQ_USB_PERF_TASK_CORE < 0 ? tskNO_AFFINITY
+                                                                          : CONFIG_AQ_USB_PERF_TASK_CORE) != pdPASS) {
+        s_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t usb_netif_perf_stop_aq(void) {
+    if (s_task == NULL) return ESP_OK;
+    atomic_store_explicit(&s_stop, true, memory_order_release);
+    // Acotado por el timeout de select y, en la fuente, por un send o un tick de ritmo
+    for (int i = 0; i < 100 && (!atomic_load_explicit(&s_exited, memory_order_acquire) || s_src_task); i++) {
+        vTaskDelay(pdMS_TO_TICKS(20));
+    }
+    if (!atomic_load(&s_exited) || s_src_task) return ESP_ERR_TIMEOUT;
+    s_task = NULL;
+    return ESP_OK;
+}
+
+esp_err_t usb_netif_perf_source_aq(const usb_netif_perf_source_cfg_aq_t *cfg) {
+    if (cfg == NULL || cfg->proto > USB_NETIF_PERF_UDP_AQ) return ESP_ERR_INVALID_ARG;
+    if (cfg->len > sizeof(s_src_buf) || (cfg->proto == USB_NETIF_PERF_UDP_AQ && cfg->len &&
+                                         cfg->len < PERF_UDP_HDR_LEN_AQ)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (s_task == NULL) return ESP_ERR_INVALID_STATE;  // start primero: fija la netif
+    if (s_src_task != NULL) return ESP_ERR_INVALID_STATE;
+
+    s_src_cfg = *cfg;
+    if (s_src_cfg.port == 0) s_src_cfg.port = CONFIG_AQ_USB_PERF_PORT;
+    if (s_src_cfg.duration_ms == 0) s_src_cfg.duration_ms = 10000;
+    if (s_src_cfg.host.addr == 0) {
+        esp_netif_ip_info_t ip;
+        if (esp_netif_get_ip_info(s_netif, &ip) != ESP_OK || ip.gw.addr == 0) return ESP_ERR_INVALID_STATE;
+        s_src_cfg.host = ip.gw;
+    }
+    if (xTaskCreatePinnedToCore(usb_perf_src_task, "usb_perf_src", PERF_TASK_STACK_AQ, NULL,
+                                CONFIG_AQ_USB_PERF_TASK_PRIO, &s_src_task,
+                                CONFIG_AQ_USB_PERF_TASK_CORE < 0 ? tskNO_AFFINITY
+                                                                 : CONFIG_AQ_USB_PERF_TASK_CORE) != pdPASS) {
+        s_src_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t usb_netif_perf_get_last_aq(usb_netif_perf_result_aq_t *out) {
+    if (out == NULL) return ESP_ERR_INVALID_ARG;
+    portENTER_CRITICAL(&s_last_lock);
+    bool have = s_have_last;
+    if (have) *out = s_last;
+    portEXIT_CRITICAL(&s_last_lock);
+    return have ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+#else  // !CONFIG_AQ_USB_PERF
+
+esp_err_t usb_netif_perf_start_aq(void) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t usb_netif_perf_stop_aq(void) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t usb_netif_perf_source_aq(const usb_netif_perf_source_cfg_aq_t *cfg) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t usb_netif_perf_get_last_aq(usb_netif_perf_result_aq_t *out) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
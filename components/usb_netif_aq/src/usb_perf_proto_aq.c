@@ -0,0 +1,144 @@
+#include "usb_perf_proto_aq.h"
+#include <string.h>
+
+static void put_be32(uint8_t *p, uint32_t v) {
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static uint32_t get_be32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+void perf_udp_hdr_put_aq(uint8_t *buf, int32_t id, int64_t t_us) {
+    put_be32(buf, (uint32_t)id);
+    put_be32(buf + 4, (uint32_t)(t_us / 1000000));
+    put_be32(buf + 8, (uint32_t)(t_us % 1000000));
+    put_be32(buf + 12, id < 0 ? 0xffffffffu : 0);  // extensión de signo, como iperf
+}
+
+bool perf_udp_hdr_get_aq(const uint8_t *buf, size_t len, perf_udp_hdr_aq_t *out) {
+    if (len < PERF_UDP_HDR_LEN_AQ) return false;
+    out->id = (int32_t)get_be32(buf);
+    out->sec = get_be32(buf + 4);
+    out->usec = get_be32(buf + 8);
+    return true;
+}
+
+void perf_udp_rx_reset_aq(perf_udp_rx_aq_t *s, uint64_t peer, int64_t now_us) {
+    memset(s, 0, sizeof(*s));
+    s->active = true;
+    s->peer = peer;
+    s->t_first_us = s->t_last_us = now_us;
+}
+
+perf_udp_kind_aq_t perf_udp_rx_aq(perf_udp_rx_aq_t *s, uint64_t peer, const uint8_t *d, size_t len, int64_t now_us) {
+    perf_udp_hdr_aq_t h;
+    if (!perf_udp_hdr_get_aq(d, len, &h)) return PERF_UDP_BAD_AQ;
+    if (h.id < 0) {
+        if (!s->active || peer != s->peer) return PERF_UDP_BAD_AQ;
+        // El FIN lleva el id siguiente al último enviado: revela las pérdidas del final
+        if (-h.id > s->next_id) {
+            s->lost += (uint32_t)(-h.id - s->next_id);
+            s->next_id = -h.id;
+        }
+        return PERF_UDP_FIN_AQ;
+    }
+    if (!s->active || peer != s->peer || h.id == 0) {
+        perf_udp_rx_reset_aq(s, peer, now_us);
+    }
+    s->t_last_us = now_us;
+    s->bytes += len;
+    s->packets++;
+
+    // Pérdidas por huecos de id; uno que llega tarde estaba contado como perdido
+    if (h.id >= s->next_id) {
+        s->lost += (uint32_t)(h.id - s->next_id);
+        s->next_id = h.id + 1;
+    } else {
+        s->out_of_order++;
+        if (s->lost) s->lost--;
+    }
+
+    // RFC 3550 6.4.1: J += (|D| - J) / 16 con D la variación del tiempo de tránsito. Los
+    // relojes no están sincronizados, pero el desfase se cancela en la diferencia.
+    int64_t transit = now_us - ((int64_t)h.sec * 1000000 + h.usec);
+    if (s->have_transit) {
+        int64_t dt = transit - s->last_transit_us;
+        if (dt < 0) dt = -dt;
+        s->jitter_us += ((double)dt - s->jitter_us) / 16.0;
+    }
+    s->last_transit_us = transit;
+    s->have_transit = true;
+    return PERF_UDP_DATA_AQ;
+}
+
+size_t perf_udp_report_put_aq(const perf_udp_rx_aq_t *s, const uint8_t *fin, uint8_t *out) {
+    memcpy(out, fin, PERF_UDP_HDR_LEN_AQ);
+    uint8_t *r = out + PERF_UDP_HDR_LEN_AQ;
+    int64_t dur = s->t_last_us - s->t_first_us;
+    uint32_t jitter = (uint32_t)s->jitter_us;
+    put_be32(r, PERF_UDP_REPORT_FLAG_AQ);
+    put_be32(r + 4, (uint32_t)(s->bytes >> 32));
+    put_be32(r + 8, (uint32_t)s->bytes);
+    put_be32(r + 12, (uint32_t)(dur / 1000000));
+    put_be32(r + 16, (uint32_t)(dur % 1000000));
+    put_be32(r + 20, s->lost);
+    put_be32(r + 24, s->out_of_order);
+    put_be32(r + 28, (uint32_t)s->next_id);  // iperf: último id visto, no recibidos
+    put_be32(r + 32, jitter / 1000000);
+    put_be32(r + 36, jitter % 1000000);
+    return PERF_UDP_REPORT_LEN_AQ;
+}
+
+bool perf_udp_report_get_aq(const uint8_t *d, size_t len, perf_udp_report_aq_t *out) {
+    if (len < PERF_UDP_REPORT_LEN_AQ) return false;
+    const uint8_t *r = d + PERF_UDP_HDR_LEN_AQ;
+    if (!(get_be32(r) & PERF_UDP_REPORT_FLAG_AQ)) return false;
+    out->bytes = (uint64_t)get_be32(r + 4) << 32 | get_be32(r + 8);
+    out->duration_ms = get_be32(r + 12) * 1000 + get_be32(r + 16) / 1000;
+    out->lost = get_be32(r + 20);
+    out->out_of_order = get_be32(r + 24);
+    out->datagrams = get_be32(r + 28);
+    out->jitter_us = get_be32(r + 32) * 1000000 + get_be32(r + 36);
+    return true;
+}
+
+void perf_result_rates_aq(usb_netif_perf_result_aq_t *r, int64_t duration_us) {
+    r->duration_ms = (uint32_t)(duration_us / 1000);
+    if (duration_us <= 0) {
+        r->mbps = 0;
+        r->pps = 0;
+        return;
+    }
+    r->mbps = (float)((double)r->bytes * 8 / (double)duration_us);
+    r->pps = (uint32_t)((uint64_t)r->packets * 1000000 / (uint64_t)duration_us);
+}
+
+void perf_udp_rx_result_aq(const perf_udp_rx_aq_t *s, usb_netif_perf_result_aq_t *out) {
+    out->proto = USB_NETIF_PERF_UDP_AQ;
+    out->source = false;
+    out->bytes = s->bytes;
+    out->packets = s->packets;
+    out->lost = s->lost;
+    out->out_of_order = s->out_of_order;
+    out->jitter_ms = (float)(s->jitter_us / 1000.0);
+    perf_result_rates_aq(out, s->t_last_us - s->t_first_us);
+}
+
+static void put_le64(uint8_t *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+bool perf_echo_stamp_aq(uint8_t *d, size_t len, int64_t t_rx_us, int64_t t_tx_us) {
+    if (len < PERF_ECHO_HDR_LEN_AQ) return false;
+    uint32_t magic = (uint32_t)d[0] | (uint32_t)d[1] << 8 | (uint32_t)d[2] << 16 | (uint32_t)d[3] << 24;
+    if (magic != PERF_ECHO_MAGIC_AQ) return false;
+    put_le64(d + 16, (uint64_t)t_rx_us);
+    put_le64(d + 24, (uint64_t)t_tx_us);
+    return true;
+}
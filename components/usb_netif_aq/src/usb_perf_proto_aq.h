@@ -0,0 +1,77 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "usb_netif_aq.h"
+
+// Formatos de red y contabilidad del servicio de medida (usb_perf_aq.c). C puro, sin
+// sockets ni FreeRTOS: el benchmark de host lo usa también para hacer de MASTER.
+
+// iperf 2 (>= 2.0.10), UDP: cada datagrama empieza por id (negativo en el último), la
+// marca de tiempo del emisor e id2 (parte alta del id de 64 bits, no usada aquí), todo en
+// orden de red. El servidor contesta al último con esa cabecera seguida de su informe.
+#define PERF_UDP_HDR_LEN_AQ     16
+#define PERF_UDP_REPORT_LEN_AQ  (PERF_UDP_HDR_LEN_AQ + 40)
+#define PERF_UDP_REPORT_FLAG_AQ 0x80000000u   // HEADER_VERSION1 de iperf
+#define PERF_UDP_DEFAULT_LEN_AQ 1470
+
+// Eco: u32 magic, u32 seq, u64 marca del cliente (la devuelve intacta), u64 llegada y
+// u64 salida en el panel (µs), little-endian; el resto del datagrama vuelve tal cual
+#define PERF_ECHO_MAGIC_AQ      0x43454151u  // "AQEC"
+#define PERF_ECHO_HDR_LEN_AQ    32
+
+typedef struct {
+    int32_t  id;
+    uint32_t sec;
+    uint32_t usec;
+} perf_udp_hdr_aq_t;
+
+// Informe de servidor de iperf 2
+typedef struct {
+    uint64_t bytes;
+    uint32_t duration_ms;
+    uint32_t lost;
+    uint32_t out_of_order;
+    uint32_t datagrams;
+    uint32_t jitter_us;
+} perf_udp_report_aq_t;
+
+// Sumidero UDP: una sesión por emisor; empieza con el primer datagrama y termina con el
+// de id negativo
+typedef struct {
+    bool     active;
+    uint64_t peer;             // IP << 16 | puerto
+    int64_t  t_first_us;
+    int64_t  t_last_us;
+    int32_t  next_id;
+    uint64_t bytes;
+    uint32_t packets;
+    uint32_t lost;
+    uint32_t out_of_order;
+    bool     have_transit;
+    int64_t  last_transit_us;
+    double   jitter_us;
+} perf_udp_rx_aq_t;
+
+typedef enum {
+    PERF_UDP_BAD_AQ = 0,       // demasiado corto
+    PERF_UDP_DATA_AQ,
+    PERF_UDP_FIN_AQ,           // último datagrama: contestar con el informe
+} perf_udp_kind_aq_t;
+
+void perf_udp_hdr_put_aq(uint8_t *buf, int32_t id, int64_t t_us);
+bool perf_udp_hdr_get_aq(const uint8_t *buf, size_t len, perf_udp_hdr_aq_t *out);
+
+void perf_udp_rx_reset_aq(perf_udp_rx_aq_t *s, uint64_t peer, int64_t now_us);
+// Contabiliza un datagrama (abre sesión si no hay o cambia el emisor). now_us: reloj local.
+perf_udp_kind_aq_t perf_udp_rx_aq(perf_udp_rx_aq_t *s, uint64_t peer, const uint8_t *d, size_t len, int64_t now_us);
+// Informe para el datagrama final fin (sus PERF_UDP_HDR_LEN_AQ primeros bytes). Devuelve la longitud.
+size_t perf_udp_report_put_aq(const perf_udp_rx_aq_t *s, const uint8_t *fin, uint8_t *out);
+bool   perf_udp_report_get_aq(const uint8_t *d, size_t len, perf_udp_report_aq_t *out);
+void   perf_udp_rx_result_aq(const perf_udp_rx_aq_t *s, usb_netif_perf_result_aq_t *out);
+
+// Eco en el sitio: comprueba la cabecera y escribe las marcas del panel
+bool perf_echo_stamp_aq(uint8_t *d, size_t len, int64_t t_rx_us, int64_t t_tx_us);
+
+// Mbit/s y paquetes/s a partir de bytes, paquetes y duración
+void perf_result_rates_aq(usb_netif_perf_result_aq_t *r, int64_t duration_us);
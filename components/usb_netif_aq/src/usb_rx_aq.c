@@ -0,0 +1,253 @@
+#include "usb_rx_aq.h"
+#include <stdatomic.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "usb_dlog_aq.h"
+#include "usb_mem_aq.h"
+#include "usb_rx_filter_aq.h"
+#include "usb_rx_pool_aq.h"
+#include "usb_spsc_aq.h"
+#include "usb_stats_aq.h"
+#include "usb_task_aq.h"
+
+typedef struct {
+    uint8_t *buffer;
+    uint16_t len;
+    uint32_t t_rx;  // usb_stats_stamp_aq() en el callback, para el histograma RX
+} rx_packet_t;
+
+// Productor: el callback de TinyUSB (tarea usb_device). Consumidor: usb_rx_task.
+static usb_spsc_aq_t s_rx_ring;
+static bool s_rx_ready = false;
+static TaskHandle_t s_rx_task_handle = NULL;
+static esp_netif_t *s_netif = NULL;
+static atomic_bool s_rx_sleeping = false;  // usb_rx_task va a bloquearse esperando tramas
+
+// Despierta a usb_rx_task solo si anunció que iba a dormir; con la tarea ocupada
+// vaciando el anillo no hay notificación (ni su sección crítica) por paquete.
+static inline void rx_wake(void) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&s_rx_sleeping, memory_order_relaxed) &&
+        atomic_exchange_explicit(&s_rx_sleeping, false, memory_order_relaxed) && s_rx_task_handle) {
+        xTaskNotifyGive(s_rx_task_handle);
+    }
+}
+
+#if CONFIG_AQ_USB_RX_FLOW_CONTROL
+_Static_assert(CONFIG_AQ_USB_RX_RESUME_LEVEL < CONFIG_AQ_USB_RX_RING_LEN,
+               "AQ_USB_RX_RESUME_LEVEL must be below AQ_USB_RX_RING_LEN");
+
+// Control de flujo: en vez de tirar la trama que no cabe, no se pide la siguiente a
+// TinyUSB. Sin tud_network_recv_renew el NTB en curso no se libera, la clase NCM deja de
+// armar el endpoint OUT al quedarse sin NTB libres y el host recibe NAK hasta que
+// usb_rx_task (o lwIP al devolver buffers) deja sitio y reanuda.
+static atomic_bool s_rx_paused = false;
+static uint32_t s_rx_pause_t0;  // publicado por el store de s_rx_paused
+static usb_rx_resume_fn_aq_t s_rx_resume = NULL;
+
+// Cabe una trama más: hueco en el anillo y buffer libre en el pool
+static inline bool rx_has_room(void) {
+    return usb_spsc_count_aq(&s_rx_ring) < CONFIG_AQ_USB_RX_RING_LEN && usb_rx_pool_has_free_aq();
+}
+
+// Histéresis: no reanudar hasta bajar del nivel, para no alternar pausa y trama suelta
+static inline bool rx_can_resume(void) {
+    return usb_spsc_count_aq(&s_rx_ring) <= CONFIG_AQ_USB_RX_RESUME_LEVEL && usb_rx_pool_has_free_aq();
+}
+
+// Solo quien gana el exchange reanuda, y cuenta la pausa al salir
+static bool rx_flow_claim(void) {
+    if (!atomic_exchange_explicit(&s_rx_paused, false, memory_order_seq_cst)) return false;
+    usb_stats_add_aq(&g_usb_stats_aq.rx_resumes, 1);
+    usb_stats_add_aq(&g_usb_stats_aq.rx_paused_us, usb_stats_stamp_aq() - s_rx_pause_t0);
+    USB_DLOG_AQ(RX_RESUME, usb_spsc_count_aq(&s_rx_ring));
+    return true;
+}
+
+// Lado consumidor, tras liberar sitio. La barrera empareja con la de usb_rx_input_flow_aq:
+// o el callback ve el sitio recién liberado o aquí se ve su pausa.
+static inline void rx_flow_check(void) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&s_rx_paused, memory_order_relaxed) && rx_can_resume() && rx_flow_claim() &&
+        s_rx_resume) {
+        s_rx_resume();
+    }
+}
+
+bool usb_rx_input_flow_aq(const uint8_t *buffer, uint16_t len) {
+    // Pausa que TinyUSB ya no respeta: un reset del bus reinicia la recepción NCM
+    if (atomic_load_explicit(&s_rx_paused, memory_order_relaxed)) {
+        rx_flow_claim();
+    }
+    if (len) {
+        usb_rx_input_aq((void *)buffer, len, NULL);
+    }
+    if (!s_rx_ready || rx_has_room()) return true;
+
+    s_rx_pause_t0 = usb_stats_stamp_aq();
+    usb_stats_add_aq(&g_usb_stats_aq.rx_pauses, 1);
+    USB_DLOG_AQ(RX_PAUSE, usb_spsc_count_aq(&s_rx_ring));
+    atomic_store_explicit(&s_rx_paused, true, memory_order_seq_cst);
+    // El consumidor pudo liberar sitio antes de ver el flag: volver a mirar
+    atomic_thread_fence(memory_order_seq_cst);
+    return rx_can_resume() && rx_flow_claim();
+}
+
+void usb_rx_set_resume_aq(usb_rx_resume_fn_aq_t resume) {
+    s_rx_resume = resume;
+}
+#endif
+
+// RX: from USB -> ring
+// El buffer de TinyUSB solo es válido durante el callback, así que se copia una vez
+// a un buffer del pool. Ese mismo buffer llega a lwIP sin más copias (pbuf_custom)
+// y vuelve al pool a través de driver_free_rx_buffer. Antes, el filtro RX descarta la
+// charla del host que lwIP tiraría igualmente, sin gastar buffer ni hueco del anillo.
+esp_err_t usb_rx_input_aq(void *buffer, uint16_t len, void *ctx) {
+    USB_DLOG_AQ(RX_FRAME, len);
+    if (s_rx_ready) {
+        if (len > usb_rx_pool_buf_size_aq()) {
+            USB_DLOG_AQ(RX_OVERSIZE, len);
+            usb_stats_drop_aq(USB_NETIF_DROP_RX_OVERSIZE_AQ);
+            return ESP_FAIL;
+        }
+#if CONFIG_AQ_USB_RX_FILTER
+        if (!usb_rx_filter_pass_aq(buffer, len)) {
+            USB_DLOG_AQ(RX_FILTERED, len);
+            return ESP_OK;
+        }
+#endif
+        rx_packet_t pkt = { .buffer = usb_rx_pool_alloc_aq(), .len = len, .t_rx = usb_stats_stamp_aq() };
+        if (pkt.buffer) {
+            memcpy(pkt.buffer, buffer, len);
+            if (!usb_spsc_push_aq(&s_rx_ring, &pkt)) {
+                USB_DLOG_AQ(RX_RING_FULL);
+                usb_rx_pool_free_aq(pkt.buffer);
+                usb_stats_drop_aq(USB_NETIF_DROP_RX_QUEUE_FULL_AQ);
+                return ESP_FAIL;
+            }
+            uint32_t depth = usb_spsc_count_aq(&s_rx_ring);
+            usb_stats_rx_depth_aq(depth);
+            rx_wake();
+            USB_DLOG_AQ(RX_QUEUED, depth);
+            return ESP_OK;
+        } else {
+            USB_DLOG_AQ(RX_POOL_EMPTY);
+            usb_stats_drop_aq(USB_NETIF_DROP_RX_ALLOC_FAIL_AQ);
+            return ESP_FAIL;
+        }
+    }
+    USB_DLOG_AQ(RX_NOT_READY);
+    usb_stats_drop_aq(USB_NETIF_DROP_RX_NO_NETIF_AQ);
+    return ESP_OK;
+}
+
+void usb_rx_free_aq(void *h, void *buffer) {
+    (void)h;
+    if (usb_rx_pool_owns_aq(buffer)) {
+        usb_rx_pool_free_aq(buffer);
+#if CONFIG_AQ_USB_RX_FLOW_CONTROL
+        rx_flow_check();  // pausa por pool agotado con buffers retenidos por lwIP
+#endif
+    } else if (buffer) {
+        USB_DLOG_AQ(RX_FOREIGN_BUF, buffer);
+    }
+}
+
+static void rx_deliver(rx_packet_t *pkt) {
+    USB_DLOG_AQ(RX_DELIVER, pkt->len);
+    if (s_netif) {
+        // eb = buffer: esp_netif lo envuelve en un pbuf sin copiar y nos lo
+        // devuelve en usb_rx_free_aq cuando lwIP termina con él.
+        usb_stats_latency_aq(g_usb_stats_aq.rx_latency, pkt->t_rx);
+        esp_err_t ret = esp_netif_receive(s_netif, pkt->buffer, pkt->len, pkt->buffer);
+        USB_DLOG_AQ(RX_NETIF_RESULT, ret);
+        if (ret == ESP_OK) {
+            usb_stats_add_aq(&g_usb_stats_aq.rx_packets, 1);
+            usb_stats_add_aq(&g_usb_stats_aq.rx_bytes, pkt->len);
+        } else {
+            // esp_netif ya devolvió el buffer vía driver_free_rx_buffer
+            usb_stats_drop_aq(USB_NETIF_DROP_RX_ALLOC_FAIL_AQ);
+        }
+    } else {
+        USB_DLOG_AQ(RX_NO_NETIF);
+        usb_rx_pool_free_aq(pkt->buffer);
+        usb_stats_drop_aq(USB_NETIF_DROP_RX_NO_NETIF_AQ);
+    }
+}
+
+static void usb_rx_task(void *arg) {
+    rx_packet_t pkt;
+    while (1) {
+        while (usb_spsc_pop_aq(&s_rx_ring, &pkt)) {
+            rx_deliver(&pkt);
+#if CONFIG_AQ_USB_RX_FLOW_CONTROL
+            rx_flow_check();
+#endif
+        }
+        // Anunciar que vamos a dormir y volver a mirar: una trama encolada después de
+        // la barrera ve el flag y nos notifica; una anterior la vemos aquí.
+        atomic_store_explicit(&s_rx_sleeping, true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (usb_spsc_count_aq(&s_rx_ring)) {
+            atomic_store_explicit(&s_rx_sleeping, false, memory_order_relaxed);
+            continue;
+        }
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+esp_err_t usb_rx_init_aq(void) {
+#if CONFIG_AQ_USB_RX_FILTER
+    usb_rx_filter_init_aq();
+#endif
+    esp_err_t err = usb_spsc_init_aq(&s_rx_ring, sizeof(rx_packet_t), CONFIG_AQ_USB_RX_RING_LEN);
+    if (err != ESP_OK) return err;
+
+    // Pool RX preasignado: evita malloc/free por paquete y la fragmentación del heap
+    err = usb_rx_pool_init_aq(CONFIG_AQ_USB_RX_POOL_SIZE, USB_RX_BUF_SIZE_AQ);
+    if (err != ESP_OK) {
+        usb_spsc_deinit_aq(&s_rx_ring);
+        return err;
+    }
+    s_rx_ready = true;
+    return ESP_OK;
+}
+
+esp_err_t usb_rx_start_aq(esp_netif_t *netif) {
+    s_netif = netif;
+    return usb_mem_task_create_aq(USB_NETIF_TASK_RX_AQ, usb_rx_task, NULL, CONFIG_AQ_USB_RX_TASK_PRIO,
+                                  USB_TASK_CORE_AQ(CONFIG_AQ_USB_RX_TASK_CORE), &s_rx_task_handle);
+}
+
+void usb_rx_stop_aq(void) {
+    usb_mem_task_delete_aq(USB_NETIF_TASK_RX_AQ);
+    s_rx_task_handle = NULL;
+}
+
+void usb_rx_ring_usage_aq(uint32_t *used, uint32_t *capacity) {
+    *used = s_rx_ready ? usb_spsc_count_aq(&s_rx_ring) : 0;
+    *capacity = CONFIG_AQ_USB_RX_RING_LEN;
+}
+
+void usb_rx_discard_aq(void) {
+    rx_packet_t pkt;
+    while (usb_spsc_pop_aq(&s_rx_ring, &pkt)) {
+        usb_rx_pool_free_aq(pkt.buffer);
+    }
+}
+
+void usb_rx_deinit_aq(void) {
+    if (s_rx_ready) {
+        // Llamar con TinyUSB ya desinstalado: sin productor, este hilo es el consumidor
+        s_rx_ready = false;
+        usb_rx_discard_aq();
+#if CONFIG_AQ_USB_RX_FLOW_CONTROL
+        atomic_store(&s_rx_paused, false);
+#endif
+        usb_spsc_deinit_aq(&s_rx_ring);
+    }
+    s_netif = NULL;
+    usb_rx_pool_deinit_aq();
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_netif.h"
+
+// Etapa RX: el callback de TinyUSB copia la trama a un buffer del pool y la pasa por
+// un anillo SPSC lock-free; una tarea dedicada la entrega a esp_netif sin más copias
+// (pbuf_custom).
+
+esp_err_t usb_rx_init_aq(void);
+esp_err_t usb_rx_start_aq(esp_netif_t *netif);
+void      usb_rx_stop_aq(void);
+void      usb_rx_deinit_aq(void);
+
+// Vacía el anillo devolviendo los buffers al pool. Solo sin usb_rx_task (es el consumidor)
+void      usb_rx_discard_aq(void);
+// Ocupación actual del anillo RX (informe de memoria)
+void      usb_rx_ring_usage_aq(uint32_t *used, uint32_t *capacity);
+
+// on_recv_callback de tinyusb_net (contexto de la tarea USB)
+esp_err_t usb_rx_input_aq(void *buffer, uint16_t len, void *ctx);
+// driver_free_rx_buffer de esp_netif (hilo tcpip)
+void      usb_rx_free_aq(void *h, void *buffer);
+
+// Control de flujo (CONFIG_AQ_USB_RX_FLOW_CONTROL). Sustituye a usb_rx_input_aq en el
+// tud_network_recv_cb: true si TinyUSB puede entregar ya la siguiente trama
+// (tud_network_recv_renew); false si la recepción queda en pausa hasta que usb_rx_task
+// o el hilo tcpip liberen sitio y llamen a la función de reanudar.
+typedef void (*usb_rx_resume_fn_aq_t)(void);
+bool      usb_rx_input_flow_aq(const uint8_t *buffer, uint16_t len);
+void      usb_rx_set_resume_aq(usb_rx_resume_fn_aq_t resume);
@@ -0,0 +1,368 @@
+#include "usb_rx_filter_aq.h"
+#include <stdatomic.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+
+#if CONFIG_AQ_USB_RX_FILTER
+
+#define ETH_HDR_LEN 14
+#define ETHTYPE_VLAN 0x8100
+#define ETHTYPE_IPV4 0x0800
+#define ETHTYPE_ARP  0x0806
+#define ETHTYPE_IPV6 0x86DD
+
+#define MAX_RULES CONFIG_AQ_USB_RX_FILTER_MAX_RULES
+#define VERDICT_PASS USB_NETIF_RX_FILTER_REASON_COUNT_AQ
+// Lecturas de la tabla antes de rendirse y dejar pasar la trama sin filtrar
+#define SEQ_TRIES 4
+
+typedef struct {
+    bool used;
+    usb_netif_rx_rule_aq_t rule;  // normalizada: campos que no usa su tipo a cero
+} rule_slot_t;
+
+// Tabla de reglas. El lector (callback de TinyUSB) no toma locks: s_seq es impar mientras
+// un escritor la modifica, y el lector descarta lo evaluado si s_seq cambió entretanto.
+// Los escritores se serializan con s_lock; en la sección crítica no los puede expulsar
+// la tarea usb_device de su mismo núcleo, así que la ventana impar dura lo que la copia.
+static rule_slot_t s_slots[MAX_RULES];
+static uint32_t s_nslots;  // huecos a recorrer: el último en uso + 1
+static _Atomic uint32_t s_seq;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static atomic_bool s_enabled = true;
+
+static atomic_uint s_hits[MAX_RULES];
+static atomic_uint s_passed;
+static atomic_uint s_dropped[USB_NETIF_RX_FILTER_REASON_COUNT_AQ];
+static atomic_uint s_unfiltered;
+
+static inline uint16_t rd16(const uint8_t *p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline void count(atomic_uint *c) {
+    atomic_fetch_add_explicit(c, 1, memory_order_relaxed);
+}
+
+static bool prefix_match(const uint8_t *prefix, const uint8_t *addr, uint8_t bits) {
+    uint8_t n = bits >> 3;
+    if (memcmp(prefix, addr, n) != 0) return false;
+    uint8_t rem = bits & 7;
+    return rem == 0 || ((prefix[n] ^ addr[n]) & (uint8_t)(0xFF << (8 - rem))) == 0;
+}
+
+// Una pasada por la tabla. Devuelve VERDICT_PASS o el motivo del descarte; *slot es la
+// regla que decidió (-1 si ninguna)
+static int evaluate(const uint8_t *frame, size_t len, int *slot) {
+    *slot = -1;
+    if (len < ETH_HDR_LEN) return USB_NETIF_RX_FILTER_RUNT_AQ;
+
+    size_t off = 12;
+    uint16_t ethertype = rd16(frame + off);
+    if (ethertype == ETHTYPE_VLAN && len >= ETH_HDR_LEN + 4) {
+        off += 4;
+        ethertype = rd16(frame + off);
+    }
+    off += 2;
+
+    // Bit I/G de la MAC de destino: multicast o broadcast
+    bool group = frame[0] & 0x01;
+    const uint8_t *dst_ip = NULL;
+    bool ipv6 = false;
+    if (group) {
+        if (ethertype == ETHTYPE_IPV4 && len >= off + 20) {
+            dst_ip = frame + off + 16;
+        } else if (ethertype == ETHTYPE_IPV6 && len >= off + 40) {
+            dst_ip = frame + off + 24;
+            ipv6 = true;
+        }
+    }
+
+    int ether_slot = -1, mac_slot = -1, group_slot = -1;
+    for (uint32_t i = 0; i < s_nslots; i++) {
+        const rule_slot_t *s = &s_slots[i];
+        if (!s->used) continue;
+        const usb_netif_rx_rule_aq_t *r = &s->rule;
+        switch (r->type) {
+        case USB_NETIF_RX_RULE_ETHERTYPE_AQ:
+            if (r->ethertype == ethertype) ether_slot = (int)i;
+            break;
+        case USB_NETIF_RX_RULE_MAC_AQ:
+            if (group && (r->ethertype == 0 || r->ethertype == ethertype) && memcmp(r->mac, frame, 6) == 0) {
+                mac_slot = (int)i;
+            }
+            break;
+        case USB_NETIF_RX_RULE_GROUP_AQ:
+            if (dst_ip && r->ipv6 == ipv6 && prefix_match(r->addr, dst_ip, r->prefix_len)) group_slot = (int)i;
+            break;
+        }
+    }
+
+    if (ether_slot < 0) return USB_NETIF_RX_FILTER_ETHERTYPE_AQ;
+    if (!group) {
+        *slot = ether_slot;
+        return VERDICT_PASS;
+    }
+    *slot = group_slot >= 0 ? group_slot : mac_slot;
+    return *slot >= 0 ? VERDICT_PASS : USB_NETIF_RX_FILTER_GROUP_AQ;
+}
+
+bool usb_rx_filter_pass_aq(const uint8_t *frame, size_t len) {
+    if (!atomic_load_explicit(&s_enabled, memory_order_relaxed)) return true;
+    for (int tries = 0; tries < SEQ_TRIES; tries++) {
+        uint32_t seq = atomic_load_explicit(&s_seq, memory_order_acquire);
+        if (seq & 1) continue;
+        int slot;
+        int verdict = evaluate(frame, len, &slot);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&s_seq, memory_order_relaxed) != seq) continue;
+        // Contadores solo con la tabla validada: una evaluación repetida no cuenta dos veces
+        if (verdict != VERDICT_PASS) {
+            count(&s_dropped[verdict]);
+            return false;
+        }
+        if (slot >= 0) count(&s_hits[slot]);
+        count(&s_passed);
+        return true;
+    }
+    // El filtro solo ahorra trabajo: ante la duda la trama sigue y la decide lwIP
+    count(&s_unfiltered);
+    return true;
+}
+
+// ---------- escritores ----------
+
+static esp_err_t normalize(const usb_netif_rx_rule_aq_t *in, usb_netif_rx_rule_aq_t *out) {
+    memset(out, 0, sizeof(*out));
+    out->type = in->type;
+    switch (in->type) {
+    case USB_NETIF_RX_RULE_ETHERTYPE_AQ:
+        if (in->ethertype == 0) return ESP_ERR_INVALID_ARG;
+        out->ethertype = in->ethertype;
+        return ESP_OK;
+    case USB_NETIF_RX_RULE_MAC_AQ:
+        // El unicast no pasa por las reglas MAC
+        if (!(in->mac[0] & 0x01)) return ESP_ERR_INVALID_ARG;
+        memcpy(out->mac, in->mac, 6);
+        out->ethertype = in->ethertype;
+        return ESP_OK;
+    case USB_NETIF_RX_RULE_GROUP_AQ: {
+        uint8_t max_bits = in->ipv6 ? 128 : 32;
+        if (in->prefix_len > max_bits) return ESP_ERR_INVALID_ARG;
+        out->ipv6 = in->ipv6;
+        out->prefix_len = in->prefix_len;
+        // Bits fuera del prefijo a cero, para que remove encuentre la misma regla
+        uint8_t n = in->prefix_len >> 3, rem = in->prefix_len & 7;
+        memcpy(out->addr, in->addr, n);
+        if (rem) out->addr[n] = in->addr[n] & (uint8_t)(0xFF << (8 - rem));
+        return ESP_OK;
+    }
+    default:
+        return ESP_ERR_INVALID_ARG;
+    }
+}
+
+static int find_locked(const usb_netif_rx_rule_aq_t *rule) {
+    for (uint32_t i = 0; i < s_nslots; i++) {
+        if (s_slots[i].used && memcmp(&s_slots[i].rule, rule, sizeof(*rule)) == 0) return (int)i;
+    }
+    return -1;
+}
+
+static void write_begin(void) {
+    taskENTER_CRITICAL(&s_lock);
+    atomic_fetch_add_explicit(&s_seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static void write_end(void) {
+    atomic_fetch_add_explicit(&s_seq, 1, memory_order_release);
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+// Con la tabla en escritura; rule ya normalizada
+static esp_err_t add_locked(const usb_netif_rx_rule_aq_t *rule) {
+    if (find_locked(rule) >= 0) return ESP_OK;
+    for (uint32_t i = 0; i < MAX_RULES; i++) {
+        if (s_slots[i].used) continue;
+        memcpy(&s_slots[i].rule, rule, sizeof(*rule));  // con el relleno a cero, para find_locked
+        s_slots[i].used = true;
+        atomic_store_explicit(&s_hits[i], 0, memory_order_relaxed);
+        if (i >= s_nslots) s_nslots = i + 1;
+        return ESP_OK;
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+static void add_default(usb_netif_rx_rule_aq_t rule) {
+    usb_netif_rx_rule_aq_t norm;
+    if (normalize(&rule, &norm) == ESP_OK) add_locked(&norm);
+}
+
+// IPv4 y ARP (la petición ARP llega a broadcast), más las ofertas DHCP a 255.255.255.255.
+// Fuera quedan mDNS, LLMNR, SSDP, NetBIOS y, sin IPv6, todo IPv6 (RA, ND, MLD).
+static void load_defaults_locked(void) {
+    memset(s_slots, 0, sizeof(s_slots));
+    s_nslots = 0;
+    add_default((usb_netif_rx_rule_aq_t){ .type = USB_NETIF_RX_RULE_ETHERTYPE_AQ, .ethertype = ETHTYPE_IPV4 });
+    add_default((usb_netif_rx_rule_aq_t){ .type = USB_NETIF_RX_RULE_ETHERTYPE_AQ, .ethertype = ETHTYPE_ARP });
+    add_default((usb_netif_rx_rule_aq_t){ .type = USB_NETIF_RX_RULE_MAC_AQ,
+                                          .mac = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF },
+                                          .ethertype = ETHTYPE_ARP });
+    add_default((usb_netif_rx_rule_aq_t){ .type = USB_NETIF_RX_RULE_GROUP_AQ, .prefix_len = 32,
+                                          .addr = { 255, 255, 255, 255 } });
+#if CONFIG_AQ_USB_RX_FILTER_IPV6
+    // Todos los nodos (RA) y solicited-node (ND de nuestras direcciones)
+    add_default((usb_netif_rx_rule_aq_t){ .type = USB_NETIF_RX_RULE_ETHERTYPE_AQ, .ethertype = ETHTYPE_IPV6 });
+    add_default((usb_netif_rx_rule_aq_t){ .type = USB_NETIF_RX_RULE_GROUP_AQ, .ipv6 = true, .prefix_len = 128,
+                                          .addr = { 0xFF, 0x02, [15] = 0x01 } });
+    add_default((usb_netif_rx_rule_aq_t){ .type = USB_NETIF_RX_RULE_GROUP_AQ, .ipv6 = true, .prefix_len = 104,
+                                          .addr = { 0xFF, 0x02, [11] = 0x01, [12] = 0xFF } });
+#endif
+}
+
+static void reset_counters(void) {
+    for (int i = 0; i < MAX_RULES; i++) {
+        atomic_store_explicit(&s_hits[i], 0, memory_order_relaxed);
+    }
+    for (int i = 0; i < USB_NETIF_RX_FILTER_REASON_COUNT_AQ; i++) {
+        atomic_store_explicit(&s_dropped[i], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&s_passed, 0, memory_order_relaxed);
+    atomic_store_explicit(&s_unfiltered, 0, memory_order_relaxed);
+}
+
+void usb_rx_filter_init_aq(void) {
+    usb_netif_rx_filter_reset_aq();
+}
+
+esp_err_t usb_netif_rx_filter_reset_aq(void) {
+    write_begin();
+    load_defaults_locked();
+    write_end();
+    reset_counters();
+    return ESP_OK;
+}
+
+esp_err_t usb_netif_rx_filter_add_aq(const usb_netif_rx_rule_aq_t *rule) {
+    if (rule == NULL) return ESP_ERR_INVALID_ARG;
+    usb_netif_rx_rule_aq_t norm;
+    esp_err_t err = normalize(rule, &norm);
+    if (err != ESP_OK) return err;
+    write_begin();
+    err = add_locked(&norm);
+    write_end();
+    return err;
+}
+
+esp_err_t usb_netif_rx_filter_remove_aq(const usb_netif_rx_rule_aq_t *rule) {
+    if (rule == NULL) return ESP_ERR_INVALID_ARG;
+    usb_netif_rx_rule_aq_t norm;
+    esp_err_t err = normalize(rule, &norm);
+    if (err != ESP_OK) return err;
+    write_begin();
+    int i = find_locked(&norm);
+    if (i >= 0) {
+        s_slots[i].used = false;
+        while (s_nslots > 0 && !s_slots[s_nslots - 1].used) s_nslots--;
+    }
+    write_end();
+    return i >= 0 ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t usb_netif_rx_filter_enable_aq(bool enable) {
+    atomic_store_explicit(&s_enabled, enable, memory_order_relaxed);
+    return ESP_OK;
+}
+
+esp_err_t usb_netif_rx_filter_get_rules_aq(usb_netif_rx_rule_info_aq_t *out, size_t max, size_t *count) {
+    if ((out == NULL && max) || count == NULL) return ESP_ERR_INVALID_ARG;
+    size_t n;
+    uint32_t seq;
+    do {
+        // Un escritor sostiene la ventana impar solo dentro de su sección crítica
+        while ((seq = atomic_load_explicit(&s_seq, memory_order_acquire)) & 1) {
+        }
+        n = 0;
+        for (uint32_t i = 0; i < s_nslots && n < max; i++) {
+            if (!s_slots[i].used) continue;
+            out[n].rule = s_slots[i].rule;
+            out[n].hits = atomic_load_explicit(&s_hits[i], memory_order_relaxed);
+            n++;
+        }
+        atomic_thread_fence(memory_order_acquire);
+    } while (atomic_load_explicit(&s_seq, memory_order_relaxed) != seq);
+    *count = n;
+    return ESP_OK;
+}
+
+esp_err_t usb_netif_rx_filter_get_stats_aq(usb_netif_rx_filter_stats_aq_t *out) {
+    if (out == NULL) return ESP_ERR_INVALID_ARG;
+    memset(out, 0, sizeof(*out));
+    out->enabled = atomic_load_explicit(&s_enabled, memory_order_relaxed);
+    out->passed = atomic_load_explicit(&s_passed, memory_order_relaxed);
+    for (int i = 0; i < USB_NETIF_RX_FILTER_REASON_COUNT_AQ; i++) {
+        out->dropped[i] = atomic_load_explicit(&s_dropped[i], memory_order_relaxed);
+    }
+    out->unfiltered = atomic_load_explicit(&s_unfiltered, memory_order_relaxed);
+    taskENTER_CRITICAL(&s_lock);
+    for (uint32_t i = 0; i < s_nslots; i++) {
+        out->rules += s_slots[i].used;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    out->capacity = MAX_RULES;
+    return ESP_OK;
+}
+
+static usb_netif_rx_rule_aq_t ip4_group(esp_ip4_addr_t group) {
+    usb_netif_rx_rule_aq_t rule = { .type = USB_NETIF_RX_RULE_GROUP_AQ, .prefix_len = 32 };
+    memcpy(rule.addr, &group.addr, 4);  // ya en orden de red
+    return rule;
+}
+
+esp_err_t usb_netif_rx_filter_join_ip4_aq(esp_ip4_addr_t group) {
+    usb_netif_rx_rule_aq_t rule = ip4_group(group);
+    return usb_netif_rx_filter_add_aq(&rule);
+}
+
+esp_err_t usb_netif_rx_filter_leave_ip4_aq(esp_ip4_addr_t group) {
+    usb_netif_rx_rule_aq_t rule = ip4_group(group);
+    return usb_netif_rx_filter_remove_aq(&rule);
+}
+
+#else  // !CONFIG_AQ_USB_RX_FILTER
+
+esp_err_t usb_netif_rx_filter_add_aq(const usb_netif_rx_rule_aq_t *rule) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t usb_netif_rx_filter_remove_aq(const usb_netif_rx_rule_aq_t *rule) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t usb_netif_rx_filter_reset_aq(void) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t usb_netif_rx_filter_enable_aq(bool enable) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t usb_netif_rx_filter_get_rules_aq(usb_netif_rx_rule_info_aq_t *out, size_t max, size_t *count) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t usb_netif_rx_filter_get_stats_aq(usb_netif_rx_filter_stats_aq_t *out) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t usb_netif_rx_filter_join_ip4_aq(esp_ip4_addr_t group) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t usb_netif_rx_filter_leave_ip4_aq(esp_ip4_addr_t group) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
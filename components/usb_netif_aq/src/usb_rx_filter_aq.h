@@ -0,0 +1,17 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "usb_netif_aq.h"
+
+// Filtro L2 de la entrada RX (CONFIG_AQ_USB_RX_FILTER). Solo lee la cabecera Ethernet/IP,
+// en el mismo buffer de TinyUSB. usb_rx_filter_pass_aq corre en el callback por cada
+// trama; las reglas se cambian desde cualquier tarea con usb_netif_rx_filter_*_aq. La tabla
+// va protegida por un seqlock: el lector no espera nunca, y si coincide con una escritura
+// deja pasar la trama (la decide lwIP como antes).
+
+// Carga las reglas por defecto (IPv4, ARP y DHCP; IPv6 y ND con CONFIG_AQ_USB_RX_FILTER_IPV6)
+void usb_rx_filter_init_aq(void);
+// true: la trama sigue al pool y al anillo RX
+bool usb_rx_filter_pass_aq(const uint8_t *frame, size_t len);
+
@@ -0,0 +1,109 @@
+#include "usb_rx_pool_aq.h"
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "usb_mem_aq.h"
+
+static const char *TAG = "usb_rx_pool_aq";
+
+// Los buffers libres se encadenan usando su primera palabra como puntero "next",
+// así no hace falta memoria extra para la lista.
+typedef struct free_node {
+    struct free_node *next;
+} free_node_t;
+
+static portMUX_TYPE s_pool_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t *s_pool_mem = NULL;
+static free_node_t *s_free_list = NULL;
+static size_t s_buf_size = 0;
+static size_t s_count = 0;
+static uint32_t s_in_use = 0;
+static uint32_t s_high_water = 0;
+static uint32_t s_exhausted = 0;
+
+esp_err_t usb_rx_pool_init_aq(size_t count, size_t buf_size) {
+    if (count == 0 || buf_size < sizeof(free_node_t)) return ESP_ERR_INVALID_ARG;
+    if (s_pool_mem) return ESP_ERR_INVALID_STATE;
+
+    // Alinear a 4 bytes para que cada buffer pueda alojar el nodo de la lista libre
+    buf_size = (buf_size + 3) & ~(size_t)3;
+    s_pool_mem = usb_mem_alloc_aq(USB_MEM_RX_POOL_AQ, count * buf_size);
+    if (s_pool_mem == NULL) {
+        ESP_LOGE(TAG, "Cannot reserve RX pool (%u x %u bytes)", (unsigned)count, (unsigned)buf_size);
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_buf_size = buf_size;
+    s_count = count;
+    s_free_list = NULL;
+    for (size_t i = count; i > 0; i--) {
+        free_node_t *node = (free_node_t *)(s_pool_mem + (i - 1) * buf_size);
+        node->next = s_free_list;
+        s_free_list = node;
+    }
+    s_in_use = 0;
+    s_high_water = 0;
+    s_exhausted = 0;
+
+    ESP_LOGI(TAG, "RX pool ready: %u buffers of %u bytes", (unsigned)count, (unsigned)buf_size);
+    return ESP_OK;
+}
+
+void usb_rx_pool_deinit_aq(void) {
+    if (s_in_use) {
+        ESP_LOGW(TAG, "Releasing RX pool with %u buffers still in use", (unsigned)s_in_use);
+    }
+    usb_mem_free_aq(USB_MEM_RX_POOL_AQ, s_pool_mem, s_count * s_buf_size);
+    s_pool_mem = NULL;
+    s_free_list = NULL;
+    s_count = 0;
+}
+
+void *usb_rx_pool_alloc_aq(void) {
+    free_node_t *node;
+    taskENTER_CRITICAL(&s_pool_lock);
+    node = s_free_list;
+    if (node) {
+        s_free_list = node->next;
+        if (++s_in_use > s_high_water) {
+            s_high_water = s_in_use;
+        }
+    } else {
+        s_exhausted++;
+    }
+    taskEXIT_CRITICAL(&s_pool_lock);
+    return node;
+}
+
+void usb_rx_pool_free_aq(void *buf) {
+    if (buf == NULL) return;
+    free_node_t *node = (free_node_t *)buf;
+    taskENTER_CRITICAL(&s_pool_lock);
+    node->next = s_free_list;
+    s_free_list = node;
+    s_in_use--;
+    taskEXIT_CRITICAL(&s_pool_lock);
+}
+
+bool usb_rx_pool_owns_aq(const void *buf) {
+    const uint8_t *p = (const uint8_t *)buf;
+    return s_pool_mem && p >= s_pool_mem && p < s_pool_mem + s_count * s_buf_size &&
+           ((size_t)(p - s_pool_mem) % s_buf_size) == 0;
+}
+
+bool usb_rx_pool_has_free_aq(void) {
+    return *(free_node_t *volatile *)&s_free_list != NULL;
+}
+
+size_t usb_rx_pool_buf_size_aq(void) {
+    return s_buf_size;
+}
+
+void usb_rx_pool_get_stats_aq(usb_netif_rx_pool_stats_aq_t *out) {
+    taskENTER_CRITICAL(&s_pool_lock);
+    out->capacity = s_count;
+    out->in_use = s_in_use;
+    out->high_water = s_high_water;
+    out->exhausted = s_exhausted;
+    taskEXIT_CRITICAL(&s_pool_lock);
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "usb_netif_aq.h"
+
+// Pool de buffers RX de tamaño fijo, reservado una sola vez en usb_netif_install_aq.
+// alloc se llama desde el contexto de TinyUSB y free desde el hilo tcpip (al liberar
+// el pbuf), por eso ambos están protegidos con un spinlock corto.
+
+esp_err_t usb_rx_pool_init_aq(size_t count, size_t buf_size);
+void      usb_rx_pool_deinit_aq(void);
+void     *usb_rx_pool_alloc_aq(void);
+void      usb_rx_pool_free_aq(void *buf);
+bool      usb_rx_pool_owns_aq(const void *buf);
+// Queda algún buffer libre. Sin lock: solo el callback reserva, así que un true sigue
+// valiendo hasta su próxima trama (los free de lwIP solo pueden añadir)
+bool      usb_rx_pool_has_free_aq(void);
+size_t    usb_rx_pool_buf_size_aq(void);
+void      usb_rx_pool_get_stats_aq(usb_netif_rx_pool_stats_aq_t *out);
@@ -0,0 +1,21 @@
+#include "usb_spsc_aq.h"
+#include "usb_mem_aq.h"
+
+esp_err_t usb_spsc_init_aq(usb_spsc_aq_t *r, uint32_t item_size, uint32_t capacity) {
+    if (r == NULL || item_size == 0 || capacity == 0) return ESP_ERR_INVALID_ARG;
+    if (item_size > USB_MEM_RING_SLOT_AQ) return ESP_ERR_INVALID_SIZE;
+    // En RAM interna: el anillo se toca en cada paquete desde los dos núcleos
+    r->slots = usb_mem_alloc_aq(USB_MEM_RINGS_AQ, (size_t)(capacity + 1) * item_size);
+    if (r->slots == NULL) return ESP_ERR_NO_MEM;
+    r->item_size = item_size;
+    r->size = capacity + 1;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    return ESP_OK;
+}
+
+void usb_spsc_deinit_aq(usb_spsc_aq_t *r) {
+    usb_mem_free_aq(USB_MEM_RINGS_AQ, r->slots, (size_t)r->size * r->item_size);
+    r->slots = NULL;
+    r->size = 0;
+}
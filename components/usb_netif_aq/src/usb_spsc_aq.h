@@ -0,0 +1,56 @@
+#pragma once
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "esp_err.h"
+
+// Anillo lock-free de un productor y un consumidor con elementos de tamaño fijo.
+// Sin secciones críticas: el productor solo escribe head y el consumidor solo tail,
+// publicados con release/acquire (memw en Xtensa). La capacidad no tiene que ser
+// potencia de 2; se reserva un hueco extra para distinguir lleno de vacío.
+
+typedef struct {
+    uint8_t *slots;
+    uint32_t item_size;
+    uint32_t size;              // capacidad + 1
+    _Atomic uint32_t head;      // siguiente hueco a escribir (productor)
+    _Atomic uint32_t tail;      // siguiente elemento a leer (consumidor)
+} usb_spsc_aq_t;
+
+esp_err_t usb_spsc_init_aq(usb_spsc_aq_t *r, uint32_t item_size, uint32_t capacity);
+void      usb_spsc_deinit_aq(usb_spsc_aq_t *r);
+
+static inline uint32_t usb_spsc_next_aq(const usb_spsc_aq_t *r, uint32_t i) {
+    return ++i == r->size ? 0 : i;
+}
+
+// Solo el productor. false si está lleno.
+static inline bool usb_spsc_push_aq(usb_spsc_aq_t *r, const void *item) {
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint32_t next = usb_spsc_next_aq(r, head);
+    if (next == atomic_load_explicit(&r->tail, memory_order_acquire)) {
+        return false;
+    }
+    memcpy(r->slots + head * r->item_size, item, r->item_size);
+    atomic_store_explicit(&r->head, next, memory_order_release);
+    return true;
+}
+
+// Solo el consumidor. false si está vacío.
+static inline bool usb_spsc_pop_aq(usb_spsc_aq_t *r, void *item) {
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    if (tail == atomic_load_explicit(&r->head, memory_order_acquire)) {
+        return false;
+    }
+    memcpy(item, r->slots + tail * r->item_size, r->item_size);
+    atomic_store_explicit(&r->tail, usb_spsc_next_aq(r, tail), memory_order_release);
+    return true;
+}
+
+// Ocupación aproximada; exacta desde el productor o el consumidor
+static inline uint32_t usb_spsc_count_aq(const usb_spsc_aq_t *r) {
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    return head >= tail ? head - tail : r->size - tail + head;
+}
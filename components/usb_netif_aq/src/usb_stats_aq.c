@@ -0,0 +1,68 @@
+#include "usb_stats_aq.h"
+#include "esp_log.h"
+#include "esp_event.h"
+
+static const char *TAG = "usb_stats_aq";
+
+usb_stats_counters_aq_t g_usb_stats_aq;
+
+static esp_timer_handle_t s_report_timer = NULL;
+
+static uint32_t load(atomic_uint *c) {
+    return atomic_load_explicit(c, memory_order_relaxed);
+}
+
+void usb_stats_snapshot_aq(usb_netif_stats_aq_t *out) {
+    // Sin lock: cada campo es coherente por sí mismo, no entre campos
+    out->timestamp_us = esp_timer_get_time();
+    out->rx_packets = load(&g_usb_stats_aq.rx_packets);
+    out->rx_bytes = load(&g_usb_stats_aq.rx_bytes);
+    out->tx_packets = load(&g_usb_stats_aq.tx_packets);
+    out->tx_bytes = load(&g_usb_stats_aq.tx_bytes);
+    for (int i = 0; i < USB_NETIF_DROP_COUNT_AQ; i++) {
+        out->drops[i] = load(&g_usb_stats_aq.drops[i]);
+    }
+    out->rx_queue_high_water = load(&g_usb_stats_aq.rx_queue_high_water);
+    for (int i = 0; i < USB_NETIF_LAT_BUCKETS_AQ; i++) {
+        out->rx_latency_us[i] = load(&g_usb_stats_aq.rx_latency[i]);
+        out->tx_latency_us[i] = load(&g_usb_stats_aq.tx_latency[i]);
+    }
+    out->rx_pauses = load(&g_usb_stats_aq.rx_pauses);
+    out->rx_resumes = load(&g_usb_stats_aq.rx_resumes);
+    out->rx_paused_us = load(&g_usb_stats_aq.rx_paused_us);
+}
+
+void usb_stats_reset_aq(void) {
+    atomic_uint *c = (atomic_uint *)&g_usb_stats_aq;
+    for (size_t i = 0; i < sizeof(g_usb_stats_aq) / sizeof(atomic_uint); i++) {
+        atomic_store_explicit(&c[i], 0, memory_order_relaxed);
+    }
+}
+
+static void report_timer_cb(void *arg) {
+    usb_netif_stats_aq_t snap;
+    usb_stats_snapshot_aq(&snap);
+    // Sin espera: si el bucle de eventos va lleno se pierde este informe, no el siguiente
+    if (esp_event_post(USB_NET_EVENTS, USB_NET_STATS, &snap, sizeof(snap), 0) != ESP_OK) {
+        ESP_LOGD(TAG, "Stats event dropped");
+    }
+}
+
+esp_err_t usb_stats_start_aq(uint32_t period_ms) {
+    if (period_ms == 0 || s_report_timer) return ESP_OK;
+    const esp_timer_create_args_t args = {
+        .callback = report_timer_cb,
+        .name = "usb_stats",
+    };
+    esp_err_t err = esp_timer_create(&args, &s_report_timer);
+    if (err != ESP_OK) return err;
+    return esp_timer_start_periodic(s_report_timer, (uint64_t)period_ms * 1000);
+}
+
+void usb_stats_stop_aq(void) {
+    if (s_report_timer) {
+        esp_timer_stop(s_report_timer);
+        esp_timer_delete(s_report_timer);
+        s_report_timer = NULL;
+    }
+}
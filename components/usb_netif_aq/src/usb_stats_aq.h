@@ -0,0 +1,61 @@
+#pragma once
+#include <stdatomic.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "usb_netif_aq.h"
+
+// Contadores de la ruta de datos. Se actualizan con atómicos relajados (una instrucción
+// en Xtensa/RISC-V, sin secciones críticas) desde el callback de TinyUSB, la tarea RX,
+// el hilo tcpip y la tarea TX. Son de 32 bits y dan la vuelta: usar diferencias.
+typedef struct {
+    atomic_uint rx_packets;
+    atomic_uint rx_bytes;
+    atomic_uint tx_packets;
+    atomic_uint tx_bytes;
+    atomic_uint drops[USB_NETIF_DROP_COUNT_AQ];
+    atomic_uint rx_queue_high_water;
+    atomic_uint rx_latency[USB_NETIF_LAT_BUCKETS_AQ];
+    atomic_uint tx_latency[USB_NETIF_LAT_BUCKETS_AQ];
+    atomic_uint rx_pauses;
+    atomic_uint rx_resumes;
+    atomic_uint rx_paused_us;
+} usb_stats_counters_aq_t;
+
+extern usb_stats_counters_aq_t g_usb_stats_aq;
+
+static inline void usb_stats_add_aq(atomic_uint *counter, uint32_t n) {
+    atomic_fetch_add_explicit(counter, n, memory_order_relaxed);
+}
+
+static inline void usb_stats_drop_aq(usb_netif_drop_aq_t cause) {
+    atomic_fetch_add_explicit(&g_usb_stats_aq.drops[cause], 1, memory_order_relaxed);
+}
+
+static inline void usb_stats_rx_depth_aq(uint32_t depth) {
+    unsigned hw = atomic_load_explicit(&g_usb_stats_aq.rx_queue_high_water, memory_order_relaxed);
+    while (depth > hw &&
+           !atomic_compare_exchange_weak_explicit(&g_usb_stats_aq.rx_queue_high_water, &hw, depth,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+// Marca de tiempo para las latencias: µs truncados a 32 bits (la resta sigue siendo
+// correcta aunque el contador dé la vuelta)
+static inline uint32_t usb_stats_stamp_aq(void) {
+    return (uint32_t)esp_timer_get_time();
+}
+
+// Suma una muestra al histograma log2: cubeta i = [2^i, 2^(i+1)) µs
+static inline void usb_stats_latency_aq(atomic_uint *hist, uint32_t t0) {
+    uint32_t dt = usb_stats_stamp_aq() - t0;
+    uint32_t b = 31 - __builtin_clz(dt | 1);
+    if (b >= USB_NETIF_LAT_BUCKETS_AQ) b = USB_NETIF_LAT_BUCKETS_AQ - 1;
+    atomic_fetch_add_explicit(&hist[b], 1, memory_order_relaxed);
+}
+
+void      usb_stats_snapshot_aq(usb_netif_stats_aq_t *out);
+void      usb_stats_reset_aq(void);
+// Publica USB_NET_STATS cada period_ms en el bucle de eventos por defecto (0 = nunca)
+esp_err_t usb_stats_start_aq(uint32_t period_ms);
+void      usb_stats_stop_aq(void);
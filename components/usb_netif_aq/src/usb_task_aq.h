@@ -0,0 +1,10 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Núcleo de las tareas del driver a partir del Kconfig (-1 = sin afinidad)
+#if CONFIG_FREERTOS_UNICORE
+#define USB_TASK_CORE_AQ(core) 0
+#else
+#define USB_TASK_CORE_AQ(core) ((core) < 0 ? tskNO_AFFINITY : (BaseType_t)(core))
+#endif
@@ -0,0 +1,198 @@
+#include "usb_tx_aq.h"
+#include <stdatomic.h>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "tinyusb_net.h"
+#include "usb_dlog_aq.h"
+#include "usb_mem_aq.h"
+#include "usb_tx_class_aq.h"
+#include "ncm_agg_aq.h"
+#include "usb_spsc_aq.h"
+#include "usb_stats_aq.h"
+#include "usb_task_aq.h"
+
+typedef struct {
+    struct pbuf *p;     // referencia retenida hasta que TinyUSB copia la trama
+    void *payload;
+    uint16_t len;
+    uint32_t t_enq;     // usb_stats_stamp_aq() al encolar, para el histograma TX
+} tx_item_t;
+
+// Un anillo SPSC por clase. Productor: el hilo tcpip (linkoutput de lwIP, serializado
+// también con LWIP_TCPIP_CORE_LOCKING). Consumidor: usb_tx_task.
+static usb_spsc_aq_t s_tx_ring[USB_NETIF_TX_CLASS_COUNT_AQ];
+static bool s_tx_ready = false;
+static TaskHandle_t s_tx_task_handle = NULL;
+static atomic_bool s_tx_sleeping = false;  // usb_tx_task va a bloquearse
+static esp_timer_handle_t s_flush_timer = NULL;
+static ncm_agg_aq_t s_agg;
+
+static void tx_send(tx_item_t *item) {
+    esp_err_t ret = tinyusb_net_send_sync(item->payload, item->len, NULL,
+                                          pdMS_TO_TICKS(CONFIG_AQ_USB_TX_TIMEOUT_MS));
+    if (ret == ESP_OK) {
+        usb_stats_latency_aq(g_usb_stats_aq.tx_latency, item->t_enq);
+        usb_stats_add_aq(&g_usb_stats_aq.tx_packets, 1);
+        usb_stats_add_aq(&g_usb_stats_aq.tx_bytes, item->len);
+    } else {
+        USB_DLOG_AQ(TX_FAILED, item->len, ret);
+        usb_stats_drop_aq(ret == ESP_ERR_TIMEOUT ? USB_NETIF_DROP_TX_TIMEOUT_AQ : USB_NETIF_DROP_TX_USB_ERROR_AQ);
+    }
+    pbuf_free(item->p);
+}
+
+// Vence la espera de agregación: despertar a la tarea TX para que vacíe el lote
+static void flush_timer_cb(void *arg) {
+    xTaskNotifyGive(s_tx_task_handle);
+}
+
+// Despierta a usb_tx_task solo si anunció que iba a dormir (ver usb_tx_task)
+static inline void tx_wake(void) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&s_tx_sleeping, memory_order_relaxed) &&
+        atomic_exchange_explicit(&s_tx_sleeping, false, memory_order_relaxed)) {
+        xTaskNotifyGive(s_tx_task_handle);
+    }
+}
+
+static void usb_tx_task(void *arg) {
+    usb_spsc_aq_t *ctrl_q = &s_tx_ring[USB_NETIF_TX_CLASS_CONTROL_AQ];
+    usb_spsc_aq_t *bulk_q = &s_tx_ring[USB_NETIF_TX_CLASS_BULK_AQ];
+    tx_item_t item;
+    uint32_t pending = 0;
+    while (1) {
+        // Anunciar que vamos a dormir y volver a mirar: lo encolado después de la
+        // barrera ve el flag y nos notifica; lo anterior lo vemos aquí. En HOLD solo
+        // despiertan el timer de flush o tramas nuevas.
+        atomic_store_explicit(&s_tx_sleeping, true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (usb_spsc_count_aq(ctrl_q) == 0 && usb_spsc_count_aq(bulk_q) == pending) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+        atomic_store_explicit(&s_tx_sleeping, false, memory_order_relaxed);
+        while (1) {
+            // Prioridad estricta: control nunca se agrega ni espera detrás de bulk
+            while (usb_spsc_pop_aq(ctrl_q, &item)) {
+                tx_send(&item);
+            }
+
+            int64_t now = esp_timer_get_time();
+            pending = usb_spsc_count_aq(bulk_q);
+            ncm_agg_decision_aq_t d = ncm_agg_decide_aq(&s_agg, now, (uint16_t)pending);
+            if (d == NCM_AGG_IDLE) {
+                break;
+            }
+            if (d == NCM_AGG_HOLD) {
+                // Esperar a más tramas para llenar el NTB; el timer fuerza el envío
+                if (!esp_timer_is_active(s_flush_timer)) {
+                    int64_t wait = ncm_agg_deadline_aq(&s_agg) - now;
+                    esp_timer_start_once(s_flush_timer, wait > 0 ? (uint64_t)wait : 1);
+                }
+                break;
+            }
+
+            // Ráfaga de hasta max_datagrams tramas seguidas: TinyUSB las empaqueta en
+            // el mismo NTB. Se corta si llega una trama de control.
+            uint16_t sent = 0;
+            while (sent < s_agg.cfg.max_datagrams && usb_spsc_pop_aq(bulk_q, &item)) {
+                tx_send(&item);
+                sent++;
+                if (usb_spsc_count_aq(ctrl_q)) break;
+            }
+            ncm_agg_flushed_aq(&s_agg, sent);
+        }
+    }
+}
+
+esp_err_t usb_tx_init_aq(void) {
+    const uint32_t depth[USB_NETIF_TX_CLASS_COUNT_AQ] = {
+        [USB_NETIF_TX_CLASS_CONTROL_AQ] = CONFIG_AQ_USB_TX_CTRL_QUEUE_LEN,
+        [USB_NETIF_TX_CLASS_BULK_AQ] = CONFIG_AQ_USB_TX_BULK_QUEUE_LEN,
+    };
+    for (int c = 0; c < USB_NETIF_TX_CLASS_COUNT_AQ; c++) {
+        esp_err_t err = usb_spsc_init_aq(&s_tx_ring[c], sizeof(tx_item_t), depth[c]);
+        if (err != ESP_OK) {
+            usb_tx_deinit_aq();
+            return err;
+        }
+    }
+    const ncm_agg_cfg_aq_t agg_cfg = {
+        .max_datagrams = CONFIG_AQ_USB_NCM_MAX_DATAGRAMS_PER_NTB,
+        .flush_us = CONFIG_AQ_USB_NCM_FLUSH_US,
+#if CONFIG_AQ_USB_NCM_ADAPTIVE_FLUSH
+        .adaptive = true,
+#endif
+    };
+    ncm_agg_init_aq(&s_agg, &agg_cfg);
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = flush_timer_cb,
+        .name = "usb_tx_flush",
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &s_flush_timer);
+    if (err != ESP_OK) {
+        usb_tx_deinit_aq();
+        return err;
+    }
+
+    usb_tx_class_init_aq(CONFIG_AQ_USB_TX_CTRL_DSCP_MIN);
+#if CONFIG_AQ_USB_TX_CTRL_PORT
+    usb_tx_class_add_port_aq(CONFIG_AQ_USB_TX_CTRL_PORT);
+#endif
+    s_tx_ready = true;
+    return ESP_OK;
+}
+
+esp_err_t usb_tx_start_aq(void) {
+    return usb_mem_task_create_aq(USB_NETIF_TASK_TX_AQ, usb_tx_task, NULL, CONFIG_AQ_USB_TX_TASK_PRIO,
+                                  USB_TASK_CORE_AQ(CONFIG_AQ_USB_TX_TASK_CORE), &s_tx_task_handle);
+}
+
+void usb_tx_stop_aq(void) {
+    if (s_flush_timer) {
+        esp_timer_stop(s_flush_timer);
+    }
+    usb_mem_task_delete_aq(USB_NETIF_TASK_TX_AQ);
+    s_tx_task_handle = NULL;
+}
+
+void usb_tx_deinit_aq(void) {
+    tx_item_t item;
+    if (s_flush_timer) {
+        esp_timer_delete(s_flush_timer);
+        s_flush_timer = NULL;
+    }
+    s_tx_ready = false;
+    for (int c = 0; c < USB_NETIF_TX_CLASS_COUNT_AQ; c++) {
+        if (s_tx_ring[c].slots == NULL) continue;
+        while (usb_spsc_pop_aq(&s_tx_ring[c], &item)) {
+            pbuf_free(item.p);
+        }
+        usb_spsc_deinit_aq(&s_tx_ring[c]);
+    }
+}
+
+void usb_tx_ring_usage_aq(usb_netif_tx_class_aq_t cls, uint32_t *used, uint32_t *capacity) {
+    *used = s_tx_ready ? usb_spsc_count_aq(&s_tx_ring[cls]) : 0;
+    *capacity = s_tx_ring[cls].size ? s_tx_ring[cls].size - 1 : 0;
+}
+
+esp_err_t usb_tx_enqueue_aq(void *payload, size_t len, struct pbuf *p) {
+    // Sin pbuf la llamada viene de esp_netif_transmit, que cualquier tarea puede invocar:
+    // empujar desde ahí rompería el productor único de los anillos SPSC
+    if (p == NULL) return ESP_ERR_NOT_SUPPORTED;
+    if (!s_tx_ready || s_tx_task_handle == NULL) return ESP_ERR_INVALID_STATE;
+
+    tx_item_t item = { .p = p, .payload = payload, .len = (uint16_t)len, .t_enq = usb_stats_stamp_aq() };
+    pbuf_ref(p);
+
+    usb_netif_tx_class_aq_t cls = usb_tx_classify_aq(item.payload, len);
+    if (!usb_spsc_push_aq(&s_tx_ring[cls], &item)) {
+        pbuf_free(item.p);
+        usb_stats_drop_aq(USB_NETIF_DROP_TX_QUEUE_FULL_AQ);
+        return ESP_ERR_NO_MEM;
+    }
+    tx_wake();
+    return ESP_OK;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <stddef.h>
+#include "esp_err.h"
+#include "lwip/pbuf.h"
+#include "usb_netif_aq.h"
+
+// Etapa TX asíncrona: el hilo tcpip solo encola (referencia al pbuf, sin copia) en un
+// anillo SPSC por clase y una tarea dedicada los vacía hacia TinyUSB, siempre el de
+// control antes que el bulk.
+
+esp_err_t usb_tx_init_aq(void);
+esp_err_t usb_tx_start_aq(void);
+void      usb_tx_stop_aq(void);
+void      usb_tx_deinit_aq(void);
+
+// Ocupación actual del anillo de una clase (informe de memoria)
+void      usb_tx_ring_usage_aq(usb_netif_tx_class_aq_t cls, uint32_t *used, uint32_t *capacity);
+
+// Un solo productor: llamar solo desde el hilo tcpip (transmit_wrap de esp_netif, con el
+// pbuf de lwIP). Con p == NULL devuelve ESP_ERR_NOT_SUPPORTED sin encolar: esp_netif_transmit
+// sin pbuf puede llegar desde cualquier tarea. ESP_ERR_NO_MEM si el anillo de la clase está
+// lleno (lwIP lo recibe como ERR_MEM)
+esp_err_t usb_tx_enqueue_aq(void *payload, size_t len, struct pbuf *p);
@@ -0,0 +1,117 @@
+#include "usb_tx_class_aq.h"
+
+#define ETH_HDR_LEN 14
+#define ETHTYPE_VLAN 0x8100
+#define ETHTYPE_IPV4 0x0800
+#define ETHTYPE_ARP  0x0806
+#define ETHTYPE_IPV6 0x86DD
+
+#define IP_PROTO_ICMP   1
+#define IP_PROTO_TCP    6
+#define IP_PROTO_UDP    17
+#define IP_PROTO_ICMPV6 58
+
+#define DHCP_SERVER_PORT 67
+#define DHCP_CLIENT_PORT 68
+
+// Puertos de control. Un 0 marca hueco libre; las escrituras de 16 bits alineadas son
+// atómicas en Xtensa, así que el hilo tcpip puede leer la tabla sin lock.
+static volatile uint16_t s_ctrl_ports[USB_TX_CLASS_MAX_PORTS];
+static uint8_t s_ctrl_dscp_min = 40;
+
+static inline uint16_t rd16(const uint8_t *p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static bool is_ctrl_port(uint16_t port) {
+    if (port == 0) return false;
+    for (int i = 0; i < USB_TX_CLASS_MAX_PORTS; i++) {
+        if (s_ctrl_ports[i] == port) return true;
+    }
+    return false;
+}
+
+static usb_netif_tx_class_aq_t classify_l4(uint8_t proto, const uint8_t *l4, size_t l4_len) {
+    if (proto != IP_PROTO_TCP && proto != IP_PROTO_UDP) {
+        return USB_NETIF_TX_CLASS_BULK_AQ;
+    }
+    if (l4_len < 4) return USB_NETIF_TX_CLASS_BULK_AQ;
+    uint16_t src = rd16(l4);
+    uint16_t dst = rd16(l4 + 2);
+    if (proto == IP_PROTO_UDP && (dst == DHCP_SERVER_PORT || dst == DHCP_CLIENT_PORT)) {
+        return USB_NETIF_TX_CLASS_CONTROL_AQ;
+    }
+    return (is_ctrl_port(src) || is_ctrl_port(dst)) ? USB_NETIF_TX_CLASS_CONTROL_AQ
+                                                    : USB_NETIF_TX_CLASS_BULK_AQ;
+}
+
+void usb_tx_class_init_aq(uint8_t ctrl_dscp_min) {
+    s_ctrl_dscp_min = ctrl_dscp_min;
+}
+
+usb_netif_tx_class_aq_t usb_tx_classify_aq(const uint8_t *frame, size_t len) {
+    if (len < ETH_HDR_LEN) return USB_NETIF_TX_CLASS_BULK_AQ;
+
+    size_t off = 12;
+    uint16_t ethertype = rd16(frame + off);
+    if (ethertype == ETHTYPE_VLAN && len >= ETH_HDR_LEN + 4) {
+        off += 4;
+        ethertype = rd16(frame + off);
+    }
+    off += 2;
+    const uint8_t *ip = frame + off;
+    size_t ip_len = len - off;
+
+    switch (ethertype) {
+    case ETHTYPE_ARP:
+        // Sin ARP no sale nada más; nunca debe esperar detrás de una ráfaga
+        return USB_NETIF_TX_CLASS_CONTROL_AQ;
+
+    case ETHTYPE_IPV4: {
+        if (ip_len < 20) return USB_NETIF_TX_CLASS_BULK_AQ;
+        size_t ihl = (size_t)(ip[0] & 0x0F) * 4;
+        uint8_t dscp = ip[1] >> 2;
+        uint8_t proto = ip[9];
+        if (s_ctrl_dscp_min && dscp >= s_ctrl_dscp_min) return USB_NETIF_TX_CLASS_CONTROL_AQ;
+        if (proto == IP_PROTO_ICMP) return USB_NETIF_TX_CLASS_CONTROL_AQ;
+        // Solo el primer fragmento lleva cabecera L4
+        bool first_frag = ((ip[6] & 0x1F) | ip[7]) == 0;
+        if (!first_frag || ihl < 20 || ip_len < ihl) return USB_NETIF_TX_CLASS_BULK_AQ;
+        return classify_l4(proto, ip + ihl, ip_len - ihl);
+    }
+
+    case ETHTYPE_IPV6: {
+        if (ip_len < 40) return USB_NETIF_TX_CLASS_BULK_AQ;
+        uint8_t tclass = (uint8_t)(((ip[0] & 0x0F) << 4) | (ip[1] >> 4));
+        uint8_t next = ip[6];
+        if (s_ctrl_dscp_min && (tclass >> 2) >= s_ctrl_dscp_min) return USB_NETIF_TX_CLASS_CONTROL_AQ;
+        if (next == IP_PROTO_ICMPV6) return USB_NETIF_TX_CLASS_CONTROL_AQ;  // ND/RS
+        return classify_l4(next, ip + 40, ip_len - 40);
+    }
+
+    default:
+        return USB_NETIF_TX_CLASS_BULK_AQ;
+    }
+}
+
+esp_err_t usb_tx_class_add_port_aq(uint16_t port) {
+    if (port == 0) return ESP_ERR_INVALID_ARG;
+    if (is_ctrl_port(port)) return ESP_OK;
+    for (int i = 0; i < USB_TX_CLASS_MAX_PORTS; i++) {
+        if (s_ctrl_ports[i] == 0) {
+            s_ctrl_ports[i] = port;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t usb_tx_class_remove_port_aq(uint16_t port) {
+    for (int i = 0; i < USB_TX_CLASS_MAX_PORTS; i++) {
+        if (port != 0 && s_ctrl_ports[i] == port) {
+            s_ctrl_ports[i] = 0;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
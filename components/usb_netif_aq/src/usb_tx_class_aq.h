@@ -0,0 +1,14 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "usb_netif_aq.h"
+
+// Clasificador de tramas TX (solo lee la cabecera Ethernet/IP, sin dependencias de IDF).
+// Se ejecuta en el hilo tcpip por cada trama saliente.
+
+#define USB_TX_CLASS_MAX_PORTS 8
+
+void usb_tx_class_init_aq(uint8_t ctrl_dscp_min);
+usb_netif_tx_class_aq_t usb_tx_classify_aq(const uint8_t *frame, size_t len);
+esp_err_t usb_tx_class_add_port_aq(uint16_t port);
+esp_err_t usb_tx_class_remove_port_aq(uint16_t port);
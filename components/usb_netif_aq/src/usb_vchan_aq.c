@@ -0,0 +1,178 @@
+#include "usb_vchan_aq.h"
+#include <string.h>
+
+typedef struct {
+    uint8_t *block;
+    uint32_t len;       // payload
+    bool discard;       // abandonado por el productor: vuelve al pool sin enviarse
+} vchan_item_t;
+
+uint32_t usb_vchan_block_size_aq(uint32_t payload_max) {
+    // +1: byte de relleno para que la transferencia no acabe en un paquete completo
+    return (USB_VCHAN_HDR_AQ + payload_max + 1 + 3) & ~3u;
+}
+
+esp_err_t usb_vchan_init_aq(usb_vchan_aq_t *ch, uint8_t *mem, uint32_t blocks, uint32_t payload_max,
+                            const usb_vchan_ops_aq_t *ops) {
+    if (ch == NULL || mem == NULL || ops == NULL || blocks == 0 || payload_max == 0 ||
+        USB_VCHAN_HDR_AQ + payload_max + 1 > UINT16_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(ch, 0, sizeof(*ch));
+    ch->ops = *ops;
+    ch->mem = mem;
+    ch->blocks = blocks;
+    ch->block_size = usb_vchan_block_size_aq(payload_max);
+    ch->payload_max = payload_max;
+    esp_err_t err = usb_spsc_init_aq(&ch->free_ring, sizeof(uint8_t *), blocks);
+    if (err != ESP_OK) return err;
+    err = usb_spsc_init_aq(&ch->tx_ring, sizeof(vchan_item_t), blocks);
+    if (err != ESP_OK) {
+        usb_spsc_deinit_aq(&ch->free_ring);
+        return err;
+    }
+    // Aún sin transporte: este hilo hace de productor del anillo de libres
+    for (uint32_t i = 0; i < blocks; i++) {
+        uint8_t *b = mem + i * ch->block_size;
+        usb_spsc_push_aq(&ch->free_ring, &b);
+    }
+    // Cerrado = busy: los envíos se encolan sin avisar hasta usb_vchan_open_aq
+    atomic_store_explicit(&ch->busy, true, memory_order_relaxed);
+    return ESP_OK;
+}
+
+void usb_vchan_deinit_aq(usb_vchan_aq_t *ch) {
+    usb_spsc_deinit_aq(&ch->tx_ring);
+    usb_spsc_deinit_aq(&ch->free_ring);
+    ch->mem = NULL;
+}
+
+static uint8_t *block_of(usb_vchan_aq_t *ch, uint8_t *payload) {
+    if (ch->mem == NULL || payload == NULL) return NULL;
+    uint8_t *b = payload - USB_VCHAN_HDR_AQ;
+    if (b < ch->mem || b >= ch->mem + ch->blocks * ch->block_size) return NULL;
+    if ((uint32_t)(b - ch->mem) % ch->block_size != 0) return NULL;
+    return b;
+}
+
+uint8_t *usb_vchan_get_aq(usb_vchan_aq_t *ch, size_t *capacity) {
+    uint8_t *b;
+    if (ch->mem == NULL || !usb_spsc_pop_aq(&ch->free_ring, &b)) {
+        atomic_fetch_add_explicit(&ch->no_block, 1, memory_order_relaxed);
+        return NULL;
+    }
+    if (capacity) *capacity = ch->payload_max;
+    return b + USB_VCHAN_HDR_AQ;
+}
+
+// Avisa al transporte solo si no había nada en marcha (ver usb_vchan_pump_aq)
+static void vchan_kick(usb_vchan_aq_t *ch) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!atomic_exchange_explicit(&ch->busy, true, memory_order_relaxed)) {
+        ch->ops.kick(ch->ops.ctx);
+    }
+}
+
+esp_err_t usb_vchan_send_aq(usb_vchan_aq_t *ch, uint8_t *payload, size_t len, uint8_t stream, uint32_t ts_us) {
+    uint8_t *b = block_of(ch, payload);
+    if (b == NULL || len == 0 || len > ch->payload_max) return ESP_ERR_INVALID_ARG;
+    usb_vchan_hdr_aq_t *h = (usb_vchan_hdr_aq_t *)b;
+    h->magic = USB_VCHAN_MAGIC_AQ;
+    h->version = USB_VCHAN_VERSION_AQ;
+    h->stream = stream;
+    h->seq = ch->seq++;
+    h->ts_us = ts_us;
+    h->len = (uint32_t)len;
+    vchan_item_t it = { .block = b, .len = (uint32_t)len };
+    // Cada bloque está en un solo sitio a la vez: el anillo TX nunca se llena
+    usb_spsc_push_aq(&ch->tx_ring, &it);
+    uint32_t depth = usb_spsc_count_aq(&ch->tx_ring);
+    if (depth > ch->queue_high_water) ch->queue_high_water = depth;
+    vchan_kick(ch);
+    return ESP_OK;
+}
+
+void usb_vchan_release_aq(usb_vchan_aq_t *ch, uint8_t *payload) {
+    uint8_t *b = block_of(ch, payload);
+    if (b == NULL) return;
+    // El anillo de libres solo lo alimenta el transporte: el bloque vuelve por la cola TX
+    vchan_item_t it = { .block = b, .discard = true };
+    usb_spsc_push_aq(&ch->tx_ring, &it);
+    vchan_kick(ch);
+}
+
+void usb_vchan_open_aq(usb_vchan_aq_t *ch, uint16_t packet_size) {
+    ch->packet_size = packet_size;
+    atomic_store_explicit(&ch->busy, true, memory_order_relaxed);
+    usb_vchan_pump_aq(ch);
+}
+
+void usb_vchan_pump_aq(usb_vchan_aq_t *ch) {
+    // Cerrado: busy sigue en true y open volverá a llamar. Con una transferencia en
+    // curso, usb_vchan_done_aq seguirá con la cola.
+    if (ch->mem == NULL || ch->packet_size == 0 || ch->in_flight) return;
+    vchan_item_t it;
+    for (;;) {
+        while (usb_spsc_pop_aq(&ch->tx_ring, &it)) {
+            if (!it.discard) {
+                uint32_t n = USB_VCHAN_HDR_AQ + it.len;
+                if (n % ch->packet_size == 0) n++;  // paquete corto final = fin de trama
+                ch->in_flight = it.block;
+                if (ch->ops.xfer(ch->ops.ctx, it.block, n)) return;
+                ch->in_flight = NULL;
+                atomic_fetch_add_explicit(&ch->dropped, 1, memory_order_relaxed);
+            }
+            usb_spsc_push_aq(&ch->free_ring, &it.block);
+        }
+        // Nada que enviar: soltar busy y volver a mirar. Un send posterior a la barrera
+        // ve busy = false y avisa; uno anterior lo vemos aquí.
+        atomic_store_explicit(&ch->busy, false, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (usb_spsc_count_aq(&ch->tx_ring) == 0 ||
+            atomic_exchange_explicit(&ch->busy, true, memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+void usb_vchan_done_aq(usb_vchan_aq_t *ch, bool ok, uint32_t bytes) {
+    uint8_t *b = ch->in_flight;
+    if (b == NULL) return;
+    ch->in_flight = NULL;
+    if (ok) {
+        atomic_fetch_add_explicit(&ch->blocks_sent, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&ch->bytes_sent, ((usb_vchan_hdr_aq_t *)b)->len, memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&ch->dropped, 1, memory_order_relaxed);
+    }
+    usb_spsc_push_aq(&ch->free_ring, &b);
+    usb_vchan_pump_aq(ch);
+}
+
+void usb_vchan_close_aq(usb_vchan_aq_t *ch) {
+    ch->packet_size = 0;
+    atomic_store_explicit(&ch->busy, true, memory_order_relaxed);
+    if (ch->mem == NULL) return;
+    // El host ya no lee: lo pendiente es viejo; el salto de seq lo delata al reconectar
+    if (ch->in_flight) {
+        usb_spsc_push_aq(&ch->free_ring, &ch->in_flight);
+        ch->in_flight = NULL;
+        atomic_fetch_add_explicit(&ch->dropped, 1, memory_order_relaxed);
+    }
+    vchan_item_t it;
+    while (usb_spsc_pop_aq(&ch->tx_ring, &it)) {
+        if (!it.discard) atomic_fetch_add_explicit(&ch->dropped, 1, memory_order_relaxed);
+        usb_spsc_push_aq(&ch->free_ring, &it.block);
+    }
+}
+
+void usb_vchan_stats_aq(usb_vchan_aq_t *ch, usb_netif_vendor_stats_aq_t *out) {
+    out->open = ch->packet_size != 0;
+    out->blocks_sent = atomic_load_explicit(&ch->blocks_sent, memory_order_relaxed);
+    out->bytes_sent = atomic_load_explicit(&ch->bytes_sent, memory_order_relaxed);
+    out->no_block = atomic_load_explicit(&ch->no_block, memory_order_relaxed);
+    out->dropped = atomic_load_explicit(&ch->dropped, memory_order_relaxed);
+    out->queue_high_water = ch->queue_high_water;
+    out->blocks = ch->blocks;
+    out->payload_max = ch->payload_max;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "usb_netif_aq.h"
+#include "usb_spsc_aq.h"
+
+// Núcleo del canal vendor: pool de bloques, trama y cola hacia el transporte. C puro
+// sobre usb_spsc_aq para poder compilarlo en el host; el transporte real (endpoint bulk
+// IN de TinyUSB) está en usb_vendor_aq.c.
+//
+// Cada bloque es [cabecera 16 B][payload][relleno]. La aplicación escribe las muestras
+// directamente en el payload y el DMA del USB lee el bloque tal cual: sin copias.
+// Un productor (una tarea de la aplicación) y un consumidor (el contexto del transporte).
+
+#define USB_VCHAN_MAGIC_AQ   0x5141  // "AQ" en little-endian
+#define USB_VCHAN_VERSION_AQ 1
+
+// Cabecera de trama, little-endian. Una trama = una transferencia bulk: termina en un
+// paquete corto, así que el host la recibe entera con una sola lectura.
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t  version;
+    uint8_t  stream;   // canal lógico de la aplicación (p.ej. corriente ADC de PANEL_DC)
+    uint32_t seq;      // por canal; un salto indica bloques descartados en un reset
+    uint32_t ts_us;    // esp_timer al enviar
+    uint32_t len;      // bytes de payload
+} usb_vchan_hdr_aq_t;
+
+#define USB_VCHAN_HDR_AQ sizeof(usb_vchan_hdr_aq_t)
+
+typedef struct {
+    // Lanza la transferencia de buf; false si el endpoint no la acepta. Contexto del transporte.
+    bool (*xfer)(void *ctx, uint8_t *buf, uint32_t len);
+    // Pide al transporte que llame a usb_vchan_pump_aq en su contexto. Desde el productor.
+    void (*kick)(void *ctx);
+    void *ctx;
+} usb_vchan_ops_aq_t;
+
+typedef struct {
+    usb_vchan_ops_aq_t ops;
+    uint8_t *mem;                 // bloques contiguos
+    uint32_t blocks;
+    uint32_t block_size;          // cabecera + payload + relleno, múltiplo de 4
+    uint32_t payload_max;
+    uint16_t packet_size;         // tamaño máximo de paquete del endpoint (0 = sin abrir)
+    usb_spsc_aq_t free_ring;      // transporte -> productor: bloques libres
+    usb_spsc_aq_t tx_ring;        // productor -> transporte: bloques listos o abandonados
+    uint8_t *in_flight;           // solo el transporte
+    atomic_bool busy;             // cerrado, transferencia en curso o pump pendiente
+    uint32_t seq;                 // solo el productor
+    // Estadísticas (usb_netif_vendor_stats_aq_t)
+    atomic_uint blocks_sent;
+    atomic_uint bytes_sent;
+    atomic_uint no_block;
+    atomic_uint dropped;
+    uint32_t queue_high_water;
+} usb_vchan_aq_t;
+
+// mem: blocks * usb_vchan_block_size_aq(payload_max) bytes, alineado a 4 y apto para DMA
+uint32_t  usb_vchan_block_size_aq(uint32_t payload_max);
+esp_err_t usb_vchan_init_aq(usb_vchan_aq_t *ch, uint8_t *mem, uint32_t blocks, uint32_t payload_max,
+                            const usb_vchan_ops_aq_t *ops);
+void      usb_vchan_deinit_aq(usb_vchan_aq_t *ch);
+
+// Productor
+uint8_t  *usb_vchan_get_aq(usb_vchan_aq_t *ch, size_t *capacity);
+esp_err_t usb_vchan_send_aq(usb_vchan_aq_t *ch, uint8_t *payload, size_t len, uint8_t stream, uint32_t ts_us);
+void      usb_vchan_release_aq(usb_vchan_aq_t *ch, uint8_t *payload);
+
+// Transporte
+void usb_vchan_open_aq(usb_vchan_aq_t *ch, uint16_t packet_size);  // envía lo encolado mientras estaba cerrado
+void usb_vchan_pump_aq(usb_vchan_aq_t *ch);
+void usb_vchan_done_aq(usb_vchan_aq_t *ch, bool ok, uint32_t bytes);
+void usb_vchan_close_aq(usb_vchan_aq_t *ch);  // desmontaje/reset: lo pendiente vuelve al pool
+
+void usb_vchan_stats_aq(usb_vchan_aq_t *ch, usb_netif_vendor_stats_aq_t *out);
@@ -0,0 +1,181 @@
+#include "usb_vendor_aq.h"
+#include "sdkconfig.h"
+#include "usb_netif_aq.h"
+
+#if CONFIG_AQ_USB_VENDOR_CHANNEL
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "tusb.h"
+#include "device/usbd_pvt.h"
+#include "usb_mem_aq.h"
+#include "usb_vchan_aq.h"
+
+static const char *TAG = "usb_vendor_aq";
+
+// usbd_app_driver_get_cb y usbd_defer_func vienen de usbd_pvt.h, privado de TinyUSB: mismo
+// rango probado que usb_netif_aq.c (idf_component.yml)
+_Static_assert(TUSB_VERSION_MAJOR == 0 && TUSB_VERSION_MINOR == 18,
+               "usb_vendor_aq: TinyUSB internals only tested with tinyusb 0.18.x");
+
+// Driver de clase de aplicación (usbd_app_driver_get_cb) en vez de la clase vendor de
+// TinyUSB: esa copia cada escritura a su FIFO y trocea en paquetes; aquí el endpoint
+// transfiere el bloque de la aplicación tal cual, una trama por transferencia. Todo lo
+// de TinyUSB corre en la tarea usb_device (tud_task); el productor solo la despierta con
+// usbd_defer_func cuando el canal estaba parado.
+
+static usb_vchan_aq_t s_ch;
+static uint8_t *s_mem;
+static uint8_t s_rhport;
+static uint8_t s_ep_in;
+
+static bool vendor_xfer(void *ctx, uint8_t *buf, uint32_t len) {
+    return s_ep_in != 0 && usbd_edpt_xfer(s_rhport, s_ep_in, buf, (uint16_t)len);
+}
+
+static void vendor_pump(void *param) {
+    usb_vchan_pump_aq(&s_ch);
+}
+
+static void vendor_kick(void *ctx) {
+    usbd_defer_func(vendor_pump, NULL, false);
+}
+
+//--------------------------------------------------------------------+
+// Class driver
+//--------------------------------------------------------------------+
+static void vendor_drv_init(void) {
+}
+
+#if defined(TUSB_VERSION_NUMBER) && TUSB_VERSION_NUMBER >= 1700
+static bool vendor_drv_deinit(void) {
+    return true;
+}
+#endif
+
+static void vendor_drv_reset(uint8_t rhport) {
+    // Reset de bus o desconfiguración: lo que no llegó al host vuelve al pool
+    s_ep_in = 0;
+    usb_vchan_close_aq(&s_ch);
+}
+
+// Reclama la interfaz 0xFF con un único endpoint bulk IN; el resto es de NCM
+static uint16_t vendor_drv_open(uint8_t rhport, tusb_desc_interface_t const *itf, uint16_t max_len) {
+    if (itf->bInterfaceClass != TUSB_CLASS_VENDOR_SPECIFIC || itf->bNumEndpoints != 1) return 0;
+    uint8_t const *p = tu_desc_next(itf);
+    uint8_t const *end = (uint8_t const *)itf + max_len;
+    while (p < end && tu_desc_type(p) != TUSB_DESC_ENDPOINT) {
+        p = tu_desc_next(p);
+    }
+    if (p >= end) return 0;
+    tusb_desc_endpoint_t const *ep = (tusb_desc_endpoint_t const *)p;
+    if (ep->bmAttributes.xfer != TUSB_XFER_BULK || tu_edpt_dir(ep->bEndpointAddress) != TUSB_DIR_IN) return 0;
+    if (!usbd_edpt_open(rhport, ep)) return 0;
+
+    s_rhport = rhport;
+    s_ep_in = ep->bEndpointAddress;
+    uint16_t mps = tu_edpt_packet_size(ep);
+    ESP_LOGI(TAG, "Vendor channel open: EP 0x%02X, %u-byte packets", s_ep_in, mps);
+    usb_vchan_open_aq(&s_ch, mps);
+    return (uint16_t)(p + ep->bLength - (uint8_t const *)itf);
+}
+
+static bool vendor_drv_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t const *request) {
+    return false;  // sin peticiones propias: STALL
+}
+
+static bool vendor_drv_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes) {
+    if (ep_addr != s_ep_in) return false;
+    usb_vchan_done_aq(&s_ch, result == XFER_RESULT_SUCCESS, xferred_bytes);
+    return true;
+}
+
+static const usbd_class_driver_t s_vendor_driver = {
+#if CFG_TUSB_DEBUG >= 2
+    .name = "AQ_VENDOR",
+#endif
+    .init = vendor_drv_init,
+#if defined(TUSB_VERSION_NUMBER) && TUSB_VERSION_NUMBER >= 1700
+    .deinit = vendor_drv_deinit,
+#endif
+    .reset = vendor_drv_reset,
+    .open = vendor_drv_open,
+    .control_xfer_cb = vendor_drv_control_xfer_cb,
+    .xfer_cb = vendor_drv_xfer_cb,
+    .sof = NULL,
+};
+
+// TinyUSB consulta los drivers de aplicación antes que los suyos
+usbd_class_driver_t const *usbd_app_driver_get_cb(uint8_t *driver_count) {
+    *driver_count = 1;
+    return &s_vendor_driver;
+}
+
+//--------------------------------------------------------------------+
+// Ciclo de vida y API pública
+//--------------------------------------------------------------------+
+#define VENDOR_MEM_BYTES_AQ \
+    (CONFIG_AQ_USB_VENDOR_BLOCKS * usb_vchan_block_size_aq(CONFIG_AQ_USB_VENDOR_BLOCK_SIZE))
+
+esp_err_t usb_vendor_init_aq(void) {
+    s_mem = usb_mem_alloc_aq(USB_MEM_VENDOR_AQ, VENDOR_MEM_BYTES_AQ);
+    if (s_mem == NULL) return ESP_ERR_NO_MEM;
+    const usb_vchan_ops_aq_t ops = { .xfer = vendor_xfer, .kick = vendor_kick };
+    esp_err_t err = usb_vchan_init_aq(&s_ch, s_mem, CONFIG_AQ_USB_VENDOR_BLOCKS, CONFIG_AQ_USB_VENDOR_BLOCK_SIZE, &ops);
+    if (err != ESP_OK) {
+        usb_mem_free_aq(USB_MEM_VENDOR_AQ, s_mem, VENDOR_MEM_BYTES_AQ);
+        s_mem = NULL;
+    }
+    return err;
+}
+
+void usb_vendor_deinit_aq(void) {
+    if (s_mem == NULL) return;
+    usb_vchan_deinit_aq(&s_ch);
+    usb_mem_free_aq(USB_MEM_VENDOR_AQ, s_mem, VENDOR_MEM_BYTES_AQ);
+    s_mem = NULL;
+}
+
+uint8_t *usb_netif_vendor_block_get_aq(size_t *capacity) {
+    return usb_vchan_get_aq(&s_ch, capacity);
+}
+
+esp_err_t usb_netif_vendor_block_send_aq(uint8_t *block, size_t len, uint8_t stream) {
+    return usb_vchan_send_aq(&s_ch, block, len, stream, (uint32_t)esp_timer_get_time());
+}
+
+void usb_netif_vendor_block_release_aq(uint8_t *block) {
+    usb_vchan_release_aq(&s_ch, block);
+}
+
+esp_err_t usb_netif_vendor_get_stats_aq(usb_netif_vendor_stats_aq_t *out) {
+    if (out == NULL) return ESP_ERR_INVALID_ARG;
+    if (s_mem == NULL) return ESP_ERR_INVALID_STATE;
+    usb_vchan_stats_aq(&s_ch, out);
+    return ESP_OK;
+}
+
+#else  // !CONFIG_AQ_USB_VENDOR_CHANNEL
+
+esp_err_t usb_vendor_init_aq(void) {
+    return ESP_OK;
+}
+
+void usb_vendor_deinit_aq(void) {
+}
+
+uint8_t *usb_netif_vendor_block_get_aq(size_t *capacity) {
+    return NULL;
+}
+
+esp_err_t usb_netif_vendor_block_send_aq(uint8_t *block, size_t len, uint8_t stream) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void usb_netif_vendor_block_release_aq(uint8_t *block) {
+}
+
+esp_err_t usb_netif_vendor_get_stats_aq(usb_netif_vendor_stats_aq_t *out) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
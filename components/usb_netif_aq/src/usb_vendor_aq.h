@@ -0,0 +1,7 @@
+#pragma once
+#include "esp_err.h"
+
+// Transporte del canal vendor (usb_vendor_aq.c): driver de clase de aplicación de TinyUSB
+// sobre el núcleo usb_vchan_aq. Sin CONFIG_AQ_USB_VENDOR_CHANNEL no hace nada.
+esp_err_t usb_vendor_init_aq(void);    // antes de tinyusb_driver_install
+void      usb_vendor_deinit_aq(void);  // después de tinyusb_driver_uninstall
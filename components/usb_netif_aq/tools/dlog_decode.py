@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Decodifica en el MASTER el log diferido de usb_netif_aq enviado por UDP.
+
+Uso (panel con CONFIG_AQ_USB_DLOG_UDP):
+    python components/usb_netif_aq/tools/dlog_decode.py                 # escucha en 0.0.0.0:5515
+    python components/usb_netif_aq/tools/dlog_decode.py --port 6000 --level 2
+
+Los formatos salen del catálogo src/usb_dlog_msgs_aq.h, el mismo que compila el firmware:
+el identificador de cada registro es la posición del mensaje en la lista. Con un catálogo
+que no coincide con el del panel las líneas salen con el texto equivocado, así que se usa
+el del mismo commit que el firmware.
+
+Datagrama (little-endian): "AQLG", u16 versión = 1, u16 count, u32 seq, u32 dropped, y
+count registros de 24 B: u32 ts_us, u16 id, u8 level, u8 core, u32 args[4].
+"""
+import argparse
+import os
+import re
+import socket
+import struct
+import sys
+
+MAGIC = b'AQLG'
+HDR = struct.Struct('<4sHHII')
+REC = struct.Struct('<IHBB4I')
+LEVELS = {'NONE': 0, 'ERROR': 1, 'WARN': 2, 'INFO': 3, 'DEBUG': 4, 'VERBOSE': 5}
+LETTER = 'NEWIDV'
+MSG_RE = re.compile(r'X\((\w+),\s*(\w+),\s*"([^"]*)",\s*"((?:[^"\\]|\\.)*)"\)')
+CONV_RE = re.compile(r'%(0?\d*)([udxX])')
+DEFAULT_CATALOG = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'src', 'usb_dlog_msgs_aq.h')
+
+
+def load_catalog(path):
+    msgs = []
+    with open(path, encoding='utf-8') as f:
+        for line in f:
+            m = MSG_RE.search(line)
+            if m:
+                msg_id, level, tag, fmt = m.groups()
+                msgs.append((msg_id, LEVELS[level], tag, fmt))
+    return msgs
+
+
+def format_args(fmt, args):
+    # Solo conversiones de 32 bits (ver el catálogo); %d reinterpreta el valor con signo
+    it = iter(args)
+
+    def conv(m):
+        v = next(it, 0)
+        if m.group(2) == 'd':
+            v = v - (1 << 32) if v & 0x80000000 else v
+        return ('%' + m.group(1) + m.group(2)) % v
+
+    return CONV_RE.sub(conv, fmt)
+
+
+def decode(data):
+    if len(data) < HDR.size:
+        raise ValueError('short datagram')
+    magic, version, count, seq, dropped = HDR.unpack_from(data)
+    if magic != MAGIC or version != 1:
+        raise ValueError(f'bad header {magic!r} v{version}')
+    if len(data) < HDR.size + count * REC.size:
+        raise ValueError(f'truncated: {count} records announced')
+    recs = []
+    for i in range(count):
+        ts, msg, level, core, *args = REC.unpack_from(data, HDR.size + i * REC.size)
+        recs.append((ts, msg, level, core, args))
+    return seq, dropped, recs
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument('--bind', default='0.0.0.0', help='dirección local')
+    ap.add_argument('--port', type=int, default=5515, help='CONFIG_AQ_USB_DLOG_UDP_PORT')
+    ap.add_argument('--catalog', default=DEFAULT_CATALOG, help='usb_dlog_msgs_aq.h del firmware')
+    ap.add_argument('--level', type=int, default=5, help='nivel máximo a mostrar (0-5)')
+    args = ap.parse_args()
+
+    catalog = load_catalog(args.catalog)
+    if not catalog:
+        sys.exit(f'{args.catalog}: no messages found')
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.bind, args.port))
+    print(f'listening on {args.bind}:{args.port}, {len(catalog)} messages', file=sys.stderr)
+
+    expected = {}   # por panel: siguiente seq y dropped visto
+    while True:
+        data, peer = sock.recvfrom(2048)
+        try:
+            seq, dropped, recs = decode(data)
+        except ValueError as e:
+            print(f'{peer[0]}: {e}', file=sys.stderr)
+            continue
+        prev = expected.get(peer[0])
+        if prev is not None:
+            if seq != prev[0]:
+                print(f'{peer[0]}: {(seq - prev[0]) & 0xffffffff} datagrams lost', file=sys.stderr)
+            if dropped != prev[1]:
+                print(f'{peer[0]}: {(dropped - prev[1]) & 0xffffffff} records dropped on the panel', file=sys.stderr)
+        expected[peer[0]] = ((seq + 1) & 0xffffffff, dropped)
+        for ts, msg, level, core, rargs in recs:
+            if level > args.level:
+                continue
+            if msg < len(catalog):
+                _, _, tag, fmt = catalog[msg]
+                text = format_args(fmt, rargs)
+            else:
+                tag, text = '?', f'unknown message {msg} args {rargs}'
+            print(f'{LETTER[level] if level < len(LETTER) else "?"} ({ts / 1e6:.6f}) [{peer[0]} cpu{core}] {tag}: {text}')
+        sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+"""Coste en IRAM de cada función de un componente, a partir del .map del enlazador.
+
+Uso (tras idf.py build):
+    python components/usb_netif_aq/tools/iram_report.py build/<proyecto>.map
+    python components/usb_netif_aq/tools/iram_report.py build/<proyecto>.map --lib libmqtt_service_aq.a --json
+
+Cuenta .text.<func> y .literal.<func> (pool de literales de Xtensa) de los objetos de la
+librería y los reparte entre IRAM y flash según la sección de salida en que acabaron.
+Comparar la salida con CONFIG_AQ_USB_IRAM_PROFILE = None / Hot path / Whole data path
+da el precio en IRAM de cada perfil, función a función.
+"""
+import argparse
+import json
+import re
+import sys
+from collections import defaultdict
+
+OUT_RE = re.compile(r'^(\.\S+)')
+IN_RE = re.compile(r'^ (\.\S+)(?:\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)\s+(\S+))?\s*$')
+CONT_RE = re.compile(r'^\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)\s+(\S+)\s*$')
+SYM_RE = re.compile(r'^\s+0x[0-9a-fA-F]+\s+([A-Za-z_]\w*)\s*$')
+OBJ_RE = re.compile(r'\(([^()]+?)(?:\.c)?\.obj\)$')
+
+
+def region_of(out_section):
+    if out_section.startswith('.iram0'):
+        return 'iram'
+    if out_section.startswith('.flash.text'):
+        return 'flash'
+    return None
+
+
+def func_of(section):
+    for prefix in ('.text.', '.literal.'):
+        if section.startswith(prefix):
+            return section[len(prefix):]
+    return None  # .iram1.N (IRAM_ATTR): el nombre sale de la línea de símbolo siguiente
+
+
+def parse(path, lib):
+    funcs = defaultdict(lambda: {'iram': 0, 'flash': 0, 'object': ''})
+    out_section = None
+    pending = None   # sección de entrada cuya dirección/tamaño viene en la línea siguiente
+    unnamed = None   # entrada sin nombre de función esperando su símbolo
+    with open(path, errors='replace') as f:
+        for line in f:
+            line = line.rstrip('\n')
+            m = OUT_RE.match(line)
+            if m:
+                out_section, pending, unnamed = m.group(1), None, None
+                continue
+            entry = None
+            m = IN_RE.match(line)
+            if m:
+                if m.group(2) is None:
+                    pending = m.group(1)
+                    continue
+                entry = (m.group(1), int(m.group(3), 16), m.group(4))
+            elif pending:
+                m = CONT_RE.match(line)
+                if m:
+                    entry = (pending, int(m.group(2), 16), m.group(3))
+                pending = None
+            if entry:
+                unnamed = None
+                section, size, origin = entry
+                region = region_of(out_section or '')
+                if region is None or size == 0 or lib not in origin:
+                    continue
+                obj = OBJ_RE.search(origin)
+                record = (region, size, obj.group(1) if obj else origin)
+                name = func_of(section)
+                if name:
+                    add(funcs, name, record)
+                else:
+                    unnamed = record
+                continue
+            if unnamed:
+                m = SYM_RE.match(line)
+                if m:
+                    add(funcs, m.group(1), unnamed)
+                    unnamed = None
+    return funcs
+
+
+def add(funcs, name, record):
+    region, size, obj = record
+    funcs[name][region] += size
+    funcs[name]['object'] = obj
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument('map', help='fichero .map del build (build/<proyecto>.map)')
+    ap.add_argument('--lib', default='libusb_netif_aq.a', help='librería del componente')
+    ap.add_argument('--json', action='store_true', help='salida JSON')
+    args = ap.parse_args()
+
+    funcs = parse(args.map, args.lib)
+    if not funcs:
+        sys.exit(f'{args.lib}: no code found in {args.map}')
+    rows = sorted(funcs.items(), key=lambda kv: (-kv[1]['iram'], kv[0]))
+    total_iram = sum(v['iram'] for v in funcs.values())
+    total_flash = sum(v['flash'] for v in funcs.values())
+
+    if args.json:
+        json.dump({'lib': args.lib, 'iram': total_iram, 'flash': total_flash,
+                   'functions': {k: v for k, v in rows}}, sys.stdout, indent=2)
+        print()
+        return
+    print(f'{"function":<34} {"IRAM":>7} {"flash":>7}  object')
+    for name, v in rows:
+        print(f'{name:<34} {v["iram"]:>7} {v["flash"]:>7}  {v["object"]}')
+    print(f'{"total " + args.lib:<34} {total_iram:>7} {total_flash:>7}')
+
+
+if __name__ == '__main__':
+    main()
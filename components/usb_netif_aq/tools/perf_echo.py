@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+"""Mide desde el MASTER el eco UDP del servicio de medida de usb_netif_aq (CONFIG_AQ_USB_PERF).
+
+Uso:
+    python components/usb_netif_aq/tools/perf_echo.py 192.168.7.2                 # 1000 ecos de 64 B
+    python components/usb_netif_aq/tools/perf_echo.py 192.168.7.2 -n 5000 -s 1400 --rate 200
+
+Cada datagrama lleva una cabecera de 32 B little-endian: u32 magic = 0x43454151 ("AQEC"),
+u32 seq, u64 marca del cliente (ns, vuelve intacta), u64 llegada y u64 salida en el panel
+(µs de esp_timer); el resto es relleno hasta -s. El panel devuelve el datagrama con sus dos
+marcas escritas: rtt menos (salida - llegada) es el tiempo en el enlace USB y los dos stacks.
+"""
+import argparse
+import socket
+import struct
+import sys
+import time
+
+HDR = struct.Struct('<IIQQQ')
+MAGIC = 0x43454151
+
+
+def pct(sorted_vals, p):
+    return sorted_vals[min(len(sorted_vals) - 1, int(len(sorted_vals) * p / 100))]
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument('panel', help='IP del panel en el enlace USB')
+    ap.add_argument('--port', type=int, default=5002, help='CONFIG_AQ_USB_PERF_ECHO_PORT')
+    ap.add_argument('-n', type=int, default=1000, help='ecos')
+    ap.add_argument('-s', '--size', type=int, default=64, help='bytes por datagrama (>= 32)')
+    ap.add_argument('--rate', type=float, default=0, help='ecos/s; 0 = uno en vuelo, sin espera')
+    ap.add_argument('--timeout', type=float, default=0.5, help='s por eco')
+    args = ap.parse_args()
+    if args.size < HDR.size:
+        sys.exit(f'--size must be at least {HDR.size}')
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.settimeout(args.timeout)
+    sock.connect((args.panel, args.port))
+    pad = bytes(args.size - HDR.size)
+    rtt, link, lost, bad = [], [], 0, 0
+    for seq in range(args.n):
+        t0 = time.monotonic_ns()
+        sock.send(HDR.pack(MAGIC, seq, t0, 0, 0) + pad)
+        try:
+            while True:
+                data = sock.recv(65536)
+                magic, rseq, ts, t_rx, t_tx = HDR.unpack_from(data)
+                if magic == MAGIC and rseq == seq and ts == t0:
+                    break
+                bad += 1   # eco tardío de un seq anterior
+        except socket.timeout:
+            lost += 1
+            continue
+        us = (time.monotonic_ns() - t0) / 1000
+        rtt.append(us)
+        link.append(us - (t_tx - t_rx))
+        if args.rate:
+            time.sleep(max(0.0, 1 / args.rate - us / 1e6))
+
+    if not rtt:
+        sys.exit(f'no echo from {args.panel}:{args.port}: is CONFIG_AQ_USB_PERF enabled?')
+    rtt.sort()
+    link.sort()
+    print(f'{len(rtt)}/{args.n} echoes of {args.size} B, {lost} lost, {bad} late')
+    print(f'rtt   p50 {pct(rtt, 50):.0f} us  p99 {pct(rtt, 99):.0f} us  max {rtt[-1]:.0f} us')
+    print(f'link  p50 {pct(link, 50):.0f} us  p99 {pct(link, 99):.0f} us  (rtt minus time inside the panel)')
+
+
+if __name__ == '__main__':
+    main()
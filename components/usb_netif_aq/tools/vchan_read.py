@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+"""Lee en el MASTER el canal vendor bulk de usb_netif_aq (CONFIG_AQ_USB_VENDOR_CHANNEL).
+
+Uso (pyusb + libusb; en Linux, permisos de acceso al dispositivo vía udev):
+    python components/usb_netif_aq/tools/vchan_read.py                  # caudal y saltos
+    python components/usb_netif_aq/tools/vchan_read.py --stream 1 --out adc.bin
+
+La interfaz NCM sigue en manos del kernel; solo se reclama la interfaz 0xFF. Cada lectura
+devuelve una trama entera (el dispositivo termina cada transferencia en un paquete corto):
+cabecera de 16 B little-endian u16 magic = 0x5141, u8 version = 1, u8 stream, u32 seq,
+u32 ts_us, u32 len, y len bytes de payload. Un salto de seq son bloques descartados en el
+panel por un reset del bus o porque nadie leía.
+"""
+import argparse
+import struct
+import sys
+import time
+
+import usb.core
+import usb.util
+
+HDR = struct.Struct('<HBBIII')
+MAGIC = 0x5141
+VERSION = 1
+READ_LEN = 16 + 16368 + 64   # cabecera + CONFIG_AQ_USB_VENDOR_BLOCK_SIZE máximo + relleno
+
+
+def find_channel(vid, pid):
+    dev = usb.core.find(idVendor=vid, idProduct=pid)
+    if dev is None:
+        sys.exit(f'{vid:04x}:{pid:04x} not found')
+    cfg = dev.get_active_configuration()
+    for itf in cfg:
+        if itf.bInterfaceClass == 0xFF:
+            ep = usb.util.find_descriptor(
+                itf, custom_match=lambda e: usb.util.endpoint_direction(e.bEndpointAddress) == usb.util.ENDPOINT_IN)
+            if ep is not None:
+                usb.util.claim_interface(dev, itf.bInterfaceNumber)
+                return dev, itf.bInterfaceNumber, ep
+    sys.exit('no vendor interface: is CONFIG_AQ_USB_VENDOR_CHANNEL enabled?')
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument('--vid', type=lambda v: int(v, 0), default=0x303A)
+    ap.add_argument('--pid', type=lambda v: int(v, 0), default=0x4021)
+    ap.add_argument('--stream', type=int, default=None, help='solo este canal lógico')
+    ap.add_argument('--out', help='añade el payload crudo a este fichero')
+    ap.add_argument('--timeout', type=int, default=2000, help='ms por lectura')
+    args = ap.parse_args()
+
+    dev, itf, ep = find_channel(args.vid, args.pid)
+    out = open(args.out, 'ab') if args.out else None
+    expected = None
+    frames = payload = lost = 0
+    t_report = time.monotonic()
+    try:
+        while True:
+            try:
+                data = ep.read(READ_LEN, timeout=args.timeout)
+            except usb.core.USBTimeoutError:
+                continue
+            if len(data) < HDR.size:
+                print(f'short frame: {len(data)} bytes', file=sys.stderr)
+                continue
+            magic, version, stream, seq, ts_us, length = HDR.unpack_from(data)
+            if magic != MAGIC or version != VERSION or HDR.size + length > len(data):
+                print(f'bad frame: magic {magic:#06x} v{version} len {length} of {len(data)}', file=sys.stderr)
+                continue
+            if expected is not None and seq != expected:
+                lost += (seq - expected) & 0xffffffff
+            expected = (seq + 1) & 0xffffffff
+            frames += 1
+            payload += length
+            if out and (args.stream is None or stream == args.stream):
+                out.write(bytes(data[HDR.size:HDR.size + length]))
+            now = time.monotonic()
+            if now - t_report >= 1.0:
+                print(f'{frames / (now - t_report):.0f} frames/s, {payload / (now - t_report) / 1024:.1f} KB/s, '
+                      f'{lost} lost, last seq {seq} ts {ts_us} us')
+                frames = payload = 0
+                t_report = now
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if out:
+            out.close()
+        usb.util.release_interface(dev, itf)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,18 @@
+#pragma once
+#include <stdbool.h>
+#include <stdio.h>
+#include "sdkconfig.h"
+
+// Avisos y errores solo con -v: bajo saturación los componentes registran cada descarte y
+// la consola dominaría la medida. Los ESP_LOGI no se imprimen nunca.
+extern bool g_mock_log_verbose_aq;
+
+typedef enum {
+    ESP_LOG_NONE, ESP_LOG_ERROR, ESP_LOG_WARN, ESP_LOG_INFO, ESP_LOG_DEBUG, ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+#define ESP_LOGE(tag, fmt, ...) do { if (g_mock_log_verbose_aq) fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__); } while (0)
+#define ESP_LOGW(tag, fmt, ...) do { if (g_mock_log_verbose_aq) fprintf(stderr, "W %s: " fmt "\n", tag, ##__VA_ARGS__); } while (0)
+#define ESP_LOGI(tag, fmt, ...) do { (void)(tag); } while (0)
+#define ESP_LOGD(tag, fmt, ...) do { (void)(tag); } while (0)
+#define ESP_LOGV(tag, fmt, ...) do { (void)(tag); } while (0)
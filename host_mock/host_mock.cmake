@@ -0,0 +1,9 @@
+# Mock de IDF común a los host_bench de components/*: esp_err, esp_log y los stubs que
+# varios benches usan igual (esp_netif, esp_event, esp_timer, freertos/queue.h, lwip/sockets.h).
+# Cada host_bench lo incluye y pone su mock/ antes de HOST_MOCK_DIR, así un stub propio
+# (sdkconfig.h, FreeRTOS.h, el esp_netif.h completo de usb_netif_aq...) sustituye al común:
+#   include(${COMPONENT_DIR}/../../host_mock/host_mock.cmake)
+#   add_executable(x ... ${HOST_MOCK_SOURCES})
+#   target_include_directories(x PRIVATE mock ${HOST_MOCK_DIR} ...)
+set(HOST_MOCK_DIR ${CMAKE_CURRENT_LIST_DIR})
+set(HOST_MOCK_SOURCES ${HOST_MOCK_DIR}/mock_common_aq.c)
@@ -0,0 +1,10 @@
+#pragma once
+// La API de sockets de lwIP es la de BSD: en el host se usa la del sistema
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>